@@ -10,6 +10,8 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "input/lrec_readers.h"
+#include "input/lrec_index.h"
+#include "input/line_readers.h"
 #include "dsl/function_manager.h"
 #include "dsl/mlr_dsl_cst.h"
 #include "mapping/mappers.h"
@@ -42,6 +44,7 @@ static mapper_setup_t* mapper_lookup_table[] = {
 	&mapper_bootstrap_setup,
 	&mapper_cat_setup,
 	&mapper_check_setup,
+	&mapper_count_setup,
 	&mapper_count_distinct_setup,
 	&mapper_count_similar_setup,
 	&mapper_cut_setup,
@@ -58,6 +61,7 @@ static mapper_setup_t* mapper_lookup_table[] = {
 	&mapper_label_setup,
 	&mapper_least_frequent_setup,
 	&mapper_merge_fields_setup,
+	&mapper_merge_state_setup,
 	&mapper_most_frequent_setup,
 	&mapper_nest_setup,
 	&mapper_nothing_setup,
@@ -157,6 +161,54 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 			popts->do_in_place = TRUE;
 			argi += 1;
 
+		} else if (streq(argv[argi], "--build-index")) {
+			popts->do_build_index = TRUE;
+			argi += 1;
+
+		} else if (streq(argv[argi], "--index-stride")) {
+			check_arg_count(argv, argi, argc, 2);
+			if (sscanf(argv[argi+1], "%lld", &popts->index_stride) != 1 || popts->index_stride <= 0) {
+				fprintf(stderr,
+					"%s: --index-stride argument must be a positive integer; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
+		} else if (streq(argv[argi], "--byte-range")) {
+			check_arg_count(argv, argi, argc, 2);
+			long long start, end;
+			char colon, extra;
+			if (sscanf(argv[argi+1], "%lld:%lld%c", &start, &end, &extra) == 2 && start >= 0 && end >= start) {
+				popts->byte_range_start = start;
+				popts->byte_range_end = end;
+			} else if (sscanf(argv[argi+1], "%lld%c%c", &start, &colon, &extra) == 2 && colon == ':' && start >= 0) {
+				popts->byte_range_start = start;
+				popts->byte_range_end = -1LL;
+			} else {
+				fprintf(stderr,
+					"%s: --byte-range argument must be of the form {start}:{end} or {start}:; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
+		} else if (streq(argv[argi], "--shard")) {
+			check_arg_count(argv, argi, argc, 2);
+			char extra;
+			if (sscanf(argv[argi+1], "%lld/%lld%c", &popts->shard_number, &popts->num_shards, &extra) != 2
+				|| popts->shard_number < 1 || popts->shard_number > popts->num_shards)
+			{
+				fprintf(stderr,
+					"%s: --shard argument must be of the form {i}/{n} with 1 <= i <= n; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
 		} else if (streq(argv[argi], "-n")) {
 			no_input = TRUE;
 			argi += 1;
@@ -249,7 +301,8 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 	popts->mapper_argb = argi;
 	popts->argv = argv;
 	popts->argc = argc;
-	*ppmapper_list = cli_parse_mappers(argv, &argi, argc, popts, &no_input);
+	*ppmapper_list = cli_parse_mappers(argv, &argi, argc, popts, &no_input,
+		&popts->reader_opts);
 
 	for ( ; argi < argc; argi++) {
 		slls_append(popts->filenames, argv[argi], NO_FREE);
@@ -288,6 +341,52 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 		exit(1);
 	}
 
+	if (popts->do_build_index) {
+		// In-place output would leave the index describing the old file contents.
+		if (popts->do_in_place || popts->filenames == NULL) {
+			fprintf(stderr, "%s: --build-index is for reading input files, not with -I or -n.\n",
+				MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		if (!popts->reader_opts.use_mmap_for_read || popts->reader_opts.prepipe != NULL) {
+			fprintf(stderr, "%s: --build-index requires mmapped input files; see --mmap.\n",
+				MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+	}
+
+	if (popts->byte_range_start >= 0LL || popts->num_shards > 0LL) {
+		char* ifile_fmt = popts->reader_opts.ifile_fmt;
+		char* irs = streq(popts->reader_opts.irs, "auto") ? "\n" : popts->reader_opts.irs;
+		if (popts->byte_range_start >= 0LL && popts->num_shards > 0LL) {
+			fprintf(stderr, "%s: --byte-range and --shard are mutually exclusive.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		// In-place output would replace each file with just part of it, and an index would cover only part.
+		if (popts->do_in_place || popts->do_build_index || popts->filenames == NULL) {
+			fprintf(stderr, "%s: --byte-range and --shard are for reading input, not with -I, -n or --build-index.\n",
+				MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		if (!streq(ifile_fmt, "dkvp") && !streq(ifile_fmt, "nidx") && !streq(ifile_fmt, "csv")
+			&& !streq(ifile_fmt, "csvlite") && !streq(ifile_fmt, "tsv"))
+		{
+			fprintf(stderr, "%s: --byte-range and --shard are not supported for input format \"%s\".\n",
+				MLR_GLOBALS.bargv0, ifile_fmt);
+			exit(1);
+		}
+		if (mlr_irs_overlaps_itself(irs, strlen(irs))) {
+			fprintf(stderr, "%s: --byte-range and --shard are not supported for IRS \"%s\", which can overlap itself.\n",
+				MLR_GLOBALS.bargv0, popts->reader_opts.irs);
+			exit(1);
+		}
+		// The shards are of each file's size, which isn't known for standard input or before a prepipe.
+		if (popts->num_shards > 0LL && (popts->filenames->length == 0 || popts->reader_opts.prepipe != NULL)) {
+			fprintf(stderr, "%s: --shard needs input files, without --prepipe.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+	}
+
 	if (have_rand_seed) {
 		mtrand_init(rand_seed);
 	} else {
@@ -300,8 +399,21 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 // ----------------------------------------------------------------
 // Returns a list of mappers, from the starting point in argv given by *pargi. Bumps *pargi to
 // point to remaining post-mapper-setup args, i.e. filenames.
-sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts, int* pno_input) {
+//
+// Where a mapper's setup can fuse it with the next one in the chain, the pair are replaced by the
+// fused mapper, before any of the following.
+//
+// If ppushdown_reader_opts is non-null, its field projection is set to the set of field names
+// which the chain's output can depend on, or NULL if that's all of them. Walking the chain left to
+// right: a mapper which uses only its named fields ends the walk; one which passes other fields
+// through lets the walk continue; anything else, or reaching the end of the chain (the record
+// writer), needs all fields. Its record predicate and record-count, number and span sinks are set from
+// the first mapper, if that has them.
+sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts, int* pno_input,
+	cli_reader_opts_t* ppushdown_reader_opts)
+{
 	sllv_t* pmapper_list = sllv_alloc();
+	sllv_t* psetup_list = sllv_alloc(); // in parallel
 	int argi = *pargi;
 
 	// Allow then-chains to start with an initial 'then': 'mlr verb1 then verb2 then verb3' or
@@ -347,13 +459,60 @@ sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts,
 			*pno_input = TRUE;
 		}
 
-		sllv_append(pmapper_list, pmapper);
+		mapper_setup_t* pprev_setup = (psetup_list->ptail == NULL) ? NULL : psetup_list->ptail->pvvalue;
+		mapper_setup_t* pfused_setup = NULL;
+		mapper_t* pfused = (pprev_setup == NULL || pprev_setup->pfuse_func == NULL) ? NULL
+			: pprev_setup->pfuse_func(pmapper_list->ptail->pvvalue, pmapper_setup, pmapper, &pfused_setup);
+		if (pfused != NULL) {
+			pmapper_list->ptail->pvvalue = pfused;
+			psetup_list->ptail->pvvalue = pfused_setup;
+		} else {
+			sllv_append(pmapper_list, pmapper);
+			sllv_append(psetup_list, pmapper_setup);
+		}
 
 		if (argi >= argc || !streq(argv[argi], "then"))
 			break;
 		argi++;
 	}
 
+	if (ppushdown_reader_opts != NULL) {
+		mapper_t* pmapper = pmapper_list->phead->pvvalue;
+		mapper_setup_t* pmapper_setup = psetup_list->phead->pvvalue;
+
+		if (pmapper_setup->pinput_predicate_func != NULL)
+			ppushdown_reader_opts->precord_predicate = pmapper_setup->pinput_predicate_func(pmapper);
+		if (pmapper_setup->pinput_count_sink_func != NULL)
+			ppushdown_reader_opts->precord_count_sink = pmapper_setup->pinput_count_sink_func(pmapper);
+		if (pmapper_setup->pinput_number_sink_func != NULL)
+			ppushdown_reader_opts->pnumber_sink = pmapper_setup->pinput_number_sink_func(pmapper);
+		if (pmapper_setup->pinput_record_ranges_func != NULL)
+			ppushdown_reader_opts->precord_ranges = pmapper_setup->pinput_record_ranges_func(pmapper);
+		if (pmapper_setup->pinput_tail_count_func != NULL)
+			ppushdown_reader_opts->input_tail_count = pmapper_setup->pinput_tail_count_func(pmapper);
+		if (pmapper_setup->pinput_span_sink_func != NULL)
+			ppushdown_reader_opts->pspan_sink = pmapper_setup->pinput_span_sink_func(pmapper);
+	}
+
+	hss_t* pfield_projection = hss_alloc();
+	int projection_state = MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+	for (sllve_t* pe = pmapper_list->phead, * pf = psetup_list->phead;
+		pe != NULL && projection_state == MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+		pe = pe->pnext, pf = pf->pnext)
+	{
+		mapper_setup_t* pmapper_setup = pf->pvvalue;
+		projection_state = (pmapper_setup->pinput_fields_func == NULL)
+			? MAPPER_USES_ALL_FIELDS
+			: pmapper_setup->pinput_fields_func(pe->pvvalue, pfield_projection);
+	}
+	sllv_free(psetup_list);
+
+	if (ppushdown_reader_opts != NULL && projection_state == MAPPER_USES_ONLY_THESE_FIELDS) {
+		ppushdown_reader_opts->pfield_projection = pfield_projection;
+	} else {
+		hss_free(pfield_projection);
+	}
+
 	*pargi = argi;
 	return pmapper_list;
 }
@@ -364,6 +523,8 @@ void cli_opts_free(cli_opts_t* popts) {
 		return;
 
 	slls_free(popts->filenames);
+	if (popts->reader_opts.pfield_projection != NULL)
+		hss_free(popts->reader_opts.pfield_projection);
 	free(popts);
 	free_opt_singletons();
 }
@@ -418,9 +579,12 @@ static lhmss_t* get_default_rses() {
 		lhmss_put(singleton_default_rses, "nidx",     "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "csv",      "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "csvlite",  "auto",  NO_FREE);
+		lhmss_put(singleton_default_rses, "tsv",      "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "markdown", "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "pprint",   "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "xtab",     "(N/A)", NO_FREE);
+		lhmss_put(singleton_default_rses, "bin",      "(N/A)", NO_FREE);
+		lhmss_put(singleton_default_rses, "col",      "(N/A)", NO_FREE);
 	}
 	return singleton_default_rses;
 }
@@ -434,9 +598,12 @@ static lhmss_t* get_default_fses() {
 		lhmss_put(singleton_default_fses, "nidx",     " ",      NO_FREE);
 		lhmss_put(singleton_default_fses, "csv",      ",",      NO_FREE);
 		lhmss_put(singleton_default_fses, "csvlite",  ",",      NO_FREE);
+		lhmss_put(singleton_default_fses, "tsv",      "\t",     NO_FREE);
 		lhmss_put(singleton_default_fses, "markdown", "(N/A)",  NO_FREE);
 		lhmss_put(singleton_default_fses, "pprint",   " ",      NO_FREE);
 		lhmss_put(singleton_default_fses, "xtab",     "auto",   NO_FREE);
+		lhmss_put(singleton_default_fses, "bin",      "(N/A)",  NO_FREE);
+		lhmss_put(singleton_default_fses, "col",      "(N/A)",  NO_FREE);
 	}
 	return singleton_default_fses;
 }
@@ -450,9 +617,12 @@ static lhmss_t* get_default_pses() {
 		lhmss_put(singleton_default_pses, "nidx",     "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "csv",      "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "csvlite",  "(N/A)", NO_FREE);
+		lhmss_put(singleton_default_pses, "tsv",      "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "markdown", "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "pprint",   "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "xtab",     " ",     NO_FREE);
+		lhmss_put(singleton_default_pses, "bin",      "(N/A)", NO_FREE);
+		lhmss_put(singleton_default_pses, "col",      "(N/A)", NO_FREE);
 	}
 	return singleton_default_pses;
 }
@@ -465,10 +635,13 @@ static lhmsll_t* get_default_repeat_ifses() {
 		lhmsll_put(singleton_default_repeat_ifses, "json",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "csv",      FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "csvlite",  FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ifses, "tsv",      FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "markdown", FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "nidx",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "xtab",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "pprint",   TRUE,  NO_FREE);
+		lhmsll_put(singleton_default_repeat_ifses, "bin",      FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ifses, "col",      FALSE, NO_FREE);
 	}
 	return singleton_default_repeat_ifses;
 }
@@ -481,10 +654,13 @@ static lhmsll_t* get_default_repeat_ipses() {
 		lhmsll_put(singleton_default_repeat_ipses, "json",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "csv",      FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "csvlite",  FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ipses, "tsv",      FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "markdown", FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "nidx",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "xtab",     TRUE,  NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "pprint",   FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ipses, "bin",      FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ipses, "col",      FALSE, NO_FREE);
 	}
 	return singleton_default_repeat_ipses;
 }
@@ -749,8 +925,13 @@ static void main_usage_data_format_options(FILE* o, char* argv0) {
 	fprintf(o, "  --icsv    --ocsv    --csv       Comma-separated value (or tab-separated\n");
 	fprintf(o, "                                  with --fs tab, etc.)\n");
 	fprintf(o, "\n");
-	fprintf(o, "  --itsv    --otsv    --tsv       Keystroke-savers for \"--icsv --ifs tab\",\n");
-	fprintf(o, "                                  \"--ocsv --ofs tab\", \"--csv --fs tab\".\n");
+	fprintf(o, "  --itsv    --otsv    --tsv       Tab-separated value. Like CSV-lite with tab as\n");
+	fprintf(o, "                                  field separator, but without double-quoting:\n");
+	fprintf(o, "                                  tab, newline, carriage return, and backslash within\n");
+	fprintf(o, "                                  fields are written as \\t, \\n, \\r, and \\\\.\n");
+	fprintf(o, "                                  A record with a single, empty field is written as\n");
+	fprintf(o, "                                  a blank line, which TSV input takes as a schema\n");
+	fprintf(o, "                                  change rather than as a record.\n");
 	fprintf(o, "\n");
 	fprintf(o, "  --icsvlite --ocsvlite --csvlite Comma-separated value (or tab-separated\n");
 	fprintf(o, "                                  with --fs tab, etc.). The 'lite' CSV does not handle\n");
@@ -781,6 +962,9 @@ static void main_usage_data_format_options(FILE* o, char* argv0) {
 	fprintf(o, "    --json-fatal-arrays-on-input  maps. The other two options cause them to be skipped, or\n");
 	fprintf(o, "                                  to be treated as errors.  Please use the jq tool for full\n");
 	fprintf(o, "                                  JSON (pre)processing.\n");
+	fprintf(o, "    --no-json-index               When reading JSON files via mmap, parse each file\n");
+	fprintf(o, "                                  whole, rather than a record at a time using a\n");
+	fprintf(o, "                                  structural-character index.\n");
 	fprintf(o, "                      --jvstack   Put one key-value pair per line for JSON\n");
 	fprintf(o, "                                  output.\n");
 	fprintf(o, "                      --jlistwrap Wrap JSON output in outermost [ ].\n");
@@ -792,6 +976,18 @@ static void main_usage_data_format_options(FILE* o, char* argv0) {
 	fprintf(o, "                                  non-JSON formats. Defaults to %s.\n",
 		DEFAULT_JSON_FLATTEN_SEPARATOR);
 	fprintf(o, "\n");
+	fprintf(o, "  --ibin    --obin    --bin       Miller's own binary format, for intermediate files\n");
+	fprintf(o, "                                  between Miller runs: much faster to read than text\n");
+	fprintf(o, "                                  formats. Field names are written once per distinct\n");
+	fprintf(o, "                                  field-name list.\n");
+	fprintf(o, "                    --obin-typed  Like --obin, but also writes numbers in binary form\n");
+	fprintf(o, "                                  where that reproduces them exactly. This makes files\n");
+	fprintf(o, "                                  smaller but slower to read.\n");
+	fprintf(o, "  --icol    --ocol    --col       Miller's own columnar format, for data written once\n");
+	fprintf(o, "                                  then analyzed many times: only the fields used are\n");
+	fprintf(o, "                                  decoded, filters on numeric fields skip blocks of\n");
+	fprintf(o, "                                  records, and stats1 without -g reads numbers directly.\n");
+	fprintf(o, "\n");
 	fprintf(o, "  -p is a keystroke-saver for --nidx --fs space --repifs\n");
 	fprintf(o, "\n");
 	fprintf(o, "  --mmap --no-mmap --mmap-below {n} Use mmap for files whenever possible, never, or\n");
@@ -894,7 +1090,9 @@ static void main_usage_separator_options(FILE* o, char* argv0) {
 	fprintf(o, "    alignment impossible.\n");
 	fprintf(o, "  * OPS may be multi-character for XTAB format, in which case alignment is\n");
 	fprintf(o, "    disabled.\n");
-	fprintf(o, "  * TSV is simply CSV using tab as field separator (\"--fs tab\").\n");
+	fprintf(o, "  * TSV is a format of its own, with tab as default field separator; IFS must be\n");
+	fprintf(o, "    single-character for TSV input. TSV-lite is simply CSV-lite using tab as field\n");
+	fprintf(o, "    separator (\"--fs tab\").\n");
 	fprintf(o, "  * FS/PS are ignored for markdown format; RS is used.\n");
 	fprintf(o, "  * All FS and PS options are ignored for JSON format, since they are not relevant\n");
 	fprintf(o, "    to the JSON format.\n");
@@ -972,6 +1170,30 @@ static void main_usage_other_options(FILE* o, char* argv0) {
 	fprintf(o, "                     file is processed in isolation: if the output format is\n");
 	fprintf(o, "                     CSV, CSV headers will be present in each output file;\n");
 	fprintf(o, "                     statistics are only over each file's own records; and so on.\n");
+	fprintf(o, "  --build-index      For each input file, write a record index to the file name\n");
+	fprintf(o, "                     with \"%s\" appended, while processing it as usual.\n", MLR_INDEX_FILE_SUFFIX);
+	fprintf(o, "                     Later runs with the same input-format options then seek\n");
+	fprintf(o, "                     using the index, if it's newer than the data, when the\n");
+	fprintf(o, "                     first verb is tail or sample without -g, or filter on NR\n");
+	fprintf(o, "                     ranges such as 'NR > 1000000 && NR <= 1000100'; and count\n");
+	fprintf(o, "                     records straight from it. Needs mmapped input (see --mmap)\n");
+	fprintf(o, "                     in DKVP, NIDX, CSV, CSV-lite or TSV format. Example:\n");
+	fprintf(o, "                     \"%s --icsv --build-index nothing big.csv\".\n", argv0);
+	fprintf(o, "  --index-stride {n} Index every nth record when building an index. Default %lld.\n",
+		DEFAULT_INDEX_STRIDE);
+	fprintf(o, "  --byte-range {start}:{end} Read only the records starting at byte offsets from\n");
+	fprintf(o, "                     start up to but not including end in each input file, or\n");
+	fprintf(o, "                     through end of file with {start}:, for splitting work\n");
+	fprintf(o, "                     across processes: ranges which together cover a file read\n");
+	fprintf(o, "                     each of its records once. CSV and TSV headers are read from\n");
+	fprintf(o, "                     the start of the file. NR and FNR count from the range's\n");
+	fprintf(o, "                     first record. For DKVP, NIDX, CSV, CSV-lite or TSV format,\n");
+	fprintf(o, "                     where records are lines: not CSV with line breaks within\n");
+	fprintf(o, "                     quotes, nor CSV-lite with a schema change before the range.\n");
+	fprintf(o, "  --shard {i}/{n}    Same as --byte-range for the ith of n equal byte ranges\n");
+	fprintf(o, "                     of each input file, for i from 1 to n. Example: run\n");
+	fprintf(o, "                     \"%s --shard 1/4 ...\" through \"%s --shard 4/4 ...\" in parallel.\n",
+		argv0, argv0);
 }
 
 static void main_usage_then_chaining(FILE* o, char* argv0) {
@@ -1068,6 +1290,14 @@ void cli_opts_init(cli_opts_t* popts) {
 	popts->nr_progress_mod = 0LL;
 
 	popts->do_in_place     = FALSE;
+
+	popts->do_build_index  = FALSE;
+	popts->index_stride    = DEFAULT_INDEX_STRIDE;
+
+	popts->byte_range_start = -1LL;
+	popts->byte_range_end   = -1LL;
+	popts->shard_number     = 0LL;
+	popts->num_shards       = 0LL;
 }
 
 void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
@@ -1082,6 +1312,7 @@ void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
 	preader_opts->allow_repeat_ips               = NEITHER_TRUE_NOR_FALSE;
 	preader_opts->use_implicit_csv_header        = NEITHER_TRUE_NOR_FALSE;
 	preader_opts->use_mmap_for_read              = NEITHER_TRUE_NOR_FALSE;
+	preader_opts->use_json_index                 = NEITHER_TRUE_NOR_FALSE;
 
 	preader_opts->prepipe                        = NULL;
 	preader_opts->comment_handling               = COMMENTS_ARE_DATA;
@@ -1094,6 +1325,14 @@ void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
 	preader_opts->generator_opts.start          = 0LL;
 	preader_opts->generator_opts.stop           = 100LL;
 	preader_opts->generator_opts.step           = 1LL;
+
+	preader_opts->pfield_projection             = NULL;
+	preader_opts->precord_predicate             = NULL;
+	preader_opts->precord_count_sink            = NULL;
+	preader_opts->pnumber_sink                  = NULL;
+	preader_opts->precord_ranges                = NULL;
+	preader_opts->input_tail_count              = -1LL;
+	preader_opts->pspan_sink                    = NULL;
 }
 
 void cli_writer_opts_init(cli_writer_opts_t* pwriter_opts) {
@@ -1113,6 +1352,7 @@ void cli_writer_opts_init(cli_writer_opts_t* pwriter_opts) {
 
 	pwriter_opts->output_json_flatten_separator  = NULL;
 	pwriter_opts->oosvar_flatten_separator       = NULL;
+	pwriter_opts->write_typed_bin_numbers        = NEITHER_TRUE_NOR_FALSE;
 
 	pwriter_opts->oquoting                       = QUOTE_UNSPECIFIED;
 }
@@ -1144,6 +1384,9 @@ void cli_apply_reader_defaults(cli_reader_opts_t* preader_opts) {
 		preader_opts->use_mmap_for_read = FALSE;
 #endif
 
+	if (preader_opts->use_json_index == NEITHER_TRUE_NOR_FALSE)
+		preader_opts->use_json_index = TRUE;
+
 	if (preader_opts->input_json_flatten_separator == NULL)
 		preader_opts->input_json_flatten_separator = DEFAULT_JSON_FLATTEN_SEPARATOR;
 }
@@ -1182,6 +1425,9 @@ void cli_apply_writer_defaults(cli_writer_opts_t* pwriter_opts) {
 	if (pwriter_opts->oosvar_flatten_separator == NULL)
 		pwriter_opts->oosvar_flatten_separator = DEFAULT_OOSVAR_FLATTEN_SEPARATOR;
 
+	if (pwriter_opts->write_typed_bin_numbers == NEITHER_TRUE_NOR_FALSE)
+		pwriter_opts->write_typed_bin_numbers = FALSE;
+
 	if (pwriter_opts->oquoting == QUOTE_UNSPECIFIED)
 		pwriter_opts->oquoting = DEFAULT_OQUOTING;
 }
@@ -1250,6 +1496,9 @@ void cli_merge_reader_opts(cli_reader_opts_t* pfunc_opts, cli_reader_opts_t* pma
 	if (pfunc_opts->use_mmap_for_read == NEITHER_TRUE_NOR_FALSE)
 		pfunc_opts->use_mmap_for_read = pmain_opts->use_mmap_for_read;
 
+	if (pfunc_opts->use_json_index == NEITHER_TRUE_NOR_FALSE)
+		pfunc_opts->use_json_index = pmain_opts->use_json_index;
+
 	if (pfunc_opts->input_json_flatten_separator == NULL)
 		pfunc_opts->input_json_flatten_separator = pmain_opts->input_json_flatten_separator;
 }
@@ -1308,6 +1557,9 @@ void cli_merge_writer_opts(cli_writer_opts_t* pfunc_opts, cli_writer_opts_t* pma
 	if (pfunc_opts->oosvar_flatten_separator == NULL)
 		pfunc_opts->oosvar_flatten_separator = pmain_opts->oosvar_flatten_separator;
 
+	if (pfunc_opts->write_typed_bin_numbers == NEITHER_TRUE_NOR_FALSE)
+		pfunc_opts->write_typed_bin_numbers = pmain_opts->write_typed_bin_numbers;
+
 	if (pfunc_opts->oquoting == QUOTE_UNSPECIFIED)
 		pfunc_opts->oquoting = pmain_opts->oquoting;
 }
@@ -1452,6 +1704,9 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 	} else if (streq(argv[argi], "--json-map-arrays-on-input")) {
 		preader_opts->json_array_ingest = JSON_ARRAY_INGEST_AS_MAP;
 		argi += 1;
+	} else if (streq(argv[argi], "--no-json-index")) {
+		preader_opts->use_json_index = FALSE;
+		argi += 1;
 
 	} else if (streq(argv[argi], "--implicit-csv-header")) {
 		preader_opts->use_implicit_csv_header = TRUE;
@@ -1509,8 +1764,7 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 		argi += 1;
 
 	} else if (streq(argv[argi], "--itsv")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		argi += 1;
 
 	} else if (streq(argv[argi], "--itsvlite")) {
@@ -1534,6 +1788,14 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 		preader_opts->ifile_fmt = "xtab";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--ibin")) {
+		preader_opts->ifile_fmt = "bin";
+		argi += 1;
+
+	} else if (streq(argv[argi], "--icol")) {
+		preader_opts->ifile_fmt = "col";
+		argi += 1;
+
 	} else if (streq(argv[argi], "--ipprint")) {
 		preader_opts->ifile_fmt        = "csvlite";
 		preader_opts->ifs              = " ";
@@ -1662,8 +1924,7 @@ int cli_handle_writer_options(char** argv, int argc, int *pargi, cli_writer_opts
 		argi += 1;
 
 	} else if (streq(argv[argi], "--otsv")) {
-		pwriter_opts->ofile_fmt = "csv";
-		pwriter_opts->ofs = "\t";
+		pwriter_opts->ofile_fmt = "tsv";
 		argi += 1;
 
 	} else if (streq(argv[argi], "--otsvlite")) {
@@ -1695,6 +1956,19 @@ int cli_handle_writer_options(char** argv, int argc, int *pargi, cli_writer_opts
 		pwriter_opts->ofile_fmt = "pprint";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--obin")) {
+		pwriter_opts->ofile_fmt = "bin";
+		argi += 1;
+
+	} else if (streq(argv[argi], "--obin-typed")) {
+		pwriter_opts->ofile_fmt = "bin";
+		pwriter_opts->write_typed_bin_numbers = TRUE;
+		argi += 1;
+
+	} else if (streq(argv[argi], "--ocol")) {
+		pwriter_opts->ofile_fmt = "col";
+		argi += 1;
+
 	} else if (streq(argv[argi], "--right")) {
 		pwriter_opts->right_align_pprint = TRUE;
 		argi += 1;
@@ -1789,9 +2063,7 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 
 	} else if (streq(argv[argi], "--tsv")) {
-		preader_opts->ifile_fmt = pwriter_opts->ofile_fmt = "csv";
-		preader_opts->ifs = "\t";
-		pwriter_opts->ofs = "\t";
+		preader_opts->ifile_fmt = pwriter_opts->ofile_fmt = "tsv";
 		argi += 1;
 
 	} else if (streq(argv[argi], "--tsvlite") || streq(argv[argi], "-t")) {
@@ -1815,6 +2087,16 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		pwriter_opts->ofile_fmt = "nidx";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--bin")) {
+		preader_opts->ifile_fmt = "bin";
+		pwriter_opts->ofile_fmt = "bin";
+		argi += 1;
+
+	} else if (streq(argv[argi], "--col")) {
+		preader_opts->ifile_fmt = "col";
+		pwriter_opts->ofile_fmt = "col";
+		argi += 1;
+
 	} else if (streq(argv[argi], "-T")) {
 		preader_opts->ifile_fmt = "nidx";
 		pwriter_opts->ofile_fmt = "nidx";
@@ -1837,9 +2119,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 	} else if (streq(argv[argi], "--c2t")) {
 		preader_opts->ifile_fmt = "csv";
 		preader_opts->irs       = "auto";
-		pwriter_opts->ofile_fmt = "csv";
+		pwriter_opts->ofile_fmt = "tsv";
 		pwriter_opts->ors       = "auto";
-		pwriter_opts->ofs       = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--c2d")) {
 		preader_opts->ifile_fmt = "csv";
@@ -1873,45 +2154,38 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 
 	} else if (streq(argv[argi], "--t2c")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "csv";
 		pwriter_opts->ors       = "auto";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2d")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "dkvp";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2n")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "nidx";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2j")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "json";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2p")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "pprint";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2x")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "xtab";
 		argi += 1;
 	} else if (streq(argv[argi], "--t2m")) {
-		preader_opts->ifile_fmt = "csv";
-		preader_opts->ifs       = "\t";
+		preader_opts->ifile_fmt = "tsv";
 		preader_opts->irs       = "auto";
 		pwriter_opts->ofile_fmt = "markdown";
 		argi += 1;
@@ -1923,9 +2197,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 	} else if (streq(argv[argi], "--d2t")) {
 		preader_opts->ifile_fmt = "dkvp";
-		pwriter_opts->ofile_fmt = "csv";
+		pwriter_opts->ofile_fmt = "tsv";
 		pwriter_opts->ors       = "auto";
-		pwriter_opts->ofs       = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--d2n")) {
 		preader_opts->ifile_fmt = "dkvp";
@@ -1955,9 +2228,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 	} else if (streq(argv[argi], "--n2t")) {
 		preader_opts->ifile_fmt = "nidx";
-		pwriter_opts->ofile_fmt = "csv";
+		pwriter_opts->ofile_fmt = "tsv";
 		pwriter_opts->ors       = "auto";
-		pwriter_opts->ofs       = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--n2d")) {
 		preader_opts->ifile_fmt = "nidx";
@@ -1987,9 +2259,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 	} else if (streq(argv[argi], "--j2t")) {
 		preader_opts->ifile_fmt = "json";
-		pwriter_opts->ofile_fmt = "csv";
+		pwriter_opts->ofile_fmt = "tsv";
 		pwriter_opts->ors       = "auto";
-		pwriter_opts->ofs       = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--j2d")) {
 		preader_opts->ifile_fmt = "json";
@@ -2023,9 +2294,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		preader_opts->ifile_fmt        = "csvlite";
 		preader_opts->ifs              = " ";
 		preader_opts->allow_repeat_ifs = TRUE;
-		pwriter_opts->ofile_fmt        = "csv";
+		pwriter_opts->ofile_fmt        = "tsv";
 		pwriter_opts->ors              = "auto";
-		pwriter_opts->ofs              = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--p2d")) {
 		preader_opts->ifile_fmt        = "csvlite";
@@ -2065,9 +2335,8 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		argi += 1;
 	} else if (streq(argv[argi], "--x2t")) {
 		preader_opts->ifile_fmt = "xtab";
-		pwriter_opts->ofile_fmt = "csv";
+		pwriter_opts->ofile_fmt = "tsv";
 		pwriter_opts->ors       = "auto";
-		pwriter_opts->ofs       = "\t";
 		argi += 1;
 	} else if (streq(argv[argi], "--x2d")) {
 		preader_opts->ifile_fmt = "xtab";
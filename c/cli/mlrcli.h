@@ -13,6 +13,8 @@
 #include "cli/json_array_ingest.h"
 #include "containers/lhmsll.h"
 #include "containers/lhmss.h"
+#include "containers/hss.h"
+#include "input/lrec_reader.h"
 #include <unistd.h>
 
 // ----------------------------------------------------------------
@@ -37,6 +39,7 @@ typedef struct _cli_reader_opts_t {
 	int   allow_repeat_ips;
 	int   use_implicit_csv_header;
 	int   use_mmap_for_read;
+	int   use_json_index;
 
 	// Command for popen on input, e.g. "zcat -cf <". Can be null in which case
 	// files are read directly rather than through a pipe.
@@ -51,6 +54,30 @@ typedef struct _cli_reader_opts_t {
 	// Fake internal-data-generator 'reader'
 	generator_opts_t generator_opts;
 
+	// Field names the main mapper chain can need, or NULL for all of them. Readers which support
+	// projection skip the rest. Set up from the mapper chain, so this is never merged into
+	// per-verb reader options such as join's.
+	hss_t* pfield_projection;
+	// Record test the readers may apply before the main mapper chain sees the record, or NULL.
+	// Borrowed from the chain's first mapper; likewise never merged into per-verb reader options.
+	lrec_reader_predicate_t* precord_predicate;
+	// Where the stream driver may send record counts in place of records, for readers able to
+	// count without parsing, or NULL. Borrowed from the chain's first mapper, as above.
+	lrec_reader_count_sink_t* precord_count_sink;
+	// Where readers with typed columns may send blocks of numbers in place of records, or NULL.
+	// Borrowed from the chain's first mapper, as above.
+	lrec_reader_number_sink_t* pnumber_sink;
+	// Which records, by position, the main mapper chain needs, for indexed input, or NULL for all of
+	// them. Borrowed from the chain's first mapper, as above.
+	lrec_reader_record_ranges_t* precord_ranges;
+	// How many records at the end of each input file the main mapper chain needs, for mmap readers able
+	// to find them by reading backward, or -1 for all of them. From the chain's first mapper, as above.
+	long long input_tail_count;
+	// Where the stream driver may send records holding only a few fields, with where they came from, in
+	// place of whole records, for readers able to read them again, or NULL. From the chain's first
+	// mapper, as above.
+	lrec_reader_span_sink_t* pspan_sink;
+
 } cli_reader_opts_t;
 
 // ----------------------------------------------------------------
@@ -71,6 +98,7 @@ typedef struct _cli_writer_opts_t {
 	int   json_quote_non_string_values;
 	char* output_json_flatten_separator;
 	char* oosvar_flatten_separator;
+	int   write_typed_bin_numbers;
 
 	quoting_t oquoting;
 
@@ -94,6 +122,19 @@ typedef struct _cli_opts_t {
 
 	int do_in_place;
 
+	// Write a record index for each input file, with an entry every index_stride records. See
+	// input/lrec_index.h.
+	int do_build_index;
+	long long index_stride;
+
+	// Read only the records starting within a byte range of each input file: [byte_range_start,
+	// byte_range_end), through end of file if byte_range_end is -1, or the shard_number'th of num_shards
+	// equal ranges. Unused if byte_range_start is -1 and num_shards is 0.
+	long long byte_range_start;
+	long long byte_range_end;
+	long long shard_number;
+	long long num_shards;
+
 } cli_opts_t;
 
 // ----------------------------------------------------------------
@@ -101,7 +142,8 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list);
 
 // See stream.c. The idea is that the mapper-chain is constructed once for normal stream-over-all-files
 // mode, but per-file for in-place mode.
-sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts, int* pno_input);
+sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts, int* pno_input,
+	cli_reader_opts_t* ppushdown_reader_opts);
 
 int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts_t* preader_opts);
 int cli_handle_writer_options(char** argv, int argc, int *pargi, cli_writer_opts_t* pwriter_opts);
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/frequent_keeper.h"
+
+#define FREQUENT_KEEPER_INIT_ALLOC_SIZE 16
+
+static int  frequent_keeper_find(frequent_keeper_t* pkeeper, slls_t* pvalues, int hash);
+static void frequent_keeper_insert_slot(frequent_keeper_t* pkeeper, int entry_index);
+static void frequent_keeper_remove_slot(frequent_keeper_t* pkeeper, int entry_index);
+static void frequent_keeper_grow(frequent_keeper_t* pkeeper);
+static void frequent_keeper_sift_up(frequent_keeper_t* pkeeper, int i);
+static void frequent_keeper_sift_down(frequent_keeper_t* pkeeper, int i);
+
+// ----------------------------------------------------------------
+frequent_keeper_t* frequent_keeper_alloc(int capacity) {
+	frequent_keeper_t* pkeeper = mlr_malloc_or_die(sizeof(frequent_keeper_t));
+	pkeeper->capacity   = capacity;
+	pkeeper->size       = 0;
+	pkeeper->alloc_size = 0;
+	pkeeper->entries    = NULL;
+	pkeeper->heap       = NULL;
+	pkeeper->slots      = NULL;
+	pkeeper->slots_mask = 0;
+	pkeeper->num_added  = 0LL;
+	frequent_keeper_grow(pkeeper);
+	return pkeeper;
+}
+
+void frequent_keeper_free(frequent_keeper_t* pkeeper) {
+	if (pkeeper == NULL)
+		return;
+	for (int i = 0; i < pkeeper->size; i++)
+		slls_free(pkeeper->entries[i].pvalues);
+	free(pkeeper->entries);
+	free(pkeeper->heap);
+	free(pkeeper->slots);
+	free(pkeeper);
+}
+
+// ----------------------------------------------------------------
+// Cases:
+// * Already tracked: increment the count, which may move the entry down the heap.
+// * Not tracked, not yet full: add an entry at the bottom of the heap, where a count of one belongs.
+// * Not tracked, full: the entry with the smallest count, at the top of the heap, is given the new values.
+void frequent_keeper_add(frequent_keeper_t* pkeeper, slls_t* pvalues) {
+	int hash = slls_hash_func(pvalues);
+	int entry_index = frequent_keeper_find(pkeeper, pvalues, hash);
+	pkeeper->num_added++;
+
+	if (entry_index >= 0) {
+		frequent_keeper_entry_t* pentry = &pkeeper->entries[entry_index];
+		pentry->count++;
+		frequent_keeper_sift_down(pkeeper, pentry->heap_index);
+
+	} else if (pkeeper->size < pkeeper->capacity) {
+		if (pkeeper->size >= pkeeper->alloc_size)
+			frequent_keeper_grow(pkeeper);
+		entry_index = pkeeper->size++;
+		frequent_keeper_entry_t* pentry = &pkeeper->entries[entry_index];
+		pentry->pvalues    = slls_copy(pvalues);
+		pentry->count      = 1LL;
+		pentry->error      = 0LL;
+		pentry->seq        = pkeeper->num_added;
+		pentry->hash       = hash;
+		pentry->heap_index = entry_index;
+		pkeeper->heap[entry_index] = entry_index;
+		frequent_keeper_insert_slot(pkeeper, entry_index);
+		frequent_keeper_sift_up(pkeeper, entry_index);
+
+	} else {
+		entry_index = pkeeper->heap[0];
+		frequent_keeper_entry_t* pentry = &pkeeper->entries[entry_index];
+		frequent_keeper_remove_slot(pkeeper, entry_index);
+		slls_free(pentry->pvalues);
+		pentry->pvalues = slls_copy(pvalues);
+		pentry->error   = pentry->count;
+		pentry->count++;
+		pentry->seq     = pkeeper->num_added;
+		pentry->hash    = hash;
+		frequent_keeper_insert_slot(pkeeper, entry_index);
+		frequent_keeper_sift_down(pkeeper, 0);
+	}
+}
+
+// ----------------------------------------------------------------
+static int frequent_keeper_cmp(const void* pva, const void* pvb) {
+	const frequent_keeper_entry_t* pa = *(frequent_keeper_entry_t**)pva;
+	const frequent_keeper_entry_t* pb = *(frequent_keeper_entry_t**)pvb;
+	if (pa->count != pb->count)
+		return (pa->count > pb->count) ? -1 : 1;
+	if (pa->error != pb->error)
+		return (pa->error < pb->error) ? -1 : 1;
+	return (pa->seq < pb->seq) ? -1 : (pa->seq > pb->seq) ? 1 : 0;
+}
+
+frequent_keeper_entry_t** frequent_keeper_sorted_entries(frequent_keeper_t* pkeeper) {
+	frequent_keeper_entry_t** pentries = mlr_malloc_or_die((pkeeper->size + 1) * sizeof(frequent_keeper_entry_t*));
+	for (int i = 0; i < pkeeper->size; i++)
+		pentries[i] = &pkeeper->entries[i];
+	qsort(pentries, pkeeper->size, sizeof(frequent_keeper_entry_t*), frequent_keeper_cmp);
+	return pentries;
+}
+
+// ----------------------------------------------------------------
+// The hash table has at least twice as many slots as there are entries allocated, so probes are short.
+static void frequent_keeper_grow(frequent_keeper_t* pkeeper) {
+	int alloc_size = (pkeeper->alloc_size == 0) ? FREQUENT_KEEPER_INIT_ALLOC_SIZE : 2 * pkeeper->alloc_size;
+	if (alloc_size > pkeeper->capacity)
+		alloc_size = pkeeper->capacity;
+	pkeeper->entries = mlr_realloc_or_die(pkeeper->entries, alloc_size * sizeof(frequent_keeper_entry_t));
+	pkeeper->heap    = mlr_realloc_or_die(pkeeper->heap, alloc_size * sizeof(int));
+	pkeeper->alloc_size = alloc_size;
+
+	int num_slots = 1;
+	while (num_slots < 2 * alloc_size)
+		num_slots <<= 1;
+	free(pkeeper->slots);
+	pkeeper->slots = mlr_malloc_or_die(num_slots * sizeof(int));
+	for (int i = 0; i < num_slots; i++)
+		pkeeper->slots[i] = -1;
+	pkeeper->slots_mask = num_slots - 1;
+	for (int i = 0; i < pkeeper->size; i++)
+		frequent_keeper_insert_slot(pkeeper, i);
+}
+
+static int frequent_keeper_find(frequent_keeper_t* pkeeper, slls_t* pvalues, int hash) {
+	for (int i = hash & pkeeper->slots_mask; pkeeper->slots[i] >= 0; i = (i + 1) & pkeeper->slots_mask) {
+		frequent_keeper_entry_t* pentry = &pkeeper->entries[pkeeper->slots[i]];
+		if (pentry->hash == hash && slls_equals(pentry->pvalues, pvalues))
+			return pkeeper->slots[i];
+	}
+	return -1;
+}
+
+static void frequent_keeper_insert_slot(frequent_keeper_t* pkeeper, int entry_index) {
+	int i = pkeeper->entries[entry_index].hash & pkeeper->slots_mask;
+	while (pkeeper->slots[i] >= 0)
+		i = (i + 1) & pkeeper->slots_mask;
+	pkeeper->slots[i] = entry_index;
+}
+
+// Linear probing without tombstones: after emptying a slot, later entries in the same run move back into it
+// unless that would put them before their ideal slots.
+static void frequent_keeper_remove_slot(frequent_keeper_t* pkeeper, int entry_index) {
+	int mask = pkeeper->slots_mask;
+	int i = pkeeper->entries[entry_index].hash & mask;
+	while (pkeeper->slots[i] != entry_index)
+		i = (i + 1) & mask;
+	for (int j = (i + 1) & mask; pkeeper->slots[j] >= 0; j = (j + 1) & mask) {
+		int ideal = pkeeper->entries[pkeeper->slots[j]].hash & mask;
+		if (((j - ideal) & mask) >= ((j - i) & mask)) {
+			pkeeper->slots[i] = pkeeper->slots[j];
+			i = j;
+		}
+	}
+	pkeeper->slots[i] = -1;
+}
+
+// ----------------------------------------------------------------
+// 0-up: left child 2*i+1, right child 2*i+2, parent (i-1)/2. Each count is at most its children's.
+static inline void frequent_keeper_swap(frequent_keeper_t* pkeeper, int i, int j) {
+	int entry_index = pkeeper->heap[i];
+	pkeeper->heap[i] = pkeeper->heap[j];
+	pkeeper->heap[j] = entry_index;
+	pkeeper->entries[pkeeper->heap[i]].heap_index = i;
+	pkeeper->entries[pkeeper->heap[j]].heap_index = j;
+}
+
+static inline unsigned long long frequent_keeper_heap_count(frequent_keeper_t* pkeeper, int i) {
+	return pkeeper->entries[pkeeper->heap[i]].count;
+}
+
+static void frequent_keeper_sift_up(frequent_keeper_t* pkeeper, int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (frequent_keeper_heap_count(pkeeper, parent) <= frequent_keeper_heap_count(pkeeper, i))
+			break;
+		frequent_keeper_swap(pkeeper, parent, i);
+		i = parent;
+	}
+}
+
+static void frequent_keeper_sift_down(frequent_keeper_t* pkeeper, int i) {
+	int n = pkeeper->size;
+	while (TRUE) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+		if (left < n && frequent_keeper_heap_count(pkeeper, left) < frequent_keeper_heap_count(pkeeper, smallest))
+			smallest = left;
+		if (right < n && frequent_keeper_heap_count(pkeeper, right) < frequent_keeper_heap_count(pkeeper, smallest))
+			smallest = right;
+		if (smallest == i)
+			break;
+		frequent_keeper_swap(pkeeper, smallest, i);
+		i = smallest;
+	}
+}
+
+// ----------------------------------------------------------------
+void frequent_keeper_print(frequent_keeper_t* pkeeper) {
+	printf("frequent_keeper dump: capacity=%d size=%d num_added=%llu\n",
+		pkeeper->capacity, pkeeper->size, pkeeper->num_added);
+	for (int i = 0; i < pkeeper->size; i++) {
+		frequent_keeper_entry_t* pentry = &pkeeper->entries[pkeeper->heap[i]];
+		char* values = slls_join(pentry->pvalues, ",");
+		printf("[%02d] %s count=%llu error=%llu\n", i, values, pentry->count, pentry->error);
+		free(values);
+	}
+}
@@ -0,0 +1,55 @@
+// ================================================================
+// Data structure for mlr most-frequent --approx: the Space-Saving algorithm
+// (Metwally, Agrawal and El Abbadi, 2005) for the most frequent values in a
+// stream, in memory bounded by a fixed capacity.
+//
+// * Up to capacity values are tracked, each with a count. A value already
+//   tracked has its count incremented. A new one, if the keeper is full,
+//   replaces the one with the smallest count, taking over that count plus one,
+//   and noting that count as its error.
+//
+// * A tracked value's true count is between its count less its error, and its
+//   count. Any value seen more than n/capacity times, of n added in all, is
+//   tracked.
+//
+// * Counts are kept in a min-heap, so that finding the value to replace is
+//   O(1) and incrementing is O(log capacity); values are found by an
+//   open-addressed hash table of entry indices.
+// ================================================================
+
+#ifndef FREQUENT_KEEPER_H
+#define FREQUENT_KEEPER_H
+#include "containers/slls.h"
+
+typedef struct _frequent_keeper_entry_t {
+	slls_t*            pvalues;
+	unsigned long long count;
+	unsigned long long error;
+	unsigned long long seq;        // num_added when first tracked
+	int                hash;
+	int                heap_index;
+} frequent_keeper_entry_t;
+
+typedef struct _frequent_keeper_t {
+	int                      capacity;
+	int                      size;
+	int                      alloc_size; // grows up to capacity as needed
+	frequent_keeper_entry_t* entries;
+	int*                     heap;       // entry indices, smallest count at index 0
+	int*                     slots;      // entry indices, -1 for empty
+	int                      slots_mask;
+	unsigned long long       num_added;
+} frequent_keeper_t;
+
+frequent_keeper_t* frequent_keeper_alloc(int capacity);
+void frequent_keeper_free(frequent_keeper_t* pkeeper);
+// The values are copied if kept.
+void frequent_keeper_add(frequent_keeper_t* pkeeper, slls_t* pvalues);
+// An array of pointers to the entries, most frequent first, then least error, then first tracked. The caller
+// should free the array but not the entries.
+frequent_keeper_entry_t** frequent_keeper_sorted_entries(frequent_keeper_t* pkeeper);
+
+// For debug/test
+void frequent_keeper_print(frequent_keeper_t* pkeeper);
+
+#endif // FREQUENT_KEEPER_H
@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/hll_sketch.h"
+
+#define HLL_SKETCH_HASHES_INIT_ALLOC 16
+#define HLL_FNV_PRIME                0x100000001b3ULL
+
+static void hll_sketch_add_hash(hll_sketch_t* psketch, unsigned long long hash);
+static void hll_sketch_make_dense(hll_sketch_t* psketch);
+static void hll_sketch_update_register(hll_sketch_t* psketch, unsigned long long hash);
+
+// ----------------------------------------------------------------
+// FNV-1a, with a zero byte after each value so that e.g. "a","bc" and "ab","c" differ. Its low bits aren't
+// well mixed, so hll_sketch_ingest finishes the hash as MurmurHash3 does.
+unsigned long long hll_hash_string(unsigned long long hash, char* value) {
+	for (unsigned char* p = (unsigned char*)value; *p; p++) {
+		hash ^= *p;
+		hash *= HLL_FNV_PRIME;
+	}
+	return hash * HLL_FNV_PRIME;
+}
+
+static unsigned long long hll_hash_finish(unsigned long long hash) {
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static inline int hll_leading_zeroes(unsigned long long x) {
+#ifdef __GNUC__
+	return __builtin_clzll(x);
+#else
+	int n = 0;
+	while (!(x & 0x8000000000000000ULL)) {
+		x <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+// ----------------------------------------------------------------
+hll_sketch_t* hll_sketch_alloc(int precision) {
+	MLR_INTERNAL_CODING_ERROR_IF(precision < HLL_SKETCH_MIN_PRECISION || precision > HLL_SKETCH_MAX_PRECISION);
+	hll_sketch_t* psketch = mlr_malloc_or_die(sizeof(hll_sketch_t));
+	psketch->precision         = precision;
+	psketch->num_registers     = 1 << precision;
+	psketch->registers         = NULL;
+	psketch->hashes            = mlr_malloc_or_die(HLL_SKETCH_HASHES_INIT_ALLOC * sizeof(unsigned long long));
+	psketch->num_hashes        = 0;
+	psketch->hashes_alloc_size = HLL_SKETCH_HASHES_INIT_ALLOC;
+	memset(psketch->hashes, 0, HLL_SKETCH_HASHES_INIT_ALLOC * sizeof(unsigned long long));
+	return psketch;
+}
+
+void hll_sketch_free(hll_sketch_t* psketch) {
+	if (psketch == NULL)
+		return;
+	free(psketch->registers);
+	free(psketch->hashes);
+	free(psketch);
+}
+
+// ----------------------------------------------------------------
+void hll_sketch_ingest(hll_sketch_t* psketch, unsigned long long hash) {
+	hash = hll_hash_finish(hash);
+	if (psketch->registers != NULL)
+		hll_sketch_update_register(psketch, hash);
+	else
+		hll_sketch_add_hash(psketch, hash == 0LL ? 1LL : hash);
+}
+
+void hll_sketch_put_hash(hll_sketch_t* psketch, unsigned long long hash) {
+	if (psketch->registers != NULL)
+		hll_sketch_update_register(psketch, hash);
+	else
+		hll_sketch_add_hash(psketch, hash);
+}
+
+void hll_sketch_put_register(hll_sketch_t* psketch, int index, int value) {
+	if (psketch->registers == NULL)
+		hll_sketch_make_dense(psketch);
+	if (value > psketch->registers[index])
+		psketch->registers[index] = value;
+}
+
+// ----------------------------------------------------------------
+void hll_sketch_merge(hll_sketch_t* pdst, hll_sketch_t* psrc) {
+	MLR_INTERNAL_CODING_ERROR_IF(pdst->precision != psrc->precision);
+	if (psrc->registers == NULL) {
+		for (int i = 0; i < psrc->hashes_alloc_size; i++)
+			if (psrc->hashes[i] != 0LL)
+				hll_sketch_put_hash(pdst, psrc->hashes[i]);
+	} else {
+		if (pdst->registers == NULL)
+			hll_sketch_make_dense(pdst);
+		for (int i = 0; i < pdst->num_registers; i++)
+			if (psrc->registers[i] > pdst->registers[i])
+				pdst->registers[i] = psrc->registers[i];
+	}
+}
+
+// ----------------------------------------------------------------
+// Open addressing with linear probing, at most half full.
+static void hll_sketch_add_hash(hll_sketch_t* psketch, unsigned long long hash) {
+	int mask = psketch->hashes_alloc_size - 1;
+	int i = hash & mask;
+	while (psketch->hashes[i] != 0LL) {
+		if (psketch->hashes[i] == hash)
+			return;
+		i = (i + 1) & mask;
+	}
+	psketch->hashes[i] = hash;
+	psketch->num_hashes++;
+
+	if (psketch->num_hashes > psketch->num_registers / 16) {
+		hll_sketch_make_dense(psketch);
+	} else if (2 * psketch->num_hashes >= psketch->hashes_alloc_size) {
+		unsigned long long* old_hashes = psketch->hashes;
+		int old_alloc_size = psketch->hashes_alloc_size;
+		psketch->hashes_alloc_size *= 2;
+		psketch->hashes = mlr_malloc_or_die(psketch->hashes_alloc_size * sizeof(unsigned long long));
+		memset(psketch->hashes, 0, psketch->hashes_alloc_size * sizeof(unsigned long long));
+		psketch->num_hashes = 0;
+		for (i = 0; i < old_alloc_size; i++)
+			if (old_hashes[i] != 0LL)
+				hll_sketch_add_hash(psketch, old_hashes[i]);
+		free(old_hashes);
+	}
+}
+
+static void hll_sketch_make_dense(hll_sketch_t* psketch) {
+	psketch->registers = mlr_malloc_or_die(psketch->num_registers);
+	memset(psketch->registers, 0, psketch->num_registers);
+	for (int i = 0; i < psketch->hashes_alloc_size; i++)
+		if (psketch->hashes[i] != 0LL)
+			hll_sketch_update_register(psketch, psketch->hashes[i]);
+	free(psketch->hashes);
+	psketch->hashes = NULL;
+	psketch->num_hashes = 0;
+	psketch->hashes_alloc_size = 0;
+}
+
+// The top p bits are the register index. The rest, shifted up, have at most 64-p leading zeroes.
+static void hll_sketch_update_register(hll_sketch_t* psketch, unsigned long long hash) {
+	int index = hash >> (64 - psketch->precision);
+	unsigned long long rest = hash << psketch->precision;
+	int value = (rest == 0LL) ? 64 - psketch->precision + 1 : hll_leading_zeroes(rest) + 1;
+	if (value > psketch->registers[index])
+		psketch->registers[index] = value;
+}
+
+// ----------------------------------------------------------------
+// Ertl's sigma and tau functions, for the registers still at zero and those at the maximum.
+static double hll_sigma(double x) {
+	if (x == 1.0)
+		return INFINITY;
+	double y = 1.0;
+	double z = x;
+	double zprev;
+	do {
+		x *= x;
+		zprev = z;
+		z += x * y;
+		y += y;
+	} while (z != zprev);
+	return z;
+}
+
+static double hll_tau(double x) {
+	if (x == 0.0 || x == 1.0)
+		return 0.0;
+	double y = 1.0;
+	double z = 1.0 - x;
+	double zprev;
+	do {
+		x = sqrt(x);
+		zprev = z;
+		y *= 0.5;
+		z -= (1.0 - x) * (1.0 - x) * y;
+	} while (z != zprev);
+	return z / 3.0;
+}
+
+unsigned long long hll_sketch_estimate(hll_sketch_t* psketch) {
+	if (psketch->registers == NULL)
+		return psketch->num_hashes;
+
+	int q = 64 - psketch->precision;
+	int counts[64 + 2];
+	memset(counts, 0, sizeof(counts));
+	for (int i = 0; i < psketch->num_registers; i++)
+		counts[psketch->registers[i]]++;
+
+	double m = psketch->num_registers;
+	double z = m * hll_tau(1.0 - counts[q+1] / m);
+	for (int k = q; k >= 1; k--)
+		z = 0.5 * (z + counts[k]);
+	z += m * hll_sigma(counts[0] / m);
+	double alpha_infinity = 0.5 / log(2.0);
+	return (unsigned long long)llround(alpha_infinity * m * m / z);
+}
+
+// ----------------------------------------------------------------
+void hll_sketch_print(hll_sketch_t* psketch) {
+	printf("hll_sketch dump: precision=%d estimate=%llu\n", psketch->precision, hll_sketch_estimate(psketch));
+	if (psketch->registers == NULL) {
+		printf("hashes (%d):", psketch->num_hashes);
+		for (int i = 0; i < psketch->hashes_alloc_size; i++)
+			if (psketch->hashes[i] != 0LL)
+				printf(" %016llx", psketch->hashes[i]);
+		printf("\n");
+	} else {
+		printf("registers:");
+		for (int i = 0; i < psketch->num_registers; i++)
+			printf(" %d", psketch->registers[i]);
+		printf("\n");
+	}
+}
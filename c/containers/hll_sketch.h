@@ -0,0 +1,59 @@
+// ================================================================
+// For mlr count-distinct --approx: a HyperLogLog sketch (Flajolet et al.,
+// 2007) with the sparse start of HLL++ (Heule, Nunkesser and Hall, 2013).
+//
+// * Values are reduced to 64-bit hashes. The top p bits of a hash pick one of
+//   m = 2^p registers, which keeps the most leading zeroes seen in the rest of
+//   the hashes it was picked for, plus one.
+//
+// * Until there are more than m/16 distinct hashes, the hashes themselves are
+//   kept instead of the registers, so small counts are exact (up to hash
+//   collisions) and take little memory.
+//
+// * The estimate is Ertl's improved one ("New cardinality estimation
+//   algorithms for HyperLogLog sketches", 2017), which needs no bias-correction
+//   tables. Its relative standard error is about 1.04/sqrt(m): 0.8% for the
+//   default p = 14, at 16KB per sketch.
+//
+// * Sketches fed separate parts of an input stream, with the same precision,
+//   can be merged, and the result is as if one sketch had seen all of it.
+// ================================================================
+
+#ifndef HLL_SKETCH_H
+#define HLL_SKETCH_H
+
+#define HLL_SKETCH_MIN_PRECISION      4
+#define HLL_SKETCH_MAX_PRECISION     18
+#define HLL_SKETCH_DEFAULT_PRECISION 14
+
+// For hashing several strings as one value: start from HLL_HASH_INIT and fold each in.
+#define HLL_HASH_INIT 0xcbf29ce484222325ULL
+unsigned long long hll_hash_string(unsigned long long hash, char* value);
+
+typedef struct _hll_sketch_t {
+	int                 precision;
+	int                 num_registers;
+	unsigned char*      registers;    // NULL until there are too many hashes to keep
+	unsigned long long* hashes;       // open-addressed, zero for empty
+	int                 num_hashes;
+	int                 hashes_alloc_size;
+} hll_sketch_t;
+
+hll_sketch_t* hll_sketch_alloc(int precision);
+void hll_sketch_free(hll_sketch_t* psketch);
+// Hashes from hll_hash_string.
+void hll_sketch_ingest(hll_sketch_t* psketch, unsigned long long hash);
+// Same as if psrc's values had been ingested by pdst. Leaves psrc as it was.
+void hll_sketch_merge(hll_sketch_t* pdst, hll_sketch_t* psrc);
+unsigned long long hll_sketch_estimate(hll_sketch_t* psketch);
+
+// For saving and restoring state. A sketch has either its registers or its hashes; the hashes are those
+// in the nonzero slots of the hashes array. A register value may be put into a sketch holding hashes,
+// which it then folds into registers.
+void hll_sketch_put_hash(hll_sketch_t* psketch, unsigned long long hash);
+void hll_sketch_put_register(hll_sketch_t* psketch, int index, int value);
+
+// For debug/test
+void hll_sketch_print(hll_sketch_t* psketch);
+
+#endif // HLL_SKETCH_H
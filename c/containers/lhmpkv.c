@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/lhmpkv.h"
+
+#define LHMPKV_INITIAL_ARRAY_LENGTH 16
+
+static void lhmpkv_enlarge(lhmpkv_t* pmap);
+
+// ----------------------------------------------------------------
+static lhmpkv_slot_t* lhmpkv_alloc_slots(int array_length) {
+	lhmpkv_slot_t* slots = mlr_malloc_or_die(array_length * sizeof(lhmpkv_slot_t));
+	memset(slots, 0, array_length * sizeof(lhmpkv_slot_t));
+	return slots;
+}
+
+lhmpkv_t* lhmpkv_alloc() {
+	lhmpkv_t* pmap = mlr_malloc_or_die(sizeof(lhmpkv_t));
+	pmap->num_occupied = 0;
+	pmap->array_length = LHMPKV_INITIAL_ARRAY_LENGTH;
+	pmap->slots        = lhmpkv_alloc_slots(LHMPKV_INITIAL_ARRAY_LENGTH);
+	pmap->phead        = NULL;
+	pmap->ptail        = NULL;
+	return pmap;
+}
+
+void lhmpkv_free(lhmpkv_t* pmap) {
+	if (pmap == NULL)
+		return;
+	for (lhmpkve_t* pe = pmap->phead; pe != NULL; ) {
+		lhmpkve_t* pnext = pe->pnext;
+		free(pe);
+		pe = pnext;
+	}
+	free(pmap->slots);
+	free(pmap);
+}
+
+// ----------------------------------------------------------------
+// Returns the slot holding the key, or the empty one where it would go.
+static lhmpkv_slot_t* lhmpkv_find_slot(lhmpkv_t* pmap, packed_key_t* pkey) {
+	int mask = pmap->array_length - 1;
+	for (int index = pkey->hash & mask; ; index = (index + 1) & mask) {
+		lhmpkv_slot_t* pslot = &pmap->slots[index];
+		if (pslot->pentry == NULL)
+			return pslot;
+		if (pslot->hash == pkey->hash && packed_key_equals(pslot->pentry->key, pkey))
+			return pslot;
+	}
+}
+
+void* lhmpkv_get(lhmpkv_t* pmap, packed_key_t* pkey) {
+	lhmpkv_slot_t* pslot = lhmpkv_find_slot(pmap, pkey);
+	return (pslot->pentry == NULL) ? NULL : pslot->pentry->pvvalue;
+}
+
+// ----------------------------------------------------------------
+// The entry, its key struct and the key's bytes are one allocation.
+lhmpkve_t* lhmpkv_put(lhmpkv_t* pmap, packed_key_t* pkey, void* pvvalue) {
+	lhmpkv_slot_t* pslot = lhmpkv_find_slot(pmap, pkey);
+	if (pslot->pentry != NULL) {
+		pslot->pentry->pvvalue = pvvalue;
+		return pslot->pentry;
+	}
+
+	lhmpkve_t* pe = mlr_malloc_or_die(sizeof(lhmpkve_t) + sizeof(packed_key_t) + pkey->length);
+	packed_key_t* pcopy = (packed_key_t*)(pe + 1);
+	pcopy->bytes        = (char*)(pcopy + 1);
+	pcopy->length       = pkey->length;
+	pcopy->alloc_length = 0;
+	pcopy->num_values   = pkey->num_values;
+	pcopy->hash         = pkey->hash;
+	memcpy(pcopy->bytes, pkey->bytes, pkey->length);
+	pe->key     = pcopy;
+	pe->pvvalue = pvvalue;
+	pe->pnext   = NULL;
+
+	if (pmap->ptail == NULL)
+		pmap->phead = pe;
+	else
+		pmap->ptail->pnext = pe;
+	pmap->ptail = pe;
+
+	pslot->hash = pkey->hash;
+	pslot->pentry = pe;
+	pmap->num_occupied++;
+	if (2 * pmap->num_occupied > pmap->array_length)
+		lhmpkv_enlarge(pmap);
+	return pe;
+}
+
+// Keeps the table at most half full.
+static void lhmpkv_enlarge(lhmpkv_t* pmap) {
+	free(pmap->slots);
+	pmap->array_length *= 2;
+	pmap->slots = lhmpkv_alloc_slots(pmap->array_length);
+	int mask = pmap->array_length - 1;
+	for (lhmpkve_t* pe = pmap->phead; pe != NULL; pe = pe->pnext) {
+		int index = pe->key->hash & mask;
+		while (pmap->slots[index].pentry != NULL)
+			index = (index + 1) & mask;
+		pmap->slots[index].hash = pe->key->hash;
+		pmap->slots[index].pentry = pe;
+	}
+}
@@ -0,0 +1,50 @@
+// ================================================================
+// Packed-key-to-void-star insertion-ordered hash map, for the grouping verbs.
+// See packed_key.h.
+//
+// * Lookups take a finished packed key, typically the verb's scratch key for
+//   the current record. Puts copy the key, along with the entry, into a
+//   single allocation, so entries and their keys never move.
+//
+// * The table is open-addressed with linear probing, and holds the keys'
+//   hashes alongside the entry pointers so that most probes for other keys
+//   are rejected without touching the entries.
+//
+// * Iterate in insertion order with
+//   for (lhmpkve_t* pe = pmap->phead; pe != NULL; pe = pe->pnext).
+//
+// * There is no removal.
+// ================================================================
+
+#ifndef LHMPKV_H
+#define LHMPKV_H
+
+#include "containers/packed_key.h"
+
+typedef struct _lhmpkve_t {
+	packed_key_t*      key;
+	void*              pvvalue;
+	struct _lhmpkve_t* pnext;
+} lhmpkve_t;
+
+typedef struct _lhmpkv_slot_t {
+	unsigned long long hash;
+	lhmpkve_t*         pentry; // NULL if empty
+} lhmpkv_slot_t;
+
+typedef struct _lhmpkv_t {
+	int            num_occupied;
+	int            array_length;
+	lhmpkv_slot_t* slots;
+	lhmpkve_t*     phead;
+	lhmpkve_t*     ptail;
+} lhmpkv_t;
+
+lhmpkv_t*  lhmpkv_alloc();
+// Void-star payloads should first be freed by the caller.
+void       lhmpkv_free(lhmpkv_t* pmap);
+void*      lhmpkv_get(lhmpkv_t* pmap, packed_key_t* pkey);
+// Copies the key if it's new, else replaces the value. Returns the entry, whose key is the map's copy.
+lhmpkve_t* lhmpkv_put(lhmpkv_t* pmap, packed_key_t* pkey, void* pvvalue);
+
+#endif // LHMPKV_H
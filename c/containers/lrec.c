@@ -57,6 +57,14 @@ lrec_t* lrec_csv_alloc(char* data_line) {
 	return prec;
 }
 
+lrec_t* lrec_bin_alloc(char* payload) {
+	lrec_t* prec = mlr_malloc_or_die(sizeof(lrec_t));
+	memset(prec, 0, sizeof(lrec_t));
+	prec->psingle_line = payload;
+	prec->pfree_backing_func = lrec_free_single_line_backing;
+	return prec;
+}
+
 lrec_t* lrec_xtab_alloc(slls_t* pxtab_lines) {
 	lrec_t* prec = mlr_malloc_or_die(sizeof(lrec_t));
 	memset(prec, 0, sizeof(lrec_t));
@@ -65,6 +73,12 @@ lrec_t* lrec_xtab_alloc(slls_t* pxtab_lines) {
 	return prec;
 }
 
+void lrec_set_single_line_backing(lrec_t* prec, char* line) {
+	MLR_INTERNAL_CODING_ERROR_IF(prec->pfree_backing_func != lrec_unbacked_free);
+	prec->psingle_line = line;
+	prec->pfree_backing_func = lrec_free_single_line_backing;
+}
+
 // ----------------------------------------------------------------
 static void lrec_free_contents(lrec_t* prec) {
 	for (lrece_t* pe = prec->phead; pe != NULL; /*pe = pe->pnext*/) {
@@ -143,6 +157,15 @@ void lrec_put(lrec_t* prec, char* key, char* value, char free_flags) {
 	}
 }
 
+void lrec_put_new_key(lrec_t* prec, char* key, char* value, char free_flags) {
+	lrece_t* pe = mlr_malloc_or_die(sizeof(lrece_t));
+	pe->key         = key;
+	pe->value       = value;
+	pe->free_flags  = free_flags;
+	pe->quote_flags = 0;
+	lrec_link_at_tail(prec, pe);
+}
+
 void lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
 
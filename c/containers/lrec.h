@@ -81,7 +81,7 @@ struct _lrec_t {
 	// freed at lrec_free().
 
 	// E.g. for NIDX, DKVP, and CSV formats (header handled separately in the
-	// latter case).
+	// latter case), and the stdio reader for the binary format.
 	char* psingle_line;
 
 	// For XTAB format.
@@ -99,6 +99,10 @@ lrec_t* lrec_nidx_alloc(char* line);
 lrec_t* lrec_csvlite_alloc(char* data_line);
 lrec_t* lrec_csv_alloc(char* data_line);
 lrec_t* lrec_xtab_alloc(slls_t* pxtab_lines);
+lrec_t* lrec_bin_alloc(char* payload);
+// For a record whose keys and values were put in as pointers into a line, e.g. by an mmap reader parsing a
+// copy of part of a file: has lrec_free free the line as well.
+void lrec_set_single_line_backing(lrec_t* prec, char* line);
 
 void lrec_clear(lrec_t* prec);
 void  lrec_free(lrec_t* prec);
@@ -123,6 +127,8 @@ lrec_t* lrec_copy(lrec_t* pinrec);
 //     free the memory (else, there will be a memory leak).
 void  lrec_put(lrec_t* prec, char* key, char* value, char free_flags);
 void  lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags);
+// Like lrec_put, for a key the caller knows isn't in the record already: it's appended without a key scan.
+void  lrec_put_new_key(lrec_t* prec, char* key, char* value, char free_flags);
 // Like lrec_put: if key is present, modify value. But if not, add new field at start of record, not at end.
 void  lrec_prepend(lrec_t* prec, char* key, char* value, char free_flags);
 // Like lrec_put: if key is present, modify value. But if not, add new field after specified entry, not at end.
@@ -37,8 +37,6 @@
 
 // ================================================================
 static int  mlhmmv_hash_func(mv_t* plevel_key);
-static void json_decimal_print       (FILE* ostream, char* s);
-static void json_print_string_escaped(FILE* ostream, char* s);
 
 // ----------------------------------------------------------------
 static void mlhmmv_level_init(mlhmmv_level_t  *plevel, int length);
@@ -155,7 +153,7 @@ void mlhmmv_print_terminal(mv_t* pmv, int quote_keys_always, int quote_values_al
 // we make it JSON-compliant.
 //
 // Precondition: the caller has already checked that the string represents a number.
-static void json_decimal_print(FILE* ostream, char* s) {
+void json_decimal_print(FILE* ostream, char* s) {
 	if (s[0] == '.') {
 		fprintf(ostream, "0%s", s);
 	} else if (s[0] == '-' && s[1] == '.') {
@@ -165,7 +163,7 @@ static void json_decimal_print(FILE* ostream, char* s) {
 	}
 }
 
-static void json_print_string_escaped(FILE* ostream, char* s) {
+void json_print_string_escaped(FILE* ostream, char* s) {
 	fputc('"', ostream);
 	for (char* p = s; *p; p++) {
 		char c = *p;
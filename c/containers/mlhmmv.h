@@ -30,6 +30,11 @@
 // ----------------------------------------------------------------
 void mlhmmv_print_terminal(mv_t* pmv, int quote_keys_always, int quote_values_always, FILE* ostream);
 
+// Also used by the lrec-to-JSON writer. The former's precondition is that the
+// caller has already checked that the string represents a number.
+void json_decimal_print(FILE* ostream, char* s);
+void json_print_string_escaped(FILE* ostream, char* s);
+
 // ----------------------------------------------------------------
 struct _mlhmmv_level_t; // forward reference
 
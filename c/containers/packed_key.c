@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/packed_key.h"
+
+#define PACKED_KEY_INIT_ALLOC_LENGTH 64
+#define PACKED_KEY_HASH_MULTIPLIER   0x9e3779b97f4a7c15ULL
+
+// ----------------------------------------------------------------
+packed_key_t* packed_key_alloc() {
+	packed_key_t* pkey = mlr_malloc_or_die(sizeof(packed_key_t));
+	pkey->bytes        = mlr_malloc_or_die(PACKED_KEY_INIT_ALLOC_LENGTH);
+	pkey->length       = 0;
+	pkey->alloc_length = PACKED_KEY_INIT_ALLOC_LENGTH;
+	pkey->num_values   = 0;
+	pkey->hash         = 0LL;
+	return pkey;
+}
+
+void packed_key_free(packed_key_t* pkey) {
+	if (pkey == NULL)
+		return;
+	if (pkey->alloc_length > 0)
+		free(pkey->bytes);
+	free(pkey);
+}
+
+void packed_key_clear(packed_key_t* pkey) {
+	pkey->length = 0;
+	pkey->num_values = 0;
+}
+
+// ----------------------------------------------------------------
+void packed_key_append(packed_key_t* pkey, char* value) {
+	int value_length = strlen(value);
+	int new_length = pkey->length + sizeof(int) + value_length + 1;
+	if (new_length > pkey->alloc_length) {
+		int alloc_length = 2 * pkey->alloc_length;
+		if (alloc_length < new_length)
+			alloc_length = new_length;
+		pkey->bytes = mlr_realloc_or_die(pkey->bytes, alloc_length);
+		pkey->alloc_length = alloc_length;
+	}
+	char* p = pkey->bytes + pkey->length;
+	memcpy(p, &value_length, sizeof(int));
+	memcpy(p + sizeof(int), value, value_length + 1);
+	pkey->length = new_length;
+	pkey->num_values++;
+}
+
+// A word at a time, multiplying and folding, then finished as MurmurHash3 does so that the low bits, which
+// lhmpkv uses for its table index, depend on all the input.
+void packed_key_finish(packed_key_t* pkey) {
+	unsigned long long hash = pkey->length * PACKED_KEY_HASH_MULTIPLIER;
+	unsigned long long word;
+	char* p = pkey->bytes;
+	char* end = pkey->bytes + pkey->length;
+	for ( ; p + sizeof(word) <= end; p += sizeof(word)) {
+		memcpy(&word, p, sizeof(word));
+		hash = (hash ^ word) * PACKED_KEY_HASH_MULTIPLIER;
+		hash ^= hash >> 32;
+	}
+	if (p < end) {
+		word = 0LL;
+		memcpy(&word, p, end - p);
+		hash = (hash ^ word) * PACKED_KEY_HASH_MULTIPLIER;
+		hash ^= hash >> 32;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	pkey->hash = hash;
+}
+
+// ----------------------------------------------------------------
+int packed_key_fill_from_record(packed_key_t* pkey, lrec_t* prec, slls_t* pfield_names) {
+	packed_key_clear(pkey);
+	for (sllse_t* pe = pfield_names->phead; pe != NULL; pe = pe->pnext) {
+		char* value = lrec_get(prec, pe->value);
+		if (value == NULL)
+			return FALSE;
+		packed_key_append(pkey, value);
+	}
+	packed_key_finish(pkey);
+	return TRUE;
+}
+
+void packed_key_fill_from_slls(packed_key_t* pkey, slls_t* pvalues) {
+	packed_key_clear(pkey);
+	for (sllse_t* pe = pvalues->phead; pe != NULL; pe = pe->pnext)
+		packed_key_append(pkey, pe->value);
+	packed_key_finish(pkey);
+}
+
+slls_t* packed_key_to_slls(packed_key_t* pkey) {
+	slls_t* pvalues = slls_alloc();
+	for (char* value = packed_key_first(pkey); value != NULL; value = packed_key_next(pkey, value))
+		slls_append_no_free(pvalues, value);
+	return pvalues;
+}
@@ -0,0 +1,61 @@
+// ================================================================
+// Group-by keys for the grouping verbs: field values packed into one buffer,
+// each as its length (an int), then its bytes, then a NUL, with a 64-bit hash
+// of the whole buffer.
+//
+// * Verbs fill one scratch key per record, reusing its buffer, and look it up
+//   in an lhmpkv, which copies it only when the group is new. So an existing
+//   group costs no allocation.
+//
+// * Values can be used in place as C strings: see packed_key_first and
+//   packed_key_next.
+//
+// * The length prefixes keep e.g. "a","bc" and "ab","c" distinct.
+// ================================================================
+
+#ifndef PACKED_KEY_H
+#define PACKED_KEY_H
+
+#include <string.h>
+#include "containers/slls.h"
+#include "containers/lrec.h"
+
+typedef struct _packed_key_t {
+	char*              bytes;
+	int                length;
+	int                alloc_length; // zero if the bytes aren't separately allocated, as in lhmpkv entries
+	int                num_values;
+	unsigned long long hash;         // set by packed_key_finish
+} packed_key_t;
+
+packed_key_t* packed_key_alloc();
+void packed_key_free(packed_key_t* pkey);
+void packed_key_clear(packed_key_t* pkey);
+void packed_key_append(packed_key_t* pkey, char* value);
+// Computes the hash. Needed after appending and before lookup.
+void packed_key_finish(packed_key_t* pkey);
+// Clears the key, appends the values of the given fields and finishes it; or returns FALSE if the record
+// lacks any of them.
+int packed_key_fill_from_record(packed_key_t* pkey, lrec_t* prec, slls_t* pfield_names);
+void packed_key_fill_from_slls(packed_key_t* pkey, slls_t* pvalues);
+// The list's values point into the key.
+slls_t* packed_key_to_slls(packed_key_t* pkey);
+
+// Iteration over the values:
+// for (char* value = packed_key_first(pkey); value != NULL; value = packed_key_next(pkey, value))
+static inline char* packed_key_first(packed_key_t* pkey) {
+	return (pkey->length == 0) ? NULL : pkey->bytes + sizeof(int);
+}
+
+static inline char* packed_key_next(packed_key_t* pkey, char* value) {
+	int value_length;
+	memcpy(&value_length, value - sizeof(int), sizeof(int));
+	char* pnext = value + value_length + 1;
+	return (pnext >= pkey->bytes + pkey->length) ? NULL : pnext + sizeof(int);
+}
+
+static inline int packed_key_equals(packed_key_t* pa, packed_key_t* pb) {
+	return pa->hash == pb->hash && pa->length == pb->length && memcmp(pa->bytes, pb->bytes, pa->length) == 0;
+}
+
+#endif // PACKED_KEY_H
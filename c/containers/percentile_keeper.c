@@ -4,17 +4,25 @@
 #include "containers/percentile_keeper.h"
 #include "lib/mvfuncs.h"
 
-#define INITIAL_CAPACITY 10000
+#define INITIAL_CAPACITY 16
 #define GROWTH_FACTOR    2.0
 
+// Below this, ranges being selected in are insertion-sorted.
+#define SELECT_INSERTION_THRESHOLD 16
+
 // ----------------------------------------------------------------
 percentile_keeper_t* percentile_keeper_alloc() {
-	unsigned long long capacity = INITIAL_CAPACITY;
 	percentile_keeper_t* ppercentile_keeper = mlr_malloc_or_die(sizeof(percentile_keeper_t));
-	ppercentile_keeper->data     = mlr_malloc_or_die(capacity*sizeof(mv_t));
-	ppercentile_keeper->size     = 0LL;
-	ppercentile_keeper->capacity = capacity;
-	ppercentile_keeper->sorted   = FALSE;
+	ppercentile_keeper->storage        = PERCENTILE_KEEPER_EMPTY;
+	ppercentile_keeper->ints           = NULL;
+	ppercentile_keeper->floats         = NULL;
+	ppercentile_keeper->data           = NULL;
+	ppercentile_keeper->size           = 0LL;
+	ppercentile_keeper->capacity       = 0LL;
+	ppercentile_keeper->fixed_indices  = NULL;
+	ppercentile_keeper->num_fixed      = 0;
+	ppercentile_keeper->fixed_capacity = 0;
+	ppercentile_keeper->permuted       = FALSE;
 	return ppercentile_keeper;
 }
 
@@ -22,10 +30,15 @@ percentile_keeper_t* percentile_keeper_alloc() {
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper) {
 	if (ppercentile_keeper == NULL)
 		return;
-	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
-		mv_free(&ppercentile_keeper->data[i]);
+	if (ppercentile_keeper->data != NULL) {
+		for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
+			mv_free(&ppercentile_keeper->data[i]);
+		}
 	}
+	free(ppercentile_keeper->ints);
+	free(ppercentile_keeper->floats);
 	free(ppercentile_keeper->data);
+	free(ppercentile_keeper->fixed_indices);
 	ppercentile_keeper->data = NULL;
 	ppercentile_keeper->size = 0LL;
 	ppercentile_keeper->capacity = 0LL;
@@ -33,14 +46,84 @@ void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper) {
 }
 
 // ----------------------------------------------------------------
+// On the first value not of the type so far, the values so far are copied out as mv_t's.
+static void percentile_keeper_make_mixed(percentile_keeper_t* ppercentile_keeper) {
+	mv_t* data = mlr_malloc_or_die(ppercentile_keeper->capacity * sizeof(mv_t));
+	if (ppercentile_keeper->storage == PERCENTILE_KEEPER_INTS) {
+		for (unsigned long long i = 0; i < ppercentile_keeper->size; i++)
+			data[i] = mv_from_int(ppercentile_keeper->ints[i]);
+	} else if (ppercentile_keeper->storage == PERCENTILE_KEEPER_FLOATS) {
+		for (unsigned long long i = 0; i < ppercentile_keeper->size; i++)
+			data[i] = mv_from_float(ppercentile_keeper->floats[i]);
+	}
+	free(ppercentile_keeper->ints);
+	free(ppercentile_keeper->floats);
+	ppercentile_keeper->ints = NULL;
+	ppercentile_keeper->floats = NULL;
+	ppercentile_keeper->data = data;
+	ppercentile_keeper->storage = PERCENTILE_KEEPER_MIXED;
+}
+
 void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value) {
+	if (ppercentile_keeper->storage == PERCENTILE_KEEPER_EMPTY) {
+		ppercentile_keeper->capacity = INITIAL_CAPACITY;
+		if (value.type == MT_INT) {
+			ppercentile_keeper->ints = mlr_malloc_or_die(ppercentile_keeper->capacity * sizeof(long long));
+			ppercentile_keeper->storage = PERCENTILE_KEEPER_INTS;
+		} else if (value.type == MT_FLOAT) {
+			ppercentile_keeper->floats = mlr_malloc_or_die(ppercentile_keeper->capacity * sizeof(double));
+			ppercentile_keeper->storage = PERCENTILE_KEEPER_FLOATS;
+		} else {
+			ppercentile_keeper->data = mlr_malloc_or_die(ppercentile_keeper->capacity * sizeof(mv_t));
+			ppercentile_keeper->storage = PERCENTILE_KEEPER_MIXED;
+		}
+	} else if ((ppercentile_keeper->storage == PERCENTILE_KEEPER_INTS && value.type != MT_INT)
+		|| (ppercentile_keeper->storage == PERCENTILE_KEEPER_FLOATS && value.type != MT_FLOAT))
+	{
+		percentile_keeper_make_mixed(ppercentile_keeper);
+	}
+
 	if (ppercentile_keeper->size >= ppercentile_keeper->capacity) {
 		ppercentile_keeper->capacity = (unsigned long long)(ppercentile_keeper->capacity * GROWTH_FACTOR);
-		ppercentile_keeper->data = (mv_t*)mlr_realloc_or_die(ppercentile_keeper->data,
-			ppercentile_keeper->capacity*sizeof(mv_t));
+		switch (ppercentile_keeper->storage) {
+		case PERCENTILE_KEEPER_INTS:
+			ppercentile_keeper->ints = mlr_realloc_or_die(ppercentile_keeper->ints,
+				ppercentile_keeper->capacity*sizeof(long long));
+			break;
+		case PERCENTILE_KEEPER_FLOATS:
+			ppercentile_keeper->floats = mlr_realloc_or_die(ppercentile_keeper->floats,
+				ppercentile_keeper->capacity*sizeof(double));
+			break;
+		default:
+			ppercentile_keeper->data = mlr_realloc_or_die(ppercentile_keeper->data,
+				ppercentile_keeper->capacity*sizeof(mv_t));
+			break;
+		}
+	}
+	switch (ppercentile_keeper->storage) {
+	case PERCENTILE_KEEPER_INTS:
+		ppercentile_keeper->ints[ppercentile_keeper->size++] = value.u.intv;
+		break;
+	case PERCENTILE_KEEPER_FLOATS:
+		ppercentile_keeper->floats[ppercentile_keeper->size++] = value.u.fltv;
+		break;
+	default:
+		ppercentile_keeper->data[ppercentile_keeper->size++] = value;
+		break;
+	}
+	ppercentile_keeper->num_fixed = 0;
+}
+
+// ----------------------------------------------------------------
+mv_t percentile_keeper_get(percentile_keeper_t* ppercentile_keeper, unsigned long long i) {
+	switch (ppercentile_keeper->storage) {
+	case PERCENTILE_KEEPER_INTS:
+		return mv_from_int(ppercentile_keeper->ints[i]);
+	case PERCENTILE_KEEPER_FLOATS:
+		return mv_from_float(ppercentile_keeper->floats[i]);
+	default:
+		return ppercentile_keeper->data[i];
 	}
-	ppercentile_keeper->data[ppercentile_keeper->size++] = value;
-	ppercentile_keeper->sorted = FALSE;
 }
 
 // ================================================================
@@ -225,23 +308,117 @@ static unsigned long long compute_index_non_interpolated(unsigned long long n, d
 	return (unsigned long long)index;
 }
 
-static mv_t get_percentile_linearly_interpolated(mv_t* array, unsigned long long n, double p) {
-	double findex = (p/100.0)*(n-1);
-	if (findex < 0)
-		findex = 0;
-	unsigned long long iindex = (unsigned long long)floor(findex);
-	if (iindex >= n-1) {
-		return array[iindex];
-	} else {
-		// array[iindex] + frac * (array[iindex+1] - array[iindex]);
-		mv_t frac = mv_from_float(findex - iindex);
-		mv_t* pa = &array[iindex];
-		mv_t* pb = &array[iindex+1];
-		mv_t diff = x_xx_minus_func(pb, pa);
-		mv_t prod = x_xx_times_func(&frac, &diff);
-		mv_t rv = x_xx_plus_func(pa, &prod);
-		return rv;
+// ----------------------------------------------------------------
+// Introselect: quickselect with median-of-three pivots, falling back to heapsort if partitioning goes
+// badly, which bounds the worst case at O(n log n). Hoare partitioning stops on equal values, so runs of
+// duplicates split evenly, and with pivots taken from the range it stays in bounds even for NaNs. The
+// same for each storage type, with the comparison inlined.
+#define PERCENTILE_KEEPER_DEFINE_SELECT(name, type, less) \
+static void name##_heapsort(type* a, long long n) { \
+	for (long long start = n/2 - 1, end = n; end > 1; ) { \
+		long long i; \
+		if (start >= 0) { \
+			i = start--; \
+		} else { \
+			end--; \
+			type t = a[0]; a[0] = a[end]; a[end] = t; \
+			i = 0; \
+		} \
+		while (2*i + 1 < end) { \
+			long long child = 2*i + 1; \
+			if (child + 1 < end && less(a[child], a[child + 1])) \
+				child++; \
+			if (!less(a[i], a[child])) \
+				break; \
+			type t = a[i]; a[i] = a[child]; a[child] = t; \
+			i = child; \
+		} \
+	} \
+} \
+static void name(type* a, long long lo, long long hi, long long k) { \
+	int depth_limit = 2; \
+	for (long long m = hi - lo + 1; m > 1; m >>= 1) \
+		depth_limit += 2; \
+	while (hi - lo >= SELECT_INSERTION_THRESHOLD) { \
+		if (depth_limit-- == 0) { \
+			name##_heapsort(&a[lo], hi - lo + 1); \
+			return; \
+		} \
+		long long mid = lo + (hi - lo) / 2; \
+		type t; \
+		if (less(a[mid], a[lo])) { t = a[mid]; a[mid] = a[lo]; a[lo] = t; } \
+		if (less(a[hi], a[mid])) { t = a[hi]; a[hi] = a[mid]; a[mid] = t; } \
+		if (less(a[mid], a[lo])) { t = a[mid]; a[mid] = a[lo]; a[lo] = t; } \
+		type pivot = a[mid]; \
+		long long i = lo, j = hi; \
+		while (i <= j) { \
+			while (less(a[i], pivot)) \
+				i++; \
+			while (less(pivot, a[j])) \
+				j--; \
+			if (i <= j) { \
+				t = a[i]; a[i] = a[j]; a[j] = t; \
+				i++; \
+				j--; \
+			} \
+		} \
+		if (k <= j) \
+			hi = j; \
+		else if (k >= i) \
+			lo = i; \
+		else \
+			return; \
+	} \
+	for (long long i = lo + 1; i <= hi; i++) { \
+		type v = a[i]; \
+		long long j = i; \
+		for ( ; j > lo && less(v, a[j-1]); j--) \
+			a[j] = a[j-1]; \
+		a[j] = v; \
+	} \
+}
+
+#define PERCENTILE_KEEPER_LESS_SCALAR(a, b) ((a) < (b))
+#define PERCENTILE_KEEPER_LESS_MV(a, b) (mv_xx_comparator(&(a), &(b)) < 0)
+PERCENTILE_KEEPER_DEFINE_SELECT(select_ints,   long long, PERCENTILE_KEEPER_LESS_SCALAR)
+PERCENTILE_KEEPER_DEFINE_SELECT(select_floats, double,    PERCENTILE_KEEPER_LESS_SCALAR)
+PERCENTILE_KEEPER_DEFINE_SELECT(select_mvs,    mv_t,      PERCENTILE_KEEPER_LESS_MV)
+
+// Puts the value belonging at index k in sorted order there, selecting between the nearest fixed indices.
+static mv_t percentile_keeper_select(percentile_keeper_t* ppercentile_keeper, unsigned long long k) {
+	int pos = 0;
+	while (pos < ppercentile_keeper->num_fixed && ppercentile_keeper->fixed_indices[pos] < k)
+		pos++;
+	if (pos == ppercentile_keeper->num_fixed || ppercentile_keeper->fixed_indices[pos] != k) {
+		long long lo = (pos == 0) ? 0 : ppercentile_keeper->fixed_indices[pos-1] + 1;
+		long long hi = (pos == ppercentile_keeper->num_fixed)
+			? ppercentile_keeper->size - 1
+			: ppercentile_keeper->fixed_indices[pos] - 1;
+		switch (ppercentile_keeper->storage) {
+		case PERCENTILE_KEEPER_INTS:
+			select_ints(ppercentile_keeper->ints, lo, hi, k);
+			break;
+		case PERCENTILE_KEEPER_FLOATS:
+			select_floats(ppercentile_keeper->floats, lo, hi, k);
+			break;
+		default:
+			select_mvs(ppercentile_keeper->data, lo, hi, k);
+			break;
+		}
+		ppercentile_keeper->permuted = TRUE;
+
+		if (ppercentile_keeper->num_fixed >= ppercentile_keeper->fixed_capacity) {
+			ppercentile_keeper->fixed_capacity = (ppercentile_keeper->fixed_capacity == 0)
+				? 8 : 2 * ppercentile_keeper->fixed_capacity;
+			ppercentile_keeper->fixed_indices = mlr_realloc_or_die(ppercentile_keeper->fixed_indices,
+				ppercentile_keeper->fixed_capacity * sizeof(unsigned long long));
+		}
+		memmove(&ppercentile_keeper->fixed_indices[pos+1], &ppercentile_keeper->fixed_indices[pos],
+			(ppercentile_keeper->num_fixed - pos) * sizeof(unsigned long long));
+		ppercentile_keeper->fixed_indices[pos] = k;
+		ppercentile_keeper->num_fixed++;
 	}
+	return percentile_keeper_get(ppercentile_keeper, k);
 }
 
 // ----------------------------------------------------------------
@@ -249,32 +426,41 @@ mv_t percentile_keeper_emit_non_interpolated(percentile_keeper_t* ppercentile_ke
 	if (ppercentile_keeper->size == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
-		ppercentile_keeper->sorted = TRUE;
-	}
-	return ppercentile_keeper->data[compute_index_non_interpolated(ppercentile_keeper->size, percentile)];
+	return percentile_keeper_select(ppercentile_keeper,
+		compute_index_non_interpolated(ppercentile_keeper->size, percentile));
 }
 
+// array[iindex] + frac * (array[iindex+1] - array[iindex]);
 mv_t percentile_keeper_emit_linearly_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile) {
-	if (ppercentile_keeper->size == 0) {
+	unsigned long long n = ppercentile_keeper->size;
+	if (n == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
-		ppercentile_keeper->sorted = TRUE;
+	double findex = (percentile/100.0)*(n-1);
+	if (findex < 0)
+		findex = 0;
+	unsigned long long iindex = (unsigned long long)floor(findex);
+	mv_t a = percentile_keeper_select(ppercentile_keeper, iindex);
+	if (iindex >= n-1) {
+		return a;
+	} else {
+		mv_t b = percentile_keeper_select(ppercentile_keeper, iindex+1);
+		mv_t frac = mv_from_float(findex - iindex);
+		mv_t diff = x_xx_minus_func(&b, &a);
+		mv_t prod = x_xx_times_func(&frac, &diff);
+		mv_t rv = x_xx_plus_func(&a, &prod);
+		return rv;
 	}
-	return get_percentile_linearly_interpolated(ppercentile_keeper->data, ppercentile_keeper->size, percentile);
 }
 
 // ----------------------------------------------------------------
 void percentile_keeper_print(percentile_keeper_t* ppercentile_keeper) {
 	printf("percentile_keeper dump:\n");
 	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
-		mv_t* pa = &ppercentile_keeper->data[i];
-		if (pa->type == MT_FLOAT)
-			printf("[%02llu] %.8lf\n", i, ppercentile_keeper->data[i].u.fltv);
+		mv_t a = percentile_keeper_get(ppercentile_keeper, i);
+		if (a.type == MT_FLOAT)
+			printf("[%02llu] %.8lf\n", i, a.u.fltv);
 		else
-			printf("[%02llu] %8lld\n", i, ppercentile_keeper->data[i].u.intv);
+			printf("[%02llu] %8lld\n", i, a.u.intv);
 	}
 }
@@ -6,16 +6,37 @@
 #define PERCENTILE_KEEPER_H
 #include "lib/mlrval.h"
 
+// While all values are ints, or all are floats, they're kept in a plain array of that type; otherwise, and
+// for strings, as mv_t's in the data array. Only one of the three arrays is non-NULL.
+//
+// Percentiles are found by selection rather than sorting. Each one found leaves its index fixed: the
+// values there and before it are no greater, and after it no less. Later ones select only between the
+// fixed indices on either side. Ingesting clears them.
+typedef enum _percentile_keeper_storage_t {
+	PERCENTILE_KEEPER_EMPTY,
+	PERCENTILE_KEEPER_INTS,
+	PERCENTILE_KEEPER_FLOATS,
+	PERCENTILE_KEEPER_MIXED,
+} percentile_keeper_storage_t;
+
 typedef struct _percentile_keeper_t {
-	mv_t* data;
+	percentile_keeper_storage_t storage;
+	long long* ints;
+	double*    floats;
+	mv_t*      data;
 	unsigned long long size;
 	unsigned long long capacity;
-	int   sorted;
+	unsigned long long* fixed_indices; // sorted
+	int   num_fixed;
+	int   fixed_capacity;
+	int   permuted; // no longer in order of ingest
 } percentile_keeper_t;
 
 percentile_keeper_t* percentile_keeper_alloc();
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper);
 void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value);
+// The ith value ingested, unless the keeper has been permuted by emitting. Strings point into the keeper.
+mv_t percentile_keeper_get(percentile_keeper_t* ppercentile_keeper, unsigned long long i);
 
 typedef mv_t percentile_keeper_emitter_t(percentile_keeper_t* ppercentile_keeper, double percentile);
 mv_t percentile_keeper_emit_non_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile);
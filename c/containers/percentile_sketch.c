@@ -0,0 +1,266 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/percentile_sketch.h"
+
+#define PERCENTILE_SKETCH_LEVEL_RATIO   (2.0/3.0)
+#define PERCENTILE_SKETCH_MIN_CAPACITY  2
+#define PERCENTILE_SKETCH_INIT_ALLOC    8
+#define PERCENTILE_SKETCH_RANDOM_SEED   0x9e3779b97f4a7c15ULL
+
+static void percentile_sketch_grow(percentile_sketch_t* psketch);
+static void percentile_sketch_append(percentile_sketch_t* psketch, int level, double value);
+static void percentile_sketch_compress(percentile_sketch_t* psketch);
+static void percentile_sketch_sort(percentile_sketch_t* psketch);
+static double percentile_sketch_value_at_rank(percentile_sketch_t* psketch, unsigned long long rank);
+
+// ----------------------------------------------------------------
+percentile_sketch_t* percentile_sketch_alloc(int k) {
+	percentile_sketch_t* psketch = mlr_malloc_or_die(sizeof(percentile_sketch_t));
+	psketch->k                 = (k < PERCENTILE_SKETCH_MIN_CAPACITY) ? PERCENTILE_SKETCH_MIN_CAPACITY : k;
+	psketch->num_levels        = 0;
+	psketch->levels            = NULL;
+	psketch->level_sizes       = NULL;
+	psketch->level_alloc_sizes = NULL;
+	psketch->size              = 0;
+	psketch->max_size          = 0;
+	psketch->n                 = 0LL;
+	psketch->all_ints          = TRUE;
+	psketch->random_state      = PERCENTILE_SKETCH_RANDOM_SEED;
+	psketch->sorted_values     = NULL;
+	psketch->sorted_ranks      = NULL;
+	psketch->num_sorted        = 0;
+	psketch->is_sorted         = FALSE;
+	percentile_sketch_grow(psketch);
+	return psketch;
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_free(percentile_sketch_t* psketch) {
+	if (psketch == NULL)
+		return;
+	for (int h = 0; h < psketch->num_levels; h++)
+		free(psketch->levels[h]);
+	free(psketch->levels);
+	free(psketch->level_sizes);
+	free(psketch->level_alloc_sizes);
+	free(psketch->sorted_values);
+	free(psketch->sorted_ranks);
+	free(psketch);
+}
+
+// ----------------------------------------------------------------
+// Capacities depend on the number of levels: the top one's is k.
+static int percentile_sketch_capacity(percentile_sketch_t* psketch, int level) {
+	int depth = psketch->num_levels - 1 - level;
+	int capacity = (int)ceil(psketch->k * pow(PERCENTILE_SKETCH_LEVEL_RATIO, depth));
+	return (capacity < PERCENTILE_SKETCH_MIN_CAPACITY) ? PERCENTILE_SKETCH_MIN_CAPACITY : capacity;
+}
+
+static void percentile_sketch_grow(percentile_sketch_t* psketch) {
+	int h = psketch->num_levels++;
+	psketch->levels            = mlr_realloc_or_die(psketch->levels, psketch->num_levels * sizeof(double*));
+	psketch->level_sizes       = mlr_realloc_or_die(psketch->level_sizes, psketch->num_levels * sizeof(int));
+	psketch->level_alloc_sizes = mlr_realloc_or_die(psketch->level_alloc_sizes, psketch->num_levels * sizeof(int));
+	psketch->levels[h]            = mlr_malloc_or_die(PERCENTILE_SKETCH_INIT_ALLOC * sizeof(double));
+	psketch->level_sizes[h]       = 0;
+	psketch->level_alloc_sizes[h] = PERCENTILE_SKETCH_INIT_ALLOC;
+	psketch->max_size = 0;
+	for (h = 0; h < psketch->num_levels; h++)
+		psketch->max_size += percentile_sketch_capacity(psketch, h);
+}
+
+static void percentile_sketch_append(percentile_sketch_t* psketch, int level, double value) {
+	if (psketch->level_sizes[level] >= psketch->level_alloc_sizes[level]) {
+		psketch->level_alloc_sizes[level] *= 2;
+		psketch->levels[level] = mlr_realloc_or_die(psketch->levels[level],
+			psketch->level_alloc_sizes[level] * sizeof(double));
+	}
+	psketch->levels[level][psketch->level_sizes[level]++] = value;
+	psketch->size++;
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_ingest(percentile_sketch_t* psketch, mv_t* pvalue) {
+	double value;
+	if (pvalue->type == MT_INT) {
+		value = (double)pvalue->u.intv;
+	} else {
+		value = pvalue->u.fltv;
+		psketch->all_ints = FALSE;
+	}
+	percentile_sketch_append(psketch, 0, value);
+	psketch->n++;
+	psketch->is_sorted = FALSE;
+	if (psketch->size >= psketch->max_size)
+		percentile_sketch_compress(psketch);
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_merge(percentile_sketch_t* pdst, percentile_sketch_t* psrc) {
+	while (pdst->num_levels < psrc->num_levels)
+		percentile_sketch_grow(pdst);
+	for (int h = 0; h < psrc->num_levels; h++)
+		for (int i = 0; i < psrc->level_sizes[h]; i++)
+			percentile_sketch_append(pdst, h, psrc->levels[h][i]);
+	pdst->n += psrc->n;
+	pdst->all_ints = pdst->all_ints && psrc->all_ints;
+	pdst->is_sorted = FALSE;
+	while (pdst->size >= pdst->max_size)
+		percentile_sketch_compress(pdst);
+}
+
+void percentile_sketch_put_at_level(percentile_sketch_t* psketch, int level, double value) {
+	while (psketch->num_levels <= level)
+		percentile_sketch_grow(psketch);
+	percentile_sketch_append(psketch, level, value);
+	psketch->n += 1ULL << level;
+	psketch->is_sorted = FALSE;
+}
+
+// ----------------------------------------------------------------
+// NaNs sort last, as in lib/mlrsort.h.
+static int double_comparator(const void* pva, const void* pvb) {
+	double a = *(double*)pva;
+	double b = *(double*)pvb;
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return isnan(a) - isnan(b);
+}
+
+// xorshift64
+static int percentile_sketch_coin_flip(percentile_sketch_t* psketch) {
+	unsigned long long x = psketch->random_state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	psketch->random_state = x;
+	return (int)(x >> 63);
+}
+
+// Compacts the lowest level at or over its capacity, and the levels above if that fills them, until the
+// sketch is under its maximum size. With an odd number of values the smallest stays where it is, so total
+// weight is kept.
+static void percentile_sketch_compress(percentile_sketch_t* psketch) {
+	for (int h = 0; h < psketch->num_levels; h++) {
+		if (psketch->level_sizes[h] < percentile_sketch_capacity(psketch, h))
+			continue;
+		if (h + 1 == psketch->num_levels)
+			percentile_sketch_grow(psketch);
+
+		double* values = psketch->levels[h];
+		int num_values = psketch->level_sizes[h];
+		qsort(values, num_values, sizeof(double), double_comparator);
+		int start = num_values % 2;
+		int offset = percentile_sketch_coin_flip(psketch);
+		for (int i = start + offset; i < num_values; i += 2)
+			percentile_sketch_append(psketch, h + 1, values[i]);
+		psketch->size -= num_values - start;
+		psketch->level_sizes[h] = start;
+
+		if (psketch->size < psketch->max_size)
+			break;
+	}
+}
+
+// ----------------------------------------------------------------
+typedef struct _weighted_value_t {
+	double             value;
+	unsigned long long weight;
+} weighted_value_t;
+
+static int weighted_value_comparator(const void* pva, const void* pvb) {
+	return double_comparator(&((weighted_value_t*)pva)->value, &((weighted_value_t*)pvb)->value);
+}
+
+static void percentile_sketch_sort(percentile_sketch_t* psketch) {
+	if (psketch->is_sorted)
+		return;
+	weighted_value_t* pairs = mlr_malloc_or_die((psketch->size + 1) * sizeof(weighted_value_t));
+	int num_pairs = 0;
+	for (int h = 0; h < psketch->num_levels; h++) {
+		for (int i = 0; i < psketch->level_sizes[h]; i++) {
+			pairs[num_pairs].value  = psketch->levels[h][i];
+			pairs[num_pairs].weight = 1ULL << h;
+			num_pairs++;
+		}
+	}
+	qsort(pairs, num_pairs, sizeof(weighted_value_t), weighted_value_comparator);
+
+	psketch->sorted_values = mlr_realloc_or_die(psketch->sorted_values, (num_pairs + 1) * sizeof(double));
+	psketch->sorted_ranks  = mlr_realloc_or_die(psketch->sorted_ranks,
+		(num_pairs + 1) * sizeof(unsigned long long));
+	unsigned long long cumulative_weight = 0LL;
+	for (int i = 0; i < num_pairs; i++) {
+		cumulative_weight += pairs[i].weight;
+		psketch->sorted_values[i] = pairs[i].value;
+		psketch->sorted_ranks[i]  = cumulative_weight;
+	}
+	psketch->num_sorted = num_pairs;
+	psketch->is_sorted = TRUE;
+	free(pairs);
+}
+
+// The value which would be at the given zero-up index if all the inputs were sorted: the first whose
+// cumulative weight exceeds it.
+static double percentile_sketch_value_at_rank(percentile_sketch_t* psketch, unsigned long long rank) {
+	int lo = 0;
+	int hi = psketch->num_sorted - 1;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (psketch->sorted_ranks[mid] > rank)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return psketch->sorted_values[lo];
+}
+
+static mv_t percentile_sketch_typed(percentile_sketch_t* psketch, double value) {
+	return psketch->all_ints ? mv_from_int((long long)value) : mv_from_float(value);
+}
+
+// ----------------------------------------------------------------
+// Indexing is as in percentile_keeper.c.
+mv_t percentile_sketch_emit_non_interpolated(percentile_sketch_t* psketch, double percentile) {
+	if (psketch->n == 0LL)
+		return mv_absent();
+	percentile_sketch_sort(psketch);
+	long long index = percentile * psketch->n / 100.0;
+	if (index >= (long long)psketch->n)
+		index = psketch->n - 1;
+	if (index < 0)
+		index = 0;
+	return percentile_sketch_typed(psketch, percentile_sketch_value_at_rank(psketch, index));
+}
+
+mv_t percentile_sketch_emit_linearly_interpolated(percentile_sketch_t* psketch, double percentile) {
+	if (psketch->n == 0LL)
+		return mv_absent();
+	percentile_sketch_sort(psketch);
+	double findex = (percentile/100.0) * (psketch->n - 1);
+	if (findex < 0)
+		findex = 0;
+	unsigned long long iindex = (unsigned long long)floor(findex);
+	double a = percentile_sketch_value_at_rank(psketch, iindex);
+	if (iindex >= psketch->n - 1)
+		return percentile_sketch_typed(psketch, a);
+	double b = percentile_sketch_value_at_rank(psketch, iindex + 1);
+	return mv_from_float(a + (findex - iindex) * (b - a));
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_print(percentile_sketch_t* psketch) {
+	printf("percentile_sketch dump: k=%d n=%llu size=%d max_size=%d\n",
+		psketch->k, psketch->n, psketch->size, psketch->max_size);
+	for (int h = 0; h < psketch->num_levels; h++) {
+		printf("level %d (%d/%d):", h, psketch->level_sizes[h], percentile_sketch_capacity(psketch, h));
+		for (int i = 0; i < psketch->level_sizes[h]; i++)
+			printf(" %.8lf", psketch->levels[h][i]);
+		printf("\n");
+	}
+}
@@ -0,0 +1,66 @@
+// ================================================================
+// For mlr stats1 approximate percentiles: a KLL sketch (Karnin, Lang and
+// Liberty, "Optimal quantile approximation in streams", 2016).
+//
+// * Values are kept in levels. A value at level h stands for 2^h of the
+//   input. When the sketch is full, the lowest level over its capacity is
+//   sorted, and every other value in it, starting at random with the first or
+//   the second, moves up a level; the rest are discarded.
+//
+// * The top level has capacity k, and each level below has two thirds the
+//   capacity of the one above it, but at least two. So the sketch holds fewer
+//   than 3k values plus two per level, however many it has seen.
+//
+// * The rank of a percentile's value is off by at most about 2n/k, i.e. 1% of
+//   n for the default k = 200, and typically by a fifth of that. Until the
+//   first compaction, i.e. for fewer than k values, results are exact.
+//
+// * The random choices come from a fixed seed, so output is reproducible.
+//
+// * Sketches fed separate parts of an input stream can be merged, and the
+//   result has the same error bound.
+// ================================================================
+
+#ifndef PERCENTILE_SKETCH_H
+#define PERCENTILE_SKETCH_H
+#include "lib/mlrval.h"
+
+#define PERCENTILE_SKETCH_DEFAULT_K 200
+
+typedef struct _percentile_sketch_t {
+	int                 k;
+	int                 num_levels;
+	double**            levels;       // level h values each stand for 2^h inputs
+	int*                level_sizes;
+	int*                level_alloc_sizes;
+	int                 size;         // values held, over all levels
+	int                 max_size;     // sum of the levels' capacities
+	unsigned long long  n;            // values seen
+	int                 all_ints;
+	unsigned long long  random_state;
+
+	// For emit: all values in order, with cumulative weights. Rebuilt after adding.
+	double*             sorted_values;
+	unsigned long long* sorted_ranks; // number of inputs at or below each value
+	int                 num_sorted;
+	int                 is_sorted;
+} percentile_sketch_t;
+
+percentile_sketch_t* percentile_sketch_alloc(int k);
+void percentile_sketch_free(percentile_sketch_t* psketch);
+// Ints are emitted as ints if all the values were ints; else all are floats.
+void percentile_sketch_ingest(percentile_sketch_t* psketch, mv_t* pvalue);
+// Same as if psrc's values had been ingested by pdst. Leaves psrc as it was.
+void percentile_sketch_merge(percentile_sketch_t* pdst, percentile_sketch_t* psrc);
+// For restoring saved state: puts a value at the given level, standing for 2^level inputs. Follow with
+// percentile_sketch_merge into a sketch fed the usual way.
+void percentile_sketch_put_at_level(percentile_sketch_t* psketch, int level, double value);
+
+typedef mv_t percentile_sketch_emitter_t(percentile_sketch_t* psketch, double percentile);
+mv_t percentile_sketch_emit_non_interpolated(percentile_sketch_t* psketch, double percentile);
+mv_t percentile_sketch_emit_linearly_interpolated(percentile_sketch_t* psketch, double percentile);
+
+// For debug/test
+void percentile_sketch_print(percentile_sketch_t* psketch);
+
+#endif // PERCENTILE_SKETCH_H
@@ -4,13 +4,23 @@
 #include "containers/top_keeper.h"
 #include "lib/mvfuncs.h"
 
+#define TOP_KEEPER_INIT_ALLOC_SIZE 16
+
+static void top_keeper_heapify(top_keeper_t* ptop_keeper);
+static void top_keeper_sift_up(top_keeper_t* ptop_keeper, int i);
+static void top_keeper_sift_down(top_keeper_t* ptop_keeper, int i, int n);
+
 // ----------------------------------------------------------------
 top_keeper_t* top_keeper_alloc(int capacity) {
 	top_keeper_t* ptop_keeper = mlr_malloc_or_die(sizeof(top_keeper_t));
-	ptop_keeper->top_values   = mlr_malloc_or_die(capacity*sizeof(mv_t));
-	ptop_keeper->top_precords = mlr_malloc_or_die(capacity*sizeof(lrec_t*));
+	ptop_keeper->top_values   = NULL;
+	ptop_keeper->top_precords = NULL;
+	ptop_keeper->top_seqs     = NULL;
 	ptop_keeper->size         = 0;
 	ptop_keeper->capacity     = capacity;
+	ptop_keeper->alloc_size   = 0;
+	ptop_keeper->is_sorted    = FALSE;
+	ptop_keeper->num_added    = 0LL;
 	return ptop_keeper;
 }
 
@@ -20,65 +30,144 @@ void top_keeper_free(top_keeper_t* ptop_keeper) {
 		return;
 	free(ptop_keeper->top_values);
 	free(ptop_keeper->top_precords);
+	free(ptop_keeper->top_seqs);
 	ptop_keeper->top_values = NULL;
 	ptop_keeper->top_precords = NULL;
+	ptop_keeper->top_seqs = NULL;
 	ptop_keeper->size = 0;
 	ptop_keeper->capacity = 0;
 	free(ptop_keeper);
 }
 
 // ----------------------------------------------------------------
-// Cases:
-// 1. array size <  capacity
-//    * find destidx
-//    * if destidx == size
-//        put it there
-//      else
-//        shift down & insert
-//      increment size
-//
-// 2. array size == capacity
-//    * find destidx
-//    * if destidx == size
-//        discard
-//      else
-//        shift down & insert
-
-// capacity = 10, size = 6, destidx = 3     capacity = 10, size = 10, destidx = 3
-// [0 #]   [0 #]                            [0 #]   [0 #]
-// [1 #]   [1 #]                            [1 #]   [1 #]
-// [2 #]   [2 #]                            [2 #]   [2 #]
-// [3 #]*  [3 X]                            [3 #]*  [3 X]
-// [4 #]   [4 #]                            [4 #]   [4 #]
-// [5 #]   [5 #]                            [5 #]   [5 #]
-// [6  ]   [6 #]                            [6 #]   [6 #]
-// [7  ]   [7  ]                            [7 #]   [7 #]
-// [8  ]   [8  ]                            [8 #]   [8 #]
-// [9  ]   [9  ]                            [9 #]   [9 #]
-
-// Our caller, mapper_top, feeds us records. We keep them or free them.
+// Whether entry i outranks entry j.
+static inline int top_keeper_outranks(top_keeper_t* ptop_keeper, int i, int j) {
+	mv_t* pa = &ptop_keeper->top_values[i];
+	mv_t* pb = &ptop_keeper->top_values[j];
+	if (mv_i_nn_gt(pa, pb))
+		return TRUE;
+	if (mv_i_nn_lt(pa, pb))
+		return FALSE;
+	return ptop_keeper->top_seqs[i] > ptop_keeper->top_seqs[j];
+}
+
+static inline void top_keeper_swap(top_keeper_t* ptop_keeper, int i, int j) {
+	mv_t value = ptop_keeper->top_values[i];
+	ptop_keeper->top_values[i] = ptop_keeper->top_values[j];
+	ptop_keeper->top_values[j] = value;
+	lrec_t* prec = ptop_keeper->top_precords[i];
+	ptop_keeper->top_precords[i] = ptop_keeper->top_precords[j];
+	ptop_keeper->top_precords[j] = prec;
+	unsigned long long seq = ptop_keeper->top_seqs[i];
+	ptop_keeper->top_seqs[i] = ptop_keeper->top_seqs[j];
+	ptop_keeper->top_seqs[j] = seq;
+}
+
+// ----------------------------------------------------------------
 void top_keeper_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec) {
-	int destidx = mlr_bsearch_mv_n_for_insert(ptop_keeper->top_values, ptop_keeper->size, &value);
+	top_keeper_add_with_seq(ptop_keeper, value, prec, ptop_keeper->num_added);
+}
+
+// Cases:
+// * Not yet full: put the new entry at the bottom of the heap and sift it up.
+// * Full: if the new entry outranks the lowest-ranked one, at index 0, it takes that one's place and is
+//   sifted down; else it's discarded.
+void top_keeper_add_with_seq(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec, unsigned long long seq) {
+	if (ptop_keeper->is_sorted)
+		top_keeper_heapify(ptop_keeper);
+	if (seq >= ptop_keeper->num_added)
+		ptop_keeper->num_added = seq + 1;
+
 	if (ptop_keeper->size < ptop_keeper->capacity) {
-		for (int i = ptop_keeper->size-1; i >= destidx; i--) {
-			ptop_keeper->top_values[i+1]   = ptop_keeper->top_values[i];
-			ptop_keeper->top_precords[i+1] = ptop_keeper->top_precords[i];
-		}
-		ptop_keeper->top_values[destidx]   = value;
-		ptop_keeper->top_precords[destidx] = prec;
-		ptop_keeper->size++;
-	} else {
-		if (destidx >= ptop_keeper->capacity) {
-			lrec_free(prec);
-			return;
+		if (ptop_keeper->size >= ptop_keeper->alloc_size) {
+			int alloc_size = (ptop_keeper->alloc_size == 0) ? TOP_KEEPER_INIT_ALLOC_SIZE : 2 * ptop_keeper->alloc_size;
+			if (alloc_size > ptop_keeper->capacity)
+				alloc_size = ptop_keeper->capacity;
+			ptop_keeper->top_values   = mlr_realloc_or_die(ptop_keeper->top_values, alloc_size * sizeof(mv_t));
+			ptop_keeper->top_precords = mlr_realloc_or_die(ptop_keeper->top_precords, alloc_size * sizeof(lrec_t*));
+			ptop_keeper->top_seqs     = mlr_realloc_or_die(ptop_keeper->top_seqs,
+				alloc_size * sizeof(unsigned long long));
+			ptop_keeper->alloc_size   = alloc_size;
 		}
-		lrec_free(ptop_keeper->top_precords[ptop_keeper->size-1]);
-		for (int i = ptop_keeper->size-2; i >= destidx; i--) {
-			ptop_keeper->top_values[i+1]   = ptop_keeper->top_values[i];
-			ptop_keeper->top_precords[i+1] = ptop_keeper->top_precords[i];
-		}
-		ptop_keeper->top_values[destidx]   = value;
-		ptop_keeper->top_precords[destidx] = prec;
+		int i = ptop_keeper->size++;
+		ptop_keeper->top_values[i]   = value;
+		ptop_keeper->top_precords[i] = prec;
+		ptop_keeper->top_seqs[i]     = seq;
+		top_keeper_sift_up(ptop_keeper, i);
+		return;
+	}
+
+	// The new entry loses to the lowest-ranked one if its value is less, or equal but added earlier, which
+	// happens only when merging.
+	if (ptop_keeper->size == 0 || mv_i_nn_lt(&value, &ptop_keeper->top_values[0])
+		|| (!mv_i_nn_gt(&value, &ptop_keeper->top_values[0]) && seq < ptop_keeper->top_seqs[0]))
+	{
+		lrec_free(prec);
+		return;
+	}
+	lrec_free(ptop_keeper->top_precords[0]);
+	ptop_keeper->top_values[0]   = value;
+	ptop_keeper->top_precords[0] = prec;
+	ptop_keeper->top_seqs[0]     = seq;
+	top_keeper_sift_down(ptop_keeper, 0, ptop_keeper->size);
+}
+
+// ----------------------------------------------------------------
+// The source's entries are numbered after all of the destination's additions, as if they had come later in
+// the same stream.
+void top_keeper_merge(top_keeper_t* pdst, top_keeper_t* psrc) {
+	unsigned long long seq_base = pdst->num_added;
+	for (int i = 0; i < psrc->size; i++)
+		top_keeper_add_with_seq(pdst, psrc->top_values[i], psrc->top_precords[i], seq_base + psrc->top_seqs[i]);
+	pdst->num_added = seq_base + psrc->num_added;
+	psrc->size = 0;
+	psrc->num_added = 0LL;
+}
+
+// ----------------------------------------------------------------
+// Heapsort: repeatedly swapping the lowest-ranked entry to the end leaves the highest-ranked at the start.
+void top_keeper_sort(top_keeper_t* ptop_keeper) {
+	if (ptop_keeper->is_sorted)
+		return;
+	for (int n = ptop_keeper->size - 1; n > 0; n--) {
+		top_keeper_swap(ptop_keeper, 0, n);
+		top_keeper_sift_down(ptop_keeper, 0, n);
+	}
+	ptop_keeper->is_sorted = TRUE;
+}
+
+// Reversed, rank order is lowest first, which is already a heap.
+static void top_keeper_heapify(top_keeper_t* ptop_keeper) {
+	for (int i = 0, j = ptop_keeper->size - 1; i < j; i++, j--)
+		top_keeper_swap(ptop_keeper, i, j);
+	ptop_keeper->is_sorted = FALSE;
+}
+
+// ----------------------------------------------------------------
+// 0-up: left child 2*i+1, right child 2*i+2, parent (i-1)/2. Each entry outranks its parent.
+static void top_keeper_sift_up(top_keeper_t* ptop_keeper, int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!top_keeper_outranks(ptop_keeper, parent, i))
+			break;
+		top_keeper_swap(ptop_keeper, parent, i);
+		i = parent;
+	}
+}
+
+static void top_keeper_sift_down(top_keeper_t* ptop_keeper, int i, int n) {
+	while (TRUE) {
+		int lowest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+		if (left < n && top_keeper_outranks(ptop_keeper, lowest, left))
+			lowest = left;
+		if (right < n && top_keeper_outranks(ptop_keeper, lowest, right))
+			lowest = right;
+		if (lowest == i)
+			break;
+		top_keeper_swap(ptop_keeper, lowest, i);
+		i = lowest;
 	}
 }
 
@@ -1,5 +1,15 @@
 // ================================================================
-// Data structure for mlr top: just a decorated array.
+// Data structure for mlr top: a bounded heap of values, with their records.
+//
+// * Values rank larger first. Among equal values, later-added ones rank first,
+//   so e.g. top -n 1 keeps the last of several equal maxima.
+//
+// * While adding, the arrays are a zero-indexed heap with the lowest-ranked
+//   entry at index 0, so that replacing it is O(log capacity).
+//   top_keeper_sort puts them in rank order for output.
+//
+// * Keepers fed separate parts of an input stream can be merged, in the order
+//   of those parts, to give what one keeper fed all of it would have.
 // ================================================================
 
 #ifndef TOP_KEEPER_H
@@ -8,15 +18,28 @@
 #include "containers/lrec.h"
 
 typedef struct _top_keeper_t {
-	mv_t*    top_values;
-	lrec_t** top_precords;
-	int      size;
-	int      capacity;
+	mv_t*               top_values;
+	lrec_t**            top_precords;
+	unsigned long long* top_seqs; // order added, for ties
+	int                 size;
+	int                 capacity;
+	int                 alloc_size; // grows up to capacity as needed
+	int                 is_sorted;
+	unsigned long long  num_added;
 } top_keeper_t;
 
 top_keeper_t* top_keeper_alloc(int capacity);
 void top_keeper_free(top_keeper_t* ptop_keeper);
+
+// Our caller, mapper_top, feeds us records, which may be NULL. We keep them or free them.
 void top_keeper_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec);
+// For restoring saved state: as top_keeper_add, but with the entry's place in the order of adding given, as
+// found in top_seqs.
+void top_keeper_add_with_seq(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec, unsigned long long seq);
+// Same as if psrc's values and records had been added to pdst after its own. Leaves psrc empty.
+void top_keeper_merge(top_keeper_t* pdst, top_keeper_t* psrc);
+// Puts the arrays in rank order, highest first. Adding again afterward is allowed.
+void top_keeper_sort(top_keeper_t* ptop_keeper);
 
 // For debug/test
 void top_keeper_print(top_keeper_t* ptop_keeper);
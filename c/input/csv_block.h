@@ -0,0 +1,96 @@
+// ================================================================
+// Block classification for the CSV readers. When IFS and IRS are single
+// characters (the overwhelmingly common case) the readers don't step the
+// parse-trie byte by byte. Instead the input is classified 64 bytes at a time
+// into two bitmaps -- one bit per byte for double quotes, and one for
+// IFS-or-IRS -- and the tokenizer jumps from one set bit to the next. Field
+// spans in between are never looked at again. The parse-trie path is retained
+// for multi-character separators.
+//
+// The word-at-a-time classification is in lib/byte_masks.h. For a partial
+// block at the end of the input, or without MLR_BYTE_MASKS_USE_WORDS, it's a
+// plain byte loop. Either way nothing is read at or past the given end.
+// ================================================================
+
+#ifndef CSV_BLOCK_H
+#define CSV_BLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include "lib/byte_masks.h"
+
+#define CSV_BLOCK_SIZE 64
+
+typedef struct _csv_block_t {
+	char*    base;   // Start of the classified block; not necessarily aligned
+	char*    end;    // base + CSV_BLOCK_SIZE, or the end of the input if sooner
+	uint64_t quotes; // Bit i is set iff base[i] is a double quote
+	uint64_t seps;   // Bit i is set iff base[i] is IFS or IRS
+	char     ifs;
+	char     irs;
+} csv_block_t;
+
+static inline void csv_block_init(csv_block_t* pblock, char ifs, char irs) {
+	pblock->base = NULL;
+	pblock->end  = NULL;
+	pblock->ifs  = ifs;
+	pblock->irs  = irs;
+}
+
+// For when the bytes under the block may have changed, e.g. a new file or a refilled buffer.
+static inline void csv_block_reset(csv_block_t* pblock) {
+	pblock->base = NULL;
+	pblock->end  = NULL;
+}
+
+static inline void csv_block_load(csv_block_t* pblock, char* base, char* eof) {
+	pblock->base   = base;
+	pblock->quotes = 0ULL;
+	pblock->seps   = 0ULL;
+
+	if (eof - base >= CSV_BLOCK_SIZE) {
+		pblock->end = base + CSV_BLOCK_SIZE;
+#ifdef MLR_BYTE_MASKS_USE_WORDS
+		uint64_t dquotes = BYTES_01 * (unsigned char)'"';
+		uint64_t ifses   = BYTES_01 * (unsigned char)pblock->ifs;
+		uint64_t irses   = BYTES_01 * (unsigned char)pblock->irs;
+		for (int i = 0; i < CSV_BLOCK_SIZE / 8; i++) {
+			uint64_t x;
+			memcpy(&x, base + 8*i, 8);
+			pblock->quotes |= gather_high_bits(bytes_equal_to(x, dquotes)) << (8*i);
+			pblock->seps   |= gather_high_bits(bytes_equal_to(x, ifses) | bytes_equal_to(x, irses)) << (8*i);
+		}
+		return;
+#endif
+	} else {
+		pblock->end = eof;
+	}
+
+	char ifs = pblock->ifs;
+	char irs = pblock->irs;
+	int n = pblock->end - base;
+	for (int i = 0; i < n; i++) {
+		char c = base[i];
+		if (c == '"')
+			pblock->quotes |= 1ULL << i;
+		else if (c == ifs || c == irs)
+			pblock->seps |= 1ULL << i;
+	}
+}
+
+// Returns a pointer to the first double quote at or after e -- or, if want_seps is true, the first double quote,
+// IFS, or IRS -- or eof if there is none.
+static inline char* csv_block_scan(csv_block_t* pblock, char* e, char* eof, int want_seps) {
+	while (e < eof) {
+		if (e < pblock->base || e >= pblock->end)
+			csv_block_load(pblock, e, eof);
+		uint64_t bits = want_seps ? pblock->quotes | pblock->seps : pblock->quotes;
+		bits >>= (e - pblock->base);
+		if (bits != 0ULL)
+			return e + lowest_set_bit(bits);
+		e = pblock->end;
+	}
+	return eof;
+}
+
+#endif // CSV_BLOCK_H
@@ -8,6 +8,7 @@
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "file_reader_mmap.h"
+#include "input/lrec_reader.h"
 
 #if MLR_ARCH_MMAP_ENABLED
 static char empty_buf[1] = { 0 };
@@ -47,6 +48,7 @@ file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name)
 			exit(1);
 		}
 	}
+	pstate->sof = pstate->sol;
 	pstate->eof = pstate->sol + stat.st_size;
 	// POSIX semantics: the mmap itself increments a reference count to the file, in addition to the
 	// open.  We close the file but keep the mmap reference until a subsequent munmap.
@@ -82,3 +84,49 @@ void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name) {
 void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe) {
 	file_reader_mmap_close(pvhandle, prepipe);
 }
+
+// ----------------------------------------------------------------
+long long file_reader_mmap_vtell(void* pvstate, void* pvhandle, long long* pheader_offset) {
+	file_reader_mmap_state_t* pstate = pvhandle;
+	*pheader_offset = LREC_READER_HEADER_NONE;
+	return pstate->sol - pstate->sof;
+}
+
+void file_reader_mmap_vseek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* pstate = pvhandle;
+	pstate->sol = pstate->sof + offset;
+}
+
+// ----------------------------------------------------------------
+lrec_t* file_reader_mmap_reread(lrec_reader_t* preader, void* pvhandle, long long offset, long long end,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (offset < 0LL || end < offset || end > phandle->eof - phandle->sof)
+		return NULL;
+	long long length = end - offset;
+	char* line = mlr_malloc_or_die(length + 1);
+	memcpy(line, phandle->sof + offset, length);
+	line[length] = 0;
+
+	file_reader_mmap_state_t copy = { .sof = line, .sol = line, .eof = line + length, .fd = -1 };
+	lrec_t* prec = preader->pprocess_func(preader->pvstate, &copy, pctx);
+	if (prec == NULL)
+		free(line);
+	else
+		lrec_set_single_line_backing(prec, line);
+	return prec;
+}
+
+// ----------------------------------------------------------------
+void file_reader_mmap_release(file_reader_mmap_state_t* pstate, long long start, long long end) {
+#if MLR_ARCH_MMAP_ENABLED
+	long long page_size = sysconf(_SC_PAGESIZE);
+	start = (start + page_size - 1) / page_size * page_size;
+	end = end / page_size * page_size;
+	if (pstate->sof != empty_buf && start < end)
+		madvise(pstate->sof + start, (size_t)(end - start), MADV_DONTNEED);
+#endif
+}
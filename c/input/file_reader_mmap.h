@@ -5,7 +5,11 @@
 #ifndef FILE_READER_MMAP_H
 #define FILE_READER_MMAP_H
 
+#include "lib/context.h"
+#include "containers/lrec.h"
+
 typedef struct _file_reader_mmap_state_t {
+	char* sof; // for byte offsets
 	char* sol;
 	char* eof;
 	int   fd;
@@ -17,4 +21,22 @@ void file_reader_mmap_close(file_reader_mmap_state_t* pstate, char* prepipe);
 void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name);
 void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe);
 
+// Tell and seek methods (see input/lrec_reader.h) for readers which keep no state from one record to
+// the next, e.g. DKVP.
+long long file_reader_mmap_vtell(void* pvstate, void* pvhandle, long long* pheader_offset);
+void file_reader_mmap_vseek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx);
+
+// Reread method (see input/lrec_reader.h) for readers whose records depend only on their own lines, e.g.
+// DKVP.
+struct _lrec_reader_t;
+lrec_t* file_reader_mmap_reread(struct _lrec_reader_t* preader, void* pvhandle, long long offset, long long end,
+	context_t* pctx);
+
+// Gives back the memory which bytes [start, end) of the file take, as far as whole pages lie in that range,
+// when the caller knows that no record points into them any longer. Pages the readers parsed in place
+// would otherwise stay in memory, as private copies, until exit. The bytes mustn't be read again through
+// this mapping.
+void file_reader_mmap_release(file_reader_mmap_state_t* pstate, long long start, long long end);
+
 #endif // FILE_READER_MMAP_H
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
 #include "input/line_readers.h"
@@ -234,3 +235,238 @@ char* mlr_alloc_read_line_multiple_delimiter_stripping_comments_aux(
 		}
 	}
 }
+
+// ----------------------------------------------------------------
+#define COUNT_LINES_BLOCK_SIZE (64 * 1024)
+
+long long mlr_count_lines_single_delimiter(
+	FILE*      fp,
+	int        delimiter,
+	int        do_auto_line_term,
+	context_t* pctx)
+{
+	char* block = mlr_malloc_or_die(COUNT_LINES_BLOCK_SIZE);
+	long long count = 0LL;
+	int in_line = FALSE; // Bytes seen since the last delimiter
+	char last = 0;       // The last of those, if any
+	size_t nread;
+
+	while ((nread = fread(block, 1, COUNT_LINES_BLOCK_SIZE, fp)) > 0) {
+		char* p = block;
+		char* end = block + nread;
+		char* q;
+		while ((q = memchr(p, delimiter, end - p)) != NULL) {
+			if (do_auto_line_term) {
+				char before = (q > p) ? q[-1] : (in_line ? last : 0);
+				if (before == '\r')
+					context_set_autodetected_crlf(pctx);
+				else
+					context_set_autodetected_lf(pctx);
+				do_auto_line_term = FALSE;
+			}
+			count++;
+			in_line = FALSE;
+			p = q + 1;
+		}
+		if (p < end) {
+			in_line = TRUE;
+			last = end[-1];
+		}
+	}
+
+	// As with the line reader, an unterminated last line counts, and sets the line ending if nothing has yet.
+	if (do_auto_line_term) {
+		if (in_line && last == '\r')
+			context_set_autodetected_crlf(pctx);
+		else
+			context_set_autodetected_lf(pctx);
+	}
+	if (in_line)
+		count++;
+
+	free(block);
+	return count;
+}
+
+// ----------------------------------------------------------------
+long long mlr_count_lines_mmap(file_reader_mmap_state_t* phandle, char* irs, int irslen,
+	int do_auto_line_term, comment_handling_t comment_handling, char* comment_string, context_t* pctx)
+{
+	int comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	char* sol = phandle->sol;
+	char* eof = phandle->eof;
+	long long count = 0LL;
+
+	while (sol < eof) {
+		char* q = memchr(sol, irs[0], eof - sol);
+		if (irslen > 1) {
+			while (q != NULL && ((eof - q) < irslen || memcmp(q, irs, irslen) != 0))
+				q = memchr(q + 1, irs[0], eof - q - 1);
+		}
+		char* next = (q == NULL) ? eof : q + irslen;
+
+		if (comment_string != NULL && (eof - sol) >= comment_string_length
+			&& streqn(sol, comment_string, comment_string_length))
+		{
+			if (comment_handling == PASS_COMMENTS)
+				fwrite(sol, 1, next - sol, stdout);
+		} else {
+			if (do_auto_line_term && q != NULL) {
+				if (q > sol && q[-1] == '\r')
+					context_set_autodetected_crlf(pctx);
+				else
+					context_set_autodetected_lf(pctx);
+				do_auto_line_term = FALSE;
+			}
+			count++;
+		}
+		sol = next;
+	}
+
+	phandle->sol = eof;
+	return count;
+}
+
+// ----------------------------------------------------------------
+char* mlr_find_last_lines_mmap(file_reader_mmap_state_t* phandle, char* irs, int irslen,
+	char* comment_string, long long num_lines)
+{
+	if (mlr_irs_overlaps_itself(irs, irslen))
+		return NULL;
+
+	int comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	char* sol = phandle->sol;
+	if (num_lines <= 0LL)
+		return phandle->eof;
+	if (sol >= phandle->eof)
+		return sol;
+	char* eol = phandle->eof; // end of the current line, less its IRS
+	if ((eol - sol) >= irslen && memcmp(eol - irslen, irs, irslen) == 0)
+		eol -= irslen;
+	long long count = 0LL;
+
+	while (TRUE) {
+		// The line starts after the last IRS before its end.
+		char* p = eol - irslen;
+		while (p >= sol && (*p != irs[0] || memcmp(p, irs, irslen) != 0))
+			p--;
+		char* line = (p >= sol) ? p + irslen : sol;
+
+		if (comment_string == NULL || (phandle->eof - line) < comment_string_length
+			|| !streqn(line, comment_string, comment_string_length))
+		{
+			if (++count >= num_lines)
+				return line;
+		}
+		if (line == sol)
+			return sol;
+		eol = p;
+	}
+}
+
+// ----------------------------------------------------------------
+int mlr_irs_overlaps_itself(char* irs, int irslen) {
+	for (int k = 1; k < irslen; k++)
+		if (memcmp(irs, irs + k, irslen - k) == 0)
+			return TRUE;
+	return FALSE;
+}
+
+// ----------------------------------------------------------------
+// Since IRS can't overlap itself, every occurrence of it ends a line, so the search can start anywhere.
+long long mlr_find_line_start_mmap(file_reader_mmap_state_t* phandle, char* irs, int irslen, long long offset) {
+	long long size = phandle->eof - phandle->sof;
+	if (offset <= 0LL)
+		return 0LL;
+	if (offset >= size)
+		return size;
+	char* p = phandle->sof + ((offset >= irslen) ? offset - irslen : 0LL);
+	char* eof = phandle->eof;
+	while (TRUE) {
+		char* q = memchr(p, irs[0], eof - p);
+		if (q == NULL || (eof - q) < irslen)
+			return size;
+		if (memcmp(q, irs, irslen) == 0 && (q - phandle->sof) + irslen >= offset)
+			return (q - phandle->sof) + irslen;
+		p = q + 1;
+	}
+}
+
+// ----------------------------------------------------------------
+// The last irslen bytes read are kept in a window, to check for IRS after each one.
+static int read_byte_checking_irs(FILE* input_stream, char* irs, int irslen, char* window, int* pend_of_line) {
+	int c = getc(input_stream);
+	if (c != EOF) {
+		memmove(window, window + 1, irslen - 1);
+		window[irslen - 1] = c;
+		*pend_of_line = (memcmp(window, irs, irslen) == 0);
+	}
+	return c;
+}
+
+long long mlr_copy_line_range_stdio(FILE* input_stream, FILE* output_stream, char* irs, int irslen,
+	int with_header, char* comment_string, long long start, long long end)
+{
+	char* window = mlr_malloc_or_die(irslen);
+	memset(window, 0, irslen);
+	int comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	long long offset = 0LL;
+	int end_of_line = FALSE;
+	int c;
+
+	// The header is the first line other than comment lines. A line is a comment line if it starts with
+	// the comment string, as far as it goes.
+	while (with_header) {
+		int is_comment = comment_string != NULL;
+		int column = 0;
+		while (TRUE) {
+			if ((c = read_byte_checking_irs(input_stream, irs, irslen, window, &end_of_line)) == EOF) {
+				free(window);
+				return offset;
+			}
+			putc(c, output_stream);
+			offset++;
+			if (is_comment && column < comment_string_length && c != comment_string[column])
+				is_comment = FALSE;
+			column++;
+			if (end_of_line)
+				break;
+		}
+		if (!is_comment || column - irslen < comment_string_length)
+			break;
+	}
+
+	// Skips to the first line starting at or after the start offset, seeking over most of the way when
+	// the input is a file.
+	if (offset < start) {
+		long long seek_offset = start - irslen;
+		if (seek_offset > offset && fseek(input_stream, seek_offset, SEEK_SET) == 0) {
+			offset = seek_offset;
+			memset(window, 0, irslen);
+		}
+		end_of_line = FALSE;
+		while (offset < start || !end_of_line) {
+			if ((c = read_byte_checking_irs(input_stream, irs, irslen, window, &end_of_line)) == EOF) {
+				free(window);
+				return offset;
+			}
+			offset++;
+			if (end_of_line && offset >= start)
+				break;
+		}
+	}
+
+	// Copies the lines starting before the end offset.
+	while (end < 0LL || offset < end) {
+		do {
+			if ((c = read_byte_checking_irs(input_stream, irs, irslen, window, &end_of_line)) == EOF) {
+				free(window);
+				return offset;
+			}
+			putc(c, output_stream);
+			offset++;
+		} while (!end_of_line);
+	}
+	free(window);
+	return offset;
+}
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "cli/comment_handling.h"
 #include "lib/context.h"
+#include "input/file_reader_mmap.h"
 
 // Notes:
 // * The caller should free the return value.
@@ -67,4 +68,48 @@ char* mlr_alloc_read_line_multiple_delimiter_stripping_comments_aux(
 	char*              comment_string,
 	int*               pnum_lines_comment_skipped); // Lets caller track line numbers
 
+// Counts the lines which repeated calls to mlr_alloc_read_line_single_delimiter would return, including
+// its line-ending autodetection, but reading the stream in blocks without copying lines out.
+long long mlr_count_lines_single_delimiter(
+	FILE*      fp,
+	int        delimiter,
+	int        do_auto_line_term,
+	context_t* pctx);
+
+// Counts the records in the rest of an mmapped file for line-oriented readers, one per IRS-terminated line
+// (the last line may be unterminated), skipping or passing comment lines the same way those readers do, and
+// autodetecting the line ending from the first record.
+long long mlr_count_lines_mmap(
+	file_reader_mmap_state_t* phandle,
+	char*                     irs,
+	int                       irslen,
+	int                       do_auto_line_term,
+	comment_handling_t        comment_handling,
+	char*                     comment_string,
+	context_t*                pctx);
+
+// Finds the start of the last num_lines lines of an mmapped file, as mlr_count_lines_mmap would count them,
+// by reading backward from end of file to the file's current position: which it returns if there are fewer.
+// Returns NULL if IRS can overlap itself (e.g. ";;"), since then reading backward can split lines differently.
+char* mlr_find_last_lines_mmap(
+	file_reader_mmap_state_t* phandle,
+	char*                     irs,
+	int                       irslen,
+	char*                     comment_string,
+	long long                 num_lines);
+
+// Whether a line could end in the middle of IRS, e.g. ";;" in ";;;".
+int mlr_irs_overlaps_itself(char* irs, int irslen);
+
+// For byte-range reading: the byte offset of the first line of an mmapped file starting at or after the
+// given offset, or the file's size if there's none. IRS must not overlap itself.
+long long mlr_find_line_start_mmap(file_reader_mmap_state_t* phandle, char* irs, int irslen, long long offset);
+
+// For byte-range reading with stdio: copies to the output stream the lines of the input stream starting
+// at or after byte offset start and before byte offset end (or through end of stream, if end is -1), after
+// the input's first line other than comment lines, if with_header. IRS must not overlap itself. Returns
+// how far it read.
+long long mlr_copy_line_range_stdio(FILE* input_stream, FILE* output_stream, char* irs, int irslen,
+	int with_header, char* comment_string, long long start, long long end);
+
 #endif // LINE_READERS_H
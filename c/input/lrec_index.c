@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "lib/bin_format.h"
+#include "input/lrec_index.h"
+
+// Nanosecond timestamps are st_mtim and st_ctim in POSIX.1-2008, but st_mtimespec and st_ctimespec on macOS.
+#ifdef __APPLE__
+#define MLR_STAT_MTIME_NSEC(pstatbuf) ((pstatbuf)->st_mtimespec.tv_nsec)
+#define MLR_STAT_CTIME_NSEC(pstatbuf) ((pstatbuf)->st_ctimespec.tv_nsec)
+#else
+#define MLR_STAT_MTIME_NSEC(pstatbuf) ((pstatbuf)->st_mtim.tv_nsec)
+#define MLR_STAT_CTIME_NSEC(pstatbuf) ((pstatbuf)->st_ctim.tv_nsec)
+#endif
+
+static char* lrec_index_alloc_filename(char* filename);
+static char* lrec_index_alloc_signature(cli_reader_opts_t* preader_opts);
+static int lrec_index_stamp_file(char* filename, lrec_index_stamp_t* pstamp);
+static int lrec_index_stamps_equal(lrec_index_stamp_t* pa, lrec_index_stamp_t* pb);
+static lrec_index_t* lrec_index_decode(unsigned char* p, unsigned char* end, char* signature,
+	lrec_index_stamp_t* pstamp);
+
+// ----------------------------------------------------------------
+lrec_index_t* lrec_index_load(char* filename, cli_reader_opts_t* preader_opts) {
+	lrec_index_stamp_t stamp, index_stamp;
+	if (!lrec_index_stamp_file(filename, &stamp))
+		return NULL;
+	char* index_filename = lrec_index_alloc_filename(filename);
+	if (!lrec_index_stamp_file(index_filename, &index_stamp)) {
+		free(index_filename);
+		return NULL;
+	}
+	// If the data file was modified no earlier than the index was written, as when both happen within one
+	// tick of the filesystem's clock, the index may be for what was there before.
+	if (stamp.mtime_sec > index_stamp.mtime_sec
+		|| (stamp.mtime_sec == index_stamp.mtime_sec && stamp.mtime_nsec >= index_stamp.mtime_nsec))
+	{
+		fprintf(stderr, "%s: ignoring index \"%s\", which is no newer than the data file.\n",
+			MLR_GLOBALS.bargv0, index_filename);
+		free(index_filename);
+		return NULL;
+	}
+	size_t size;
+	char* contents = (get_file_size(index_filename) == (ssize_t)(-1))
+		? NULL
+		: read_file_into_memory(index_filename, &size);
+	if (contents == NULL) {
+		free(index_filename);
+		return NULL;
+	}
+
+	char* signature = lrec_index_alloc_signature(preader_opts);
+	lrec_index_t* pindex = lrec_index_decode((unsigned char*)contents, (unsigned char*)contents + size,
+		signature, &stamp);
+	if (pindex == NULL)
+		fprintf(stderr, "%s: ignoring index \"%s\", which is out of date or for other input options.\n",
+			MLR_GLOBALS.bargv0, index_filename);
+	free(signature);
+	free(contents);
+	free(index_filename);
+	return pindex;
+}
+
+// Returns NULL if the index doesn't match the data file or reader options, or is corrupt.
+static lrec_index_t* lrec_index_decode(unsigned char* p, unsigned char* end, char* signature,
+	lrec_index_stamp_t* pstamp)
+{
+	unsigned long long length, zmtime_sec, mtime_nsec, zctime_sec, ctime_nsec, num_records, num_entries;
+	lrec_index_stamp_t index_stamp;
+	if (end - p < MLR_INDEX_HEADER_LENGTH || memcmp(p, MLR_INDEX_HEADER, MLR_INDEX_HEADER_LENGTH) != 0)
+		return NULL;
+	p += MLR_INDEX_HEADER_LENGTH;
+	char* index_signature;
+	if (!mlr_bin_get_varint(&p, end, &length) || (index_signature = mlr_bin_get_string(&p, end, length)) == NULL)
+		return NULL;
+	if (!streq(index_signature, signature))
+		return NULL;
+	if (!mlr_bin_get_varint(&p, end, &index_stamp.size) || !mlr_bin_get_varint(&p, end, &index_stamp.inode)
+		|| !mlr_bin_get_varint(&p, end, &zmtime_sec) || !mlr_bin_get_varint(&p, end, &mtime_nsec)
+		|| !mlr_bin_get_varint(&p, end, &zctime_sec) || !mlr_bin_get_varint(&p, end, &ctime_nsec))
+		return NULL;
+	index_stamp.mtime_sec  = mlr_bin_unzigzag(zmtime_sec);
+	index_stamp.mtime_nsec = mtime_nsec;
+	index_stamp.ctime_sec  = mlr_bin_unzigzag(zctime_sec);
+	index_stamp.ctime_nsec = ctime_nsec;
+	if (!lrec_index_stamps_equal(&index_stamp, pstamp))
+		return NULL;
+	if (!mlr_bin_get_varint(&p, end, &num_records) || !mlr_bin_get_varint(&p, end, &num_entries))
+		return NULL;
+	// Each entry takes at least three bytes, which bounds the number for a corrupt index.
+	if (num_entries == 0ULL || num_entries > (unsigned long long)(end - p) / 3)
+		return NULL;
+
+	lrec_index_t* pindex = lrec_index_alloc();
+	pindex->num_records = num_records;
+	long long record_number = 0LL;
+	long long offset = 0LL;
+	for (unsigned long long i = 0; i < num_entries; i++) {
+		unsigned long long drecord_number, doffset, zheader_offset;
+		if (!mlr_bin_get_varint(&p, end, &drecord_number) || !mlr_bin_get_varint(&p, end, &doffset)
+			|| !mlr_bin_get_varint(&p, end, &zheader_offset))
+		{
+			lrec_index_free(pindex);
+			return NULL;
+		}
+		record_number += drecord_number;
+		offset += doffset;
+		long long header_offset = mlr_bin_unzigzag(zheader_offset);
+		if (record_number > (long long)num_records || offset > (long long)index_stamp.size
+			|| header_offset > offset)
+		{
+			lrec_index_free(pindex);
+			return NULL;
+		}
+		lrec_index_note(pindex, record_number, offset, header_offset);
+	}
+	if (p != end || pindex->entries[0].record_number != 0LL) {
+		lrec_index_free(pindex);
+		return NULL;
+	}
+	return pindex;
+}
+
+// ----------------------------------------------------------------
+lrec_index_t* lrec_index_alloc() {
+	lrec_index_t* pindex = mlr_malloc_or_die(sizeof(lrec_index_t));
+	pindex->num_records = 0LL;
+	pindex->num_entries = 0LL;
+	pindex->capacity    = 1024LL;
+	pindex->entries     = mlr_malloc_or_die(pindex->capacity * sizeof(lrec_index_entry_t));
+	memset(&pindex->stamp, 0, sizeof(pindex->stamp));
+	return pindex;
+}
+
+lrec_index_t* lrec_index_alloc_for_file(char* filename) {
+	lrec_index_t* pindex = lrec_index_alloc();
+	if (!lrec_index_stamp_file(filename, &pindex->stamp)) {
+		perror("stat");
+		fprintf(stderr, "%s: could not stat \"%s\".\n", MLR_GLOBALS.bargv0, filename);
+		exit(1);
+	}
+	return pindex;
+}
+
+void lrec_index_note(lrec_index_t* pindex, long long record_number, long long offset, long long header_offset) {
+	if (pindex->num_entries >= pindex->capacity) {
+		pindex->capacity *= 2;
+		pindex->entries = mlr_realloc_or_die(pindex->entries, pindex->capacity * sizeof(lrec_index_entry_t));
+	}
+	lrec_index_entry_t* pentry = &pindex->entries[pindex->num_entries++];
+	pentry->record_number = record_number;
+	pentry->offset        = offset;
+	pentry->header_offset = header_offset;
+}
+
+// The index is written to a temp file then renamed, so that concurrent runs see either the old index or
+// the new one.
+void lrec_index_write(lrec_index_t* pindex, char* filename, cli_reader_opts_t* preader_opts) {
+	lrec_index_stamp_t stamp;
+	if (!lrec_index_stamp_file(filename, &stamp)) {
+		perror("stat");
+		fprintf(stderr, "%s: could not stat \"%s\".\n", MLR_GLOBALS.bargv0, filename);
+		exit(1);
+	}
+	if (!lrec_index_stamps_equal(&stamp, &pindex->stamp)) {
+		fprintf(stderr, "%s: not indexing \"%s\", which changed while being read.\n",
+			MLR_GLOBALS.bargv0, filename);
+		return;
+	}
+	char* index_filename = lrec_index_alloc_filename(filename);
+	char* tempname = alloc_suffixed_temp_file_name(index_filename);
+	FILE* output_stream = fopen(tempname, "wb");
+	if (output_stream == NULL) {
+		perror("fopen");
+		fprintf(stderr, "%s: Could not open \"%s\" for write.\n", MLR_GLOBALS.bargv0, tempname);
+		exit(1);
+	}
+
+	unsigned char buf[80];
+	char* signature = lrec_index_alloc_signature(preader_opts);
+	size_t signature_length = strlen(signature);
+	fwrite(MLR_INDEX_HEADER, 1, MLR_INDEX_HEADER_LENGTH, output_stream);
+	fwrite(buf, 1, mlr_bin_put_varint(buf, signature_length), output_stream);
+	fwrite(signature, 1, signature_length + 1, output_stream);
+	int n = mlr_bin_put_varint(buf, stamp.size);
+	n += mlr_bin_put_varint(&buf[n], stamp.inode);
+	n += mlr_bin_put_varint(&buf[n], mlr_bin_zigzag(stamp.mtime_sec));
+	n += mlr_bin_put_varint(&buf[n], stamp.mtime_nsec);
+	n += mlr_bin_put_varint(&buf[n], mlr_bin_zigzag(stamp.ctime_sec));
+	n += mlr_bin_put_varint(&buf[n], stamp.ctime_nsec);
+	n += mlr_bin_put_varint(&buf[n], pindex->num_records);
+	n += mlr_bin_put_varint(&buf[n], pindex->num_entries);
+	fwrite(buf, 1, n, output_stream);
+
+	long long record_number = 0LL;
+	long long offset = 0LL;
+	for (long long i = 0; i < pindex->num_entries; i++) {
+		lrec_index_entry_t* pentry = &pindex->entries[i];
+		n = mlr_bin_put_varint(buf, pentry->record_number - record_number);
+		n += mlr_bin_put_varint(&buf[n], pentry->offset - offset);
+		n += mlr_bin_put_varint(&buf[n], mlr_bin_zigzag(pentry->header_offset));
+		fwrite(buf, 1, n, output_stream);
+		record_number = pentry->record_number;
+		offset = pentry->offset;
+	}
+
+	if (fclose(output_stream) != 0) {
+		perror("fclose");
+		fprintf(stderr, "%s: Could not write \"%s\".\n", MLR_GLOBALS.bargv0, tempname);
+		exit(1);
+	}
+	if (rename(tempname, index_filename) != 0) {
+		perror("rename");
+		fprintf(stderr, "%s: Could not rename \"%s\" to \"%s\".\n", MLR_GLOBALS.bargv0, tempname, index_filename);
+		exit(1);
+	}
+	free(signature);
+	free(tempname);
+	free(index_filename);
+}
+
+// ----------------------------------------------------------------
+void lrec_index_free(lrec_index_t* pindex) {
+	if (pindex == NULL)
+		return;
+	free(pindex->entries);
+	free(pindex);
+}
+
+// ----------------------------------------------------------------
+// Binary search: entries[0] is for record 0.
+lrec_index_entry_t* lrec_index_find(lrec_index_t* pindex, long long record_number) {
+	long long lo = 0LL;
+	long long hi = pindex->num_entries - 1;
+	while (lo < hi) {
+		long long mid = lo + (hi - lo + 1) / 2;
+		if (pindex->entries[mid].record_number <= record_number)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return &pindex->entries[lo];
+}
+
+// ----------------------------------------------------------------
+static int lrec_index_stamp_file(char* filename, lrec_index_stamp_t* pstamp) {
+	struct stat statbuf;
+	if (stat(filename, &statbuf) < 0)
+		return FALSE;
+	pstamp->size       = statbuf.st_size;
+	pstamp->inode      = statbuf.st_ino;
+	pstamp->mtime_sec  = statbuf.st_mtime;
+	pstamp->mtime_nsec = MLR_STAT_MTIME_NSEC(&statbuf);
+	pstamp->ctime_sec  = statbuf.st_ctime;
+	pstamp->ctime_nsec = MLR_STAT_CTIME_NSEC(&statbuf);
+	return TRUE;
+}
+
+static int lrec_index_stamps_equal(lrec_index_stamp_t* pa, lrec_index_stamp_t* pb) {
+	return pa->size == pb->size && pa->inode == pb->inode
+		&& pa->mtime_sec == pb->mtime_sec && pa->mtime_nsec == pb->mtime_nsec
+		&& pa->ctime_sec == pb->ctime_sec && pa->ctime_nsec == pb->ctime_nsec;
+}
+
+// ----------------------------------------------------------------
+static char* lrec_index_alloc_filename(char* filename) {
+	return mlr_paste_2_strings(filename, MLR_INDEX_FILE_SUFFIX);
+}
+
+// The reader options which affect where records start, and what the reader carries from one to the next.
+static char* lrec_index_alloc_signature(cli_reader_opts_t* preader_opts) {
+	char* comment_string = preader_opts->comment_string == NULL ? "" : preader_opts->comment_string;
+	char* format = "%s\037%s\037%s\037%s\037%d\037%d\037%d\037%d\037%s";
+	int length = snprintf(NULL, 0, format, preader_opts->ifile_fmt, preader_opts->irs, preader_opts->ifs,
+		preader_opts->ips, preader_opts->allow_repeat_ifs, preader_opts->allow_repeat_ips,
+		preader_opts->use_implicit_csv_header, preader_opts->comment_handling, comment_string);
+	char* signature = mlr_malloc_or_die(length + 1);
+	snprintf(signature, length + 1, format, preader_opts->ifile_fmt, preader_opts->irs, preader_opts->ifs,
+		preader_opts->ips, preader_opts->allow_repeat_ifs, preader_opts->allow_repeat_ips,
+		preader_opts->use_implicit_csv_header, preader_opts->comment_handling, comment_string);
+	return signature;
+}
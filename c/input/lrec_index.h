@@ -0,0 +1,77 @@
+// ================================================================
+// Sidecar record indexes, written by mlr --build-index next to each input file
+// as FILE.mlri, for the mmap readers to seek to a given record number without
+// reading everything before it. An index holds the byte offset of every
+// so-many'th record, with what the reader needs to start there (see the tell
+// and seek methods in input/lrec_reader.h).
+//
+// An index is used only when it matches the data file's size, inode, and
+// modification and status-change times to the nanosecond, and the reader
+// options it was built with: else it's ignored. It's also ignored when the
+// data file's modification time isn't older than the index file's own, since
+// then the data may have changed after the index was written without its
+// timestamps showing it.
+//
+// Varints, zigzag integers and strings are encoded as in Miller's binary row
+// format: see lib/bin_format.h.
+//
+// * 'M' 'L' 'R' 'I' then a version byte.
+// * The reader options, as a string.
+// * The data file's size and inode, as varints, then its modification and
+//   status-change times, each as zigzag-varint seconds then varint nanoseconds.
+// * The number of records in the file, then the number of entries, as varints.
+// * Per entry: the record number and byte offset, as varint differences from
+//   the previous entry's, then the header offset, as a zigzag varint.
+// ================================================================
+
+#ifndef LREC_INDEX_H
+#define LREC_INDEX_H
+
+#include "cli/mlrcli.h"
+
+#define MLR_INDEX_FILE_SUFFIX ".mlri"
+#define MLR_INDEX_HEADER "MLRI\002"
+#define MLR_INDEX_HEADER_LENGTH 5
+
+#define DEFAULT_INDEX_STRIDE 1000LL
+
+typedef struct _lrec_index_entry_t {
+	long long record_number; // zero-up within the file
+	long long offset;
+	long long header_offset; // as from the reader's tell method
+} lrec_index_entry_t;
+
+// What's compared to tell whether the data file has changed since it was indexed.
+typedef struct _lrec_index_stamp_t {
+	unsigned long long size;
+	unsigned long long inode;
+	long long mtime_sec;
+	long long mtime_nsec;
+	long long ctime_sec;
+	long long ctime_nsec;
+} lrec_index_stamp_t;
+
+typedef struct _lrec_index_t {
+	lrec_index_stamp_t stamp; // of the data file, as of the start of building
+	long long num_records;
+	long long num_entries;
+	long long capacity;
+	lrec_index_entry_t* entries;
+} lrec_index_t;
+
+// Returns NULL if there's no index for the file, or if it isn't current.
+lrec_index_t* lrec_index_load(char* filename, cli_reader_opts_t* preader_opts);
+
+// For building. Entries are to be noted in increasing order of record number. The index is
+// allocated before the data file is read, and isn't written if the file changes meanwhile.
+lrec_index_t* lrec_index_alloc();
+lrec_index_t* lrec_index_alloc_for_file(char* filename);
+void lrec_index_note(lrec_index_t* pindex, long long record_number, long long offset, long long header_offset);
+void lrec_index_write(lrec_index_t* pindex, char* filename, cli_reader_opts_t* preader_opts);
+
+void lrec_index_free(lrec_index_t* pindex);
+
+// The last entry at or before the record number.
+lrec_index_entry_t* lrec_index_find(lrec_index_t* pindex, long long record_number);
+
+#endif // LREC_INDEX_H
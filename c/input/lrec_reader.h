@@ -3,7 +3,9 @@
 
 #include <stdio.h>
 #include "lib/context.h"
+#include "lib/mlrval.h"
 #include "containers/lrec.h"
+#include "containers/slls.h"
 #include "input/file_reader_mmap.h"
 
 struct _lrec_reader_t; // forward reference for method declarations
@@ -13,6 +15,29 @@ typedef void*   lrec_reader_open_func_t(void* pvstate, char* prepipe, char* file
 typedef void    lrec_reader_close_func_t(void* pvstate, void* pvhandle, char* prepipe);
 typedef lrec_t* lrec_reader_process_func_t(void* pvstate, void* pvhandle, context_t* pctx);
 typedef void    lrec_reader_sof_func_t(void* pvstate, void* pvhandle);
+// Reads to end of file without building records, returning how many there were. Errors are
+// reported as the process method would report them.
+typedef long long lrec_reader_count_func_t(void* pvstate, void* pvhandle, context_t* pctx);
+// For indexed input (see input/lrec_index.h), optionally for mmap readers: the byte offset at which the
+// next call to the process method will start reading, with what else the reader needs to start there
+// -- the byte offset of the header line in effect, or one of the LREC_READER_HEADER_* values below.
+// Seeking goes back to such a place, just after start of file, possibly in another run. For byte ranges, it
+// may also go to any line start along with the start-of-file header offset: then to the end of the header
+// line, if that's further.
+typedef long long lrec_reader_tell_func_t(void* pvstate, void* pvhandle, long long* pheader_offset);
+typedef void    lrec_reader_seek_func_t(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx);
+// For tail reading, optionally for mmap readers: just after start of file, skips ahead to the start of the
+// file's last num_records records, finding them by reading backward from end of file, so that the process
+// method returns only those. Returns FALSE, having skipped nothing, if the reader can't tell from the end
+// of the file where they start.
+typedef int     lrec_reader_seek_tail_func_t(void* pvstate, void* pvhandle, long long num_records, context_t* pctx);
+// For late materialization (see lrec_reader_span_sink_t below), optionally for mmap readers whose records depend
+// only on their own lines: reads again the record which the process method returned from bytes [offset, end)
+// of the file. It's parsed from a copy of those bytes, which the record owns, so that the file's contents
+// aren't written to and can be read from again. Returns NULL if there's no record there.
+typedef lrec_t* lrec_reader_reread_func_t(struct _lrec_reader_t* preader, void* pvhandle, long long offset,
+	long long end, context_t* pctx);
 typedef void    lrec_reader_free_func_t(struct _lrec_reader_t* preader);
 
 typedef struct _lrec_reader_t {
@@ -21,7 +46,98 @@ typedef struct _lrec_reader_t {
 	lrec_reader_close_func_t*   pclose_func;
 	lrec_reader_process_func_t* pprocess_func;
 	lrec_reader_sof_func_t*     psof_func;
+	lrec_reader_count_func_t*   pcount_func; // optional: null if the reader can't count without parsing
+	lrec_reader_tell_func_t*    ptell_func;  // optional: null if the reader can't be indexed
+	lrec_reader_seek_func_t*    pseek_func;  // likewise
+	lrec_reader_seek_tail_func_t* pseek_tail_func; // optional
+	lrec_reader_reread_func_t*  preread_func; // optional
 	lrec_reader_free_func_t*    pfree_func; // virtual destructor
 } lrec_reader_t;
 
+#define LREC_READER_HEADER_NONE (-1LL) // no header needed, e.g. DKVP
+#define LREC_READER_HEADER_NEXT (-2LL) // the next line is a header
+
+// A test on a few named fields, pushed down from the start of the mapper chain (e.g. mlr filter).
+// Readers supporting it call the test on a record holding at least those fields, and drop the
+// record if it returns FALSE. Owned by the mapper it came from.
+typedef int lrec_reader_predicate_func_t(void* pvstate, lrec_t* prec, context_t* pctx);
+// Optionally, for readers keeping numeric minima and maxima per block of records (e.g. the columnar
+// reader): returns TRUE if the test can pass no record whose named field is a number in [min, max],
+// so that the block can be skipped.
+typedef int lrec_reader_predicate_range_func_t(void* pvstate, char* field_name, double min, double max);
+
+typedef struct _lrec_reader_predicate_t {
+	slls_t*                             pfield_names;
+	lrec_reader_predicate_func_t*       ptest_func;
+	lrec_reader_predicate_range_func_t* pexcludes_range_func; // optional
+	void*                               pvstate;
+} lrec_reader_predicate_t;
+
+// For record-boundaries-only reading: when the start of the mapper chain needs only the number of
+// records and not their contents (e.g. mlr count, or mlr nothing), the stream driver has readers
+// supporting it count records, and passes the counts here in place of the records themselves.
+// Owned by the mapper it came from.
+typedef void lrec_reader_count_sink_func_t(void* pvstate, long long record_count, context_t* pctx);
+
+typedef struct _lrec_reader_count_sink_t {
+	lrec_reader_count_sink_func_t* pcount_func;
+	void*                          pvstate;
+} lrec_reader_count_sink_t;
+
+// For typed columnar input: when the start of the mapper chain only folds the values of a few named
+// fields into running totals, one field at a time and regardless of record boundaries (e.g. stats1
+// without -g), readers having them as typed numbers may pass them here, a block at a time, in place
+// of building records. Each call is for one of the named fields, in order, over the same records; a
+// call with no values stands for records lacking the field. Values are MT_INT or MT_FLOAT. Owned by
+// the mapper it came from.
+typedef void lrec_reader_number_sink_func_t(void* pvstate, char* field_name, mv_t* pvalues, int num_values,
+	context_t* pctx);
+
+typedef struct _lrec_reader_number_sink_t {
+	slls_t*                         pfield_names;
+	lrec_reader_number_sink_func_t* pnumbers_func;
+	void*                           pvstate;
+} lrec_reader_number_sink_t;
+
+// For indexed input: when the start of the mapper chain needs only some of the records, by position
+// (e.g. mlr tail without -g), which ones, given how many there are in all the input files together. The
+// stream driver asks when every input file has a current index (see input/lrec_index.h), then reads
+// just those records, counting the others in NR and FNR. The function returns how many zero-based
+// [start, end) record-number ranges it has allocated in *pranges, sorted and non-overlapping, which
+// the caller frees. Owned by the mapper it came from.
+typedef struct _lrec_reader_record_range_t {
+	long long start;
+	long long end;
+} lrec_reader_record_range_t;
+
+typedef int lrec_reader_record_ranges_func_t(void* pvstate, long long num_records,
+	lrec_reader_record_range_t** pranges);
+
+typedef struct _lrec_reader_record_ranges_t {
+	lrec_reader_record_ranges_func_t* pranges_func;
+	void*                             pvstate;
+} lrec_reader_record_ranges_t;
+
+// For late materialization: when the start of the mapper chain only reorders whole records by a few named
+// fields (e.g. mlr sort), the stream driver may, for readers able to read records again, pass records holding
+// only those fields along with where each came from, in place of whole records. The sink keeps the places
+// rather than the records. At end of stream it returns them in the order it wants the records output, in an
+// array which the caller frees, and the driver reads the records again from there, one at a time, for the
+// rest of the chain. Owned by the mapper it came from.
+typedef struct _lrec_reader_span_t {
+	long long offset;  // bytes [offset, end) of the file hold the record
+	long long end;
+	int       filenum; // as in the context
+} lrec_reader_span_t;
+
+typedef void      lrec_reader_span_func_t(void* pvstate, lrec_t* prec, lrec_reader_span_t* pspan, context_t* pctx);
+typedef long long lrec_reader_spans_func_t(void* pvstate, lrec_reader_span_t** pspans);
+
+typedef struct _lrec_reader_span_sink_t {
+	slls_t*                   pfield_names;
+	lrec_reader_span_func_t*  pspan_func;
+	lrec_reader_spans_func_t* pspans_func;
+	void*                     pvstate;
+} lrec_reader_span_sink_t;
+
 #endif // LREC_READER_H
@@ -0,0 +1,497 @@
+// ================================================================
+// Readers for Miller's columnar format: see lib/col_format.h. A row group is
+// taken in whole, then records are built a row at a time from just the
+// columns the mapper chain needs. Before that, a row group can be dealt with
+// without building records at all:
+// * skipped, if a pushed-down filter can't pass any of its rows given the
+//   numeric columns' minima and maxima;
+// * handed to the first mapper as typed numbers, if it has a number sink
+//   (e.g. stats1 without -g) and the columns it wants are numeric.
+//
+// The mmap reader points keys and string values into the file contents. The
+// stdio reader, for standard input and --no-mmap, reads each row group into a
+// buffer which is reused, so it copies them.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/col_format.h"
+#include "input/file_reader_mmap.h"
+#include "input/file_reader_stdio.h"
+#include "input/lrec_readers.h"
+
+// How many numbers at a time go to the number sink.
+#define NUMBER_BLOCK_LENGTH 1024
+
+typedef struct _lrec_reader_col_state_t {
+	int                saw_stream_header;
+	long long          offset;           // stdio: bytes read so far in the file
+	char*              start_of_file;    // mmap
+	int                copy_strings;     // stdio: records outlive the row group's buffer
+
+	// The current row group
+	long long          row_group_offset; // for error messages
+	unsigned char*     payload;          // stdio: reused from one row group to the next
+	unsigned long long payload_capacity;
+	mlr_col_column_t*  columns;
+	unsigned long long num_columns;
+	unsigned long long columns_capacity;
+	unsigned long long num_rows;
+	unsigned long long next_row;
+	int*               kept_columns;     // indices of the columns which go into records
+	unsigned char**    cursors;          // per kept column
+	int                num_kept_columns;
+
+	hss_t*                     pfield_projection;
+	lrec_reader_predicate_t*   precord_predicate;
+	lrec_reader_number_sink_t* pnumber_sink;
+	mv_t*                      numbers;
+} lrec_reader_col_state_t;
+
+static lrec_reader_col_state_t* lrec_reader_col_state_alloc(hss_t* pfield_projection,
+	lrec_reader_predicate_t* precord_predicate, lrec_reader_number_sink_t* pnumber_sink, int copy_strings);
+static void    lrec_reader_col_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_col_sof(void* pvstate, void* pvhandle);
+static void    lrec_reader_stdio_col_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_col_process(void* pvstate, void* pvhandle, context_t* pctx);
+static lrec_t* lrec_reader_stdio_col_process(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_col_count(void* pvstate, void* pvhandle, context_t* pctx);
+static unsigned char* lrec_reader_mmap_col_next_row_group(lrec_reader_col_state_t* pstate,
+	file_reader_mmap_state_t* phandle, unsigned long long* pnum_rows, unsigned char** ppayload_end,
+	context_t* pctx);
+static int     lrec_reader_stdio_col_next_row_group(lrec_reader_col_state_t* pstate, FILE* input_stream,
+	context_t* pctx);
+static int     read_varint(lrec_reader_col_state_t* pstate, FILE* input_stream, unsigned long long* pvalue);
+static void    lrec_reader_col_get_directory(lrec_reader_col_state_t* pstate, unsigned char* p, unsigned char* end,
+	context_t* pctx);
+static void    lrec_reader_col_start_row_group(lrec_reader_col_state_t* pstate, unsigned long long num_rows,
+	context_t* pctx);
+static int     lrec_reader_col_excludes_row_group(lrec_reader_col_state_t* pstate);
+static int     lrec_reader_col_sink_row_group(lrec_reader_col_state_t* pstate, context_t* pctx);
+static lrec_t* lrec_reader_col_next_record(lrec_reader_col_state_t* pstate, context_t* pctx);
+static mlr_col_column_t* find_column(lrec_reader_col_state_t* pstate, char* field_name);
+static void    not_columnar(context_t* pctx);
+static void    data_corrupt(lrec_reader_col_state_t* pstate, context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_col_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate,
+	lrec_reader_number_sink_t* pnumber_sink)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	plrec_reader->pvstate       = lrec_reader_col_state_alloc(pfield_projection, precord_predicate, pnumber_sink,
+		FALSE);
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	plrec_reader->pprocess_func = lrec_reader_mmap_col_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_col_sof;
+	plrec_reader->pcount_func   = lrec_reader_mmap_col_count;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_col_free;
+
+	return plrec_reader;
+}
+
+lrec_reader_t* lrec_reader_stdio_col_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate,
+	lrec_reader_number_sink_t* pnumber_sink)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	plrec_reader->pvstate       = lrec_reader_col_state_alloc(pfield_projection, precord_predicate, pnumber_sink,
+		TRUE);
+	plrec_reader->popen_func    = file_reader_stdio_vopen;
+	plrec_reader->pclose_func   = file_reader_stdio_vclose;
+	plrec_reader->pprocess_func = lrec_reader_stdio_col_process;
+	plrec_reader->psof_func     = lrec_reader_stdio_col_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_col_free;
+
+	return plrec_reader;
+}
+
+static lrec_reader_col_state_t* lrec_reader_col_state_alloc(hss_t* pfield_projection,
+	lrec_reader_predicate_t* precord_predicate, lrec_reader_number_sink_t* pnumber_sink, int copy_strings)
+{
+	lrec_reader_col_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_col_state_t));
+	pstate->saw_stream_header = FALSE;
+	pstate->offset            = 0LL;
+	pstate->start_of_file     = NULL;
+	pstate->copy_strings      = copy_strings;
+	pstate->row_group_offset  = 0LL;
+	pstate->payload           = NULL;
+	pstate->payload_capacity  = 0ULL;
+	pstate->columns_capacity  = 16;
+	pstate->columns           = mlr_malloc_or_die(pstate->columns_capacity * sizeof(mlr_col_column_t));
+	pstate->kept_columns      = mlr_malloc_or_die(pstate->columns_capacity * sizeof(int));
+	pstate->cursors           = mlr_malloc_or_die(pstate->columns_capacity * sizeof(unsigned char*));
+	pstate->num_columns       = 0ULL;
+	pstate->num_kept_columns  = 0;
+	pstate->num_rows          = 0ULL;
+	pstate->next_row          = 0ULL;
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
+	pstate->pnumber_sink      = pnumber_sink;
+	pstate->numbers           = (pnumber_sink == NULL) ? NULL : mlr_malloc_or_die(NUMBER_BLOCK_LENGTH * sizeof(mv_t));
+	return pstate;
+}
+
+static void lrec_reader_col_free(lrec_reader_t* preader) {
+	lrec_reader_col_state_t* pstate = preader->pvstate;
+	free(pstate->payload);
+	free(pstate->columns);
+	free(pstate->kept_columns);
+	free(pstate->cursors);
+	free(pstate->numbers);
+	free(pstate);
+	free(preader);
+}
+
+static void lrec_reader_mmap_col_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_col_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	pstate->start_of_file = phandle->sol;
+	pstate->saw_stream_header = FALSE;
+	pstate->num_rows = pstate->next_row = 0ULL;
+}
+
+static void lrec_reader_stdio_col_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_col_state_t* pstate = pvstate;
+	pstate->offset = 0LL;
+	pstate->saw_stream_header = FALSE;
+	pstate->num_rows = pstate->next_row = 0ULL;
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_col_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_col_state_t* pstate = pvstate;
+	while (TRUE) {
+		if (pstate->next_row >= pstate->num_rows) {
+			unsigned long long num_rows;
+			unsigned char* end;
+			unsigned char* p = lrec_reader_mmap_col_next_row_group(pstate, pvhandle, &num_rows, &end, pctx);
+			if (p == NULL)
+				return NULL;
+			lrec_reader_col_get_directory(pstate, p, end, pctx);
+			lrec_reader_col_start_row_group(pstate, num_rows, pctx);
+			continue;
+		}
+		lrec_t* prec = lrec_reader_col_next_record(pstate, pctx);
+		if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+}
+
+static lrec_t* lrec_reader_stdio_col_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_col_state_t* pstate = pvstate;
+	while (TRUE) {
+		if (pstate->next_row >= pstate->num_rows) {
+			if (!lrec_reader_stdio_col_next_row_group(pstate, pvhandle, pctx))
+				return NULL;
+			continue;
+		}
+		lrec_t* prec = lrec_reader_col_next_record(pstate, pctx);
+		if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+}
+
+// Row groups' directories are checked, but their columns aren't decoded.
+static long long lrec_reader_mmap_col_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_col_state_t* pstate = pvstate;
+	long long count = 0LL;
+	unsigned long long num_rows;
+	unsigned char* end;
+	unsigned char* p;
+	while ((p = lrec_reader_mmap_col_next_row_group(pstate, pvhandle, &num_rows, &end, pctx)) != NULL) {
+		lrec_reader_col_get_directory(pstate, p, end, pctx);
+		count += num_rows;
+	}
+	return count;
+}
+
+// ----------------------------------------------------------------
+// Steps over stream headers, and returns the start of the next row group's payload, with its number of
+// rows and the end of the payload, or NULL at end of file.
+static unsigned char* lrec_reader_mmap_col_next_row_group(lrec_reader_col_state_t* pstate,
+	file_reader_mmap_state_t* phandle, unsigned long long* pnum_rows, unsigned char** ppayload_end,
+	context_t* pctx)
+{
+	unsigned char* eof = (unsigned char*)phandle->eof;
+	while (TRUE) {
+		unsigned char* pitem = (unsigned char*)phandle->sol;
+		if (pitem >= eof)
+			return NULL;
+		pstate->row_group_offset = (char*)pitem - pstate->start_of_file;
+
+		if (*pitem == MLR_COL_TAG_STREAM_HEADER) {
+			if (eof - pitem < MLR_COL_STREAM_HEADER_LENGTH
+				|| memcmp(pitem, MLR_COL_STREAM_HEADER, MLR_COL_STREAM_HEADER_LENGTH - 1) != 0)
+			{
+				not_columnar(pctx);
+			}
+			if (pitem[MLR_COL_STREAM_HEADER_LENGTH - 1] != MLR_COL_VERSION) {
+				fprintf(stderr, "%s: unsupported columnar-format version %d in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, pitem[MLR_COL_STREAM_HEADER_LENGTH - 1], pctx->filename);
+				exit(1);
+			}
+			pstate->saw_stream_header = TRUE;
+			phandle->sol = (char*)pitem + MLR_COL_STREAM_HEADER_LENGTH;
+			continue;
+		}
+
+		if (!pstate->saw_stream_header)
+			not_columnar(pctx);
+		unsigned char* p = pitem + 1;
+		unsigned long long payload_length;
+		if (*pitem != MLR_COL_TAG_ROW_GROUP
+			|| !mlr_bin_get_varint(&p, eof, pnum_rows) || !mlr_bin_get_varint(&p, eof, &payload_length)
+			|| payload_length > (unsigned long long)(eof - p))
+		{
+			data_corrupt(pstate, pctx);
+		}
+		phandle->sol = (char*)p + payload_length;
+		*ppayload_end = p + payload_length;
+		return p;
+	}
+}
+
+// Reads the next row group into the payload buffer and starts on it. Returns FALSE at end of file.
+static int lrec_reader_stdio_col_next_row_group(lrec_reader_col_state_t* pstate, FILE* input_stream,
+	context_t* pctx)
+{
+	while (TRUE) {
+		pstate->row_group_offset = pstate->offset;
+		int tag = getc(input_stream);
+		if (tag == EOF)
+			return FALSE;
+		pstate->offset++;
+
+		if (tag == MLR_COL_TAG_STREAM_HEADER) {
+			char header[MLR_COL_STREAM_HEADER_LENGTH];
+			header[0] = tag;
+			if (fread(&header[1], 1, MLR_COL_STREAM_HEADER_LENGTH - 1, input_stream) != MLR_COL_STREAM_HEADER_LENGTH - 1
+				|| memcmp(header, MLR_COL_STREAM_HEADER, MLR_COL_STREAM_HEADER_LENGTH - 1) != 0)
+			{
+				not_columnar(pctx);
+			}
+			if (header[MLR_COL_STREAM_HEADER_LENGTH - 1] != MLR_COL_VERSION) {
+				fprintf(stderr, "%s: unsupported columnar-format version %d in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, header[MLR_COL_STREAM_HEADER_LENGTH - 1], pctx->filename);
+				exit(1);
+			}
+			pstate->offset += MLR_COL_STREAM_HEADER_LENGTH - 1;
+			pstate->saw_stream_header = TRUE;
+			continue;
+		}
+
+		if (!pstate->saw_stream_header)
+			not_columnar(pctx);
+		unsigned long long num_rows, payload_length;
+		if (tag != MLR_COL_TAG_ROW_GROUP
+			|| !read_varint(pstate, input_stream, &num_rows) || !read_varint(pstate, input_stream, &payload_length))
+		{
+			data_corrupt(pstate, pctx);
+		}
+		if (payload_length > pstate->payload_capacity) {
+			free(pstate->payload);
+			pstate->payload_capacity = payload_length;
+			pstate->payload = mlr_malloc_or_die(pstate->payload_capacity);
+		}
+		if (fread(pstate->payload, 1, payload_length, input_stream) != payload_length)
+			data_corrupt(pstate, pctx);
+		pstate->offset += payload_length;
+
+		lrec_reader_col_get_directory(pstate, pstate->payload, pstate->payload + payload_length, pctx);
+		lrec_reader_col_start_row_group(pstate, num_rows, pctx);
+		return TRUE;
+	}
+}
+
+static int read_varint(lrec_reader_col_state_t* pstate, FILE* input_stream, unsigned long long* pvalue) {
+	unsigned long long value = 0ULL;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc(input_stream);
+		if (c == EOF)
+			return FALSE;
+		pstate->offset++;
+		value |= (unsigned long long)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*pvalue = value;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_col_get_directory(lrec_reader_col_state_t* pstate, unsigned char* p, unsigned char* end,
+	context_t* pctx)
+{
+	if (!mlr_col_get_num_columns(&p, end, &pstate->num_columns))
+		data_corrupt(pstate, pctx);
+	if (pstate->num_columns > pstate->columns_capacity) {
+		pstate->columns_capacity = pstate->num_columns;
+		pstate->columns = mlr_realloc_or_die(pstate->columns, pstate->columns_capacity * sizeof(mlr_col_column_t));
+		pstate->kept_columns = mlr_realloc_or_die(pstate->kept_columns, pstate->columns_capacity * sizeof(int));
+		pstate->cursors = mlr_realloc_or_die(pstate->cursors, pstate->columns_capacity * sizeof(unsigned char*));
+	}
+	if (!mlr_col_get_directory(p, end, pstate->num_columns, pstate->columns))
+		data_corrupt(pstate, pctx);
+}
+
+// Sets up for building records from the row group, unless it can be skipped or sent to the number sink.
+static void lrec_reader_col_start_row_group(lrec_reader_col_state_t* pstate, unsigned long long num_rows,
+	context_t* pctx)
+{
+	pstate->num_rows = num_rows;
+	pstate->next_row = 0ULL;
+	if (num_rows == 0ULL)
+		return;
+
+	if (lrec_reader_col_excludes_row_group(pstate) || lrec_reader_col_sink_row_group(pstate, pctx)) {
+		// As for records dropped one at a time.
+		pctx->nr  += num_rows;
+		pctx->fnr += num_rows;
+		pstate->num_rows = 0ULL;
+		return;
+	}
+
+	pstate->num_kept_columns = 0;
+	for (unsigned long long i = 0; i < pstate->num_columns; i++) {
+		mlr_col_column_t* pcolumn = &pstate->columns[i];
+		if (pstate->pfield_projection == NULL || hss_has(pstate->pfield_projection, pcolumn->field_name)) {
+			pstate->kept_columns[pstate->num_kept_columns] = i;
+			pstate->cursors[pstate->num_kept_columns] = pcolumn->block;
+			pstate->num_kept_columns++;
+		}
+	}
+}
+
+// True if the pushed-down filter can't pass any row, going by the minima and maxima of the numeric
+// columns it looks at.
+static int lrec_reader_col_excludes_row_group(lrec_reader_col_state_t* pstate) {
+	lrec_reader_predicate_t* ppredicate = pstate->precord_predicate;
+	if (ppredicate == NULL || ppredicate->pexcludes_range_func == NULL)
+		return FALSE;
+	for (sllse_t* pe = ppredicate->pfield_names->phead; pe != NULL; pe = pe->pnext) {
+		mlr_col_column_t* pcolumn = find_column(pstate, pe->value);
+		if (pcolumn == NULL)
+			continue;
+		double min, max;
+		if (pcolumn->type == MLR_COL_TYPE_FLOAT) {
+			min = pcolumn->fmin;
+			max = pcolumn->fmax;
+		} else if (pcolumn->type == MLR_COL_TYPE_INT
+			&& pcolumn->imin >= -MLR_COL_MAX_EXACT_INT && pcolumn->imax <= MLR_COL_MAX_EXACT_INT)
+		{
+			min = pcolumn->imin;
+			max = pcolumn->imax;
+		} else {
+			continue;
+		}
+		if (ppredicate->pexcludes_range_func(ppredicate->pvstate, pe->value, min, max))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+// If the columns the number sink wants are all numeric or absent, sends them there and returns TRUE.
+static int lrec_reader_col_sink_row_group(lrec_reader_col_state_t* pstate, context_t* pctx) {
+	lrec_reader_number_sink_t* psink = pstate->pnumber_sink;
+	if (psink == NULL || pstate->precord_predicate != NULL)
+		return FALSE;
+	for (sllse_t* pe = psink->pfield_names->phead; pe != NULL; pe = pe->pnext) {
+		mlr_col_column_t* pcolumn = find_column(pstate, pe->value);
+		if (pcolumn != NULL && pcolumn->type == MLR_COL_TYPE_STRING)
+			return FALSE;
+	}
+
+	for (sllse_t* pe = psink->pfield_names->phead; pe != NULL; pe = pe->pnext) {
+		mlr_col_column_t* pcolumn = find_column(pstate, pe->value);
+		if (pcolumn == NULL) {
+			psink->pnumbers_func(psink->pvstate, pe->value, NULL, 0, pctx);
+			continue;
+		}
+		unsigned char* p = pcolumn->block;
+		unsigned long long num_left = pstate->num_rows;
+		while (num_left > 0) {
+			int n = (num_left < NUMBER_BLOCK_LENGTH) ? num_left : NUMBER_BLOCK_LENGTH;
+			for (int i = 0; i < n; i++) {
+				if (pcolumn->type == MLR_COL_TYPE_INT) {
+					unsigned long long u;
+					if (!mlr_bin_get_varint(&p, pcolumn->block_end, &u))
+						data_corrupt(pstate, pctx);
+					pstate->numbers[i] = mv_from_int(mlr_bin_unzigzag(u));
+				} else {
+					double value;
+					int decimals;
+					if (!mlr_col_get_float(&p, pcolumn->block_end, &value, &decimals))
+						data_corrupt(pstate, pctx);
+					pstate->numbers[i] = (decimals == 0) ? mv_from_int((long long)value) : mv_from_float(value);
+				}
+			}
+			psink->pnumbers_func(psink->pvstate, pe->value, pstate->numbers, n, pctx);
+			num_left -= n;
+		}
+		if (p != pcolumn->block_end)
+			data_corrupt(pstate, pctx);
+	}
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_col_next_record(lrec_reader_col_state_t* pstate, context_t* pctx) {
+	lrec_t* prec = lrec_unbacked_alloc();
+	for (int k = 0; k < pstate->num_kept_columns; k++) {
+		mlr_col_column_t* pcolumn = &pstate->columns[pstate->kept_columns[k]];
+		char free_flags;
+		char* value = mlr_col_get_value(pcolumn, &pstate->cursors[k], &free_flags);
+		if (value == NULL)
+			data_corrupt(pstate, pctx);
+		char* key = pcolumn->field_name;
+		if (pstate->copy_strings) {
+			key = mlr_strdup_or_die(key);
+			if (!(free_flags & FREE_ENTRY_VALUE))
+				value = mlr_strdup_or_die(value);
+			free_flags = FREE_ENTRY_KEY | FREE_ENTRY_VALUE;
+		}
+		// Field names are checked to be distinct within the row group.
+		lrec_put_new_key(prec, key, value, free_flags);
+	}
+
+	pstate->next_row++;
+	if (pstate->next_row == pstate->num_rows) {
+		for (int k = 0; k < pstate->num_kept_columns; k++)
+			if (pstate->cursors[k] != pstate->columns[pstate->kept_columns[k]].block_end)
+				data_corrupt(pstate, pctx);
+	}
+	return prec;
+}
+
+static mlr_col_column_t* find_column(lrec_reader_col_state_t* pstate, char* field_name) {
+	for (unsigned long long i = 0; i < pstate->num_columns; i++)
+		if (streq(pstate->columns[i].field_name, field_name))
+			return &pstate->columns[i];
+	return NULL;
+}
+
+static void not_columnar(context_t* pctx) {
+	fprintf(stderr, "%s: file \"%s\" is not in Miller's columnar format.\n",
+		MLR_GLOBALS.bargv0, pctx->filename);
+	exit(1);
+}
+
+static void data_corrupt(lrec_reader_col_state_t* pstate, context_t* pctx) {
+	fprintf(stderr, "%s: data corrupt or truncated in row group at byte offset %lld in columnar-format file \"%s\".\n",
+		MLR_GLOBALS.bargv0, pstate->row_group_offset, pctx->filename);
+	exit(1);
+}
@@ -37,6 +37,11 @@ lrec_reader_t* lrec_reader_gen_alloc(char* field_name,
 	plrec_reader->pclose_func   = lrec_reader_gen_close;
 	plrec_reader->pprocess_func = lrec_reader_gen_process;
 	plrec_reader->psof_func     = lrec_reader_gen_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_gen_free;
 
 	return plrec_reader;
@@ -29,6 +29,11 @@ lrec_reader_t* lrec_reader_in_memory_alloc(sllv_t* precords) {
 	plrec_reader->pclose_func   = lrec_reader_in_memory_vclose;
 	plrec_reader->pprocess_func = lrec_reader_in_memory_process;
 	plrec_reader->psof_func     = lrec_reader_in_memory_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_in_memory_free;
 
 	return plrec_reader;
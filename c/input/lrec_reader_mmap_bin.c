@@ -0,0 +1,278 @@
+// ================================================================
+// Reader for Miller's binary row format: see lib/bin_format.h. Keys and
+// string values point right into the mmapped file contents, which carry their
+// own NUL terminators, so a record costs only the lrec itself and its entries.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/bin_format.h"
+#include "input/file_reader_mmap.h"
+#include "input/lrec_readers.h"
+
+typedef struct _bin_schema_t {
+	unsigned long long num_fields;
+	char** field_names;
+	char*  keeps; // with projection pushdown: which fields to put in the record
+} bin_schema_t;
+
+typedef struct _lrec_reader_mmap_bin_state_t {
+	char*         start_of_file;
+	int           saw_stream_header;
+	bin_schema_t* schemas;
+	unsigned long long num_schemas;
+	unsigned long long schemas_capacity;
+	hss_t*        pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+} lrec_reader_mmap_bin_state_t;
+
+static void    lrec_reader_mmap_bin_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_bin_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_bin_process(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_bin_count(void* pvstate, void* pvhandle, context_t* pctx);
+static unsigned char* lrec_reader_mmap_bin_next_item(lrec_reader_mmap_bin_state_t* pstate,
+	file_reader_mmap_state_t* phandle, char* ptag, unsigned long long* pa, unsigned char** ppayload_end,
+	context_t* pctx);
+static void    lrec_reader_mmap_bin_define_schema(lrec_reader_mmap_bin_state_t* pstate, unsigned long long id,
+	unsigned char* p, unsigned char* end, unsigned char* pitem, context_t* pctx);
+static void    lrec_reader_mmap_bin_reset_schemas(lrec_reader_mmap_bin_state_t* pstate);
+static void    data_corrupt(lrec_reader_mmap_bin_state_t* pstate, unsigned char* pitem, context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_bin_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate) {
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_bin_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_bin_state_t));
+	pstate->start_of_file     = NULL;
+	pstate->saw_stream_header = FALSE;
+	pstate->schemas_capacity  = 16;
+	pstate->schemas           = mlr_malloc_or_die(pstate->schemas_capacity * sizeof(bin_schema_t));
+	pstate->num_schemas       = 0;
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	plrec_reader->pprocess_func = lrec_reader_mmap_bin_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_bin_sof;
+	plrec_reader->pcount_func   = lrec_reader_mmap_bin_count;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_mmap_bin_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_mmap_bin_free(lrec_reader_t* preader) {
+	lrec_reader_mmap_bin_state_t* pstate = preader->pvstate;
+	lrec_reader_mmap_bin_reset_schemas(pstate);
+	free(pstate->schemas);
+	free(pstate);
+	free(preader);
+}
+
+// Schemas are per file.
+static void lrec_reader_mmap_bin_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_mmap_bin_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	pstate->start_of_file = phandle->sol;
+	pstate->saw_stream_header = FALSE;
+	lrec_reader_mmap_bin_reset_schemas(pstate);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_bin_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_bin_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	char tag;
+	unsigned long long a;
+	unsigned char* end;
+	unsigned char* p;
+
+	while ((p = lrec_reader_mmap_bin_next_item(pstate, phandle, &tag, &a, &end, pctx)) != NULL) {
+		unsigned char* pitem = (unsigned char*)phandle->sol;
+		phandle->sol = (char*)end;
+
+		if (tag == MLR_BIN_TAG_RECORD) {
+			if (a >= pstate->num_schemas)
+				data_corrupt(pstate, pitem, pctx);
+			bin_schema_t* pschema = &pstate->schemas[a];
+			lrec_t* prec = lrec_unbacked_alloc();
+			for (unsigned long long i = 0; i < pschema->num_fields; i++) {
+				if (pschema->keeps != NULL && !pschema->keeps[i]) {
+					if (!mlr_bin_skip_value(&p, end))
+						data_corrupt(pstate, pitem, pctx);
+					continue;
+				}
+				char free_flags;
+				char* value = mlr_bin_get_value(&p, end, &free_flags);
+				if (value == NULL)
+					data_corrupt(pstate, pitem, pctx);
+				lrec_put_new_key(prec, pschema->field_names[i], value, free_flags);
+			}
+			if (p != end)
+				data_corrupt(pstate, pitem, pctx);
+			if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+				return prec;
+
+		} else if (tag == MLR_BIN_TAG_KEYED_RECORD) {
+			lrec_t* prec = lrec_unbacked_alloc();
+			for (unsigned long long i = 0; i < a; i++) {
+				unsigned long long key_length;
+				char free_flags;
+				char* key = mlr_bin_get_varint(&p, end, &key_length) ? mlr_bin_get_string(&p, end, key_length) : NULL;
+				char* value = (key == NULL) ? NULL : mlr_bin_get_value(&p, end, &free_flags);
+				if (value == NULL)
+					data_corrupt(pstate, pitem, pctx);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
+			}
+			if (p != end)
+				data_corrupt(pstate, pitem, pctx);
+			if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+				return prec;
+
+		} else {
+			lrec_reader_mmap_bin_define_schema(pstate, a, p, end, pitem, pctx);
+		}
+	}
+	return NULL;
+}
+
+// Records are checked as thoroughly as by the process method, just not built.
+static long long lrec_reader_mmap_bin_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_bin_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	long long count = 0LL;
+	char tag;
+	unsigned long long a;
+	unsigned char* end;
+	unsigned char* p;
+
+	while ((p = lrec_reader_mmap_bin_next_item(pstate, phandle, &tag, &a, &end, pctx)) != NULL) {
+		unsigned char* pitem = (unsigned char*)phandle->sol;
+		phandle->sol = (char*)end;
+
+		if (tag == MLR_BIN_TAG_RECORD) {
+			if (a >= pstate->num_schemas)
+				data_corrupt(pstate, pitem, pctx);
+			for (unsigned long long i = 0; i < pstate->schemas[a].num_fields; i++)
+				if (!mlr_bin_skip_value(&p, end))
+					data_corrupt(pstate, pitem, pctx);
+			if (p != end)
+				data_corrupt(pstate, pitem, pctx);
+			count++;
+
+		} else if (tag == MLR_BIN_TAG_KEYED_RECORD) {
+			for (unsigned long long i = 0; i < a; i++) {
+				unsigned long long key_length;
+				if (!mlr_bin_get_varint(&p, end, &key_length) || mlr_bin_get_string(&p, end, key_length) == NULL
+					|| !mlr_bin_skip_value(&p, end))
+				{
+					data_corrupt(pstate, pitem, pctx);
+				}
+			}
+			if (p != end)
+				data_corrupt(pstate, pitem, pctx);
+			count++;
+
+		} else {
+			lrec_reader_mmap_bin_define_schema(pstate, a, p, end, pitem, pctx);
+		}
+	}
+	return count;
+}
+
+// ----------------------------------------------------------------
+// Steps over stream headers, and returns the start of the next item's payload, with the item's tag, its
+// number (schema id, or field count), and the end of its payload. Returns NULL at end of file. The item
+// itself starts at phandle->sol.
+static unsigned char* lrec_reader_mmap_bin_next_item(lrec_reader_mmap_bin_state_t* pstate,
+	file_reader_mmap_state_t* phandle, char* ptag, unsigned long long* pa, unsigned char** ppayload_end,
+	context_t* pctx)
+{
+	unsigned char* eof = (unsigned char*)phandle->eof;
+	while (TRUE) {
+		unsigned char* pitem = (unsigned char*)phandle->sol;
+		if (pitem >= eof)
+			return NULL;
+		unsigned char* p = pitem + 1;
+
+		if (*pitem == MLR_BIN_TAG_STREAM_HEADER) {
+			if (eof - pitem < MLR_BIN_STREAM_HEADER_LENGTH
+				|| memcmp(pitem, MLR_BIN_STREAM_HEADER, MLR_BIN_STREAM_HEADER_LENGTH - 1) != 0)
+			{
+				data_corrupt(pstate, pitem, pctx);
+			}
+			if (pitem[MLR_BIN_STREAM_HEADER_LENGTH - 1] != MLR_BIN_VERSION) {
+				fprintf(stderr, "%s: unsupported binary-format version %d in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, pitem[MLR_BIN_STREAM_HEADER_LENGTH - 1], pctx->filename);
+				exit(1);
+			}
+			pstate->saw_stream_header = TRUE;
+			lrec_reader_mmap_bin_reset_schemas(pstate);
+			phandle->sol = (char*)pitem + MLR_BIN_STREAM_HEADER_LENGTH;
+			continue;
+		}
+
+		if (!pstate->saw_stream_header) {
+			fprintf(stderr, "%s: file \"%s\" is not in Miller's binary format.\n",
+				MLR_GLOBALS.bargv0, pctx->filename);
+			exit(1);
+		}
+		unsigned long long payload_length;
+		if ((*pitem != MLR_BIN_TAG_RECORD && *pitem != MLR_BIN_TAG_KEYED_RECORD && *pitem != MLR_BIN_TAG_SCHEMA)
+			|| !mlr_bin_get_varint(&p, eof, pa) || !mlr_bin_get_varint(&p, eof, &payload_length)
+			|| payload_length > (unsigned long long)(eof - p))
+		{
+			data_corrupt(pstate, pitem, pctx);
+		}
+		*ptag = *pitem;
+		*ppayload_end = p + payload_length;
+		return p;
+	}
+}
+
+// Ids are assigned in order, but a schema may be redefined.
+static void lrec_reader_mmap_bin_define_schema(lrec_reader_mmap_bin_state_t* pstate, unsigned long long id,
+	unsigned char* p, unsigned char* end, unsigned char* pitem, context_t* pctx)
+{
+	bin_schema_t schema;
+	if (id > pstate->num_schemas || !mlr_bin_get_schema(p, end, &schema.num_fields, &schema.field_names))
+		data_corrupt(pstate, pitem, pctx);
+	schema.keeps = NULL;
+	if (pstate->pfield_projection != NULL) {
+		schema.keeps = mlr_malloc_or_die(schema.num_fields + 1);
+		for (unsigned long long i = 0; i < schema.num_fields; i++)
+			schema.keeps[i] = hss_has(pstate->pfield_projection, schema.field_names[i]);
+	}
+	if (id < pstate->num_schemas) {
+		free(pstate->schemas[id].field_names);
+		free(pstate->schemas[id].keeps);
+	} else {
+		if (pstate->num_schemas >= pstate->schemas_capacity) {
+			pstate->schemas_capacity *= 2;
+			pstate->schemas = mlr_realloc_or_die(pstate->schemas, pstate->schemas_capacity * sizeof(bin_schema_t));
+		}
+		pstate->num_schemas++;
+	}
+	pstate->schemas[id] = schema;
+}
+
+static void lrec_reader_mmap_bin_reset_schemas(lrec_reader_mmap_bin_state_t* pstate) {
+	for (unsigned long long i = 0; i < pstate->num_schemas; i++) {
+		free(pstate->schemas[i].field_names);
+		free(pstate->schemas[i].keeps);
+	}
+	pstate->num_schemas = 0;
+}
+
+static void data_corrupt(lrec_reader_mmap_bin_state_t* pstate, unsigned char* pitem, context_t* pctx) {
+	fprintf(stderr, "%s: data corrupt or truncated at byte offset %lld in binary-format file \"%s\".\n",
+		MLR_GLOBALS.bargv0, (long long)((char*)pitem - pstate->start_of_file), pctx->filename);
+	exit(1);
+}
@@ -9,12 +9,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
 #include "lib/string_builder.h"
 #include "input/file_reader_mmap.h"
+#include "input/csv_block.h"
 #include "input/lrec_readers.h"
 #include "input/peek_file_reader.h"
 #include "containers/rslls.h"
@@ -48,6 +51,7 @@ typedef struct _lrec_reader_mmap_csv_state_t {
 	// Input line number is not the same as the record-counter in context_t,
 	// which counts records.
 	long long  ilno;
+	int        ilno_known; // FALSE after a seek, since the lines skipped over weren't counted
 
 	char* eof;
 	char* irs;
@@ -63,6 +67,12 @@ typedef struct _lrec_reader_mmap_csv_state_t {
 	comment_handling_t comment_handling;
 	char* comment_string;
 	int   comment_string_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+	lrec_t* ppredicate_rec;   // The predicate's fields only, tested before the full record is built
+	int*    predicate_columns; // Their positions in the data fields, or -1
+	int     have_predicate_columns;
+	header_keeper_t* ppredicate_header_keeper; // What the positions were found from
 
 	int   dquotelen;
 
@@ -72,8 +82,15 @@ typedef struct _lrec_reader_mmap_csv_state_t {
 	parse_trie_t*       pno_dquote_parse_trie;
 	parse_trie_t*       pdquote_parse_trie;
 
+	char                ifs_char;
+	char                irs_char;
+	csv_block_t         block;
+	int               (*pget_fields_func)(struct _lrec_reader_mmap_csv_state_t* pstate,
+		rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx);
+
 	int                 expect_header_line_next;
 	int                 use_implicit_header;
+	long long           header_offset; // for indexing: where pheader_keeper's line, or comments before it, began
 	header_keeper_t*    pheader_keeper;
 	lhmslv_t*           pheader_keepers;
 
@@ -82,19 +99,39 @@ typedef struct _lrec_reader_mmap_csv_state_t {
 static void    lrec_reader_mmap_csv_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_csv_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_csv_count(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_csv_tell(void* pvstate, void* pvhandle, long long* pheader_offset);
+static void    lrec_reader_mmap_csv_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx);
+static long long lrec_reader_mmap_csv_count_single_seps(void* pvstate, void* pvhandle, context_t* pctx);
+static int     lrec_reader_mmap_csv_seek_tail_single_seps(void* pvstate, void* pvhandle, long long num_records,
+	context_t* pctx);
+static int     lrec_reader_mmap_csv_ingest_header_line(lrec_reader_mmap_csv_state_t* pstate,
+	file_reader_mmap_state_t* phandle, context_t* pctx);
+static int     lrec_reader_mmap_csv_is_comment_line(lrec_reader_mmap_csv_state_t* pstate, context_t* pctx);
 static int     lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 	rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx);
+static int     lrec_reader_mmap_csv_get_fields_single_seps(lrec_reader_mmap_csv_state_t* pstate,
+	rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx);
+static long long lrec_reader_mmap_csv_count_fields_single_seps(lrec_reader_mmap_csv_state_t* pstate,
+	file_reader_mmap_state_t* phandle, context_t* pctx);
+static int     predicate_keeps_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
 static lrec_t* paste_indices_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
 static lrec_t* paste_header_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
+static void    check_data_length(lrec_reader_mmap_csv_state_t* pstate, unsigned long long data_length,
+	context_t* pctx);
+static char*   ilno_desc(lrec_reader_mmap_csv_state_t* pstate, char* prefix);
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
 	lrec_reader_mmap_csv_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_csv_state_t));
 	pstate->ilno          = 0LL;
+	pstate->ilno_known    = TRUE;
 
 	pstate->do_auto_line_term = FALSE;
 	if (streq(irs, "auto")) {
@@ -105,6 +142,13 @@ lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit
 	pstate->comment_handling = comment_handling;
 	pstate->comment_string = comment_string;
 	pstate->comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
+	pstate->ppredicate_rec    = (precord_predicate == NULL) ? NULL : lrec_unbacked_alloc();
+	pstate->predicate_columns = (precord_predicate == NULL) ? NULL
+		: mlr_malloc_or_die(precord_predicate->pfield_names->length * sizeof(int));
+	pstate->have_predicate_columns = FALSE;
+	pstate->ppredicate_header_keeper = NULL;
 
 	pstate->eof           = "\xff";
 	pstate->irs           = irs;
@@ -140,8 +184,25 @@ lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit
 	pstate->pfields = rslls_alloc();
 	pstate->psb = sb_alloc(STRING_BUILDER_INIT_SIZE);
 
+	// The block tokenizer needs the separators to be distinguishable from one another and from the double
+	// quote by their first byte. With IFS of CR in auto-line-ending mode the trie's longest-match rule
+	// matters (quote-CR-LF vs. quote-CR), so that case stays on the trie path too.
+	pstate->ifs_char = pstate->ifs[0];
+	pstate->irs_char = pstate->irs[0];
+	csv_block_init(&pstate->block, pstate->ifs_char, pstate->irs_char);
+	if (strlen(pstate->ifs) == 1 && strlen(pstate->irs) == 1
+		&& pstate->ifs_char != pstate->irs_char
+		&& pstate->ifs_char != '"' && pstate->irs_char != '"'
+		&& !(pstate->do_auto_line_term && pstate->ifs_char == '\r'))
+	{
+		pstate->pget_fields_func = lrec_reader_mmap_csv_get_fields_single_seps;
+	} else {
+		pstate->pget_fields_func = lrec_reader_mmap_csv_get_fields;
+	}
+
 	pstate->expect_header_line_next   = use_implicit_header ? FALSE : TRUE;
 	pstate->use_implicit_header       = use_implicit_header;
+	pstate->header_offset             = LREC_READER_HEADER_NONE;
 	pstate->pheader_keeper            = NULL;
 	pstate->pheader_keepers           = lhmslv_alloc();
 
@@ -150,6 +211,18 @@ lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit
 	plrec_reader->pclose_func   = file_reader_mmap_vclose;
 	plrec_reader->pprocess_func = lrec_reader_mmap_csv_process;
 	plrec_reader->psof_func     = lrec_reader_mmap_csv_sof;
+	// Comment lines are recognized by their first field, so with comment handling we need the fields.
+	plrec_reader->pcount_func   = (pstate->pget_fields_func == lrec_reader_mmap_csv_get_fields_single_seps
+		&& pstate->comment_string == NULL)
+		? lrec_reader_mmap_csv_count_single_seps
+		: lrec_reader_mmap_csv_count;
+	plrec_reader->ptell_func    = lrec_reader_mmap_csv_tell;
+	plrec_reader->pseek_func    = lrec_reader_mmap_csv_seek;
+	plrec_reader->pseek_tail_func = (pstate->pget_fields_func == lrec_reader_mmap_csv_get_fields_single_seps
+		&& pstate->comment_string == NULL)
+		? lrec_reader_mmap_csv_seek_tail_single_seps
+		: NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_mmap_csv_free;
 
 	return plrec_reader;
@@ -166,6 +239,8 @@ static void lrec_reader_mmap_csv_free(lrec_reader_t* preader) {
 	parse_trie_free(pstate->pno_dquote_parse_trie);
 	parse_trie_free(pstate->pdquote_parse_trie);
 	rslls_free(pstate->pfields);
+	lrec_free(pstate->ppredicate_rec);
+	free(pstate->predicate_columns);
 	sb_free(pstate->psb);
 	free(pstate->ifs_eof);
 	free(pstate->dquote_irs);
@@ -179,7 +254,10 @@ static void lrec_reader_mmap_csv_free(lrec_reader_t* preader) {
 static void lrec_reader_mmap_csv_sof(void* pvstate, void* pvhandle) {
 	lrec_reader_mmap_csv_state_t* pstate = pvstate;
 	pstate->ilno = 0LL;
+	pstate->ilno_known = TRUE;
 	pstate->expect_header_line_next = pstate->use_implicit_header ? FALSE : TRUE;
+	pstate->header_offset = LREC_READER_HEADER_NONE;
+	csv_block_reset(&pstate->block);
 
 	// Strip UTF-8 BOM if any
 	file_reader_mmap_state_t* phandle = pvhandle;
@@ -197,97 +275,25 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 
 	// Ingest the next header line, if expected
 	if (pstate->expect_header_line_next) {
-		while (TRUE) {
-			if (!lrec_reader_mmap_csv_get_fields(pstate, pstate->pfields, phandle, pctx))
-				return NULL;
-			pstate->ilno++;
-
-			// We check for comments here rather than within the parser since it's important
-			// for users to be able to comment out lines containing double-quoted newlines.
-			if (pstate->comment_string != NULL && pstate->pfields->phead != NULL) {
-				if (streqn(pstate->pfields->phead->value, pstate->comment_string, pstate->comment_string_length)) {
-					if (pstate->comment_handling == PASS_COMMENTS) {
-						int i = 0;
-						for (
-							rsllse_t* pe = pstate->pfields->phead;
-							i < pstate->pfields->length && pe != NULL;
-							pe = pe->pnext, i++)
-						{
-							if (i > 0)
-								fputs(pstate->ifs, stdout);
-							fputs(pe->value, stdout);
-						}
-						if (pstate->do_auto_line_term) {
-							fputs(pctx->auto_line_term, stdout);
-						} else {
-							fputs(pstate->irs, stdout);
-						}
-					}
-					rslls_reset(pstate->pfields);
-					continue;
-				}
-			}
-
-			slls_t* pheader_fields = slls_alloc();
-			int i = 0;
-			for (rsllse_t* pe = pstate->pfields->phead; i < pstate->pfields->length && pe != NULL; pe = pe->pnext, i++) {
-				if (*pe->value == 0) {
-					fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\" line %lld.\n",
-						MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
-					exit(1);
-				}
-				// Transfer pointer-free responsibility from the rslls to the
-				// header fields in the header keeper
-				slls_append(pheader_fields, pe->value, pe->free_flag);
-				pe->free_flag = 0;
-			}
-			rslls_reset(pstate->pfields);
-
-			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
-			if (pstate->pheader_keeper == NULL) {
-				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
-				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
-					NO_FREE); // freed by header-keeper
-			} else { // Re-use the header-keeper in the header cache
-				slls_free(pheader_fields);
-			}
-
-			pstate->expect_header_line_next = FALSE;
-			break;
-		}
+		if (!lrec_reader_mmap_csv_ingest_header_line(pstate, phandle, pctx))
+			return NULL;
 	}
 
 	// Ingest the next data line, if expected
 	while (TRUE) {
-		int rc = lrec_reader_mmap_csv_get_fields(pstate, pstate->pfields, phandle, pctx);
+		int rc = pstate->pget_fields_func(pstate, pstate->pfields, phandle, pctx);
 		pstate->ilno++;
 		if (rc == FALSE) // EOF
 			return NULL;
 
-		// We check for comments here rather than within the parser since it's important
-		// for users to be able to comment out lines containing double-quoted newlines.
-		if (pstate->comment_string != NULL && pstate->pfields->phead != NULL) {
-			if (streqn(pstate->pfields->phead->value, pstate->comment_string, pstate->comment_string_length)) {
-				if (pstate->comment_handling == PASS_COMMENTS) {
-					int i = 0;
-					for (
-						rsllse_t* pe = pstate->pfields->phead;
-						i < pstate->pfields->length && pe != NULL;
-						pe = pe->pnext, i++)
-					{
-						if (i > 0)
-							fputs(pstate->ifs, stdout);
-						fputs(pe->value, stdout);
-					}
-					if (pstate->do_auto_line_term) {
-						fputs(pctx->auto_line_term, stdout);
-					} else {
-						fputs(pstate->irs, stdout);
-					}
-				}
-				rslls_reset(pstate->pfields);
-				continue;
-			}
+		if (pstate->comment_string != NULL && lrec_reader_mmap_csv_is_comment_line(pstate, pctx)) {
+			rslls_reset(pstate->pfields);
+			continue;
+		}
+
+		if (pstate->precord_predicate != NULL && !predicate_keeps_data(pstate, pstate->pfields, pctx)) {
+			rslls_reset(pstate->pfields);
+			continue;
 		}
 
 		lrec_t* prec = pstate->use_implicit_header
@@ -298,6 +304,233 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 	}
 }
 
+// ----------------------------------------------------------------
+// For record-boundaries-only reading: data lines are split into fields only far enough to check their count
+// against the header's, with no records built. Everything else is as in the process method.
+static long long lrec_reader_mmap_csv_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	long long count = 0LL;
+
+	if (pstate->expect_header_line_next) {
+		if (!lrec_reader_mmap_csv_ingest_header_line(pstate, phandle, pctx))
+			return count;
+	}
+
+	while (TRUE) {
+		int rc = pstate->pget_fields_func(pstate, pstate->pfields, phandle, pctx);
+		pstate->ilno++;
+		if (rc == FALSE) // EOF
+			return count;
+
+		if (pstate->comment_string != NULL && lrec_reader_mmap_csv_is_comment_line(pstate, pctx)) {
+			rslls_reset(pstate->pfields);
+			continue;
+		}
+
+		if (!pstate->use_implicit_header)
+			check_data_length(pstate, pstate->pfields->length, pctx);
+		rslls_reset(pstate->pfields);
+		count++;
+	}
+}
+
+// Without comment handling and with single-character separators, data lines aren't even split into fields: the
+// separators in them are just counted.
+static long long lrec_reader_mmap_csv_count_single_seps(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	long long count = 0LL;
+
+	if (pstate->expect_header_line_next) {
+		if (!lrec_reader_mmap_csv_ingest_header_line(pstate, phandle, pctx))
+			return count;
+	}
+
+	while (TRUE) {
+		long long nfields = lrec_reader_mmap_csv_count_fields_single_seps(pstate, phandle, pctx);
+		pstate->ilno++;
+		if (nfields < 0LL) // EOF
+			return count;
+		if (!pstate->use_implicit_header)
+			check_data_length(pstate, nfields, pctx);
+		count++;
+	}
+}
+
+// ----------------------------------------------------------------
+// For indexing. Data lines after the header are read as from the start of the file, once the header is read.
+static long long lrec_reader_mmap_csv_tell(void* pvstate, void* pvhandle, long long* pheader_offset) {
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (pstate->expect_header_line_next)
+		*pheader_offset = LREC_READER_HEADER_NEXT;
+	else if (pstate->use_implicit_header)
+		*pheader_offset = LREC_READER_HEADER_NONE;
+	else
+		*pheader_offset = pstate->header_offset;
+	return phandle->sol - phandle->sof;
+}
+
+static void lrec_reader_mmap_csv_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx)
+{
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (header_offset >= 0LL) {
+		// The header may be the one already in effect, whose line has since been parsed in place.
+		if (header_offset != pstate->header_offset) {
+			if (phandle->sol != phandle->sof + header_offset)
+				pstate->ilno_known = FALSE;
+			phandle->sol = phandle->sof + header_offset;
+			lrec_reader_mmap_csv_ingest_header_line(pstate, phandle, pctx);
+			// For byte ranges the offset may be any line start, e.g. of the header line itself.
+			if (phandle->sol > phandle->sof + offset)
+				offset = phandle->sol - phandle->sof;
+		}
+		pstate->expect_header_line_next = FALSE;
+	} else {
+		pstate->expect_header_line_next = (header_offset == LREC_READER_HEADER_NEXT);
+	}
+	if (phandle->sol != phandle->sof + offset)
+		pstate->ilno_known = FALSE;
+	phandle->sol = phandle->sof + offset;
+}
+
+// ----------------------------------------------------------------
+// For tail reading. The header, if any, is read from the start of the file as usual. Then a data line ends at
+// each IRS not within double quotes, which when reading backward is each one followed by an even number of
+// double quotes to end of file: quotes within fields are doubled, and fields containing them are wrapped in
+// them. Comment lines could have unpaired quotes, so this is only without comment handling.
+//
+// With autodetected line endings, the file's first line decides them as it would have if everything were read:
+// that's the header line if any, else the first data line, which is looked at here before it's skipped.
+static int lrec_reader_mmap_csv_seek_tail_single_seps(void* pvstate, void* pvhandle, long long num_records,
+	context_t* pctx)
+{
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	char irs = pstate->irs_char;
+
+	if (pstate->expect_header_line_next) {
+		if (!lrec_reader_mmap_csv_ingest_header_line(pstate, phandle, pctx))
+			return TRUE;
+	}
+	if (pstate->do_auto_line_term && !pctx->auto_line_term_detected) {
+		int in_quotes = FALSE;
+		for (char* q = phandle->sol; q < phandle->eof; q++) {
+			if (*q == '"') {
+				in_quotes = !in_quotes;
+			} else if (*q == '\n' && !in_quotes) {
+				if (q > phandle->sol && q[-1] == '\r')
+					context_set_autodetected_crlf(pctx);
+				else
+					context_set_autodetected_lf(pctx);
+				break;
+			}
+		}
+	}
+	if (num_records <= 0LL) {
+		phandle->sol = phandle->eof;
+		pstate->ilno_known = FALSE;
+		return TRUE;
+	}
+	if (phandle->sol >= phandle->eof)
+		return TRUE;
+
+	char* p = phandle->eof - 1;
+	if (*p == irs)
+		p--;
+	int in_quotes = FALSE;
+	long long count = 0LL;
+	for ( ; p >= phandle->sol; p--) {
+		if (*p == '"') {
+			in_quotes = !in_quotes;
+		} else if (*p == irs && !in_quotes) {
+			if (++count >= num_records) {
+				phandle->sol = p + 1;
+				pstate->ilno_known = FALSE;
+				return TRUE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+// Returns FALSE at end of file.
+static int lrec_reader_mmap_csv_ingest_header_line(lrec_reader_mmap_csv_state_t* pstate,
+	file_reader_mmap_state_t* phandle, context_t* pctx)
+{
+	pstate->header_offset = phandle->sol - phandle->sof;
+	while (TRUE) {
+		if (!pstate->pget_fields_func(pstate, pstate->pfields, phandle, pctx))
+			return FALSE;
+		pstate->ilno++;
+
+		if (pstate->comment_string != NULL && lrec_reader_mmap_csv_is_comment_line(pstate, pctx)) {
+			rslls_reset(pstate->pfields);
+			continue;
+		}
+
+		slls_t* pheader_fields = slls_alloc();
+		int i = 0;
+		for (rsllse_t* pe = pstate->pfields->phead; i < pstate->pfields->length && pe != NULL; pe = pe->pnext, i++) {
+			if (*pe->value == 0) {
+				fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\"%s.\n",
+					MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " line "));
+				exit(1);
+			}
+			// Transfer pointer-free responsibility from the rslls to the
+			// header fields in the header keeper
+			slls_append(pheader_fields, pe->value, pe->free_flag);
+			pe->free_flag = 0;
+		}
+		rslls_reset(pstate->pfields);
+
+		pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
+		if (pstate->pheader_keeper == NULL) {
+			pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
+			lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
+				NO_FREE); // freed by header-keeper
+		} else { // Re-use the header-keeper in the header cache
+			slls_free(pheader_fields);
+		}
+
+		pstate->expect_header_line_next = FALSE;
+		return TRUE;
+	}
+}
+
+// We check for comments here rather than within the parser since it's important for users to be able to comment
+// out lines containing double-quoted newlines. Comment lines are passed through to standard output if so
+// requested.
+static int lrec_reader_mmap_csv_is_comment_line(lrec_reader_mmap_csv_state_t* pstate, context_t* pctx) {
+	if (pstate->pfields->phead == NULL)
+		return FALSE;
+	if (!streqn(pstate->pfields->phead->value, pstate->comment_string, pstate->comment_string_length))
+		return FALSE;
+
+	if (pstate->comment_handling == PASS_COMMENTS) {
+		int i = 0;
+		for (
+			rsllse_t* pe = pstate->pfields->phead;
+			i < pstate->pfields->length && pe != NULL;
+			pe = pe->pnext, i++)
+		{
+			if (i > 0)
+				fputs(pstate->ifs, stdout);
+			fputs(pe->value, stdout);
+		}
+		if (pstate->do_auto_line_term) {
+			fputs(pctx->auto_line_term, stdout);
+		} else {
+			fputs(pstate->irs, stdout);
+		}
+	}
+	return TRUE;
+}
+
 static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 	rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx)
 {
@@ -347,13 +580,13 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 						record_done = TRUE;
 						break;
 					case DQUOTE_STRIDX: // CSV syntax error: fields containing quotes must be fully wrapped in quotes
-						fprintf(stderr, "%s: syntax error: unwrapped double quote at line %lld.\n",
-							MLR_GLOBALS.bargv0, pstate->ilno);
+						fprintf(stderr, "%s: syntax error: unwrapped double quote%s.\n",
+							MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
 						exit(1);
 						break;
 					default:
-						fprintf(stderr, "%s: internal coding error: unexpected token %d at line %lld.\n",
-							MLR_GLOBALS.bargv0, stridx, pstate->ilno);
+						fprintf(stderr, "%s: internal coding error: unexpected token %d%s.\n",
+							MLR_GLOBALS.bargv0, stridx, ilno_desc(pstate, " at line "));
 						exit(1);
 						break;
 					}
@@ -389,8 +622,8 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 			// "ab""c" becomes ab"c.
 			while (!field_done) {
 				if (e >= phandle->eof) {
-					fprintf(stderr, "%s: unmatched double quote at line %lld.\n",
-						MLR_GLOBALS.bargv0, pstate->ilno);
+					fprintf(stderr, "%s: unmatched double quote%s.\n",
+						MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
 					exit(1);
 				}
 
@@ -415,6 +648,8 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 							if (e > p && e[-1] == '\r') {
 								e[-1] = 0;
 								context_set_autodetected_crlf(pctx);
+							} else if (stridx == DQUOTE_IRS2_STRIDX) {
+								context_set_autodetected_crlf(pctx);
 							} else {
 								context_set_autodetected_lf(pctx);
 							}
@@ -437,8 +672,8 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 						}
 						break;
 					default:
-						fprintf(stderr, "%s: internal coding error: unexpected token %d at line %lld.\n",
-							MLR_GLOBALS.bargv0, stridx, pstate->ilno);
+						fprintf(stderr, "%s: internal coding error: unexpected token %d%s.\n",
+							MLR_GLOBALS.bargv0, stridx, ilno_desc(pstate, " at line "));
 						exit(1);
 						break;
 					}
@@ -456,6 +691,294 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 	return TRUE;
 }
 
+// ----------------------------------------------------------------
+// Same semantics as lrec_reader_mmap_csv_get_fields, including its error messages, for single-character IFS and
+// IRS.
+static int lrec_reader_mmap_csv_get_fields_single_seps(lrec_reader_mmap_csv_state_t* pstate,
+	rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx)
+{
+	string_builder_t* psb = pstate->psb;
+	char* eof = phandle->eof;
+	char  ifs = pstate->ifs_char;
+	char  irs = pstate->irs_char;
+
+	if (phandle->sol >= eof)
+		return FALSE;
+
+	char* p = phandle->sol;
+	char* e = p;
+
+	// loop over fields in record
+	int record_done = FALSE;
+	while (!record_done) {
+		if (e >= eof || *e != '"') { // start of non-quoted field
+			char* q = csv_block_scan(&pstate->block, e, eof, TRUE);
+
+			if (q >= eof) {
+				// End of file without end of line. See lrec_reader_mmap_csv_get_fields for why we copy here
+				// rather than zero-poke.
+				char* copy = mlr_alloc_string_from_char_range(p, eof - p);
+				rslls_append(pfields, copy, FREE_ENTRY_VALUE, 0);
+				e = eof;
+				record_done = TRUE;
+
+			} else if (*q == ifs) { // end of field
+				*q = 0;
+				rslls_append(pfields, p, NO_FREE, 0);
+				e = p = q + 1;
+
+			} else if (*q == irs) { // end of record
+				*q = 0;
+				if (pstate->do_auto_line_term) {
+					if (q > p && q[-1] == '\r') {
+						q[-1] = 0;
+						context_set_autodetected_crlf(pctx);
+					} else {
+						context_set_autodetected_lf(pctx);
+					}
+				}
+				rslls_append(pfields, p, NO_FREE, 0);
+				e = p = q + 1;
+				record_done = TRUE;
+
+			} else { // CSV syntax error: fields containing quotes must be fully wrapped in quotes
+				fprintf(stderr, "%s: syntax error: unwrapped double quote%s.\n",
+					MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
+				exit(1);
+			}
+
+		} else { // start of quoted field
+			e++;
+			p = e;
+
+			// See lrec_reader_mmap_csv_get_fields for the contiguous/non-contiguous distinction.
+			int field_done = FALSE;
+			int contiguous = TRUE;
+			while (!field_done) {
+				char* q = (e < eof) ? csv_block_scan(&pstate->block, e, eof, FALSE) : eof;
+				if (q >= eof) {
+					fprintf(stderr, "%s: unmatched double quote%s.\n",
+						MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
+					exit(1);
+				}
+				if (!contiguous && q > e)
+					sb_append_char_range(psb, e, q - 1);
+				e = q;
+
+				// Now *e is a double quote: look at what follows it.
+				int matchlen = 0;
+				int is_end_of_record = FALSE;
+				if (e + 1 < eof) {
+					char c = e[1];
+					if (c == ifs) {
+						matchlen = 2;
+					} else if (c == irs) {
+						matchlen = 2;
+						is_end_of_record = TRUE;
+					} else if (pstate->do_auto_line_term && c == '\r' && e + 2 < eof && e[2] == '\n') {
+						matchlen = 3;
+						is_end_of_record = TRUE;
+					} else if (c == '"') { // RFC-4180 CSV: "" inside a dquoted field is an escape for "
+						if (contiguous) { // not anymore it isn't
+							sb_append_char_range(psb, p, e);
+							contiguous = FALSE;
+						} else {
+							sb_append_char(psb, '"');
+						}
+						e += 2;
+						continue;
+					}
+				}
+
+				if (matchlen == 0) { // lone double quote within the field is data
+					if (!contiguous)
+						sb_append_char(psb, '"');
+					e++;
+					continue;
+				}
+
+				*e = 0;
+				if (is_end_of_record && pstate->do_auto_line_term) {
+					if (e > p && e[-1] == '\r') {
+						e[-1] = 0;
+						context_set_autodetected_crlf(pctx);
+					} else if (matchlen == 3) {
+						context_set_autodetected_crlf(pctx);
+					} else {
+						context_set_autodetected_lf(pctx);
+					}
+				}
+				if (contiguous)
+					rslls_append(pfields, p, NO_FREE, FIELD_QUOTED_ON_INPUT);
+				else
+					rslls_append(pfields, sb_finish(psb), FREE_ENTRY_VALUE, FIELD_QUOTED_ON_INPUT);
+				e += matchlen;
+				p = e;
+				field_done  = TRUE;
+				record_done = is_end_of_record;
+			}
+		}
+	}
+	phandle->sol = e;
+
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+// The same scan as lrec_reader_mmap_csv_get_fields_single_seps, with the same error messages, but only counting
+// fields: nothing is copied out, unescaped, or zero-poked. Returns -1 at end of file.
+static long long lrec_reader_mmap_csv_count_fields_single_seps(lrec_reader_mmap_csv_state_t* pstate,
+	file_reader_mmap_state_t* phandle, context_t* pctx)
+{
+	char* eof = phandle->eof;
+	char  ifs = pstate->ifs_char;
+	char  irs = pstate->irs_char;
+	long long nfields = 0LL;
+
+	if (phandle->sol >= eof)
+		return -1LL;
+
+	char* p = phandle->sol;
+	char* e = p;
+
+	int record_done = FALSE;
+	while (!record_done) {
+		if (e >= eof || *e != '"') { // start of non-quoted field
+			char* q = csv_block_scan(&pstate->block, e, eof, TRUE);
+
+			if (q >= eof) {
+				e = eof;
+				record_done = TRUE;
+			} else if (*q == ifs) {
+				e = p = q + 1;
+			} else if (*q == irs) {
+				if (pstate->do_auto_line_term) {
+					if (q > p && q[-1] == '\r')
+						context_set_autodetected_crlf(pctx);
+					else
+						context_set_autodetected_lf(pctx);
+				}
+				e = p = q + 1;
+				record_done = TRUE;
+			} else {
+				fprintf(stderr, "%s: syntax error: unwrapped double quote%s.\n",
+					MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
+				exit(1);
+			}
+			nfields++;
+
+		} else { // start of quoted field
+			e++;
+			p = e;
+
+			int field_done = FALSE;
+			while (!field_done) {
+				char* q = (e < eof) ? csv_block_scan(&pstate->block, e, eof, FALSE) : eof;
+				if (q >= eof) {
+					fprintf(stderr, "%s: unmatched double quote%s.\n",
+						MLR_GLOBALS.bargv0, ilno_desc(pstate, " at line "));
+					exit(1);
+				}
+				e = q;
+
+				int matchlen = 0;
+				int is_end_of_record = FALSE;
+				if (e + 1 < eof) {
+					char c = e[1];
+					if (c == ifs) {
+						matchlen = 2;
+					} else if (c == irs) {
+						matchlen = 2;
+						is_end_of_record = TRUE;
+					} else if (pstate->do_auto_line_term && c == '\r' && e + 2 < eof && e[2] == '\n') {
+						matchlen = 3;
+						is_end_of_record = TRUE;
+					} else if (c == '"') {
+						e += 2;
+						continue;
+					}
+				}
+				if (matchlen == 0) { // lone double quote within the field is data
+					e++;
+					continue;
+				}
+
+				if (is_end_of_record && pstate->do_auto_line_term) {
+					if ((e > p && e[-1] == '\r') || matchlen == 3)
+						context_set_autodetected_crlf(pctx);
+					else
+						context_set_autodetected_lf(pctx);
+				}
+				e += matchlen;
+				p = e;
+				field_done  = TRUE;
+				record_done = is_end_of_record;
+			}
+			nfields++;
+		}
+	}
+	phandle->sol = e;
+
+	return nfields;
+}
+
+// ----------------------------------------------------------------
+// For predicate pushdown: tests the data fields the predicate names, before the rest of the record
+// is built. Returns FALSE, having counted the record in NR/FNR, if it's to be skipped. A header/data
+// length mismatch is passed through for paste_header_and_data to report.
+static int predicate_keeps_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx) {
+	lrec_reader_predicate_t* ppredicate = pstate->precord_predicate;
+
+	if (!pstate->have_predicate_columns || pstate->ppredicate_header_keeper != pstate->pheader_keeper) {
+		int i = 0;
+		for (sllse_t* pn = ppredicate->pfield_names->phead; pn != NULL; pn = pn->pnext, i++) {
+			pstate->predicate_columns[i] = -1;
+			if (pstate->use_implicit_header) {
+				int idx = 0;
+				if (sscanf(pn->value, "%d", &idx) == 1 && idx > 0) {
+					char free_flags = 0;
+					char* key = low_int_to_string(idx, &free_flags);
+					if (streq(key, pn->value))
+						pstate->predicate_columns[i] = idx - 1;
+					if (free_flags & FREE_ENTRY_KEY)
+						free(key);
+				}
+			} else {
+				// With repeated header fields the last value is the one the record keeps.
+				int j = 0;
+				for (sllse_t* ph = pstate->pheader_keeper->pkeys->phead; ph != NULL; ph = ph->pnext, j++) {
+					if (streq(ph->value, pn->value))
+						pstate->predicate_columns[i] = j;
+				}
+			}
+		}
+		pstate->have_predicate_columns = TRUE;
+		pstate->ppredicate_header_keeper = pstate->pheader_keeper;
+	}
+
+	if (!pstate->use_implicit_header && pstate->pheader_keeper->pkeys->length != pdata_fields->length)
+		return TRUE;
+
+	lrec_t* prec = pstate->ppredicate_rec;
+	int i = 0;
+	for (sllse_t* pn = ppredicate->pfield_names->phead; pn != NULL; pn = pn->pnext, i++) {
+		int column = pstate->predicate_columns[i];
+		if (column < 0 || column >= pdata_fields->length)
+			continue;
+		rsllse_t* pd = pdata_fields->phead;
+		for (int j = 0; j < column; j++)
+			pd = pd->pnext;
+		lrec_put(prec, pn->value, pd->value, NO_FREE);
+	}
+	int keeps = ppredicate->ptest_func(ppredicate->pvstate, prec, pctx);
+	lrec_clear(prec);
+	if (!keeps) {
+		pctx->nr++;
+		pctx->fnr++;
+	}
+	return keeps;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* paste_indices_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx) {
 	int idx = 0;
@@ -464,6 +987,11 @@ static lrec_t* paste_indices_and_data(lrec_reader_mmap_csv_state_t* pstate, rsll
 		idx++;
 		char free_flags = pd->free_flag;
 		char* key = low_int_to_string(idx, &free_flags);
+		if (pstate->pfield_projection != NULL && !hss_has(pstate->pfield_projection, key)) {
+			if (free_flags & FREE_ENTRY_KEY)
+				free(key);
+			continue;
+		}
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, key, pd->value, free_flags, pd->quote_flag);
 		pd->free_flag = 0;
@@ -473,19 +1001,38 @@ static lrec_t* paste_indices_and_data(lrec_reader_mmap_csv_state_t* pstate, rsll
 
 // ----------------------------------------------------------------
 static lrec_t* paste_header_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx) {
-	if (pstate->pheader_keeper->pkeys->length != pdata_fields->length) {
-		fprintf(stderr, "%s: Header/data length mismatch (%llu != %llu) at file \"%s\" line %lld.\n",
-			MLR_GLOBALS.bargv0, pstate->pheader_keeper->pkeys->length, pdata_fields->length,
-			pctx->filename, pstate->ilno);
-		exit(1);
-	}
+	check_data_length(pstate, pdata_fields->length, pctx);
 	lrec_t* prec = lrec_unbacked_alloc();
 	sllse_t* ph  = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
 	for ( ; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext) {
+		// Fields outside the projection are left to the rslls, which frees them on reset.
+		if (pstate->pfield_projection != NULL && !hss_has(pstate->pfield_projection, ph->value))
+			continue;
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, ph->value, pd->value, pd->free_flag, pd->quote_flag);
 		pd->free_flag = 0;
 	}
 	return prec;
 }
+
+static void check_data_length(lrec_reader_mmap_csv_state_t* pstate, unsigned long long data_length,
+	context_t* pctx)
+{
+	if (pstate->pheader_keeper->pkeys->length != data_length) {
+		fprintf(stderr, "%s: Header/data length mismatch (%llu != %llu) at file \"%s\"%s.\n",
+			MLR_GLOBALS.bargv0, pstate->pheader_keeper->pkeys->length, data_length,
+			pctx->filename, ilno_desc(pstate, " line "));
+		exit(1);
+	}
+}
+
+// Where an error is, for its message: the prefix and the input line number, or nothing after a seek. Only for
+// the message just before exiting, since the text is in a static buffer.
+static char* ilno_desc(lrec_reader_mmap_csv_state_t* pstate, char* prefix) {
+	static char buf[64];
+	if (!pstate->ilno_known)
+		return "";
+	snprintf(buf, sizeof(buf), "%s%lld", prefix, pstate->ilno);
+	return buf;
+}
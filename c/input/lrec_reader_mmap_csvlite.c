@@ -12,6 +12,7 @@
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_masks.h"
 #include "containers/slls.h"
 #include "containers/lhmslv.h"
 #include "input/file_reader_mmap.h"
@@ -40,6 +41,7 @@
 typedef struct _lrec_reader_mmap_csvlite_state_t {
 	long long  ifnr;
 	long long  ilno; // Line-level, not record-level as in context_t
+	int        ilno_known; // FALSE after a seek, since the lines skipped over weren't counted
 	char* irs;
 	char* ifs;
 	int   irslen;
@@ -52,6 +54,7 @@ typedef struct _lrec_reader_mmap_csvlite_state_t {
 	int   comment_string_length;
 
 	int  expect_header_line_next;
+	long long header_offset; // for indexing: where pheader_keeper's line, or comments before it, began
 	header_keeper_t* pheader_keeper;
 	lhmslv_t*     pheader_keepers;
 } lrec_reader_mmap_csvlite_state_t;
@@ -60,6 +63,12 @@ static void    lrec_reader_mmap_csvlite_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_csvlite_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_mmap_csvlite_process_single_seps(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_csvlite_tell(void* pvstate, void* pvhandle, long long* pheader_offset);
+static void    lrec_reader_mmap_csvlite_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx);
+static char*   ilno_desc(lrec_reader_mmap_csvlite_state_t* pstate, char* prefix, long long ilno);
+static int     lrec_reader_mmap_csvlite_ingest_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_csvlite_state_t* pstate, context_t* pctx);
 
 static slls_t* lrec_reader_mmap_csvlite_get_header_single_seps(file_reader_mmap_state_t* phandle,
 	lrec_reader_mmap_csvlite_state_t* pstate, context_t* pctx);
@@ -108,6 +117,7 @@ lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_re
 	pstate->comment_string_length    = comment_string == NULL ? 0 : strlen(comment_string);
 
 	pstate->expect_header_line_next  = use_implicit_header ? FALSE : TRUE;
+	pstate->header_offset            = LREC_READER_HEADER_NONE;
 	pstate->pheader_keeper           = NULL;
 	pstate->pheader_keepers          = lhmslv_alloc();
 
@@ -133,6 +143,11 @@ lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_re
 	}
 
 	plrec_reader->psof_func     = lrec_reader_mmap_csvlite_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = lrec_reader_mmap_csvlite_tell;
+	plrec_reader->pseek_func    = lrec_reader_mmap_csvlite_seek;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_mmap_csvlite_free;
 
 	return plrec_reader;
@@ -154,7 +169,9 @@ static void lrec_reader_mmap_csvlite_sof(void* pvstate, void* pvhandle) {
 	lrec_reader_mmap_csvlite_state_t* pstate = pvstate;
 	pstate->ifnr = 0LL;
 	pstate->ilno = 0LL;
+	pstate->ilno_known = TRUE;
 	pstate->expect_header_line_next = pstate->use_implicit_header ? FALSE : TRUE;
+	pstate->header_offset = LREC_READER_HEADER_NONE;
 }
 
 // ----------------------------------------------------------------
@@ -164,29 +181,8 @@ static lrec_t* lrec_reader_mmap_csvlite_process_single_seps(void* pvstate, void*
 
 	while (TRUE) {
 		if (pstate->expect_header_line_next) {
-
-			slls_t* pheader_fields = lrec_reader_mmap_csvlite_get_header_single_seps(phandle, pstate, pctx);
-			if (pheader_fields == NULL) { // EOF
+			if (!lrec_reader_mmap_csvlite_ingest_header(phandle, pstate, pctx)) // EOF
 				return NULL;
-			}
-
-			for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
-				if (*pe->value == 0) {
-					fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\" line %lld.\n",
-						MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
-					exit(1);
-				}
-			}
-
-			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
-			if (pstate->pheader_keeper == NULL) {
-				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
-				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
-					NO_FREE); // freed by header-keeper
-			} else { // Re-use the header-keeper in the header cache
-				slls_free(pheader_fields);
-			}
-			pstate->expect_header_line_next = FALSE;
 		}
 
 		int end_of_stanza = FALSE;
@@ -211,28 +207,8 @@ static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void*
 
 	while (TRUE) {
 		if (pstate->expect_header_line_next) {
-
-			slls_t* pheader_fields = lrec_reader_mmap_csvlite_get_header_multi_seps(phandle, pstate);
-			if (pheader_fields == NULL) // EOF
+			if (!lrec_reader_mmap_csvlite_ingest_header(phandle, pstate, pctx)) // EOF
 				return NULL;
-
-			for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
-				if (*pe->value == 0) {
-					fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\" line %lld.\n",
-						MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
-					exit(1);
-				}
-			}
-
-			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
-			if (pstate->pheader_keeper == NULL) {
-				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
-				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
-					NO_FREE); // freed by header-keeper
-			} else { // Re-use the header-keeper in the header cache
-				slls_free(pheader_fields);
-			}
-			pstate->expect_header_line_next = FALSE;
 		}
 
 		int end_of_stanza = FALSE;
@@ -251,6 +227,77 @@ static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void*
 	}
 }
 
+// ----------------------------------------------------------------
+// For indexing. Data lines after a header are read as from the start of the file, once the header is read.
+static long long lrec_reader_mmap_csvlite_tell(void* pvstate, void* pvhandle, long long* pheader_offset) {
+	lrec_reader_mmap_csvlite_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (pstate->expect_header_line_next)
+		*pheader_offset = LREC_READER_HEADER_NEXT;
+	else if (pstate->use_implicit_header)
+		*pheader_offset = LREC_READER_HEADER_NONE;
+	else
+		*pheader_offset = pstate->header_offset;
+	return phandle->sol - phandle->sof;
+}
+
+static void lrec_reader_mmap_csvlite_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx)
+{
+	lrec_reader_mmap_csvlite_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (header_offset >= 0LL) {
+		// The header may be the one already in effect, whose line has since been parsed in place.
+		if (header_offset != pstate->header_offset) {
+			if (phandle->sol != phandle->sof + header_offset)
+				pstate->ilno_known = FALSE;
+			phandle->sol = phandle->sof + header_offset;
+			lrec_reader_mmap_csvlite_ingest_header(phandle, pstate, pctx);
+			// For byte ranges the offset may be any line start, e.g. of the header line itself.
+			if (phandle->sol > phandle->sof + offset)
+				offset = phandle->sol - phandle->sof;
+		}
+		pstate->expect_header_line_next = FALSE;
+	} else {
+		pstate->expect_header_line_next = (header_offset == LREC_READER_HEADER_NEXT);
+	}
+	if (phandle->sol != phandle->sof + offset)
+		pstate->ilno_known = FALSE;
+	phandle->sol = phandle->sof + offset;
+}
+
+// ----------------------------------------------------------------
+// Returns FALSE at end of file.
+static int lrec_reader_mmap_csvlite_ingest_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_csvlite_state_t* pstate, context_t* pctx)
+{
+	pstate->header_offset = phandle->sol - phandle->sof;
+	slls_t* pheader_fields = (pstate->irslen == 1 && pstate->ifslen == 1)
+		? lrec_reader_mmap_csvlite_get_header_single_seps(phandle, pstate, pctx)
+		: lrec_reader_mmap_csvlite_get_header_multi_seps(phandle, pstate);
+	if (pheader_fields == NULL) // EOF
+		return FALSE;
+
+	for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
+		if (*pe->value == 0) {
+			fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\"%s.\n",
+				MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " line ", pstate->ilno));
+			exit(1);
+		}
+	}
+
+	pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
+	if (pstate->pheader_keeper == NULL) {
+		pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
+		lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
+			NO_FREE); // freed by header-keeper
+	} else { // Re-use the header-keeper in the header cache
+		slls_free(pheader_fields);
+	}
+	pstate->expect_header_line_next = FALSE;
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 static slls_t* lrec_reader_mmap_csvlite_get_header_single_seps(file_reader_mmap_state_t* phandle,
 	lrec_reader_mmap_csvlite_state_t* pstate, context_t* pctx)
@@ -358,12 +405,15 @@ static slls_t* lrec_reader_mmap_csvlite_get_header_multi_seps(file_reader_mmap_s
 	char* header_name = p;
 
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs[0], ifs[0], ifs[0]);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, irs, irslen)) {
 			*p = 0;
 			phandle->sol = p + irslen;
 			pstate->ilno++;
 			break;
-		} else if (streqn(p, ifs, ifslen)) {
+		} else if (sep_matches(p, phandle->eof, ifs, ifslen)) {
 			*p = 0;
 
 			slls_append_no_free(pheader_names, header_name);
@@ -443,8 +493,8 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_single_seps(file_reader_mmap_
 		} else if (*p == ifs) {
 			*p = 0;
 			if (pe == NULL) {
-				fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-					MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+				fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+					MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 				exit(1);
 			}
 			key = pe->value;
@@ -468,8 +518,8 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_single_seps(file_reader_mmap_
 		return prec;
 
 	if (pe == NULL) {
-		fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-			MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+		fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+			MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 		exit(1);
 	}
 	key = pe->value;
@@ -488,8 +538,8 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_single_seps(file_reader_mmap_
 	}
 
 	if (pe->pnext != NULL) {
-		fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-			MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+		fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+			MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 		exit(1);
 	}
 
@@ -526,7 +576,10 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps(file_reader_mmap_s
 	char* value = p;
 	int saw_rs = FALSE;
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs[0], ifs[0], ifs[0]);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, irs, irslen)) {
 			if (p == line) {
 				*pend_of_stanza = TRUE;
 				lrec_free(prec);
@@ -537,11 +590,11 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps(file_reader_mmap_s
 			pstate->ilno++;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, ifs, ifslen)) {
+		} else if (sep_matches(p, phandle->eof, ifs, ifslen)) {
 			*p = 0;
 			if (pe == NULL) {
-				fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-					MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+				fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+					MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 				exit(1);
 			}
 			key = pe->value;
@@ -565,8 +618,8 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps(file_reader_mmap_s
 		return prec;
 
 	if (pe == NULL) {
-		fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-			MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+		fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+			MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 		exit(1);
 	}
 	key = pe->value;
@@ -585,8 +638,8 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps(file_reader_mmap_s
 	}
 
 	if (pe->pnext != NULL) {
-		fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
-			MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+		fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+			MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
 		exit(1);
 	}
 
@@ -713,7 +766,10 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps_implicit_header(fi
 	int idx = 0;
 	int saw_rs = FALSE;
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs[0], ifs[0], ifs[0]);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, irs, irslen)) {
 			if (p == line) {
 				*pend_of_stanza = TRUE;
 				lrec_free(prec);
@@ -724,7 +780,7 @@ static lrec_t* lrec_reader_mmap_csvlite_get_record_multi_seps_implicit_header(fi
 			pstate->ilno++;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, ifs, ifslen)) {
+		} else if (sep_matches(p, phandle->eof, ifs, ifslen)) {
 			*p = 0;
 			key = low_int_to_string(++idx, &free_flags);
 			lrec_put(prec, key, value, free_flags);
@@ -822,3 +878,14 @@ static int handle_comment_line_multi_irs(
 		return FALSE;
 	}
 }
+
+// ----------------------------------------------------------------
+// Where an error is, for its message: the prefix and the input line number, or nothing after a seek. Only for
+// the message just before exiting, since the text is in a static buffer.
+static char* ilno_desc(lrec_reader_mmap_csvlite_state_t* pstate, char* prefix, long long ilno) {
+	static char buf[64];
+	if (!pstate->ilno_known)
+		return "";
+	snprintf(buf, sizeof(buf), "%s%lld", prefix, ilno);
+	return buf;
+}
@@ -12,7 +12,9 @@
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_masks.h"
 #include "input/file_reader_mmap.h"
+#include "input/line_readers.h"
 #include "input/lrec_readers.h"
 
 typedef struct _lrec_reader_mmap_dkvp_state_t {
@@ -27,10 +29,14 @@ typedef struct _lrec_reader_mmap_dkvp_state_t {
 	comment_handling_t comment_handling;
 	char* comment_string;
 	int   comment_string_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
 } lrec_reader_mmap_dkvp_state_t;
 
 static void    lrec_reader_mmap_dkvp_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle);
+static long long lrec_reader_mmap_dkvp_count(void* pvstate, void* pvhandle, context_t* pctx);
+static int     lrec_reader_mmap_dkvp_seek_tail(void* pvstate, void* pvhandle, long long num_records, context_t* pctx);
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx);
@@ -61,7 +67,8 @@ static void skip_over_comment_lines_multi_irs(
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -77,6 +84,8 @@ lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int
 	pstate->comment_handling      = comment_handling;
 	pstate->comment_string        = comment_string;
 	pstate->comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	pstate->pfield_projection     = pfield_projection;
+	pstate->precord_predicate     = precord_predicate;
 
 	plrec_reader->pvstate     = (void*)pstate;
 	plrec_reader->popen_func  = file_reader_mmap_vopen;
@@ -102,6 +111,11 @@ lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int
 			: lrec_reader_mmap_dkvp_process_multi_irs_multi_others;
 	}
 	plrec_reader->psof_func   = lrec_reader_mmap_dkvp_sof;
+	plrec_reader->pcount_func = lrec_reader_mmap_dkvp_count;
+	plrec_reader->ptell_func  = file_reader_mmap_vtell;
+	plrec_reader->pseek_func  = file_reader_mmap_vseek;
+	plrec_reader->pseek_tail_func = lrec_reader_mmap_dkvp_seek_tail;
+	plrec_reader->preread_func    = file_reader_mmap_reread;
 	plrec_reader->pfree_func  = lrec_reader_mmap_dkvp_free;
 
 	return plrec_reader;
@@ -116,43 +130,71 @@ static void lrec_reader_mmap_dkvp_free(lrec_reader_t* preader) {
 static void lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle) {
 }
 
+// ----------------------------------------------------------------
+// Each line is a record, whatever is in it.
+static long long lrec_reader_mmap_dkvp_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	return mlr_count_lines_mmap(pvhandle, pstate->irs, pstate->irslen, pstate->do_auto_line_term,
+		pstate->comment_handling, pstate->comment_string, pctx);
+}
+
+// Likewise when reading backward.
+static int lrec_reader_mmap_dkvp_seek_tail(void* pvstate, void* pvhandle, long long num_records, context_t* pctx) {
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	char* start = mlr_find_last_lines_mmap(phandle, pstate->irs, pstate->irslen, pstate->comment_string,
+		num_records);
+	if (start == NULL)
+		return FALSE;
+	phandle->sol = start;
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_single_irs_single_others(phandle, pstate->irs[0], pstate->ifs[0], pstate->ips[0],
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_dkvp_single_irs_single_others(phandle, pstate->irs[0], pstate->ifs[0], pstate->ips[0],
 			pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_single_irs_multi_others(phandle, pstate->irs[0], pstate, pctx);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_dkvp_single_irs_multi_others(phandle, pstate->irs[0], pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_multi_irs_single_others(phandle, pstate->ifs[0], pstate->ips[0],
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_dkvp_multi_irs_single_others(phandle, pstate->ifs[0], pstate->ips[0],
 			pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_multi_irs_multi_others(phandle, pstate, pctx);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_dkvp_multi_irs_multi_others(phandle, pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 // ----------------------------------------------------------------
@@ -206,10 +248,10 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 			}
 
 			p++;
@@ -242,15 +284,15 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof)
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			else
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
 			if (value >= phandle->eof)
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			else
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -260,18 +302,18 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof) {
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
 		else {
 			if (value >= phandle->eof) {
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, key, copy, FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, copy, FREE_ENTRY_VALUE);
 			}
 		}
 	}
@@ -303,8 +345,12 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 	int saw_ps = FALSE;
 	int saw_rs = FALSE;
 
+	char irs0 = pstate->irs[0];
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, pstate->irs, pstate->irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs0, ifs, ips);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, pstate->irs, pstate->irslen)) {
 			*p = 0;
 			phandle->sol = p + pstate->irslen;
 			saw_rs = TRUE;
@@ -319,10 +365,10 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 			}
 
 			p++;
@@ -355,15 +401,15 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof)
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			else
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
 			if (value >= phandle->eof)
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			else
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -373,18 +419,18 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof) {
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
 		else {
 			if (value >= phandle->eof) {
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, key, copy, FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, copy, FREE_ENTRY_VALUE);
 			}
 		}
 	}
@@ -416,7 +462,12 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 	int saw_ps = FALSE;
 	int saw_rs = FALSE;
 
+	char ifs0 = pstate->ifs[0];
+	char ips0 = pstate->ips[0];
 	for ( ; p < phandle->eof && *p; ) {
+		p = find_sep_candidate(p, phandle->eof, irs, ifs0, ips0);
+		if (p >= phandle->eof || *p == 0)
+			break;
 		if (*p == irs) {
 			*p = 0;
 
@@ -432,7 +483,7 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 			phandle->sol = p+1;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, pstate->ifs, pstate->ifslen)) {
+		} else if (sep_matches(p, phandle->eof, pstate->ifs, pstate->ifslen)) {
 			saw_ps = FALSE;
 			*p = 0;
 
@@ -442,10 +493,10 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 			}
 
 			p += pstate->ifslen;
@@ -455,7 +506,7 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 			}
 			key = p;
 			value = p;
-		} else if (streqn(p, pstate->ips, pstate->ipslen) && !saw_ps) {
+		} else if (sep_matches(p, phandle->eof, pstate->ips, pstate->ipslen) && !saw_ps) {
 			*p = 0;
 			p += pstate->ipslen;
 			value = p;
@@ -479,15 +530,15 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof)
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			else
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
 			if (value >= phandle->eof)
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			else
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -497,18 +548,18 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_multi_others(file_reader_mmap_sta
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof) {
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
 		else {
 			if (value >= phandle->eof) {
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, key, copy, FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, copy, FREE_ENTRY_VALUE);
 			}
 		}
 	}
@@ -540,13 +591,19 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_multi_others(file_reader_mmap_stat
 	int saw_ps = FALSE;
 	int saw_rs = FALSE;
 
+	char irs0 = pstate->irs[0];
+	char ifs0 = pstate->ifs[0];
+	char ips0 = pstate->ips[0];
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, pstate->irs, pstate->irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs0, ifs0, ips0);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, pstate->irs, pstate->irslen)) {
 			*p = 0;
 			phandle->sol = p + pstate->irslen;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, pstate->ifs, pstate->ifslen)) {
+		} else if (sep_matches(p, phandle->eof, pstate->ifs, pstate->ifslen)) {
 			saw_ps = FALSE;
 			*p = 0;
 
@@ -556,10 +613,10 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_multi_others(file_reader_mmap_stat
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 			}
 
 			p += pstate->ifslen;
@@ -569,7 +626,7 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_multi_others(file_reader_mmap_stat
 			}
 			key = p;
 			value = p;
-		} else if (streqn(p, pstate->ips, pstate->ipslen) && !saw_ps) {
+		} else if (sep_matches(p, phandle->eof, pstate->ips, pstate->ipslen) && !saw_ps) {
 			*p = 0;
 			p += pstate->ipslen;
 			value = p;
@@ -592,15 +649,15 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_multi_others(file_reader_mmap_stat
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof)
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			else
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
 			if (value >= phandle->eof)
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			else
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, NO_FREE);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -610,18 +667,18 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_multi_others(file_reader_mmap_stat
 		if (*key == 0 || value <= key) {
 			char free_flags = NO_FREE;
 			if (value >= phandle->eof) {
-				lrec_put(prec, low_int_to_string(idx, &free_flags), "", free_flags);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), "", free_flags);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
 		else {
 			if (value >= phandle->eof) {
-				lrec_put(prec, key, "", NO_FREE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, "", NO_FREE);
 			} else {
 				char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-				lrec_put(prec, key, copy, FREE_ENTRY_VALUE);
+				lrec_put_projected(prec, pstate->pfield_projection, key, copy, FREE_ENTRY_VALUE);
 			}
 		}
 	}
@@ -678,6 +735,13 @@ static void skip_over_comment_lines_multi_irs(
 				for (int i = 0; i < irslen; i++)
 					fputc(phandle->sol[i], stdout);
 			phandle->sol += irslen;
+		} else {
+			// Unterminated comment line at end of file, with fewer than irslen bytes left.
+			while (phandle->sol < phandle->eof) {
+				if (pstate->comment_handling == PASS_COMMENTS)
+					fputc(*phandle->sol, stdout);
+				phandle->sol++;
+			}
 		}
 	}
 }
@@ -74,6 +74,11 @@ lrec_reader_t* lrec_reader_mmap_json_alloc(char* input_json_flatten_separator, j
 	plrec_reader->pclose_func   = file_reader_mmap_vclose;
 	plrec_reader->pprocess_func = lrec_reader_mmap_json_process;
 	plrec_reader->psof_func     = lrec_reader_mmap_json_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_mmap_json_free;
 
 	return plrec_reader;
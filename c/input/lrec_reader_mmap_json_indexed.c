@@ -0,0 +1,803 @@
+// ================================================================
+// Note: there are multiple process methods with a lot of code duplication.
+// This is intentional. Much of Miller's measured processing time is in the
+// lrec-reader process methods. This is code which needs to execute on every
+// byte of input and even moving a single runtime if-statement into a
+// function-pointer assignment at alloc time can have noticeable effects on
+// performance (5-10% in some cases).
+// ================================================================
+
+// ================================================================
+// Two-stage JSON reader for mmapped input. This is the default for JSON files;
+// lrec_reader_mmap_json (--no-json-index) is the fallback.
+//
+// Stage one indexes the input a batch at a time: each 64-byte block is
+// classified a word at a time (see lib/byte_masks.h) into bitmasks of double
+// quotes, backslashes, and the structural characters { } [ ] : and ,. From
+// the backslashes we find which quotes are escaped; a prefix-XOR over the
+// unescaped quotes then gives the bytes which are inside strings, and the
+// token index for the block is the unescaped quotes plus the structural
+// characters outside of strings. Stage two walks the token index, recursive
+// descent, flattening keys and values into one record per top-level object.
+// Numbers and true/false/null are what lies between tokens.
+//
+// As with the other mmap readers, keys and values point into the file
+// contents, with closing quotes and number terminators overwritten by null
+// characters: the mapping is private, and is never unmapped. Since the token
+// characters are stored in the index, stage two never needs to re-read a byte
+// it may have overwritten. Strings with backslash escapes are decoded into
+// allocated copies; nested keys, which are prefixed by the enclosing keys and
+// the flatten separator, are likewise allocated.
+//
+// Unlike lrec_reader_mmap_json, records are produced one top-level object at
+// a time, and input syntax is as for lrec_reader_stdio_json.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cli/json_array_ingest.h"
+#include "cli/comment_handling.h"
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/byte_masks.h"
+#include "input/file_reader_mmap.h"
+#include "input/lrec_readers.h"
+#include "input/json_parser.h"
+#include "input/mlr_json_adapter.h"
+
+#define JSON_INDEX_BLOCK_SIZE 64
+#define JSON_INDEX_BATCH_SIZE (64 * 1024) // Multiple of the block size
+#define JSON_INDEX_PREFIX_INIT_SIZE 128
+
+typedef enum _json_indexed_top_level_t {
+	JSON_INDEXED_OUTSIDE_ARRAY,
+	JSON_INDEXED_ARRAY_EXPECT_VALUE,
+	JSON_INDEXED_ARRAY_EXPECT_COMMA,
+} json_indexed_top_level_t;
+
+typedef struct _lrec_reader_mmap_json_indexed_state_t {
+	char* input_json_flatten_separator;
+	int   flatten_sep_length;
+	json_array_ingest_t json_array_ingest;
+	char* specified_line_term;
+	int do_auto_line_term;
+	char* detected_line_term;
+	comment_handling_t comment_handling;
+	char* comment_string;
+
+	char* pfile_start; // For line numbers in error messages
+	char* sof;         // After the BOM if any
+	char* eof;
+
+	// Stage one. The token index holds positions and characters for the current batch.
+	char*    pindexed;        // Start of the next batch
+	uint64_t escape_carry;    // 1 if the first byte of the next block is backslash-escaped
+	uint64_t in_string_carry; // All ones if the next block starts within a string
+	char**   token_ptrs;
+	char*    token_chars;
+	int      num_tokens;
+	int      token_index;
+
+	// Stage two.
+	char* pcur; // Just past the last consumed token or scalar
+	long long num_poked_newlines;
+	json_indexed_top_level_t top_level;
+	char* prefix; // Enclosing keys for nested objects, each followed by the flatten separator
+	int   prefix_length;
+	int   prefix_alloc;
+} lrec_reader_mmap_json_indexed_state_t;
+
+static void    lrec_reader_mmap_json_indexed_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_json_indexed_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_json_indexed_process(void* pvstate, void* pvhandle, context_t* pctx);
+
+static void json_indexed_parse_object(lrec_reader_mmap_json_indexed_state_t* pstate, lrec_t* prec);
+static void json_indexed_parse_value(lrec_reader_mmap_json_indexed_state_t* pstate, lrec_t* prec,
+	char* name, char name_free_flags);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_json_indexed_alloc(char* input_json_flatten_separator,
+	json_array_ingest_t json_array_ingest, char* line_term,
+	comment_handling_t comment_handling, char* comment_string)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_json_indexed_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_json_indexed_state_t));
+	pstate->input_json_flatten_separator  = input_json_flatten_separator;
+	pstate->flatten_sep_length            = strlen(input_json_flatten_separator);
+	pstate->json_array_ingest             = json_array_ingest;
+	pstate->specified_line_term           = line_term;
+	pstate->do_auto_line_term             = FALSE;
+	pstate->detected_line_term            = "\n"; // xxx adapt to MLR_GLOBALS/ctx-const for Windows port
+	pstate->comment_handling              = comment_handling;
+	pstate->comment_string                = comment_string;
+
+	pstate->pfile_start                   = NULL;
+	pstate->sof                           = NULL;
+	pstate->eof                           = NULL;
+	pstate->pindexed                      = NULL;
+	pstate->escape_carry                  = 0ULL;
+	pstate->in_string_carry               = 0ULL;
+	pstate->token_ptrs                    = mlr_malloc_or_die(JSON_INDEX_BATCH_SIZE * sizeof(char*));
+	pstate->token_chars                   = mlr_malloc_or_die(JSON_INDEX_BATCH_SIZE);
+	pstate->num_tokens                    = 0;
+	pstate->token_index                   = 0;
+
+	pstate->pcur                          = NULL;
+	pstate->num_poked_newlines            = 0LL;
+	pstate->top_level                     = JSON_INDEXED_OUTSIDE_ARRAY;
+	pstate->prefix_alloc                  = JSON_INDEX_PREFIX_INIT_SIZE;
+	pstate->prefix                        = mlr_malloc_or_die(pstate->prefix_alloc);
+	pstate->prefix[0]                     = 0;
+	pstate->prefix_length                 = 0;
+
+	if (streq(line_term, "auto")) {
+		pstate->do_auto_line_term = TRUE;
+	}
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	plrec_reader->pprocess_func = lrec_reader_mmap_json_indexed_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_json_indexed_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_mmap_json_indexed_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_mmap_json_indexed_free(lrec_reader_t* preader) {
+	lrec_reader_mmap_json_indexed_state_t* pstate = preader->pvstate;
+	free(pstate->token_ptrs);
+	free(pstate->token_chars);
+	free(pstate->prefix);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_mmap_json_indexed_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_mmap_json_indexed_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+
+	pstate->pfile_start = phandle->sol;
+	pstate->sof         = phandle->sol;
+	pstate->eof         = phandle->eof;
+
+	// Skip UTF-8 BOM if any
+	if (pstate->eof - pstate->sof >= 3 && memcmp(pstate->sof, "\xef\xbb\xbf", 3) == 0)
+		pstate->sof += 3;
+
+	// Find the first line-ending sequence (if any): LF or CRLF.
+	if (pstate->do_auto_line_term) {
+		char* p = memchr(pstate->sof, '\n', pstate->eof - pstate->sof);
+		if (p != NULL)
+			pstate->detected_line_term = (p > pstate->sof && p[-1] == '\r') ? "\r\n" : "\n";
+	}
+
+	// Miller data comments must be at start of line. As in lrec_reader_mmap_json, these are blanked out
+	// up front.
+	if (pstate->comment_handling != COMMENTS_ARE_DATA) {
+		char* line_term = pstate->do_auto_line_term ? pstate->detected_line_term : pstate->specified_line_term;
+		mlr_json_strip_comments(pstate->sof, pstate->eof, pstate->comment_handling, pstate->comment_string,
+			line_term);
+	}
+
+	pstate->pindexed           = pstate->sof;
+	pstate->escape_carry       = 0ULL;
+	pstate->in_string_carry    = 0ULL;
+	pstate->num_tokens         = 0;
+	pstate->token_index        = 0;
+	pstate->pcur               = pstate->sof;
+	pstate->num_poked_newlines = 0LL;
+	pstate->top_level          = JSON_INDEXED_OUTSIDE_ARRAY;
+	pstate->prefix_length      = 0;
+	pstate->prefix[0]          = 0;
+}
+
+// ================================================================
+// STAGE ONE
+
+// Bit i is set iff there are an odd number of set bits in m at positions 0 through i.
+static inline uint64_t prefix_xor(uint64_t m) {
+	m ^= m << 1;
+	m ^= m << 2;
+	m ^= m << 4;
+	m ^= m << 8;
+	m ^= m << 16;
+	m ^= m << 32;
+	return m;
+}
+
+// The block is 64 readable bytes; base is where they are in the file.
+static inline void json_index_block(lrec_reader_mmap_json_indexed_state_t* pstate, char* base, char* block) {
+	uint64_t quotes      = 0ULL;
+	uint64_t backslashes = 0ULL;
+	uint64_t structurals = 0ULL;
+
+#ifdef MLR_BYTE_MASKS_USE_WORDS
+	// Setting the 0x20 bit maps [ to { and ] to }, and nothing else to either.
+	for (int i = 0; i < JSON_INDEX_BLOCK_SIZE / 8; i++) {
+		uint64_t x;
+		memcpy(&x, block + 8*i, 8);
+		uint64_t y = x | (BYTES_01 * 0x20);
+		quotes      |= gather_high_bits(bytes_equal_to(x, BYTES_01 * '"')) << (8*i);
+		backslashes |= gather_high_bits(bytes_equal_to(x, BYTES_01 * '\\')) << (8*i);
+		structurals |= gather_high_bits(
+			bytes_equal_to(y, BYTES_01 * '{') | bytes_equal_to(y, BYTES_01 * '}') |
+			bytes_equal_to(x, BYTES_01 * ':') | bytes_equal_to(x, BYTES_01 * ',')) << (8*i);
+	}
+#else
+	for (int i = 0; i < JSON_INDEX_BLOCK_SIZE; i++) {
+		switch (block[i]) {
+		case '"':
+			quotes |= 1ULL << i;
+			break;
+		case '\\':
+			backslashes |= 1ULL << i;
+			break;
+		case '{': case '}': case '[': case ']': case ':': case ',':
+			structurals |= 1ULL << i;
+			break;
+		}
+	}
+#endif
+
+	// Each backslash which isn't itself escaped escapes the byte after it. Backslashes are rare enough that
+	// a loop over them is fine.
+	uint64_t escaped = pstate->escape_carry;
+	pstate->escape_carry = 0ULL;
+	uint64_t escapers = backslashes & ~escaped;
+	while (escapers != 0ULL) {
+		int i = lowest_set_bit(escapers);
+		escapers &= escapers - 1;
+		if (i == JSON_INDEX_BLOCK_SIZE - 1) {
+			pstate->escape_carry = 1ULL;
+		} else {
+			escaped  |= 1ULL << (i + 1);
+			escapers &= ~(1ULL << (i + 1));
+		}
+	}
+
+	// Opening quotes and string contents are in the string mask; closing quotes aren't.
+	uint64_t unescaped_quotes = quotes & ~escaped;
+	uint64_t in_string = prefix_xor(unescaped_quotes) ^ pstate->in_string_carry;
+	pstate->in_string_carry = (uint64_t)((int64_t)in_string >> 63);
+
+	uint64_t tokens = unescaped_quotes | (structurals & ~in_string);
+	int n = pstate->num_tokens;
+	while (tokens != 0ULL) {
+		int i = lowest_set_bit(tokens);
+		tokens &= tokens - 1;
+		pstate->token_ptrs[n]  = base + i;
+		pstate->token_chars[n] = block[i];
+		n++;
+	}
+	pstate->num_tokens = n;
+}
+
+// Replaces the token index with that of the next batch of input. Returns FALSE at end of input.
+static int json_index_next_batch(lrec_reader_mmap_json_indexed_state_t* pstate) {
+	pstate->num_tokens  = 0;
+	pstate->token_index = 0;
+
+	while (pstate->num_tokens == 0) {
+		char* base = pstate->pindexed;
+		char* eof  = pstate->eof;
+		if (base >= eof)
+			return FALSE;
+		char* batch_end = (eof - base > JSON_INDEX_BATCH_SIZE) ? base + JSON_INDEX_BATCH_SIZE : eof;
+
+		for ( ; batch_end - base >= JSON_INDEX_BLOCK_SIZE; base += JSON_INDEX_BLOCK_SIZE)
+			json_index_block(pstate, base, base);
+		if (base < batch_end) {
+			// Partial block at end of input. Padding with spaces adds no tokens.
+			char block[JSON_INDEX_BLOCK_SIZE];
+			memset(block, ' ', JSON_INDEX_BLOCK_SIZE);
+			memcpy(block, base, batch_end - base);
+			json_index_block(pstate, base, block);
+		}
+		pstate->pindexed = batch_end;
+	}
+	return TRUE;
+}
+
+// ================================================================
+// STAGE TWO
+
+// Returns the character of the next token, or 0 at end of input, with *pptr set to its position (eof at end
+// of input). The token is not consumed.
+static inline char json_peek_token(lrec_reader_mmap_json_indexed_state_t* pstate, char** pptr) {
+	if (pstate->token_index >= pstate->num_tokens && !json_index_next_batch(pstate)) {
+		*pptr = pstate->eof;
+		return 0;
+	}
+	*pptr = pstate->token_ptrs[pstate->token_index];
+	return pstate->token_chars[pstate->token_index];
+}
+
+static inline void json_consume_token(lrec_reader_mmap_json_indexed_state_t* pstate, char* ptr) {
+	pstate->token_index++;
+	pstate->pcur = ptr + 1;
+}
+
+static inline int json_is_whitespace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline char* json_skip_whitespace(char* p, char* end) {
+	while (p < end && json_is_whitespace(*p))
+		p++;
+	return p;
+}
+
+// ----------------------------------------------------------------
+static long long json_line_number(lrec_reader_mmap_json_indexed_state_t* pstate, char* p) {
+	long long ilno = 1LL + pstate->num_poked_newlines;
+	for (char* q = pstate->pfile_start; q < p && q < pstate->eof; q++)
+		if (*q == '\n')
+			ilno++;
+	return ilno;
+}
+
+static void json_fail_at(lrec_reader_mmap_json_indexed_state_t* pstate, char* p, char* message) {
+	fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: %s\n", MLR_GLOBALS.bargv0,
+		json_line_number(pstate, p), message);
+	exit(1);
+}
+
+// c is 0 for end of input.
+static void json_fail_unexpected_at(lrec_reader_mmap_json_indexed_state_t* pstate, char* p, char c, char* where) {
+	if (c == 0)
+		fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: Unexpected EOF %s\n",
+			MLR_GLOBALS.bargv0, json_line_number(pstate, p), where);
+	else
+		fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: Unexpected `%c` %s\n",
+			MLR_GLOBALS.bargv0, json_line_number(pstate, p), c, where);
+	exit(1);
+}
+
+// Consumes the next token, after checking there is only whitespace before it. Returns its character, or 0 at
+// end of input.
+static inline char json_take_token(lrec_reader_mmap_json_indexed_state_t* pstate, char** pptr, char* where) {
+	char c = json_peek_token(pstate, pptr);
+	char* p = json_skip_whitespace(pstate->pcur, *pptr);
+	if (p < *pptr)
+		json_fail_unexpected_at(pstate, p, *p, where);
+	if (c != 0)
+		json_consume_token(pstate, *pptr);
+	return c;
+}
+
+static json_type_t json_indexed_type_from_first_char(char c) {
+	switch (c) {
+	case '{': return JSON_OBJECT;
+	case '[': return JSON_ARRAY;
+	case '"': return JSON_STRING;
+	case 't': case 'f': return JSON_BOOLEAN;
+	case 'n': return JSON_NULL;
+	case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+		return JSON_INTEGER;
+	default: return JSON_NONE;
+	}
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_json_indexed_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_json_indexed_state_t* pstate = pvstate;
+	if (pstate->do_auto_line_term) {
+		context_set_autodetected_line_term(pctx, pstate->detected_line_term);
+	}
+
+	while (TRUE) {
+		char* ptok;
+		char c = json_peek_token(pstate, &ptok);
+		char* p = json_skip_whitespace(pstate->pcur, ptok);
+		if (p < ptok) {
+			// Only scalars lie between tokens.
+			c = *p;
+		} else if (c == 0) {
+			if (pstate->top_level != JSON_INDEXED_OUTSIDE_ARRAY)
+				json_fail_unexpected_at(pstate, p, c, "in top-level array");
+			return NULL;
+		} else {
+			json_consume_token(pstate, ptok);
+		}
+
+		switch (pstate->top_level) {
+
+		case JSON_INDEXED_OUTSIDE_ARRAY:
+			if (c == '[') {
+				pstate->top_level = JSON_INDEXED_ARRAY_EXPECT_VALUE;
+				continue;
+			}
+			if (c != '{') {
+				if (json_indexed_type_from_first_char(c) == JSON_NONE)
+					json_fail_unexpected_at(pstate, p, c, "when seeking value");
+				fprintf(stderr,
+					"%s: found non-terminal (type %s) at top level. This is valid but unmillerable JSON.\n",
+					MLR_GLOBALS.bargv0, json_describe_type(json_indexed_type_from_first_char(c)));
+				fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			break;
+
+		case JSON_INDEXED_ARRAY_EXPECT_VALUE:
+			if (c == ']') {
+				pstate->top_level = JSON_INDEXED_OUTSIDE_ARRAY;
+				continue;
+			}
+			if (c != '{') {
+				if (json_indexed_type_from_first_char(c) == JSON_NONE)
+					json_fail_unexpected_at(pstate, p, c, "in top-level array");
+				fprintf(stderr,
+					"%s: found non-object (type %s) within top-level array. This is valid but unmillerable JSON.\n",
+					MLR_GLOBALS.bargv0, json_describe_type(json_indexed_type_from_first_char(c)));
+				fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			pstate->top_level = JSON_INDEXED_ARRAY_EXPECT_COMMA;
+			break;
+
+		case JSON_INDEXED_ARRAY_EXPECT_COMMA:
+			if (c == ',') {
+				pstate->top_level = JSON_INDEXED_ARRAY_EXPECT_VALUE;
+			} else if (c == ']') {
+				pstate->top_level = JSON_INDEXED_OUTSIDE_ARRAY;
+			} else {
+				json_fail_unexpected_at(pstate, p, c, "in top-level array: expected , or ]");
+			}
+			continue;
+		}
+
+		lrec_t* prec = lrec_unbacked_alloc();
+		json_indexed_parse_object(pstate, prec);
+		return prec;
+	}
+}
+
+// ----------------------------------------------------------------
+static int json_indexed_get_hex4(lrec_reader_mmap_json_indexed_state_t* pstate, char* p, char* e) {
+	int value = 0;
+	for (int i = 0; i < 4; i++, p++) {
+		char c = (p < e) ? *p : '"';
+		if (c >= '0' && c <= '9')
+			value = (value << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			value = (value << 4) | (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			value = (value << 4) | (c - 'A' + 10);
+		else
+			json_fail_unexpected_at(pstate, p, c, "in \\u escape");
+	}
+	return value;
+}
+
+// Decodes the string contents [s, e), which contain at least one backslash, into a new allocation. The
+// result is never longer than the input.
+static char* json_indexed_unescape(lrec_reader_mmap_json_indexed_state_t* pstate, char* s, char* e) {
+	char* decoded = mlr_malloc_or_die(e - s + 1);
+	char* w = decoded;
+	for (char* p = s; p < e; ) {
+		char* q = memchr(p, '\\', e - p);
+		if (q == NULL)
+			q = e;
+		memcpy(w, p, q - p);
+		w += q - p;
+		if (q >= e)
+			break;
+
+		// Stage one guarantees a backslash is never the last byte before the closing quote.
+		p = q + 2;
+		switch (q[1]) {
+		case 'b': *w++ = '\b'; break;
+		case 'f': *w++ = '\f'; break;
+		case 'n': *w++ = '\n'; break;
+		case 'r': *w++ = '\r'; break;
+		case 't': *w++ = '\t'; break;
+		case 'u': {
+			unsigned int uchar = json_indexed_get_hex4(pstate, p, e);
+			p += 4;
+			if ((uchar & 0xF800) == 0xD800) { // UTF-16 surrogate pair
+				if (e - p < 2 || p[0] != '\\' || p[1] != 'u')
+					json_fail_at(pstate, p, "Unpaired UTF-16 surrogate in \\u escape");
+				unsigned int uchar2 = json_indexed_get_hex4(pstate, p + 2, e);
+				p += 6;
+				uchar = 0x010000 | ((uchar & 0x3FF) << 10) | (uchar2 & 0x3FF);
+			}
+			if (uchar <= 0x7F) {
+				*w++ = uchar;
+			} else if (uchar <= 0x7FF) {
+				*w++ = 0xC0 | (uchar >> 6);
+				*w++ = 0x80 | (uchar & 0x3F);
+			} else if (uchar <= 0xFFFF) {
+				*w++ = 0xE0 | (uchar >> 12);
+				*w++ = 0x80 | ((uchar >> 6) & 0x3F);
+				*w++ = 0x80 | (uchar & 0x3F);
+			} else {
+				*w++ = 0xF0 | (uchar >> 18);
+				*w++ = 0x80 | ((uchar >> 12) & 0x3F);
+				*w++ = 0x80 | ((uchar >> 6) & 0x3F);
+				*w++ = 0x80 | (uchar & 0x3F);
+			}
+			break;
+		}
+		default: // Including \" \\ and \/
+			*w++ = q[1];
+			break;
+		}
+	}
+	*w = 0;
+	return decoded;
+}
+
+// The opening quote at popen has been consumed. Consumes the closing quote and returns the string contents,
+// setting *pfree_flags to free_flag if they're in a new allocation.
+static inline char* json_indexed_take_string(lrec_reader_mmap_json_indexed_state_t* pstate, char* popen,
+	char* pfree_flags, char free_flag)
+{
+	char* pclose;
+	// The next token is the closing quote, or there is none.
+	if (json_peek_token(pstate, &pclose) == 0)
+		json_fail_unexpected_at(pstate, pclose, 0, "in string");
+	json_consume_token(pstate, pclose);
+
+	char* s = popen + 1;
+	if (memchr(s, '\\', pclose - s) == NULL) {
+		*pclose = 0;
+		*pfree_flags = NO_FREE;
+		return s;
+	} else {
+		*pfree_flags = free_flag;
+		return json_indexed_unescape(pstate, s, pclose);
+	}
+}
+
+// ----------------------------------------------------------------
+// Validates the number or true/false/null in [s, e), returning its value. Numbers are kept as-is, with
+// however many decimal places the input has: see json_parser.h.
+static char* json_indexed_take_scalar(lrec_reader_mmap_json_indexed_state_t* pstate, char* s, char* e) {
+	char* literal = NULL;
+	char* value = NULL;
+	switch (*s) {
+	case 't': literal = "true";  value = "true";  break;
+	case 'f': literal = "false"; value = "false"; break;
+	case 'n': literal = "null";  value = "";      break;
+	}
+	if (literal != NULL) {
+		char* p = s;
+		for (char* q = literal; *q; q++, p++) {
+			if (p >= e)
+				json_fail_unexpected_at(pstate, p, p < pstate->eof ? *p : 0, "in true/false/null");
+			if (*p != *q)
+				json_fail_unexpected_at(pstate, p, *p, "in true/false/null");
+		}
+		if (p < e)
+			json_fail_unexpected_at(pstate, p, *p, "in true/false/null");
+		pstate->pcur = e;
+		return value;
+	}
+
+	if (*s != '-' && !(*s >= '0' && *s <= '9'))
+		json_fail_unexpected_at(pstate, s, *s, "when seeking value");
+
+	// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	char* p = s;
+	if (*p == '-')
+		p++;
+	if (p >= e || !(*p >= '0' && *p <= '9'))
+		json_fail_at(pstate, p, "Expected digit in number");
+	if (*p == '0' && p + 1 < e && (p[1] >= '0' && p[1] <= '9'))
+		json_fail_at(pstate, p, "Unexpected `0` before digit in number");
+	while (p < e && (*p >= '0' && *p <= '9'))
+		p++;
+	if (p < e && *p == '.') {
+		p++;
+		if (p >= e || !(*p >= '0' && *p <= '9'))
+			json_fail_at(pstate, p, "Expected digit after `.`");
+		while (p < e && (*p >= '0' && *p <= '9'))
+			p++;
+	}
+	if (p < e && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < e && (*p == '+' || *p == '-'))
+			p++;
+		if (p >= e || !(*p >= '0' && *p <= '9'))
+			json_fail_at(pstate, p, "Expected digit after `e`");
+		while (p < e && (*p >= '0' && *p <= '9'))
+			p++;
+	}
+	if (p < e)
+		json_fail_unexpected_at(pstate, p, *p, "in number");
+	if (e >= pstate->eof)
+		json_fail_unexpected_at(pstate, e, 0, "in number");
+
+	// The terminator is whitespace or a token; either way we're done reading it.
+	if (*e == '\n')
+		pstate->num_poked_newlines++;
+	*e = 0;
+	pstate->pcur = e + 1;
+	return s;
+}
+
+// ----------------------------------------------------------------
+// For leaves: the record key is the name, prefixed by the enclosing keys if any.
+static inline char* json_indexed_leaf_key(lrec_reader_mmap_json_indexed_state_t* pstate,
+	char* name, char name_free_flags, char* pkey_free_flags)
+{
+	if (pstate->prefix_length == 0) {
+		*pkey_free_flags = name_free_flags;
+		return name;
+	}
+	int name_length = strlen(name);
+	char* key = mlr_malloc_or_die(pstate->prefix_length + name_length + 1);
+	memcpy(key, pstate->prefix, pstate->prefix_length);
+	memcpy(key + pstate->prefix_length, name, name_length + 1);
+	if (name_free_flags)
+		free(name);
+	*pkey_free_flags = FREE_ENTRY_KEY;
+	return key;
+}
+
+// For non-leaves: the name and the flatten separator are appended to the prefix. The return value is passed
+// to pop_prefix.
+static int json_indexed_push_prefix(lrec_reader_mmap_json_indexed_state_t* pstate, char* name, char name_free_flags) {
+	int saved_prefix_length = pstate->prefix_length;
+	int name_length = strlen(name);
+	int new_length = saved_prefix_length + name_length + pstate->flatten_sep_length;
+	if (new_length + 1 > pstate->prefix_alloc) {
+		pstate->prefix_alloc = 2 * (new_length + 1);
+		pstate->prefix = mlr_realloc_or_die(pstate->prefix, pstate->prefix_alloc);
+	}
+	memcpy(pstate->prefix + saved_prefix_length, name, name_length);
+	memcpy(pstate->prefix + saved_prefix_length + name_length, pstate->input_json_flatten_separator,
+		pstate->flatten_sep_length + 1);
+	pstate->prefix_length = new_length;
+	if (name_free_flags)
+		free(name);
+	return saved_prefix_length;
+}
+
+static void json_indexed_pop_prefix(lrec_reader_mmap_json_indexed_state_t* pstate, int saved_prefix_length) {
+	pstate->prefix_length = saved_prefix_length;
+	pstate->prefix[saved_prefix_length] = 0;
+}
+
+// ----------------------------------------------------------------
+// The opening brace has been consumed. If prec is NULL, the object is parsed for syntax only.
+static void json_indexed_parse_object(lrec_reader_mmap_json_indexed_state_t* pstate, lrec_t* prec) {
+	char* ptok;
+	char c = json_take_token(pstate, &ptok, "in object");
+	if (c == '}')
+		return;
+
+	while (TRUE) {
+		if (c != '"')
+			json_fail_unexpected_at(pstate, ptok, c, "in object");
+		char name_free_flags;
+		char* name = json_indexed_take_string(pstate, ptok, &name_free_flags, FREE_ENTRY_KEY);
+
+		c = json_take_token(pstate, &ptok, "in object: expected :");
+		if (c != ':')
+			json_fail_unexpected_at(pstate, ptok, c, "in object: expected :");
+
+		json_indexed_parse_value(pstate, prec, name, name_free_flags);
+
+		c = json_take_token(pstate, &ptok, "in object: expected , or }");
+		if (c == '}')
+			return;
+		if (c != ',')
+			json_fail_unexpected_at(pstate, ptok, c, "in object: expected , or }");
+		c = json_take_token(pstate, &ptok, "in object");
+		if (c == '}')
+			return;
+	}
+}
+
+// The opening bracket has been consumed. If prec is NULL, the array is parsed for syntax only.
+static void json_indexed_parse_array_as_map(lrec_reader_mmap_json_indexed_state_t* pstate, lrec_t* prec) {
+	char* ptok;
+	char c = json_peek_token(pstate, &ptok);
+	char* p = json_skip_whitespace(pstate->pcur, ptok);
+	if (p == ptok && c == ']') {
+		json_consume_token(pstate, ptok);
+		return;
+	}
+
+	int idx = 0;
+	char name[32];
+	while (TRUE) {
+		sprintf(name, "%d", idx++);
+		json_indexed_parse_value(pstate, prec, name, NO_FREE);
+
+		c = json_take_token(pstate, &ptok, "in array: expected , or ]");
+		if (c == ']')
+			return;
+		if (c != ',')
+			json_fail_unexpected_at(pstate, ptok, c, "in array: expected , or ]");
+		c = json_peek_token(pstate, &ptok);
+		p = json_skip_whitespace(pstate->pcur, ptok);
+		if (p == ptok && c == ']') {
+			json_consume_token(pstate, ptok);
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// The name and colon have been consumed. The name is owned by this function.
+static void json_indexed_parse_value(lrec_reader_mmap_json_indexed_state_t* pstate, lrec_t* prec,
+	char* name, char name_free_flags)
+{
+	char* ptok;
+	char c = json_peek_token(pstate, &ptok);
+	char* p = json_skip_whitespace(pstate->pcur, ptok);
+	char value_free_flags = NO_FREE;
+	char* value = NULL;
+	int saved_prefix_length;
+
+	if (p < ptok) {
+		// Number or true/false/null, up to the next token.
+		char* e = ptok;
+		while (e > p && json_is_whitespace(e[-1]))
+			e--;
+		value = json_indexed_take_scalar(pstate, p, e);
+
+	} else if (c == '"') {
+		json_consume_token(pstate, ptok);
+		value = json_indexed_take_string(pstate, ptok, &value_free_flags, FREE_ENTRY_VALUE);
+
+	} else if (c == '{') {
+		json_consume_token(pstate, ptok);
+		saved_prefix_length = json_indexed_push_prefix(pstate, name, name_free_flags);
+		json_indexed_parse_object(pstate, prec);
+		json_indexed_pop_prefix(pstate, saved_prefix_length);
+		return;
+
+	} else if (c == '[') {
+		json_consume_token(pstate, ptok);
+		switch (pstate->json_array_ingest) {
+		case JSON_ARRAY_INGEST_FATAL:
+			fprintf(stderr,
+				"%s: found array item within JSON object. This is valid but unmillerable JSON.\n"
+				"Use --json-skip-arrays-on-input to exclude these from input without fataling.\n"
+				"Or, --json-map-arrays-on-input to convert them to integer-indexed maps.\n",
+				MLR_GLOBALS.bargv0);
+			fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+			break;
+		case JSON_ARRAY_INGEST_AS_MAP:
+			saved_prefix_length = json_indexed_push_prefix(pstate, name, name_free_flags);
+			json_indexed_parse_array_as_map(pstate, prec);
+			json_indexed_pop_prefix(pstate, saved_prefix_length);
+			break;
+		default:
+			// Parse for syntax, then discard.
+			saved_prefix_length = json_indexed_push_prefix(pstate, name, name_free_flags);
+			json_indexed_parse_array_as_map(pstate, NULL);
+			json_indexed_pop_prefix(pstate, saved_prefix_length);
+			break;
+		}
+		return;
+
+	} else {
+		json_fail_unexpected_at(pstate, p, c, "when seeking value");
+	}
+
+	if (prec == NULL) {
+		if (name_free_flags)
+			free(name);
+		if (value_free_flags)
+			free(value);
+		return;
+	}
+	char key_free_flags;
+	char* key = json_indexed_leaf_key(pstate, name, name_free_flags, &key_free_flags);
+	lrec_put(prec, key, value, key_free_flags | value_free_flags);
+}
@@ -10,7 +10,9 @@
 #include <stdlib.h>
 #include "cli/comment_handling.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_masks.h"
 #include "input/file_reader_mmap.h"
+#include "input/line_readers.h"
 #include "input/lrec_readers.h"
 
 typedef struct _lrec_reader_mmap_nidx_state_t {
@@ -23,10 +25,14 @@ typedef struct _lrec_reader_mmap_nidx_state_t {
 	comment_handling_t comment_handling;
 	char* comment_string;
 	int   comment_string_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
 } lrec_reader_mmap_nidx_state_t;
 
 static void    lrec_reader_mmap_nidx_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_nidx_sof(void* pvstate, void* pvhandle);
+static long long lrec_reader_mmap_nidx_count(void* pvstate, void* pvhandle, context_t* pctx);
+static int     lrec_reader_mmap_nidx_seek_tail(void* pvstate, void* pvhandle, long long num_records, context_t* pctx);
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_mmap_nidx_process_multi_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx);
@@ -57,7 +63,8 @@ static void skip_over_comment_lines_multi_irs(
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -71,6 +78,8 @@ lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repea
 	pstate->comment_handling         = comment_handling;
 	pstate->comment_string           = comment_string;
 	pstate->comment_string_length    = comment_string == NULL ? 0 : strlen(comment_string);
+	pstate->pfield_projection        = pfield_projection;
+	pstate->precord_predicate        = precord_predicate;
 
 	plrec_reader->pvstate     = (void*)pstate;
 	plrec_reader->popen_func  = file_reader_mmap_vopen;
@@ -98,6 +107,11 @@ lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repea
 	}
 
 	plrec_reader->psof_func     = lrec_reader_mmap_nidx_sof;
+	plrec_reader->pcount_func   = lrec_reader_mmap_nidx_count;
+	plrec_reader->ptell_func    = file_reader_mmap_vtell;
+	plrec_reader->pseek_func    = file_reader_mmap_vseek;
+	plrec_reader->pseek_tail_func = lrec_reader_mmap_nidx_seek_tail;
+	plrec_reader->preread_func    = file_reader_mmap_reread;
 	plrec_reader->pfree_func    = lrec_reader_mmap_nidx_free;
 
 	return plrec_reader;
@@ -112,41 +126,69 @@ static void lrec_reader_mmap_nidx_free(lrec_reader_t* preader) {
 static void lrec_reader_mmap_nidx_sof(void* pvstate, void* pvhandle) {
 }
 
+// ----------------------------------------------------------------
+// Each line is a record, whatever is in it.
+static long long lrec_reader_mmap_nidx_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
+	return mlr_count_lines_mmap(pvhandle, pstate->irs, pstate->irslen, pstate->do_auto_line_term,
+		pstate->comment_handling, pstate->comment_string, pctx);
+}
+
+// Likewise when reading backward.
+static int lrec_reader_mmap_nidx_seek_tail(void* pvstate, void* pvhandle, long long num_records, context_t* pctx) {
+	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	char* start = mlr_find_last_lines_mmap(phandle, pstate->irs, pstate->irslen, pstate->comment_string,
+		num_records);
+	if (start == NULL)
+		return FALSE;
+	phandle->sol = start;
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_single_irs_single_ifs(phandle, pstate->irs[0], pstate->ifs[0], pstate, pctx);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_nidx_single_irs_single_ifs(phandle, pstate->irs[0], pstate->ifs[0], pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_single_irs_multi_ifs(phandle, pstate->irs[0], pstate, pctx);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_nidx_single_irs_multi_ifs(phandle, pstate->irs[0], pstate, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_multi_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_multi_irs_single_ifs(phandle, pstate->ifs[0], pstate);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_nidx_multi_irs_single_ifs(phandle, pstate->ifs[0], pstate);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_multi_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_multi_irs_multi_ifs(phandle, pstate);
+	while (phandle->sol < phandle->eof) {
+		lrec_t* prec = lrec_parse_mmap_nidx_multi_irs_multi_ifs(phandle, pstate);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+	return NULL;
 }
 
 // ----------------------------------------------------------------
@@ -194,7 +236,7 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_single_ifs(file_reader_mmap_state
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 
 			p++;
 			if (pstate->allow_repeat_ifs) {
@@ -218,14 +260,14 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_single_ifs(file_reader_mmap_state
 	if (saw_rs) {
 		// Easy and simple case: we read until end of line.  We zero-poked the irs to a null character to terminate the
 		// C string so it's OK to retain a pointer to that.
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
 		// to terminate the C string: if the file size is not a multiple of the OS page size it'll work (it's our
 		// copy-on-write memory). But if the file size is a multiple of the page size, then zero-poking at EOF is one
 		// byte past the page and that will segv us.
 		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-		lrec_put(prec, key, copy, free_flags|FREE_ENTRY_VALUE);
+		lrec_put_projected(prec, pstate->pfield_projection, key, copy, free_flags|FREE_ENTRY_VALUE);
 	}
 
 	return prec;
@@ -256,6 +298,9 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_multi_ifs(file_reader_mmap_state_
 	int saw_rs = FALSE;
 
 	for ( ; p < phandle->eof && *p; ) {
+		p = find_sep_candidate(p, phandle->eof, irs, ifs[0], ifs[0]);
+		if (p >= phandle->eof || *p == 0)
+			break;
 		if (*p == irs) {
 			*p = 0;
 
@@ -271,12 +316,12 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_multi_ifs(file_reader_mmap_state_
 			phandle->sol = p+1;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, ifs, ifslen)) {
+		} else if (sep_matches(p, phandle->eof, ifs, ifslen)) {
 			*p = 0;
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 
 			p += ifslen;
 			if (pstate->allow_repeat_ifs) {
@@ -300,14 +345,14 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_multi_ifs(file_reader_mmap_state_
 	if (saw_rs) {
 		// Easy and simple case: we read until end of line.  We zero-poked the irs to a null character to terminate the
 		// C string so it's OK to retain a pointer to that.
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
 		// to terminate the C string: if the file size is not a multiple of the OS page size it'll work (it's our
 		// copy-on-write memory). But if the file size is a multiple of the page size, then zero-poking at EOF is one
 		// byte past the page and that will segv us.
 		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-		lrec_put(prec, key, copy, free_flags|FREE_ENTRY_VALUE);
+		lrec_put_projected(prec, pstate->pfield_projection, key, copy, free_flags|FREE_ENTRY_VALUE);
 	}
 
 	return prec;
@@ -338,7 +383,10 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_single_ifs(file_reader_mmap_state_
 	int irslen = pstate->irslen;
 
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs[0], ifs, ifs);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, irs, irslen)) {
 			*p = 0;
 			phandle->sol = p + irslen;
 			saw_rs = TRUE;
@@ -348,7 +396,7 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_single_ifs(file_reader_mmap_state_
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 
 			p++;
 			if (pstate->allow_repeat_ifs) {
@@ -372,14 +420,14 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_single_ifs(file_reader_mmap_state_
 	if (saw_rs) {
 		// Easy and simple case: we read until end of line.  We zero-poked the irs to a null character to terminate the
 		// C string so it's OK to retain a pointer to that.
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
 		// to terminate the C string: if the file size is not a multiple of the OS page size it'll work (it's our
 		// copy-on-write memory). But if the file size is a multiple of the page size, then zero-poking at EOF is one
 		// byte past the page and that will segv us.
 		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-		lrec_put(prec, key, copy, free_flags|FREE_ENTRY_VALUE);
+		lrec_put_projected(prec, pstate->pfield_projection, key, copy, free_flags|FREE_ENTRY_VALUE);
 	}
 
 	return prec;
@@ -411,17 +459,20 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_multi_ifs(file_reader_mmap_state_t
 	char* value = p;
 	int saw_rs = FALSE;
 	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
+		p = find_sep_candidate(p, phandle->eof, irs[0], ifs[0], ifs[0]);
+		if (p >= phandle->eof || *p == 0)
+			break;
+		if (sep_matches(p, phandle->eof, irs, irslen)) {
 			*p = 0;
 			phandle->sol = p + irslen;
 			saw_rs = TRUE;
 			break;
-		} else if (streqn(p, ifs, ifslen)) {
+		} else if (sep_matches(p, phandle->eof, ifs, ifslen)) {
 			*p = 0;
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 
 			p += ifslen;
 			if (pstate->allow_repeat_ifs) {
@@ -445,14 +496,14 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_multi_ifs(file_reader_mmap_state_t
 	if (saw_rs) {
 		// Easy and simple case: we read until end of line.  We zero-poked the irs to a null character to terminate the
 		// C string so it's OK to retain a pointer to that.
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
 		// to terminate the C string: if the file size is not a multiple of the OS page size it'll work (it's our
 		// copy-on-write memory). But if the file size is a multiple of the page size, then zero-poking at EOF is one
 		// byte past the page and that will segv us.
 		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
-		lrec_put(prec, key, copy, free_flags|FREE_ENTRY_VALUE);
+		lrec_put_projected(prec, pstate->pfield_projection, key, copy, free_flags|FREE_ENTRY_VALUE);
 	}
 
 	return prec;
@@ -507,6 +558,13 @@ static void skip_over_comment_lines_multi_irs(
 				for (int i = 0; i < irslen; i++)
 					fputc(phandle->sol[i], stdout);
 			phandle->sol += irslen;
+		} else {
+			// Unterminated comment line at end of file, with fewer than irslen bytes left.
+			while (phandle->sol < phandle->eof) {
+				if (pstate->comment_handling == PASS_COMMENTS)
+					fputc(*phandle->sol, stdout);
+				phandle->sol++;
+			}
 		}
 	}
 }
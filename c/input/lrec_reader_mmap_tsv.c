@@ -0,0 +1,538 @@
+// ================================================================
+// TSV is like CSV-lite with a single-character field separator (tab by
+// default) and no double-quoting. Instead, tabs, newlines, and carriage
+// returns within fields are written as the two-character sequences "\t",
+// "\n", and "\r", and backslash as "\\"; these are decoded in place, which
+// is safe since the mmap is copy-on-write and decoding never lengthens a
+// field. Fields without backslashes are handed through untouched.
+//
+// Multi-character IRS is handled by the stdio TSV reader.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cli/comment_handling.h"
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "containers/slls.h"
+#include "containers/lhmslv.h"
+#include "input/file_reader_mmap.h"
+#include "input/lrec_readers.h"
+
+// See lrec_reader_mmap_csvlite.c for the multi-file semantics, which are the same here.
+
+typedef struct _lrec_reader_mmap_tsv_state_t {
+	long long  ifnr;
+	long long  ilno; // Line-level, not record-level as in context_t
+	int        ilno_known; // FALSE after a seek, since the lines skipped over weren't counted
+	char  irs;
+	char  ifs;
+	int   do_auto_line_term;
+	int   use_implicit_header;
+	comment_handling_t comment_handling;
+	char* comment_string;
+	int   comment_string_length;
+	// Nonzero for IRS, IFS, backslash, and NUL: lets the per-byte loop do a single test for the common case.
+	unsigned char is_special[256];
+
+	int  expect_header_line_next;
+	long long header_offset; // for indexing: where pheader_keeper's line, or comments before it, began
+	header_keeper_t* pheader_keeper;
+	lhmslv_t*     pheader_keepers;
+} lrec_reader_mmap_tsv_state_t;
+
+static void    lrec_reader_mmap_tsv_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_tsv_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_tsv_process(void* pvstate, void* pvhandle, context_t* pctx);
+static long long lrec_reader_mmap_tsv_tell(void* pvstate, void* pvhandle, long long* pheader_offset);
+static void    lrec_reader_mmap_tsv_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx);
+static char*   ilno_desc(lrec_reader_mmap_tsv_state_t* pstate, char* prefix, long long ilno);
+static int     lrec_reader_mmap_tsv_ingest_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx);
+
+static slls_t* lrec_reader_mmap_tsv_get_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx, char** pline_copy);
+
+static lrec_t* lrec_reader_mmap_tsv_get_record(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx, header_keeper_t* pheader_keeper, int* pend_of_stanza);
+
+static lrec_t* lrec_reader_mmap_tsv_get_record_implicit_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx);
+
+static int handle_comment_line(file_reader_mmap_state_t* phandle, lrec_reader_mmap_tsv_state_t* pstate);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_tsv_alloc(char* irs, char ifs, int use_implicit_header,
+	comment_handling_t comment_handling, char* comment_string)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_tsv_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_tsv_state_t));
+	pstate->ifnr                     = 0LL;
+	pstate->ilno                     = 0LL;
+	pstate->ilno_known               = TRUE;
+	pstate->irs                      = irs[0];
+	pstate->ifs                      = ifs;
+	pstate->do_auto_line_term        = FALSE;
+	pstate->use_implicit_header      = use_implicit_header;
+	pstate->comment_handling         = comment_handling;
+	pstate->comment_string           = comment_string;
+	pstate->comment_string_length    = comment_string == NULL ? 0 : strlen(comment_string);
+
+	pstate->expect_header_line_next  = use_implicit_header ? FALSE : TRUE;
+	pstate->header_offset            = LREC_READER_HEADER_NONE;
+	pstate->pheader_keeper           = NULL;
+	pstate->pheader_keepers          = lhmslv_alloc();
+
+	if (streq(irs, "auto")) {
+		// Auto means either lines end in "\n" or "\r\n" (LF or CRLF).  In
+		// either case the final character is "\n". Then for autodetect we
+		// simply check if there's a character in the line before the '\n', and
+		// if that is '\r'.
+		pstate->do_auto_line_term = TRUE;
+		pstate->irs = '\n';
+	}
+
+	memset(pstate->is_special, 0, sizeof(pstate->is_special));
+	pstate->is_special[(unsigned char)pstate->irs] = 1;
+	pstate->is_special[(unsigned char)pstate->ifs] = 1;
+	pstate->is_special['\\'] = 1;
+	pstate->is_special[0] = 1;
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	plrec_reader->pprocess_func = lrec_reader_mmap_tsv_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_tsv_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = lrec_reader_mmap_tsv_tell;
+	plrec_reader->pseek_func    = lrec_reader_mmap_tsv_seek;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_mmap_tsv_free;
+
+	return plrec_reader;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_mmap_tsv_free(lrec_reader_t* preader) {
+	lrec_reader_mmap_tsv_state_t* pstate = preader->pvstate;
+	for (lhmslve_t* pe = pstate->pheader_keepers->phead; pe != NULL; pe = pe->pnext) {
+		header_keeper_t* pheader_keeper = pe->pvvalue;
+		header_keeper_free(pheader_keeper);
+	}
+	lhmslv_free(pstate->pheader_keepers);
+	free(pstate);
+	free(preader);
+}
+
+static void lrec_reader_mmap_tsv_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_mmap_tsv_state_t* pstate = pvstate;
+	pstate->ifnr = 0LL;
+	pstate->ilno = 0LL;
+	pstate->ilno_known = TRUE;
+	pstate->expect_header_line_next = pstate->use_implicit_header ? FALSE : TRUE;
+	pstate->header_offset = LREC_READER_HEADER_NONE;
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_tsv_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_tsv_state_t* pstate = pvstate;
+
+	if (pstate->use_implicit_header) {
+		lrec_t* prec = lrec_reader_mmap_tsv_get_record_implicit_header(phandle, pstate, pctx);
+		if (prec != NULL)
+			pstate->ifnr++;
+		return prec;
+	}
+
+	while (TRUE) {
+		if (pstate->expect_header_line_next) {
+			if (!lrec_reader_mmap_tsv_ingest_header(phandle, pstate, pctx)) // EOF
+				return NULL;
+		}
+
+		int end_of_stanza = FALSE;
+		lrec_t* prec = lrec_reader_mmap_tsv_get_record(phandle, pstate, pctx, pstate->pheader_keeper,
+			&end_of_stanza);
+		if (end_of_stanza) {
+			pstate->expect_header_line_next = TRUE;
+		} else if (prec == NULL) { // EOF
+			return NULL;
+		} else {
+			pstate->ifnr++;
+			return prec;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// For indexing. Data lines after a header are read as from the start of the file, once the header is read.
+static long long lrec_reader_mmap_tsv_tell(void* pvstate, void* pvhandle, long long* pheader_offset) {
+	lrec_reader_mmap_tsv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (pstate->expect_header_line_next)
+		*pheader_offset = LREC_READER_HEADER_NEXT;
+	else if (pstate->use_implicit_header)
+		*pheader_offset = LREC_READER_HEADER_NONE;
+	else
+		*pheader_offset = pstate->header_offset;
+	return phandle->sol - phandle->sof;
+}
+
+static void lrec_reader_mmap_tsv_seek(void* pvstate, void* pvhandle, long long offset, long long header_offset,
+	context_t* pctx)
+{
+	lrec_reader_mmap_tsv_state_t* pstate = pvstate;
+	file_reader_mmap_state_t* phandle = pvhandle;
+	if (header_offset >= 0LL) {
+		// The header may be the one already in effect, whose line has since been parsed in place.
+		if (header_offset != pstate->header_offset) {
+			if (phandle->sol != phandle->sof + header_offset)
+				pstate->ilno_known = FALSE;
+			phandle->sol = phandle->sof + header_offset;
+			lrec_reader_mmap_tsv_ingest_header(phandle, pstate, pctx);
+			// For byte ranges the offset may be any line start, e.g. of the header line itself.
+			if (phandle->sol > phandle->sof + offset)
+				offset = phandle->sol - phandle->sof;
+		}
+		pstate->expect_header_line_next = FALSE;
+	} else {
+		pstate->expect_header_line_next = (header_offset == LREC_READER_HEADER_NEXT);
+	}
+	if (phandle->sol != phandle->sof + offset)
+		pstate->ilno_known = FALSE;
+	phandle->sol = phandle->sof + offset;
+}
+
+// ----------------------------------------------------------------
+// Returns FALSE at end of file.
+static int lrec_reader_mmap_tsv_ingest_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx)
+{
+	pstate->header_offset = phandle->sol - phandle->sof;
+	char* line_copy = NULL;
+	slls_t* pheader_fields = lrec_reader_mmap_tsv_get_header(phandle, pstate, pctx, &line_copy);
+	if (pheader_fields == NULL) // EOF
+		return FALSE;
+
+	for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
+		if (*pe->value == 0) {
+			fprintf(stderr, "%s: unacceptable empty TSV key at file \"%s\"%s.\n",
+				MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " line ", pstate->ilno));
+			exit(1);
+		}
+	}
+
+	pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
+	if (pstate->pheader_keeper == NULL) {
+		pstate->pheader_keeper = header_keeper_alloc(line_copy, pheader_fields);
+		lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
+			NO_FREE); // freed by header-keeper
+	} else { // Re-use the header-keeper in the header cache
+		slls_free(pheader_fields);
+		free(line_copy);
+	}
+	pstate->expect_header_line_next = FALSE;
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+// Returns NULL at end of file. The header names point into the mmapped file
+// except when the header line is the last line of the file and lacks a line
+// terminator: then they point into a copy which the caller must keep.
+
+static slls_t* lrec_reader_mmap_tsv_get_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx, char** pline_copy)
+{
+	char irs = pstate->irs;
+	char ifs = pstate->ifs;
+
+	// Skip blank/comment lines and seek to header line
+	while (TRUE) {
+		if (phandle->sol < phandle->eof && *phandle->sol == irs) {
+			phandle->sol++;
+			pstate->ilno++;
+			continue;
+		}
+		if (pstate->do_auto_line_term && (phandle->eof - phandle->sol) >= 2
+			&& phandle->sol[0] == '\r' && phandle->sol[1] == irs)
+		{
+			phandle->sol += 2;
+			pstate->ilno++;
+			continue;
+		}
+		if (pstate->comment_string != NULL && handle_comment_line(phandle, pstate)) {
+			continue;
+		}
+		break;
+	}
+	if (phandle->sol >= phandle->eof)
+		return NULL;
+
+	char* line = phandle->sol;
+	char* p = line;
+	for ( ; p < phandle->eof && *p != irs; p++)
+		;
+	if (p < phandle->eof) {
+		*p = 0;
+		if (pstate->do_auto_line_term) {
+			if (p > line && p[-1] == '\r') {
+				p[-1] = 0;
+				context_set_autodetected_crlf(pctx);
+			} else {
+				context_set_autodetected_lf(pctx);
+			}
+		}
+		phandle->sol = p + 1;
+	} else {
+		line = mlr_alloc_string_from_char_range(line, phandle->eof - line);
+		*pline_copy = line;
+		phandle->sol = phandle->eof;
+	}
+	pstate->ilno++;
+
+	return split_tsv_header_line(line, ifs);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_tsv_get_record(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx, header_keeper_t* pheader_keeper, int* pend_of_stanza)
+{
+	char irs = pstate->irs;
+	char ifs = pstate->ifs;
+
+	// Skip comment lines
+	if (pstate->comment_string != NULL) {
+		while (handle_comment_line(phandle, pstate))
+			;
+	}
+
+	if (phandle->sol >= phandle->eof)
+		return NULL;
+
+	char* line  = phandle->sol;
+	lrec_t* prec = lrec_unbacked_alloc();
+
+	sllse_t* pe = pheader_keeper->pkeys->phead;
+	char* p = line;
+	char* value = p;
+	int saw_rs = FALSE;
+	int saw_backslash = FALSE;
+	unsigned char* is_special = pstate->is_special;
+	for ( ; p < phandle->eof; ) {
+		if (!is_special[(unsigned char)*p]) {
+			p++;
+		} else if (*p == irs) {
+			if (p == line || (pstate->do_auto_line_term && p == line + 1 && *line == '\r')) {
+				phandle->sol = p+1;
+				pstate->ilno++;
+				*pend_of_stanza = TRUE;
+				lrec_free(prec);
+				return NULL;
+			}
+			*p = 0;
+
+			if (pstate->do_auto_line_term) {
+				if (p[-1] == '\r') {
+					p[-1] = 0;
+					context_set_autodetected_crlf(pctx);
+				} else {
+					context_set_autodetected_lf(pctx);
+				}
+			}
+
+			phandle->sol = p+1;
+			pstate->ilno++;
+			saw_rs = TRUE;
+			break;
+		} else if (*p == ifs) {
+			*p = 0;
+			if (pe == NULL) {
+				fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+					MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno + 1));
+				exit(1);
+			}
+			if (saw_backslash) {
+				mlr_unbackslash_tsv_in_place(value);
+				saw_backslash = FALSE;
+			}
+			lrec_put(prec, pe->value, value, NO_FREE);
+			pe = pe->pnext;
+			value = ++p;
+		} else if (*p == '\\') {
+			saw_backslash = TRUE;
+			p++;
+		} else { // NUL
+			break;
+		}
+	}
+	if (p >= phandle->eof) {
+		phandle->sol = p+1;
+		pstate->ilno++;
+	}
+
+	if (pe == NULL || pe->pnext != NULL) {
+		fprintf(stderr, "%s: Header-data length mismatch in file %s%s.\n",
+			MLR_GLOBALS.bargv0, pctx->filename, ilno_desc(pstate, " at line ", pstate->ilno));
+		exit(1);
+	}
+
+	if (saw_rs) {
+		// Easy and simple case: we read until end of line.  We zero-poked the irs to a null character to terminate the
+		// C string so it's OK to retain a pointer to that.
+		if (saw_backslash)
+			mlr_unbackslash_tsv_in_place(value);
+		lrec_put(prec, pe->value, value, NO_FREE);
+	} else {
+		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
+		// to terminate the C string: if the file size is not a multiple of the OS page size it'll work (it's our
+		// copy-on-write memory). But if the file size is a multiple of the page size, then zero-poking at EOF is one
+		// byte past the page and that will segv us.
+		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
+		if (saw_backslash)
+			mlr_unbackslash_tsv_in_place(copy);
+		lrec_put(prec, pe->value, copy, FREE_ENTRY_VALUE);
+	}
+
+	return prec;
+}
+
+// ----------------------------------------------------------------
+// With implicit header there is no schema change, so blank lines are simply skipped.
+
+static lrec_t* lrec_reader_mmap_tsv_get_record_implicit_header(file_reader_mmap_state_t* phandle,
+	lrec_reader_mmap_tsv_state_t* pstate, context_t* pctx)
+{
+	char irs = pstate->irs;
+	char ifs = pstate->ifs;
+
+	// Skip comment and blank lines
+	while (TRUE) {
+		if (phandle->sol < phandle->eof && *phandle->sol == irs) {
+			phandle->sol++;
+			pstate->ilno++;
+			continue;
+		}
+		if (pstate->do_auto_line_term && (phandle->eof - phandle->sol) >= 2
+			&& phandle->sol[0] == '\r' && phandle->sol[1] == irs)
+		{
+			phandle->sol += 2;
+			pstate->ilno++;
+			continue;
+		}
+		if (pstate->comment_string != NULL && handle_comment_line(phandle, pstate)) {
+			continue;
+		}
+		break;
+	}
+	if (phandle->sol >= phandle->eof)
+		return NULL;
+
+	lrec_t* prec = lrec_unbacked_alloc();
+	char* line  = phandle->sol;
+
+	char* p = line;
+	char* key   = NULL;
+	char* value = p;
+	char  free_flags = NO_FREE;
+	int idx = 0;
+	int saw_rs = FALSE;
+	int saw_backslash = FALSE;
+	unsigned char* is_special = pstate->is_special;
+	for ( ; p < phandle->eof; ) {
+		if (!is_special[(unsigned char)*p]) {
+			p++;
+		} else if (*p == irs) {
+			*p = 0;
+
+			if (pstate->do_auto_line_term) {
+				if (p > line && p[-1] == '\r') {
+					p[-1] = 0;
+					context_set_autodetected_crlf(pctx);
+				} else {
+					context_set_autodetected_lf(pctx);
+				}
+			}
+
+			phandle->sol = p+1;
+			pstate->ilno++;
+			saw_rs = TRUE;
+			break;
+		} else if (*p == ifs) {
+			*p = 0;
+			if (saw_backslash) {
+				mlr_unbackslash_tsv_in_place(value);
+				saw_backslash = FALSE;
+			}
+			key = low_int_to_string(++idx, &free_flags);
+			lrec_put(prec, key, value, free_flags);
+			value = ++p;
+		} else if (*p == '\\') {
+			saw_backslash = TRUE;
+			p++;
+		} else { // NUL
+			break;
+		}
+	}
+	if (p >= phandle->eof) {
+		phandle->sol = p+1;
+		pstate->ilno++;
+	}
+
+	key = low_int_to_string(++idx, &free_flags);
+
+	if (saw_rs) {
+		if (saw_backslash)
+			mlr_unbackslash_tsv_in_place(value);
+		lrec_put(prec, key, value, free_flags);
+	} else {
+		// See comments above regarding zero-poking at end of file.
+		char* copy = mlr_alloc_string_from_char_range(value, phandle->eof - value);
+		if (saw_backslash)
+			mlr_unbackslash_tsv_in_place(copy);
+		lrec_put(prec, key, copy, free_flags|FREE_ENTRY_VALUE);
+	}
+
+	return prec;
+}
+
+// ----------------------------------------------------------------
+static int handle_comment_line(file_reader_mmap_state_t* phandle, lrec_reader_mmap_tsv_state_t* pstate) {
+	char irs = pstate->irs;
+	if ((phandle->eof - phandle->sol) >= pstate->comment_string_length
+	&& streqn(phandle->sol, pstate->comment_string, pstate->comment_string_length))
+	{
+		if (pstate->comment_handling == PASS_COMMENTS)
+			for (int i = 0; i < pstate->comment_string_length; i++)
+				fputc(phandle->sol[i], stdout);
+		phandle->sol += pstate->comment_string_length;
+		while (phandle->sol < phandle->eof && *phandle->sol != irs) {
+			if (pstate->comment_handling == PASS_COMMENTS)
+				fputc(*phandle->sol, stdout);
+			phandle->sol++;
+		}
+		if (phandle->sol < phandle->eof && *phandle->sol == irs) {
+			if (pstate->comment_handling == PASS_COMMENTS)
+				fputc(*phandle->sol, stdout);
+			phandle->sol++;
+		}
+		pstate->ilno++;
+		return TRUE;
+	} else {
+		return FALSE;
+	}
+}
+
+// ----------------------------------------------------------------
+// Where an error is, for its message: the prefix and the input line number, or nothing after a seek. Only for
+// the message just before exiting, since the text is in a static buffer.
+static char* ilno_desc(lrec_reader_mmap_tsv_state_t* pstate, char* prefix, long long ilno) {
+	static char buf[64];
+	if (!pstate->ilno_known)
+		return "";
+	snprintf(buf, sizeof(buf), "%s%lld", prefix, ilno);
+	return buf;
+}
@@ -0,0 +1,262 @@
+// ================================================================
+// Reader for Miller's binary row format (see lib/bin_format.h), for standard
+// input and other non-mmappable input. Each record's payload is read into one
+// buffer, with a copy of its schema's field names after it, and the record's
+// keys and values point into that.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/bin_format.h"
+#include "input/file_reader_stdio.h"
+#include "input/lrec_readers.h"
+
+typedef struct _bin_schema_t {
+	unsigned long long num_fields;
+	unsigned char* payload; // holds the field names
+	unsigned long long payload_length;
+	size_t* field_name_offsets;
+	char*   keeps; // with projection pushdown: which fields to put in the record
+} bin_schema_t;
+
+typedef struct _lrec_reader_stdio_bin_state_t {
+	long long     offset; // for error messages
+	int           saw_stream_header;
+	bin_schema_t* schemas;
+	unsigned long long num_schemas;
+	unsigned long long schemas_capacity;
+	hss_t*        pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+} lrec_reader_stdio_bin_state_t;
+
+static void    lrec_reader_stdio_bin_free(lrec_reader_t* preader);
+static void    lrec_reader_stdio_bin_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_stdio_bin_process(void* pvstate, void* pvhandle, context_t* pctx);
+static int     read_varint(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, unsigned long long* pvalue);
+static void    read_payload(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, unsigned char* payload,
+	unsigned long long length, long long item_offset, context_t* pctx);
+static void    lrec_reader_stdio_bin_define_schema(lrec_reader_stdio_bin_state_t* pstate, unsigned long long id,
+	unsigned char* payload, unsigned long long length, long long item_offset, context_t* pctx);
+static void    lrec_reader_stdio_bin_reset_schemas(lrec_reader_stdio_bin_state_t* pstate);
+static void    data_corrupt(long long item_offset, context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_stdio_bin_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate) {
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_stdio_bin_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_stdio_bin_state_t));
+	pstate->offset            = 0LL;
+	pstate->saw_stream_header = FALSE;
+	pstate->schemas_capacity  = 16;
+	pstate->schemas           = mlr_malloc_or_die(pstate->schemas_capacity * sizeof(bin_schema_t));
+	pstate->num_schemas       = 0;
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_stdio_vopen;
+	plrec_reader->pclose_func   = file_reader_stdio_vclose;
+	plrec_reader->pprocess_func = lrec_reader_stdio_bin_process;
+	plrec_reader->psof_func     = lrec_reader_stdio_bin_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_stdio_bin_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_stdio_bin_free(lrec_reader_t* preader) {
+	lrec_reader_stdio_bin_state_t* pstate = preader->pvstate;
+	lrec_reader_stdio_bin_reset_schemas(pstate);
+	free(pstate->schemas);
+	free(pstate);
+	free(preader);
+}
+
+// Schemas are per file.
+static void lrec_reader_stdio_bin_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_stdio_bin_state_t* pstate = pvstate;
+	pstate->offset = 0LL;
+	pstate->saw_stream_header = FALSE;
+	lrec_reader_stdio_bin_reset_schemas(pstate);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_stdio_bin_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_bin_state_t* pstate = pvstate;
+	FILE* input_stream = pvhandle;
+
+	while (TRUE) {
+		long long item_offset = pstate->offset;
+		int tag = getc(input_stream);
+		if (tag == EOF)
+			return NULL;
+		pstate->offset++;
+
+		if (tag == MLR_BIN_TAG_STREAM_HEADER) {
+			char header[MLR_BIN_STREAM_HEADER_LENGTH];
+			header[0] = tag;
+			if (fread(&header[1], 1, MLR_BIN_STREAM_HEADER_LENGTH - 1, input_stream) != MLR_BIN_STREAM_HEADER_LENGTH - 1
+				|| memcmp(header, MLR_BIN_STREAM_HEADER, MLR_BIN_STREAM_HEADER_LENGTH - 1) != 0)
+			{
+				data_corrupt(item_offset, pctx);
+			}
+			if (header[MLR_BIN_STREAM_HEADER_LENGTH - 1] != MLR_BIN_VERSION) {
+				fprintf(stderr, "%s: unsupported binary-format version %d in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, header[MLR_BIN_STREAM_HEADER_LENGTH - 1], pctx->filename);
+				exit(1);
+			}
+			pstate->offset += MLR_BIN_STREAM_HEADER_LENGTH - 1;
+			pstate->saw_stream_header = TRUE;
+			lrec_reader_stdio_bin_reset_schemas(pstate);
+			continue;
+		}
+
+		if (!pstate->saw_stream_header) {
+			fprintf(stderr, "%s: file \"%s\" is not in Miller's binary format.\n",
+				MLR_GLOBALS.bargv0, pctx->filename);
+			exit(1);
+		}
+		unsigned long long a, length;
+		if ((tag != MLR_BIN_TAG_RECORD && tag != MLR_BIN_TAG_KEYED_RECORD && tag != MLR_BIN_TAG_SCHEMA)
+			|| !read_varint(pstate, input_stream, &a) || !read_varint(pstate, input_stream, &length))
+		{
+			data_corrupt(item_offset, pctx);
+		}
+
+		if (tag == MLR_BIN_TAG_RECORD) {
+			if (a >= pstate->num_schemas)
+				data_corrupt(item_offset, pctx);
+			bin_schema_t* pschema = &pstate->schemas[a];
+			unsigned char* payload = mlr_malloc_or_die(length + pschema->payload_length);
+			read_payload(pstate, input_stream, payload, length, item_offset, pctx);
+			unsigned char* field_names = payload + length;
+			memcpy(field_names, pschema->payload, pschema->payload_length);
+
+			lrec_t* prec = lrec_bin_alloc((char*)payload);
+			unsigned char* p = payload;
+			for (unsigned long long i = 0; i < pschema->num_fields; i++) {
+				if (pschema->keeps != NULL && !pschema->keeps[i]) {
+					if (!mlr_bin_skip_value(&p, field_names))
+						data_corrupt(item_offset, pctx);
+					continue;
+				}
+				char free_flags;
+				char* value = mlr_bin_get_value(&p, field_names, &free_flags);
+				if (value == NULL)
+					data_corrupt(item_offset, pctx);
+				lrec_put_new_key(prec, (char*)field_names + pschema->field_name_offsets[i], value, free_flags);
+			}
+			if (p != field_names)
+				data_corrupt(item_offset, pctx);
+			if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+				return prec;
+
+		} else if (tag == MLR_BIN_TAG_KEYED_RECORD) {
+			unsigned char* payload = mlr_malloc_or_die(length);
+			read_payload(pstate, input_stream, payload, length, item_offset, pctx);
+			unsigned char* end = payload + length;
+
+			lrec_t* prec = lrec_bin_alloc((char*)payload);
+			unsigned char* p = payload;
+			for (unsigned long long i = 0; i < a; i++) {
+				unsigned long long key_length;
+				char free_flags;
+				char* key = mlr_bin_get_varint(&p, end, &key_length) ? mlr_bin_get_string(&p, end, key_length) : NULL;
+				char* value = (key == NULL) ? NULL : mlr_bin_get_value(&p, end, &free_flags);
+				if (value == NULL)
+					data_corrupt(item_offset, pctx);
+				lrec_put_projected(prec, pstate->pfield_projection, key, value, free_flags);
+			}
+			if (p != end)
+				data_corrupt(item_offset, pctx);
+			if (lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+				return prec;
+
+		} else {
+			unsigned char* payload = mlr_malloc_or_die(length);
+			read_payload(pstate, input_stream, payload, length, item_offset, pctx);
+			lrec_reader_stdio_bin_define_schema(pstate, a, payload, length, item_offset, pctx);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+static int read_varint(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, unsigned long long* pvalue) {
+	unsigned long long value = 0ULL;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc(input_stream);
+		if (c == EOF)
+			return FALSE;
+		pstate->offset++;
+		value |= (unsigned long long)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*pvalue = value;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void read_payload(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, unsigned char* payload,
+	unsigned long long length, long long item_offset, context_t* pctx)
+{
+	if (fread(payload, 1, length, input_stream) != length)
+		data_corrupt(item_offset, pctx);
+	pstate->offset += length;
+}
+
+// Ids are assigned in order, but a schema may be redefined. Takes ownership of the payload.
+static void lrec_reader_stdio_bin_define_schema(lrec_reader_stdio_bin_state_t* pstate, unsigned long long id,
+	unsigned char* payload, unsigned long long length, long long item_offset, context_t* pctx)
+{
+	bin_schema_t schema;
+	char** field_names = NULL;
+	if (id > pstate->num_schemas || !mlr_bin_get_schema(payload, payload + length, &schema.num_fields, &field_names))
+		data_corrupt(item_offset, pctx);
+	schema.payload = payload;
+	schema.payload_length = length;
+	schema.field_name_offsets = mlr_malloc_or_die((schema.num_fields + 1) * sizeof(size_t));
+	for (unsigned long long i = 0; i < schema.num_fields; i++)
+		schema.field_name_offsets[i] = (unsigned char*)field_names[i] - payload;
+	schema.keeps = NULL;
+	if (pstate->pfield_projection != NULL) {
+		schema.keeps = mlr_malloc_or_die(schema.num_fields + 1);
+		for (unsigned long long i = 0; i < schema.num_fields; i++)
+			schema.keeps[i] = hss_has(pstate->pfield_projection, field_names[i]);
+	}
+	free(field_names);
+
+	if (id < pstate->num_schemas) {
+		free(pstate->schemas[id].payload);
+		free(pstate->schemas[id].field_name_offsets);
+		free(pstate->schemas[id].keeps);
+	} else {
+		if (pstate->num_schemas >= pstate->schemas_capacity) {
+			pstate->schemas_capacity *= 2;
+			pstate->schemas = mlr_realloc_or_die(pstate->schemas, pstate->schemas_capacity * sizeof(bin_schema_t));
+		}
+		pstate->num_schemas++;
+	}
+	pstate->schemas[id] = schema;
+}
+
+static void lrec_reader_stdio_bin_reset_schemas(lrec_reader_stdio_bin_state_t* pstate) {
+	for (unsigned long long i = 0; i < pstate->num_schemas; i++) {
+		free(pstate->schemas[i].payload);
+		free(pstate->schemas[i].field_name_offsets);
+		free(pstate->schemas[i].keeps);
+	}
+	pstate->num_schemas = 0;
+}
+
+static void data_corrupt(long long item_offset, context_t* pctx) {
+	fprintf(stderr, "%s: data corrupt or truncated at byte offset %lld in binary-format file \"%s\".\n",
+		MLR_GLOBALS.bargv0, item_offset, pctx->filename);
+	exit(1);
+}
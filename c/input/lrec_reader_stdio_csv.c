@@ -9,6 +9,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <ctype.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
@@ -16,6 +19,7 @@
 #include "lib/string_builder.h"
 #include "input/file_reader_stdio.h"
 #include "input/byte_readers.h"
+#include "input/csv_block.h"
 #include "input/lrec_readers.h"
 #include "input/peek_file_reader.h"
 #include "containers/rslls.h"
@@ -34,6 +38,7 @@
 
 // ----------------------------------------------------------------
 #define STRING_BUILDER_INIT_SIZE 1024
+#define CSV_STREAM_BUFFER_SIZE (64 * 1024)
 
 // AKA "token"
 #define EOF_STRIDX           0x2000
@@ -67,6 +72,12 @@ typedef struct _lrec_reader_stdio_csv_state_t {
 	comment_handling_t comment_handling;
 	char* comment_string;
 	int   comment_string_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+	lrec_t* ppredicate_rec;   // The predicate's fields only, tested before the full record is built
+	int*    predicate_columns; // Their positions in the data fields, or -1
+	int     have_predicate_columns;
+	header_keeper_t* ppredicate_header_keeper; // What the positions were found from
 
 	char* dquote;
 	char* dquote_irs;
@@ -85,6 +96,16 @@ typedef struct _lrec_reader_stdio_csv_state_t {
 	parse_trie_t*       pno_dquote_parse_trie;
 	parse_trie_t*       pdquote_parse_trie;
 
+	// For single-character IFS and IRS: the block tokenizer's input buffer. See input/csv_block.h.
+	int                 fd;
+	char*               pbuf;
+	char*               pnext; // first unconsumed byte
+	char*               pend;  // end of what's been read
+	int                 at_eof;
+	csv_block_t         block;
+	int               (*pget_fields_func)(struct _lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
+		context_t* pctx, int is_header);
+
 	int                 expect_header_line_next;
 	int                 use_implicit_header;
 	header_keeper_t*    pheader_keeper;
@@ -97,6 +118,10 @@ static void    lrec_reader_stdio_csv_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, context_t* pctx);
 static int     lrec_reader_stdio_csv_get_fields(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
 	context_t* pctx, int is_header);
+static void    lrec_reader_stdio_csv_sof_single_seps(void* pvstate, void* pvhandle);
+static int     lrec_reader_stdio_csv_get_fields_single_seps(lrec_reader_stdio_csv_state_t* pstate,
+	rslls_t* pfields, context_t* pctx, int is_header);
+static int     predicate_keeps_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
 static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx);
 static lrec_t* paste_header_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
@@ -106,7 +131,8 @@ static void    lrec_reader_stdio_csv_close(void* pvstate, void* pvhandle, char*
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -122,6 +148,13 @@ lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implici
 	pstate->comment_handling = comment_handling;
 	pstate->comment_string   = comment_string;
 	pstate->comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
+	pstate->ppredicate_rec    = (precord_predicate == NULL) ? NULL : lrec_unbacked_alloc();
+	pstate->predicate_columns = (precord_predicate == NULL) ? NULL
+		: mlr_malloc_or_die(precord_predicate->pfield_names->length * sizeof(int));
+	pstate->have_predicate_columns = FALSE;
+	pstate->ppredicate_header_keeper = NULL;
 
 	pstate->eof           = "\xff";
 	pstate->irs           = irs;
@@ -185,6 +218,34 @@ lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implici
 	plrec_reader->pclose_func   = lrec_reader_stdio_csv_close;
 	plrec_reader->pprocess_func = lrec_reader_stdio_csv_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_csv_sof;
+
+	// As in the mmap reader, the block tokenizer is for separators distinguishable from one another and from
+	// the double quote by their first byte. It reads the file itself, in chunks, rather than a byte at a
+	// time through the peek-file-reader.
+	pstate->fd     = -1;
+	pstate->pbuf   = NULL;
+	pstate->pnext  = NULL;
+	pstate->pend   = NULL;
+	pstate->at_eof = FALSE;
+	csv_block_init(&pstate->block, pstate->ifs[0], pstate->irs[0]);
+	if (strlen(pstate->ifs) == 1 && strlen(pstate->irs) == 1
+		&& pstate->ifs[0] != pstate->irs[0]
+		&& pstate->ifs[0] != '"' && pstate->irs[0] != '"'
+		&& !(pstate->do_auto_line_term && pstate->ifs[0] == '\r'))
+	{
+		pstate->pbuf = mlr_malloc_or_die(CSV_STREAM_BUFFER_SIZE);
+		pstate->pget_fields_func    = lrec_reader_stdio_csv_get_fields_single_seps;
+		plrec_reader->popen_func    = file_reader_stdio_vopen;
+		plrec_reader->pclose_func   = file_reader_stdio_vclose;
+		plrec_reader->psof_func     = lrec_reader_stdio_csv_sof_single_seps;
+	} else {
+		pstate->pget_fields_func    = lrec_reader_stdio_csv_get_fields;
+	}
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_csv_free;
 
 	return plrec_reader;
@@ -203,12 +264,15 @@ static void lrec_reader_stdio_csv_free(lrec_reader_t* preader) {
 	parse_trie_free(pstate->pno_dquote_parse_trie);
 	parse_trie_free(pstate->pdquote_parse_trie);
 	rslls_free(pstate->pfields);
+	lrec_free(pstate->ppredicate_rec);
+	free(pstate->predicate_columns);
 	stdio_byte_reader_free(pstate->pbr);
 	sb_free(pstate->psb);
 	free(pstate->ifs_eof);
 	free(pstate->dquote_irs);
 	free(pstate->dquote_irs2);
 	free(pstate->dquote_ifs);
+	free(pstate->pbuf);
 	free(pstate);
 	free(preader);
 }
@@ -227,7 +291,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 	// Ingest the next header line, if expected
 	if (pstate->expect_header_line_next) {
 		while (TRUE) {
-			if (!lrec_reader_stdio_csv_get_fields(pstate, pstate->pfields, pctx, TRUE))
+			if (!pstate->pget_fields_func(pstate, pstate->pfields, pctx, TRUE))
 				return NULL;
 			pstate->ilno++;
 
@@ -288,7 +352,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 
 	// Ingest the next data line, if expected
 	while (TRUE) {
-		int rc = lrec_reader_stdio_csv_get_fields(pstate, pstate->pfields, pctx, FALSE);
+		int rc = pstate->pget_fields_func(pstate, pstate->pfields, pctx, FALSE);
 		pstate->ilno++;
 		if (rc == FALSE) // EOF
 			return NULL;
@@ -319,6 +383,11 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 			}
 		}
 
+		if (pstate->precord_predicate != NULL && !predicate_keeps_data(pstate, pstate->pfields, pctx)) {
+			rslls_reset(pstate->pfields);
+			continue;
+		}
+
 		lrec_t* prec =  pstate->use_implicit_header
 			? paste_indices_and_data(pstate, pstate->pfields, pctx)
 			: paste_header_and_data(pstate, pstate->pfields, pctx);
@@ -473,6 +542,8 @@ static int lrec_reader_stdio_csv_get_fields(lrec_reader_stdio_csv_state_t* pstat
 							if (field_length > 0 && field[field_length-1] == '\r') {
 								field[field_length-1] = 0;
 								context_set_autodetected_crlf(pctx);
+							} else if (stridx == DQUOTE_IRS2_STRIDX) {
+								context_set_autodetected_crlf(pctx);
 							} else {
 								context_set_autodetected_lf(pctx);
 							}
@@ -503,6 +574,256 @@ static int lrec_reader_stdio_csv_get_fields(lrec_reader_stdio_csv_state_t* pstat
 	return TRUE;
 }
 
+// ----------------------------------------------------------------
+// Block-tokenizer input. As in the stdio JSON reader, we use read(2) rather than fread so that a partial
+// chunk from a pipe is processed as soon as it arrives, rather than waiting for a full buffer.
+
+static void lrec_reader_stdio_csv_sof_single_seps(void* pvstate, void* pvhandle) {
+	lrec_reader_stdio_csv_state_t* pstate = pvstate;
+	FILE* input_stream = pvhandle;
+	lrec_reader_stdio_csv_sof(pvstate, pvhandle);
+	pstate->fd     = fileno(input_stream);
+	pstate->pnext  = pstate->pbuf;
+	pstate->pend   = pstate->pbuf;
+	pstate->at_eof = FALSE;
+	csv_block_reset(&pstate->block);
+}
+
+// Keeps the unconsumed bytes, moving them to the start of the buffer, and reads more after them. Returns
+// FALSE at end of file.
+static int csv_read_more(lrec_reader_stdio_csv_state_t* pstate) {
+	if (pstate->at_eof)
+		return FALSE;
+	int nkeep = pstate->pend - pstate->pnext;
+	if (nkeep > 0 && pstate->pnext > pstate->pbuf)
+		memmove(pstate->pbuf, pstate->pnext, nkeep);
+	pstate->pnext = pstate->pbuf;
+	pstate->pend  = pstate->pbuf + nkeep;
+	csv_block_reset(&pstate->block);
+
+	while (TRUE) {
+		ssize_t nread = read(pstate->fd, pstate->pend, CSV_STREAM_BUFFER_SIZE - nkeep);
+		if (nread > 0) {
+			pstate->pend += nread;
+			return TRUE;
+		} else if (nread == 0) {
+			pstate->at_eof = TRUE;
+			return FALSE;
+		} else if (errno != EINTR) {
+			perror("read");
+			fprintf(stderr, "%s: CSV read failed.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+	}
+}
+
+// Makes sure at least n bytes are unconsumed, if the input has that many. This is only for looking a
+// few bytes ahead, so they always fit in the buffer.
+static int csv_ensure_available(lrec_reader_stdio_csv_state_t* pstate, int n) {
+	while (pstate->pend - pstate->pnext < n) {
+		if (!csv_read_more(pstate))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// The line-ending '\n' won't be included in the field. With autodetected line endings, a CR before it
+// is stripped, as in lrec_reader_stdio_csv_get_fields.
+static inline void csv_strip_cr(lrec_reader_stdio_csv_state_t* pstate, char* field, int field_length,
+	context_t* pctx)
+{
+	if (pstate->do_auto_line_term) {
+		if (field_length > 0 && field[field_length-1] == '\r') {
+			field[field_length-1] = 0;
+			context_set_autodetected_crlf(pctx);
+		} else {
+			context_set_autodetected_lf(pctx);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// Same semantics as lrec_reader_stdio_csv_get_fields, including its error messages, for single-character
+// IFS and IRS. Fields within the buffer are copied out of it directly; one running past the end of the
+// buffer is accumulated in the string builder across refills.
+static int lrec_reader_stdio_csv_get_fields_single_seps(lrec_reader_stdio_csv_state_t* pstate,
+	rslls_t* pfields, context_t* pctx, int is_header)
+{
+	string_builder_t* psb = pstate->psb;
+	csv_block_t* pblock = &pstate->block;
+	char ifs = pstate->ifs[0];
+	char irs = pstate->irs[0];
+	char* field = NULL;
+	int field_length = 0;
+
+	if (!csv_ensure_available(pstate, 1))
+		return FALSE;
+
+	// Strip the UTF-8 BOM, if any.
+	if (is_header && csv_ensure_available(pstate, UTF8_BOM_LENGTH)
+		&& memcmp(pstate->pnext, UTF8_BOM, UTF8_BOM_LENGTH) == 0)
+	{
+		pstate->pnext += UTF8_BOM_LENGTH;
+	}
+
+	// Loop over fields in record
+	while (TRUE) {
+		if (!csv_ensure_available(pstate, 1) || *pstate->pnext != '"') { // NOT DOUBLE-QUOTED
+			char* q = csv_block_scan(pblock, pstate->pnext, pstate->pend, TRUE);
+			int spanned = FALSE;
+			while (q >= pstate->pend) {
+				if (pstate->pend > pstate->pnext)
+					sb_append_char_range(psb, pstate->pnext, pstate->pend - 1);
+				pstate->pnext = pstate->pend;
+				spanned = TRUE;
+				if (!csv_read_more(pstate))
+					break;
+				q = csv_block_scan(pblock, pstate->pnext, pstate->pend, TRUE);
+			}
+
+			if (q >= pstate->pend) { // end of record at end of file
+				rslls_append(pfields, sb_finish(psb), FREE_ENTRY_VALUE, 0);
+				return TRUE;
+			}
+
+			char c = *q;
+			if (c == '"') { // CSV syntax error: fields containing quotes must be fully wrapped in quotes
+				fprintf(stderr, "%s: syntax error: unwrapped double quote at line %lld.\n",
+					MLR_GLOBALS.bargv0, pstate->ilno);
+				exit(1);
+			}
+			if (spanned) {
+				if (q > pstate->pnext)
+					sb_append_char_range(psb, pstate->pnext, q - 1);
+				field = sb_finish_with_length(psb, &field_length);
+			} else {
+				field_length = q - pstate->pnext;
+				field = mlr_alloc_string_from_char_range(pstate->pnext, field_length);
+			}
+			pstate->pnext = q + 1;
+
+			if (c == ifs) { // end of field
+				rslls_append(pfields, field, FREE_ENTRY_VALUE, 0);
+				if (!csv_ensure_available(pstate, 1)) {
+					fprintf(stderr, "%s: syntax error: record-ending field separator at line %lld.\n",
+						MLR_GLOBALS.bargv0, pstate->ilno);
+					exit(1);
+				}
+			} else { // end of record
+				csv_strip_cr(pstate, field, field_length, pctx);
+				rslls_append(pfields, field, FREE_ENTRY_VALUE, 0);
+				return TRUE;
+			}
+
+		} else { // DOUBLE-QUOTED
+			pstate->pnext++;
+
+			// Loop over double quotes in the field, keeping what's between them.
+			while (TRUE) {
+				char* q = csv_block_scan(pblock, pstate->pnext, pstate->pend, FALSE);
+				if (q > pstate->pnext)
+					sb_append_char_range(psb, pstate->pnext, q - 1);
+				pstate->pnext = q;
+				if (q >= pstate->pend) {
+					if (!csv_read_more(pstate)) {
+						fprintf(stderr, "%s: unmatched double quote at line %lld.\n",
+							MLR_GLOBALS.bargv0, pstate->ilno);
+						exit(1);
+					}
+					continue;
+				}
+
+				// Now *pnext is a double quote: look at what follows it.
+				if (!csv_ensure_available(pstate, 2)) { // end of record at end of file
+					pstate->pnext++;
+					rslls_append(pfields, sb_finish(psb), FREE_ENTRY_VALUE, FIELD_QUOTED_ON_INPUT);
+					return TRUE;
+				}
+				char c = pstate->pnext[1];
+				if (c == ifs) { // end of field
+					pstate->pnext += 2;
+					rslls_append(pfields, sb_finish(psb), FREE_ENTRY_VALUE, FIELD_QUOTED_ON_INPUT);
+					break;
+				} else if (c == irs
+					|| (pstate->do_auto_line_term && c == '\r' && csv_ensure_available(pstate, 3)
+						&& pstate->pnext[2] == '\n'))
+				{ // end of record
+					pstate->pnext += (c == irs) ? 2 : 3;
+					field = sb_finish_with_length(psb, &field_length);
+					if (c != irs && pstate->do_auto_line_term)
+						context_set_autodetected_crlf(pctx);
+					csv_strip_cr(pstate, field, field_length, pctx);
+					rslls_append(pfields, field, FREE_ENTRY_VALUE, FIELD_QUOTED_ON_INPUT);
+					return TRUE;
+				} else if (c == '"') { // RFC-4180 CSV: "" inside a dquoted field is an escape for "
+					sb_append_char(psb, '"');
+					pstate->pnext += 2;
+				} else { // a lone double quote within the field is data
+					sb_append_char(psb, '"');
+					pstate->pnext++;
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// For predicate pushdown: tests the data fields the predicate names, before the rest of the record
+// is built. Returns FALSE, having counted the record in NR/FNR, if it's to be skipped. A header/data
+// length mismatch is passed through for paste_header_and_data to report.
+static int predicate_keeps_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx) {
+	lrec_reader_predicate_t* ppredicate = pstate->precord_predicate;
+
+	if (!pstate->have_predicate_columns || pstate->ppredicate_header_keeper != pstate->pheader_keeper) {
+		int i = 0;
+		for (sllse_t* pn = ppredicate->pfield_names->phead; pn != NULL; pn = pn->pnext, i++) {
+			pstate->predicate_columns[i] = -1;
+			if (pstate->use_implicit_header) {
+				int idx = 0;
+				if (sscanf(pn->value, "%d", &idx) == 1 && idx > 0) {
+					char free_flags = 0;
+					char* key = low_int_to_string(idx, &free_flags);
+					if (streq(key, pn->value))
+						pstate->predicate_columns[i] = idx - 1;
+					if (free_flags & FREE_ENTRY_KEY)
+						free(key);
+				}
+			} else {
+				// With repeated header fields the last value is the one the record keeps.
+				int j = 0;
+				for (sllse_t* ph = pstate->pheader_keeper->pkeys->phead; ph != NULL; ph = ph->pnext, j++) {
+					if (streq(ph->value, pn->value))
+						pstate->predicate_columns[i] = j;
+				}
+			}
+		}
+		pstate->have_predicate_columns = TRUE;
+		pstate->ppredicate_header_keeper = pstate->pheader_keeper;
+	}
+
+	if (!pstate->use_implicit_header && pstate->pheader_keeper->pkeys->length != pdata_fields->length)
+		return TRUE;
+
+	lrec_t* prec = pstate->ppredicate_rec;
+	int i = 0;
+	for (sllse_t* pn = ppredicate->pfield_names->phead; pn != NULL; pn = pn->pnext, i++) {
+		int column = pstate->predicate_columns[i];
+		if (column < 0 || column >= pdata_fields->length)
+			continue;
+		rsllse_t* pd = pdata_fields->phead;
+		for (int j = 0; j < column; j++)
+			pd = pd->pnext;
+		lrec_put(prec, pn->value, pd->value, NO_FREE);
+	}
+	int keeps = ppredicate->ptest_func(ppredicate->pvstate, prec, pctx);
+	lrec_clear(prec);
+	if (!keeps) {
+		pctx->nr++;
+		pctx->fnr++;
+	}
+	return keeps;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx)
@@ -513,6 +834,11 @@ static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rsl
 		idx++;
 		char free_flags = pd->free_flag;
 		char* key = low_int_to_string(idx, &free_flags);
+		if (pstate->pfield_projection != NULL && !hss_has(pstate->pfield_projection, key)) {
+			if (free_flags & FREE_ENTRY_KEY)
+				free(key);
+			continue;
+		}
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, key, pd->value, free_flags, pd->quote_flag);
 		pd->free_flag = 0;
@@ -534,6 +860,9 @@ static lrec_t* paste_header_and_data(lrec_reader_stdio_csv_state_t* pstate, rsll
 	sllse_t* ph = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
 	for ( ; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext) {
+		// Fields outside the projection are left to the rslls, which frees them on reset.
+		if (pstate->pfield_projection != NULL && !hss_has(pstate->pfield_projection, ph->value))
+			continue;
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, ph->value, pd->value, pd->free_flag, pd->quote_flag);
 		pd->free_flag = 0;
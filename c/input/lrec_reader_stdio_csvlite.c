@@ -107,6 +107,11 @@ lrec_reader_t* lrec_reader_stdio_csvlite_alloc(char* irs, char* ifs, int allow_r
 	}
 	plrec_reader->pprocess_func = lrec_reader_stdio_csvlite_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_csvlite_free;
 
 	return plrec_reader;
@@ -24,13 +24,19 @@ typedef struct _lrec_reader_stdio_dkvp_state_t {
 	int    ifslen;
 	int    ipslen;
 	int    allow_repeat_ifs;
+	int    do_auto_line_term;
 	comment_handling_t comment_handling;
 	char*  comment_string;
 	size_t line_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+	lrec_reader_process_func_t* punfiltered_process_func;
 } lrec_reader_stdio_dkvp_state_t;
 
 static void    lrec_reader_stdio_dkvp_free(lrec_reader_t* preader);
 static void    lrec_reader_stdio_dkvp_sof(void* pvstate, void* pvhandle);
+static long long lrec_reader_stdio_dkvp_count(void* pvstate, void* pvhandle, context_t* pctx);
+static lrec_t* lrec_reader_stdio_dkvp_process_filtered(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others_auto_line_term(void* pvstate, void* pvhandle,
 	context_t* pctx);
 static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_multi_others_auto_line_term(void* pvstate, void* pvhandle,
@@ -46,7 +52,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvsta
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -58,10 +65,13 @@ lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int
 	pstate->ifslen           = strlen(ifs);
 	pstate->ipslen           = strlen(ips);
 	pstate->allow_repeat_ifs = allow_repeat_ifs;
+	pstate->do_auto_line_term = FALSE;
 	pstate->comment_handling = comment_handling;
 	pstate->comment_string   = comment_string;
 	// This is used to track nominal line length over the file read. Bootstrap with a default length.
 	pstate->line_length      = MLR_ALLOC_READ_LINE_INITIAL_SIZE;
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
 
 	plrec_reader->pvstate       = (void*)pstate;
 	plrec_reader->popen_func    = file_reader_stdio_vopen;
@@ -71,6 +81,7 @@ lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int
 		// either case the final character is "\n". Then for autodetect we
 		// simply check if there's a character in the line before the '\n', and
 		// if that is '\r'.
+		pstate->do_auto_line_term = TRUE;
 		pstate->irs = "\n";
 		pstate->irslen = 1;
 		plrec_reader->pprocess_func = (pstate->ifslen == 1 && pstate->ipslen == 1)
@@ -85,7 +96,19 @@ lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int
 			? &lrec_reader_stdio_dkvp_process_multi_irs_single_others
 			: &lrec_reader_stdio_dkvp_process_multi_irs_multi_others;
 	}
+	if (precord_predicate != NULL) {
+		pstate->punfiltered_process_func = plrec_reader->pprocess_func;
+		plrec_reader->pprocess_func = lrec_reader_stdio_dkvp_process_filtered;
+	}
 	plrec_reader->psof_func     = lrec_reader_stdio_dkvp_sof;
+	// Multi-character IRS and comment-stripping are left to the line readers.
+	plrec_reader->pcount_func   = (pstate->irslen == 1 && comment_handling == COMMENTS_ARE_DATA)
+		? lrec_reader_stdio_dkvp_count
+		: NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_dkvp_free;
 
 	return plrec_reader;
@@ -100,6 +123,24 @@ static void lrec_reader_stdio_dkvp_free(lrec_reader_t* preader) {
 static void lrec_reader_stdio_dkvp_sof(void* pvstate, void* pvhandle) {
 }
 
+// ----------------------------------------------------------------
+// Each line is a record, whatever is in it.
+static long long lrec_reader_stdio_dkvp_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_dkvp_state_t* pstate = pvstate;
+	return mlr_count_lines_single_delimiter(pvhandle, pstate->irs[0], pstate->do_auto_line_term, pctx);
+}
+
+// ----------------------------------------------------------------
+// With predicate pushdown: reads past records which fail the test.
+static lrec_t* lrec_reader_stdio_dkvp_process_filtered(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_dkvp_state_t* pstate = pvstate;
+	while (TRUE) {
+		lrec_t* prec = pstate->punfiltered_process_func(pvstate, pvhandle, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+}
+
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others_auto_line_term(
 	void* pvstate, void* pvhandle, context_t* pctx)
@@ -116,7 +157,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others_auto_line
 	if (line == NULL) {
 		return NULL;
 	} else {
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 	}
 }
 
@@ -134,7 +176,7 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_multi_others_auto_line_
 		return NULL;
 	} else {
 		return lrec_parse_stdio_dkvp_multi_sep(line, pstate->ifs, pstate->ips, pstate->ifslen, pstate->ipslen,
-			pstate->allow_repeat_ifs);
+			pstate->allow_repeat_ifs, pstate->pfield_projection);
 	}
 }
 
@@ -148,7 +190,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others(void* pvs
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -163,7 +206,7 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_multi_others(void* pvst
 		return NULL;
 	else
 		return lrec_parse_stdio_dkvp_multi_sep(line, pstate->ifs, pstate->ips, pstate->ifslen, pstate->ipslen,
-			pstate->allow_repeat_ifs);
+			pstate->allow_repeat_ifs, pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -177,7 +220,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_single_others(void* pvst
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -192,7 +236,7 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvsta
 		return NULL;
 	else
 		return lrec_parse_stdio_dkvp_multi_sep(line, pstate->ifs, pstate->ips, pstate->ifslen, pstate->ipslen,
-			pstate->allow_repeat_ifs);
+			pstate->allow_repeat_ifs, pstate->pfield_projection);
 }
 
 // ----------------------------------------------------------------
@@ -204,7 +248,9 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvsta
 // I couldn't find a performance gain using stdlib index(3) ... *maybe* even a
 // fraction of a percent *slower*.
 
-lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs) {
+lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs,
+	hss_t* pfield_projection)
+{
 	lrec_t* prec = lrec_dkvp_alloc(line);
 
 	// It would be easier to split the line on field separator (e.g. ","), then
@@ -234,10 +280,10 @@ lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int all
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char  free_flags = 0;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pfield_projection, key, value, NO_FREE);
 			}
 
 			p++;
@@ -263,10 +309,10 @@ lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int all
 	} else {
 		if (*key == 0 || value <= key) {
 			char  free_flags = 0;
-			lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+			lrec_put_projected(prec, pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
-			lrec_put(prec, key, value, NO_FREE);
+			lrec_put_projected(prec, pfield_projection, key, value, NO_FREE);
 		}
 	}
 
@@ -274,7 +320,7 @@ lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int all
 }
 
 lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int ifslen, int ipslen,
-	int allow_repeat_ifs)
+	int allow_repeat_ifs, hss_t* pfield_projection)
 {
 	lrec_t* prec = lrec_dkvp_alloc(line);
 
@@ -305,10 +351,10 @@ lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int if
 				// "a=".  Here we use the positional index as the key. This way
 				// DKVP is a generalization of NIDX.
 				char  free_flags = 0;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+				lrec_put_projected(prec, pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 			}
 			else {
-				lrec_put(prec, key, value, NO_FREE);
+				lrec_put_projected(prec, pfield_projection, key, value, NO_FREE);
 			}
 
 			p += ifslen;
@@ -334,10 +380,10 @@ lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int if
 	} else {
 		if (*key == 0 || value <= key) {
 			char  free_flags = 0;
-			lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+			lrec_put_projected(prec, pfield_projection, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
 		else {
-			lrec_put(prec, key, value, NO_FREE);
+			lrec_put_projected(prec, pfield_projection, key, value, NO_FREE);
 		}
 	}
 
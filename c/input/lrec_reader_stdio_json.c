@@ -8,46 +8,89 @@
 // ================================================================
 
 // ================================================================
-// This has at present a lot of code duplication with lrec_reader_mmap_json.
-// This is because we read the entire input file into memory and get a pointer
-// to it, which is a lot like mmap.  At some future point we may implement a
-// streaming JSON parser at which point the two files would diverge.
+// Streaming JSON reader. Unlike lrec_reader_mmap_json, which parses the
+// entire input into json_value_t trees and then walks those, this reads the
+// input in fixed-size chunks and parses one top-level object at a time,
+// flattening keys and values directly into the next record as it goes. Memory
+// use is therefore bounded by the size of the largest single record rather
+// than the size of the input, and records are emitted as soon as they are
+// read -- which matters for large files and for 'tail -f | mlr'.
+//
+// As with the non-streaming reader, input may be a sequence of concatenated
+// top-level objects
+//
+//   { "a" : 1 }
+//   { "b" : 2 }
+//
+// or top-level arrays of objects
+//
+// [
+//   { "a" : 1 },
+//   { "b" : 2 }
+// ]
+//
+// or any mix of the two. As in json_parser.c, trailing commas before a closing
+// brace or bracket are accepted.
 // ================================================================
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
-#include "input/file_ingestor_stdio.h"
+#include "input/file_reader_stdio.h"
 #include "input/lrec_readers.h"
 #include "input/json_parser.h"
 #include "input/mlr_json_adapter.h"
 
+#define JSON_STREAM_BUFFER_SIZE (64 * 1024)
+#define JSON_EOF (-1)
+
+typedef enum _json_top_level_t {
+	JSON_TOP_LEVEL_OUTSIDE_ARRAY,
+	JSON_TOP_LEVEL_ARRAY_EXPECT_VALUE,
+	JSON_TOP_LEVEL_ARRAY_EXPECT_COMMA,
+} json_top_level_t;
+
 typedef struct _lrec_reader_stdio_json_state_t {
-	// The list of top-level JSON objects is backed by the file contents. The records are in turn
-	// backed by the top-level JSON objects. This means the latter should not be freed while
-	// the records are in used. (This is done to reduce data copies, for performance: we can
-	// manipulate pointers to strings rather than copying strings.)
-	//
-	// In particular, in the multifile-input case, we need to keep *all* parsed JSON (and
-	// not free one file's data when we proceed to the next) since records with pointers
-	// into the parsed JSON may still be in use -- e.g. mlr sort.
-	sllv_t* ptop_level_json_objects;
-	sllv_t* precords;
 	char* input_json_flatten_separator;
 	json_array_ingest_t json_array_ingest;
 	char* specified_line_term;
 	int do_auto_line_term;
 	char* detected_line_term;
+	int line_term_detected;
 	comment_handling_t comment_handling;
 	char* comment_string;
+	int comment_string_length;
+
+	// The unconsumed input is [pnext, pend) within the chunk buffer.
+	int   fd;
+	char* pbuf;
+	char* pnext;
+	char* pend;
+	int   at_eof;
+	int   at_line_start; // Only tracked when comments are being skipped or passed
+	int   prev_was_cr;
+	long long ilno;
+	json_top_level_t top_level;
+
+	json_flattener_t* pflattener;
 } lrec_reader_stdio_json_state_t;
 
 static void    lrec_reader_stdio_json_free(lrec_reader_t* preader);
 static void    lrec_reader_stdio_json_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_stdio_json_process(void* pvstate, void* pvhandle, context_t* pctx);
 
+static void json_parse_string(lrec_reader_stdio_json_state_t* pstate);
+static void json_parse_number(lrec_reader_stdio_json_state_t* pstate, int c);
+static void json_expect_literal(lrec_reader_stdio_json_state_t* pstate, char* rest);
+static void json_parse_object(lrec_reader_stdio_json_state_t* pstate);
+static void json_parse_array_as_map(lrec_reader_stdio_json_state_t* pstate);
+static void json_parse_value(lrec_reader_stdio_json_state_t* pstate, int c);
+
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator, json_array_ingest_t json_array_ingest, char* line_term,
 	comment_handling_t comment_handling, char* comment_string)
@@ -55,25 +98,41 @@ lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator,
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
 	lrec_reader_stdio_json_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_stdio_json_state_t));
-	pstate->ptop_level_json_objects      = sllv_alloc();
-	pstate->precords                     = sllv_alloc();
 	pstate->input_json_flatten_separator = input_json_flatten_separator;
 	pstate->json_array_ingest            = json_array_ingest;
 	pstate->specified_line_term          = line_term;
 	pstate->do_auto_line_term            = FALSE;
 	pstate->detected_line_term           = "\n"; // xxx adapt to MLR_GLOBALS/ctx-const for Windows port
+	pstate->line_term_detected           = FALSE;
 	pstate->comment_handling             = comment_handling;
 	pstate->comment_string               = comment_string;
+	pstate->comment_string_length        = comment_string == NULL ? 0 : strlen(comment_string);
+
+	pstate->fd                           = -1;
+	pstate->pbuf                         = mlr_malloc_or_die(JSON_STREAM_BUFFER_SIZE);
+	pstate->pnext                        = pstate->pbuf;
+	pstate->pend                         = pstate->pbuf;
+	pstate->at_eof                       = FALSE;
+	pstate->at_line_start                = FALSE;
+	pstate->prev_was_cr                  = FALSE;
+	pstate->ilno                         = 1LL;
+	pstate->top_level                    = JSON_TOP_LEVEL_OUTSIDE_ARRAY;
+	pstate->pflattener                   = json_flattener_alloc(input_json_flatten_separator);
 
 	if (streq(line_term, "auto")) {
 		pstate->do_auto_line_term = TRUE;
 	}
 
 	plrec_reader->pvstate       = (void*)pstate;
-	plrec_reader->popen_func    = file_ingestor_stdio_vopen;
-	plrec_reader->pclose_func   = file_ingestor_stdio_nop_vclose;
+	plrec_reader->popen_func    = file_reader_stdio_vopen;
+	plrec_reader->pclose_func   = file_reader_stdio_vclose;
 	plrec_reader->pprocess_func = lrec_reader_stdio_json_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_json_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_json_free;
 
 	return plrec_reader;
@@ -81,132 +140,538 @@ lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator,
 
 static void lrec_reader_stdio_json_free(lrec_reader_t* preader) {
 	lrec_reader_stdio_json_state_t* pstate = preader->pvstate;
+	json_flattener_free(pstate->pflattener);
+	free(pstate->pbuf);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+// Chunked input. We use read(2) rather than fread so that a partial chunk from a pipe is processed as
+// soon as it arrives, rather than waiting for a full buffer.
+
+static int json_read_more(lrec_reader_stdio_json_state_t* pstate) {
+	if (pstate->at_eof)
+		return FALSE;
+	// Keep any unconsumed bytes.
+	int nkeep = pstate->pend - pstate->pnext;
+	if (nkeep > 0 && pstate->pnext > pstate->pbuf)
+		memmove(pstate->pbuf, pstate->pnext, nkeep);
+	pstate->pnext = pstate->pbuf;
+	pstate->pend  = pstate->pbuf + nkeep;
 
-	for (sllve_t* pe = pstate->ptop_level_json_objects->phead; pe != NULL; pe = pe->pnext) {
-		json_value_t* top_level_json_object = pe->pvvalue;
-		json_free_value(top_level_json_object);
+	while (TRUE) {
+		ssize_t nread = read(pstate->fd, pstate->pend, JSON_STREAM_BUFFER_SIZE - nkeep);
+		if (nread > 0) {
+			pstate->pend += nread;
+			return TRUE;
+		} else if (nread == 0) {
+			pstate->at_eof = TRUE;
+			return FALSE;
+		} else if (errno != EINTR) {
+			perror("read");
+			fprintf(stderr, "%s: JSON read failed.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
 	}
-	sllv_free(pstate->ptop_level_json_objects);
-	for (sllve_t* pf = pstate->precords->phead; pf != NULL; pf = pf->pnext) {
-		lrec_t* prec = pf->pvvalue;
-		lrec_free(prec);
+}
+
+// Makes sure at least n bytes are unconsumed, if the input has that many.
+static int json_ensure_available(lrec_reader_stdio_json_state_t* pstate, int n) {
+	while (pstate->pend - pstate->pnext < n) {
+		if (!json_read_more(pstate))
+			return FALSE;
 	}
-	sllv_free(pstate->precords);
-	pstate->precords = NULL;
+	return TRUE;
+}
 
-	free(pstate);
-	free(preader);
+// Comment lines are skipped (or passed to stdout) in their entirety, up to but not including the line
+// ending. This is the same treatment mlr_json_strip_comments gives them in the non-streaming reader.
+static void json_consume_comment_line(lrec_reader_stdio_json_state_t* pstate) {
+	int pass = pstate->comment_handling == PASS_COMMENTS;
+	int pending_cr = FALSE;
+	while (TRUE) {
+		if (pstate->pnext >= pstate->pend && !json_read_more(pstate))
+			break;
+		char c = *pstate->pnext;
+		if (c == '\n')
+			break;
+		pstate->pnext++;
+		if (pass && pending_cr)
+			fputc('\r', stdout);
+		pending_cr = (c == '\r');
+		if (pass && !pending_cr)
+			fputc(c, stdout);
+	}
+
+	if (pstate->do_auto_line_term && !pstate->line_term_detected && pstate->pnext < pstate->pend) {
+		pstate->detected_line_term = pending_cr ? "\r\n" : "\n";
+		pstate->line_term_detected = TRUE;
+	}
+	pstate->prev_was_cr = pending_cr;
+
+	if (pass) {
+		char* line_term = pstate->do_auto_line_term ? pstate->detected_line_term : pstate->specified_line_term;
+		if (pending_cr && !streq(line_term, "\r\n"))
+			fputc('\r', stdout);
+		fputs(line_term, stdout);
+	}
 }
 
-// The stdio-JSON lrec-reader is non-streaming: we ingest all records here in the start-of-file hook.
-// Then in the process method we pop one lrec off the list at a time, until they are all exhausted.
-// This is in contrast to other Miller lrec-readers.
-//
-// It would be possible to extend the streaming framework to also have an end-of-file hook
-// which we could use here to free parsed-JSON data. However, we simply leverage the start-of-file
-// hook for the *next* file (if any) or the free method (if not): these free parsed-JSON structures
-// from the previous file (if any).
-static void lrec_reader_stdio_json_sof(void* pvstate, void* pvhandle) {
-	lrec_reader_stdio_json_state_t* pstate = pvstate;
-	file_ingestor_stdio_state_t* phandle = pvhandle;
-	json_char* json_input = (json_char*)phandle->sof;
-	json_value_t* parsed_top_level_json;
-	json_char error_buf[JSON_ERROR_MAX];
-
-	// This enables us to handle input of the form
-	//
-	//   { "a" : 1 }
-	//   { "b" : 2 }
-	//   { "c" : 3 }
-	//
-	// in addition to
-	//
-	// [
-	//   { "a" : 1 }
-	//   { "b" : 2 }
-	//   { "c" : 3 }
-	// ]
-	//
-	// This is in line with what jq can handle. In this case, json_parse will return
-	// once for each top-level item and will give us back a pointer to the start of
-	// the rest of the input stream, so we can call json_parse on the rest until it is
-	// all exhausted.
-
-	json_char* item_start = json_input;
-	int length = phandle->eof - phandle->sof;
-	char* detected_line_term = NULL;
-
-	if (pstate->do_auto_line_term) {
-		// Find the first line-ending sequence (if any): LF or CRLF.
-		for (char* p = phandle->sof; p < phandle->eof; p++) {
-			if (p[0] == '\n') {
-				if (p > phandle->sof && p[-1] == '\r') {
-					detected_line_term = "\r\n";
-				} else {
-					detected_line_term = "\n";
-				}
-				break;
+static int json_getc_slow(lrec_reader_stdio_json_state_t* pstate) {
+	while (TRUE) {
+		if (pstate->pnext >= pstate->pend && !json_read_more(pstate))
+			return JSON_EOF;
+		if (pstate->comment_string == NULL || pstate->comment_handling == COMMENTS_ARE_DATA)
+			return (unsigned char)*pstate->pnext++;
+
+		if (pstate->at_line_start) {
+			pstate->at_line_start = FALSE;
+			if (json_ensure_available(pstate, pstate->comment_string_length)
+				&& streqn(pstate->pnext, pstate->comment_string, pstate->comment_string_length))
+			{
+				json_consume_comment_line(pstate);
+				continue;
 			}
 		}
+		int c = (unsigned char)*pstate->pnext++;
+		if (c == '\n')
+			pstate->at_line_start = TRUE;
+		return c;
 	}
+}
+
+static inline int json_getc(lrec_reader_stdio_json_state_t* pstate) {
+	if (pstate->pnext < pstate->pend && pstate->comment_handling == COMMENTS_ARE_DATA)
+		return (unsigned char)*pstate->pnext++;
+	else
+		return json_getc_slow(pstate);
+}
+
+// Only valid immediately after a json_getc which did not return EOF.
+static inline void json_ungetc(lrec_reader_stdio_json_state_t* pstate) {
+	pstate->pnext--;
+	if (*pstate->pnext == '\n')
+		pstate->at_line_start = FALSE;
+}
+
+// Returns the first non-whitespace character, or JSON_EOF.
+static inline int json_skip_whitespace(lrec_reader_stdio_json_state_t* pstate) {
+	while (TRUE) {
+		int c = json_getc(pstate);
+		switch (c) {
+		case '\n':
+			pstate->ilno++;
+			if (pstate->do_auto_line_term && !pstate->line_term_detected) {
+				pstate->detected_line_term = pstate->prev_was_cr ? "\r\n" : "\n";
+				pstate->line_term_detected = TRUE;
+			}
+			pstate->prev_was_cr = FALSE;
+			break;
+		case '\r':
+			pstate->prev_was_cr = TRUE;
+			break;
+		case ' ':
+		case '\t':
+			pstate->prev_was_cr = FALSE;
+			break;
+		default:
+			pstate->prev_was_cr = FALSE;
+			return c;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+static void json_fail(lrec_reader_stdio_json_state_t* pstate, char* message) {
+	fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: %s\n", MLR_GLOBALS.bargv0, pstate->ilno, message);
+	exit(1);
+}
+
+static void json_fail_unexpected(lrec_reader_stdio_json_state_t* pstate, int c, char* where) {
+	if (c == JSON_EOF)
+		fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: Unexpected EOF %s\n",
+			MLR_GLOBALS.bargv0, pstate->ilno, where);
+	else
+		fprintf(stderr, "%s: Unable to parse JSON data: Line %lld: Unexpected `%c` %s\n",
+			MLR_GLOBALS.bargv0, pstate->ilno, c, where);
+	exit(1);
+}
 
-	// Skip comments. For JSON, we ingest the entire blob, this is a matter of finding and iterating over lines.
-	// Miller data comments must be at start of line.
-	if (pstate->comment_handling != COMMENTS_ARE_DATA) {
-		char* line_term = pstate->specified_line_term;
-		if (pstate->do_auto_line_term && detected_line_term != NULL)
-			line_term = detected_line_term;
-		mlr_json_strip_comments(phandle->sof, phandle->eof,
-			pstate->comment_handling, pstate->comment_string, line_term);
+static json_type_t json_type_from_first_char(int c) {
+	switch (c) {
+	case '{': return JSON_OBJECT;
+	case '[': return JSON_ARRAY;
+	case '"': return JSON_STRING;
+	case 't': case 'f': return JSON_BOOLEAN;
+	case 'n': return JSON_NULL;
+	case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+		return JSON_INTEGER;
+	default: return JSON_NONE;
 	}
-	mlr_json_end_strip(phandle->sof, &phandle->eof);
-	length = phandle->eof - phandle->sof;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_stdio_json_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_stdio_json_state_t* pstate = pvstate;
+	FILE* input_stream = pvhandle;
 
-	if (length > 0) {
-		while (TRUE) {
+	pstate->fd            = fileno(input_stream);
+	pstate->pnext         = pstate->pbuf;
+	pstate->pend          = pstate->pbuf;
+	pstate->at_eof        = FALSE;
+	pstate->at_line_start = pstate->comment_handling != COMMENTS_ARE_DATA;
+	pstate->prev_was_cr   = FALSE;
+	pstate->ilno          = 1LL;
+	pstate->top_level     = JSON_TOP_LEVEL_OUTSIDE_ARRAY;
 
-			parsed_top_level_json = json_parse(item_start, length, error_buf, &item_start);
+	// Skip UTF-8 BOM if any
+	if (json_ensure_available(pstate, 3) && memcmp(pstate->pnext, "\xef\xbb\xbf", 3) == 0)
+		pstate->pnext += 3;
 
-			if (parsed_top_level_json == NULL) {
-				fprintf(stderr, "%s: Unable to parse JSON data: %s\n", MLR_GLOBALS.bargv0, error_buf);
+	// Find the first line-ending sequence (if any) in the first chunk, LF or CRLF, so that it's known before
+	// the first record is written. Failing that, the whitespace-skipper will find it later.
+	if (pstate->do_auto_line_term && !pstate->line_term_detected) {
+		char* p = memchr(pstate->pnext, '\n', pstate->pend - pstate->pnext);
+		if (p != NULL) {
+			pstate->detected_line_term = (p > pstate->pnext && p[-1] == '\r') ? "\r\n" : "\n";
+			pstate->line_term_detected = TRUE;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_stdio_json_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_json_state_t* pstate = pvstate;
+
+	while (TRUE) {
+		int c = json_skip_whitespace(pstate);
+		if (pstate->line_term_detected) {
+			context_set_autodetected_line_term(pctx, pstate->detected_line_term);
+		}
+
+		if (c == JSON_EOF) {
+			if (pstate->top_level != JSON_TOP_LEVEL_OUTSIDE_ARRAY)
+				json_fail_unexpected(pstate, c, "in top-level array");
+			return NULL;
+		}
+
+		switch (pstate->top_level) {
+
+		case JSON_TOP_LEVEL_OUTSIDE_ARRAY:
+			if (c == '[') {
+				pstate->top_level = JSON_TOP_LEVEL_ARRAY_EXPECT_VALUE;
+				continue;
+			}
+			if (c != '{') {
+				if (json_type_from_first_char(c) == JSON_NONE)
+					json_fail_unexpected(pstate, c, "when seeking value");
+				fprintf(stderr,
+					"%s: found non-terminal (type %s) at top level. This is valid but unmillerable JSON.\n",
+					MLR_GLOBALS.bargv0, json_describe_type(json_type_from_first_char(c)));
+				fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
 				exit(1);
 			}
+			break;
 
-			// The lrecs have their string pointers pointing into the parsed-JSON objects (for
-			// efficiency) so it's important we not free the latter until our free method.
-			if (!reference_json_objects_as_lrecs(pstate->precords, parsed_top_level_json,
-				pstate->input_json_flatten_separator, pstate->json_array_ingest))
-			{
+		case JSON_TOP_LEVEL_ARRAY_EXPECT_VALUE:
+			if (c == ']') {
+				pstate->top_level = JSON_TOP_LEVEL_OUTSIDE_ARRAY;
+				continue;
+			}
+			if (c != '{') {
+				if (json_type_from_first_char(c) == JSON_NONE)
+					json_fail_unexpected(pstate, c, "in top-level array");
+				fprintf(stderr,
+					"%s: found non-object (type %s) within top-level array. This is valid but unmillerable JSON.\n",
+					MLR_GLOBALS.bargv0, json_describe_type(json_type_from_first_char(c)));
 				fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
 				exit(1);
 			}
+			pstate->top_level = JSON_TOP_LEVEL_ARRAY_EXPECT_COMMA;
+			break;
 
-			if (item_start == NULL)
-				break;
-			if (*item_start == 0)
-				break;
-			length -= (item_start - json_input);
-			json_input = item_start;
-			// json_parse goes up to the '\r' or '\n' (whichever is found first) on the first
-			// parse, then keeps going from there on the next. E.g. in the CRLF case it
-			// consumes the CR at the end of the first read and consumes the LF at the start
-			// of the second, and so on. After the very last parse, we need to here consume
-			// the final '\n' which is (by itself) a parse error.
-			if (length == 1 && *(char*)json_input == '\n') {
-				break;
+		case JSON_TOP_LEVEL_ARRAY_EXPECT_COMMA:
+			if (c == ',') {
+				pstate->top_level = JSON_TOP_LEVEL_ARRAY_EXPECT_VALUE;
+			} else if (c == ']') {
+				pstate->top_level = JSON_TOP_LEVEL_OUTSIDE_ARRAY;
+			} else {
+				json_fail_unexpected(pstate, c, "in top-level array: expected , or ]");
 			}
+			continue;
 		}
+
+		json_parse_object(pstate);
+		return json_flattener_finish(pstate->pflattener);
+	}
+}
+
+// ----------------------------------------------------------------
+// Scalars are decoded straight into the flattener's record buffer.
+
+static int json_get_hex4(lrec_reader_stdio_json_state_t* pstate) {
+	int value = 0;
+	for (int i = 0; i < 4; i++) {
+		int c = json_getc(pstate);
+		if (c >= '0' && c <= '9')
+			value = (value << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			value = (value << 4) | (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			value = (value << 4) | (c - 'A' + 10);
+		else
+			json_fail_unexpected(pstate, c, "in \\u escape");
 	}
-	if (detected_line_term != NULL) {
-		pstate->detected_line_term = detected_line_term;
+	return value;
+}
+
+// The opening double quote has already been consumed.
+static void json_parse_string(lrec_reader_stdio_json_state_t* pstate) {
+	json_flattener_t* pflattener = pstate->pflattener;
+	while (TRUE) {
+		// Copy runs of unescaped characters a chunk at a time.
+		if (pstate->comment_handling == COMMENTS_ARE_DATA) {
+			char* p = pstate->pnext;
+			char* q = p;
+			while (q < pstate->pend && *q != '"' && *q != '\\')
+				q++;
+			if (q > p) {
+				json_flattener_append_chars(pflattener, p, q - p);
+				pstate->pnext = q;
+			}
+		}
+
+		int c = json_getc(pstate);
+		if (c == '"') {
+			return;
+		} else if (c == JSON_EOF) {
+			json_fail_unexpected(pstate, c, "in string");
+		} else if (c != '\\') {
+			json_flattener_append_char(pflattener, c);
+			continue;
+		}
+
+		c = json_getc(pstate);
+		switch (c) {
+		case 'b': json_flattener_append_char(pflattener, '\b'); break;
+		case 'f': json_flattener_append_char(pflattener, '\f'); break;
+		case 'n': json_flattener_append_char(pflattener, '\n'); break;
+		case 'r': json_flattener_append_char(pflattener, '\r'); break;
+		case 't': json_flattener_append_char(pflattener, '\t'); break;
+		case JSON_EOF:
+			json_fail_unexpected(pstate, c, "in string");
+			break;
+		case 'u': {
+			unsigned int uchar = json_get_hex4(pstate);
+			if ((uchar & 0xF800) == 0xD800) { // UTF-16 surrogate pair
+				int c1 = json_getc(pstate);
+				int c2 = json_getc(pstate);
+				if (c1 != '\\' || c2 != 'u')
+					json_fail(pstate, "Unpaired UTF-16 surrogate in \\u escape");
+				unsigned int uchar2 = json_get_hex4(pstate);
+				uchar = 0x010000 | ((uchar & 0x3FF) << 10) | (uchar2 & 0x3FF);
+			}
+			if (uchar <= 0x7F) {
+				json_flattener_append_char(pflattener, uchar);
+			} else if (uchar <= 0x7FF) {
+				json_flattener_append_char(pflattener, 0xC0 | (uchar >> 6));
+				json_flattener_append_char(pflattener, 0x80 | (uchar & 0x3F));
+			} else if (uchar <= 0xFFFF) {
+				json_flattener_append_char(pflattener, 0xE0 | (uchar >> 12));
+				json_flattener_append_char(pflattener, 0x80 | ((uchar >> 6) & 0x3F));
+				json_flattener_append_char(pflattener, 0x80 | (uchar & 0x3F));
+			} else {
+				json_flattener_append_char(pflattener, 0xF0 | (uchar >> 18));
+				json_flattener_append_char(pflattener, 0x80 | ((uchar >> 12) & 0x3F));
+				json_flattener_append_char(pflattener, 0x80 | ((uchar >> 6) & 0x3F));
+				json_flattener_append_char(pflattener, 0x80 | (uchar & 0x3F));
+			}
+			break;
+		}
+		default: // Including \" \\ and \/
+			json_flattener_append_char(pflattener, c);
+			break;
+		}
+	}
+}
+
+// Numbers are kept as-is, with however many decimal places the input has: see json_parser.h.
+// The first character has already been consumed.
+static void json_parse_number(lrec_reader_stdio_json_state_t* pstate, int c) {
+	json_flattener_t* pflattener = pstate->pflattener;
+	int start = pflattener->buf_length;
+	while (TRUE) {
+		json_flattener_append_char(pflattener, c);
+		c = json_getc(pstate);
+		if (c == JSON_EOF)
+			break;
+		if (!((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')) {
+			json_ungetc(pstate);
+			break;
+		}
+	}
+
+	// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	char* p = &pflattener->buf[start];
+	char* e = &pflattener->buf[pflattener->buf_length];
+	if (p < e && *p == '-')
+		p++;
+	if (p >= e || !isdigit((unsigned char)*p))
+		json_fail(pstate, "Expected digit in number");
+	if (*p == '0' && p + 1 < e && isdigit((unsigned char)p[1]))
+		json_fail(pstate, "Unexpected `0` before digit in number");
+	while (p < e && isdigit((unsigned char)*p))
+		p++;
+	if (p < e && *p == '.') {
+		p++;
+		if (p >= e || !isdigit((unsigned char)*p))
+			json_fail(pstate, "Expected digit after `.`");
+		while (p < e && isdigit((unsigned char)*p))
+			p++;
+	}
+	if (p < e && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < e && (*p == '+' || *p == '-'))
+			p++;
+		if (p >= e || !isdigit((unsigned char)*p))
+			json_fail(pstate, "Expected digit after `e`");
+		while (p < e && isdigit((unsigned char)*p))
+			p++;
+	}
+	if (p < e)
+		json_fail_unexpected(pstate, *p, "in number");
+}
+
+// The first character has already been consumed.
+static void json_expect_literal(lrec_reader_stdio_json_state_t* pstate, char* rest) {
+	for (char* p = rest; *p; p++) {
+		int c = json_getc(pstate);
+		if (c != *p)
+			json_fail_unexpected(pstate, c, "in true/false/null");
 	}
 }
 
 // ----------------------------------------------------------------
-static lrec_t* lrec_reader_stdio_json_process(void* pvstate, void* pvhandle, context_t* pctx) {
-	lrec_reader_stdio_json_state_t* pstate = pvstate;
-	if (pstate->do_auto_line_term) {
-		context_set_autodetected_line_term(pctx, pstate->detected_line_term);
+// The opening brace has already been consumed.
+static void json_parse_object(lrec_reader_stdio_json_state_t* pstate) {
+	json_flattener_t* pflattener = pstate->pflattener;
+	int c = json_skip_whitespace(pstate);
+	if (c == '}')
+		return;
+
+	while (TRUE) {
+		if (c != '"')
+			json_fail_unexpected(pstate, c, "in object");
+		json_flattener_begin_key(pflattener);
+		json_parse_string(pstate);
+		json_flattener_end_key(pflattener);
+
+		c = json_skip_whitespace(pstate);
+		if (c != ':')
+			json_fail_unexpected(pstate, c, "in object: expected :");
+
+		json_parse_value(pstate, json_skip_whitespace(pstate));
+
+		c = json_skip_whitespace(pstate);
+		if (c == '}')
+			return;
+		if (c != ',')
+			json_fail_unexpected(pstate, c, "in object: expected , or }");
+		c = json_skip_whitespace(pstate);
+		if (c == '}')
+			return;
+	}
+}
+
+// The opening bracket has already been consumed.
+static void json_parse_array_as_map(lrec_reader_stdio_json_state_t* pstate) {
+	int idx = 0;
+	int c = json_skip_whitespace(pstate);
+	if (c == ']')
+		return;
+
+	while (TRUE) {
+		json_flattener_put_index_key(pstate->pflattener, idx++);
+		json_parse_value(pstate, c);
+
+		c = json_skip_whitespace(pstate);
+		if (c == ']')
+			return;
+		if (c != ',')
+			json_fail_unexpected(pstate, c, "in array: expected , or ]");
+		c = json_skip_whitespace(pstate);
+		if (c == ']')
+			return;
+	}
+}
+
+// ----------------------------------------------------------------
+// The key has been ended in the flattener; c is the first character of the value.
+static void json_parse_value(lrec_reader_stdio_json_state_t* pstate, int c) {
+	json_flattener_t* pflattener = pstate->pflattener;
+	int saved_prefix_length;
+	int mark;
+
+	switch (c) {
+	case '"':
+		json_parse_string(pstate);
+		json_flattener_end_value(pflattener);
+		break;
+
+	case '{':
+		saved_prefix_length = json_flattener_push_prefix(pflattener);
+		json_parse_object(pstate);
+		json_flattener_pop_prefix(pflattener, saved_prefix_length);
+		break;
+
+	case '[':
+		switch (pstate->json_array_ingest) {
+		case JSON_ARRAY_INGEST_FATAL:
+			fprintf(stderr,
+				"%s: found array item within JSON object. This is valid but unmillerable JSON.\n"
+				"Use --json-skip-arrays-on-input to exclude these from input without fataling.\n"
+				"Or, --json-map-arrays-on-input to convert them to integer-indexed maps.\n",
+				MLR_GLOBALS.bargv0);
+			fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+			break;
+		case JSON_ARRAY_INGEST_AS_MAP:
+			saved_prefix_length = json_flattener_push_prefix(pflattener);
+			json_parse_array_as_map(pstate);
+			json_flattener_pop_prefix(pflattener, saved_prefix_length);
+			break;
+		default:
+			// Parse for syntax, then discard.
+			saved_prefix_length = json_flattener_push_prefix(pflattener);
+			mark = json_flattener_mark(pflattener);
+			json_parse_array_as_map(pstate);
+			json_flattener_rewind(pflattener, mark);
+			json_flattener_pop_prefix(pflattener, saved_prefix_length);
+			break;
+		}
+		break;
+
+	case 't':
+		json_expect_literal(pstate, "rue");
+		json_flattener_put_value(pflattener, "true");
+		break;
+	case 'f':
+		json_expect_literal(pstate, "alse");
+		json_flattener_put_value(pflattener, "false");
+		break;
+	case 'n':
+		json_expect_literal(pstate, "ull");
+		json_flattener_put_value(pflattener, "");
+		break;
+
+	default:
+		if (c == '-' || (c >= '0' && c <= '9')) {
+			json_parse_number(pstate, c);
+			json_flattener_end_value(pflattener);
+		} else {
+			json_fail_unexpected(pstate, c, "when seeking value");
+		}
+		break;
 	}
-	return sllv_pop(pstate->precords);
 }
@@ -20,13 +20,19 @@ typedef struct _lrec_reader_stdio_nidx_state_t {
 	int    irslen;
 	int    ifslen;
 	int    allow_repeat_ifs;
+	int    do_auto_line_term;
 	comment_handling_t comment_handling;
 	char*  comment_string;
 	size_t line_length;
+	hss_t* pfield_projection;
+	lrec_reader_predicate_t* precord_predicate;
+	lrec_reader_process_func_t* punfiltered_process_func;
 } lrec_reader_stdio_nidx_state_t;
 
 static void    lrec_reader_stdio_nidx_free(lrec_reader_t* preader);
 static void    lrec_reader_stdio_nidx_sof(void* pvstate, void* pvhandle);
+static long long lrec_reader_stdio_nidx_count(void* pvstate, void* pvhandle, context_t* pctx);
+static lrec_t* lrec_reader_stdio_nidx_process_filtered(void* pvstate, void* pvhandle, context_t* pctx);
 static lrec_t* lrec_reader_stdio_nidx_process_single_irs_single_ifs_auto_line_term(void* pvstate, void* pvhandle,
 	context_t* pctx);
 static lrec_t* lrec_reader_stdio_nidx_process_single_irs_multi_ifs_auto_line_term(void* pvstate, void* pvhandle,
@@ -38,7 +44,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_multi_ifs(void* pvstate,
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -48,10 +55,13 @@ lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repe
 	pstate->irslen           = strlen(irs);
 	pstate->ifslen           = strlen(ifs);
 	pstate->allow_repeat_ifs = allow_repeat_ifs;
+	pstate->do_auto_line_term = FALSE;
 	pstate->comment_handling = comment_handling;
 	pstate->comment_string   = comment_string;
 	// This is used to track nominal line length over the file read. Bootstrap with a default length.
 	pstate->line_length      = MLR_ALLOC_READ_LINE_INITIAL_SIZE;
+	pstate->pfield_projection = pfield_projection;
+	pstate->precord_predicate = precord_predicate;
 
 	plrec_reader->pvstate       = (void*)pstate;
 	plrec_reader->popen_func    = file_reader_stdio_vopen;
@@ -61,6 +71,7 @@ lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repe
 		// either case the final character is "\n". Then for autodetect we
 		// simply check if there's a character in the line before the '\n', and
 		// if that is '\r'.
+		pstate->do_auto_line_term = TRUE;
 		pstate->irs = "\n";
 		pstate->irslen = 1;
 		plrec_reader->pprocess_func = (pstate->ifslen == 1)
@@ -75,7 +86,19 @@ lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repe
 			? &lrec_reader_stdio_nidx_process_multi_irs_single_ifs
 			: &lrec_reader_stdio_nidx_process_multi_irs_multi_ifs;
 	}
+	if (precord_predicate != NULL) {
+		pstate->punfiltered_process_func = plrec_reader->pprocess_func;
+		plrec_reader->pprocess_func = lrec_reader_stdio_nidx_process_filtered;
+	}
 	plrec_reader->psof_func     = lrec_reader_stdio_nidx_sof;
+	// Multi-character IRS and comment-stripping are left to the line readers.
+	plrec_reader->pcount_func   = (pstate->irslen == 1 && comment_handling == COMMENTS_ARE_DATA)
+		? lrec_reader_stdio_nidx_count
+		: NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_nidx_free;
 
 	return plrec_reader;
@@ -90,6 +113,24 @@ static void lrec_reader_stdio_nidx_free(lrec_reader_t* preader) {
 static void lrec_reader_stdio_nidx_sof(void* pvstate, void* pvhandle) {
 }
 
+// ----------------------------------------------------------------
+// Each line is a record, whatever is in it.
+static long long lrec_reader_stdio_nidx_count(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_nidx_state_t* pstate = pvstate;
+	return mlr_count_lines_single_delimiter(pvhandle, pstate->irs[0], pstate->do_auto_line_term, pctx);
+}
+
+// ----------------------------------------------------------------
+// With predicate pushdown: reads past records which fail the test.
+static lrec_t* lrec_reader_stdio_nidx_process_filtered(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_nidx_state_t* pstate = pvstate;
+	while (TRUE) {
+		lrec_t* prec = pstate->punfiltered_process_func(pvstate, pvhandle, pctx);
+		if (prec == NULL || lrec_reader_predicate_keeps(pstate->precord_predicate, prec, pctx))
+			return prec;
+	}
+}
+
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_stdio_nidx_process_single_irs_single_ifs_auto_line_term(void* pvstate, void* pvhandle, context_t* pctx) {
 	FILE* input_stream = pvhandle;
@@ -104,7 +145,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_single_irs_single_ifs_auto_line_te
 	if (line == NULL) {
 		return NULL;
 	} else {
-		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 	}
 }
 
@@ -121,7 +163,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_single_irs_multi_ifs_auto_line_ter
 	if (line == NULL) {
 		return NULL;
 	} else {
-		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 	}
 }
 
@@ -138,7 +181,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_single_irs_single_ifs(void* pvstat
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_nidx_process_single_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -154,7 +198,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_single_irs_multi_ifs(void* pvstate
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -168,7 +213,8 @@ static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_single_ifs(void* pvstate
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_single_sep(line, pstate->ifs[0], pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -182,11 +228,14 @@ static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_multi_ifs(void* pvstate,
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_nidx_multi_sep(line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs,
+			pstate->pfield_projection);
 }
 
 // ----------------------------------------------------------------
-lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs) {
+lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs,
+	hss_t* pfield_projection)
+{
 	lrec_t* prec = lrec_nidx_alloc(line);
 
 	int idx = 0;
@@ -205,7 +254,7 @@ lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pfield_projection, key, value, free_flags);
 
 			p++;
 			if (allow_repeat_ifs) {
@@ -223,14 +272,16 @@ lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_
 		; // OK
 	} else {
 		key = low_int_to_string(idx, &free_flags);
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pfield_projection, key, value, free_flags);
 	}
 
 	return prec;
 }
 
 // ----------------------------------------------------------------
-lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs) {
+lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs,
+	hss_t* pfield_projection)
+{
 	lrec_t* prec = lrec_nidx_alloc(line);
 
 	int  idx = 0;
@@ -249,7 +300,7 @@ lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int a
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+			lrec_put_projected(prec, pfield_projection, key, value, free_flags);
 
 			p += ifslen;
 			if (allow_repeat_ifs) {
@@ -267,7 +318,7 @@ lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int a
 		; // OK
 	} else {
 		key = low_int_to_string(idx, &free_flags);
-		lrec_put(prec, key, value, free_flags);
+		lrec_put_projected(prec, pfield_projection, key, value, free_flags);
 	}
 
 	return prec;
@@ -0,0 +1,303 @@
+// ================================================================
+// TSV is like CSV-lite with a single-character field separator (tab by
+// default) and no double-quoting. Instead, tabs, newlines, and carriage
+// returns within fields are written as the two-character sequences "\t",
+// "\n", and "\r", and backslash as "\\"; these are decoded in place. Fields
+// without backslashes -- the vast majority -- are handed through untouched.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cli/comment_handling.h"
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "containers/slls.h"
+#include "containers/lhmslv.h"
+#include "input/file_reader_stdio.h"
+#include "input/line_readers.h"
+#include "input/lrec_readers.h"
+
+// See lrec_reader_stdio_csvlite.c for the header-keeper and multi-file semantics,
+// which are the same here.
+
+typedef struct _lrec_reader_stdio_tsv_state_t {
+	long long  ifnr;
+	long long  ilno; // Line-level, not record-level as in context_t
+	char*  irs;
+	char   ifs;
+	int    irslen;
+	int    do_auto_line_term;
+	int    use_implicit_header;
+	size_t line_length;
+	comment_handling_t comment_handling;
+	char*  comment_string;
+
+	int  expect_header_line_next;
+	header_keeper_t* pheader_keeper;
+	lhmslv_t*     pheader_keepers;
+} lrec_reader_stdio_tsv_state_t;
+
+static void    lrec_reader_stdio_tsv_free(lrec_reader_t* preader);
+static void    lrec_reader_stdio_tsv_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_stdio_tsv_process(void* pvstate, void* pvhandle, context_t* pctx);
+static char*   lrec_reader_stdio_tsv_read_line(lrec_reader_stdio_tsv_state_t* pstate, FILE* input_stream,
+	context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_stdio_tsv_alloc(char* irs, char ifs, int use_implicit_header,
+	comment_handling_t comment_handling, char* comment_string)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_stdio_tsv_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_stdio_tsv_state_t));
+	pstate->ifnr                    = 0LL;
+	pstate->ilno                    = 0LL;
+	pstate->irs                     = irs;
+	pstate->ifs                     = ifs;
+	pstate->irslen                  = strlen(irs);
+	pstate->do_auto_line_term       = FALSE;
+	pstate->use_implicit_header     = use_implicit_header;
+	// This is used to track nominal line length over the file read. Bootstrap with a default length.
+	pstate->line_length             = MLR_ALLOC_READ_LINE_INITIAL_SIZE;
+	pstate->comment_handling        = comment_handling;
+	pstate->comment_string          = comment_string;
+
+	pstate->expect_header_line_next = use_implicit_header  ? FALSE : TRUE;
+	pstate->pheader_keeper          = NULL;
+	pstate->pheader_keepers         = lhmslv_alloc();
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_stdio_vopen;
+	plrec_reader->pclose_func   = file_reader_stdio_vclose;
+	if (streq(irs, "auto")) {
+		// Auto means either lines end in "\n" or "\r\n" (LF or CRLF).  In
+		// either case the final character is "\n". Then for autodetect we
+		// simply check if there's a character in the line before the '\n', and
+		// if that is '\r'.
+		pstate->irs = "\n";
+		pstate->irslen = 1;
+		pstate->do_auto_line_term = TRUE;
+	}
+	plrec_reader->pprocess_func = lrec_reader_stdio_tsv_process;
+	plrec_reader->psof_func     = lrec_reader_stdio_tsv_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
+	plrec_reader->pfree_func    = lrec_reader_stdio_tsv_free;
+
+	return plrec_reader;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_stdio_tsv_free(lrec_reader_t* preader) {
+	lrec_reader_stdio_tsv_state_t* pstate = preader->pvstate;
+	for (lhmslve_t* pe = pstate->pheader_keepers->phead; pe != NULL; pe = pe->pnext) {
+		header_keeper_t* pheader_keeper = pe->pvvalue;
+		header_keeper_free(pheader_keeper);
+	}
+	lhmslv_free(pstate->pheader_keepers);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_stdio_tsv_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_stdio_tsv_state_t* pstate = pvstate;
+	pstate->ifnr = 0LL;
+	pstate->ilno = 0LL;
+	pstate->expect_header_line_next = pstate->use_implicit_header ? FALSE : TRUE;
+}
+
+// ----------------------------------------------------------------
+static char* lrec_reader_stdio_tsv_read_line(lrec_reader_stdio_tsv_state_t* pstate, FILE* input_stream,
+	context_t* pctx)
+{
+	char* line = NULL;
+	if (pstate->comment_handling == COMMENTS_ARE_DATA) {
+		if (pstate->irslen == 1)
+			line = mlr_alloc_read_line_single_delimiter(input_stream, pstate->irs[0],
+				&pstate->line_length, pstate->do_auto_line_term, pctx);
+		else
+			line = mlr_alloc_read_line_multiple_delimiter(input_stream, pstate->irs, pstate->irslen,
+				&pstate->line_length);
+	} else {
+		int num_lines_comment_skipped = 0;
+		if (pstate->irslen == 1)
+			line = mlr_alloc_read_line_single_delimiter_stripping_comments_aux(input_stream, pstate->irs[0],
+				&pstate->line_length, pstate->do_auto_line_term,
+				pstate->comment_handling, pstate->comment_string, &num_lines_comment_skipped, pctx);
+		else
+			line = mlr_alloc_read_line_multiple_delimiter_stripping_comments_aux(input_stream,
+				pstate->irs, pstate->irslen, &pstate->line_length,
+				pstate->comment_handling, pstate->comment_string, &num_lines_comment_skipped);
+		pstate->ilno += num_lines_comment_skipped;
+	}
+	if (line != NULL)
+		pstate->ilno++;
+	return line;
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_stdio_tsv_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	FILE* input_stream = pvhandle;
+	lrec_reader_stdio_tsv_state_t* pstate = pvstate;
+
+	while (TRUE) {
+		if (pstate->expect_header_line_next) {
+			while (TRUE) {
+				char* hline = lrec_reader_stdio_tsv_read_line(pstate, input_stream, pctx);
+				if (hline == NULL) // EOF
+					return NULL;
+
+				slls_t* pheader_fields = split_tsv_header_line(hline, pstate->ifs);
+				if (pheader_fields->length == 0) {
+					slls_free(pheader_fields);
+					free(hline);
+					pstate->pheader_keeper = NULL;
+					continue;
+				}
+
+				for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
+					if (*pe->value == 0) {
+						fprintf(stderr, "%s: unacceptable empty TSV key at file \"%s\" line %lld.\n",
+							MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+						exit(1);
+					}
+				}
+
+				pstate->expect_header_line_next = FALSE;
+
+				pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
+				if (pstate->pheader_keeper == NULL) {
+					pstate->pheader_keeper = header_keeper_alloc(hline, pheader_fields);
+					lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
+						NO_FREE); // freed by header-keeper
+				} else { // Re-use the header-keeper in the header cache
+					slls_free(pheader_fields);
+					free(hline);
+				}
+				break;
+			}
+		}
+
+		char* line = lrec_reader_stdio_tsv_read_line(pstate, input_stream, pctx);
+		if (line == NULL) // EOF
+			return NULL;
+
+		if (!*line) {
+			free(line);
+			if (pstate->pheader_keeper != NULL && !pstate->use_implicit_header) {
+				pstate->pheader_keeper = NULL;
+				pstate->expect_header_line_next = TRUE;
+			}
+			continue;
+		}
+
+		pstate->ifnr++;
+		return pstate->use_implicit_header
+			? lrec_parse_stdio_tsv_data_line_implicit_header(line, pstate->ifs)
+			: lrec_parse_stdio_tsv_data_line(pstate->pheader_keeper, pctx->filename, pstate->ilno,
+				line, pstate->ifs);
+	}
+}
+
+// ----------------------------------------------------------------
+slls_t* split_tsv_header_line(char* line, char ifs) {
+	slls_t* plist = slls_alloc();
+	if (*line == 0) // empty string splits to empty list
+		return plist;
+
+	char* start = line;
+	int saw_backslash = FALSE;
+	for (char* p = line; *p; p++) {
+		if (*p == ifs) {
+			*p = 0;
+			if (saw_backslash) {
+				mlr_unbackslash_tsv_in_place(start);
+				saw_backslash = FALSE;
+			}
+			slls_append_no_free(plist, start);
+			start = p + 1;
+		} else if (*p == '\\') {
+			saw_backslash = TRUE;
+		}
+	}
+	if (saw_backslash)
+		mlr_unbackslash_tsv_in_place(start);
+	slls_append_no_free(plist, start);
+
+	return plist;
+}
+
+// ----------------------------------------------------------------
+lrec_t* lrec_parse_stdio_tsv_data_line(header_keeper_t* pheader_keeper, char* filename, long long ilno,
+	char* data_line, char ifs)
+{
+	lrec_t* prec = lrec_csvlite_alloc(data_line);
+	char* p = data_line;
+	char* value = p;
+	int saw_backslash = FALSE;
+
+	sllse_t* pe = pheader_keeper->pkeys->phead;
+	for ( ; *p; p++) {
+		if (*p == ifs) {
+			*p = 0;
+			if (pe == NULL) {
+				fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
+					MLR_GLOBALS.bargv0, filename, ilno);
+				exit(1);
+			}
+			if (saw_backslash) {
+				mlr_unbackslash_tsv_in_place(value);
+				saw_backslash = FALSE;
+			}
+			lrec_put(prec, pe->value, value, NO_FREE);
+			pe = pe->pnext;
+			value = p + 1;
+		} else if (*p == '\\') {
+			saw_backslash = TRUE;
+		}
+	}
+	if (pe == NULL || pe->pnext != NULL) {
+		fprintf(stderr, "%s: Header-data length mismatch in file %s at line %lld.\n",
+			MLR_GLOBALS.bargv0, filename, ilno);
+		exit(1);
+	}
+	if (saw_backslash)
+		mlr_unbackslash_tsv_in_place(value);
+	lrec_put(prec, pe->value, value, NO_FREE);
+
+	return prec;
+}
+
+lrec_t* lrec_parse_stdio_tsv_data_line_implicit_header(char* data_line, char ifs) {
+	lrec_t* prec = lrec_csvlite_alloc(data_line);
+	char* p = data_line;
+	char* value = p;
+	char  free_flags = NO_FREE;
+	int saw_backslash = FALSE;
+
+	int idx = 0;
+	for ( ; *p; p++) {
+		if (*p == ifs) {
+			*p = 0;
+			if (saw_backslash) {
+				mlr_unbackslash_tsv_in_place(value);
+				saw_backslash = FALSE;
+			}
+			char* key = low_int_to_string(++idx, &free_flags);
+			lrec_put(prec, key, value, free_flags);
+			value = p + 1;
+		} else if (*p == '\\') {
+			saw_backslash = TRUE;
+		}
+	}
+	if (saw_backslash)
+		mlr_unbackslash_tsv_in_place(value);
+	char* key = low_int_to_string(++idx, &free_flags);
+	lrec_put(prec, key, value, free_flags);
+
+	return prec;
+}
@@ -62,6 +62,11 @@ lrec_reader_t* lrec_reader_stdio_xtab_alloc(char* ifs, char* ips, int allow_repe
 	plrec_reader->pclose_func   = file_reader_stdio_vclose;
 	plrec_reader->pprocess_func = lrec_reader_stdio_xtab_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_xtab_sof;
+	plrec_reader->pcount_func   = NULL;
+	plrec_reader->ptell_func    = NULL;
+	plrec_reader->pseek_func    = NULL;
+	plrec_reader->pseek_tail_func = NULL;
+	plrec_reader->preread_func    = NULL;
 	plrec_reader->pfree_func    = lrec_reader_stdio_xtab_free;
 
 	return plrec_reader;
@@ -1,3 +1,5 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include "cli/comment_handling.h"
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
@@ -11,17 +13,21 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 	} else if (streq(popts->ifile_fmt, "dkvp")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 		else
 			return lrec_reader_stdio_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 	} else if (streq(popts->ifile_fmt, "csv")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_csv_alloc(popts->irs, popts->ifs, popts->use_implicit_csv_header,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 		else
 			return lrec_reader_stdio_csv_alloc(popts->irs, popts->ifs, popts->use_implicit_csv_header,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 	} else if (streq(popts->ifile_fmt, "csvlite")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_csvlite_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
@@ -29,13 +35,28 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 		else
 			return lrec_reader_stdio_csvlite_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
 				popts->use_implicit_csv_header, popts->comment_handling, popts->comment_string);
+	} else if (streq(popts->ifile_fmt, "tsv")) {
+		if (strlen(popts->ifs) != 1) {
+			fprintf(stderr, "%s: IFS for TSV format must be single-character; got \"%s\".\n",
+				MLR_GLOBALS.bargv0, popts->ifs);
+			exit(1);
+		}
+		// The mmap reader handles only single-character IRS.
+		if (popts->use_mmap_for_read && (streq(popts->irs, "auto") || strlen(popts->irs) == 1))
+			return lrec_reader_mmap_tsv_alloc(popts->irs, popts->ifs[0], popts->use_implicit_csv_header,
+				popts->comment_handling, popts->comment_string);
+		else
+			return lrec_reader_stdio_tsv_alloc(popts->irs, popts->ifs[0], popts->use_implicit_csv_header,
+				popts->comment_handling, popts->comment_string);
 	} else if (streq(popts->ifile_fmt, "nidx")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_nidx_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 		else
 			return lrec_reader_stdio_nidx_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string,
+				popts->pfield_projection, popts->precord_predicate);
 	} else if (streq(popts->ifile_fmt, "xtab")) {
 		// Use stdio-xtab for comment handling; not supported in the mmap-xtab reader.
 		if (popts->use_mmap_for_read && popts->comment_string == NULL)
@@ -45,12 +66,27 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 			return lrec_reader_stdio_xtab_alloc(popts->ifs, popts->ips, popts->allow_repeat_ips,
 				popts->comment_handling, popts->comment_string);
 	} else if (streq(popts->ifile_fmt, "json")) {
-		if (popts->use_mmap_for_read)
+		if (popts->use_mmap_for_read && popts->use_json_index)
+			return lrec_reader_mmap_json_indexed_alloc(popts->input_json_flatten_separator,
+				popts->json_array_ingest, popts->irs, popts->comment_handling, popts->comment_string);
+		else if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_json_alloc(popts->input_json_flatten_separator,
 				popts->json_array_ingest, popts->irs, popts->comment_handling, popts->comment_string);
 		else
 			return lrec_reader_stdio_json_alloc(popts->input_json_flatten_separator,
 				popts->json_array_ingest, popts->irs, popts->comment_handling, popts->comment_string);
+	} else if (streq(popts->ifile_fmt, "bin")) {
+		if (popts->use_mmap_for_read)
+			return lrec_reader_mmap_bin_alloc(popts->pfield_projection, popts->precord_predicate);
+		else
+			return lrec_reader_stdio_bin_alloc(popts->pfield_projection, popts->precord_predicate);
+	} else if (streq(popts->ifile_fmt, "col")) {
+		if (popts->use_mmap_for_read)
+			return lrec_reader_mmap_col_alloc(popts->pfield_projection, popts->precord_predicate,
+				popts->pnumber_sink);
+		else
+			return lrec_reader_stdio_col_alloc(popts->pfield_projection, popts->precord_predicate,
+				popts->pnumber_sink);
 	} else {
 		return NULL;
 	}
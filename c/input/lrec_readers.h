@@ -2,6 +2,7 @@
 #define LREC_READERS_H
 #include "cli/mlrcli.h"
 #include "cli/comment_handling.h"
+#include "containers/hss.h"
 #include "input/lrec_reader.h"
 
 // ----------------------------------------------------------------
@@ -13,40 +14,93 @@ lrec_reader_t*  lrec_reader_alloc_or_die(cli_reader_opts_t* popts);
 lrec_reader_t* lrec_reader_gen_alloc(char* field_name, unsigned long long start, unsigned long long stop, unsigned long long step);
 lrec_reader_t* lrec_reader_stdio_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
-lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_header,
+lrec_reader_t* lrec_reader_stdio_tsv_alloc(char* irs, char ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_header,
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_stdio_xtab_alloc(char* ifs, char* ips, int allow_repeat_ips,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_stdio_bin_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
+lrec_reader_t* lrec_reader_stdio_col_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate,
+	lrec_reader_number_sink_t* pnumber_sink);
 lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator, json_array_ingest_t json_array_ingest, char* line_term,
 	comment_handling_t comment_handling, char* comment_string);
 
 lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
-lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
+lrec_reader_t* lrec_reader_mmap_tsv_alloc(char* irs, char ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string,
+	hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
 lrec_reader_t* lrec_reader_mmap_xtab_alloc(char* ifs, char* ips, int allow_repeat_ips,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_mmap_bin_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate);
+lrec_reader_t* lrec_reader_mmap_col_alloc(hss_t* pfield_projection, lrec_reader_predicate_t* precord_predicate,
+	lrec_reader_number_sink_t* pnumber_sink);
 lrec_reader_t* lrec_reader_mmap_json_alloc(char* input_json_flatten_separator, json_array_ingest_t json_array_ingest, char* line_term,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_mmap_json_indexed_alloc(char* input_json_flatten_separator,
+	json_array_ingest_t json_array_ingest, char* line_term,
+	comment_handling_t comment_handling, char* comment_string);
 
 lrec_reader_t* lrec_reader_in_memory_alloc(sllv_t* precords);
 
+// ----------------------------------------------------------------
+// For readers supporting projection pushdown: like lrec_put, except that fields not named in the
+// projection aren't attached to the record, and their reader-allocated keys/values are freed right
+// away. A null projection keeps all fields.
+static inline void lrec_put_projected(lrec_t* prec, hss_t* pfield_projection, char* key, char* value,
+	char free_flags)
+{
+	if (pfield_projection == NULL || hss_has(pfield_projection, key)) {
+		lrec_put(prec, key, value, free_flags);
+	} else {
+		if (free_flags & FREE_ENTRY_KEY)
+			free(key);
+		if (free_flags & FREE_ENTRY_VALUE)
+			free(value);
+	}
+}
+
+// ----------------------------------------------------------------
+// For readers supporting predicate pushdown: returns TRUE if the record is to go on to the mapper
+// chain. Otherwise frees it, counting it in NR and FNR as though it had gone there and been dropped.
+static inline int lrec_reader_predicate_keeps(lrec_reader_predicate_t* ppredicate, lrec_t* prec,
+	context_t* pctx)
+{
+	if (ppredicate == NULL || ppredicate->ptest_func(ppredicate->pvstate, prec, pctx))
+		return TRUE;
+	lrec_free(prec);
+	pctx->nr++;
+	pctx->fnr++;
+	return FALSE;
+}
+
 // ----------------------------------------------------------------
 // These entry points are made public for unit test
 
-lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs);
-lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs);
+lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs, hss_t* pfield_projection);
+lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs,
+	hss_t* pfield_projection);
 
-lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs);
-lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int ifslen, int ipslen, int allow_repeat_ifs);
+lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs,
+	hss_t* pfield_projection);
+lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int ifslen, int ipslen, int allow_repeat_ifs,
+	hss_t* pfield_projection);
 
 slls_t* split_csv_header_line(char* line, char ifs, int allow_repeat_ifs);
 
@@ -62,6 +116,11 @@ lrec_t* lrec_parse_stdio_csvlite_data_line_single_ifs_implicit_header(header_kee
 lrec_t* lrec_parse_stdio_csvlite_data_line_multi_ifs_implicit_header(header_keeper_t* pheader_keeper, char* filename, long long ilno,
 	char* data_line, char* ifs, int ifslen, int allow_repeat_ifs);
 
+slls_t* split_tsv_header_line(char* line, char ifs);
+lrec_t* lrec_parse_stdio_tsv_data_line(header_keeper_t* pheader_keeper, char* filename, long long ilno,
+	char* data_line, char ifs);
+lrec_t* lrec_parse_stdio_tsv_data_line_implicit_header(char* data_line, char ifs);
+
 lrec_t* lrec_parse_stdio_xtab_single_ips(slls_t* pxtab_lines, char ips, int allow_repeat_ips);
 lrec_t* lrec_parse_stdio_xtab_multi_ips(slls_t* pxtab_lines, char* ips, int ipslen, int allow_repeat_ips);
 
@@ -272,6 +272,138 @@ static int populate_from_nested_array(lrec_t* prec, json_value_t* pjson_array, c
 	return TRUE;
 }
 
+// ----------------------------------------------------------------
+#define JSON_FLATTENER_INIT_SIZE 1024
+
+json_flattener_t* json_flattener_alloc(char* flatten_sep) {
+	json_flattener_t* pflattener = mlr_malloc_or_die(sizeof(json_flattener_t));
+	pflattener->flatten_sep        = flatten_sep;
+	pflattener->flatten_sep_length = strlen(flatten_sep);
+	pflattener->buf_alloc          = JSON_FLATTENER_INIT_SIZE;
+	pflattener->buf                = mlr_malloc_or_die(pflattener->buf_alloc);
+	pflattener->buf_length         = 0;
+	pflattener->pending_start      = 0;
+	pflattener->offsets_alloc      = 64;
+	pflattener->offsets            = mlr_malloc_or_die(pflattener->offsets_alloc * sizeof(int));
+	pflattener->num_offsets        = 0;
+	pflattener->prefix_alloc       = 64;
+	pflattener->prefix             = mlr_malloc_or_die(pflattener->prefix_alloc);
+	pflattener->prefix_length      = 0;
+	return pflattener;
+}
+
+void json_flattener_free(json_flattener_t* pflattener) {
+	if (pflattener == NULL)
+		return;
+	free(pflattener->buf);
+	free(pflattener->offsets);
+	free(pflattener->prefix);
+	free(pflattener);
+}
+
+void _json_flattener_enlarge(json_flattener_t* pflattener, int more) {
+	while (pflattener->buf_length + more > pflattener->buf_alloc)
+		pflattener->buf_alloc *= 2;
+	pflattener->buf = mlr_realloc_or_die(pflattener->buf, pflattener->buf_alloc);
+}
+
+static void json_flattener_push_offset(json_flattener_t* pflattener, int offset) {
+	if (pflattener->num_offsets >= pflattener->offsets_alloc) {
+		pflattener->offsets_alloc *= 2;
+		pflattener->offsets = mlr_realloc_or_die(pflattener->offsets, pflattener->offsets_alloc * sizeof(int));
+	}
+	pflattener->offsets[pflattener->num_offsets++] = offset;
+}
+
+// ----------------------------------------------------------------
+void json_flattener_begin_key(json_flattener_t* pflattener) {
+	pflattener->pending_start = pflattener->buf_length;
+	if (pflattener->prefix_length > 0)
+		json_flattener_append_chars(pflattener, pflattener->prefix, pflattener->prefix_length);
+}
+
+// Array-as-map keys are the zero-up array indices.
+void json_flattener_put_index_key(json_flattener_t* pflattener, int idx) {
+	char digits[32];
+	int n = sprintf(digits, "%d", idx);
+	json_flattener_begin_key(pflattener);
+	json_flattener_append_chars(pflattener, digits, n);
+	json_flattener_end_key(pflattener);
+}
+
+void json_flattener_end_key(json_flattener_t* pflattener) {
+	json_flattener_append_char(pflattener, 0);
+	json_flattener_push_offset(pflattener, pflattener->pending_start);
+	pflattener->pending_start = pflattener->buf_length;
+}
+
+void json_flattener_end_value(json_flattener_t* pflattener) {
+	json_flattener_append_char(pflattener, 0);
+	json_flattener_push_offset(pflattener, pflattener->pending_start);
+}
+
+void json_flattener_put_value(json_flattener_t* pflattener, char* value) {
+	json_flattener_append_chars(pflattener, value, strlen(value) + 1);
+	json_flattener_push_offset(pflattener, pflattener->pending_start);
+}
+
+// ----------------------------------------------------------------
+int json_flattener_push_prefix(json_flattener_t* pflattener) {
+	int saved_prefix_length = pflattener->prefix_length;
+	int key_offset = pflattener->offsets[--pflattener->num_offsets];
+	int key_length = pflattener->buf_length - key_offset - 1; // Including any existing prefix
+
+	int new_length = key_length + pflattener->flatten_sep_length;
+	if (new_length > pflattener->prefix_alloc) {
+		while (new_length > pflattener->prefix_alloc)
+			pflattener->prefix_alloc *= 2;
+		pflattener->prefix = mlr_realloc_or_die(pflattener->prefix, pflattener->prefix_alloc);
+	}
+	memcpy(pflattener->prefix, &pflattener->buf[key_offset], key_length);
+	memcpy(&pflattener->prefix[key_length], pflattener->flatten_sep, pflattener->flatten_sep_length);
+	pflattener->prefix_length = new_length;
+
+	pflattener->buf_length = key_offset;
+	return saved_prefix_length;
+}
+
+void json_flattener_pop_prefix(json_flattener_t* pflattener, int saved_prefix_length) {
+	pflattener->prefix_length = saved_prefix_length;
+}
+
+// ----------------------------------------------------------------
+int json_flattener_mark(json_flattener_t* pflattener) {
+	return pflattener->num_offsets;
+}
+
+void json_flattener_rewind(json_flattener_t* pflattener, int mark) {
+	pflattener->num_offsets = mark;
+	if (mark == 0) {
+		pflattener->buf_length = 0;
+	} else {
+		char* last_value = &pflattener->buf[pflattener->offsets[mark-1]];
+		pflattener->buf_length = pflattener->offsets[mark-1] + strlen(last_value) + 1;
+	}
+}
+
+// ----------------------------------------------------------------
+lrec_t* json_flattener_finish(json_flattener_t* pflattener) {
+	char* backing = NULL;
+	if (pflattener->buf_length > 0) {
+		backing = mlr_malloc_or_die(pflattener->buf_length);
+		memcpy(backing, pflattener->buf, pflattener->buf_length);
+	}
+	lrec_t* prec = lrec_csvlite_alloc(backing);
+	for (int i = 0; i + 1 < pflattener->num_offsets; i += 2) {
+		lrec_put(prec, &backing[pflattener->offsets[i]], &backing[pflattener->offsets[i+1]], NO_FREE);
+	}
+
+	pflattener->buf_length    = 0;
+	pflattener->num_offsets   = 0;
+	pflattener->prefix_length = 0;
+	return prec;
+}
+
 // ----------------------------------------------------------------
 // * The buffer is an entire JSON blob, e.g. contents from stdio read or mmap; peof-psof is the file size so peof is one
 //   byte *after* the last valid file byte.
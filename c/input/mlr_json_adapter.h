@@ -3,6 +3,7 @@
 
 #include "cli/comment_handling.h"
 #include "input/json_parser.h"
+#include "lib/mlrutil.h"
 #include "containers/lrec.h"
 
 // Given parsed JSON, constructs a list of lrecs with string values pointing into the parsed JSON.
@@ -16,6 +17,67 @@
 int reference_json_objects_as_lrecs(sllv_t* precords, json_value_t* ptop_level_json, char* flatten_sep,
 	json_array_ingest_t json_array_ingest);
 
+// ----------------------------------------------------------------
+// Flattening without a parse tree, for the streaming JSON reader: as the parser walks one top-level
+// object it hands over keys and scalar values, and nested keys are prefixed with the flatten
+// separator as above. Keys and values are accumulated in a scratch buffer as "key\0value\0..." and
+// the finished record is backed by a single allocation holding all of its strings.
+//
+// Usage for a leaf: begin_key (or put_index_key), append the name, end_key; append the value,
+// end_value. For a nested object or array-as-map after end_key: push_prefix, then the nested
+// leaves, then pop_prefix.
+typedef struct _json_flattener_t {
+	char*  flatten_sep;
+	int    flatten_sep_length;
+
+	char*  buf;
+	int    buf_length;
+	int    buf_alloc;
+	int    pending_start;
+
+	int*   offsets; // key, value, key, value, ... into buf
+	int    num_offsets;
+	int    offsets_alloc;
+
+	char*  prefix;
+	int    prefix_length;
+	int    prefix_alloc;
+} json_flattener_t;
+
+json_flattener_t* json_flattener_alloc(char* flatten_sep);
+void json_flattener_free(json_flattener_t* pflattener);
+
+void _json_flattener_enlarge(json_flattener_t* pflattener, int more); // private method
+
+static inline void json_flattener_append_char(json_flattener_t* pflattener, char c) {
+	if (pflattener->buf_length >= pflattener->buf_alloc)
+		_json_flattener_enlarge(pflattener, 1);
+	pflattener->buf[pflattener->buf_length++] = c;
+}
+static inline void json_flattener_append_chars(json_flattener_t* pflattener, char* p, int n) {
+	if (pflattener->buf_length + n > pflattener->buf_alloc)
+		_json_flattener_enlarge(pflattener, n);
+	memcpy(&pflattener->buf[pflattener->buf_length], p, n);
+	pflattener->buf_length += n;
+}
+
+void json_flattener_begin_key(json_flattener_t* pflattener);
+void json_flattener_put_index_key(json_flattener_t* pflattener, int idx);
+void json_flattener_end_key(json_flattener_t* pflattener);
+void json_flattener_end_value(json_flattener_t* pflattener);
+void json_flattener_put_value(json_flattener_t* pflattener, char* value);
+
+// The key just ended becomes part of the prefix. The return value is passed to pop_prefix.
+int  json_flattener_push_prefix(json_flattener_t* pflattener);
+void json_flattener_pop_prefix(json_flattener_t* pflattener, int saved_prefix_length);
+
+// For skipping values: mark before the key, and rewind to drop everything since.
+int  json_flattener_mark(json_flattener_t* pflattener);
+void json_flattener_rewind(json_flattener_t* pflattener, int mark);
+
+// Returns the record and resets for the next one.
+lrec_t* json_flattener_finish(json_flattener_t* pflattener);
+
 // * The buffer is an entire JSON blob, e.g. contents from stdio read or mmap; peof-psof is the file size so peof is one
 //   byte *after* the last valid file byte.
 // * The buffer is not assumed to be null-terminated.
@@ -0,0 +1,259 @@
+// ================================================================
+// Miller's binary row format, for intermediate files between Miller runs
+// (--ibin/--obin). A stream is a sequence of items, each starting with a
+// one-byte tag. Counts and lengths are unsigned LEB128 varints.
+//
+// * Stream header: 'M' 'L' 'R' 'B' then a version byte. Written at the start
+//   of each output stream; on input it may recur (e.g. from concatenated
+//   files) and each one starts a fresh schema dictionary.
+//
+// * The other items have the layout
+//     tag {varint a} {varint payload length} {payload}
+//   so that readers can step over any item without decoding it:
+//   o 'S': schema definition. a is the schema id, numbered from 0 in order of
+//     definition; the payload is the number of fields, then the field names
+//     as strings.
+//   o 'R': record. a is the id of its schema; the payload is one value per
+//     field name in the schema.
+//   o 'K': record carrying its own field names. a is the number of fields;
+//     the payload is alternating field names and values.
+//
+// * Strings (field names, and string values) are a varint length, the bytes,
+//   then a NUL, so that the mmap reader can point records' keys and values
+//   right at the file contents.
+//
+// * A value starts with a varint h. If h is even, it's a string of length
+//   h/2. Otherwise it's a typed number, written only where it reproduces the
+//   original text exactly:
+//   o h == 1: decimal integer, as a zigzag varint.
+//   o h == 3: fixed-point decimal: a byte with the number of digits after the
+//     decimal point, then the IEEE-754 double, little-endian.
+// ================================================================
+
+#ifndef BIN_FORMAT_H
+#define BIN_FORMAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "lib/mlrutil.h"
+#include "lib/free_flags.h"
+
+#define MLR_BIN_VERSION 1
+#define MLR_BIN_STREAM_HEADER "MLRB\001"
+#define MLR_BIN_STREAM_HEADER_LENGTH 5
+
+#define MLR_BIN_TAG_STREAM_HEADER 'M'
+#define MLR_BIN_TAG_SCHEMA        'S'
+#define MLR_BIN_TAG_RECORD        'R'
+#define MLR_BIN_TAG_KEYED_RECORD  'K'
+
+#define MLR_BIN_VALUE_INT    1ULL
+#define MLR_BIN_VALUE_DOUBLE 3ULL
+
+// Enough for the longest fixed-point decimal written as a typed number.
+#define MLR_BIN_MAX_DECIMALS 17
+#define MLR_BIN_MAX_NUMBER_STRING_LENGTH 64
+
+// ----------------------------------------------------------------
+// Writes the varint into p, which must have room for ten bytes, and returns the number of bytes written.
+static inline int mlr_bin_put_varint(unsigned char* p, unsigned long long value) {
+	int n = 0;
+	while (value >= 0x80) {
+		p[n++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	p[n++] = (unsigned char)value;
+	return n;
+}
+
+// Decodes a varint at *pp, not reading past end. Returns FALSE if it's truncated or too long.
+static inline int mlr_bin_get_varint(unsigned char** pp, unsigned char* end, unsigned long long* pvalue) {
+	unsigned char* p = *pp;
+	unsigned long long value = 0ULL;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (p >= end)
+			return FALSE;
+		unsigned char c = *p++;
+		value |= (unsigned long long)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*pp = p;
+			*pvalue = value;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Decodes a NUL-terminated string at *pp, of the given length, not reading past end.
+static inline char* mlr_bin_get_string(unsigned char** pp, unsigned char* end, unsigned long long length) {
+	unsigned char* p = *pp;
+	if (length >= (unsigned long long)(end - p) || p[length] != 0)
+		return NULL;
+	*pp = p + length + 1;
+	return (char*)p;
+}
+
+static inline unsigned long long mlr_bin_zigzag(long long value) {
+	return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+static inline long long mlr_bin_unzigzag(unsigned long long value) {
+	return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+// ----------------------------------------------------------------
+// Typed numbers
+
+// True if the string is an integer as printed by "%lld": no plus sign, leading zeroes, or "-0".
+static inline int mlr_bin_is_canonical_int(char* s, long long* pvalue) {
+	char* p = (*s == '-') ? s + 1 : s;
+	if (*p < '0' || *p > '9' || (*p == '0' && (p[1] != 0 || p != s)))
+		return FALSE;
+	for (char* q = p; *q; q++)
+		if (*q < '0' || *q > '9')
+			return FALSE;
+	if (strlen(p) > 19)
+		return FALSE;
+	errno = 0;
+	*pvalue = strtoll(s, NULL, 10);
+	return errno == 0;
+}
+
+// Formats a fixed-point decimal as the writer saw it. Returns the length.
+static inline int mlr_bin_format_decimal(char* buf, double value, int decimals) {
+	return snprintf(buf, MLR_BIN_MAX_NUMBER_STRING_LENGTH, "%.*lf", decimals, value);
+}
+
+// True if the string is a fixed-point decimal which mlr_bin_format_decimal reproduces exactly.
+static inline int mlr_bin_is_exact_decimal(char* s, int length, double* pvalue, int* pdecimals) {
+	if (length >= MLR_BIN_MAX_NUMBER_STRING_LENGTH)
+		return FALSE;
+	char* dot = strchr(s, '.');
+	if (dot == NULL)
+		return FALSE;
+	int decimals = length - (dot - s) - 1;
+	if (decimals < 1 || decimals > MLR_BIN_MAX_DECIMALS)
+		return FALSE;
+	char* end = NULL;
+	double value = strtod(s, &end);
+	if (end != s + length)
+		return FALSE;
+	char buf[MLR_BIN_MAX_NUMBER_STRING_LENGTH];
+	if (mlr_bin_format_decimal(buf, value, decimals) != length || memcmp(buf, s, length) != 0)
+		return FALSE;
+	*pvalue = value;
+	*pdecimals = decimals;
+	return TRUE;
+}
+
+static inline void mlr_bin_put_double(unsigned char* p, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 8; i++)
+		p[i] = (unsigned char)(bits >> (8 * i));
+}
+
+static inline double mlr_bin_get_double(unsigned char* p) {
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++)
+		bits |= (uint64_t)p[i] << (8 * i);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// ----------------------------------------------------------------
+// Decoding item payloads. These check bounds and structure, for the sake of truncated or corrupt files,
+// and return NULL/FALSE on failure.
+
+// Decodes a value at *pp, not reading past end. A string is returned as a pointer into the buffer. A typed
+// number is formatted into a newly allocated string, with FREE_ENTRY_VALUE set in *pfree_flags.
+static inline char* mlr_bin_get_value(unsigned char** pp, unsigned char* end, char* pfree_flags) {
+	unsigned long long h;
+	if (!mlr_bin_get_varint(pp, end, &h))
+		return NULL;
+	if (!(h & 1ULL)) {
+		*pfree_flags = NO_FREE;
+		return mlr_bin_get_string(pp, end, h >> 1);
+	} else if (h == MLR_BIN_VALUE_INT) {
+		unsigned long long zigzag;
+		if (!mlr_bin_get_varint(pp, end, &zigzag))
+			return NULL;
+		*pfree_flags = FREE_ENTRY_VALUE;
+		return mlr_alloc_string_from_ll(mlr_bin_unzigzag(zigzag));
+	} else if (h == MLR_BIN_VALUE_DOUBLE) {
+		unsigned char* p = *pp;
+		if (end - p < 9 || p[0] > MLR_BIN_MAX_DECIMALS)
+			return NULL;
+		char* s = mlr_malloc_or_die(MLR_BIN_MAX_NUMBER_STRING_LENGTH);
+		mlr_bin_format_decimal(s, mlr_bin_get_double(&p[1]), p[0]);
+		*pp = p + 9;
+		*pfree_flags = FREE_ENTRY_VALUE;
+		return s;
+	} else {
+		return NULL;
+	}
+}
+
+// As above but only checks the value, for reading without building records.
+static inline int mlr_bin_skip_value(unsigned char** pp, unsigned char* end) {
+	unsigned long long h;
+	if (!mlr_bin_get_varint(pp, end, &h))
+		return FALSE;
+	if (!(h & 1ULL)) {
+		return mlr_bin_get_string(pp, end, h >> 1) != NULL;
+	} else if (h == MLR_BIN_VALUE_INT) {
+		unsigned long long zigzag;
+		return mlr_bin_get_varint(pp, end, &zigzag);
+	} else if (h == MLR_BIN_VALUE_DOUBLE) {
+		if (end - *pp < 9 || **pp > MLR_BIN_MAX_DECIMALS)
+			return FALSE;
+		*pp += 9;
+		return TRUE;
+	} else {
+		return FALSE;
+	}
+}
+
+// Decodes a schema payload. On success the caller should free *pfield_names, whose elements point into the
+// payload.
+static inline int mlr_bin_get_schema(unsigned char* p, unsigned char* end, unsigned long long* pnum_fields,
+	char*** pfield_names)
+{
+	unsigned long long num_fields;
+	if (!mlr_bin_get_varint(&p, end, &num_fields))
+		return FALSE;
+	// Each name takes at least two bytes, which bounds the allocation for a corrupt count.
+	if (num_fields > (unsigned long long)(end - p) / 2)
+		return FALSE;
+	char** field_names = mlr_malloc_or_die((num_fields + 1) * sizeof(char*));
+	for (unsigned long long i = 0; i < num_fields; i++) {
+		unsigned long long length;
+		if (!mlr_bin_get_varint(&p, end, &length) || (field_names[i] = mlr_bin_get_string(&p, end, length)) == NULL) {
+			free(field_names);
+			return FALSE;
+		}
+	}
+	if (p != end) {
+		free(field_names);
+		return FALSE;
+	}
+	// Readers append schema records' fields without checking for duplicate keys, so check here, once per
+	// schema. The writer never produces duplicates.
+	for (unsigned long long i = 1; i < num_fields; i++) {
+		for (unsigned long long j = 0; j < i; j++) {
+			if (streq(field_names[i], field_names[j])) {
+				free(field_names);
+				return FALSE;
+			}
+		}
+	}
+	*pnum_fields = num_fields;
+	*pfield_names = field_names;
+	return TRUE;
+}
+
+#endif // BIN_FORMAT_H
@@ -0,0 +1,89 @@
+// ================================================================
+// Word-at-a-time byte classification, for the block tokenizers in the mmap
+// readers. On little-endian GCC/Clang targets, MLR_BYTE_MASKS_USE_WORDS is
+// defined and a 64-bit word can be classified all at once: for each of its 8
+// bytes, a byte equal to c becomes 0x80 and anything else becomes 0x00
+// (exactly, with no false positives from borrows), then the eight high bits
+// are gathered into one byte by a multiply, with bit i for byte i. Elsewhere,
+// callers use a plain byte loop.
+//
+// Also here: separator search for the readers' multi-character-separator
+// paths, which look for the separators' first bytes a word at a time and then
+// check the rest of the separator only where one of those is found.
+// ================================================================
+
+#ifndef BYTE_MASKS_H
+#define BYTE_MASKS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define MLR_BYTE_MASKS_USE_WORDS
+#endif
+
+#ifdef MLR_BYTE_MASKS_USE_WORDS
+#define BYTES_01 0x0101010101010101ULL
+#define BYTES_7F 0x7f7f7f7f7f7f7f7fULL
+
+// c_repeated is BYTES_01 times the byte to match.
+static inline uint64_t bytes_equal_to(uint64_t x, uint64_t c_repeated) {
+	uint64_t y = x ^ c_repeated;
+	uint64_t t = (y & BYTES_7F) + BYTES_7F;
+	return ~(t | y | BYTES_7F);
+}
+
+static inline uint64_t gather_high_bits(uint64_t m) {
+	return ((m >> 7) * 0x0102040810204080ULL) >> 56;
+}
+
+static inline int lowest_set_bit(uint64_t m) {
+	return __builtin_ctzll(m);
+}
+#else
+static inline int lowest_set_bit(uint64_t m) {
+	int i = 0;
+	while (!(m & 1ULL)) {
+		m >>= 1;
+		i++;
+	}
+	return i;
+}
+#endif
+
+// ----------------------------------------------------------------
+// Returns the first p at or after the given one, and before end, where *p is a, b, c or NUL -- where
+// the line parsers need to look, for separators starting with those bytes or the end of a C string --
+// or end if there's none. Pass the same byte more than once if there are fewer than three.
+static inline char* find_sep_candidate(char* p, char* end, char a, char b, char c) {
+#ifdef MLR_BYTE_MASKS_USE_WORDS
+	uint64_t a_repeated = BYTES_01 * (unsigned char)a;
+	uint64_t b_repeated = BYTES_01 * (unsigned char)b;
+	uint64_t c_repeated = BYTES_01 * (unsigned char)c;
+	while (end - p >= 8) {
+		uint64_t x;
+		memcpy(&x, p, 8);
+		uint64_t m = bytes_equal_to(x, a_repeated) | bytes_equal_to(x, b_repeated)
+			| bytes_equal_to(x, c_repeated) | bytes_equal_to(x, 0ULL);
+		if (m != 0ULL)
+			return p + (lowest_set_bit(m) >> 3);
+		p += 8;
+	}
+#endif
+	for ( ; p < end; p++)
+		if (*p == a || *p == b || *p == c || *p == 0)
+			break;
+	return p;
+}
+
+// Whether the separator is at p, not running past end. Two-byte separators, chiefly CRLF, are the
+// common multi-character case and are checked without a call.
+static inline int sep_matches(char* p, char* end, char* sep, int seplen) {
+	if (*p != sep[0])
+		return 0;
+	if (seplen == 2)
+		return (end - p) >= 2 && p[1] == sep[1];
+	return (end - p) >= seplen && memcmp(p + 1, sep + 1, seplen - 1) == 0;
+}
+
+#endif // BYTE_MASKS_H
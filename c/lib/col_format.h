@@ -0,0 +1,220 @@
+// ================================================================
+// Miller's columnar format, for data sets which are written once and then
+// analyzed many times (--icol/--ocol). Records are stored in row groups of up
+// to a few tens of thousands of records having the same field names, and
+// within a row group each field's values are stored together in a column
+// block, typed where that can be done losslessly. Readers decode only the
+// columns they need, and can skip whole row groups using per-column minima
+// and maxima.
+//
+// Varints, zigzag integers, NUL-terminated strings and doubles are encoded as
+// in Miller's binary row format: see lib/bin_format.h.
+//
+// * Stream header: 'M' 'L' 'R' 'C' then a version byte. It may recur, e.g.
+//   in concatenated files.
+//
+// * Row group: 'G' {varint number of rows} {varint payload length} {payload}.
+//   The payload is the number of columns as a varint, then a directory entry
+//   per column, then the column blocks in the same order. A directory entry
+//   is the field name as a string, a type byte, the block length as a varint,
+//   then the column's statistics:
+//   o 'I': integers, written by "%lld" in the input. The block is a zigzag
+//     varint per row; the statistics are the minimum and maximum, likewise.
+//   o 'F': fixed-point decimals, and integers of magnitude up to 2^53. The
+//     block is, per row, a byte with the number of digits after the decimal
+//     point (0 for integers) then the double; the statistics are the
+//     minimum and maximum as doubles.
+//   o 'S': anything else. The block is a string per row; no statistics.
+// ================================================================
+
+#ifndef COL_FORMAT_H
+#define COL_FORMAT_H
+
+#include <math.h>
+#include "lib/bin_format.h"
+
+#define MLR_COL_VERSION 1
+#define MLR_COL_STREAM_HEADER "MLRC\001"
+#define MLR_COL_STREAM_HEADER_LENGTH 5
+
+#define MLR_COL_TAG_STREAM_HEADER 'M'
+#define MLR_COL_TAG_ROW_GROUP     'G'
+
+#define MLR_COL_TYPE_INT    'I'
+#define MLR_COL_TYPE_FLOAT  'F'
+#define MLR_COL_TYPE_STRING 'S'
+
+#define MLR_COL_FLOAT_VALUE_LENGTH 9
+
+// Integers which doubles hold exactly.
+#define MLR_COL_MAX_EXACT_INT 9007199254740992LL
+
+// One column of a row group, as decoded from its directory entry.
+typedef struct _mlr_col_column_t {
+	char*          field_name;
+	char           type;
+	unsigned long long block_length;
+	unsigned char* block;
+	unsigned char* block_end;
+	long long      imin, imax; // for MLR_COL_TYPE_INT
+	double         fmin, fmax; // for MLR_COL_TYPE_FLOAT
+} mlr_col_column_t;
+
+// ----------------------------------------------------------------
+// A row-group payload starts with the number of columns. Each directory entry takes at least four bytes,
+// which bounds the number for a corrupt payload.
+static inline int mlr_col_get_num_columns(unsigned char** pp, unsigned char* end, unsigned long long* pnum_columns) {
+	return mlr_bin_get_varint(pp, end, pnum_columns) && *pnum_columns <= (unsigned long long)(end - *pp) / 4;
+}
+
+// Decodes the rest of a row-group payload's directory into the caller's array. Returns FALSE if the
+// payload is corrupt, including if field names are repeated.
+static inline int mlr_col_get_directory(unsigned char* p, unsigned char* end, unsigned long long num_columns,
+	mlr_col_column_t* columns)
+{
+	unsigned long long block_lengths_sum = 0ULL;
+	for (unsigned long long i = 0; i < num_columns; i++) {
+		mlr_col_column_t* pcolumn = &columns[i];
+		unsigned long long length, zmin, zmax;
+		if (!mlr_bin_get_varint(&p, end, &length) || (pcolumn->field_name = mlr_bin_get_string(&p, end, length)) == NULL)
+			return FALSE;
+		if (p >= end)
+			return FALSE;
+		pcolumn->type = *p++;
+		if (!mlr_bin_get_varint(&p, end, &pcolumn->block_length))
+			return FALSE;
+		switch (pcolumn->type) {
+		case MLR_COL_TYPE_INT:
+			if (!mlr_bin_get_varint(&p, end, &zmin) || !mlr_bin_get_varint(&p, end, &zmax))
+				return FALSE;
+			pcolumn->imin = mlr_bin_unzigzag(zmin);
+			pcolumn->imax = mlr_bin_unzigzag(zmax);
+			break;
+		case MLR_COL_TYPE_FLOAT:
+			if (end - p < 16)
+				return FALSE;
+			pcolumn->fmin = mlr_bin_get_double(p);
+			pcolumn->fmax = mlr_bin_get_double(p + 8);
+			p += 16;
+			break;
+		case MLR_COL_TYPE_STRING:
+			break;
+		default:
+			return FALSE;
+		}
+		// The blocks' lengths must add up to what's left once the directory is done.
+		if (pcolumn->block_length > (unsigned long long)(end - p))
+			return FALSE;
+		block_lengths_sum += pcolumn->block_length;
+		for (unsigned long long j = 0; j < i; j++)
+			if (streq(columns[j].field_name, pcolumn->field_name))
+				return FALSE;
+	}
+	if (block_lengths_sum != (unsigned long long)(end - p))
+		return FALSE;
+	for (unsigned long long i = 0; i < num_columns; i++) {
+		columns[i].block = p;
+		columns[i].block_end = p + columns[i].block_length;
+		p += columns[i].block_length;
+	}
+	return TRUE;
+}
+
+// Decodes the next value of a float column. Returns FALSE if it's corrupt.
+static inline int mlr_col_get_float(unsigned char** pp, unsigned char* end, double* pvalue, int* pdecimals) {
+	unsigned char* p = *pp;
+	if (end - p < MLR_COL_FLOAT_VALUE_LENGTH || p[0] > MLR_BIN_MAX_DECIMALS)
+		return FALSE;
+	*pdecimals = p[0];
+	*pvalue = mlr_bin_get_double(&p[1]);
+	*pp = p + MLR_COL_FLOAT_VALUE_LENGTH;
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+// Formatting numbers back to text is most of the cost of reading numeric columns, so it's done here
+// without printf where possible.
+
+// Writes the integer's digits into buf and returns their length.
+static inline int mlr_col_format_int(char* buf, long long value) {
+	char digits[24];
+	int n = 0;
+	unsigned long long u = (value < 0) ? -(unsigned long long)value : (unsigned long long)value;
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u > 0);
+	int length = 0;
+	if (value < 0)
+		buf[length++] = '-';
+	while (n > 0)
+		buf[length++] = digits[--n];
+	buf[length] = 0;
+	return length;
+}
+
+// As mlr_bin_format_decimal. Values written by the columnar writer are the nearest doubles to their
+// decimal text. Below 2^52 once scaled, no two decimals with this many places have the same nearest
+// double, so an integer which maps back to the value has the text's digits.
+static inline int mlr_col_format_decimal(char* buf, double value, int decimals) {
+	static const double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+	};
+	double scale = powers_of_ten[decimals];
+	double scaled = value * scale;
+	if (!(scaled > -MLR_COL_MAX_EXACT_INT/2 && scaled < MLR_COL_MAX_EXACT_INT/2))
+		return mlr_bin_format_decimal(buf, value, decimals);
+	long long k = llround(scaled);
+	if (decimals == 0)
+		return mlr_col_format_int(buf, k);
+	if ((double)k / scale != value || (k == 0 && signbit(value)))
+		return mlr_bin_format_decimal(buf, value, decimals);
+
+	char digits[24];
+	int n = 0;
+	unsigned long long u = (k < 0) ? -k : k;
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u > 0 || n <= decimals);
+	int length = 0;
+	if (k < 0)
+		buf[length++] = '-';
+	while (n > decimals)
+		buf[length++] = digits[--n];
+	buf[length++] = '.';
+	while (n > 0)
+		buf[length++] = digits[--n];
+	buf[length] = 0;
+	return length;
+}
+
+// Decodes the next value of a column as a string: pointing into the block for string columns, or
+// newly allocated for numbers, with FREE_ENTRY_VALUE set in *pfree_flags. Returns NULL if it's corrupt.
+static inline char* mlr_col_get_value(mlr_col_column_t* pcolumn, unsigned char** pp, char* pfree_flags) {
+	unsigned long long u;
+	if (pcolumn->type == MLR_COL_TYPE_STRING) {
+		if (!mlr_bin_get_varint(pp, pcolumn->block_end, &u))
+			return NULL;
+		*pfree_flags = NO_FREE;
+		return mlr_bin_get_string(pp, pcolumn->block_end, u);
+	} else if (pcolumn->type == MLR_COL_TYPE_INT) {
+		if (!mlr_bin_get_varint(pp, pcolumn->block_end, &u))
+			return NULL;
+		char* s = mlr_malloc_or_die(MLR_BIN_MAX_NUMBER_STRING_LENGTH);
+		mlr_col_format_int(s, mlr_bin_unzigzag(u));
+		*pfree_flags = FREE_ENTRY_VALUE;
+		return s;
+	} else {
+		double value;
+		int decimals;
+		if (!mlr_col_get_float(pp, pcolumn->block_end, &value, &decimals))
+			return NULL;
+		char* s = mlr_malloc_or_die(MLR_BIN_MAX_NUMBER_STRING_LENGTH);
+		mlr_col_format_decimal(s, value, decimals);
+		*pfree_flags = FREE_ENTRY_VALUE;
+		return s;
+	}
+}
+
+#endif // COL_FORMAT_H
@@ -0,0 +1,125 @@
+#include <math.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "lib/mlrsort.h"
+
+#define SIGN_BIT 0x8000000000000000ULL
+
+// Below this, merge-sort runs are insertion-sorted.
+#define INSERTION_SORT_THRESHOLD 12
+
+// ----------------------------------------------------------------
+// IEEE-754 doubles compare as sign-magnitude integers. Flipping the sign bit of non-negatives, and all the
+// bits of negatives, makes that unsigned two's-complement order.
+unsigned long long mlr_sort_key_from_double(double value) {
+	if (isnan(value))
+		return ~0ULL;
+	if (value == 0.0)
+		value = 0.0;
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & SIGN_BIT) ? ~bits : (bits | SIGN_BIT);
+}
+
+// Big-endian, zero-padded, so the integers compare as strcmp does on the prefixes.
+unsigned long long mlr_sort_key_from_string(char* value, int* pis_exact) {
+	unsigned long long key = 0ULL;
+	int i = 0;
+	for ( ; i < 8 && value[i] != 0; i++)
+		key |= (unsigned long long)(unsigned char)value[i] << (56 - 8 * i);
+	*pis_exact = (value[i] == 0);
+	return key;
+}
+
+// ----------------------------------------------------------------
+void mlr_radix_sort_pairs(mlr_sort_pair_t* ppairs, mlr_sort_pair_t* pscratch, size_t n) {
+	if (n < 2)
+		return;
+
+	// Histograms for all eight byte positions in one pass over the keys.
+	size_t (*counts)[256] = mlr_malloc_or_die(8 * sizeof(*counts));
+	memset(counts, 0, 8 * sizeof(*counts));
+	for (size_t i = 0; i < n; i++) {
+		unsigned long long key = ppairs[i].key;
+		for (int b = 0; b < 8; b++)
+			counts[b][(key >> (8 * b)) & 0xff]++;
+	}
+
+	mlr_sort_pair_t* pfrom = ppairs;
+	mlr_sort_pair_t* pto   = pscratch;
+	for (int b = 0; b < 8; b++) {
+		size_t* bcounts = counts[b];
+		if (bcounts[(pfrom[0].key >> (8 * b)) & 0xff] == n) // all the same in this byte
+			continue;
+		size_t offset = 0;
+		for (int d = 0; d < 256; d++) {
+			size_t count = bcounts[d];
+			bcounts[d] = offset;
+			offset += count;
+		}
+		for (size_t i = 0; i < n; i++)
+			pto[bcounts[(pfrom[i].key >> (8 * b)) & 0xff]++] = pfrom[i];
+		mlr_sort_pair_t* ptemp = pfrom;
+		pfrom = pto;
+		pto = ptemp;
+	}
+	if (pfrom != ppairs)
+		memcpy(ppairs, pfrom, n * sizeof(mlr_sort_pair_t));
+	free(counts);
+}
+
+// ----------------------------------------------------------------
+static void merge_sort_aux(char* base, char* temp, size_t n, size_t size,
+	mlr_sort_comparator_t* pcomparator, void* pvcontext)
+{
+	if (n < 2)
+		return;
+
+	if (n <= INSERTION_SORT_THRESHOLD) {
+		for (size_t i = 1; i < n; i++) {
+			size_t j = i;
+			if (pcomparator(base + (j-1) * size, base + j * size, pvcontext) <= 0)
+				continue;
+			memcpy(temp, base + i * size, size);
+			for ( ; j > 0 && pcomparator(base + (j-1) * size, temp, pvcontext) > 0; j--)
+				memcpy(base + j * size, base + (j-1) * size, size);
+			memcpy(base + j * size, temp, size);
+		}
+		return;
+	}
+
+	size_t nleft = n / 2;
+	char* right = base + nleft * size;
+	merge_sort_aux(base,  temp, nleft,     size, pcomparator, pvcontext);
+	merge_sort_aux(right, temp, n - nleft, size, pcomparator, pvcontext);
+	if (pcomparator(right - size, right, pvcontext) <= 0) // already in order
+		return;
+
+	// Merge the left half, moved out of the way, with the right half in place. Ties go to the left, for
+	// stability.
+	memcpy(temp, base, nleft * size);
+	char* pleft = temp;
+	char* pleft_end = temp + nleft * size;
+	char* pright = right;
+	char* pright_end = base + n * size;
+	char* pout = base;
+	while (pleft < pleft_end && pright < pright_end) {
+		if (pcomparator(pright, pleft, pvcontext) < 0) {
+			memcpy(pout, pright, size);
+			pright += size;
+		} else {
+			memcpy(pout, pleft, size);
+			pleft += size;
+		}
+		pout += size;
+	}
+	memcpy(pout, pleft, pleft_end - pleft);
+}
+
+void mlr_merge_sort(void* base, size_t n, size_t size, mlr_sort_comparator_t* pcomparator, void* pvcontext) {
+	if (n < 2)
+		return;
+	char* temp = mlr_malloc_or_die(((n + 1) / 2 + 1) * size);
+	merge_sort_aux(base, temp, n, size, pcomparator, pvcontext);
+	free(temp);
+}
@@ -0,0 +1,44 @@
+// ================================================================
+// Sorting helpers for verbs which sort many records by a few keys.
+//
+// * Sort keys are encoded once into unsigned 64-bit integers which compare, as
+//   integers, the same way as the keys they came from: doubles by bit
+//   transformation, strings by their first eight bytes. Descending order is
+//   the bitwise complement.
+//
+// * Arrays of key/index pairs are then sorted by LSD radix sort, which is
+//   stable, so sorting by the last key first and the first key last sorts by
+//   all of them.
+//
+// * Where the encoding of a string key isn't exact, i.e. for strings longer
+//   than eight bytes, runs of equal encoded keys are finished off by a stable
+//   merge sort with a full comparator. The comparator gets a context pointer
+//   rather than reading globals, so sorts may nest.
+// ================================================================
+
+#ifndef MLRSORT_H
+#define MLRSORT_H
+
+#include <stddef.h>
+
+typedef struct _mlr_sort_pair_t {
+	unsigned long long key;
+	size_t             index;
+} mlr_sort_pair_t;
+
+// NaNs sort after everything else, and -0.0 the same as 0.0.
+unsigned long long mlr_sort_key_from_double(double value);
+
+// Sets *pis_exact to whether the key determines the string, i.e. the string is no more than eight bytes.
+unsigned long long mlr_sort_key_from_string(char* value, int* pis_exact);
+
+// Stable sort by key. The scratch array must be as long as the pairs array. Byte positions in which all
+// keys agree are skipped.
+void mlr_radix_sort_pairs(mlr_sort_pair_t* ppairs, mlr_sort_pair_t* pscratch, size_t n);
+
+typedef int mlr_sort_comparator_t(const void* pva, const void* pvb, void* pvcontext);
+
+// Stable, unlike qsort, and reentrant, unlike qsort without the non-portable qsort_r.
+void mlr_merge_sort(void* base, size_t n, size_t size, mlr_sort_comparator_t* pcomparator, void* pvcontext);
+
+#endif // MLRSORT_H
@@ -478,6 +478,24 @@ char* mlr_alloc_unbackslash(char* input) {
 	return output;
 }
 
+// ----------------------------------------------------------------
+void mlr_unbackslash_tsv_in_place(char* input) {
+	char* pi = input;
+	char* po = input;
+	while (*pi) {
+		if (*pi == '\\') {
+			switch (pi[1]) {
+			case 't':  *(po++) = '\t';  pi += 2; continue;
+			case 'n':  *(po++) = '\n';  pi += 2; continue;
+			case 'r':  *(po++) = '\r';  pi += 2; continue;
+			case '\\': *(po++) = '\\'; pi += 2; continue;
+			}
+		}
+		*(po++) = *(pi++);
+	}
+	*po = 0;
+}
+
 // Does a strdup even if there's nothing to expand, so the caller can unconditionally
 // free what we return.
 char* mlr_alloc_double_backslash(char* input) {
@@ -139,6 +139,11 @@ int power_of_two_above(int n);
 // "\t", "\n", "\\" to single characters such as tab, newline, backslash, etc.
 char* mlr_alloc_unbackslash(char* input);
 
+// For TSV data: maps the two-character sequences "\t", "\n", "\r", and "\\" to
+// tab, newline, carriage return, and backslash respectively; other backslashes
+// are left as-is. Done in place since the output is never longer than the input.
+void mlr_unbackslash_tsv_in_place(char* input);
+
 // Miller DSL literals are unbackslashed: e.g. the two-character sequence "\t" is converted to a tab character, and
 // users need to type "\\t" to get a backslash followed by a t. Well and good, but the system regex library handles
 // backslashes not quite as I want. Namely, without this function,
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "lib/bin_format.h"
+#include "mapping/aggregate_state.h"
+
+#define STATE_MV_ABSENT 'a'
+#define STATE_MV_INT    'i'
+#define STATE_MV_FLOAT  'f'
+#define STATE_MV_STRING 's'
+
+// ----------------------------------------------------------------
+slls_t* aggregate_state_copy_argv(char** argv, int argb, int argc) {
+	slls_t* pverb_argv = slls_alloc();
+	for (int argi = argb; argi < argc; argi++)
+		slls_append_with_free(pverb_argv, mlr_strdup_or_die(argv[argi]));
+	return pverb_argv;
+}
+
+aggregate_state_spec_t* aggregate_state_spec_alloc(char* filename, slls_t* pverb_argv, int argc_used) {
+	if (filename == NULL) {
+		slls_free(pverb_argv);
+		return NULL;
+	}
+	aggregate_state_spec_t* pspec = mlr_malloc_or_die(sizeof(aggregate_state_spec_t));
+	pspec->filename = filename;
+	pspec->tempname = NULL;
+	pspec->verb     = mlr_strdup_or_die(pverb_argv->phead->value);
+	pspec->pargs    = slls_alloc();
+	int argi = 1;
+	for (sllse_t* pe = pverb_argv->phead->pnext; pe != NULL && argi < argc_used; pe = pe->pnext, argi++) {
+		if (streq(pe->value, MLR_STATE_FLAG) && pe->pnext != NULL && argi + 1 < argc_used) {
+			pe = pe->pnext;
+			argi++;
+		} else {
+			slls_append_with_free(pspec->pargs, mlr_strdup_or_die(pe->value));
+		}
+	}
+	slls_free(pverb_argv);
+	return pspec;
+}
+
+void aggregate_state_spec_free(aggregate_state_spec_t* pspec) {
+	if (pspec == NULL)
+		return;
+	free(pspec->verb);
+	slls_free(pspec->pargs);
+	free(pspec);
+}
+
+// ----------------------------------------------------------------
+// Written to a temp file then renamed, so that a merge never sees a partly written file.
+FILE* aggregate_state_open(aggregate_state_spec_t* pspec) {
+	pspec->tempname = alloc_suffixed_temp_file_name(pspec->filename);
+	FILE* output_stream = fopen(pspec->tempname, "wb");
+	if (output_stream == NULL) {
+		perror("fopen");
+		fprintf(stderr, "%s %s: Could not open \"%s\" for write.\n", MLR_GLOBALS.bargv0, pspec->verb,
+			pspec->tempname);
+		exit(1);
+	}
+
+	fwrite(MLR_STATE_HEADER, 1, MLR_STATE_HEADER_LENGTH, output_stream);
+	aggregate_state_put_string(output_stream, pspec->verb);
+	aggregate_state_put_slls(output_stream, pspec->pargs);
+	return output_stream;
+}
+
+void aggregate_state_close(FILE* output_stream, aggregate_state_spec_t* pspec) {
+	char* tempname = pspec->tempname;
+	if (fclose(output_stream) != 0) {
+		perror("fclose");
+		fprintf(stderr, "%s %s: Could not write \"%s\".\n", MLR_GLOBALS.bargv0, pspec->verb, tempname);
+		exit(1);
+	}
+	if (rename(tempname, pspec->filename) != 0) {
+		perror("rename");
+		fprintf(stderr, "%s %s: Could not rename \"%s\" to \"%s\".\n", MLR_GLOBALS.bargv0, pspec->verb,
+			tempname, pspec->filename);
+		exit(1);
+	}
+	free(tempname);
+	pspec->tempname = NULL;
+}
+
+// ----------------------------------------------------------------
+void aggregate_state_put_varint(FILE* output_stream, unsigned long long value) {
+	unsigned char buf[10];
+	fwrite(buf, 1, mlr_bin_put_varint(buf, value), output_stream);
+}
+
+void aggregate_state_put_ll(FILE* output_stream, long long value) {
+	aggregate_state_put_varint(output_stream, mlr_bin_zigzag(value));
+}
+
+void aggregate_state_put_double(FILE* output_stream, double value) {
+	unsigned char buf[8];
+	mlr_bin_put_double(buf, value);
+	fwrite(buf, 1, 8, output_stream);
+}
+
+void aggregate_state_put_string(FILE* output_stream, char* value) {
+	size_t length = strlen(value);
+	aggregate_state_put_varint(output_stream, length);
+	fwrite(value, 1, length + 1, output_stream);
+}
+
+void aggregate_state_put_slls(FILE* output_stream, slls_t* plist) {
+	aggregate_state_put_varint(output_stream, plist->length);
+	for (sllse_t* pe = plist->phead; pe != NULL; pe = pe->pnext)
+		aggregate_state_put_string(output_stream, pe->value);
+}
+
+void aggregate_state_put_packed_key(FILE* output_stream, packed_key_t* pkey) {
+	aggregate_state_put_varint(output_stream, pkey->num_values);
+	for (char* value = packed_key_first(pkey); value != NULL; value = packed_key_next(pkey, value))
+		aggregate_state_put_string(output_stream, value);
+}
+
+void aggregate_state_put_mv(FILE* output_stream, mv_t* pvalue) {
+	switch (pvalue->type) {
+	case MT_INT:
+		fputc(STATE_MV_INT, output_stream);
+		aggregate_state_put_ll(output_stream, pvalue->u.intv);
+		break;
+	case MT_FLOAT:
+		fputc(STATE_MV_FLOAT, output_stream);
+		aggregate_state_put_double(output_stream, pvalue->u.fltv);
+		break;
+	case MT_STRING:
+	case MT_EMPTY:
+		fputc(STATE_MV_STRING, output_stream);
+		aggregate_state_put_string(output_stream, pvalue->u.strv);
+		break;
+	default:
+		fputc(STATE_MV_ABSENT, output_stream);
+		break;
+	}
+}
+
+// ----------------------------------------------------------------
+aggregate_state_reader_t* aggregate_state_reader_alloc(char* filename) {
+	size_t size;
+	char* contents = read_file_into_memory(filename, &size);
+	if (contents == NULL)
+		exit(1);
+
+	aggregate_state_reader_t* preader = mlr_malloc_or_die(sizeof(aggregate_state_reader_t));
+	preader->filename = filename;
+	preader->contents = contents;
+	preader->p        = (unsigned char*)contents;
+	preader->end      = (unsigned char*)contents + size;
+
+	if (size < MLR_STATE_HEADER_LENGTH || memcmp(contents, MLR_STATE_HEADER, MLR_STATE_HEADER_LENGTH) != 0) {
+		fprintf(stderr, "%s: \"%s\" is not a Miller state file.\n", MLR_GLOBALS.bargv0, filename);
+		exit(1);
+	}
+	preader->p += MLR_STATE_HEADER_LENGTH;
+	preader->verb  = aggregate_state_get_string(preader);
+	preader->pargs = aggregate_state_get_slls(preader);
+	return preader;
+}
+
+void aggregate_state_reader_free(aggregate_state_reader_t* preader) {
+	if (preader == NULL)
+		return;
+	slls_free(preader->pargs);
+	free(preader->contents);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+unsigned long long aggregate_state_get_varint(aggregate_state_reader_t* preader) {
+	unsigned long long value;
+	if (!mlr_bin_get_varint(&preader->p, preader->end, &value))
+		aggregate_state_corrupt(preader);
+	return value;
+}
+
+long long aggregate_state_get_ll(aggregate_state_reader_t* preader) {
+	return mlr_bin_unzigzag(aggregate_state_get_varint(preader));
+}
+
+double aggregate_state_get_double(aggregate_state_reader_t* preader) {
+	if (preader->end - preader->p < 8)
+		aggregate_state_corrupt(preader);
+	double value = mlr_bin_get_double(preader->p);
+	preader->p += 8;
+	return value;
+}
+
+char* aggregate_state_get_string(aggregate_state_reader_t* preader) {
+	unsigned long long length = aggregate_state_get_varint(preader);
+	char* value = mlr_bin_get_string(&preader->p, preader->end, length);
+	if (value == NULL)
+		aggregate_state_corrupt(preader);
+	return value;
+}
+
+slls_t* aggregate_state_get_slls(aggregate_state_reader_t* preader) {
+	unsigned long long length = aggregate_state_get_varint(preader);
+	// Each string takes at least two bytes, which bounds the loop for a corrupt count.
+	if (length > (unsigned long long)(preader->end - preader->p) / 2)
+		aggregate_state_corrupt(preader);
+	slls_t* plist = slls_alloc();
+	for (unsigned long long i = 0; i < length; i++)
+		slls_append_no_free(plist, aggregate_state_get_string(preader));
+	return plist;
+}
+
+void aggregate_state_get_packed_key(aggregate_state_reader_t* preader, packed_key_t* pkey) {
+	unsigned long long length = aggregate_state_get_varint(preader);
+	if (length > (unsigned long long)(preader->end - preader->p) / 2)
+		aggregate_state_corrupt(preader);
+	packed_key_clear(pkey);
+	for (unsigned long long i = 0; i < length; i++)
+		packed_key_append(pkey, aggregate_state_get_string(preader));
+	packed_key_finish(pkey);
+}
+
+mv_t aggregate_state_get_mv(aggregate_state_reader_t* preader) {
+	if (preader->p >= preader->end)
+		aggregate_state_corrupt(preader);
+	switch (*preader->p++) {
+	case STATE_MV_ABSENT:
+		return mv_absent();
+	case STATE_MV_INT:
+		return mv_from_int(aggregate_state_get_ll(preader));
+	case STATE_MV_FLOAT:
+		return mv_from_float(aggregate_state_get_double(preader));
+	case STATE_MV_STRING: {
+		char* value = aggregate_state_get_string(preader);
+		return (*value == 0) ? mv_empty() : mv_from_string_with_free(mlr_strdup_or_die(value));
+	}
+	default:
+		aggregate_state_corrupt(preader);
+		return mv_absent(); // not reached
+	}
+}
+
+// ----------------------------------------------------------------
+void aggregate_state_check_end(aggregate_state_reader_t* preader) {
+	if (preader->p != preader->end)
+		aggregate_state_corrupt(preader);
+}
+
+void aggregate_state_corrupt(aggregate_state_reader_t* preader) {
+	fprintf(stderr, "%s: state file \"%s\" is truncated or corrupt.\n", MLR_GLOBALS.bargv0, preader->filename);
+	exit(1);
+}
@@ -0,0 +1,94 @@
+// ================================================================
+// State files for mergeable aggregates. Verbs such as stats1 take --write-state
+// {filename}, and at end of stream write their accumulators there as well as
+// producing their usual output. mlr merge-state reads any number of such files,
+// e.g. from runs over separate parts of the input, and emits what a single run
+// over all of that input would have.
+//
+// Varints, zigzag integers, strings and doubles are encoded as in Miller's
+// binary row format: see lib/bin_format.h.
+//
+// * 'M' 'L' 'R' 'S' then a version byte.
+// * The verb name, then the number of its other arguments, then those, as
+//   strings. merge-state reconstructs the verb from these, and requires them to
+//   be the same in all the files it merges.
+// * The verb's accumulators, in the verb's own layout, which should list groups
+//   and the like in the order first seen, so that merging files in order of
+//   input gives the same output order as a single run.
+// ================================================================
+
+#ifndef AGGREGATE_STATE_H
+#define AGGREGATE_STATE_H
+
+#include <stdio.h>
+#include "lib/mlrval.h"
+#include "containers/slls.h"
+#include "containers/packed_key.h"
+
+#define MLR_STATE_HEADER "MLRS\001"
+#define MLR_STATE_HEADER_LENGTH 5
+
+#define MLR_STATE_FLAG "--write-state"
+
+// ----------------------------------------------------------------
+// Set up at CLI-parse time by verbs given --write-state.
+typedef struct _aggregate_state_spec_t {
+	char*   filename;
+	char*   tempname; // while being written
+	char*   verb;
+	slls_t* pargs;
+} aggregate_state_spec_t;
+
+// Argument parsing splits comma-separated lists in place, so verbs copy argv[argb] (their name) through
+// argv[argc-1] before parsing their flags. The spec keeps the first argc_used of those, less the
+// --write-state flag and its value, or is NULL (freeing the copy) when filename is NULL.
+slls_t* aggregate_state_copy_argv(char** argv, int argb, int argc);
+aggregate_state_spec_t* aggregate_state_spec_alloc(char* filename, slls_t* pverb_argv, int argc_used);
+void aggregate_state_spec_free(aggregate_state_spec_t* pspec);
+
+// ----------------------------------------------------------------
+// Writing. The file is written to a temp file then renamed, as with record indexes. Errors are fatal.
+FILE* aggregate_state_open(aggregate_state_spec_t* pspec);
+void  aggregate_state_close(FILE* output_stream, aggregate_state_spec_t* pspec);
+
+void aggregate_state_put_varint(FILE* output_stream, unsigned long long value);
+void aggregate_state_put_ll(FILE* output_stream, long long value);
+void aggregate_state_put_double(FILE* output_stream, double value);
+void aggregate_state_put_string(FILE* output_stream, char* value);
+void aggregate_state_put_slls(FILE* output_stream, slls_t* plist);
+// Written as the list of its values would be.
+void aggregate_state_put_packed_key(FILE* output_stream, packed_key_t* pkey);
+// Absent, int, float or string, e.g. for min and max.
+void aggregate_state_put_mv(FILE* output_stream, mv_t* pvalue);
+
+// ----------------------------------------------------------------
+// Reading. The whole file is read into memory. Strings are returned as pointers into it, so the reader
+// must outlive any data structures referencing them. Truncated or corrupt files are fatal errors.
+typedef struct _aggregate_state_reader_t {
+	char*          filename;
+	char*          contents;
+	unsigned char* p;
+	unsigned char* end;
+	char*          verb;
+	slls_t*        pargs; // pointing into contents
+} aggregate_state_reader_t;
+
+aggregate_state_reader_t* aggregate_state_reader_alloc(char* filename);
+void aggregate_state_reader_free(aggregate_state_reader_t* preader);
+
+unsigned long long aggregate_state_get_varint(aggregate_state_reader_t* preader);
+long long aggregate_state_get_ll(aggregate_state_reader_t* preader);
+double aggregate_state_get_double(aggregate_state_reader_t* preader);
+char* aggregate_state_get_string(aggregate_state_reader_t* preader);
+// The list's elements point into the reader's contents.
+slls_t* aggregate_state_get_slls(aggregate_state_reader_t* preader);
+// Reads a list of values into the given key, copying them, and finishes it.
+void aggregate_state_get_packed_key(aggregate_state_reader_t* preader, packed_key_t* pkey);
+// String values are copied.
+mv_t aggregate_state_get_mv(aggregate_state_reader_t* preader);
+
+// Fatal error unless the whole file has been read.
+void aggregate_state_check_end(aggregate_state_reader_t* preader);
+void aggregate_state_corrupt(aggregate_state_reader_t* preader);
+
+#endif // AGGREGATE_STATE_H
@@ -6,6 +6,8 @@
 #include "cli/mlrcli.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
+#include "containers/hss.h"
+#include "mapping/aggregate_state.h"
 
 // See ../README.md for memory-management conventions.
 
@@ -32,11 +34,84 @@ typedef void mapper_usage_func_t(FILE* o, char* argv0, char* verb);
 typedef      mapper_t* mapper_parse_cli_func_t(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts);
 
+// For projection pushdown: which input fields a mapper's output can depend on. The mapper adds the
+// names it reads to the set (as borrowed pointers which must live as long as the mapper does), and
+// says what happens to the rest:
+// * MAPPER_USES_ALL_FIELDS: anything in the record may matter, e.g. put with $*, or reorder.
+// * MAPPER_USES_ONLY_THESE_FIELDS: output depends only on the named fields, e.g. cut -f or stats1.
+// * MAPPER_PASSES_OTHER_FIELDS_THROUGH: output depends on the named fields, plus any other fields
+//   which are passed through unmodified for downstream mappers to look at, e.g. head -g or sort -f.
+typedef enum _mapper_input_fields_t {
+	MAPPER_USES_ALL_FIELDS,
+	MAPPER_USES_ONLY_THESE_FIELDS,
+	MAPPER_PASSES_OTHER_FIELDS_THROUGH,
+} mapper_input_fields_t;
+
+typedef mapper_input_fields_t mapper_input_fields_func_t(mapper_t* pmapper, hss_t* pfield_names);
+
+// For predicate pushdown: when the mapper is first in the chain, a test which readers may apply to
+// drop records the mapper would drop anyway, or NULL if it has none. Owned by the mapper.
+typedef lrec_reader_predicate_t* mapper_input_predicate_func_t(mapper_t* pmapper);
+
+// For record-boundaries-only reading: when the mapper is first in the chain and its output depends
+// only on how many records it's given (e.g. count without -g), a sink for record counts which the
+// stream driver may use in place of passing records, or NULL if it needs them. Owned by the mapper.
+typedef lrec_reader_count_sink_t* mapper_input_count_sink_func_t(mapper_t* pmapper);
+
+// For typed columnar input: when the mapper is first in the chain and only folds numbers from named
+// fields into running totals (e.g. stats1 without -g), a sink for blocks of those numbers which
+// readers may use in place of building records, or NULL if it needs the records. Owned by the mapper.
+typedef lrec_reader_number_sink_t* mapper_input_number_sink_func_t(mapper_t* pmapper);
+
+// For indexed input: when the mapper is first in the chain and needs only some of its input records, by
+// position (e.g. tail without -g), a function saying which, or NULL if it needs them all. Owned by the
+// mapper.
+typedef lrec_reader_record_ranges_t* mapper_input_record_ranges_func_t(mapper_t* pmapper);
+
+// For tail reading: when the mapper is the whole chain and needs only the last so many of its input
+// records, from any one file (e.g. tail without -g), how many; else -1.
+typedef long long mapper_input_tail_count_func_t(mapper_t* pmapper);
+
+// For late materialization: when the mapper is first in the chain and only reorders whole records by a few
+// named fields (e.g. sort), a sink which the stream driver may pass records holding just those fields, with
+// where they came from, in place of whole records; or NULL if it needs them. Owned by the mapper.
+typedef lrec_reader_span_sink_t* mapper_input_span_sink_func_t(mapper_t* pmapper);
+
+// For mergeable aggregates: folds into the mapper's accumulators the state which a run of the same verb,
+// with the same arguments, wrote with --write-state (see aggregate_state.h). At end of stream the mapper
+// then emits as if it had also seen that run's input.
+typedef void mapper_merge_state_func_t(mapper_t* pmapper, aggregate_state_reader_t* preader);
+
+// For fusing adjacent verbs: given the mapper and the next one in the chain, with the latter's setup, a single
+// mapper giving the same output as the two, which then owns them, with its own setup; or NULL if the pair
+// don't combine (e.g. sort then head into a top-n).
+struct _mapper_setup_t;
+typedef mapper_t* mapper_fuse_func_t(mapper_t* pmapper, struct _mapper_setup_t* pnext_setup, mapper_t* pnext,
+	struct _mapper_setup_t** ppfused_setup);
+
 typedef struct _mapper_setup_t {
 	char*                    verb;
 	mapper_usage_func_t*     pusage_func;
 	mapper_parse_cli_func_t* pparse_func;
 	int                      ignores_input; // most don't; data-generators like seqgen do
+	// Optional; NULL means MAPPER_USES_ALL_FIELDS.
+	mapper_input_fields_func_t* pinput_fields_func;
+	// Optional; NULL means no predicate pushdown.
+	mapper_input_predicate_func_t* pinput_predicate_func;
+	// Optional; NULL means records are always needed.
+	mapper_input_count_sink_func_t* pinput_count_sink_func;
+	// Optional; NULL means records are always needed.
+	mapper_input_number_sink_func_t* pinput_number_sink_func;
+	// Optional; NULL means all records are always needed.
+	mapper_input_record_ranges_func_t* pinput_record_ranges_func;
+	// Optional; NULL means all records are always needed.
+	mapper_input_tail_count_func_t* pinput_tail_count_func;
+	// Optional; NULL means records are always needed.
+	mapper_input_span_sink_func_t* pinput_span_sink_func;
+	// Optional; NULL means the verb doesn't write state files.
+	mapper_merge_state_func_t* pmerge_state_func;
+	// Optional; NULL means the mapper is never fused with the next.
+	mapper_fuse_func_t* pfuse_func;
 } mapper_setup_t;
 
 #endif // MAPPER_H
@@ -21,6 +21,7 @@ static mapper_t* mapper_cat_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_cat_alloc(ap_state_t* pargp, int do_counters, char* counter_field_name,
 	slls_t* pgroup_by_field_names);
 static void      mapper_cat_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_cat_input_fields(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_cat_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_catn_process_ungrouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_catn_process_grouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
@@ -31,6 +32,7 @@ mapper_setup_t mapper_cat_setup = {
 	.pusage_func = mapper_cat_usage,
 	.pparse_func = mapper_cat_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_cat_input_fields,
 };
 
 // ----------------------------------------------------------------
@@ -119,6 +121,14 @@ static void mapper_cat_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_cat_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_cat_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_cat_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL)
@@ -7,6 +7,7 @@ static mapper_t* mapper_check_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_check_alloc();
 static void      mapper_check_free(mapper_t* pmapper, context_t* _);
+static lrec_reader_count_sink_t* mapper_check_input_count_sink(mapper_t* pmapper);
 static sllv_t*   mapper_check_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
@@ -15,6 +16,7 @@ mapper_setup_t mapper_check_setup = {
 	.pusage_func = mapper_check_usage,
 	.pparse_func = mapper_check_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_count_sink_func = mapper_check_input_count_sink,
 };
 
 // ----------------------------------------------------------------
@@ -48,6 +50,21 @@ static void mapper_check_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// Records are dropped unseen, and readers' count methods report the same input errors as their
+// process methods, so a count of records will do as well.
+static void mapper_check_count_records(void* pvstate, long long record_count, context_t* pctx) {
+}
+
+static lrec_reader_count_sink_t mapper_check_count_sink = {
+	.pcount_func = mapper_check_count_records,
+	.pvstate     = NULL,
+};
+
+static lrec_reader_count_sink_t* mapper_check_input_count_sink(mapper_t* pmapper) {
+	return &mapper_check_count_sink;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_check_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	lrec_free(pinrec);
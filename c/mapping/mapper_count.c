@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "containers/sllv.h"
+#include "containers/lhmpkv.h"
+#include "containers/mixutil.h"
+#include "mapping/mappers.h"
+#include "cli/argparse.h"
+
+#define DEFAULT_OUTPUT_FIELD_NAME "count"
+
+typedef struct _mapper_count_state_t {
+	ap_state_t* pargp;
+	slls_t*     pgroup_by_field_names;
+	int         show_num_distinct_only;
+	char*       output_field_name;
+	unsigned long long ungrouped_count;
+	packed_key_t* pgroup_by_key; // scratch, refilled per record
+	lhmpkv_t*   pcounts_by_group;
+	lrec_reader_count_sink_t count_sink;
+	aggregate_state_spec_t* pstate_spec; // for --write-state, else NULL
+} mapper_count_state_t;
+
+static void      mapper_count_usage(FILE* o, char* argv0, char* verb);
+static mapper_t* mapper_count_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* _, cli_writer_opts_t* __);
+static mapper_t* mapper_count_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
+	int show_num_distinct_only, char* output_field_name, aggregate_state_spec_t* pstate_spec);
+static void      mapper_count_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_count_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static lrec_reader_count_sink_t* mapper_count_input_count_sink(mapper_t* pmapper);
+static void      mapper_count_count_records(void* pvstate, long long record_count, context_t* pctx);
+static sllv_t*   mapper_count_process_ungrouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_count_process_grouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_count_write_state(mapper_count_state_t* pstate);
+static void      mapper_count_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader);
+
+// ----------------------------------------------------------------
+mapper_setup_t mapper_count_setup = {
+	.verb = "count",
+	.pusage_func = mapper_count_usage,
+	.pparse_func = mapper_count_parse_cli,
+	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_count_input_fields,
+	.pinput_count_sink_func = mapper_count_input_count_sink,
+	.pmerge_state_func = mapper_count_merge_state,
+};
+
+// ----------------------------------------------------------------
+static void mapper_count_usage(FILE* o, char* argv0, char* verb) {
+	fprintf(o, "Usage: %s %s [options]\n", argv0, verb);
+	fprintf(o, "Prints number of records, optionally grouped by distinct values for specified field names.\n");
+	fprintf(o, "Options:\n");
+	fprintf(o, "-g {a,b,c}    Optional group-by-field names for counts.\n");
+	fprintf(o, "-n            Show only the number of distinct values. Requires -g.\n");
+	fprintf(o, "-o {name}     Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--write-state {filename}\n");
+	fprintf(o, "              At end of stream, also write the counts to this file, for\n");
+	fprintf(o, "              %s merge-state to combine with others.\n", argv0);
+	fprintf(o, "Without -g, and where the input format allows, records are counted without being\n");
+	fprintf(o, "parsed into fields.\n");
+}
+
+static mapper_t* mapper_count_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* _, cli_writer_opts_t* __)
+{
+	slls_t* pgroup_by_field_names = NULL;
+	int     show_num_distinct_only = FALSE;
+	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
+	char*   state_filename = NULL;
+
+	int verb_argi = *pargi;
+	slls_t* pverb_argv = aggregate_state_copy_argv(argv, verb_argi, argc);
+	char* verb = argv[(*pargi)++];
+
+	ap_state_t* pstate = ap_alloc();
+	ap_define_string_list_flag(pstate, "-g", &pgroup_by_field_names);
+	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
+	ap_define_string_flag(pstate,      "-o", &output_field_name);
+	ap_define_string_flag(pstate,      MLR_STATE_FLAG, &state_filename);
+
+	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
+		mapper_count_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+
+	if (show_num_distinct_only && pgroup_by_field_names == NULL) {
+		mapper_count_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+
+	aggregate_state_spec_t* pstate_spec = aggregate_state_spec_alloc(state_filename, pverb_argv,
+		*pargi - verb_argi);
+
+	return mapper_count_alloc(pstate, pgroup_by_field_names, show_num_distinct_only, output_field_name,
+		pstate_spec);
+}
+
+// ----------------------------------------------------------------
+static mapper_t* mapper_count_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
+	int show_num_distinct_only, char* output_field_name, aggregate_state_spec_t* pstate_spec)
+{
+	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
+
+	mapper_count_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_count_state_t));
+
+	pstate->pargp                  = pargp;
+	pstate->pgroup_by_field_names  = pgroup_by_field_names;
+	pstate->show_num_distinct_only = show_num_distinct_only;
+	pstate->output_field_name      = output_field_name;
+	pstate->ungrouped_count        = 0LL;
+	pstate->pgroup_by_key          = packed_key_alloc();
+	pstate->pcounts_by_group       = lhmpkv_alloc();
+	pstate->count_sink.pcount_func = mapper_count_count_records;
+	pstate->count_sink.pvstate     = pstate;
+	pstate->pstate_spec            = pstate_spec;
+
+	pmapper->pvstate       = pstate;
+	pmapper->pprocess_func = (pgroup_by_field_names == NULL)
+		? mapper_count_process_ungrouped
+		: mapper_count_process_grouped;
+	pmapper->pfree_func    = mapper_count_free;
+
+	return pmapper;
+}
+
+static void mapper_count_free(mapper_t* pmapper, context_t* _) {
+	mapper_count_state_t* pstate = pmapper->pvstate;
+	slls_free(pstate->pgroup_by_field_names);
+	// lhmpkv_free will free the keys: we only need to free the void-star values.
+	for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+		unsigned long long* pcount = pa->pvvalue;
+		free(pcount);
+	}
+	lhmpkv_free(pstate->pcounts_by_group);
+	packed_key_free(pstate->pgroup_by_key);
+	aggregate_state_spec_free(pstate->pstate_spec);
+	ap_free(pstate->pargp);
+	free(pstate);
+	free(pmapper);
+}
+
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_count_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_count_state_t* pstate = pmapper->pvstate;
+	if (pstate->pgroup_by_field_names != NULL) {
+		for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+			hss_add(pfield_names, pe->value);
+	}
+	return MAPPER_USES_ONLY_THESE_FIELDS;
+}
+
+// Without -g, what's in the records doesn't matter: only how many of them there are.
+static lrec_reader_count_sink_t* mapper_count_input_count_sink(mapper_t* pmapper) {
+	mapper_count_state_t* pstate = pmapper->pvstate;
+	return (pstate->pgroup_by_field_names == NULL) ? &pstate->count_sink : NULL;
+}
+
+static void mapper_count_count_records(void* pvstate, long long record_count, context_t* pctx) {
+	mapper_count_state_t* pstate = pvstate;
+	pstate->ungrouped_count += record_count;
+}
+
+// ----------------------------------------------------------------
+static sllv_t* mapper_count_process_ungrouped(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_count_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		pstate->ungrouped_count++;
+		lrec_free(pinrec);
+		return NULL;
+	} else {
+		if (pstate->pstate_spec != NULL)
+			mapper_count_write_state(pstate);
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ull(pstate->ungrouped_count),
+			FREE_ENTRY_VALUE);
+		sllv_t* poutrecs = sllv_single(poutrec);
+		sllv_append(poutrecs, NULL);
+		return poutrecs;
+	}
+}
+
+// Records lacking any of the group-by fields are not counted.
+static sllv_t* mapper_count_process_grouped(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_count_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		if (packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
+			if (pcount == NULL) {
+				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
+				*pcount = 1LL;
+				lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount);
+			} else {
+				(*pcount)++;
+			}
+		}
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	if (pstate->pstate_spec != NULL)
+		mapper_count_write_state(pstate);
+	sllv_t* poutrecs = sllv_alloc();
+	if (pstate->show_num_distinct_only) {
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		lrec_put(poutrec, pstate->output_field_name,
+			mlr_alloc_string_from_int(pstate->pcounts_by_group->num_occupied), FREE_ENTRY_VALUE);
+		sllv_append(poutrecs, poutrec);
+	} else {
+		for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+			lrec_t* poutrec = lrec_unbacked_alloc();
+			sllse_t* pb = pstate->pgroup_by_field_names->phead;
+			char* value = packed_key_first(pa->key);
+			for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pa->key, value))
+				lrec_put(poutrec, pb->value, value, NO_FREE);
+			unsigned long long* pcount = pa->pvvalue;
+			lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ull(*pcount), FREE_ENTRY_VALUE);
+			sllv_append(poutrecs, poutrec);
+		}
+	}
+	sllv_append(poutrecs, NULL);
+	return poutrecs;
+}
+
+// ----------------------------------------------------------------
+// State-file layout (see aggregate_state.h): the ungrouped count, then the number of groups, then per
+// group its field values and count.
+static void mapper_count_write_state(mapper_count_state_t* pstate) {
+	FILE* output_stream = aggregate_state_open(pstate->pstate_spec);
+	aggregate_state_put_varint(output_stream, pstate->ungrouped_count);
+	aggregate_state_put_varint(output_stream, pstate->pcounts_by_group->num_occupied);
+	for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+		unsigned long long* pcount = pa->pvvalue;
+		aggregate_state_put_packed_key(output_stream, pa->key);
+		aggregate_state_put_varint(output_stream, *pcount);
+	}
+	aggregate_state_close(output_stream, pstate->pstate_spec);
+}
+
+static void mapper_count_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader) {
+	mapper_count_state_t* pstate = pmapper->pvstate;
+	pstate->ungrouped_count += aggregate_state_get_varint(preader);
+	unsigned long long num_groups = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_groups; i++) {
+		aggregate_state_get_packed_key(preader, pstate->pgroup_by_key);
+		unsigned long long count = aggregate_state_get_varint(preader);
+		unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
+		if (pcount == NULL) {
+			pcount = mlr_malloc_or_die(sizeof(unsigned long long));
+			*pcount = count;
+			lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount);
+		} else {
+			*pcount += count;
+		}
+	}
+}
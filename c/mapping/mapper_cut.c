@@ -23,6 +23,7 @@ static mapper_t* mapper_cut_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_cut_alloc(ap_state_t* pargp, slls_t* pfield_name_list,
 	int do_arg_order, int do_complement, int do_regexes);
 static void      mapper_cut_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_cut_input_fields(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_cut_process_with_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -32,6 +33,7 @@ mapper_setup_t mapper_cut_setup = {
 	.pusage_func = mapper_cut_usage,
 	.pparse_func = mapper_cut_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_cut_input_fields,
 };
 
 // ----------------------------------------------------------------
@@ -135,6 +137,18 @@ static void mapper_cut_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// With -f and without -r, only the named fields are needed: either to output them, or (with -x) to
+// know what to remove while passing everything else along.
+static mapper_input_fields_t mapper_cut_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_cut_state_t* pstate = pmapper->pvstate;
+	if (pstate->pfield_name_list == NULL)
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return pstate->do_complement ? MAPPER_PASSES_OTHER_FIELDS_THROUGH : MAPPER_USES_ONLY_THESE_FIELDS;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL) {
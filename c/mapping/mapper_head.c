@@ -4,7 +4,7 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
@@ -15,7 +15,8 @@ typedef struct _mapper_head_state_t {
 	slls_t* pgroup_by_field_names;
 	unsigned long long head_count;
 	unsigned long long unkeyed_record_count;
-	lhmslv_t* pcounts_by_group;
+	packed_key_t* pgroup_by_key; // scratch, refilled per record
+	lhmpkv_t* pcounts_by_group;
 } mapper_head_state_t;
 
 static void      mapper_head_usage(FILE* o, char* argv0, char* verb);
@@ -23,6 +24,7 @@ static mapper_t* mapper_head_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long head_count);
 static void      mapper_head_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_head_input_fields(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -32,6 +34,7 @@ mapper_setup_t mapper_head_setup = {
 	.pusage_func = mapper_head_usage,
 	.pparse_func = mapper_head_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_head_input_fields,
 };
 
 // ----------------------------------------------------------------
@@ -74,7 +77,8 @@ static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
 	pstate->head_count             = head_count;
 	pstate->unkeyed_record_count   = 0LL;
-	pstate->pcounts_by_group       = lhmslv_alloc();
+	pstate->pgroup_by_key          = packed_key_alloc();
+	pstate->pcounts_by_group       = lhmpkv_alloc();
 
 	pmapper->pvstate        = pstate;
 	pmapper->pprocess_func  = pgroup_by_field_names->length == 0
@@ -89,17 +93,33 @@ static void mapper_head_free(mapper_t* pmapper, context_t* _) {
 	mapper_head_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+	// lhmpkv_free will free the hashmap keys; we need to free the void-star hashmap values.
+	for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 		unsigned long long* pcount_for_group = pa->pvvalue;
 		free(pcount_for_group);
 	}
-	lhmslv_free(pstate->pcounts_by_group);
+	lhmpkv_free(pstate->pcounts_by_group);
+	packed_key_free(pstate->pgroup_by_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+void mapper_head_get_params(mapper_t* pmapper, unsigned long long* phead_count, slls_t** ppgroup_by_field_names) {
+	mapper_head_state_t* pstate = pmapper->pvstate;
+	*phead_count = pstate->head_count;
+	*ppgroup_by_field_names = pstate->pgroup_by_field_names;
+}
+
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_head_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_head_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_head_state_t* pstate = pvstate;
@@ -121,21 +141,17 @@ static sllv_t* mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void
 static sllv_t* mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_head_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
 			lrec_free(pinrec);
 			return NULL;
 		} else {
-			unsigned long long* pcount_for_group = lhmslv_get(pstate->pcounts_by_group,
-				pgroup_by_field_values);
+			unsigned long long* pcount_for_group = lhmpkv_get(pstate->pcounts_by_group,
+				pstate->pgroup_by_key);
 			if (pcount_for_group == NULL) {
 				pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount_for_group = 0LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values),
-					pcount_for_group, FREE_ENTRY_KEY);
+				lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount_for_group);
 			}
-			slls_free(pgroup_by_field_values);
 			(*pcount_for_group)++;
 			if (*pcount_for_group <= pstate->head_count) {
 				return sllv_single(pinrec);
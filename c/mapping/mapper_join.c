@@ -2,7 +2,7 @@
 #include "lib/mlrutil.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/mixutil.h"
 #include "containers/join_bucket_keeper.h"
 #include "mapping/mappers.h"
@@ -42,8 +42,9 @@ typedef struct _mapper_join_state_t {
 	join_bucket_keeper_t* pjoin_bucket_keeper;
 
 	// For unsorted input
-	lhmslv_t* pleft_buckets_by_join_field_values;
-	sllv_t*   pleft_unpaired_records;
+	lhmpkv_t*     pleft_buckets_by_join_field_values;
+	sllv_t*       pleft_unpaired_records;
+	packed_key_t* pjoin_key; // scratch, refilled per record
 
 } mapper_join_state_t;
 
@@ -299,6 +300,7 @@ static mapper_t* mapper_join_alloc(mapper_join_opts_t* popts) {
 
 	pstate->pleft_buckets_by_join_field_values = NULL;
 	pstate->pleft_unpaired_records             = NULL;
+	pstate->pjoin_key                          = packed_key_alloc();
 
 	pmapper->pvstate = (void*)pstate;
 	if (popts->allow_unsorted_input) {
@@ -316,17 +318,17 @@ static void mapper_join_free(mapper_t* pmapper, context_t* _) {
 	mapper_join_state_t* pstate = pmapper->pvstate;
 
 	if (pstate->pleft_buckets_by_join_field_values != NULL) {
-		for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
+		for (lhmpkve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
 			join_bucket_t* pbucket = pe->pvvalue;
-			slls_free(pbucket->pleft_field_values);
 			if (pbucket->precords)
 				while (pbucket->precords->phead)
 					lrec_free(sllv_pop(pbucket->precords));
 			sllv_free(pbucket->precords);
 			free(pbucket);
 		}
-		lhmslv_free(pstate->pleft_buckets_by_join_field_values);
+		lhmpkv_free(pstate->pleft_buckets_by_join_field_values);
 	}
+	packed_key_free(pstate->pjoin_key);
 
 	// The void-star payload, which is lrec_t*'s, should have been sllv_transferred out.
 	// Misses should be detected by valgrind --leak-check=full, e.g. reg_test/run --valgrind.
@@ -427,7 +429,7 @@ static sllv_t* mapper_join_process_unsorted(lrec_t* pright_rec, context_t* pctx,
 		if (pstate->popts->emit_left_unpairables) {
 			sllv_t* poutrecs = sllv_alloc();
 			if (pstate->pleft_buckets_by_join_field_values != NULL) { // E.g. empty right input
-				for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
+				for (lhmpkve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
 					join_bucket_t* pbucket = pe->pvvalue;
 					if (!pbucket->was_paired) {
 						sllv_transfer(poutrecs, pbucket->precords);
@@ -446,11 +448,8 @@ static sllv_t* mapper_join_process_unsorted(lrec_t* pright_rec, context_t* pctx,
 		}
 	}
 
-	slls_t* pright_field_values = mlr_reference_selected_values_from_record(pright_rec,
-		pstate->popts->pright_join_field_names);
-	if (pright_field_values != NULL) {
-		join_bucket_t* pleft_bucket = lhmslv_get(pstate->pleft_buckets_by_join_field_values, pright_field_values);
-		slls_free(pright_field_values);
+	if (packed_key_fill_from_record(pstate->pjoin_key, pright_rec, pstate->popts->pright_join_field_names)) {
+		join_bucket_t* pleft_bucket = lhmpkv_get(pstate->pleft_buckets_by_join_field_values, pstate->pjoin_key);
 		if (pleft_bucket == NULL) {
 			if (pstate->popts->emit_right_unpairables) {
 				return sllv_single(pright_rec);
@@ -556,7 +555,7 @@ static void ingest_left_file(mapper_join_state_t* pstate) {
 	};
 	context_t* pctx = &ctx;
 
-	pstate->pleft_buckets_by_join_field_values = lhmslv_alloc();
+	pstate->pleft_buckets_by_join_field_values = lhmpkv_alloc();
 
 	while (TRUE) {
 		lrec_t* pleft_rec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, pctx);
@@ -567,23 +566,18 @@ static void ingest_left_file(mapper_join_state_t* pstate) {
 		// ingestor we need to copy.
 		lrec_t* pleft_copy = lrec_copy(pleft_rec);
 
-		slls_t* pleft_field_values = mlr_reference_selected_values_from_record(pleft_copy,
-			pstate->popts->pleft_join_field_names);
-		if (pleft_field_values != NULL) {
-			join_bucket_t* pbucket = lhmslv_get(pstate->pleft_buckets_by_join_field_values, pleft_field_values);
+		if (packed_key_fill_from_record(pstate->pjoin_key, pleft_copy, pstate->popts->pleft_join_field_names)) {
+			join_bucket_t* pbucket = lhmpkv_get(pstate->pleft_buckets_by_join_field_values, pstate->pjoin_key);
 			if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
-				slls_t* pkey_field_values_copy = slls_copy(pleft_field_values);
 				join_bucket_t* pbucket = mlr_malloc_or_die(sizeof(join_bucket_t));
 				pbucket->precords = sllv_alloc();
 				pbucket->was_paired = FALSE;
-				pbucket->pleft_field_values = slls_copy(pleft_field_values);
-				lhmslv_put(pstate->pleft_buckets_by_join_field_values, pkey_field_values_copy, pbucket,
-					FREE_ENTRY_KEY);
+				pbucket->pleft_field_values = NULL; // only the sorted-input bucket keeper needs these
+				lhmpkv_put(pstate->pleft_buckets_by_join_field_values, pstate->pjoin_key, pbucket);
 				sllv_append(pbucket->precords, pleft_copy);
 			} else { // Previously seen key-field-value: append record to bucket
 				sllv_append(pbucket->precords, pleft_copy);
 			}
-			slls_free(pleft_field_values);
 		} else {
 			sllv_append(pstate->pleft_unpaired_records, pleft_copy);
 		}
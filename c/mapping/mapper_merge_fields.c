@@ -12,6 +12,7 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mlrval.h"
 #include "mapping/mappers.h"
 #include "mapping/stats1_accumulators.h"
@@ -279,7 +280,8 @@ static sllv_t* mapper_merge_fields_process_by_name_list(lrec_t* pinrec, context_
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, FALSE, PERCENTILE_SKETCH_DEFAULT_K,
+	    pinaccs, poutaccs);
 
 	for (sllse_t* pb = pstate->pvalue_field_names->phead; pb != NULL; pb = pb->pnext) {
 		char* field_name = pb->value;
@@ -354,7 +356,8 @@ static sllv_t* mapper_merge_fields_process_by_name_regex(lrec_t* pinrec, context
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, FALSE, PERCENTILE_SKETCH_DEFAULT_K,
+	    pinaccs, poutaccs);
 
 	for (lrece_t* pb = pinrec->phead; pb != NULL; /* increment inside loop */ ) {
 		char* field_name = pb->key;
@@ -462,7 +465,7 @@ static sllv_t* mapper_merge_fields_process_by_collapsing(lrec_t* pinrec, context
 
 					make_stats1_accs(short_name, pstate->paccumulator_names,
 						pstate->allow_int_float, pstate->do_interpolated_percentiles,
-						in_acc_map_for_short_name, out_acc_map_for_short_name);
+						FALSE, PERCENTILE_SKETCH_DEFAULT_K, in_acc_map_for_short_name, out_acc_map_for_short_name);
 
 					lhmsv_put(short_names_to_in_acc_maps, mlr_strdup_or_die(short_name), in_acc_map_for_short_name,
 						FREE_ENTRY_KEY);
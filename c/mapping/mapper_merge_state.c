@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "containers/sllv.h"
+#include "containers/slls.h"
+#include "mapping/mappers.h"
+#include "mapping/aggregate_state.h"
+
+typedef struct _mapper_merge_state_state_t {
+	mapper_t* pmerged;        // the verb which wrote the state files, with their state merged in
+	char**    merged_argv;
+	sllv_t*   preaders;       // kept for the strings the merged mapper references
+} mapper_merge_state_state_t;
+
+static void      mapper_merge_state_usage(FILE* o, char* argv0, char* verb);
+static mapper_t* mapper_merge_state_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts);
+static mapper_t* mapper_merge_state_alloc(slls_t* pfilenames, char* state_filename, char* argv0,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts);
+static void      mapper_merge_state_free(mapper_t* pmapper, context_t* pctx);
+static sllv_t*   mapper_merge_state_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+
+// Verbs taking --write-state.
+static mapper_setup_t* mergeable_setups[] = {
+	&mapper_count_setup,
+	&mapper_count_distinct_setup,
+	&mapper_stats1_setup,
+	&mapper_stats2_setup,
+	&mapper_top_setup,
+};
+static int num_mergeable_setups = sizeof(mergeable_setups) / sizeof(mergeable_setups[0]);
+
+// ----------------------------------------------------------------
+mapper_setup_t mapper_merge_state_setup = {
+	.verb = "merge-state",
+	.pusage_func = mapper_merge_state_usage,
+	.pparse_func = mapper_merge_state_parse_cli,
+	.ignores_input = TRUE,
+};
+
+// ----------------------------------------------------------------
+static void mapper_merge_state_usage(FILE* o, char* argv0, char* verb) {
+	fprintf(o, "Usage: %s %s [options] {state-file names}\n", argv0, verb);
+	fprintf(o, "Combines the state files which count, count-distinct, stats1, stats2 or top\n");
+	fprintf(o, "write with --write-state, e.g. from runs over separate parts of the input, and\n");
+	fprintf(o, "emits what a single run of that verb over all of that input would have. The\n");
+	fprintf(o, "files must all be from the same verb with the same options. Given in the order\n");
+	fprintf(o, "of their input, groups are output in the same order as from a single run.\n");
+	fprintf(o, "Floating-point sums, and statistics computed from them, may differ from a\n");
+	fprintf(o, "single run's in the last digits, from rounding.\n");
+	fprintf(o, "State-file names are taken up to the end of the command line, or up to \"then\".\n");
+	fprintf(o, "Input records, if any, are discarded.\n");
+	fprintf(o, "Options:\n");
+	fprintf(o, "--write-state {filename} Also write the merged state to this file, to be merged\n");
+	fprintf(o, "                         again.\n");
+	fprintf(o, "Example: %s --shard 1/2 stats1 -a mean,p50 -f x -g a --write-state s1 data.csv\n", argv0);
+	fprintf(o, "         %s --shard 2/2 stats1 -a mean,p50 -f x -g a --write-state s2 data.csv\n", argv0);
+	fprintf(o, "         %s %s s1 s2\n", argv0, verb);
+}
+
+static mapper_t* mapper_merge_state_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts)
+{
+	char* verb = argv[(*pargi)++];
+	char* state_filename = NULL;
+
+	if (*pargi + 1 < argc && streq(argv[*pargi], MLR_STATE_FLAG)) {
+		state_filename = argv[*pargi + 1];
+		*pargi += 2;
+	}
+
+	slls_t* pfilenames = slls_alloc();
+	for ( ; *pargi < argc && !streq(argv[*pargi], "then"); (*pargi)++)
+		slls_append_no_free(pfilenames, argv[*pargi]);
+	if (pfilenames->length == 0) {
+		mapper_merge_state_usage(stderr, argv[0], verb);
+		slls_free(pfilenames);
+		return NULL;
+	}
+
+	mapper_t* pmapper = mapper_merge_state_alloc(pfilenames, state_filename, argv[0],
+		pmain_reader_opts, pmain_writer_opts);
+	slls_free(pfilenames);
+	return pmapper;
+}
+
+// ----------------------------------------------------------------
+// The merged verb is set up from the arguments stored in the first state file, as if from the command
+// line, then the files' states are merged into it in order.
+static mapper_t* mapper_merge_state_alloc(slls_t* pfilenames, char* state_filename, char* argv0,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts)
+{
+	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
+	mapper_merge_state_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_merge_state_state_t));
+	pstate->preaders = sllv_alloc();
+
+	aggregate_state_reader_t* pfirst = NULL;
+	for (sllse_t* pe = pfilenames->phead; pe != NULL; pe = pe->pnext) {
+		aggregate_state_reader_t* preader = aggregate_state_reader_alloc(pe->value);
+		if (pfirst == NULL) {
+			pfirst = preader;
+		} else if (!streq(preader->verb, pfirst->verb) || !slls_equals(preader->pargs, pfirst->pargs)) {
+			fprintf(stderr, "%s merge-state: \"%s\" and \"%s\" are from different verbs or options.\n",
+				MLR_GLOBALS.bargv0, pfirst->filename, preader->filename);
+			exit(1);
+		}
+		sllv_append(pstate->preaders, preader);
+	}
+
+	mapper_setup_t* psetup = NULL;
+	for (int i = 0; i < num_mergeable_setups; i++)
+		if (streq(mergeable_setups[i]->verb, pfirst->verb))
+			psetup = mergeable_setups[i];
+	if (psetup == NULL)
+		aggregate_state_corrupt(pfirst);
+
+	int merged_argc = 2 + pfirst->pargs->length + (state_filename == NULL ? 0 : 2);
+	pstate->merged_argv = mlr_malloc_or_die((merged_argc + 1) * sizeof(char*));
+	int argi = 0;
+	pstate->merged_argv[argi++] = argv0;
+	pstate->merged_argv[argi++] = pfirst->verb;
+	for (sllse_t* pe = pfirst->pargs->phead; pe != NULL; pe = pe->pnext)
+		pstate->merged_argv[argi++] = pe->value;
+	if (state_filename != NULL) {
+		pstate->merged_argv[argi++] = MLR_STATE_FLAG;
+		pstate->merged_argv[argi++] = state_filename;
+	}
+	pstate->merged_argv[argi] = NULL;
+
+	argi = 1;
+	pstate->pmerged = psetup->pparse_func(&argi, merged_argc, pstate->merged_argv,
+		pmain_reader_opts, pmain_writer_opts);
+	if (pstate->pmerged == NULL) {
+		fprintf(stderr, "%s merge-state: could not set up %s from \"%s\".\n",
+			MLR_GLOBALS.bargv0, pfirst->verb, pfirst->filename);
+		exit(1);
+	}
+	if (argi != merged_argc)
+		aggregate_state_corrupt(pfirst);
+
+	for (sllve_t* pe = pstate->preaders->phead; pe != NULL; pe = pe->pnext) {
+		aggregate_state_reader_t* preader = pe->pvvalue;
+		psetup->pmerge_state_func(pstate->pmerged, preader);
+		aggregate_state_check_end(preader);
+	}
+
+	pmapper->pvstate       = pstate;
+	pmapper->pprocess_func = mapper_merge_state_process;
+	pmapper->pfree_func    = mapper_merge_state_free;
+
+	return pmapper;
+}
+
+static void mapper_merge_state_free(mapper_t* pmapper, context_t* pctx) {
+	mapper_merge_state_state_t* pstate = pmapper->pvstate;
+	pstate->pmerged->pfree_func(pstate->pmerged, pctx);
+	for (sllve_t* pe = pstate->preaders->phead; pe != NULL; pe = pe->pnext)
+		aggregate_state_reader_free(pe->pvvalue);
+	sllv_free(pstate->preaders);
+	free(pstate->merged_argv);
+	free(pstate);
+	free(pmapper);
+}
+
+// ----------------------------------------------------------------
+static sllv_t* mapper_merge_state_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_merge_state_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+	return pstate->pmerged->pprocess_func(NULL, pctx, pstate->pmerged->pvstate);
+}
@@ -1,17 +1,22 @@
 #include <stdio.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/frequent_keeper.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
 #define DEFAULT_MAX_OUTPUT_LENGTH 10LL
 #define DEFAULT_OUTPUT_FIELD_NAME "count"
+#define DEFAULT_CAPACITY_MULTIPLIER 100LL
+#define CAPACITY_NOT_GIVEN LLONG_MIN
 
 typedef struct _mapper_most_or_least_frequent_state_t {
 	ap_state_t* pargp;
@@ -21,6 +26,8 @@ typedef struct _mapper_most_or_least_frequent_state_t {
 	int         descending;
 	int         show_counts;
 	char*       output_field_name;
+	char*       error_field_name;
+	frequent_keeper_t* pfrequent_keeper; // for most-frequent --approx, else NULL
 } mapper_most_or_least_frequent_state_t;
 
 static void mapper_most_frequent_usage(FILE*  o, char* argv0, char* verb);
@@ -31,10 +38,11 @@ static mapper_t* mapper_least_frequent_parse_cli(int* pargi, int argc, char** ar
 static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, char** argv, int descending);
 
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name);
+	long long max_output_length, int descending, int show_counts, char* output_field_name, long long capacity);
 static void      mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _);
 
 static sllv_t*   mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_most_frequent_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // qsort callbacks
 static int descending_vcmp(const void* pva, const void* pvb);
@@ -70,6 +78,13 @@ static void mapper_most_frequent_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-n {count}. Optional flag defaulting to %lld.\n", DEFAULT_MAX_OUTPUT_LENGTH);
 	fprintf(o, "-b          Suppress counts; show only field values.\n");
 	fprintf(o, "-o {name}   Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--approx    Track only a bounded number of distinct values, using the\n");
+	fprintf(o, "            Space-Saving algorithm, for high-cardinality fields. Counts may then\n");
+	fprintf(o, "            be overestimates, by at most the amount in an added field named as\n");
+	fprintf(o, "            the count field with \"_error\" appended. Values occurring more than\n");
+	fprintf(o, "            1/capacity of the time are sure to be found.\n");
+	fprintf(o, "--capacity {k} Number of values to track with --approx. Default %lld times -n.\n",
+		DEFAULT_CAPACITY_MULTIPLIER);
 	fprintf(o, "See also \"%s %s\".\n", argv0, "least-frequent");
 }
 
@@ -102,6 +117,8 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 	long long max_output_length     = DEFAULT_MAX_OUTPUT_LENGTH;
 	int       show_counts           = TRUE;
 	char*     output_field_name     = DEFAULT_OUTPUT_FIELD_NAME;
+	int       do_approx             = FALSE;
+	long long capacity              = CAPACITY_NOT_GIVEN;
 
 	char* verb = argv[(*pargi)++];
 
@@ -110,6 +127,10 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 	ap_define_long_long_flag(pstate,   "-n", &max_output_length);
 	ap_define_false_flag(pstate,       "-b", &show_counts);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
+	if (descending) {
+		ap_define_true_flag(pstate,        "--approx", &do_approx);
+		ap_define_long_long_flag(pstate,   "--capacity", &capacity);
+	}
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_most_frequent_usage(stderr, argv[0], verb);
@@ -120,14 +141,34 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 		mapper_most_frequent_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (capacity != CAPACITY_NOT_GIVEN) {
+		if (!do_approx) {
+			fprintf(stderr, "%s %s: --capacity requires --approx.\n", MLR_GLOBALS.bargv0, verb);
+			return NULL;
+		}
+		if (capacity < 1LL) {
+			fprintf(stderr, "%s %s: --capacity must be at least 1; got %lld.\n", MLR_GLOBALS.bargv0, verb,
+				capacity);
+			return NULL;
+		}
+	}
+	if (do_approx) {
+		if (capacity == CAPACITY_NOT_GIVEN)
+			capacity = DEFAULT_CAPACITY_MULTIPLIER * max_output_length;
+		if (capacity < 1LL || capacity < max_output_length || capacity > INT_MAX / 4) {
+			mapper_most_frequent_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+	}
 
 	return mapper_most_or_least_frequent_alloc(pstate, pgroup_by_field_names, max_output_length, descending,
-		show_counts, output_field_name);
+		show_counts, output_field_name, do_approx ? capacity : 0LL);
 }
 
 // ----------------------------------------------------------------
+// Capacity is zero except for most-frequent --approx.
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name)
+	long long max_output_length, int descending, int show_counts, char* output_field_name, long long capacity)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -140,9 +181,13 @@ static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t*
 	pstate->descending            = descending;
 	pstate->show_counts           = show_counts;
 	pstate->output_field_name     = output_field_name;
+	pstate->error_field_name      = mlr_paste_2_strings(output_field_name, "_error");
+	pstate->pfrequent_keeper      = (capacity > 0LL) ? frequent_keeper_alloc(capacity) : NULL;
 
 	pmapper->pvstate       = pstate;
-	pmapper->pprocess_func = mapper_most_or_least_frequent_process;
+	pmapper->pprocess_func = (capacity > 0LL)
+		? mapper_most_frequent_process_approx
+		: mapper_most_or_least_frequent_process;
 	pmapper->pfree_func    = mapper_most_or_least_frequent_free;
 
 	return pmapper;
@@ -157,6 +202,8 @@ static void mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _)
 		free(pcount);
 	}
 	lhmslv_free(pstate->pcounts_by_group);
+	frequent_keeper_free(pstate->pfrequent_keeper);
+	free(pstate->error_field_name);
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 	ap_free(pstate->pargp);
@@ -225,6 +272,47 @@ static sllv_t* mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t*
 	}
 }
 
+// ----------------------------------------------------------------
+static sllv_t* mapper_most_frequent_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_most_or_least_frequent_state_t* pstate = pvstate;
+
+	if (pinrec != NULL) { // Not end of input record stream
+		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
+			pstate->pgroup_by_field_names);
+		if (pgroup_by_field_values != NULL) {
+			frequent_keeper_add(pstate->pfrequent_keeper, pgroup_by_field_values);
+			slls_free(pgroup_by_field_values);
+		}
+		lrec_free(pinrec);
+		return NULL;
+
+	} else { // End of input record stream
+		frequent_keeper_entry_t** pentries = frequent_keeper_sorted_entries(pstate->pfrequent_keeper);
+		sllv_t* poutrecs = sllv_alloc();
+		int input_length = pstate->pfrequent_keeper->size;
+		int output_length = (input_length < pstate->max_output_length) ? input_length : pstate->max_output_length;
+		for (int i = 0; i < output_length; i++) {
+			lrec_t* poutrec = lrec_unbacked_alloc();
+			sllse_t* pb = pstate->pgroup_by_field_names->phead;
+			sllse_t* pc = pentries[i]->pvalues->phead;
+			for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
+				lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+			}
+			if (pstate->show_counts) {
+				lrec_put(poutrec, pstate->output_field_name,
+					mlr_alloc_string_from_ull(pentries[i]->count), FREE_ENTRY_VALUE);
+				lrec_put(poutrec, pstate->error_field_name,
+					mlr_alloc_string_from_ull(pentries[i]->error), FREE_ENTRY_VALUE);
+			}
+			sllv_append(poutrecs, poutrec);
+		}
+		sllv_append(poutrecs, NULL);
+
+		free(pentries);
+		return poutrecs;
+	}
+}
+
 static int descending_vcmp(const void* pva, const void* pvb) {
 	const sort_pair_t* pa = pva;
 	const sort_pair_t* pb = pvb;
@@ -8,6 +8,8 @@ static mapper_t* mapper_nothing_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_nothing_alloc();
 static void      mapper_nothing_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_nothing_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static lrec_reader_count_sink_t* mapper_nothing_input_count_sink(mapper_t* pmapper);
 static sllv_t*   mapper_nothing_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
@@ -16,6 +18,8 @@ mapper_setup_t mapper_nothing_setup = {
 	.pusage_func = mapper_nothing_usage,
 	.pparse_func = mapper_nothing_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_nothing_input_fields,
+	.pinput_count_sink_func = mapper_nothing_input_count_sink,
 };
 
 // ----------------------------------------------------------------
@@ -49,6 +53,25 @@ static void mapper_nothing_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_nothing_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	return MAPPER_USES_ONLY_THESE_FIELDS;
+}
+
+// ----------------------------------------------------------------
+// Records are dropped unseen, so a count of them will do as well.
+static void mapper_nothing_count_records(void* pvstate, long long record_count, context_t* pctx) {
+}
+
+static lrec_reader_count_sink_t mapper_nothing_count_sink = {
+	.pcount_func = mapper_nothing_count_records,
+	.pvstate     = NULL,
+};
+
+static lrec_reader_count_sink_t* mapper_nothing_input_count_sink(mapper_t* pmapper) {
+	return &mapper_nothing_count_sink;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_nothing_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL) {
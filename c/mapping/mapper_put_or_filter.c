@@ -1,3 +1,5 @@
+#include <math.h>
+#include <limits.h>
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
 #include "lib/string_builder.h"
@@ -9,6 +11,7 @@
 #include "parsing/mlr_dsl_wrapper.h"
 #include "dsl/rval_evaluators.h"
 #include "dsl/mlr_dsl_cst.h"
+#include "dsl/context_flags.h"
 #include "mapping/mappers.h"
 
 #define DEFAULT_OOSVAR_FLATTEN_SEPARATOR ":"
@@ -34,8 +37,32 @@ typedef struct _mapper_put_or_filter_state_t {
 	int            put_output_disabled; // mlr put -q
 	int            do_final_filter;     // mlr filter
 	int            negate_final_filter; // mlr filter -x
+
+	slls_t*        pinput_field_names;  // $-names in the expression, for projection pushdown
+	int            uses_all_fields;
+
+	// For predicate pushdown: the filter expression, evaluated apart from the CST.
+	rval_evaluator_t*       ppushdown_evaluator;
+	lhmsmv_t*               ppushdown_typed_overlay; // always empty
+	lrec_reader_predicate_t record_predicate;
+	sllv_t*                 prange_comparisons; // of range_comparison_t*
+
+	// For indexed input: the zero-up record numbers [nr_range_start, nr_range_end) which leading
+	// comparisons of NR in the filter expression allow.
+	int                         has_nr_range;
+	long long                   nr_range_start;
+	long long                   nr_range_end;
+	lrec_reader_record_ranges_t record_ranges;
 } mapper_put_or_filter_state_t;
 
+// A comparison of a field against a number, within a pushed-down filter, for readers which can skip
+// blocks of records by the fields' minima and maxima.
+typedef struct _range_comparison_t {
+	char*  field_name;
+	char*  op; // with the field on the left
+	double value;
+} range_comparison_t;
+
 typedef struct _expression_info_t {
 	char* filename;
 	char* expression;
@@ -71,6 +98,17 @@ static mapper_t* mapper_put_or_filter_alloc(
 	cli_writer_opts_t* pmain_writer_opts);
 
 static void      mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx);
+static mapper_input_fields_t mapper_put_or_filter_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static int       collect_named_fields(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names);
+static lrec_reader_predicate_t* mapper_filter_input_predicate(mapper_t* pmapper);
+static int       mapper_filter_record_predicate(void* pvstate, lrec_t* prec, context_t* pctx);
+static int       is_pushable_conjunction(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names);
+static int       mapper_filter_excludes_range(void* pvstate, char* field_name, double min, double max);
+static void      collect_range_comparisons(mlr_dsl_ast_node_t* pnode, sllv_t* pcomparisons);
+static lrec_reader_record_ranges_t* mapper_filter_input_record_ranges(mapper_t* pmapper);
+static int       mapper_filter_record_ranges(void* pvstate, long long num_records,
+	lrec_reader_record_range_t** pranges);
+static int       collect_nr_range(mlr_dsl_ast_node_t* pnode, long long* pstart, long long* pend, int* pfound);
 
 static sllv_t*   mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -80,6 +118,7 @@ mapper_setup_t mapper_put_setup = {
 	.pusage_func = mapper_put_usage,
 	.pparse_func = mapper_put_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_put_or_filter_input_fields,
 };
 
 mapper_setup_t mapper_filter_setup = {
@@ -87,6 +126,9 @@ mapper_setup_t mapper_filter_setup = {
 	.pusage_func = mapper_filter_usage,
 	.pparse_func = mapper_filter_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_put_or_filter_input_fields,
+	.pinput_predicate_func = mapper_filter_input_predicate,
+	.pinput_record_ranges_func = mapper_filter_input_record_ranges,
 };
 
 // ----------------------------------------------------------------
@@ -422,10 +464,52 @@ static mapper_t* mapper_put_or_filter_alloc(
 	// Retain the string contents along with any in-pointers from the AST/CST
 	pstate->mlr_dsl_expression = mlr_dsl_expression;
 	pstate->past                     = past;
+	// This needs the AST as parsed, before the CST-builder reorganizes it.
+	pstate->pinput_field_names           = slls_alloc();
+	pstate->uses_all_fields              = (past->proot == NULL)
+		? FALSE
+		: !collect_named_fields(past->proot, pstate->pinput_field_names);
+	pstate->ppushdown_evaluator          = NULL;
+	pstate->ppushdown_typed_overlay      = NULL;
+	pstate->record_predicate.pfield_names = slls_alloc();
+	pstate->prange_comparisons           = sllv_alloc();
+	if (do_final_filter && !put_output_disabled && past->proot != NULL
+		&& past->proot->pchildren->length == 1
+		&& is_pushable_conjunction(past->proot->pchildren->phead->pvvalue, pstate->record_predicate.pfield_names))
+	{
+		// Resolve the operators' callsites right away: there are no UDFs to wait for.
+		fmgr_t* pfmgr = fmgr_alloc();
+		pstate->ppushdown_evaluator = rval_evaluator_alloc_from_ast(past->proot->pchildren->phead->pvvalue,
+			pfmgr, type_inferencing, IN_MLR_FILTER);
+		fmgr_resolve_func_callsites(pfmgr);
+		fmgr_free(pfmgr, NULL);
+		pstate->ppushdown_typed_overlay = lhmsmv_alloc();
+		// Comparisons are numeric only if fields' values are type-inferred. With -x, a block could be
+		// skipped only if the comparisons all held throughout it, which minima and maxima rarely show.
+		if (type_inferencing != TYPE_INFER_STRING_ONLY && !negate_final_filter)
+			collect_range_comparisons(past->proot->pchildren->phead->pvvalue, pstate->prange_comparisons);
+	}
+	pstate->record_predicate.ptest_func  = mapper_filter_record_predicate;
+	pstate->record_predicate.pexcludes_range_func = (pstate->prange_comparisons->length > 0)
+		? mapper_filter_excludes_range
+		: NULL;
+	pstate->record_predicate.pvstate     = pstate;
+	pstate->has_nr_range                 = FALSE;
+	pstate->nr_range_start               = 0LL;
+	pstate->nr_range_end                 = LLONG_MAX;
+	if (do_final_filter && !put_output_disabled && !negate_final_filter && past->proot != NULL
+		&& past->proot->pchildren->length == 1 && type_inferencing != TYPE_INFER_STRING_ONLY)
+	{
+		collect_nr_range(past->proot->pchildren->phead->pvvalue, &pstate->nr_range_start, &pstate->nr_range_end,
+			&pstate->has_nr_range);
+	}
+	pstate->record_ranges.pranges_func   = mapper_filter_record_ranges;
+	pstate->record_ranges.pvstate        = pstate;
 	pstate->pcst                     = mlr_dsl_cst_alloc(past, print_ast, trace_stack_allocation,
 		type_inferencing, flush_every_record, do_final_filter, negate_final_filter);
 	pstate->at_begin                     = TRUE;
 	pstate->put_output_disabled          = put_output_disabled;
+	pstate->negate_final_filter          = negate_final_filter;
 	pstate->poosvars                     = mlhmmv_root_alloc();
 	pstate->trace_execution              = trace_execution;
 	pstate->oosvar_flatten_separator     = oosvar_flatten_separator;
@@ -455,11 +539,313 @@ static void mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx) {
 	// Free what's left of the stripped AST after the CST reorganized it.
 	mlr_dsl_ast_free(pstate->past);
 
+	slls_free(pstate->pinput_field_names);
+	if (pstate->ppushdown_evaluator != NULL) {
+		pstate->ppushdown_evaluator->pfree_func(pstate->ppushdown_evaluator);
+		lhmsmv_free(pstate->ppushdown_typed_overlay);
+	}
+	slls_free(pstate->record_predicate.pfield_names);
+	for (sllve_t* pe = pstate->prange_comparisons->phead; pe != NULL; pe = pe->pnext)
+		free(pe->pvvalue);
+	sllv_free(pstate->prange_comparisons);
+
 	free(pstate->pwriter_opts);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// Records are passed along (or not) with fields assigned by name, so the output depends on the
+// fields the expression names -- unless it can get at fields some other way.
+static mapper_input_fields_t mapper_put_or_filter_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_put_or_filter_state_t* pstate = pmapper->pvstate;
+	if (pstate->uses_all_fields)
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pinput_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+}
+
+// Appends $-names to the list. Returns FALSE if the expression can reach fields not named in it: $*,
+// $[...], for-loops over the record, tee, or NF.
+static int collect_named_fields(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names) {
+	switch (pnode->type) {
+	case MD_AST_NODE_TYPE_FIELD_NAME:
+		slls_append_no_free(pfield_names, pnode->text);
+		break;
+	case MD_AST_NODE_TYPE_FULL_SREC:
+	case MD_AST_NODE_TYPE_INDIRECT_FIELD_NAME:
+	case MD_AST_NODE_TYPE_INDIRECT_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_OOSVAR_FROM_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FULL_OOSVAR_FROM_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FOR_SREC:
+	case MD_AST_NODE_TYPE_FOR_SREC_KEY_ONLY:
+	case MD_AST_NODE_TYPE_TEE:
+		return FALSE;
+	case MD_AST_NODE_TYPE_CONTEXT_VARIABLE:
+		if (streq(pnode->text, "NF"))
+			return FALSE;
+		break;
+	default:
+		break;
+	}
+	if (pnode->pchildren != NULL) {
+		for (sllve_t* pe = pnode->pchildren->phead; pe != NULL; pe = pe->pnext) {
+			if (!collect_named_fields(pe->pvvalue, pfield_names))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+// Predicate pushdown applies when the whole filter expression is a conjunction of comparisons of
+// fields against literals, e.g. '$status == 500 && $url =~ "^/api"'. Then it depends on no state but
+// those fields, so the reader can evaluate it on them (and the filter will again on what's left).
+static lrec_reader_predicate_t* mapper_filter_input_predicate(mapper_t* pmapper) {
+	mapper_put_or_filter_state_t* pstate = pmapper->pvstate;
+	return (pstate->ppushdown_evaluator == NULL) ? NULL : &pstate->record_predicate;
+}
+
+// Returns FALSE only where the filter would quietly drop the record. Non-boolean results, which
+// are fatal in the filter, are left for it to report.
+static int mapper_filter_record_predicate(void* pvstate, lrec_t* prec, context_t* pctx) {
+	mapper_put_or_filter_state_t* pstate = pvstate;
+	string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
+
+	variables_t variables = (variables_t) {
+		.pinrec           = prec,
+		.ptyped_overlay   = pstate->ppushdown_typed_overlay,
+		.poosvars         = pstate->poosvars,
+		.ppregex_captures = &pregex_captures,
+		.pctx             = pctx,
+		.plocal_stack     = pstate->plocal_stack,
+		.ploop_stack      = pstate->ploop_stack,
+		.return_state = {
+			.returned = FALSE,
+			.retval = box_ephemeral_val(mv_absent()),
+		},
+		.trace_execution              = FALSE,
+		.json_quote_int_keys          = pstate->pwriter_opts->json_quote_int_keys,
+		.json_quote_non_string_values = pstate->pwriter_opts->json_quote_non_string_values,
+	};
+	mv_t val = pstate->ppushdown_evaluator->pprocess_func(pstate->ppushdown_evaluator->pvstate, &variables);
+	string_array_free(pregex_captures);
+
+	if (mv_is_null(&val))
+		return FALSE;
+	if (val.type == MT_BOOLEAN)
+		return val.u.boolv ^ pstate->negate_final_filter;
+	mv_free(&val);
+	return TRUE;
+}
+
+// Appends the field names to the list, and returns TRUE, if the expression is an &&-chain of
+// comparisons each between a field and a literal.
+static int is_pushable_conjunction(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names) {
+	if (pnode->type != MD_AST_NODE_TYPE_OPERATOR || pnode->pchildren == NULL || pnode->pchildren->length != 2)
+		return FALSE;
+	mlr_dsl_ast_node_t* pleft  = pnode->pchildren->phead->pvvalue;
+	mlr_dsl_ast_node_t* pright = pnode->pchildren->phead->pnext->pvvalue;
+
+	if (streq(pnode->text, "&&"))
+		return is_pushable_conjunction(pleft, pfield_names) && is_pushable_conjunction(pright, pfield_names);
+
+	if (streq(pnode->text, "=~") || streq(pnode->text, "!=~")) {
+		if (pleft->type != MD_AST_NODE_TYPE_FIELD_NAME)
+			return FALSE;
+		if (pright->type != MD_AST_NODE_TYPE_STRING_LITERAL && pright->type != MD_AST_NODE_TYPE_REGEXI)
+			return FALSE;
+		slls_append_no_free(pfield_names, pleft->text);
+		return TRUE;
+	}
+
+	if (streq(pnode->text, "==") || streq(pnode->text, "!=") || streq(pnode->text, "<")
+		|| streq(pnode->text, "<=") || streq(pnode->text, ">") || streq(pnode->text, ">="))
+	{
+		if (pright->type == MD_AST_NODE_TYPE_FIELD_NAME) {
+			mlr_dsl_ast_node_t* ptemp = pleft;
+			pleft = pright;
+			pright = ptemp;
+		}
+		if (pleft->type != MD_AST_NODE_TYPE_FIELD_NAME)
+			return FALSE;
+		if (pright->type != MD_AST_NODE_TYPE_STRING_LITERAL && pright->type != MD_AST_NODE_TYPE_NUMERIC_LITERAL)
+			return FALSE;
+		slls_append_no_free(pfield_names, pleft->text);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+// The field's values in the block are all numbers in [min, max]. The block can be skipped if any of
+// the comparisons on that field fails for all of them.
+static int mapper_filter_excludes_range(void* pvstate, char* field_name, double min, double max) {
+	mapper_put_or_filter_state_t* pstate = pvstate;
+	for (sllve_t* pe = pstate->prange_comparisons->phead; pe != NULL; pe = pe->pnext) {
+		range_comparison_t* pcomparison = pe->pvvalue;
+		if (!streq(pcomparison->field_name, field_name))
+			continue;
+		char*  op    = pcomparison->op;
+		double value = pcomparison->value;
+		if (streq(op, "==") && (value < min || value > max))
+			return TRUE;
+		if (streq(op, "!=") && (value == min && value == max))
+			return TRUE;
+		if (streq(op, "<") && min >= value)
+			return TRUE;
+		if (streq(op, "<=") && min > value)
+			return TRUE;
+		if (streq(op, ">") && max <= value)
+			return TRUE;
+		if (streq(op, ">=") && max < value)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+// Given a pushable conjunction, appends its comparisons of fields against numbers to the list. Numbers
+// too big for doubles to hold exactly are left out.
+static void collect_range_comparisons(mlr_dsl_ast_node_t* pnode, sllv_t* pcomparisons) {
+	mlr_dsl_ast_node_t* pleft  = pnode->pchildren->phead->pvvalue;
+	mlr_dsl_ast_node_t* pright = pnode->pchildren->phead->pnext->pvvalue;
+	char* op = pnode->text;
+
+	if (streq(op, "&&")) {
+		collect_range_comparisons(pleft, pcomparisons);
+		collect_range_comparisons(pright, pcomparisons);
+		return;
+	}
+	if (streq(op, "=~") || streq(op, "!=~"))
+		return;
+
+	if (pright->type == MD_AST_NODE_TYPE_FIELD_NAME) {
+		mlr_dsl_ast_node_t* ptemp = pleft;
+		pleft = pright;
+		pright = ptemp;
+		if (streq(op, "<"))
+			op = ">";
+		else if (streq(op, "<="))
+			op = ">=";
+		else if (streq(op, ">"))
+			op = "<";
+		else if (streq(op, ">="))
+			op = "<=";
+	}
+	if (pright->type != MD_AST_NODE_TYPE_NUMERIC_LITERAL)
+		return;
+	mv_t value = mv_scan_number_nullable(pright->text);
+	if (!mv_is_numeric(&value))
+		return;
+	double dvalue = (value.type == MT_INT) ? (double)value.u.intv : value.u.fltv;
+	if (fabs(dvalue) > 9007199254740992.0) // 2^53
+		return;
+
+	range_comparison_t* pcomparison = mlr_malloc_or_die(sizeof(range_comparison_t));
+	pcomparison->field_name = pleft->text;
+	pcomparison->op         = op;
+	pcomparison->value      = dvalue;
+	sllv_append(pcomparisons, pcomparison);
+}
+
+// ----------------------------------------------------------------
+// When the filter expression starts with comparisons of NR against numbers, e.g. 'NR > 1000000 && NR <=
+// 1000100', records outside the range they allow are dropped without the rest being looked at, so
+// with indexed input they needn't be read.
+static lrec_reader_record_ranges_t* mapper_filter_input_record_ranges(mapper_t* pmapper) {
+	mapper_put_or_filter_state_t* pstate = pmapper->pvstate;
+	return pstate->has_nr_range ? &pstate->record_ranges : NULL;
+}
+
+static int mapper_filter_record_ranges(void* pvstate, long long num_records,
+	lrec_reader_record_range_t** pranges)
+{
+	mapper_put_or_filter_state_t* pstate = pvstate;
+	long long start = pstate->nr_range_start;
+	long long end = (pstate->nr_range_end < num_records) ? pstate->nr_range_end : num_records;
+	if (start >= end) {
+		*pranges = NULL;
+		return 0;
+	}
+	lrec_reader_record_range_t* ranges = mlr_malloc_or_die(sizeof(lrec_reader_record_range_t));
+	ranges[0].start = start;
+	ranges[0].end   = end;
+	*pranges = ranges;
+	return 1;
+}
+
+// Narrows [*pstart, *pend) by the comparisons of NR against numbers at the start of an &&-chain,
+// setting *pfound if there are any. Returns FALSE on reaching anything else, after which the filter
+// might not get as far as the comparisons.
+static int collect_nr_range(mlr_dsl_ast_node_t* pnode, long long* pstart, long long* pend, int* pfound) {
+	if (pnode->type != MD_AST_NODE_TYPE_OPERATOR || pnode->pchildren == NULL || pnode->pchildren->length != 2)
+		return FALSE;
+	mlr_dsl_ast_node_t* pleft  = pnode->pchildren->phead->pvvalue;
+	mlr_dsl_ast_node_t* pright = pnode->pchildren->phead->pnext->pvvalue;
+	char* op = pnode->text;
+
+	if (streq(op, "&&"))
+		return collect_nr_range(pleft, pstart, pend, pfound) && collect_nr_range(pright, pstart, pend, pfound);
+
+	if (pright->type == MD_AST_NODE_TYPE_CONTEXT_VARIABLE) {
+		mlr_dsl_ast_node_t* ptemp = pleft;
+		pleft = pright;
+		pright = ptemp;
+		if (streq(op, "<"))
+			op = ">";
+		else if (streq(op, "<="))
+			op = ">=";
+		else if (streq(op, ">"))
+			op = "<";
+		else if (streq(op, ">="))
+			op = "<=";
+	}
+	if (pleft->type != MD_AST_NODE_TYPE_CONTEXT_VARIABLE || !streq(pleft->text, "NR"))
+		return FALSE;
+	if (pright->type != MD_AST_NODE_TYPE_NUMERIC_LITERAL)
+		return FALSE;
+	mv_t value = mv_scan_number_nullable(pright->text);
+	if (!mv_is_numeric(&value))
+		return FALSE;
+	double dvalue = (value.type == MT_INT) ? (double)value.u.intv : value.u.fltv;
+	if (isnan(dvalue))
+		return FALSE;
+	if (dvalue < -1.0)
+		dvalue = -1.0;
+	if (dvalue > 4611686018427387904.0) // 2^62
+		dvalue = 4611686018427387904.0;
+
+	// NR is one more than the zero-up record number.
+	long long start = 0LL;
+	long long end = LLONG_MAX;
+	if (streq(op, ">")) {
+		start = (long long)floor(dvalue);
+	} else if (streq(op, ">=")) {
+		start = (long long)ceil(dvalue) - 1;
+	} else if (streq(op, "<")) {
+		end = (long long)ceil(dvalue) - 1;
+	} else if (streq(op, "<=")) {
+		end = (long long)floor(dvalue);
+	} else if (streq(op, "==")) {
+		if (dvalue == floor(dvalue)) {
+			start = (long long)dvalue - 1;
+			end = (long long)dvalue;
+		} else {
+			end = 0LL;
+		}
+	} else {
+		return FALSE;
+	}
+	if (start > *pstart)
+		*pstart = start;
+	if (end < *pend)
+		*pend = end;
+	*pfound = TRUE;
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 // The typed-overlay holds intermediate values such as in
 //
@@ -23,12 +23,22 @@ sample_bucket_t* sample_bucket_alloc(int nalloc);
 void             sample_bucket_free(sample_bucket_t* pbucket);
 void             sample_bucket_handle(sample_bucket_t* pbucket, lrec_t* prec, int record_number);
 
+typedef struct _sample_pick_t {
+	long long record_number; // zero-up
+	int slot;
+} sample_pick_t;
+
 // ----------------------------------------------------------------
 typedef struct _mapper_sample_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
 	unsigned long long sample_count;
 	lhmslv_t* pbuckets_by_group;
+	lrec_reader_record_ranges_t record_ranges;
+	// With indexed input, the record numbers to be read and their places in the sample: see
+	// mapper_sample_record_ranges. Else NULL.
+	sample_pick_t* picks;
+	long long num_picks;
 } mapper_sample_state_t;
 
 static void      mapper_sample_usage(FILE* o, char* argv0, char* verb);
@@ -38,6 +48,11 @@ static mapper_t* mapper_sample_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_
 	unsigned long long sample_count);
 static void      mapper_sample_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_sample_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static lrec_reader_record_ranges_t* mapper_sample_input_record_ranges(mapper_t* pmapper);
+static int       mapper_sample_record_ranges(void* pvstate, long long num_records,
+	lrec_reader_record_range_t** pranges);
+static void      mapper_sample_place(mapper_sample_state_t* pstate, lrec_t* pinrec, long long record_number);
+static int       sample_pick_cmp(const void* pva, const void* pvb);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_sample_setup = {
@@ -45,6 +60,7 @@ mapper_setup_t mapper_sample_setup = {
 	.pusage_func = mapper_sample_usage,
 	.pparse_func = mapper_sample_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_record_ranges_func = mapper_sample_input_record_ranges,
 };
 
 // ----------------------------------------------------------------
@@ -92,6 +108,10 @@ static mapper_t* mapper_sample_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
 	pstate->sample_count          = sample_count;
 	pstate->pbuckets_by_group     = lhmslv_alloc();
+	pstate->record_ranges.pranges_func = mapper_sample_record_ranges;
+	pstate->record_ranges.pvstate      = pstate;
+	pstate->picks                 = NULL;
+	pstate->num_picks             = 0LL;
 
 	pmapper->pvstate              = pstate;
 	pmapper->pprocess_func        = mapper_sample_process;
@@ -110,6 +130,7 @@ static void mapper_sample_free(mapper_t* pmapper, context_t* _) {
 		sample_bucket_free(pbucket);
 	}
 	lhmslv_free(pstate->pbuckets_by_group);
+	free(pstate->picks);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -118,6 +139,10 @@ static void mapper_sample_free(mapper_t* pmapper, context_t* _) {
 // ----------------------------------------------------------------
 static sllv_t* mapper_sample_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_sample_state_t* pstate = pvstate;
+	if (pinrec != NULL && pstate->picks != NULL) {
+		mapper_sample_place(pstate, pinrec, pctx->nr - 1);
+		return NULL;
+	}
 	if (pinrec != NULL) {
 		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
 			pstate->pgroup_by_field_names);
@@ -141,7 +166,8 @@ static sllv_t* mapper_sample_process(lrec_t* pinrec, context_t* pctx, void* pvst
 		for (lhmslve_t* pa = pstate->pbuckets_by_group->phead; pa != NULL; pa = pa->pnext) {
 			sample_bucket_t* pbucket = pa->pvvalue;
 			for (int i = 0; i < pbucket->nused; i++) {
-				sllv_append(poutrecs, pbucket->plrecs[i]);
+				if (pbucket->plrecs[i] != NULL) // not if a picked record wasn't there to be read
+					sllv_append(poutrecs, pbucket->plrecs[i]);
 				pbucket->plrecs[i] = NULL;
 			}
 			pbucket->nused = 0;
@@ -151,6 +177,107 @@ static sllv_t* mapper_sample_process(lrec_t* pinrec, context_t* pctx, void* pvst
 	}
 }
 
+// ----------------------------------------------------------------
+// Without -g, when the record count is known up front from indexed input, only the records which will
+// be in the sample need be read. Which those are depends only on the random draws and the record
+// numbers, not on the records, so the draws are made here just as sample_bucket_handle would make them
+// reading everything: the seeded sample is the same, in the same order, with or without an index.
+static lrec_reader_record_ranges_t* mapper_sample_input_record_ranges(mapper_t* pmapper) {
+	mapper_sample_state_t* pstate = pmapper->pvstate;
+	return (pstate->pgroup_by_field_names->length == 0) ? &pstate->record_ranges : NULL;
+}
+
+static int mapper_sample_record_ranges(void* pvstate, long long num_records,
+	lrec_reader_record_range_t** pranges)
+{
+	mapper_sample_state_t* pstate = pvstate;
+	long long sample_count = pstate->sample_count;
+
+	// For large samples, reading everything costs about the same as skipping around.
+	if (sample_count > 0LL && 2 * sample_count >= num_records) {
+		lrec_reader_record_range_t* ranges = mlr_malloc_or_die(sizeof(lrec_reader_record_range_t));
+		ranges[0].start = 0LL;
+		ranges[0].end   = num_records;
+		*pranges = ranges;
+		return 1;
+	}
+	if (sample_count <= 0LL) {
+		for (long long record_number = 1LL; record_number <= num_records; record_number++)
+			(void)get_mtrand_int31();
+		*pranges = NULL;
+		return 0;
+	}
+
+	// The reservoir's slots, by the record each ends up holding.
+	long long* slot_record_numbers = mlr_malloc_or_die(sample_count * sizeof(long long));
+	for (long long i = 0LL; i < sample_count; i++)
+		slot_record_numbers[i] = i;
+	for (long long record_number = sample_count + 1; record_number <= num_records; record_number++) {
+		int r = get_mtrand_int31() % (int)record_number;
+		if (r < sample_count)
+			slot_record_numbers[r] = record_number - 1;
+	}
+
+	sample_pick_t* picks = mlr_malloc_or_die(sample_count * sizeof(sample_pick_t));
+	for (long long i = 0LL; i < sample_count; i++) {
+		picks[i].record_number = slot_record_numbers[i];
+		picks[i].slot = i;
+	}
+	free(slot_record_numbers);
+	qsort(picks, sample_count, sizeof(sample_pick_t), sample_pick_cmp);
+
+	// Adjacent record numbers make one range.
+	lrec_reader_record_range_t* ranges = mlr_malloc_or_die(sample_count * sizeof(lrec_reader_record_range_t));
+	int num_ranges = 0;
+	for (long long i = 0; i < sample_count; i++) {
+		if (num_ranges > 0 && ranges[num_ranges - 1].end == picks[i].record_number) {
+			ranges[num_ranges - 1].end++;
+		} else {
+			ranges[num_ranges].start = picks[i].record_number;
+			ranges[num_ranges].end   = picks[i].record_number + 1;
+			num_ranges++;
+		}
+	}
+
+	sample_bucket_t* pbucket = sample_bucket_alloc(sample_count);
+	for (int i = 0; i < pbucket->nalloc; i++)
+		pbucket->plrecs[i] = NULL;
+	pbucket->nused = pbucket->nalloc;
+	lhmslv_put(pstate->pbuckets_by_group, slls_alloc(), pbucket, FREE_ENTRY_KEY);
+	pstate->picks = picks;
+	pstate->num_picks = sample_count;
+
+	*pranges = ranges;
+	return num_ranges;
+}
+
+// Puts a record read from indexed input into its slot in the sample.
+static void mapper_sample_place(mapper_sample_state_t* pstate, lrec_t* pinrec, long long record_number) {
+	sample_bucket_t* pbucket = pstate->pbuckets_by_group->phead->pvvalue;
+	long long lo = 0LL;
+	long long hi = pstate->num_picks - 1;
+	while (lo <= hi) {
+		long long mid = lo + (hi - lo) / 2;
+		if (pstate->picks[mid].record_number < record_number) {
+			lo = mid + 1;
+		} else if (pstate->picks[mid].record_number > record_number) {
+			hi = mid - 1;
+		} else {
+			int slot = pstate->picks[mid].slot;
+			lrec_free(pbucket->plrecs[slot]);
+			pbucket->plrecs[slot] = pinrec;
+			return;
+		}
+	}
+	lrec_free(pinrec);
+}
+
+static int sample_pick_cmp(const void* pva, const void* pvb) {
+	long long a = ((const sample_pick_t*)pva)->record_number;
+	long long b = ((const sample_pick_t*)pvb)->record_number;
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
 // ----------------------------------------------------------------
 sample_bucket_t* sample_bucket_alloc(int nalloc) {
 	sample_bucket_t* pbucket = mlr_malloc_or_die(sizeof(sample_bucket_t));
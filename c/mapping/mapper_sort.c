@@ -4,9 +4,10 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
+#include "lib/mlrsort.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
 
@@ -46,23 +47,42 @@
 //   has "a"="blue". If the first field matches then the sort moves to the
 //   second field, and so on.
 //
-// * Recall in particular that string keys ["a":"red","x":"1"] and
-//   ["a":"red","x":"1.0"] map to different buckets, but will sort equally.
+// * Numerical sort-key values are bucketed by value, not by spelling: string
+//   keys ["a":"red","x":"1"] and ["a":"red","x":"1.0"] map to the same bucket,
+//   since they sort equally. This keeps records which compare equal in the
+//   order they were encountered, as the sort is stable.
+//
+// * The bucket array isn't sorted by comparator, though. Each bucket's parsed
+//   values are encoded into fixed-width integers which sort the same way (see
+//   lib/mlrsort.h), in one contiguous array, and the buckets are radix-sorted
+//   on those. Only string values longer than the eight bytes the integers
+//   hold can leave ties which the comparator then has to settle.
+//
+// * When reading large files with mmap, the stream driver may instead pass
+//   records holding just the sort-key fields, along with where in their files
+//   they were (see lrec_reader_span_sink_t in input/lrec_reader.h). Then the
+//   buckets get those places rather than the records, and at end of stream
+//   they're handed back in sorted order for the records to be read again.
+//   Only the keys and the places are kept, not all the fields of all the
+//   records.
+//
+// * Sort followed by head, e.g. "mlr sort -nr x then head -n 10", is fused
+//   into one mapper which keeps only the best n records seen so far, per head
+//   group if head has -g, in a heap with the worst on top. A record is ranked
+//   by its sort keys and then by its place in the input, which is the order
+//   the stable sort would have put it in; so the output is the same, in
+//   O(n) memory rather than all the records'.
 //
 // ================================================================
 
 #define SORT_NUMERIC    0x80
 #define SORT_DESCENDING 0x40
 
-typedef struct _mapper_sort_state_t {
-	// Input parameters
-	slls_t* pkey_field_names; // Fields to sort on
-	int*    sort_params;      // Lexical/numeric; ascending/descending
-	int do_sort;              // If false, just do group-by
-	// Sort state: buckets of like records.
-	lhmslv_t* pbuckets_by_key_field_values;
-	sllv_t*   precords_missing_sort_keys;
-} mapper_sort_state_t;
+// Hex digits of an encoded numerical key, and a NUL.
+#define NUMERIC_BUCKET_KEY_SIZE 17
+
+// The bucket index for records missing sort keys.
+#define NO_BUCKET ((size_t)-1)
 
 // Each sort key is string or number; use union to save space.
 typedef struct _typed_sort_key_t {
@@ -72,11 +92,66 @@ typedef struct _typed_sort_key_t {
 	} u;
 } typed_sort_key_t;
 
+typedef struct _sort_span_t {
+	lrec_reader_span_t span;
+	size_t             bucket_index;
+} sort_span_t;
+
+typedef struct _mapper_sort_state_t {
+	// Input parameters
+	slls_t* pkey_field_names; // Fields to sort on
+	int*    sort_params;      // Lexical/numeric; ascending/descending
+	int do_sort;              // If false, just do group-by
+	// Sort state: buckets of like records.
+	lhmpkv_t* pbuckets_by_key_field_values;
+	sllv_t*   precords_missing_sort_keys;
+	// Per-record scratch: the parsed sort keys, text standing for the numerical ones in bucket keys, and the
+	// bucket key.
+	typed_sort_key_t* typed_sort_keys;
+	char*             numeric_bucket_keys;
+	packed_key_t*     pbucket_key;
+	// Late materialization: where the records were, in input order, with their buckets' indices.
+	lrec_reader_span_sink_t span_sink;
+	sort_span_t* spans;
+	long long    num_spans;
+	long long    spans_length;
+} mapper_sort_state_t;
+
 typedef struct _sort_bucket_t {
 	typed_sort_key_t* typed_sort_keys;
 	sllv_t*           precords;
+	size_t            index; // in order of first appearance
 } sort_bucket_t;
 
+// For sort then head: a record kept, with its parsed sort keys and its place in the input.
+typedef struct _sort_head_entry_t {
+	lrec_t*            prec;
+	typed_sort_key_t*  typed_sort_keys;
+	unsigned long long seq;
+} sort_head_entry_t;
+
+// The best records so far, for the whole stream or for one head group: a heap with the worst on top.
+typedef struct _sort_head_heap_t {
+	sort_head_entry_t** pentries;
+	unsigned long long  num_entries;
+	unsigned long long  capacity;
+	unsigned long long  num_missing; // records kept which lack sort keys
+} sort_head_heap_t;
+
+typedef struct _mapper_sort_head_state_t {
+	mapper_t*            psort;
+	mapper_t*            phead;
+	mapper_sort_state_t* psort_state;
+	slls_t*              pgroup_by_field_names; // owned by the head mapper
+	unsigned long long   head_count;
+	unsigned long long   seq;
+	sort_head_heap_t     unkeyed_heap; // without head -g
+	packed_key_t*        pgroup_by_key;   // scratch, refilled per record
+	lhmpkv_t*            pheaps_by_group; // with head -g
+	// In input order. Sort would put these after all the others, which head may then pass through.
+	sllv_t*              precords_missing_sort_keys;
+} mapper_sort_head_state_t;
+
 // ----------------------------------------------------------------
 static void      mapper_sort_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
@@ -86,17 +161,45 @@ static mapper_t* mapper_group_by_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort);
 static void      mapper_sort_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_sort_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static lrec_reader_span_sink_t* mapper_sort_input_span_sink(mapper_t* pmapper);
 static sllv_t*   mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
-
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx);
-
-// qsort is non-reentrant but qsort_r isn't portable. But since Miller is
-// single-threaded, even if we've got one sort chained to another, only one is
-// active at a time. We adopt the convention that we set the sort params
-// right before the sort.
-static int* pcmp_sort_params  = NULL;
-static int  cmp_params_length = 0;
-static int pbucket_comparator(const void* pva, const void* pvb);
+static sort_bucket_t* mapper_sort_get_bucket(mapper_sort_state_t* pstate, lrec_t* pinrec, context_t* pctx);
+static void      mapper_sort_span(void* pvstate, lrec_t* pinrec, lrec_reader_span_t* pspan, context_t* pctx);
+static long long mapper_sort_spans(void* pvstate, lrec_reader_span_t** pspans);
+static mlr_sort_pair_t* mapper_sort_buckets(mapper_sort_state_t* pstate, sort_bucket_t*** ppbucket_array,
+	size_t* pnum_buckets);
+
+static mapper_t* mapper_sort_fuse(mapper_t* pmapper, mapper_setup_t* pnext_setup, mapper_t* pnext,
+	mapper_setup_t** ppfused_setup);
+static void      mapper_sort_head_free(mapper_t* pmapper, context_t* pctx);
+static mapper_input_fields_t mapper_sort_head_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static sllv_t*   mapper_sort_head_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sort_head_heap_t* mapper_sort_head_get_heap(mapper_sort_head_state_t* pstate, lrec_t* pinrec);
+static void      mapper_sort_head_keep(mapper_sort_head_state_t* pstate, sort_head_heap_t* pheap, lrec_t* pinrec);
+static sllv_t*   mapper_sort_head_emit(mapper_sort_head_state_t* pstate);
+static void      sort_head_heap_sift_up(sort_head_heap_t* pheap, unsigned long long i,
+	mapper_sort_state_t* psort_state);
+static void      sort_head_heap_sift_down(sort_head_heap_t* pheap, unsigned long long i,
+	mapper_sort_state_t* psort_state);
+static int       sort_head_entry_comparator(const void* pva, const void* pvb, void* pvcontext);
+
+static void parse_sort_keys(slls_t* pkey_field_values, int* sort_params, typed_sort_key_t* typed_sort_keys,
+	context_t* pctx);
+
+typedef struct _bucket_comparator_context_t {
+	sort_bucket_t** pbucket_array;
+	int*            sort_params;
+	int             num_sort_params;
+} bucket_comparator_context_t;
+
+static void sort_bucket_array(sort_bucket_t** pbucket_array, size_t num_buckets,
+	int* sort_params, int num_sort_params, mlr_sort_pair_t* ppairs);
+static void settle_inexact_runs(mlr_sort_pair_t* ppairs, size_t lo, size_t hi, int field_index,
+	unsigned long long* keys, int* inexact_fields, bucket_comparator_context_t* pcontext);
+static int pair_comparator(const void* pva, const void* pvb, void* pvcontext);
+static int typed_sort_keys_compare(typed_sort_key_t* akeys, typed_sort_key_t* bkeys, int* sort_params,
+	int num_sort_params);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_sort_setup = {
@@ -104,6 +207,18 @@ mapper_setup_t mapper_sort_setup = {
 	.pusage_func = mapper_sort_usage,
 	.pparse_func = mapper_sort_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_sort_input_fields,
+	.pinput_span_sink_func = mapper_sort_input_span_sink,
+	.pfuse_func = mapper_sort_fuse,
+};
+
+// Sort then head; not looked up by name.
+static mapper_setup_t mapper_sort_head_setup = {
+	.verb = "sort",
+	.pusage_func = mapper_sort_usage,
+	.pparse_func = mapper_sort_parse_cli,
+	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_sort_head_input_fields,
 };
 
 mapper_setup_t mapper_group_by_setup = {
@@ -111,6 +226,8 @@ mapper_setup_t mapper_group_by_setup = {
 	.pusage_func = mapper_group_by_usage,
 	.pparse_func = mapper_group_by_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_sort_input_fields,
+	.pinput_span_sink_func = mapper_sort_input_span_sink,
 };
 
 // ----------------------------------------------------------------
@@ -224,9 +341,19 @@ static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, i
 
 	pstate->pkey_field_names             = pkey_field_names;
 	pstate->sort_params                  = sort_params;
-	pstate->pbuckets_by_key_field_values = lhmslv_alloc();
+	pstate->pbuckets_by_key_field_values = lhmpkv_alloc();
 	pstate->precords_missing_sort_keys   = sllv_alloc();
 	pstate->do_sort                      = do_sort;
+	pstate->typed_sort_keys              = mlr_malloc_or_die(pkey_field_names->length * sizeof(typed_sort_key_t));
+	pstate->numeric_bucket_keys          = mlr_malloc_or_die(pkey_field_names->length * NUMERIC_BUCKET_KEY_SIZE);
+	pstate->pbucket_key                  = packed_key_alloc();
+	pstate->span_sink.pfield_names       = pkey_field_names;
+	pstate->span_sink.pspan_func         = mapper_sort_span;
+	pstate->span_sink.pspans_func        = mapper_sort_spans;
+	pstate->span_sink.pvstate            = pstate;
+	pstate->spans                        = NULL;
+	pstate->num_spans                    = 0LL;
+	pstate->spans_length                 = 0LL;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_sort_process;
@@ -240,48 +367,52 @@ static void mapper_sort_free(mapper_t* pmapper, context_t* _) {
 	mapper_sort_state_t* pstate = pmapper->pvstate;
 	if (pstate->pkey_field_names != NULL)
 		slls_free(pstate->pkey_field_names);
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->pbuckets_by_key_field_values->phead; pa != NULL; pa = pa->pnext) {
+	// lhmpkv_free will free the hashmap keys; we need to free the void-star hashmap values.
+	for (lhmpkve_t* pa = pstate->pbuckets_by_key_field_values->phead; pa != NULL; pa = pa->pnext) {
 		sort_bucket_t* pbucket = pa->pvvalue;
 		free(pbucket->typed_sort_keys);
 		free(pbucket);
 		// precords freed in emitter
 	}
-	lhmslv_free(pstate->pbuckets_by_key_field_values);
+	lhmpkv_free(pstate->pbuckets_by_key_field_values);
+	packed_key_free(pstate->pbucket_key);
 	sllv_free(pstate->precords_missing_sort_keys);
+	free(pstate->spans);
+	free(pstate->typed_sort_keys);
+	free(pstate->numeric_bucket_keys);
 	free(pstate->sort_params);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_sort_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_sort_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pkey_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+}
+
+static lrec_reader_span_sink_t* mapper_sort_input_span_sink(mapper_t* pmapper) {
+	mapper_sort_state_t* pstate = pmapper->pvstate;
+	return &pstate->span_sink;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_sort_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
 		// Consume another input record.
-		slls_t* pkey_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pkey_field_names);
-		if (pkey_field_values == NULL) {
+		sort_bucket_t* pbucket = mapper_sort_get_bucket(pstate, pinrec, pctx);
+		if (pbucket == NULL)
 			sllv_append(pstate->precords_missing_sort_keys, pinrec);
-		} else {
-			sort_bucket_t* pbucket = lhmslv_get(pstate->pbuckets_by_key_field_values, pkey_field_values);
-			if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
-				slls_t* pkey_field_values_copy = slls_copy(pkey_field_values);
-				sort_bucket_t* pbucket = mlr_malloc_or_die(sizeof(sort_bucket_t));
-				pbucket->typed_sort_keys = parse_sort_keys(pkey_field_values_copy, pstate->sort_params, pctx);
-				pbucket->precords = sllv_alloc();
-				sllv_append(pbucket->precords, pinrec);
-				lhmslv_put(pstate->pbuckets_by_key_field_values, pkey_field_values_copy, pbucket,
-					FREE_ENTRY_KEY);
-			} else { // Previously seen key-field-value: append record to bucket
-				sllv_append(pbucket->precords, pinrec);
-			}
-			slls_free(pkey_field_values);
-		}
+		else
+			sllv_append(pbucket->precords, pinrec);
 		return NULL;
 	} else if (!pstate->do_sort) {
 		// End of input stream: do output for group-by
 		sllv_t* poutput = sllv_alloc();
-		for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext) {
+		for (lhmpkve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext) {
 			sort_bucket_t* pbucket = pe->pvvalue;
 			sllv_transfer(poutput, pbucket->precords);
 			sllv_free(pbucket->precords);
@@ -291,45 +422,492 @@ static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 		return poutput;
 	} else {
 		// End of input stream: sort bucket labels
-		int num_buckets = pstate->pbuckets_by_key_field_values->num_occupied;
-		sort_bucket_t** pbucket_array = mlr_malloc_or_die(num_buckets * sizeof(sort_bucket_t*));
-
-		// Copy bucket-pointers to an array for qsort
-		int i = 0;
-		for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
-			pbucket_array[i] = pe->pvvalue;
-		}
-
-		pcmp_sort_params  = pstate->sort_params;
-		cmp_params_length = pstate->pkey_field_names->length;
-
-		qsort(pbucket_array, num_buckets, sizeof(sort_bucket_t*), pbucket_comparator);
-
-		pcmp_sort_params  = NULL;
-		cmp_params_length = 0;
+		sort_bucket_t** pbucket_array;
+		size_t num_buckets;
+		mlr_sort_pair_t* ppairs = mapper_sort_buckets(pstate, &pbucket_array, &num_buckets);
 
 		// Emit each bucket's record
 		sllv_t* poutput = sllv_alloc();
-		for (i = 0; i < num_buckets; i++) {
-			sllv_t* plist = pbucket_array[i]->precords;
+		for (size_t i = 0; i < num_buckets; i++) {
+			sllv_t* plist = pbucket_array[ppairs[i].index]->precords;
 			sllv_transfer(poutput, plist);
 			sllv_free(plist);
 		}
 		sllv_transfer(poutput, pstate->precords_missing_sort_keys);
+		free(ppairs);
 		free(pbucket_array);
 		sllv_append(poutput, NULL); // Signal end of output-record stream.
 		return poutput;
 	}
 }
 
-static int pbucket_comparator(const void* pva, const void* pvb) {
-	// We are sorting an array of sort_bucket_t*.
-	const sort_bucket_t** pba = (const sort_bucket_t**)pva;
-	const sort_bucket_t** pbb = (const sort_bucket_t**)pvb;
-	typed_sort_key_t* akeys = (*pba)->typed_sort_keys;
-	typed_sort_key_t* bkeys = (*pbb)->typed_sort_keys;
-	for (int i = 0; i < cmp_params_length; i++) {
-		int sort_param = pcmp_sort_params[i];
+// ----------------------------------------------------------------
+// Returns the bucket for the record's sort-key values, new if they haven't been seen before, or NULL if the
+// record lacks any of the sort keys.
+static sort_bucket_t* mapper_sort_get_bucket(mapper_sort_state_t* pstate, lrec_t* pinrec, context_t* pctx) {
+	slls_t* pkey_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pkey_field_names);
+	if (pkey_field_values == NULL)
+		return NULL;
+
+	// Numerical values go into the bucket key as their encoded sort keys, which are the same for equal values.
+	int num_keys = pkey_field_values->length;
+	parse_sort_keys(pkey_field_values, pstate->sort_params, pstate->typed_sort_keys, pctx);
+	int i = 0;
+	for (sllse_t* pe = pkey_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
+		if (pstate->sort_params[i] & SORT_NUMERIC) {
+			char* text = &pstate->numeric_bucket_keys[i * NUMERIC_BUCKET_KEY_SIZE];
+			unsigned long long key = mlr_sort_key_from_double(pstate->typed_sort_keys[i].u.d);
+			for (int j = NUMERIC_BUCKET_KEY_SIZE - 2; j >= 0; j--, key >>= 4)
+				text[j] = "0123456789abcdef"[key & 0xf];
+			text[NUMERIC_BUCKET_KEY_SIZE - 1] = 0;
+			pe->value = text;
+		}
+	}
+
+	packed_key_fill_from_slls(pstate->pbucket_key, pkey_field_values);
+	slls_free(pkey_field_values);
+
+	sort_bucket_t* pbucket = lhmpkv_get(pstate->pbuckets_by_key_field_values, pstate->pbucket_key);
+	if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
+		pbucket = mlr_malloc_or_die(sizeof(sort_bucket_t));
+		pbucket->typed_sort_keys = mlr_malloc_or_die(num_keys * sizeof(typed_sort_key_t));
+		pbucket->precords = sllv_alloc();
+		pbucket->index = pstate->pbuckets_by_key_field_values->num_occupied;
+		// String sort keys point into the map's copy of the bucket key.
+		packed_key_t* pkey_copy = lhmpkv_put(pstate->pbuckets_by_key_field_values, pstate->pbucket_key,
+			pbucket)->key;
+		i = 0;
+		for (char* value = packed_key_first(pkey_copy); value != NULL; value = packed_key_next(pkey_copy, value), i++) {
+			if (pstate->sort_params[i] & SORT_NUMERIC)
+				pbucket->typed_sort_keys[i].u.d = pstate->typed_sort_keys[i].u.d;
+			else
+				pbucket->typed_sort_keys[i].u.s = value;
+		}
+	}
+	return pbucket;
+}
+
+// Returns the buckets' indices in sorted order (for group-by, in order of first appearance), with the bucket
+// array those index, which the caller frees along with the indices.
+static mlr_sort_pair_t* mapper_sort_buckets(mapper_sort_state_t* pstate, sort_bucket_t*** ppbucket_array,
+	size_t* pnum_buckets)
+{
+	size_t num_buckets = pstate->pbuckets_by_key_field_values->num_occupied;
+	sort_bucket_t** pbucket_array = mlr_malloc_or_die(num_buckets * sizeof(sort_bucket_t*));
+
+	// Copy bucket-pointers to an array for sorting
+	size_t i = 0;
+	for (lhmpkve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
+		pbucket_array[i] = pe->pvvalue;
+	}
+
+	mlr_sort_pair_t* ppairs = mlr_malloc_or_die(num_buckets * sizeof(mlr_sort_pair_t));
+	if (pstate->do_sort) {
+		sort_bucket_array(pbucket_array, num_buckets, pstate->sort_params, pstate->pkey_field_names->length,
+			ppairs);
+	} else {
+		for (i = 0; i < num_buckets; i++)
+			ppairs[i].index = i;
+	}
+	*ppbucket_array = pbucket_array;
+	*pnum_buckets = num_buckets;
+	return ppairs;
+}
+
+// ----------------------------------------------------------------
+// Late materialization: the record holds the sort-key fields, if it has them, and is done with once its
+// bucket is found.
+static void mapper_sort_span(void* pvstate, lrec_t* pinrec, lrec_reader_span_t* pspan, context_t* pctx) {
+	mapper_sort_state_t* pstate = pvstate;
+	sort_bucket_t* pbucket = mapper_sort_get_bucket(pstate, pinrec, pctx);
+	lrec_free(pinrec);
+
+	if (pstate->num_spans >= pstate->spans_length) {
+		pstate->spans_length = (pstate->spans_length == 0LL) ? 1024LL : 2 * pstate->spans_length;
+		pstate->spans = mlr_realloc_or_die(pstate->spans, pstate->spans_length * sizeof(sort_span_t));
+	}
+	sort_span_t* psort_span = &pstate->spans[pstate->num_spans++];
+	psort_span->span = *pspan;
+	psort_span->bucket_index = (pbucket == NULL) ? NO_BUCKET : pbucket->index;
+}
+
+// The spans are put in output order by a counting sort on their buckets' ranks, which keeps records in the same
+// bucket in input order. Records missing sort keys go last, as ever.
+static long long mapper_sort_spans(void* pvstate, lrec_reader_span_t** pspans) {
+	mapper_sort_state_t* pstate = pvstate;
+	sort_bucket_t** pbucket_array;
+	size_t num_buckets;
+	mlr_sort_pair_t* ppairs = mapper_sort_buckets(pstate, &pbucket_array, &num_buckets);
+
+	for (size_t i = 0; i < num_buckets; i++) {
+		sllv_free(pbucket_array[i]->precords); // never used
+		pbucket_array[i]->precords = NULL;
+	}
+
+	// ranks[b] is bucket b's place in sorted order, and starts[r] counts, then locates, the records of the
+	// bucket ranked r; records missing sort keys rank last.
+	size_t* ranks = mlr_malloc_or_die(num_buckets * sizeof(size_t));
+	for (size_t i = 0; i < num_buckets; i++)
+		ranks[ppairs[i].index] = i;
+	long long* starts = mlr_malloc_or_die((num_buckets + 2) * sizeof(long long));
+	memset(starts, 0, (num_buckets + 2) * sizeof(long long));
+	for (long long j = 0; j < pstate->num_spans; j++) {
+		size_t b = pstate->spans[j].bucket_index;
+		starts[(b == NO_BUCKET ? num_buckets : ranks[b]) + 1]++;
+	}
+	for (size_t i = 1; i <= num_buckets + 1; i++)
+		starts[i] += starts[i-1];
+
+	lrec_reader_span_t* spans = mlr_malloc_or_die((pstate->num_spans + 1) * sizeof(lrec_reader_span_t));
+	for (long long j = 0; j < pstate->num_spans; j++) {
+		size_t b = pstate->spans[j].bucket_index;
+		spans[starts[b == NO_BUCKET ? num_buckets : ranks[b]]++] = pstate->spans[j].span;
+	}
+
+	long long num_spans = pstate->num_spans;
+	free(pstate->spans);
+	pstate->spans = NULL;
+	pstate->num_spans = 0LL;
+	pstate->spans_length = 0LL;
+	free(starts);
+	free(ranks);
+	free(ppairs);
+	free(pbucket_array);
+	*pspans = spans;
+	return num_spans;
+}
+
+// ----------------------------------------------------------------
+static mapper_t* mapper_sort_fuse(mapper_t* pmapper, mapper_setup_t* pnext_setup, mapper_t* pnext,
+	mapper_setup_t** ppfused_setup)
+{
+	if (pnext_setup != &mapper_head_setup)
+		return NULL;
+
+	mapper_t* pfused = mlr_malloc_or_die(sizeof(mapper_t));
+	mapper_sort_head_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_sort_head_state_t));
+	pstate->psort       = pmapper;
+	pstate->phead       = pnext;
+	pstate->psort_state = pmapper->pvstate;
+	mapper_head_get_params(pnext, &pstate->head_count, &pstate->pgroup_by_field_names);
+	pstate->seq = 0LL;
+	memset(&pstate->unkeyed_heap, 0, sizeof(pstate->unkeyed_heap));
+	pstate->pgroup_by_key = packed_key_alloc();
+	pstate->pheaps_by_group = lhmpkv_alloc();
+	pstate->precords_missing_sort_keys = sllv_alloc();
+
+	pfused->pvstate       = pstate;
+	pfused->pprocess_func = mapper_sort_head_process;
+	pfused->pfree_func    = mapper_sort_head_free;
+
+	*ppfused_setup = &mapper_sort_head_setup;
+	return pfused;
+}
+
+// The kept records themselves are freed, or passed on, in the emitter.
+static void mapper_sort_head_free(mapper_t* pmapper, context_t* pctx) {
+	mapper_sort_head_state_t* pstate = pmapper->pvstate;
+	free(pstate->unkeyed_heap.pentries);
+	for (lhmpkve_t* pe = pstate->pheaps_by_group->phead; pe != NULL; pe = pe->pnext) {
+		sort_head_heap_t* pheap = pe->pvvalue;
+		free(pheap->pentries);
+		free(pheap);
+	}
+	lhmpkv_free(pstate->pheaps_by_group);
+	packed_key_free(pstate->pgroup_by_key);
+	sllv_free(pstate->precords_missing_sort_keys);
+	pstate->psort->pfree_func(pstate->psort, pctx);
+	pstate->phead->pfree_func(pstate->phead, pctx);
+	free(pstate);
+	free(pmapper);
+}
+
+static mapper_input_fields_t mapper_sort_head_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_sort_head_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return mapper_sort_input_fields(pstate->psort, pfield_names);
+}
+
+// ----------------------------------------------------------------
+static sllv_t* mapper_sort_head_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_sort_head_state_t* pstate = pvstate;
+	if (pinrec == NULL)
+		return mapper_sort_head_emit(pstate);
+
+	// Sort keys are parsed before head -g drops a record, so that sort's errors for non-numeric values are the
+	// same as when unfused.
+	mapper_sort_state_t* psort_state = pstate->psort_state;
+	slls_t* pkey_field_values = mlr_reference_selected_values_from_record(pinrec, psort_state->pkey_field_names);
+	if (pkey_field_values != NULL)
+		parse_sort_keys(pkey_field_values, psort_state->sort_params, psort_state->typed_sort_keys, pctx);
+
+	sort_head_heap_t* pheap = mapper_sort_head_get_heap(pstate, pinrec);
+	if (pheap == NULL) { // head -g drops these
+		slls_free(pkey_field_values);
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	if (pkey_field_values == NULL) {
+		if (pheap->num_missing < pstate->head_count) {
+			pheap->num_missing++;
+			sllv_append(pstate->precords_missing_sort_keys, pinrec);
+		} else {
+			lrec_free(pinrec);
+		}
+		return NULL;
+	}
+	slls_free(pkey_field_values);
+	mapper_sort_head_keep(pstate, pheap, pinrec);
+	pstate->seq++;
+	return NULL;
+}
+
+// Returns NULL if the record lacks any of the head -g fields.
+static sort_head_heap_t* mapper_sort_head_get_heap(mapper_sort_head_state_t* pstate, lrec_t* pinrec) {
+	if (pstate->pgroup_by_field_names->length == 0)
+		return &pstate->unkeyed_heap;
+	if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names))
+		return NULL;
+	sort_head_heap_t* pheap = lhmpkv_get(pstate->pheaps_by_group, pstate->pgroup_by_key);
+	if (pheap == NULL) {
+		pheap = mlr_malloc_or_die(sizeof(sort_head_heap_t));
+		memset(pheap, 0, sizeof(sort_head_heap_t));
+		lhmpkv_put(pstate->pheaps_by_group, pstate->pgroup_by_key, pheap);
+	}
+	return pheap;
+}
+
+// The record's sort keys are in the sort mapper's scratch space. Since it comes after all the records kept so
+// far, it displaces the worst of them only if its sort keys are strictly better.
+static void mapper_sort_head_keep(mapper_sort_head_state_t* pstate, sort_head_heap_t* pheap, lrec_t* pinrec) {
+	mapper_sort_state_t* psort_state = pstate->psort_state;
+	int num_keys = psort_state->pkey_field_names->length;
+	sort_head_entry_t* pentry;
+
+	if (pheap->num_entries < pstate->head_count) {
+		if (pheap->num_entries >= pheap->capacity) {
+			pheap->capacity = (pheap->capacity == 0LL) ? 16LL : 2 * pheap->capacity;
+			pheap->pentries = mlr_realloc_or_die(pheap->pentries, pheap->capacity * sizeof(sort_head_entry_t*));
+		}
+		pentry = mlr_malloc_or_die(sizeof(sort_head_entry_t));
+		pentry->typed_sort_keys = mlr_malloc_or_die(num_keys * sizeof(typed_sort_key_t));
+		pheap->pentries[pheap->num_entries++] = pentry;
+	} else if (pheap->num_entries > 0LL && typed_sort_keys_compare(psort_state->typed_sort_keys,
+		pheap->pentries[0]->typed_sort_keys, psort_state->sort_params, num_keys) < 0)
+	{
+		pentry = pheap->pentries[0];
+		lrec_free(pentry->prec);
+	} else {
+		lrec_free(pinrec);
+		return;
+	}
+
+	// String keys point into the record, which is kept along with them.
+	pentry->prec = pinrec;
+	memcpy(pentry->typed_sort_keys, psort_state->typed_sort_keys, num_keys * sizeof(typed_sort_key_t));
+	pentry->seq = pstate->seq;
+	if (pentry == pheap->pentries[0] && pheap->num_entries > 1)
+		sort_head_heap_sift_down(pheap, 0, psort_state);
+	else
+		sort_head_heap_sift_up(pheap, pheap->num_entries - 1, psort_state);
+}
+
+// The kept records all come out in sorted order, as sort would have them. Then those lacking sort keys, in input
+// order, as far as head would still pass them: for each group, up to the head count less the group's kept
+// records.
+static sllv_t* mapper_sort_head_emit(mapper_sort_head_state_t* pstate) {
+	sllv_t* poutput = sllv_alloc();
+
+	unsigned long long num_entries = pstate->unkeyed_heap.num_entries;
+	for (lhmpkve_t* pe = pstate->pheaps_by_group->phead; pe != NULL; pe = pe->pnext)
+		num_entries += ((sort_head_heap_t*)pe->pvvalue)->num_entries;
+	sort_head_entry_t** pentries = mlr_malloc_or_die((num_entries + 1) * sizeof(sort_head_entry_t*));
+	unsigned long long n = 0LL;
+	for (unsigned long long i = 0; i < pstate->unkeyed_heap.num_entries; i++)
+		pentries[n++] = pstate->unkeyed_heap.pentries[i];
+	for (lhmpkve_t* pe = pstate->pheaps_by_group->phead; pe != NULL; pe = pe->pnext) {
+		sort_head_heap_t* pheap = pe->pvvalue;
+		for (unsigned long long i = 0; i < pheap->num_entries; i++)
+			pentries[n++] = pheap->pentries[i];
+	}
+
+	mlr_merge_sort(pentries, num_entries, sizeof(sort_head_entry_t*), sort_head_entry_comparator,
+		pstate->psort_state);
+	for (unsigned long long i = 0; i < num_entries; i++) {
+		sllv_append(poutput, pentries[i]->prec);
+		free(pentries[i]->typed_sort_keys);
+		free(pentries[i]);
+	}
+	free(pentries);
+
+	// From here on the heaps' entry counts are of records passed on.
+	lrec_t* prec;
+	while ((prec = sllv_pop(pstate->precords_missing_sort_keys)) != NULL) {
+		sort_head_heap_t* pheap = mapper_sort_head_get_heap(pstate, prec);
+		if (pheap->num_entries < pstate->head_count) {
+			pheap->num_entries++;
+			sllv_append(poutput, prec);
+		} else {
+			lrec_free(prec);
+		}
+	}
+	pstate->unkeyed_heap.num_entries = 0LL;
+	for (lhmpkve_t* pe = pstate->pheaps_by_group->phead; pe != NULL; pe = pe->pnext)
+		((sort_head_heap_t*)pe->pvvalue)->num_entries = 0LL;
+
+	sllv_append(poutput, NULL);
+	return poutput;
+}
+
+// Worst on top: each entry ranks at or after its children.
+static void sort_head_heap_sift_up(sort_head_heap_t* pheap, unsigned long long i, mapper_sort_state_t* psort_state) {
+	sort_head_entry_t** pentries = pheap->pentries;
+	while (i > 0) {
+		unsigned long long parent = (i - 1) / 2;
+		if (sort_head_entry_comparator(&pentries[parent], &pentries[i], psort_state) >= 0)
+			break;
+		sort_head_entry_t* ptemp = pentries[parent];
+		pentries[parent] = pentries[i];
+		pentries[i] = ptemp;
+		i = parent;
+	}
+}
+
+static void sort_head_heap_sift_down(sort_head_heap_t* pheap, unsigned long long i,
+	mapper_sort_state_t* psort_state)
+{
+	sort_head_entry_t** pentries = pheap->pentries;
+	unsigned long long n = pheap->num_entries;
+	while (TRUE) {
+		unsigned long long worst = i;
+		unsigned long long left = 2 * i + 1;
+		unsigned long long right = left + 1;
+		if (left < n && sort_head_entry_comparator(&pentries[left], &pentries[worst], psort_state) > 0)
+			worst = left;
+		if (right < n && sort_head_entry_comparator(&pentries[right], &pentries[worst], psort_state) > 0)
+			worst = right;
+		if (worst == i)
+			break;
+		sort_head_entry_t* ptemp = pentries[worst];
+		pentries[worst] = pentries[i];
+		pentries[i] = ptemp;
+		i = worst;
+	}
+}
+
+// By sort keys, then by place in the input.
+static int sort_head_entry_comparator(const void* pva, const void* pvb, void* pvcontext) {
+	mapper_sort_state_t* psort_state = pvcontext;
+	sort_head_entry_t* pa = *(sort_head_entry_t**)pva;
+	sort_head_entry_t* pb = *(sort_head_entry_t**)pvb;
+	int s = typed_sort_keys_compare(pa->typed_sort_keys, pb->typed_sort_keys, psort_state->sort_params,
+		psort_state->pkey_field_names->length);
+	if (s != 0)
+		return s;
+	return (pa->seq < pb->seq) ? -1 : (pa->seq > pb->seq) ? 1 : 0;
+}
+
+// ----------------------------------------------------------------
+// Leaves in ppairs the indices of the buckets in sorted order. Ties keep the order of the bucket array,
+// i.e. of first appearance in the input.
+static void sort_bucket_array(sort_bucket_t** pbucket_array, size_t num_buckets,
+	int* sort_params, int num_sort_params, mlr_sort_pair_t* ppairs)
+{
+	// Encode all the keys up front: bucket i's are at keys[i*num_sort_params] onward.
+	unsigned long long* keys = mlr_malloc_or_die(num_buckets * num_sort_params * sizeof(unsigned long long));
+	int* inexact_fields = mlr_malloc_or_die(num_sort_params * sizeof(int));
+	int any_inexact = FALSE;
+	for (int j = 0; j < num_sort_params; j++) {
+		int sort_param = sort_params[j];
+		int inexact = FALSE;
+		for (size_t i = 0; i < num_buckets; i++) {
+			typed_sort_key_t* ptyped_sort_key = &pbucket_array[i]->typed_sort_keys[j];
+			unsigned long long key;
+			if (sort_param & SORT_NUMERIC) {
+				key = mlr_sort_key_from_double(ptyped_sort_key->u.d);
+			} else {
+				int is_exact;
+				key = mlr_sort_key_from_string(ptyped_sort_key->u.s, &is_exact);
+				if (!is_exact)
+					inexact = TRUE;
+			}
+			keys[i * num_sort_params + j] = (sort_param & SORT_DESCENDING) ? ~key : key;
+		}
+		inexact_fields[j] = inexact;
+		any_inexact |= inexact;
+	}
+
+	// LSD over the fields as well: the last field first.
+	mlr_sort_pair_t* pscratch = mlr_malloc_or_die(num_buckets * sizeof(mlr_sort_pair_t));
+	for (size_t i = 0; i < num_buckets; i++)
+		ppairs[i].index = i;
+	for (int j = num_sort_params - 1; j >= 0; j--) {
+		for (size_t i = 0; i < num_buckets; i++)
+			ppairs[i].key = keys[ppairs[i].index * num_sort_params + j];
+		mlr_radix_sort_pairs(ppairs, pscratch, num_buckets);
+	}
+	free(pscratch);
+
+	if (any_inexact) {
+		bucket_comparator_context_t context = {
+			.pbucket_array   = pbucket_array,
+			.sort_params     = sort_params,
+			.num_sort_params = num_sort_params,
+		};
+		settle_inexact_runs(ppairs, 0, num_buckets, 0, keys, inexact_fields, &context);
+	}
+
+	free(inexact_fields);
+	free(keys);
+}
+
+// Within ppairs[lo..hi), which agree on the encoded keys of the fields before field_index, finds the runs
+// agreeing on this field's as well. Where this field's values aren't all exactly encoded in a run, the
+// comparator sorts it; else the run is checked on the next field.
+static void settle_inexact_runs(mlr_sort_pair_t* ppairs, size_t lo, size_t hi, int field_index,
+	unsigned long long* keys, int* inexact_fields, bucket_comparator_context_t* pcontext)
+{
+	int n = pcontext->num_sort_params;
+	if (field_index >= n)
+		return;
+	for (size_t run_start = lo; run_start < hi; ) {
+		unsigned long long key = keys[ppairs[run_start].index * n + field_index];
+		size_t run_end = run_start + 1;
+		while (run_end < hi && keys[ppairs[run_end].index * n + field_index] == key)
+			run_end++;
+		if (run_end - run_start > 1) {
+			int inexact = FALSE;
+			if (inexact_fields[field_index]) {
+				for (size_t i = run_start; i < run_end && !inexact; i++) {
+					char* value = pcontext->pbucket_array[ppairs[i].index]->typed_sort_keys[field_index].u.s;
+					inexact = (strnlen(value, 9) > 8);
+				}
+			}
+			if (inexact)
+				mlr_merge_sort(&ppairs[run_start], run_end - run_start, sizeof(mlr_sort_pair_t),
+					pair_comparator, pcontext);
+			else
+				settle_inexact_runs(ppairs, run_start, run_end, field_index + 1, keys, inexact_fields, pcontext);
+		}
+		run_start = run_end;
+	}
+}
+
+static int pair_comparator(const void* pva, const void* pvb, void* pvcontext) {
+	bucket_comparator_context_t* pcontext = pvcontext;
+	const mlr_sort_pair_t* pa = pva;
+	const mlr_sort_pair_t* pb = pvb;
+	return typed_sort_keys_compare(pcontext->pbucket_array[pa->index]->typed_sort_keys,
+		pcontext->pbucket_array[pb->index]->typed_sort_keys, pcontext->sort_params, pcontext->num_sort_params);
+}
+
+static int typed_sort_keys_compare(typed_sort_key_t* akeys, typed_sort_key_t* bkeys, int* sort_params,
+	int num_sort_params)
+{
+	for (int i = 0; i < num_sort_params; i++) {
+		int sort_param = sort_params[i];
 		if (sort_param & SORT_NUMERIC) {
 			double a = akeys[i].u.d;
 			double b = bkeys[i].u.d;
@@ -355,8 +933,9 @@ static int pbucket_comparator(const void* pva, const void* pvb) {
 }
 
 // E.g. parse the list ["red","1.0"] into the array ["red",1.0].
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx) {
-	typed_sort_key_t* typed_sort_keys = mlr_malloc_or_die(pkey_field_values->length * sizeof(typed_sort_key_t));
+static void parse_sort_keys(slls_t* pkey_field_values, int* sort_params, typed_sort_key_t* typed_sort_keys,
+	context_t* pctx)
+{
 	int i = 0;
 	for (sllse_t* pe = pkey_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
 		if (sort_params[i] & SORT_NUMERIC) {
@@ -371,5 +950,4 @@ static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_pa
 			typed_sort_keys[i].u.s = pe->value;
 		}
 	}
-	return typed_sort_keys;
 }
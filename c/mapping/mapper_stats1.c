@@ -8,9 +8,10 @@
 #include "cli/argparse.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mlrval.h"
 #include "mapping/mappers.h"
 #include "mapping/stats1_accumulators.h"
@@ -44,11 +45,21 @@ typedef struct _mapper_stats1_state_t {
 	int              num_group_by_field_regexes;
 	int              invert_regex_group_by_field_names;
 
-	lhmslv_t*        groups_without_group_by_regex;
-	lhmslv_t*        groups_with_group_by_regex;
+	packed_key_t*    pgroup_by_key;          // scratch space used per-record
+	packed_key_t*    pgroup_by_names_key;    // scratch space used per-record, with group-by regexes
+	lhmpkv_t*        groups_without_group_by_regex;
+	lhmpkv_t*        groups_with_group_by_regex;
 	int              do_iterative_stats;
 	int              allow_int_float;
 	int              do_interpolated_percentiles;
+	int              do_approx_percentiles;
+	int              approx_percentile_k;
+	stats1_plan_t*   pplan;                  // NULL if none of the accumulators are fused
+
+	lrec_reader_number_sink_t number_sink; // when the input numbers can skip records
+	int              takes_numbers;
+
+	aggregate_state_spec_t* pstate_spec; // for --write-state, else NULL
 } mapper_stats1_state_t;
 
 
@@ -58,8 +69,15 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles);
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles,
+	int do_approx_percentiles, int approx_percentile_k, aggregate_state_spec_t* pstate_spec);
 static void      mapper_stats1_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_stats1_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static lrec_reader_number_sink_t* mapper_stats1_input_number_sink(mapper_t* pmapper);
+static int       mapper_stats1_accs_take_numbers(slls_t* paccumulator_names, int allow_int_float,
+	int do_interpolated_percentiles, int do_approx_percentiles, int approx_percentile_k);
+static void      mapper_stats1_ingest_numbers(void* pvstate, char* value_field_name, mv_t* pvalues, int num_values,
+	context_t* pctx);
 static sllv_t*   mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 static void mapper_stats1_group_by_ingest_without_regexes(
@@ -83,10 +101,16 @@ static sllv_t*   mapper_stats1_emit_all_without_group_by_regexes(mapper_stats1_s
 static sllv_t*   mapper_stats1_emit_all_with_group_by_regexes(mapper_stats1_state_t* pstate);
 static lrec_t*   mapper_stats1_emit(mapper_stats1_state_t* pstate, lrec_t* poutrec,
 	char* value_field_name, lhmsv_t* acc_field_to_acc_state_out);
+static void      mapper_stats1_write_state(mapper_stats1_state_t* pstate);
+static void      mapper_stats1_write_group_state(FILE* output_stream, lhmsv_t* pgroup_to_acc_field);
+static void      mapper_stats1_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader);
+static void      mapper_stats1_merge_group_state(mapper_stats1_state_t* pstate, lhmpkv_t* pgroups,
+	aggregate_state_reader_t* preader);
 
 typedef struct _acc_map_pair_t {
 	lhmsv_t* pin;
 	lhmsv_t* pout;
+	stats1_fused_t* pfused; // with views in pin and pout
 } acc_map_pair_t;
 
 // ----------------------------------------------------------------
@@ -95,6 +119,9 @@ mapper_setup_t mapper_stats1_setup = {
 	.pusage_func = mapper_stats1_usage,
 	.pparse_func = mapper_stats1_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_stats1_input_fields,
+	.pinput_number_sink_func = mapper_stats1_input_number_sink,
+	.pmerge_state_func = mapper_stats1_merge_state,
 };
 
 // ----------------------------------------------------------------
@@ -103,7 +130,8 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "Computes univariate statistics for one or more given fields, accumulated across\n");
 	fprintf(o, "the input record stream.\n");
 	fprintf(o, "Options:\n");
-	fprintf(o, "-a {sum,count,...}  Names of accumulators: p10 p25.2 p50 p98 p100 etc. and/or\n");
+	fprintf(o, "-a {sum,count,...}  Names of accumulators: p10 p25.2 p50 p98 p100 etc., p10~ etc.\n");
+	fprintf(o, "                    for approximate percentiles, and/or\n");
 	fprintf(o, "                    one or more of:\n");
 	for (int i = 0; i < stats1_acc_lookup_table_length; i++) {
 		fprintf(o, "   %-9s %s\n", stats1_acc_lookup_table[i].name, stats1_acc_lookup_table[i].desc);
@@ -121,10 +149,17 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "--grfx {regex} Shorthand for --gr {regex} --fx {that same regex}\n");
 	fprintf(o, "-i           Use interpolated percentiles, like R's type=7; default like type=1.\n");
 	fprintf(o, "             Not sensical for string-valued fields.\n");
+	fprintf(o, "--approx-percentiles\n");
+	fprintf(o, "             Compute all percentiles approximately, as if given as p10~ etc.\n");
+	fprintf(o, "--approx-k {k} Accuracy of approximate percentiles: see below. Default %d.\n",
+		PERCENTILE_SKETCH_DEFAULT_K);
 	fprintf(o, "-s           Print iterative stats. Useful in tail -f contexts (in which\n");
 	fprintf(o, "             case please avoid pprint-format output since end of input\n");
 	fprintf(o, "             stream will never be seen).\n");
 	fprintf(o, "-F           Computes integerable things (e.g. count) in floating point.\n");
+	fprintf(o, "--write-state {filename}\n");
+	fprintf(o, "             At end of stream, also write the accumulators to this file, for\n");
+	fprintf(o, "             %s merge-state to combine with others. Not with -s.\n", argv0);
 	fprintf(o, "Example: %s %s -a min,p10,p50,p90,max -f value -g size,shape\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a count,mode -f size\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a count,mode -f size -g shape\n", argv0, verb);
@@ -133,6 +168,11 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "         with a through h, grouped by all field names starting with k.\n");
 	fprintf(o, "Notes:\n");
 	fprintf(o, "* p50 and median are synonymous.\n");
+	fprintf(o, "* Exact percentiles keep all the values in memory. Approximate ones keep a\n");
+	fprintf(o, "  sketch of fewer than 3k numbers per field and group, which is exact for fewer\n");
+	fprintf(o, "  than k values. Beyond that, the rank of the value output is off by at most\n");
+	fprintf(o, "  about 2n/k, i.e. 1%% of n for the default k, and typically by a fifth of that.\n");
+	fprintf(o, "  They require numeric input, and with --write-state are merged as sketches.\n");
 	fprintf(o, "* min and max output the same results as p0 and p100, respectively, but use\n");
 	fprintf(o, "  less memory.\n");
 	fprintf(o, "* String-valued data make sense unless arithmetic on them is required,\n");
@@ -152,11 +192,16 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	int             do_iterative_stats                = FALSE;
 	int             allow_int_float                   = TRUE;
 	int             do_interpolated_percentiles       = FALSE;
+	int             do_approx_percentiles             = FALSE;
+	int             approx_percentile_k               = PERCENTILE_SKETCH_DEFAULT_K;
 	int             do_regex_value_field_names        = FALSE;
 	int             invert_regex_value_field_names    = FALSE;
 	int             do_regex_group_by_field_names     = FALSE;
 	int             invert_regex_group_by_field_names = FALSE;
+	char*           state_filename                    = NULL;
 
+	int verb_argi = *pargi;
+	slls_t* pverb_argv = aggregate_state_copy_argv(argv, verb_argi, argc);
 	char* verb = argv[(*pargi)++];
 
 	int oargi = *pargi;
@@ -173,11 +218,22 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_true_flag(pstate,         "-s",   &do_iterative_stats);
 	ap_define_false_flag(pstate,        "-F",   &allow_int_float);
 	ap_define_true_flag(pstate,         "-i",   &do_interpolated_percentiles);
+	ap_define_true_flag(pstate,         "--approx-percentiles", &do_approx_percentiles);
+	ap_define_int_flag(pstate,          "--approx-k", &approx_percentile_k);
+	ap_define_string_flag(pstate,       MLR_STATE_FLAG, &state_filename);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_stats1_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (state_filename != NULL && do_iterative_stats) {
+		fprintf(stderr, "%s %s: -s cannot be used with %s.\n", MLR_GLOBALS.bargv0, verb, MLR_STATE_FLAG);
+		return NULL;
+	}
+	if (approx_percentile_k < 2) {
+		mapper_stats1_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
 	int nargi = *pargi;
 	for (int argi = oargi; argi < nargi; argi++) {
@@ -209,17 +265,22 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 		return NULL;
 	}
 
+	aggregate_state_spec_t* pstate_spec = aggregate_state_spec_alloc(state_filename, pverb_argv,
+		*pargi - verb_argi);
+
 	return mapper_stats1_alloc(pstate, paccumulator_names,
 		pvalue_field_names, do_regex_value_field_names, invert_regex_value_field_names,
 		pgroup_by_field_names, do_regex_group_by_field_names, invert_regex_group_by_field_names,
-		do_iterative_stats, allow_int_float, do_interpolated_percentiles);
+		do_iterative_stats, allow_int_float, do_interpolated_percentiles, do_approx_percentiles,
+		approx_percentile_k, pstate_spec);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles)
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles,
+	int do_approx_percentiles, int approx_percentile_k, aggregate_state_spec_t* pstate_spec)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -265,7 +326,7 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->pemitter                          = mapper_stats1_emit_all_with_group_by_regexes;
 		pstate->invert_regex_group_by_field_names = invert_regex_group_by_field_names;
 		pstate->groups_without_group_by_regex     = NULL;
-		pstate->groups_with_group_by_regex        = lhmslv_alloc();
+		pstate->groups_with_group_by_regex        = lhmpkv_alloc();
 	} else {
 		pstate->pgroup_by_ingestor                = mapper_stats1_group_by_ingest_without_regexes;
 		pstate->pemitter                          = mapper_stats1_emit_all_without_group_by_regexes;
@@ -273,13 +334,31 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->group_by_field_regexes            = NULL;
 		pstate->num_group_by_field_regexes        = 0;
 		pstate->invert_regex_group_by_field_names = FALSE;
-		pstate->groups_without_group_by_regex     = lhmslv_alloc();
+		pstate->groups_without_group_by_regex     = lhmpkv_alloc();
 		pstate->groups_with_group_by_regex        = NULL;
 	}
+	pstate->pgroup_by_key                 = packed_key_alloc();
+	pstate->pgroup_by_names_key           = packed_key_alloc();
 
 	pstate->do_iterative_stats            = do_iterative_stats;
 	pstate->allow_int_float               = allow_int_float;
 	pstate->do_interpolated_percentiles   = do_interpolated_percentiles;
+	pstate->do_approx_percentiles         = do_approx_percentiles;
+	pstate->approx_percentile_k           = approx_percentile_k;
+	pstate->pplan                         = stats1_plan_alloc(paccumulator_names, allow_int_float);
+	pstate->pstate_spec                   = pstate_spec;
+
+	pstate->takes_numbers = !do_regex_value_field_names && !do_regex_group_by_field_names
+		&& pstate->pgroup_by_field_names->length == 0 && !do_iterative_stats
+		&& mapper_stats1_accs_take_numbers(paccumulator_names, allow_int_float, do_interpolated_percentiles,
+			do_approx_percentiles, approx_percentile_k);
+	pstate->number_sink.pfield_names  = slls_alloc();
+	pstate->number_sink.pnumbers_func = mapper_stats1_ingest_numbers;
+	pstate->number_sink.pvstate       = pstate;
+	if (pstate->takes_numbers) {
+		for (int i = 0; i < pstate->pvalue_field_names->length; i++)
+			slls_append_no_free(pstate->number_sink.pfield_names, pstate->pvalue_field_names->strings[i]);
+	}
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_stats1_process;
@@ -294,6 +373,7 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 	string_array_free(pstate->pvalue_field_names);
 	string_array_free(pstate->pvalue_field_values);
 	slls_free(pstate->pgroup_by_field_names);
+	slls_free(pstate->number_sink.pfield_names);
 
 	if (pstate->value_field_regexes != NULL) {
 		for (int i = 0; i < pstate->num_value_field_regexes; i++)
@@ -307,10 +387,10 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 		free(pstate->group_by_field_regexes);
 	}
 
-	// lhmslv_free and lhmsv_free will free the hashmap keys; we need to free
+	// lhmpkv_free and lhmsv_free will free the hashmap keys; we need to free
 	// the void-star hashmap values.
 	if (pstate->groups_without_group_by_regex != NULL) {
-		for (lhmslve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+		for (lhmpkve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
 			lhmsv_t* pgroup_to_acc_field = pa->pvvalue;
 			for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
 				acc_map_pair_t* pacc_field_to_acc_states = pb->pvvalue;
@@ -322,19 +402,20 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 					stats1_acc_t* pstats1_acc = pc->pvvalue;
 					pstats1_acc->pfree_func(pstats1_acc);
 				}
+				stats1_fused_free(pacc_field_to_acc_states->pfused);
 				lhmsv_free(pacc_field_to_acc_state_in);
 				lhmsv_free(pacc_field_to_acc_state_out);
 				free(pacc_field_to_acc_states);
 			}
 			lhmsv_free(pgroup_to_acc_field);
 		}
-		lhmslv_free(pstate->groups_without_group_by_regex);
+		lhmpkv_free(pstate->groups_without_group_by_regex);
 	}
 
 	if (pstate->groups_with_group_by_regex != NULL) {
-		for (lhmslve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
-			lhmslv_t* pgroups_by_names = pa->pvvalue;
-			for (lhmslve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
+		for (lhmpkve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+			lhmpkv_t* pgroups_by_names = pa->pvvalue;
+			for (lhmpkve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
 				lhmsv_t* pgroup_to_acc_field = pb->pvvalue;
 				for (lhmsve_t* pc = pgroup_to_acc_field->phead; pc != NULL; pc = pc->pnext) {
 					acc_map_pair_t* pacc_field_to_acc_states = pc->pvvalue;
@@ -346,17 +427,22 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 						stats1_acc_t* pstats1_acc = pd->pvvalue;
 						pstats1_acc->pfree_func(pstats1_acc);
 					}
+					stats1_fused_free(pacc_field_to_acc_states->pfused);
 					lhmsv_free(pacc_field_to_acc_state_in);
 					lhmsv_free(pacc_field_to_acc_state_out);
 					free(pacc_field_to_acc_states);
 				}
 				lhmsv_free(pgroup_to_acc_field);
 			}
-			lhmslv_free(pgroups_by_names);
+			lhmpkv_free(pgroups_by_names);
 		}
-		lhmslv_free(pstate->groups_with_group_by_regex);
+		lhmpkv_free(pstate->groups_with_group_by_regex);
 	}
+	packed_key_free(pstate->pgroup_by_key);
+	packed_key_free(pstate->pgroup_by_names_key);
+	stats1_plan_free(pstate->pplan);
 
+	aggregate_state_spec_free(pstate->pstate_spec);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -406,6 +492,19 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 // }
 // ================================================================
 
+// ----------------------------------------------------------------
+// Field-name regexes can match anything. With -s the input records are passed along too.
+static mapper_input_fields_t mapper_stats1_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_stats1_state_t* pstate = pmapper->pvstate;
+	if (pstate->value_field_regexes != NULL || pstate->group_by_field_regexes != NULL)
+		return MAPPER_USES_ALL_FIELDS;
+	for (int i = 0; i < pstate->pvalue_field_names->length; i++)
+		hss_add(pfield_names, pstate->pvalue_field_names->strings[i]);
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return pstate->do_iterative_stats ? MAPPER_PASSES_OTHER_FIELDS_THROUGH : MAPPER_USES_ONLY_THESE_FIELDS;
+}
+
 // In the iterative case, add to the current record its current group's stats fields.
 // In the non-iterative case, produce output only at the end of the input stream.
 static sllv_t* mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
@@ -420,6 +519,8 @@ static sllv_t* mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvst
 			return NULL;
 		}
 	} else if (!pstate->do_iterative_stats) {
+		if (pstate->pstate_spec != NULL)
+			mapper_stats1_write_state(pstate);
 		return pstate->pemitter(pstate);
 	} else {
 		return NULL;
@@ -433,27 +534,21 @@ static void mapper_stats1_group_by_ingest_without_regexes(lrec_t* pinrec, mapper
 	// population on that, but retain full-population requirement on group-by.
 	// E.g. if accumulating stats of x,y on a,b then skip record with x,y,a but
 	// process record with x,a,b.
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names))
 		return;
-	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmslv_get(pstate->groups_without_group_by_regex,
-		pgroup_by_field_values);
+	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmpkv_get(pstate->groups_without_group_by_regex,
+		pstate->pgroup_by_key);
 	if (pgroup_by_field_values_to_acc_fields == NULL) {
 		pgroup_by_field_values_to_acc_fields = lhmsv_alloc();
-		lhmslv_put(pstate->groups_without_group_by_regex, slls_copy(pgroup_by_field_values),
-			pgroup_by_field_values_to_acc_fields, FREE_ENTRY_KEY);
+		lhmpkv_put(pstate->groups_without_group_by_regex, pstate->pgroup_by_key,
+			pgroup_by_field_values_to_acc_fields);
 	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// for x=1 and y=2
 	pstate->pvalue_ingestor(pinrec, pstate, pgroup_by_field_values_to_acc_fields);
-
-	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	slls_free(pgroup_by_field_values);
 }
 
 // ----------------------------------------------------------------
@@ -462,29 +557,29 @@ static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_st
 	lhmss_t* group_by_pairs = mlr_reference_key_value_pairs_from_regex_names(pinrec,
 		pstate->group_by_field_regexes, pstate->num_group_by_field_regexes, pstate->invert_regex_group_by_field_names);
 
-	slls_t* pgroup_by_field_names = slls_alloc();
-	for (lhmsse_t* pe = group_by_pairs->phead; pe != NULL; pe = pe->pnext) {
-		slls_append_no_free(pgroup_by_field_names, pe->key);
-	}
-	slls_t* pgroup_by_field_values = slls_alloc();
+	packed_key_t* pgroup_by_names_key = pstate->pgroup_by_names_key;
+	packed_key_t* pgroup_by_key = pstate->pgroup_by_key;
+	packed_key_clear(pgroup_by_names_key);
+	packed_key_clear(pgroup_by_key);
 	for (lhmsse_t* pe = group_by_pairs->phead; pe != NULL; pe = pe->pnext) {
-		slls_append_no_free(pgroup_by_field_values, pe->value);
+		packed_key_append(pgroup_by_names_key, pe->key);
+		packed_key_append(pgroup_by_key, pe->value);
 	}
+	packed_key_finish(pgroup_by_names_key);
+	packed_key_finish(pgroup_by_key);
 
 	// Two-level map: group-by field names -> group-by field values -> acc-field map
-	lhmslv_t* pgroups_by_names = lhmslv_get(pstate->groups_with_group_by_regex, pgroup_by_field_names);
+	lhmpkv_t* pgroups_by_names = lhmpkv_get(pstate->groups_with_group_by_regex, pgroup_by_names_key);
 	if (pgroups_by_names == NULL) {
-		pgroups_by_names = lhmslv_alloc();
-		lhmslv_put(pstate->groups_with_group_by_regex, slls_copy(pgroup_by_field_names), pgroups_by_names,
-			FREE_ENTRY_KEY);
+		pgroups_by_names = lhmpkv_alloc();
+		lhmpkv_put(pstate->groups_with_group_by_regex, pgroup_by_names_key, pgroups_by_names);
 	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmslv_get(pgroups_by_names, pgroup_by_field_values);
+	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmpkv_get(pgroups_by_names, pgroup_by_key);
 	if (pgroup_by_field_values_to_acc_fields == NULL) {
 		pgroup_by_field_values_to_acc_fields = lhmsv_alloc();
-		lhmslv_put(pgroups_by_names, slls_copy(pgroup_by_field_values), pgroup_by_field_values_to_acc_fields,
-			FREE_ENTRY_KEY);
+		lhmpkv_put(pgroups_by_names, pgroup_by_key, pgroup_by_field_values_to_acc_fields);
 	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -492,8 +587,6 @@ static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_st
 	pstate->pvalue_ingestor(pinrec, pstate, pgroup_by_field_values_to_acc_fields);
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	slls_free(pgroup_by_field_names);
-	slls_free(pgroup_by_field_values);
 	lhmss_free(group_by_pairs);
 }
 
@@ -532,36 +625,65 @@ static void mapper_stats1_value_ingest_with_regexes(
 }
 
 // ----------------------------------------------------------------
-static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_t* pstate,
-	char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field)
+// For percentiles there is one unique accumulator given (for example) five distinct
+// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
+// percentile-keeper. There are multiple output accumulators: each references the same
+// underlying percentile-keeper but with distinct parameters.  Hence the ->pin and ->pout maps.
+static acc_map_pair_t* mapper_stats1_get_acc_map_pair(mapper_stats1_state_t* pstate, char* value_field_name,
+	lhmsv_t* pgroup_to_acc_field)
 {
-	// For percentiles there is one unique accumulator given (for example) five distinct
-	// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
-	// percentile-keeper. There are multiple output accumulators: each references the same
-	// underlying percentile-keeper but with distinct parameters.  Hence the ->pin and ->pout maps.
 	acc_map_pair_t* pacc_field_to_acc_states = lhmsv_get(pgroup_to_acc_field, value_field_name);
 	if (pacc_field_to_acc_states == NULL) {
 		pacc_field_to_acc_states = mlr_malloc_or_die(sizeof(acc_map_pair_t));
 		pacc_field_to_acc_states->pin  = lhmsv_alloc();
 		pacc_field_to_acc_states->pout = lhmsv_alloc();
-		lhmsv_put(pgroup_to_acc_field, value_field_name, pacc_field_to_acc_states, NO_FREE);
+		pacc_field_to_acc_states->pfused = NULL;
+		// Regex-matched field names point into the current record, which will be freed.
+		if (pstate->value_field_regexes != NULL)
+			lhmsv_put(pgroup_to_acc_field, mlr_strdup_or_die(value_field_name), pacc_field_to_acc_states,
+				FREE_ENTRY_KEY);
+		else
+			lhmsv_put(pgroup_to_acc_field, value_field_name, pacc_field_to_acc_states, NO_FREE);
 	}
-	lhmsv_t* acc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
-	lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
 
 	// Look up presence of all accumulators at this level's hashmap.
-	char* presence = lhmsv_get(acc_field_to_acc_state_in, fake_acc_name_for_setups);
+	char* presence = lhmsv_get(pacc_field_to_acc_states->pin, fake_acc_name_for_setups);
 	if (presence == NULL) {
-		make_stats1_accs(value_field_name, pstate->paccumulator_names, pstate->allow_int_float,
-			pstate->do_interpolated_percentiles, acc_field_to_acc_state_in, acc_field_to_acc_state_out);
-		lhmsv_put(acc_field_to_acc_state_in, fake_acc_name_for_setups, fake_acc_name_for_setups, NO_FREE);
+		if (pstate->pplan != NULL)
+			pacc_field_to_acc_states->pfused = make_stats1_fused_accs(pstate->pplan, value_field_name,
+				pstate->paccumulator_names, pstate->do_interpolated_percentiles, pstate->do_approx_percentiles,
+				pstate->approx_percentile_k, pacc_field_to_acc_states->pin, pacc_field_to_acc_states->pout);
+		else
+			make_stats1_accs(value_field_name, pstate->paccumulator_names, pstate->allow_int_float,
+				pstate->do_interpolated_percentiles, pstate->do_approx_percentiles, pstate->approx_percentile_k,
+				pacc_field_to_acc_states->pin, pacc_field_to_acc_states->pout);
+		lhmsv_put(pacc_field_to_acc_states->pin, fake_acc_name_for_setups, fake_acc_name_for_setups, NO_FREE);
 	}
+	return pacc_field_to_acc_states;
+}
+
+static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_t* pstate,
+	char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field)
+{
+	acc_map_pair_t* pacc_field_to_acc_states = mapper_stats1_get_acc_map_pair(pstate, value_field_name,
+		pgroup_to_acc_field);
+	lhmsv_t* acc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
+	lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
 
 	if (value_field_sval == NULL) // Key not present
 		return;
 	if (*value_field_sval == 0) // Key present with null value
 		return;
 
+	// The fused accumulators take the value once, between them. Their views in the in-map have no ingest
+	// functions, so the loop below is only for the others.
+	lhmsve_t* pfirst = acc_field_to_acc_state_in->phead;
+	if (pacc_field_to_acc_states->pfused != NULL) {
+		stats1_fused_singest(pacc_field_to_acc_states->pfused, value_field_sval);
+		if (pstate->pplan->num_unfused_names == 0)
+			pfirst = NULL;
+	}
+
 	int have_dval = FALSE;
 	int have_nval = FALSE;
 	double value_field_dval = -999.0;
@@ -574,7 +696,7 @@ static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_
 	// is only one percentiles accumulator to be told about each point. In
 	// the emitter it will be asked to produce output twice: once for the
 	// 10th percentile & once for the 90th.
-	for (lhmsve_t* pc = acc_field_to_acc_state_in->phead; pc != NULL; pc = pc->pnext) {
+	for (lhmsve_t* pc = pfirst; pc != NULL; pc = pc->pnext) {
 		char* stats1_acc_name = pc->key;
 		if (streq(stats1_acc_name, fake_acc_name_for_setups))
 			continue;
@@ -606,19 +728,90 @@ static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_
 	}
 }
 
+// ----------------------------------------------------------------
+// Typed columnar input can go straight to the accumulators when there's only the one group, and the
+// accumulators needn't see the numbers' original text.
+static lrec_reader_number_sink_t* mapper_stats1_input_number_sink(mapper_t* pmapper) {
+	mapper_stats1_state_t* pstate = pmapper->pvstate;
+	return pstate->takes_numbers ? &pstate->number_sink : NULL;
+}
+
+static int mapper_stats1_accs_take_numbers(slls_t* paccumulator_names, int allow_int_float,
+	int do_interpolated_percentiles, int do_approx_percentiles, int approx_percentile_k)
+{
+	for (sllse_t* pe = paccumulator_names->phead; pe != NULL; pe = pe->pnext) {
+		stats1_acc_t* pstats1_acc = NULL;
+		if (!is_percentile_acc_name(pe->value))
+			pstats1_acc = make_stats1_acc("", pe->value, allow_int_float, do_interpolated_percentiles);
+		else if (do_approx_percentiles || is_approx_percentile_acc_name(pe->value))
+			pstats1_acc = stats1_approx_percentile_alloc("", pe->value, allow_int_float, do_interpolated_percentiles,
+				approx_percentile_k);
+		else
+			pstats1_acc = stats1_percentile_alloc("", pe->value, allow_int_float, do_interpolated_percentiles);
+		if (pstats1_acc == NULL) // Unknown names are reported on the first record.
+			return FALSE;
+		int ok = pstats1_acc->psingest_func == NULL || pstats1_acc->ptingest_func != NULL;
+		pstats1_acc->pfree_func(pstats1_acc);
+		if (!ok)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// As mapper_stats1_ingest_name_value, for a block of records without group-by.
+static void mapper_stats1_ingest_numbers(void* pvstate, char* value_field_name, mv_t* pvalues, int num_values,
+	context_t* pctx)
+{
+	mapper_stats1_state_t* pstate = pvstate;
+	packed_key_clear(pstate->pgroup_by_key); // the one group
+	packed_key_finish(pstate->pgroup_by_key);
+	lhmsv_t* pgroup_to_acc_field = lhmpkv_get(pstate->groups_without_group_by_regex, pstate->pgroup_by_key);
+	if (pgroup_to_acc_field == NULL) {
+		pgroup_to_acc_field = lhmsv_alloc();
+		lhmpkv_put(pstate->groups_without_group_by_regex, pstate->pgroup_by_key, pgroup_to_acc_field);
+	}
+
+	acc_map_pair_t* pacc_field_to_acc_states = mapper_stats1_get_acc_map_pair(pstate, value_field_name,
+		pgroup_to_acc_field);
+
+	if (pacc_field_to_acc_states->pfused != NULL) {
+		for (int i = 0; i < num_values; i++)
+			stats1_fused_tingest(pacc_field_to_acc_states->pfused, &pvalues[i]);
+		if (pstate->pplan->num_unfused_names == 0)
+			return;
+	}
+
+	for (lhmsve_t* pc = pacc_field_to_acc_states->pin->phead; pc != NULL; pc = pc->pnext) {
+		if (streq(pc->key, fake_acc_name_for_setups))
+			continue;
+		stats1_acc_t* pstats1_acc = pc->pvvalue;
+		for (int i = 0; i < num_values; i++) {
+			mv_t value = pvalues[i];
+			double dvalue = (value.type == MT_INT) ? (double)value.u.intv : value.u.fltv;
+			if (pstats1_acc->pdingest_func != NULL)
+				pstats1_acc->pdingest_func(pstats1_acc->pvstate, dvalue);
+			if (pstats1_acc->pningest_func != NULL) {
+				mv_t nvalue = pstate->allow_int_float ? value : mv_from_float(dvalue);
+				pstats1_acc->pningest_func(pstats1_acc->pvstate, &nvalue);
+			}
+			if (pstats1_acc->psingest_func != NULL)
+				pstats1_acc->ptingest_func(pstats1_acc->pvstate, &value);
+		}
+	}
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_stats1_emit_all_without_group_by_regexes(mapper_stats1_state_t* pstate) {
 	sllv_t* poutrecs = sllv_alloc();
 
-	for (lhmslve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
-		slls_t* pgroup_by_field_values = pa->key;
+	for (lhmpkve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
 		lrec_t* poutrec = lrec_unbacked_alloc();
 
 		// Add in a=s,b=t fields:
 		sllse_t* pb = pstate->pgroup_by_field_names->phead;
-		sllse_t* pc =         pgroup_by_field_values->phead;
-		for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-			lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+		char* value = packed_key_first(pa->key);
+		for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pa->key, value)) {
+			lrec_put(poutrec, pb->value, value, NO_FREE);
 		}
 
 		// Add in fields such as x_sum=#, y_count=#, etc.:
@@ -641,21 +834,23 @@ static sllv_t* mapper_stats1_emit_all_with_group_by_regexes(mapper_stats1_state_
 	sllv_t* poutrecs = sllv_alloc();
 
 	// Two-level map: group-by field names -> group-by field values -> acc-field map
-	for (lhmslve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
-		slls_t* pgroup_by_field_names = pa->key;
-		lhmslv_t* pgroups_by_names = pa->pvvalue;
+	for (lhmpkve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+		packed_key_t* pgroup_by_names_key = pa->key;
+		lhmpkv_t* pgroups_by_names = pa->pvvalue;
 
-		for (lhmslve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
-			slls_t* pgroup_by_field_values = pb->key;
+		for (lhmpkve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
+			packed_key_t* pgroup_by_key = pb->key;
 			lhmsv_t* pgroup_by_field_values_to_acc_field = pb->pvvalue;
 
 			lrec_t* poutrec = lrec_unbacked_alloc();
 
 			// Add in a=s,b=t fields:
-			sllse_t* pc = pgroup_by_field_names->phead;
-			sllse_t* pd = pgroup_by_field_values->phead;
-			for ( ; pc != NULL && pd != NULL; pc = pc->pnext, pd = pd->pnext) {
-				lrec_put(poutrec, pc->value, pd->value, NO_FREE);
+			char* name = packed_key_first(pgroup_by_names_key);
+			char* value = packed_key_first(pgroup_by_key);
+			for ( ; name != NULL && value != NULL;
+				name = packed_key_next(pgroup_by_names_key, name), value = packed_key_next(pgroup_by_key, value))
+			{
+				lrec_put(poutrec, name, value, NO_FREE);
 			}
 
 			// Add in fields such as x_sum=#, y_count=#, etc.:
@@ -691,3 +886,101 @@ static lrec_t* mapper_stats1_emit(mapper_stats1_state_t* pstate, lrec_t* poutrec
 	}
 	return poutrec;
 }
+
+// ----------------------------------------------------------------
+// State-file layout (see aggregate_state.h): the number of groups, then per group its field values, the
+// number of value fields, then per value field its name and its input accumulators. With group-by regexes
+// the groups are themselves grouped by their field names, as in the two-level map.
+static void mapper_stats1_write_state(mapper_stats1_state_t* pstate) {
+	FILE* output_stream = aggregate_state_open(pstate->pstate_spec);
+	if (pstate->groups_without_group_by_regex != NULL) {
+		lhmpkv_t* pgroups = pstate->groups_without_group_by_regex;
+		aggregate_state_put_varint(output_stream, pgroups->num_occupied);
+		for (lhmpkve_t* pa = pgroups->phead; pa != NULL; pa = pa->pnext) {
+			aggregate_state_put_packed_key(output_stream, pa->key);
+			mapper_stats1_write_group_state(output_stream, pa->pvvalue);
+		}
+	} else {
+		aggregate_state_put_varint(output_stream, pstate->groups_with_group_by_regex->num_occupied);
+		for (lhmpkve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+			aggregate_state_put_packed_key(output_stream, pa->key);
+			lhmpkv_t* pgroups_by_names = pa->pvvalue;
+			aggregate_state_put_varint(output_stream, pgroups_by_names->num_occupied);
+			for (lhmpkve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
+				aggregate_state_put_packed_key(output_stream, pb->key);
+				mapper_stats1_write_group_state(output_stream, pb->pvvalue);
+			}
+		}
+	}
+	aggregate_state_close(output_stream, pstate->pstate_spec);
+}
+
+static void mapper_stats1_write_group_state(FILE* output_stream, lhmsv_t* pgroup_to_acc_field) {
+	aggregate_state_put_varint(output_stream, pgroup_to_acc_field->num_occupied);
+	for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
+		acc_map_pair_t* pacc_field_to_acc_states = pb->pvvalue;
+		lhmsv_t* pacc_field_to_acc_state_in = pacc_field_to_acc_states->pin;
+		aggregate_state_put_string(output_stream, pb->key);
+		aggregate_state_put_varint(output_stream, pacc_field_to_acc_state_in->num_occupied - 1);
+		for (lhmsve_t* pc = pacc_field_to_acc_state_in->phead; pc != NULL; pc = pc->pnext) {
+			if (streq(pc->key, fake_acc_name_for_setups))
+				continue;
+			stats1_acc_t* pstats1_acc = pc->pvvalue;
+			aggregate_state_put_string(output_stream, pc->key);
+			pstats1_acc->pwrite_state_func(pstats1_acc->pvstate, output_stream);
+		}
+	}
+}
+
+// Groups, value fields and accumulators are created as on ingest, in the order first seen. Names point
+// into the reader's contents, which outlive this mapper.
+static void mapper_stats1_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader) {
+	mapper_stats1_state_t* pstate = pmapper->pvstate;
+	if (pstate->groups_without_group_by_regex != NULL) {
+		mapper_stats1_merge_group_state(pstate, pstate->groups_without_group_by_regex, preader);
+	} else {
+		unsigned long long num_names = aggregate_state_get_varint(preader);
+		for (unsigned long long i = 0; i < num_names; i++) {
+			aggregate_state_get_packed_key(preader, pstate->pgroup_by_names_key);
+			lhmpkv_t* pgroups_by_names = lhmpkv_get(pstate->groups_with_group_by_regex, pstate->pgroup_by_names_key);
+			if (pgroups_by_names == NULL) {
+				pgroups_by_names = lhmpkv_alloc();
+				lhmpkv_put(pstate->groups_with_group_by_regex, pstate->pgroup_by_names_key, pgroups_by_names);
+			}
+			mapper_stats1_merge_group_state(pstate, pgroups_by_names, preader);
+		}
+	}
+}
+
+static void mapper_stats1_merge_group_state(mapper_stats1_state_t* pstate, lhmpkv_t* pgroups,
+	aggregate_state_reader_t* preader)
+{
+	unsigned long long num_groups = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_groups; i++) {
+		aggregate_state_get_packed_key(preader, pstate->pgroup_by_key);
+		lhmsv_t* pgroup_to_acc_field = lhmpkv_get(pgroups, pstate->pgroup_by_key);
+		if (pgroup_to_acc_field == NULL) {
+			pgroup_to_acc_field = lhmsv_alloc();
+			lhmpkv_put(pgroups, pstate->pgroup_by_key, pgroup_to_acc_field);
+		}
+
+		unsigned long long num_value_fields = aggregate_state_get_varint(preader);
+		for (unsigned long long j = 0; j < num_value_fields; j++) {
+			char* value_field_name = aggregate_state_get_string(preader);
+			acc_map_pair_t* pacc_field_to_acc_states = mapper_stats1_get_acc_map_pair(pstate, value_field_name,
+				pgroup_to_acc_field);
+			if (pacc_field_to_acc_states->pfused != NULL)
+				stats1_fused_merge_begin(pacc_field_to_acc_states->pfused);
+			unsigned long long num_accs = aggregate_state_get_varint(preader);
+			for (unsigned long long k = 0; k < num_accs; k++) {
+				char* stats1_acc_name = aggregate_state_get_string(preader);
+				stats1_acc_t* pstats1_acc = streq(stats1_acc_name, fake_acc_name_for_setups)
+					? NULL
+					: lhmsv_get(pacc_field_to_acc_states->pin, stats1_acc_name);
+				if (pstats1_acc == NULL)
+					aggregate_state_corrupt(preader);
+				pstats1_acc->pmerge_state_func(pstats1_acc->pvstate, preader);
+			}
+		}
+	}
+}
@@ -15,6 +15,7 @@
 #include "containers/mixutil.h"
 #include "containers/dvector.h"
 #include "mapping/mappers.h"
+#include "mapping/aggregate_state.h"
 #include "cli/argparse.h"
 
 typedef enum _bivar_measure_t {
@@ -30,12 +31,17 @@ typedef void stats2_ingest_func_t(void* pvstate, double x, double y);
 typedef void   stats2_emit_func_t(void* pvstate, char* name1, char* name2, lrec_t* poutrec);
 typedef void    stats2_fit_func_t(void* pvstate, double x, double y, lrec_t* poutrec);
 typedef void   stats2_free_func_t(struct _stats2_acc_t* pstats2_acc);
+// For --write-state and mlr merge-state: see aggregate_state.h.
+typedef void stats2_write_state_func_t(void* pvstate, FILE* output_stream);
+typedef void stats2_merge_state_func_t(void* pvstate, aggregate_state_reader_t* preader);
 
 typedef struct _stats2_acc_t {
 	void* pvstate;
 	stats2_ingest_func_t* pingest_func;
 	stats2_emit_func_t*   pemit_func;
 	stats2_fit_func_t*    pfit_func;
+	stats2_write_state_func_t* pwrite_state_func;
+	stats2_merge_state_func_t* pmerge_state_func;
 	stats2_free_func_t*   pfree_func; // virtual destructor
 } stats2_acc_t;
 
@@ -49,6 +55,7 @@ typedef struct _mapper_stats2_state_t {
 	int       do_verbose;
 	int       do_iterative_stats;
 	int       do_hold_and_fit;
+	aggregate_state_spec_t* pstate_spec; // for --write-state, else NULL
 } mapper_stats2_state_t;
 
 typedef stats2_acc_t* stats2_alloc_func_t(char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name, int do_verbose);
@@ -59,7 +66,7 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_name_pairs, slls_t* pgroup_by_field_names,
-	int do_verbose, int do_iterative_stats, int do_hold_and_fit);
+	int do_verbose, int do_iterative_stats, int do_hold_and_fit, aggregate_state_spec_t* pstate_spec);
 static void      mapper_stats2_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_stats2_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static void      mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_state_t* pstate);
@@ -67,6 +74,8 @@ static sllv_t*   mapper_stats2_emit_all(mapper_stats2_state_t* pstate);
 static void      mapper_stats2_emit(mapper_stats2_state_t* pstate, lrec_t* pinrec,
 	char* value_field_name_1, char* value_field_name_2, lhmsv_t* pacc_fields_to_acc_state);
 static sllv_t*   mapper_stats2_fit_all(mapper_stats2_state_t* pstate);
+static void      mapper_stats2_write_state(mapper_stats2_state_t* pstate);
+static void      mapper_stats2_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader);
 
 static stats2_acc_t* make_stats2            (char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name, int do_verbose);
 static stats2_acc_t* stats2_linreg_pca_alloc(char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name, int do_verbose);
@@ -101,6 +110,7 @@ mapper_setup_t mapper_stats2_setup = {
 	.pusage_func = mapper_stats2_usage,
 	.pparse_func = mapper_stats2_parse_cli,
 	.ignores_input = FALSE,
+	.pmerge_state_func = mapper_stats2_merge_state,
 };
 
 // ----------------------------------------------------------------
@@ -123,6 +133,9 @@ static void mapper_stats2_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "               the input data to compute new fit fields. All input records are\n");
 	fprintf(o, "               held in memory until end of input stream. Has effect only for\n");
 	fprintf(o, "               linreg-ols, linreg-pca, and logireg.\n");
+	fprintf(o, "--write-state {filename}\n");
+	fprintf(o, "               At end of stream, also write the accumulators to this file, for\n");
+	fprintf(o, "               %s merge-state to combine with others. Not with -s or --fit.\n", argv0);
 	fprintf(o, "Only one of -s or --fit may be used.\n");
 	fprintf(o, "Example: %s %s -a linreg-pca -f x,y\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a linreg-ols,r2 -f x,y -g size,shape\n", argv0, verb);
@@ -139,7 +152,10 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	int             do_iterative_stats    = FALSE;
 	int             do_hold_and_fit       = FALSE;
 	int             allow_int_float       = TRUE;
+	char*           state_filename        = NULL;
 
+	int verb_argi = *pargi;
+	slls_t* pverb_argv = aggregate_state_copy_argv(argv, verb_argi, argc);
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
@@ -154,6 +170,7 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	// accumulators, so we accept here as well for all applicable stats2
 	// accumulators (i.e. none of them).
 	ap_define_false_flag(pstate,        "-F",    &allow_int_float);
+	ap_define_string_flag(pstate,       MLR_STATE_FLAG, &state_filename);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_stats2_usage(stderr, argv[0], verb);
@@ -163,6 +180,10 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 		mapper_stats2_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (state_filename != NULL && (do_iterative_stats || do_hold_and_fit)) {
+		mapper_stats2_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 	if (paccumulator_names == NULL || pvalue_field_names == NULL) {
 		mapper_stats2_usage(stderr, argv[0], verb);
 		return NULL;
@@ -172,14 +193,17 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 		return NULL;
 	}
 
+	aggregate_state_spec_t* pstate_spec = aggregate_state_spec_alloc(state_filename, pverb_argv,
+		*pargi - verb_argi);
+
 	return mapper_stats2_alloc(pstate, paccumulator_names, pvalue_field_names, pgroup_by_field_names,
-		do_verbose, do_iterative_stats, do_hold_and_fit);
+		do_verbose, do_iterative_stats, do_hold_and_fit, pstate_spec);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_name_pairs, slls_t* pgroup_by_field_names,
-	int do_verbose, int do_iterative_stats, int do_hold_and_fit)
+	int do_verbose, int do_iterative_stats, int do_hold_and_fit, aggregate_state_spec_t* pstate_spec)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -193,6 +217,7 @@ static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 	pstate->do_verbose               = do_verbose;
 	pstate->do_iterative_stats       = do_iterative_stats;
 	pstate->do_hold_and_fit          = do_hold_and_fit;
+	pstate->pstate_spec              = pstate_spec;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_stats2_process;
@@ -226,6 +251,7 @@ static void mapper_stats2_free(mapper_t* pmapper, context_t* _) {
 		sllv_free(plist);
 	}
 	lhmslv_free(pstate->record_groups);
+	aggregate_state_spec_free(pstate->pstate_spec);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -281,6 +307,8 @@ static sllv_t* mapper_stats2_process(lrec_t* pinrec, context_t* pctx, void* pvst
 		}
 	} else if (!pstate->do_iterative_stats) {
 		if (!pstate->do_hold_and_fit) {
+			if (pstate->pstate_spec != NULL)
+				mapper_stats2_write_state(pstate);
 			return mapper_stats2_emit_all(pstate);
 		} else {
 			return mapper_stats2_fit_all(pstate);
@@ -489,6 +517,73 @@ static sllv_t* mapper_stats2_fit_all(mapper_stats2_state_t* pstate) {
 // }
 // ================================================================
 
+// ----------------------------------------------------------------
+// State-file layout (see aggregate_state.h): the number of groups, then per group its field values, the
+// number of value-field pairs, then per pair the two names and the accumulators.
+static void mapper_stats2_write_state(mapper_stats2_state_t* pstate) {
+	FILE* output_stream = aggregate_state_open(pstate->pstate_spec);
+	aggregate_state_put_varint(output_stream, pstate->acc_groups->num_occupied);
+	for (lhmslve_t* pa = pstate->acc_groups->phead; pa != NULL; pa = pa->pnext) {
+		aggregate_state_put_slls(output_stream, pa->key);
+		lhms2v_t* pgroup_to_acc_field = pa->pvvalue;
+		aggregate_state_put_varint(output_stream, pgroup_to_acc_field->num_occupied);
+		for (lhms2ve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
+			lhmsv_t* pacc_fields_to_acc_state = pb->pvvalue;
+			aggregate_state_put_string(output_stream, pb->key1);
+			aggregate_state_put_string(output_stream, pb->key2);
+			aggregate_state_put_varint(output_stream, pacc_fields_to_acc_state->num_occupied);
+			for (lhmsve_t* pc = pacc_fields_to_acc_state->phead; pc != NULL; pc = pc->pnext) {
+				stats2_acc_t* pstats2_acc = pc->pvvalue;
+				aggregate_state_put_string(output_stream, pc->key);
+				pstats2_acc->pwrite_state_func(pstats2_acc->pvstate, output_stream);
+			}
+		}
+	}
+	aggregate_state_close(output_stream, pstate->pstate_spec);
+}
+
+// Groups and accumulators are created as on ingest, in the order first seen. Names point into the reader's
+// contents, which outlive this mapper.
+static void mapper_stats2_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader) {
+	mapper_stats2_state_t* pstate = pmapper->pvstate;
+	unsigned long long num_groups = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_groups; i++) {
+		slls_t* pgroup_by_field_values = aggregate_state_get_slls(preader);
+		lhms2v_t* pgroup_to_acc_field = lhmslv_get(pstate->acc_groups, pgroup_by_field_values);
+		if (pgroup_to_acc_field == NULL) {
+			pgroup_to_acc_field = lhms2v_alloc();
+			lhmslv_put(pstate->acc_groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
+		}
+		slls_free(pgroup_by_field_values);
+
+		unsigned long long num_pairs = aggregate_state_get_varint(preader);
+		for (unsigned long long j = 0; j < num_pairs; j++) {
+			char* value_field_name_1 = aggregate_state_get_string(preader);
+			char* value_field_name_2 = aggregate_state_get_string(preader);
+			lhmsv_t* pacc_fields_to_acc_state = lhms2v_get(pgroup_to_acc_field, value_field_name_1, value_field_name_2);
+			if (pacc_fields_to_acc_state == NULL) {
+				pacc_fields_to_acc_state = lhmsv_alloc();
+				lhms2v_put(pgroup_to_acc_field, value_field_name_1, value_field_name_2, pacc_fields_to_acc_state,
+					NO_FREE);
+			}
+
+			unsigned long long num_accs = aggregate_state_get_varint(preader);
+			for (unsigned long long k = 0; k < num_accs; k++) {
+				char* stats2_acc_name = aggregate_state_get_string(preader);
+				stats2_acc_t* pstats2_acc = lhmsv_get(pacc_fields_to_acc_state, stats2_acc_name);
+				if (pstats2_acc == NULL) {
+					pstats2_acc = make_stats2(value_field_name_1, value_field_name_2, stats2_acc_name,
+						pstate->do_verbose);
+					if (pstats2_acc == NULL)
+						aggregate_state_corrupt(preader);
+					lhmsv_put(pacc_fields_to_acc_state, stats2_acc_name, pstats2_acc, NO_FREE);
+				}
+				pstats2_acc->pmerge_state_func(pstats2_acc->pvstate, preader);
+			}
+		}
+	}
+}
+
 // ----------------------------------------------------------------
 static stats2_acc_t* make_stats2(char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name, int do_verbose) {
 	for (int i = 0; i < stats2_acc_lookup_table_length; i++)
@@ -560,6 +655,22 @@ static void stats2_linreg_ols_fit(void* pvstate, double x, double y, lrec_t* pou
 		lrec_put(poutrec, pstate->fit_output_field_name, sfit, FREE_ENTRY_VALUE);
 	}
 }
+static void stats2_linreg_ols_write_state(void* pvstate, FILE* output_stream) {
+	stats2_linreg_ols_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumy);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+	aggregate_state_put_double(output_stream, pstate->sumxy);
+}
+static void stats2_linreg_ols_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats2_linreg_ols_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumy  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+	pstate->sumxy += aggregate_state_get_double(preader);
+}
 static void stats2_linreg_ols_free(stats2_acc_t* pstats2_acc) {
 	stats2_linreg_ols_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->m_output_field_name);
@@ -590,6 +701,8 @@ static stats2_acc_t* stats2_linreg_ols_alloc(char* value_field_name_1, char* val
 	pstats2_acc->pingest_func = stats2_linreg_ols_ingest;
 	pstats2_acc->pemit_func   = stats2_linreg_ols_emit;
 	pstats2_acc->pfit_func    = stats2_linreg_ols_fit;
+	pstats2_acc->pwrite_state_func = stats2_linreg_ols_write_state;
+	pstats2_acc->pmerge_state_func = stats2_linreg_ols_merge_state;
 	pstats2_acc->pfree_func   = stats2_linreg_ols_free;
 	return pstats2_acc;
 }
@@ -632,6 +745,22 @@ static void stats2_logireg_emit(void* pvstate, char* name1, char* name2, lrec_t*
 	char* nval = mlr_alloc_string_from_ll(pstate->pxs->size);
 	lrec_put(poutrec, pstate->n_output_field_name, nval, FREE_ENTRY_VALUE);
 }
+static void stats2_logireg_write_state(void* pvstate, FILE* output_stream) {
+	stats2_logireg_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->pxs->size);
+	for (unsigned long long i = 0; i < pstate->pxs->size; i++) {
+		aggregate_state_put_double(output_stream, pstate->pxs->data[i]);
+		aggregate_state_put_double(output_stream, pstate->pys->data[i]);
+	}
+}
+static void stats2_logireg_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats2_logireg_state_t* pstate = pvstate;
+	unsigned long long size = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < size; i++) {
+		dvector_append(pstate->pxs, aggregate_state_get_double(preader));
+		dvector_append(pstate->pys, aggregate_state_get_double(preader));
+	}
+}
 static void stats2_logireg_free(stats2_acc_t* pstats2_acc) {
 	stats2_logireg_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->m_output_field_name);
@@ -678,6 +807,8 @@ static stats2_acc_t* stats2_logireg_alloc(char* value_field_name_1, char* value_
 	pstats2_acc->pingest_func = stats2_logireg_ingest;
 	pstats2_acc->pemit_func   = stats2_logireg_emit;
 	pstats2_acc->pfit_func    = stats2_logireg_fit;
+	pstats2_acc->pwrite_state_func = stats2_logireg_write_state;
+	pstats2_acc->pmerge_state_func = stats2_logireg_merge_state;
 	pstats2_acc->pfree_func   = stats2_logireg_free;
 	return pstats2_acc;
 }
@@ -723,6 +854,24 @@ static void stats2_r2_emit(void* pvstate, char* name1, char* name2, lrec_t* pout
 		lrec_put(poutrec, pstate->r2_output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats2_r2_write_state(void* pvstate, FILE* output_stream) {
+	stats2_r2_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumy);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+	aggregate_state_put_double(output_stream, pstate->sumxy);
+	aggregate_state_put_double(output_stream, pstate->sumy2);
+}
+static void stats2_r2_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats2_r2_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumy  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+	pstate->sumxy += aggregate_state_get_double(preader);
+	pstate->sumy2 += aggregate_state_get_double(preader);
+}
 static void stats2_r2_free(stats2_acc_t* pstats2_acc) {
 	stats2_r2_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->r2_output_field_name);
@@ -744,6 +893,8 @@ static stats2_acc_t* stats2_r2_alloc(char* value_field_name_1, char* value_field
 	pstats2_acc->pingest_func = stats2_r2_ingest;
 	pstats2_acc->pemit_func   = stats2_r2_emit;
 	pstats2_acc->pfit_func    = NULL;
+	pstats2_acc->pwrite_state_func = stats2_r2_write_state;
+	pstats2_acc->pmerge_state_func = stats2_r2_merge_state;
 	pstats2_acc->pfree_func   = stats2_r2_free;
 
 	return pstats2_acc;
@@ -917,6 +1068,24 @@ static void linreg_pca_fit(void* pvstate, double x, double y, lrec_t* poutrec) {
 	}
 }
 
+static void stats2_corr_cov_write_state(void* pvstate, FILE* output_stream) {
+	stats2_corr_cov_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumy);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+	aggregate_state_put_double(output_stream, pstate->sumxy);
+	aggregate_state_put_double(output_stream, pstate->sumy2);
+}
+static void stats2_corr_cov_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats2_corr_cov_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumy  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+	pstate->sumxy += aggregate_state_get_double(preader);
+	pstate->sumy2 += aggregate_state_get_double(preader);
+}
 static void stats2_corr_cov_free(stats2_acc_t* pstats2_acc) {
 	stats2_corr_cov_state_t* pstate = pstats2_acc->pvstate;
 
@@ -991,6 +1160,8 @@ static stats2_acc_t* stats2_corr_cov_alloc(char* value_field_name_1, char* value
 		pstats2_acc->pfit_func = linreg_pca_fit;
 	else
 		pstats2_acc->pfit_func = NULL;
+	pstats2_acc->pwrite_state_func = stats2_corr_cov_write_state;
+	pstats2_acc->pmerge_state_func = stats2_corr_cov_merge_state;
 	pstats2_acc->pfree_func = stats2_corr_cov_free;
 
 	return pstats2_acc;
@@ -7,7 +7,7 @@
 #include "containers/sllv.h"
 #include "containers/slls.h"
 #include "lib/string_array.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
 #include "lib/mvfuncs.h"
@@ -43,7 +43,8 @@ typedef struct _mapper_step_state_t {
 	string_array_t* pvalue_field_names;    // parameter
 	string_array_t* pvalue_field_values;   // scratch space used per-record
 	slls_t*         pgroup_by_field_names; // parameter
-	lhmslv_t*       groups;
+	packed_key_t*   pgroup_by_key;         // scratch space used per-record
+	lhmpkv_t*       groups;
 	int             allow_int_float;
 	slls_t*         pstring_alphas;
 	slls_t*         pewma_suffixes;
@@ -204,7 +205,8 @@ static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, st
 	pstate->pvalue_field_names    = pvalue_field_names;
 	pstate->pvalue_field_values   = string_array_alloc(pvalue_field_names->length);
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
-	pstate->groups                = lhmslv_alloc();
+	pstate->pgroup_by_key         = packed_key_alloc();
+	pstate->groups                = lhmpkv_alloc();
 	pstate->allow_int_float       = allow_int_float;
 	pstate->pstring_alphas        = pstring_alphas;
 	pstate->pewma_suffixes        = pewma_suffixes;
@@ -225,9 +227,9 @@ static void mapper_step_free(mapper_t* pmapper, context_t* _) {
 	slls_free(pstate->pstring_alphas);
 	slls_free(pstate->pewma_suffixes);
 
-	// lhmslv_free and lhmsv_free will free the hashmap keys; we need to free
+	// lhmpkv_free and lhmsv_free will free the hashmap keys; we need to free
 	// the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+	for (lhmpkve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
 		lhmsv_t* pgroup_to_acc_field = pa->pvvalue;
 		for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
 			lhmsv_t* pacc_field_to_acc_state = pb->pvvalue;
@@ -239,7 +241,8 @@ static void mapper_step_free(mapper_t* pmapper, context_t* _) {
 		}
 		lhmsv_free(pgroup_to_acc_field);
 	}
-	lhmslv_free(pstate->groups);
+	lhmpkv_free(pstate->groups);
+	packed_key_free(pstate->pgroup_by_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -253,19 +256,14 @@ static sllv_t* mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 
 	// ["s", "t"]
 	mlr_reference_values_from_record_into_string_array(pinrec, pstate->pvalue_field_names, pstate->pvalue_field_values);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names))
 		return sllv_single(pinrec);
-	}
 
-	lhmsv_t* pgroup_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
+	lhmsv_t* pgroup_to_acc_field = lhmpkv_get(pstate->groups, pstate->pgroup_by_key);
 	if (pgroup_to_acc_field == NULL) {
 		pgroup_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
+		lhmpkv_put(pstate->groups, pstate->pgroup_by_key, pgroup_to_acc_field);
 	}
-	slls_free(pgroup_by_field_values);
 
 	// for x=1 and y=2
 	int n = pstate->pvalue_field_names->length;
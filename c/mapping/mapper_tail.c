@@ -16,6 +16,7 @@ typedef struct _mapper_tail_state_t {
 	slls_t* pgroup_by_field_names;
 	unsigned long long tail_count;
 	lhmslv_t* precord_lists_by_group;
+	lrec_reader_record_ranges_t record_ranges;
 } mapper_tail_state_t;
 
 static void      mapper_tail_usage(FILE* o, char* argv0, char* verb);
@@ -23,6 +24,10 @@ static mapper_t* mapper_tail_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_tail_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long tail_count);
 static void      mapper_tail_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_tail_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static lrec_reader_record_ranges_t* mapper_tail_input_record_ranges(mapper_t* pmapper);
+static long long mapper_tail_input_tail_count(mapper_t* pmapper);
+static int       mapper_tail_record_ranges(void* pvstate, long long num_records, lrec_reader_record_range_t** pranges);
 static sllv_t*   mapper_tail_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
@@ -31,6 +36,9 @@ mapper_setup_t mapper_tail_setup = {
 	.pusage_func = mapper_tail_usage,
 	.pparse_func = mapper_tail_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_tail_input_fields,
+	.pinput_record_ranges_func = mapper_tail_input_record_ranges,
+	.pinput_tail_count_func = mapper_tail_input_tail_count,
 };
 
 // ----------------------------------------------------------------
@@ -71,6 +79,8 @@ static mapper_t* mapper_tail_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
 	pstate->tail_count             = tail_count;
 	pstate->precord_lists_by_group = lhmslv_alloc();
+	pstate->record_ranges.pranges_func = mapper_tail_record_ranges;
+	pstate->record_ranges.pvstate      = pstate;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_tail_process;
@@ -96,6 +106,38 @@ static void mapper_tail_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_tail_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_tail_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS_THROUGH;
+}
+
+// ----------------------------------------------------------------
+// Without -g, the last n records are the ones wanted. Not with -n 0, though, nor in mapper_tail_input_tail_count:
+// mapper_tail_process still keeps the last record then.
+static lrec_reader_record_ranges_t* mapper_tail_input_record_ranges(mapper_t* pmapper) {
+	mapper_tail_state_t* pstate = pmapper->pvstate;
+	return (pstate->pgroup_by_field_names->length == 0 && pstate->tail_count > 0) ? &pstate->record_ranges : NULL;
+}
+
+static int mapper_tail_record_ranges(void* pvstate, long long num_records, lrec_reader_record_range_t** pranges) {
+	mapper_tail_state_t* pstate = pvstate;
+	lrec_reader_record_range_t* ranges = mlr_malloc_or_die(sizeof(lrec_reader_record_range_t));
+	ranges[0].start = (num_records > (long long)pstate->tail_count) ? num_records - pstate->tail_count : 0LL;
+	ranges[0].end   = num_records;
+	*pranges = ranges;
+	return 1;
+}
+
+static long long mapper_tail_input_tail_count(mapper_t* pmapper) {
+	mapper_tail_state_t* pstate = pmapper->pvstate;
+	return (pstate->pgroup_by_field_names->length == 0 && pstate->tail_count > 0)
+		? (long long)pstate->tail_count
+		: -1LL;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_tail_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_tail_state_t* pstate = pvstate;
@@ -7,12 +7,13 @@
 #include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/lhmsv.h"
 #include "containers/top_keeper.h"
 #include "containers/mixutil.h"
 #include "lib/mvfuncs.h"
 #include "mapping/mappers.h"
+#include "mapping/aggregate_state.h"
 #include "cli/argparse.h"
 
 #define DEFAULT_OUTPUT_FIELD_NAME "top_idx"
@@ -27,19 +28,27 @@ typedef struct _mapper_top_state_t {
 	int show_full_records;
 	int allow_int_float;
 	maybe_sign_flipper_t* pmaybe_sign_flipper;
-	lhmslv_t* groups;
+	packed_key_t* pgroup_by_key; // scratch, refilled per record
+	lhmpkv_t* groups;
 	char* output_field_name;
+	aggregate_state_spec_t* pstate_spec; // for --write-state, else NULL
 } mapper_top_state_t;
 
 static void      mapper_top_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_top_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names, slls_t* pgroup_by_field_names,
-	int top_count, int do_max, int show_full_records, int allow_int_float, char* output_field_name);
+	int top_count, int do_max, int show_full_records, int allow_int_float, char* output_field_name,
+	aggregate_state_spec_t* pstate_spec);
 static void      mapper_top_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_top_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static void      mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate);
+static lhmsv_t*  mapper_top_get_group(mapper_top_state_t* pstate, packed_key_t* pgroup_by_key);
+static top_keeper_t* mapper_top_get_keeper(mapper_top_state_t* pstate, lhmsv_t* group_to_acc_field,
+	char* value_field_name);
 static sllv_t*   mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx);
+static void      mapper_top_write_state(mapper_top_state_t* pstate);
+static void      mapper_top_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_top_setup = {
@@ -47,6 +56,7 @@ mapper_setup_t mapper_top_setup = {
 	.pusage_func = mapper_top_usage,
 	.pparse_func = mapper_top_parse_cli,
 	.ignores_input = FALSE,
+	.pmerge_state_func = mapper_top_merge_state,
 };
 
 // ----------------------------------------------------------------
@@ -61,9 +71,13 @@ static void mapper_top_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "--min         Print top smallest values; default is top largest values.\n");
 	fprintf(o, "-F            Keep top values as floats even if they look like integers.\n");
 	fprintf(o, "-o {name}     Field name for output indices. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--write-state {filename}\n");
+	fprintf(o, "              At end of stream, also write the top values, and records with -a,\n");
+	fprintf(o, "              to this file, for %s merge-state to combine with others.\n", argv0);
 
 	fprintf(o, "Prints the n records with smallest/largest values at specified fields,\n");
-	fprintf(o, "optionally by category.\n");
+	fprintf(o, "optionally by category. Of equal values, the later ones are printed first,\n");
+	fprintf(o, "and kept in preference to earlier ones.\n");
 }
 
 static mapper_t* mapper_top_parse_cli(int* pargi, int argc, char** argv,
@@ -76,7 +90,10 @@ static mapper_t* mapper_top_parse_cli(int* pargi, int argc, char** argv,
 	int     do_max                = TRUE;
 	int     allow_int_float       = TRUE;
 	char*   output_field_name     = DEFAULT_OUTPUT_FIELD_NAME;
+	char*   state_filename        = NULL;
 
+	int verb_argi = *pargi;
+	slls_t* pverb_argv = aggregate_state_copy_argv(argv, verb_argi, argc);
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
@@ -88,6 +105,7 @@ static mapper_t* mapper_top_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_false_flag(pstate,       "--min", &do_max);
 	ap_define_false_flag(pstate,       "-F",    &allow_int_float);
 	ap_define_string_flag(pstate,      "-o",    &output_field_name);
+	ap_define_string_flag(pstate,      MLR_STATE_FLAG, &state_filename);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_top_usage(stderr, argv[0], verb);
@@ -102,13 +120,17 @@ static mapper_t* mapper_top_parse_cli(int* pargi, int argc, char** argv,
 		return NULL;
 	}
 
+	aggregate_state_spec_t* pstate_spec = aggregate_state_spec_alloc(state_filename, pverb_argv,
+		*pargi - verb_argi);
+
 	return mapper_top_alloc(pstate, pvalue_field_names, pgroup_by_field_names,
-		top_count, do_max, show_full_records, allow_int_float, output_field_name);
+		top_count, do_max, show_full_records, allow_int_float, output_field_name, pstate_spec);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names, slls_t* pgroup_by_field_names,
-	int top_count, int do_max, int show_full_records, int allow_int_float, char* output_field_name)
+	int top_count, int do_max, int show_full_records, int allow_int_float, char* output_field_name,
+	aggregate_state_spec_t* pstate_spec)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -121,8 +143,10 @@ static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names,
 	pstate->allow_int_float       = allow_int_float;
 	pstate->top_count             = top_count;
 	pstate->pmaybe_sign_flipper   = do_max ? x_x_upos_func : x_x_uneg_func;
-	pstate->groups                = lhmslv_alloc();
+	pstate->pgroup_by_key         = packed_key_alloc();
+	pstate->groups                = lhmpkv_alloc();
 	pstate->output_field_name     = output_field_name;
+	pstate->pstate_spec           = pstate_spec;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_top_process;
@@ -137,7 +161,7 @@ static void mapper_top_free(mapper_t* pmapper, context_t* _) {
 	slls_free(pstate->pgroup_by_field_names);
 
 	// Free the hashmap pvvalues; the lhm free methods will free the hashmap keys.
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+	for (lhmpkve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
 		lhmsv_t* pgroup = pa->pvvalue;
 		for (lhmsve_t* pb = pgroup->phead; pb != NULL; pb = pb->pnext) {
 			top_keeper_t* ptop_keeper_for_group = pb->pvvalue;
@@ -146,7 +170,9 @@ static void mapper_top_free(mapper_t* pmapper, context_t* _) {
 		lhmsv_free(pgroup);
 	}
 
-	lhmslv_free(pstate->groups);
+	lhmpkv_free(pstate->groups);
+	packed_key_free(pstate->pgroup_by_key);
+	aggregate_state_spec_free(pstate->pstate_spec);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -168,28 +194,19 @@ static sllv_t* mapper_top_process(lrec_t* pinrec, context_t* pctx, void* pvstate
 static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
 	// ["s", "t"]
 	slls_t* pvalue_field_values    = mlr_reference_selected_values_from_record(pinrec, pstate->pvalue_field_names);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
 
 	// Heterogeneous-data case -- not all sought fields were present in record
-	if (pvalue_field_values == NULL || pgroup_by_field_values == NULL) {
-		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
+	if (pvalue_field_values == NULL) {
 		lrec_free(pinrec);
 		return;
 	}
-	if (pgroup_by_field_values->length != pstate->pgroup_by_field_names->length) {
+	if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
 		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
 		lrec_free(pinrec);
 		return;
 	}
 
-	lhmsv_t* group_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
-	if (group_to_acc_field == NULL) {
-		group_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), group_to_acc_field, FREE_ENTRY_KEY);
-	}
-	slls_free(pgroup_by_field_values);
+	lhmsv_t* group_to_acc_field = mapper_top_get_group(pstate, pstate->pgroup_by_key);
 
 	sllse_t* pa = pstate->pvalue_field_names->phead;
 	sllse_t* pb =         pvalue_field_values->phead;
@@ -203,11 +220,7 @@ static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
 			continue;
 		}
 
-		top_keeper_t* ptop_keeper_for_group = lhmsv_get(group_to_acc_field, value_field_name);
-		if (ptop_keeper_for_group == NULL) {
-			ptop_keeper_for_group = top_keeper_alloc(pstate->top_count);
-			lhmsv_put(group_to_acc_field, value_field_name, ptop_keeper_for_group, NO_FREE);
-		}
+		top_keeper_t* ptop_keeper_for_group = mapper_top_get_keeper(pstate, group_to_acc_field, value_field_name);
 
 		if (*value_field_sval == 0) { // Key present with null value
 			if (pstate->show_full_records)
@@ -229,11 +242,40 @@ static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
 	slls_free(pvalue_field_values);
 }
 
+static lhmsv_t* mapper_top_get_group(mapper_top_state_t* pstate, packed_key_t* pgroup_by_key) {
+	lhmsv_t* group_to_acc_field = lhmpkv_get(pstate->groups, pgroup_by_key);
+	if (group_to_acc_field == NULL) {
+		group_to_acc_field = lhmsv_alloc();
+		lhmpkv_put(pstate->groups, pgroup_by_key, group_to_acc_field);
+	}
+	return group_to_acc_field;
+}
+
+// The name is one of the value-field names, which outlive the keepers.
+static top_keeper_t* mapper_top_get_keeper(mapper_top_state_t* pstate, lhmsv_t* group_to_acc_field,
+	char* value_field_name)
+{
+	top_keeper_t* ptop_keeper_for_group = lhmsv_get(group_to_acc_field, value_field_name);
+	if (ptop_keeper_for_group == NULL) {
+		ptop_keeper_for_group = top_keeper_alloc(pstate->top_count);
+		lhmsv_put(group_to_acc_field, value_field_name, ptop_keeper_for_group, NO_FREE);
+	}
+	return ptop_keeper_for_group;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 	sllv_t* poutrecs = sllv_alloc();
 
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+	for (lhmpkve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+		lhmsv_t* group_to_acc_field = pa->pvvalue;
+		for (lhmsve_t* pd = group_to_acc_field->phead; pd != NULL; pd = pd->pnext)
+			top_keeper_sort(pd->pvvalue);
+	}
+	if (pstate->pstate_spec != NULL)
+		mapper_top_write_state(pstate);
+
+	for (lhmpkve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
 
 		// Above we required that there was only one value field in the
 		// show-full-records case. That's for two reasons: (1) here, we print
@@ -252,15 +294,14 @@ static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 		}
 
 		else {
-			slls_t* pgroup_by_field_values = pa->key;
 			for (int i = 0; i < pstate->top_count; i++) {
 				lrec_t* poutrec = lrec_unbacked_alloc();
 
 				// Add in a=s,b=t fields:
 				sllse_t* pb = pstate->pgroup_by_field_names->phead;
-				sllse_t* pc =         pgroup_by_field_values->phead;
-				for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-					lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+				char* value = packed_key_first(pa->key);
+				for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pa->key, value)) {
+					lrec_put(poutrec, pb->value, value, NO_FREE);
 				}
 
 				// Add in fields such as x_top_1=#
@@ -289,3 +330,83 @@ static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 	sllv_append(poutrecs, NULL);
 	return poutrecs;
 }
+
+// ----------------------------------------------------------------
+// State-file layout (see aggregate_state.h): the number of groups, then per group its field values and the
+// number of value fields seen, then per value field its name and top values. Those are the number kept, then
+// for each its place in the order of input, its value (sign-flipped for --min), and with -a its record as the
+// number of fields then their names and values.
+static void mapper_top_write_state(mapper_top_state_t* pstate) {
+	FILE* output_stream = aggregate_state_open(pstate->pstate_spec);
+	aggregate_state_put_varint(output_stream, pstate->groups->num_occupied);
+	for (lhmpkve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+		lhmsv_t* group_to_acc_field = pa->pvvalue;
+		aggregate_state_put_packed_key(output_stream, pa->key);
+		aggregate_state_put_varint(output_stream, group_to_acc_field->num_occupied);
+		for (lhmsve_t* pd = group_to_acc_field->phead; pd != NULL; pd = pd->pnext) {
+			top_keeper_t* ptop_keeper_for_group = pd->pvvalue;
+			aggregate_state_put_string(output_stream, pd->key);
+			aggregate_state_put_varint(output_stream, ptop_keeper_for_group->size);
+			for (int i = 0; i < ptop_keeper_for_group->size; i++) {
+				aggregate_state_put_varint(output_stream, ptop_keeper_for_group->top_seqs[i]);
+				aggregate_state_put_mv(output_stream, &ptop_keeper_for_group->top_values[i]);
+				if (pstate->show_full_records) {
+					lrec_t* prec = ptop_keeper_for_group->top_precords[i];
+					aggregate_state_put_varint(output_stream, prec->field_count);
+					for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+						aggregate_state_put_string(output_stream, pe->key);
+						aggregate_state_put_string(output_stream, pe->value);
+					}
+				}
+			}
+		}
+	}
+	aggregate_state_close(output_stream, pstate->pstate_spec);
+}
+
+// Each file's top values are read into keepers of their own, which are merged into the running ones as if
+// their input had come after all that before.
+static void mapper_top_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader) {
+	mapper_top_state_t* pstate = pmapper->pvstate;
+	unsigned long long num_groups = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_groups; i++) {
+		aggregate_state_get_packed_key(preader, pstate->pgroup_by_key);
+		lhmsv_t* group_to_acc_field = mapper_top_get_group(pstate, pstate->pgroup_by_key);
+
+		unsigned long long num_fields = aggregate_state_get_varint(preader);
+		for (unsigned long long j = 0; j < num_fields; j++) {
+			char* name = aggregate_state_get_string(preader);
+			char* value_field_name = NULL;
+			for (sllse_t* pe = pstate->pvalue_field_names->phead; pe != NULL; pe = pe->pnext)
+				if (streq(pe->value, name))
+					value_field_name = pe->value;
+			if (value_field_name == NULL)
+				aggregate_state_corrupt(preader);
+
+			unsigned long long num_values = aggregate_state_get_varint(preader);
+			if (num_values > (unsigned long long)pstate->top_count)
+				aggregate_state_corrupt(preader);
+			top_keeper_t* pfile_keeper = top_keeper_alloc(pstate->top_count);
+			for (unsigned long long k = 0; k < num_values; k++) {
+				unsigned long long seq = aggregate_state_get_varint(preader);
+				mv_t value = aggregate_state_get_mv(preader);
+				if (value.type != MT_INT && value.type != MT_FLOAT)
+					aggregate_state_corrupt(preader);
+				lrec_t* prec = NULL;
+				if (pstate->show_full_records) {
+					prec = lrec_unbacked_alloc();
+					unsigned long long field_count = aggregate_state_get_varint(preader);
+					for (unsigned long long f = 0; f < field_count; f++) {
+						char* key = aggregate_state_get_string(preader);
+						char* fvalue = aggregate_state_get_string(preader);
+						lrec_put(prec, mlr_strdup_or_die(key), mlr_strdup_or_die(fvalue),
+							FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
+					}
+				}
+				top_keeper_add_with_seq(pfile_keeper, value, prec, seq);
+			}
+			top_keeper_merge(mapper_top_get_keeper(pstate, group_to_acc_field, value_field_name), pfile_keeper);
+			top_keeper_free(pfile_keeper);
+		}
+	}
+}
@@ -4,10 +4,11 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
+#include "containers/lhmpkv.h"
 #include "containers/lhmsv.h"
 #include "containers/lhmsll.h"
 #include "containers/mixutil.h"
+#include "containers/hll_sketch.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
@@ -18,9 +19,17 @@ typedef struct _mapper_uniq_state_t {
 	slls_t* pgroup_by_field_names;
 	int show_counts;
 	int show_num_distinct_only;
-	lhmslv_t* pcounts_by_group;
+	packed_key_t* pgroup_by_key; // scratch, refilled per record
+	lhmpkv_t* pcounts_by_group;
 	lhmsv_t* pcounts_unlashed; // string field name -> string field value -> long long count
 	char* output_field_name;
+	aggregate_state_spec_t* pstate_spec; // for count-distinct --write-state, else NULL
+
+	// For count-distinct --approx
+	int do_lashed;
+	int approx_precision;
+	slls_t* papprox_group_by_field_names;
+	lhmpkv_t* psketches_by_group; // group-by field values -> array of HLL sketches, one per -u field name
 } mapper_uniq_state_t;
 
 static void      mapper_uniq_usage(FILE* o, char* argv0, char* verb);
@@ -30,13 +39,18 @@ static void      mapper_count_distinct_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_count_distinct_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_uniq_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, int do_lashed,
-	int show_counts, int show_num_distinct_only, char* output_field_name);
+	int show_counts, int show_num_distinct_only, char* output_field_name, aggregate_state_spec_t* pstate_spec,
+	int do_approx, int approx_precision, slls_t* papprox_group_by_field_names);
 static void      mapper_uniq_free(mapper_t* pmapper, context_t* _);
+static mapper_input_fields_t mapper_uniq_input_fields(mapper_t* pmapper, hss_t* pfield_names);
+static void      mapper_uniq_write_state(mapper_uniq_state_t* pstate);
+static void      mapper_count_distinct_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader);
 
 static sllv_t* mapper_uniq_process_unlashed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t* mapper_uniq_process_num_distinct_only(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t* mapper_uniq_process_with_counts(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t* mapper_uniq_process_no_counts(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t* mapper_count_distinct_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_count_distinct_setup = {
@@ -44,6 +58,8 @@ mapper_setup_t mapper_count_distinct_setup = {
 	.pusage_func = mapper_count_distinct_usage,
 	.pparse_func = mapper_count_distinct_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_uniq_input_fields,
+	.pmerge_state_func = mapper_count_distinct_merge_state,
 };
 
 mapper_setup_t mapper_uniq_setup = {
@@ -51,6 +67,7 @@ mapper_setup_t mapper_uniq_setup = {
 	.pusage_func = mapper_uniq_usage,
 	.pparse_func = mapper_uniq_parse_cli,
 	.ignores_input = FALSE,
+	.pinput_fields_func = mapper_uniq_input_fields,
 };
 
 // ----------------------------------------------------------------
@@ -65,6 +82,17 @@ static void mapper_count_distinct_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "              and b field values. With -f a,b and with -u, computes counts\n");
 	fprintf(o, "              for distinct a field values and counts for distinct b field\n");
 	fprintf(o, "              values separately.\n");
+	fprintf(o, "--approx      Estimate the number of distinct values, as with -n, using a\n");
+	fprintf(o, "              HyperLogLog sketch of bounded size rather than keeping every\n");
+	fprintf(o, "              distinct value. With -u, estimates each field's separately.\n");
+	fprintf(o, "-g {d,e,f}    With --approx: group-by field names, for an estimate per group.\n");
+	fprintf(o, "--precision {p} With --approx: sketches take 2^p bytes, and estimates are\n");
+	fprintf(o, "              within about 1.04/sqrt(2^p) of the count, e.g. 0.8%% for the\n");
+	fprintf(o, "              default %d. Counts up to 2^p/16 are exact. From %d to %d.\n",
+		HLL_SKETCH_DEFAULT_PRECISION, HLL_SKETCH_MIN_PRECISION, HLL_SKETCH_MAX_PRECISION);
+	fprintf(o, "--write-state {filename}\n");
+	fprintf(o, "              At end of stream, also write the counts to this file, for\n");
+	fprintf(o, "              %s merge-state to combine with others.\n", argv0);
 	fprintf(o, "Prints number of records having distinct values for specified field names.\n");
 	fprintf(o, "Same as uniq -c.\n");
 }
@@ -77,7 +105,13 @@ static mapper_t* mapper_count_distinct_parse_cli(int* pargi, int argc, char** ar
 	int     show_num_distinct_only = FALSE;
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
 	int     do_lashed = TRUE;
+	char*   state_filename = NULL;
+	int     do_approx = FALSE;
+	int     approx_precision = HLL_SKETCH_DEFAULT_PRECISION;
+	slls_t* papprox_group_by_field_names = NULL;
 
+	int verb_argi = *pargi;
+	slls_t* pverb_argv = aggregate_state_copy_argv(argv, verb_argi, argc);
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
@@ -85,6 +119,10 @@ static mapper_t* mapper_count_distinct_parse_cli(int* pargi, int argc, char** ar
 	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
 	ap_define_false_flag(pstate,       "-u", &do_lashed);
+	ap_define_true_flag(pstate,        "--approx", &do_approx);
+	ap_define_string_list_flag(pstate, "-g", &papprox_group_by_field_names);
+	ap_define_int_flag(pstate,         "--precision", &approx_precision);
+	ap_define_string_flag(pstate,      MLR_STATE_FLAG, &state_filename);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_count_distinct_usage(stderr, argv[0], verb);
@@ -99,9 +137,20 @@ static mapper_t* mapper_count_distinct_parse_cli(int* pargi, int argc, char** ar
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if ((papprox_group_by_field_names != NULL && !do_approx)
+		|| approx_precision < HLL_SKETCH_MIN_PRECISION || approx_precision > HLL_SKETCH_MAX_PRECISION)
+	{
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (papprox_group_by_field_names == NULL)
+		papprox_group_by_field_names = slls_alloc();
+
+	aggregate_state_spec_t* pstate_spec = aggregate_state_spec_alloc(state_filename, pverb_argv,
+		*pargi - verb_argi);
 
 	return mapper_uniq_alloc(pstate, pfield_names, do_lashed, TRUE, show_num_distinct_only,
-		output_field_name);
+		output_field_name, pstate_spec, do_approx, approx_precision, papprox_group_by_field_names);
 }
 
 // ----------------------------------------------------------------
@@ -144,12 +193,13 @@ static mapper_t* mapper_uniq_parse_cli(int* pargi, int argc, char** argv,
 	}
 
 	return mapper_uniq_alloc(pstate, pgroup_by_field_names, do_lashed, show_counts, show_num_distinct_only,
-		output_field_name);
+		output_field_name, NULL, FALSE, HLL_SKETCH_DEFAULT_PRECISION, NULL);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_uniq_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, int do_lashed,
-	int show_counts, int show_num_distinct_only, char* output_field_name)
+	int show_counts, int show_num_distinct_only, char* output_field_name, aggregate_state_spec_t* pstate_spec,
+	int do_approx, int approx_precision, slls_t* papprox_group_by_field_names)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -159,12 +209,20 @@ static mapper_t* mapper_uniq_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
 	pstate->show_counts            = show_counts;
 	pstate->show_num_distinct_only = show_num_distinct_only;
-	pstate->pcounts_by_group       = lhmslv_alloc();
+	pstate->pgroup_by_key          = packed_key_alloc();
+	pstate->pcounts_by_group       = lhmpkv_alloc();
 	pstate->pcounts_unlashed       = lhmsv_alloc();
 	pstate->output_field_name      = output_field_name;
+	pstate->pstate_spec            = pstate_spec;
+	pstate->do_lashed              = do_lashed;
+	pstate->approx_precision       = approx_precision;
+	pstate->papprox_group_by_field_names = papprox_group_by_field_names;
+	pstate->psketches_by_group     = do_approx ? lhmpkv_alloc() : NULL;
 
 	pmapper->pvstate = pstate;
-	if (!do_lashed)
+	if (do_approx)
+		pmapper->pprocess_func = mapper_count_distinct_process_approx;
+	else if (!do_lashed)
 		pmapper->pprocess_func = mapper_uniq_process_unlashed;
 	else if (show_num_distinct_only)
 		pmapper->pprocess_func = mapper_uniq_process_num_distinct_only;
@@ -179,26 +237,50 @@ static mapper_t* mapper_uniq_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 
 static void mapper_uniq_free(mapper_t* pmapper, context_t* _) {
 	mapper_uniq_state_t* pstate = pmapper->pvstate;
+	if (pstate->psketches_by_group != NULL) {
+		int num_sketches = pstate->do_lashed ? 1 : pstate->pgroup_by_field_names->length;
+		for (lhmpkve_t* pc = pstate->psketches_by_group->phead; pc != NULL; pc = pc->pnext) {
+			hll_sketch_t** psketches = pc->pvvalue;
+			for (int i = 0; i < num_sketches; i++)
+				hll_sketch_free(psketches[i]);
+			free(psketches);
+		}
+		lhmpkv_free(pstate->psketches_by_group);
+	}
 	slls_free(pstate->pgroup_by_field_names);
-	// lhmslv_free will free the keys: we only need to free the void-star values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+	// lhmpkv_free will free the keys: we only need to free the void-star values.
+	for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 		unsigned long long* pcount = pa->pvvalue;
 		free(pcount);
 	}
-	lhmslv_free(pstate->pcounts_by_group);
+	lhmpkv_free(pstate->pcounts_by_group);
+	packed_key_free(pstate->pgroup_by_key);
 	for (lhmsve_t* pb = pstate->pcounts_unlashed->phead; pb != NULL; pb = pb->pnext) {
 		lhmsll_t* pmap = pb->pvvalue;
 		lhmsll_free(pmap);
 	}
 	lhmsv_free(pstate->pcounts_unlashed);
+	slls_free(pstate->papprox_group_by_field_names);
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 	pstate->pcounts_unlashed = NULL;
+	aggregate_state_spec_free(pstate->pstate_spec);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+static mapper_input_fields_t mapper_uniq_input_fields(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_uniq_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	if (pstate->papprox_group_by_field_names != NULL)
+		for (sllse_t* pe = pstate->papprox_group_by_field_names->phead; pe != NULL; pe = pe->pnext)
+			hss_add(pfield_names, pe->value);
+	return MAPPER_USES_ONLY_THESE_FIELDS;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_uniq_process_unlashed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_uniq_state_t* pstate = pvstate;
@@ -221,6 +303,8 @@ static sllv_t* mapper_uniq_process_unlashed(lrec_t* pinrec, context_t* pctx, voi
 		return NULL;
 	}
 	else {
+		if (pstate->pstate_spec != NULL)
+			mapper_uniq_write_state(pstate);
 		sllv_t* poutrecs = sllv_alloc();
 		for (lhmsve_t* pe = pstate->pcounts_unlashed->phead; pe != NULL; pe = pe->pnext) {
 			char* field_name= pe->key;
@@ -242,23 +326,22 @@ static sllv_t* mapper_uniq_process_unlashed(lrec_t* pinrec, context_t* pctx, voi
 static sllv_t* mapper_uniq_process_num_distinct_only(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+		if (packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
 			if (pcount == NULL) {
 				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+				lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount);
 			} else {
 				(*pcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
 	}
 	else {
+		if (pstate->pstate_spec != NULL)
+			mapper_uniq_write_state(pstate);
 		sllv_t* poutrecs = sllv_alloc();
 
 		lrec_t* poutrec = lrec_unbacked_alloc();
@@ -274,33 +357,30 @@ static sllv_t* mapper_uniq_process_num_distinct_only(lrec_t* pinrec, context_t*
 static sllv_t* mapper_uniq_process_with_counts(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+		if (packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
 			if (pcount == NULL) {
 				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+				lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount);
 			} else {
 				(*pcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
 	} else {
+		if (pstate->pstate_spec != NULL)
+			mapper_uniq_write_state(pstate);
 		sllv_t* poutrecs = sllv_alloc();
 
-		for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+		for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 			lrec_t* poutrec = lrec_unbacked_alloc();
 
-			slls_t* pgroup_by_field_values = pa->key;
-
 			sllse_t* pb = pstate->pgroup_by_field_names->phead;
-			sllse_t* pc =         pgroup_by_field_values->phead;
-			for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-				lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+			char* value = packed_key_first(pa->key);
+			for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pa->key, value)) {
+				lrec_put(poutrec, pb->value, value, NO_FREE);
 			}
 
 			if (pstate->show_counts) {
@@ -321,35 +401,256 @@ static sllv_t* mapper_uniq_process_no_counts(lrec_t* pinrec, context_t* pctx, vo
 		return sllv_single(NULL);
 	}
 
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-		pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
+	if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->pgroup_by_field_names)) {
 		lrec_free(pinrec);
 		return NULL;
 	}
 
-	unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+	unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
 	if (pcount == NULL) {
 		pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 		*pcount = 1LL;
-		slls_t* pcopy = slls_copy(pgroup_by_field_values);
-		lhmslv_put(pstate->pcounts_by_group, pcopy, pcount, FREE_ENTRY_KEY);
+		packed_key_t* pcopy = lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount)->key;
 
 		lrec_t* poutrec = lrec_unbacked_alloc();
 
 		sllse_t* pb = pstate->pgroup_by_field_names->phead;
-		sllse_t* pc = pcopy->phead;
-		for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-			lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+		char* value = packed_key_first(pcopy);
+		for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pcopy, value)) {
+			lrec_put(poutrec, pb->value, value, NO_FREE);
 		}
 
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return sllv_single(poutrec);
 	} else {
 		(*pcount)++;
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return NULL;
 	}
 }
+
+// ----------------------------------------------------------------
+// The group's sketches, made as needed.
+static hll_sketch_t** mapper_count_distinct_get_sketches(mapper_uniq_state_t* pstate,
+	packed_key_t* pgroup_by_key)
+{
+	hll_sketch_t** psketches = lhmpkv_get(pstate->psketches_by_group, pgroup_by_key);
+	if (psketches == NULL) {
+		int num_sketches = pstate->do_lashed ? 1 : pstate->pgroup_by_field_names->length;
+		psketches = mlr_malloc_or_die(num_sketches * sizeof(hll_sketch_t*));
+		for (int i = 0; i < num_sketches; i++)
+			psketches[i] = hll_sketch_alloc(pstate->approx_precision);
+		lhmpkv_put(pstate->psketches_by_group, pgroup_by_key, psketches);
+	}
+	return psketches;
+}
+
+static void mapper_count_distinct_put_group_by(mapper_uniq_state_t* pstate, lrec_t* poutrec,
+	packed_key_t* pgroup_by_key)
+{
+	sllse_t* pb = pstate->papprox_group_by_field_names->phead;
+	char* value = packed_key_first(pgroup_by_key);
+	for ( ; pb != NULL && value != NULL; pb = pb->pnext, value = packed_key_next(pgroup_by_key, value))
+		lrec_put(poutrec, pb->value, value, NO_FREE);
+}
+
+static void mapper_count_distinct_emit_approx(mapper_uniq_state_t* pstate, sllv_t* poutrecs,
+	packed_key_t* pgroup_by_key, hll_sketch_t** psketches)
+{
+	if (pstate->do_lashed) {
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		mapper_count_distinct_put_group_by(pstate, poutrec, pgroup_by_key);
+		lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ull(hll_sketch_estimate(psketches[0])),
+			FREE_ENTRY_VALUE);
+		sllv_append(poutrecs, poutrec);
+	} else {
+		int i = 0;
+		for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext, i++) {
+			lrec_t* poutrec = lrec_unbacked_alloc();
+			mapper_count_distinct_put_group_by(pstate, poutrec, pgroup_by_key);
+			lrec_put(poutrec, "field", pe->value, NO_FREE);
+			lrec_put(poutrec, "count", mlr_alloc_string_from_ull(hll_sketch_estimate(psketches[i])),
+				FREE_ENTRY_VALUE);
+			sllv_append(poutrecs, poutrec);
+		}
+	}
+}
+
+// Lashed, a record counts only if it has all the -f fields, whose values are hashed together; unlashed,
+// each one it has is counted separately.
+static sllv_t* mapper_count_distinct_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		if (!packed_key_fill_from_record(pstate->pgroup_by_key, pinrec, pstate->papprox_group_by_field_names)) {
+			lrec_free(pinrec);
+			return NULL;
+		}
+		if (pstate->do_lashed) {
+			unsigned long long hash = HLL_HASH_INIT;
+			sllse_t* pe = pstate->pgroup_by_field_names->phead;
+			for ( ; pe != NULL; pe = pe->pnext) {
+				char* value = lrec_get(pinrec, pe->value);
+				if (value == NULL)
+					break;
+				hash = hll_hash_string(hash, value);
+			}
+			if (pe == NULL)
+				hll_sketch_ingest(mapper_count_distinct_get_sketches(pstate, pstate->pgroup_by_key)[0], hash);
+		} else {
+			hll_sketch_t** psketches = NULL;
+			int i = 0;
+			for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext, i++) {
+				char* value = lrec_get(pinrec, pe->value);
+				if (value == NULL)
+					continue;
+				if (psketches == NULL)
+					psketches = mapper_count_distinct_get_sketches(pstate, pstate->pgroup_by_key);
+				hll_sketch_ingest(psketches[i], hll_hash_string(HLL_HASH_INIT, value));
+			}
+		}
+		lrec_free(pinrec);
+		return NULL;
+	} else {
+		if (pstate->pstate_spec != NULL)
+			mapper_uniq_write_state(pstate);
+		sllv_t* poutrecs = sllv_alloc();
+		// Without -g there's one group, for which zero is the answer even if nothing was counted.
+		if (pstate->papprox_group_by_field_names->length == 0 && pstate->psketches_by_group->num_occupied == 0) {
+			packed_key_clear(pstate->pgroup_by_key);
+			packed_key_finish(pstate->pgroup_by_key);
+			mapper_count_distinct_get_sketches(pstate, pstate->pgroup_by_key);
+		}
+		for (lhmpkve_t* pa = pstate->psketches_by_group->phead; pa != NULL; pa = pa->pnext)
+			mapper_count_distinct_emit_approx(pstate, poutrecs, pa->key, pa->pvvalue);
+		sllv_append(poutrecs, NULL);
+		return poutrecs;
+	}
+}
+
+// ----------------------------------------------------------------
+// Sketch layout in state files: 0 then the number of hashes and the hashes, or 1 then all the registers.
+static void mapper_count_distinct_write_sketch(FILE* output_stream, hll_sketch_t* psketch) {
+	if (psketch->registers == NULL) {
+		aggregate_state_put_varint(output_stream, 0);
+		aggregate_state_put_varint(output_stream, psketch->num_hashes);
+		for (int i = 0; i < psketch->hashes_alloc_size; i++)
+			if (psketch->hashes[i] != 0LL)
+				aggregate_state_put_varint(output_stream, psketch->hashes[i]);
+	} else {
+		aggregate_state_put_varint(output_stream, 1);
+		for (int i = 0; i < psketch->num_registers; i++)
+			aggregate_state_put_varint(output_stream, psketch->registers[i]);
+	}
+}
+
+static void mapper_count_distinct_merge_sketch(aggregate_state_reader_t* preader, hll_sketch_t* psketch) {
+	unsigned long long is_dense = aggregate_state_get_varint(preader);
+	if (is_dense == 0) {
+		unsigned long long num_hashes = aggregate_state_get_varint(preader);
+		for (unsigned long long i = 0; i < num_hashes; i++) {
+			unsigned long long hash = aggregate_state_get_varint(preader);
+			if (hash == 0LL)
+				aggregate_state_corrupt(preader);
+			hll_sketch_put_hash(psketch, hash);
+		}
+	} else if (is_dense == 1) {
+		for (int i = 0; i < psketch->num_registers; i++) {
+			unsigned long long value = aggregate_state_get_varint(preader);
+			if (value > 64 - psketch->precision + 1)
+				aggregate_state_corrupt(preader);
+			hll_sketch_put_register(psketch, i, value);
+		}
+	} else {
+		aggregate_state_corrupt(preader);
+	}
+}
+
+// ----------------------------------------------------------------
+// State-file layout (see aggregate_state.h): the number of distinct value combinations, then per
+// combination the values and count; then for -u the number of field names, then per field name the name,
+// the number of distinct values, and per value the value and count.
+//
+// With --approx, it's the number of groups, then per group the group-by field values and the sketches.
+static void mapper_uniq_write_state(mapper_uniq_state_t* pstate) {
+	FILE* output_stream = aggregate_state_open(pstate->pstate_spec);
+	if (pstate->psketches_by_group != NULL) {
+		int num_sketches = pstate->do_lashed ? 1 : pstate->pgroup_by_field_names->length;
+		aggregate_state_put_varint(output_stream, pstate->psketches_by_group->num_occupied);
+		for (lhmpkve_t* pa = pstate->psketches_by_group->phead; pa != NULL; pa = pa->pnext) {
+			hll_sketch_t** psketches = pa->pvvalue;
+			aggregate_state_put_packed_key(output_stream, pa->key);
+			for (int i = 0; i < num_sketches; i++)
+				mapper_count_distinct_write_sketch(output_stream, psketches[i]);
+		}
+		aggregate_state_close(output_stream, pstate->pstate_spec);
+		return;
+	}
+	aggregate_state_put_varint(output_stream, pstate->pcounts_by_group->num_occupied);
+	for (lhmpkve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+		unsigned long long* pcount = pa->pvvalue;
+		aggregate_state_put_packed_key(output_stream, pa->key);
+		aggregate_state_put_varint(output_stream, *pcount);
+	}
+	aggregate_state_put_varint(output_stream, pstate->pcounts_unlashed->num_occupied);
+	for (lhmsve_t* pb = pstate->pcounts_unlashed->phead; pb != NULL; pb = pb->pnext) {
+		lhmsll_t* pcounts_for_field_name = pb->pvvalue;
+		aggregate_state_put_string(output_stream, pb->key);
+		aggregate_state_put_varint(output_stream, pcounts_for_field_name->num_occupied);
+		for (lhmslle_t* pc = pcounts_for_field_name->phead; pc != NULL; pc = pc->pnext) {
+			aggregate_state_put_string(output_stream, pc->key);
+			aggregate_state_put_ll(output_stream, pc->value);
+		}
+	}
+	aggregate_state_close(output_stream, pstate->pstate_spec);
+}
+
+// Field names point into the reader's contents, which outlive this mapper.
+static void mapper_count_distinct_merge_state(mapper_t* pmapper, aggregate_state_reader_t* preader) {
+	mapper_uniq_state_t* pstate = pmapper->pvstate;
+	if (pstate->psketches_by_group != NULL) {
+		int num_sketches = pstate->do_lashed ? 1 : pstate->pgroup_by_field_names->length;
+		unsigned long long num_groups = aggregate_state_get_varint(preader);
+		for (unsigned long long i = 0; i < num_groups; i++) {
+			aggregate_state_get_packed_key(preader, pstate->pgroup_by_key);
+			if (pstate->pgroup_by_key->num_values != pstate->papprox_group_by_field_names->length)
+				aggregate_state_corrupt(preader);
+			hll_sketch_t** psketches = mapper_count_distinct_get_sketches(pstate, pstate->pgroup_by_key);
+			for (int j = 0; j < num_sketches; j++)
+				mapper_count_distinct_merge_sketch(preader, psketches[j]);
+		}
+		return;
+	}
+	unsigned long long num_groups = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_groups; i++) {
+		aggregate_state_get_packed_key(preader, pstate->pgroup_by_key);
+		unsigned long long count = aggregate_state_get_varint(preader);
+		unsigned long long* pcount = lhmpkv_get(pstate->pcounts_by_group, pstate->pgroup_by_key);
+		if (pcount == NULL) {
+			pcount = mlr_malloc_or_die(sizeof(unsigned long long));
+			*pcount = count;
+			lhmpkv_put(pstate->pcounts_by_group, pstate->pgroup_by_key, pcount);
+		} else {
+			*pcount += count;
+		}
+	}
+
+	unsigned long long num_field_names = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_field_names; i++) {
+		char* field_name = aggregate_state_get_string(preader);
+		lhmsll_t* pcounts_for_field_name = lhmsv_get(pstate->pcounts_unlashed, field_name);
+		if (pcounts_for_field_name == NULL) {
+			pcounts_for_field_name = lhmsll_alloc();
+			lhmsv_put(pstate->pcounts_unlashed, field_name, pcounts_for_field_name, NO_FREE);
+		}
+		unsigned long long num_values = aggregate_state_get_varint(preader);
+		for (unsigned long long j = 0; j < num_values; j++) {
+			char* field_value = aggregate_state_get_string(preader);
+			long long count = aggregate_state_get_ll(preader);
+			lhmslle_t* pe = lhmsll_get_entry(pcounts_for_field_name, field_value);
+			if (pe == NULL)
+				lhmsll_put(pcounts_for_field_name, mlr_strdup_or_die(field_value), count, FREE_ENTRY_KEY);
+			else
+				pe->value += count;
+		}
+	}
+}
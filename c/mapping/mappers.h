@@ -8,6 +8,7 @@ extern mapper_setup_t mapper_bar_setup;
 extern mapper_setup_t mapper_bootstrap_setup;
 extern mapper_setup_t mapper_cat_setup;
 extern mapper_setup_t mapper_check_setup;
+extern mapper_setup_t mapper_count_setup;
 extern mapper_setup_t mapper_count_distinct_setup;
 extern mapper_setup_t mapper_count_similar_setup;
 extern mapper_setup_t mapper_cut_setup;
@@ -24,6 +25,7 @@ extern mapper_setup_t mapper_join_setup;
 extern mapper_setup_t mapper_label_setup;
 extern mapper_setup_t mapper_least_frequent_setup;
 extern mapper_setup_t mapper_merge_fields_setup;
+extern mapper_setup_t mapper_merge_state_setup;
 extern mapper_setup_t mapper_most_frequent_setup;
 extern mapper_setup_t mapper_nest_setup;
 extern mapper_setup_t mapper_nothing_setup;
@@ -49,6 +51,9 @@ extern mapper_setup_t mapper_top_setup;
 extern mapper_setup_t mapper_uniq_setup;
 extern mapper_setup_t mapper_unsparsify_setup;
 
+// For sort to fuse with a following head. The names are owned by the head mapper.
+void mapper_head_get_params(mapper_t* pmapper, unsigned long long* phead_count, slls_t** ppgroup_by_field_names);
+
 // Construction is in mlrcli.c.
 void mapper_chain_free(sllv_t* pmapper_chain, context_t* pctx);
 
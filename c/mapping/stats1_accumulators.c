@@ -10,52 +10,70 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "containers/percentile_keeper.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mvfuncs.h"
 #include "mapping/stats1_accumulators.h"
 
 // ----------------------------------------------------------------
+static void make_stats1_accs_for_name(char* value_field_name, char* stats1_acc_name, int allow_int_float,
+	int do_interpolated_percentiles, int do_approx_percentiles, int approx_percentile_k,
+	stats1_acc_t** pppercentile_acc, stats1_acc_t** ppapprox_percentile_acc,
+	lhmsv_t* acc_field_to_acc_state_in, lhmsv_t* acc_field_to_acc_state_out);
+
 void make_stats1_accs(
 	char*    value_field_name,            // input
 	slls_t*  paccumulator_names,          // input
 	int      allow_int_float,             // input
 	int      do_interpolated_percentiles, // input
+	int      do_approx_percentiles,       // input
+	int      approx_percentile_k,         // input
 	lhmsv_t* acc_field_to_acc_state_in,   // output
 	lhmsv_t* acc_field_to_acc_state_out)  // output
 {
 	stats1_acc_t* ppercentile_acc = NULL;
+	stats1_acc_t* papprox_percentile_acc = NULL;
 	for (sllse_t* pc = paccumulator_names->phead; pc != NULL; pc = pc->pnext) {
 		// for "sum", "count"
-		char* stats1_acc_name = pc->value;
+		make_stats1_accs_for_name(value_field_name, pc->value, allow_int_float, do_interpolated_percentiles,
+			do_approx_percentiles, approx_percentile_k, &ppercentile_acc, &papprox_percentile_acc,
+			acc_field_to_acc_state_in, acc_field_to_acc_state_out);
+	}
+}
 
-		// For percentiles there is one unique accumulator given (for example) five distinct
-		// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
-		// percentile-keeper. There are multiple output accumulators: each references the same
-		// underlying percentile-keeper but with distinct parameters.  Hence the "_in" and "_out" maps.
-		if (is_percentile_acc_name(stats1_acc_name)) {
-			if (ppercentile_acc == NULL) {
-				ppercentile_acc = stats1_percentile_alloc(value_field_name, stats1_acc_name, allow_int_float,
+static void make_stats1_accs_for_name(char* value_field_name, char* stats1_acc_name, int allow_int_float,
+	int do_interpolated_percentiles, int do_approx_percentiles, int approx_percentile_k,
+	stats1_acc_t** pppercentile_acc, stats1_acc_t** ppapprox_percentile_acc,
+	lhmsv_t* acc_field_to_acc_state_in, lhmsv_t* acc_field_to_acc_state_out)
+{
+	// For percentiles there is one unique accumulator given (for example) five distinct
+	// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
+	// percentile-keeper. There are multiple output accumulators: each references the same
+	// underlying percentile-keeper but with distinct parameters.  Hence the "_in" and "_out" maps.
+	// Likewise for approximate percentiles, which share one sketch.
+	if (is_percentile_acc_name(stats1_acc_name)) {
+		int is_approx = do_approx_percentiles || is_approx_percentile_acc_name(stats1_acc_name);
+		stats1_acc_t** ppacc = is_approx ? ppapprox_percentile_acc : pppercentile_acc;
+		if (*ppacc == NULL) {
+			*ppacc = is_approx
+				? stats1_approx_percentile_alloc(value_field_name, stats1_acc_name, allow_int_float,
+					do_interpolated_percentiles, approx_percentile_k)
+				: stats1_percentile_alloc(value_field_name, stats1_acc_name, allow_int_float,
 					do_interpolated_percentiles);
-				if (ppercentile_acc == NULL) {
-					fprintf(stderr, "%s stats1: accumulator \"%s\" not found.\n",
-						MLR_GLOBALS.bargv0, stats1_acc_name);
-					exit(1);
-				}
-				lhmsv_put(acc_field_to_acc_state_in, stats1_acc_name, ppercentile_acc, NO_FREE);
-			} else {
-				stats1_percentile_reuse(ppercentile_acc);
-			}
-			lhmsv_put(acc_field_to_acc_state_out, stats1_acc_name, ppercentile_acc, NO_FREE);
+			lhmsv_put(acc_field_to_acc_state_in, stats1_acc_name, *ppacc, NO_FREE);
 		} else {
-			stats1_acc_t* pstats1_acc = make_stats1_acc(value_field_name, stats1_acc_name, allow_int_float,
-				do_interpolated_percentiles);
-			if (pstats1_acc == NULL) {
-				fprintf(stderr, "%s stats1: accumulator \"%s\" not found.\n",
-					MLR_GLOBALS.bargv0, stats1_acc_name);
-				exit(1);
-			}
-			lhmsv_put(acc_field_to_acc_state_in, stats1_acc_name, pstats1_acc, NO_FREE);
-			lhmsv_put(acc_field_to_acc_state_out, stats1_acc_name, pstats1_acc, NO_FREE);
+			stats1_percentile_reuse(*ppacc);
+		}
+		lhmsv_put(acc_field_to_acc_state_out, stats1_acc_name, *ppacc, NO_FREE);
+	} else {
+		stats1_acc_t* pstats1_acc = make_stats1_acc(value_field_name, stats1_acc_name, allow_int_float,
+			do_interpolated_percentiles);
+		if (pstats1_acc == NULL) {
+			fprintf(stderr, "%s stats1: accumulator \"%s\" not found.\n",
+				MLR_GLOBALS.bargv0, stats1_acc_name);
+			exit(1);
 		}
+		lhmsv_put(acc_field_to_acc_state_in, stats1_acc_name, pstats1_acc, NO_FREE);
+		lhmsv_put(acc_field_to_acc_state_out, stats1_acc_name, pstats1_acc, NO_FREE);
 	}
 }
 
@@ -69,14 +87,24 @@ stats1_acc_t* make_stats1_acc(char* value_field_name, char* stats1_acc_name, int
 	return NULL;
 }
 
+// Either median or p{number}, or either of those followed by ~ for approximate.
 int is_percentile_acc_name(char* stats1_acc_name) {
-	if (streq(stats1_acc_name, "median"))
+	if (streq(stats1_acc_name, "median") || streq(stats1_acc_name, "median~"))
 		return TRUE;
 	double percentile;
 	// sscanf(stats1_acc_name, "p%lf", &percentile) allows "p74x" et al. which isn't ok.
 	if (stats1_acc_name[0] != 'p')
 		return FALSE;
-	if (!mlr_try_float_from_string(&stats1_acc_name[1], &percentile))
+	int ok;
+	if (is_approx_percentile_acc_name(stats1_acc_name)) {
+		char* number = mlr_strdup_or_die(&stats1_acc_name[1]);
+		number[strlen(number) - 1] = 0;
+		ok = mlr_try_float_from_string(number, &percentile);
+		free(number);
+	} else {
+		ok = mlr_try_float_from_string(&stats1_acc_name[1], &percentile);
+	}
+	if (!ok)
 		return FALSE;
 	if (percentile < 0.0 || percentile > 100.0) {
 		fprintf(stderr, "%s stats1: percentile \"%s\" outside range [0,100].\n",
@@ -86,6 +114,11 @@ int is_percentile_acc_name(char* stats1_acc_name) {
 	return TRUE;
 }
 
+int is_approx_percentile_acc_name(char* stats1_acc_name) {
+	size_t len = strlen(stats1_acc_name);
+	return len > 0 && stats1_acc_name[len - 1] == '~';
+}
+
 // ----------------------------------------------------------------
 typedef struct _stats1_count_state_t {
 	mv_t counter;
@@ -98,6 +131,10 @@ static void stats1_count_singest(void* pvstate, char* val) {
 	pstate->counter = x_xx_plus_func(&pstate->counter, &pstate->one);
 
 }
+static void stats1_count_tingest(void* pvstate, mv_t* pval) {
+	stats1_count_state_t* pstate = pvstate;
+	pstate->counter = x_xx_plus_func(&pstate->counter, &pstate->one);
+}
 static void stats1_count_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
 	stats1_count_state_t* pstate = pvstate;
 	if (copy_data)
@@ -107,6 +144,15 @@ static void stats1_count_emit(void* pvstate, char* value_field_name, char* stats
 		lrec_put(poutrec, pstate->output_field_name, mv_alloc_format_val(&pstate->counter),
 			FREE_ENTRY_VALUE);
 }
+static void stats1_count_write_state(void* pvstate, FILE* output_stream) {
+	stats1_count_state_t* pstate = pvstate;
+	aggregate_state_put_mv(output_stream, &pstate->counter);
+}
+static void stats1_count_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_count_state_t* pstate = pvstate;
+	mv_t counter = aggregate_state_get_mv(preader);
+	pstate->counter = x_xx_plus_func(&pstate->counter, &counter);
+}
 static void stats1_count_free(stats1_acc_t* pstats1_acc) {
 	stats1_count_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -126,11 +172,36 @@ stats1_acc_t* stats1_count_alloc(char* value_field_name, char* stats1_acc_name,
 	pstats1_acc->pdingest_func   = NULL;
 	pstats1_acc->pningest_func   = NULL;
 	pstats1_acc->psingest_func   = stats1_count_singest;
+	pstats1_acc->ptingest_func   = stats1_count_tingest;
 	pstats1_acc->pemit_func      = stats1_count_emit;
+	pstats1_acc->pwrite_state_func = stats1_count_write_state;
+	pstats1_acc->pmerge_state_func = stats1_count_merge_state;
 	pstats1_acc->pfree_func      = stats1_count_free;
 	return pstats1_acc;
 }
 
+// For mode and antimode. Values are written in order first seen, so merged runs break ties as a single
+// run would.
+static void write_counts_for_value(lhmsll_t* pcounts_for_value, FILE* output_stream) {
+	aggregate_state_put_varint(output_stream, pcounts_for_value->num_occupied);
+	for (lhmslle_t* pe = pcounts_for_value->phead; pe != NULL; pe = pe->pnext) {
+		aggregate_state_put_string(output_stream, pe->key);
+		aggregate_state_put_ll(output_stream, pe->value);
+	}
+}
+static void merge_counts_for_value(lhmsll_t* pcounts_for_value, aggregate_state_reader_t* preader) {
+	unsigned long long num_values = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < num_values; i++) {
+		char* value = aggregate_state_get_string(preader);
+		long long count = aggregate_state_get_ll(preader);
+		lhmslle_t* pe = lhmsll_get_entry(pcounts_for_value, value);
+		if (pe == NULL)
+			lhmsll_put(pcounts_for_value, mlr_strdup_or_die(value), count, FREE_ENTRY_KEY);
+		else
+			pe->value += count;
+	}
+}
+
 // ----------------------------------------------------------------
 typedef struct _stats1_mode_state_t {
 	lhmsll_t* pcounts_for_value;
@@ -164,6 +235,14 @@ static void stats1_mode_emit(void* pvstate, char* value_field_name, char* stats1
 	else
 		lrec_put(poutrec, pstate->output_field_name, max_key, NO_FREE);
 }
+static void stats1_mode_write_state(void* pvstate, FILE* output_stream) {
+	stats1_mode_state_t* pstate = pvstate;
+	write_counts_for_value(pstate->pcounts_for_value, output_stream);
+}
+static void stats1_mode_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_mode_state_t* pstate = pvstate;
+	merge_counts_for_value(pstate->pcounts_for_value, preader);
+}
 static void stats1_mode_free(stats1_acc_t* pstats1_acc) {
 	stats1_mode_state_t* pstate = pstats1_acc->pvstate;
 	lhmsll_free(pstate->pcounts_for_value);
@@ -183,7 +262,10 @@ stats1_acc_t* stats1_mode_alloc(char* value_field_name, char* stats1_acc_name, i
 	pstats1_acc->pdingest_func  = NULL;
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_mode_singest;
+	pstats1_acc->ptingest_func  = NULL;
 	pstats1_acc->pemit_func     = stats1_mode_emit;
+	pstats1_acc->pwrite_state_func = stats1_mode_write_state;
+	pstats1_acc->pmerge_state_func = stats1_mode_merge_state;
 	pstats1_acc->pfree_func     = stats1_mode_free;
 	return pstats1_acc;
 }
@@ -223,6 +305,14 @@ static void stats1_antimode_emit(void* pvstate, char* value_field_name, char* st
 	else
 		lrec_put(poutrec, pstate->output_field_name, min_key, NO_FREE);
 }
+static void stats1_antimode_write_state(void* pvstate, FILE* output_stream) {
+	stats1_antimode_state_t* pstate = pvstate;
+	write_counts_for_value(pstate->pcounts_for_value, output_stream);
+}
+static void stats1_antimode_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_antimode_state_t* pstate = pvstate;
+	merge_counts_for_value(pstate->pcounts_for_value, preader);
+}
 static void stats1_antimode_free(stats1_acc_t* pstats1_acc) {
 	stats1_antimode_state_t* pstate = pstats1_acc->pvstate;
 	lhmsll_free(pstate->pcounts_for_value);
@@ -242,7 +332,10 @@ stats1_acc_t* stats1_antimode_alloc(char* value_field_name, char* stats1_acc_nam
 	pstats1_acc->pdingest_func  = NULL;
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_antimode_singest;
+	pstats1_acc->ptingest_func  = NULL;
 	pstats1_acc->pemit_func     = stats1_antimode_emit;
+	pstats1_acc->pwrite_state_func = stats1_antimode_write_state;
+	pstats1_acc->pmerge_state_func = stats1_antimode_merge_state;
 	pstats1_acc->pfree_func     = stats1_antimode_free;
 	return pstats1_acc;
 }
@@ -266,6 +359,15 @@ static void stats1_sum_emit(void* pvstate, char* value_field_name, char* stats1_
 		lrec_put(poutrec, pstate->output_field_name, mv_alloc_format_val(&pstate->sum),
 			FREE_ENTRY_VALUE);
 }
+static void stats1_sum_write_state(void* pvstate, FILE* output_stream) {
+	stats1_sum_state_t* pstate = pvstate;
+	aggregate_state_put_mv(output_stream, &pstate->sum);
+}
+static void stats1_sum_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_sum_state_t* pstate = pvstate;
+	mv_t sum = aggregate_state_get_mv(preader);
+	pstate->sum = x_xx_plus_func(&pstate->sum, &sum);
+}
 static void stats1_sum_free(stats1_acc_t* pstats1_acc) {
 	stats1_sum_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -285,7 +387,10 @@ stats1_acc_t* stats1_sum_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pdingest_func = NULL;
 	pstats1_acc->pningest_func = stats1_sum_ningest;
 	pstats1_acc->psingest_func = NULL;
+	pstats1_acc->ptingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_sum_emit;
+	pstats1_acc->pwrite_state_func = stats1_sum_write_state;
+	pstats1_acc->pmerge_state_func = stats1_sum_merge_state;
 	pstats1_acc->pfree_func    = stats1_sum_free;
 	return pstats1_acc;
 }
@@ -317,6 +422,16 @@ static void stats1_mean_emit(void* pvstate, char* value_field_name, char* stats1
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_mean_write_state(void* pvstate, FILE* output_stream) {
+	stats1_mean_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sum);
+}
+static void stats1_mean_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_mean_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sum   += aggregate_state_get_double(preader);
+}
 static void stats1_mean_free(stats1_acc_t* pstats1_acc) {
 	stats1_mean_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -336,7 +451,10 @@ stats1_acc_t* stats1_mean_alloc(char* value_field_name, char* stats1_acc_name, i
 	pstats1_acc->pdingest_func  = stats1_mean_dingest;
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = NULL;
+	pstats1_acc->ptingest_func  = NULL;
 	pstats1_acc->pemit_func     = stats1_mean_emit;
+	pstats1_acc->pwrite_state_func = stats1_mean_write_state;
+	pstats1_acc->pmerge_state_func = stats1_mean_merge_state;
 	pstats1_acc->pfree_func     = stats1_mean_free;
 	return pstats1_acc;
 }
@@ -376,6 +494,18 @@ static void stats1_stddev_var_meaneb_emit(void* pvstate, char* value_field_name,
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_stddev_var_meaneb_write_state(void* pvstate, FILE* output_stream) {
+	stats1_stddev_var_meaneb_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+}
+static void stats1_stddev_var_meaneb_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_stddev_var_meaneb_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+}
 static void stats1_stddev_var_meaneb_free(stats1_acc_t* pstats1_acc) {
 	stats1_stddev_var_meaneb_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -396,7 +526,10 @@ stats1_acc_t* stats1_stddev_var_meaneb_alloc(char* value_field_name, char* stats
 	pstats1_acc->pdingest_func = stats1_stddev_var_meaneb_dingest;
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
+	pstats1_acc->ptingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_stddev_var_meaneb_emit;
+	pstats1_acc->pwrite_state_func = stats1_stddev_var_meaneb_write_state;
+	pstats1_acc->pmerge_state_func = stats1_stddev_var_meaneb_merge_state;
 	pstats1_acc->pfree_func    = stats1_stddev_var_meaneb_free;
 	return pstats1_acc;
 }
@@ -448,6 +581,20 @@ static void stats1_skewness_emit(void* pvstate, char* value_field_name, char* st
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_skewness_write_state(void* pvstate, FILE* output_stream) {
+	stats1_skewness_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+	aggregate_state_put_double(output_stream, pstate->sumx3);
+}
+static void stats1_skewness_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_skewness_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+	pstate->sumx3 += aggregate_state_get_double(preader);
+}
 static void stats1_skewness_free(stats1_acc_t* pstats1_acc) {
 	stats1_skewness_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -470,7 +617,10 @@ stats1_acc_t* stats1_skewness_alloc(char* value_field_name, char* stats1_acc_nam
 	pstats1_acc->pdingest_func = stats1_skewness_dingest;
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
+	pstats1_acc->ptingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_skewness_emit;
+	pstats1_acc->pwrite_state_func = stats1_skewness_write_state;
+	pstats1_acc->pmerge_state_func = stats1_skewness_merge_state;
 	pstats1_acc->pfree_func    = stats1_skewness_free;
 	return pstats1_acc;
 }
@@ -509,6 +659,22 @@ static void stats1_kurtosis_emit(void* pvstate, char* value_field_name, char* st
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_kurtosis_write_state(void* pvstate, FILE* output_stream) {
+	stats1_kurtosis_state_t* pstate = pvstate;
+	aggregate_state_put_varint(output_stream, pstate->count);
+	aggregate_state_put_double(output_stream, pstate->sumx);
+	aggregate_state_put_double(output_stream, pstate->sumx2);
+	aggregate_state_put_double(output_stream, pstate->sumx3);
+	aggregate_state_put_double(output_stream, pstate->sumx4);
+}
+static void stats1_kurtosis_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_kurtosis_state_t* pstate = pvstate;
+	pstate->count += aggregate_state_get_varint(preader);
+	pstate->sumx  += aggregate_state_get_double(preader);
+	pstate->sumx2 += aggregate_state_get_double(preader);
+	pstate->sumx3 += aggregate_state_get_double(preader);
+	pstate->sumx4 += aggregate_state_get_double(preader);
+}
 static void stats1_kurtosis_free(stats1_acc_t* pstats1_acc) {
 	stats1_kurtosis_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -524,13 +690,17 @@ stats1_acc_t* stats1_kurtosis_alloc(char* value_field_name, char* stats1_acc_nam
 	pstate->sumx               = 0.0;
 	pstate->sumx2              = 0.0;
 	pstate->sumx3              = 0.0;
+	pstate->sumx4              = 0.0;
 	pstate->output_field_name  = mlr_paste_3_strings(value_field_name, "_", stats1_acc_name);
 
 	pstats1_acc->pvstate       = (void*)pstate;
 	pstats1_acc->pdingest_func = stats1_kurtosis_dingest;
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
+	pstats1_acc->ptingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_kurtosis_emit;
+	pstats1_acc->pwrite_state_func = stats1_kurtosis_write_state;
+	pstats1_acc->pmerge_state_func = stats1_kurtosis_merge_state;
 	pstats1_acc->pfree_func    = stats1_kurtosis_free;
 	return pstats1_acc;
 }
@@ -545,6 +715,10 @@ static void stats1_min_singest(void* pvstate, char* sval) {
 	mv_t val = mv_copy_type_infer_string_or_float_or_int(sval);
 	pstate->min = x_xx_min_func(&pstate->min, &val);
 }
+static void stats1_min_tingest(void* pvstate, mv_t* pval) {
+	stats1_min_state_t* pstate = pvstate;
+	pstate->min = x_xx_min_func(&pstate->min, pval);
+}
 static void stats1_min_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
 	stats1_min_state_t* pstate = pvstate;
 	if (mv_is_null(&pstate->min)) {
@@ -561,6 +735,15 @@ static void stats1_min_emit(void* pvstate, char* value_field_name, char* stats1_
 				FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_min_write_state(void* pvstate, FILE* output_stream) {
+	stats1_min_state_t* pstate = pvstate;
+	aggregate_state_put_mv(output_stream, &pstate->min);
+}
+static void stats1_min_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_min_state_t* pstate = pvstate;
+	mv_t min = aggregate_state_get_mv(preader);
+	pstate->min = x_xx_min_func(&pstate->min, &min);
+}
 static void stats1_min_free(stats1_acc_t* pstats1_acc) {
 	stats1_min_state_t* pstate = pstats1_acc->pvstate;
 	mv_free(&pstate->min);
@@ -580,7 +763,10 @@ stats1_acc_t* stats1_min_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pdingest_func = NULL;
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = stats1_min_singest;
+	pstats1_acc->ptingest_func = stats1_min_tingest;
 	pstats1_acc->pemit_func    = stats1_min_emit;
+	pstats1_acc->pwrite_state_func = stats1_min_write_state;
+	pstats1_acc->pmerge_state_func = stats1_min_merge_state;
 	pstats1_acc->pfree_func    = stats1_min_free;
 	return pstats1_acc;
 }
@@ -595,6 +781,10 @@ static void stats1_max_singest(void* pvstate, char* sval) {
 	mv_t val = mv_copy_type_infer_string_or_float_or_int(sval);
 	pstate->max = x_xx_max_func(&pstate->max, &val);
 }
+static void stats1_max_tingest(void* pvstate, mv_t* pval) {
+	stats1_max_state_t* pstate = pvstate;
+	pstate->max = x_xx_max_func(&pstate->max, pval);
+}
 static void stats1_max_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
 	stats1_max_state_t* pstate = pvstate;
 	if (mv_is_null(&pstate->max)) {
@@ -611,6 +801,15 @@ static void stats1_max_emit(void* pvstate, char* value_field_name, char* stats1_
 				FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_max_write_state(void* pvstate, FILE* output_stream) {
+	stats1_max_state_t* pstate = pvstate;
+	aggregate_state_put_mv(output_stream, &pstate->max);
+}
+static void stats1_max_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_max_state_t* pstate = pvstate;
+	mv_t max = aggregate_state_get_mv(preader);
+	pstate->max = x_xx_max_func(&pstate->max, &max);
+}
 static void stats1_max_free(stats1_acc_t* pstats1_acc) {
 	stats1_max_state_t* pstate = pstats1_acc->pvstate;
 	mv_free(&pstate->max);
@@ -630,23 +829,33 @@ stats1_acc_t* stats1_max_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pdingest_func = NULL;
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = stats1_max_singest;
+	pstats1_acc->ptingest_func = stats1_max_tingest;
 	pstats1_acc->pemit_func    = stats1_max_emit;
+	pstats1_acc->pwrite_state_func = stats1_max_write_state;
+	pstats1_acc->pmerge_state_func = stats1_max_merge_state;
 	pstats1_acc->pfree_func    = stats1_max_free;
 	return pstats1_acc;
 }
 
 // ----------------------------------------------------------------
+// Exact percentiles keep all the values; approximate ones, a sketch of them. The other is NULL.
 typedef struct _stats1_percentile_state_t {
 	percentile_keeper_t* ppercentile_keeper;
+	percentile_sketch_t* ppercentile_sketch;
 	lhmss_t* poutput_field_names;
 	int reference_count;
 	percentile_keeper_emitter_t* ppercentile_keeper_emitter;
+	percentile_sketch_emitter_t* ppercentile_sketch_emitter;
 } stats1_percentile_state_t;
 static void stats1_percentile_singest(void* pvstate, char* sval) {
 	stats1_percentile_state_t* pstate = pvstate;
 	mv_t val = mv_copy_type_infer_string_or_float_or_int(sval);
 	percentile_keeper_ingest(pstate->ppercentile_keeper, val);
 }
+static void stats1_percentile_tingest(void* pvstate, mv_t* pval) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_keeper_ingest(pstate->ppercentile_keeper, *pval);
+}
 
 static void stats1_percentile_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
 	stats1_percentile_state_t* pstate = pvstate;
@@ -658,7 +867,9 @@ static void stats1_percentile_emit(void* pvstate, char* value_field_name, char*
 		// TODO: do the sscanf once at alloc time and store the double in the state struct for a minor perf gain.
 		(void)sscanf(stats1_acc_name, "p%lf", &p); // Assuming this was range-checked earlier on to be in [0,100].
 	}
-	mv_t v = pstate->ppercentile_keeper_emitter(pstate->ppercentile_keeper, p);
+	mv_t v = (pstate->ppercentile_keeper != NULL)
+		? pstate->ppercentile_keeper_emitter(pstate->ppercentile_keeper, p)
+		: pstate->ppercentile_sketch_emitter(pstate->ppercentile_sketch, p);
 	char* s = mv_alloc_format_val(&v);
 	// For this type, one accumulator tracks many stats1_names, but a single value_field_name.
 	char* output_field_name = lhmss_get(pstate->poutput_field_names, stats1_acc_name);
@@ -670,11 +881,29 @@ static void stats1_percentile_emit(void* pvstate, char* value_field_name, char*
 	lrec_put(poutrec, mlr_strdup_or_die(output_field_name), s, FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
 }
 
+// The values are kept in order of arrival, so merged runs sort the same as a single run would.
+static void stats1_percentile_write_state(void* pvstate, FILE* output_stream) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_keeper_t* pkeeper = pstate->ppercentile_keeper;
+	MLR_INTERNAL_CODING_ERROR_IF(pkeeper->permuted);
+	aggregate_state_put_varint(output_stream, pkeeper->size);
+	for (unsigned long long i = 0; i < pkeeper->size; i++) {
+		mv_t value = percentile_keeper_get(pkeeper, i);
+		aggregate_state_put_mv(output_stream, &value);
+	}
+}
+static void stats1_percentile_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_percentile_state_t* pstate = pvstate;
+	unsigned long long size = aggregate_state_get_varint(preader);
+	for (unsigned long long i = 0; i < size; i++)
+		percentile_keeper_ingest(pstate->ppercentile_keeper, aggregate_state_get_mv(preader));
+}
 static void stats1_percentile_free(stats1_acc_t* pstats1_acc) {
 	stats1_percentile_state_t* pstate = pstats1_acc->pvstate;
 	pstate->reference_count--;
 	if (pstate->reference_count == 0) {
 		percentile_keeper_free(pstate->ppercentile_keeper);
+		percentile_sketch_free(pstate->ppercentile_sketch);
 		lhmss_free(pstate->poutput_field_names);
 		free(pstate);
 		free(pstats1_acc);
@@ -686,21 +915,503 @@ stats1_acc_t* stats1_percentile_alloc(char* value_field_name, char* stats1_acc_n
 	stats1_acc_t* pstats1_acc   = mlr_malloc_or_die(sizeof(stats1_acc_t));
 	stats1_percentile_state_t* pstate = mlr_malloc_or_die(sizeof(stats1_percentile_state_t));
 	pstate->ppercentile_keeper  = percentile_keeper_alloc();
+	pstate->ppercentile_sketch  = NULL;
 	pstate->poutput_field_names = lhmss_alloc();
 	pstate->reference_count     = 1;
 	pstate->ppercentile_keeper_emitter = (do_interpolated_percentiles)
 		? percentile_keeper_emit_linearly_interpolated
 		: percentile_keeper_emit_non_interpolated;
+	pstate->ppercentile_sketch_emitter = NULL;
 
 	pstats1_acc->pvstate        = (void*)pstate;
 	pstats1_acc->pdingest_func  = NULL;
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_percentile_singest;
+	pstats1_acc->ptingest_func  = stats1_percentile_tingest;
 	pstats1_acc->pemit_func     = stats1_percentile_emit;
+	pstats1_acc->pwrite_state_func = stats1_percentile_write_state;
+	pstats1_acc->pmerge_state_func = stats1_percentile_merge_state;
 	pstats1_acc->pfree_func     = stats1_percentile_free;
 	return pstats1_acc;
 }
+
+// ----------------------------------------------------------------
+// Approximate percentiles take only numbers, so they ingest those already scanned for the other numeric
+// accumulators.
+static void stats1_approx_percentile_ningest(void* pvstate, mv_t* pval) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_sketch_ingest(pstate->ppercentile_sketch, pval);
+}
+// The sketch's levels. Merging them into another sketch works as for sketches in memory.
+static void stats1_approx_percentile_write_state(void* pvstate, FILE* output_stream) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_sketch_t* psketch = pstate->ppercentile_sketch;
+	aggregate_state_put_varint(output_stream, psketch->all_ints);
+	aggregate_state_put_varint(output_stream, psketch->num_levels);
+	for (int h = 0; h < psketch->num_levels; h++) {
+		aggregate_state_put_varint(output_stream, psketch->level_sizes[h]);
+		for (int i = 0; i < psketch->level_sizes[h]; i++)
+			aggregate_state_put_double(output_stream, psketch->levels[h][i]);
+	}
+}
+static void stats1_approx_percentile_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_sketch_t* pother = percentile_sketch_alloc(pstate->ppercentile_sketch->k);
+	pother->all_ints = aggregate_state_get_varint(preader);
+	unsigned long long num_levels = aggregate_state_get_varint(preader);
+	if (num_levels > 64)
+		aggregate_state_corrupt(preader);
+	for (int h = 0; h < num_levels; h++) {
+		unsigned long long level_size = aggregate_state_get_varint(preader);
+		for (unsigned long long i = 0; i < level_size; i++)
+			percentile_sketch_put_at_level(pother, h, aggregate_state_get_double(preader));
+	}
+	percentile_sketch_merge(pstate->ppercentile_sketch, pother);
+	percentile_sketch_free(pother);
+}
+stats1_acc_t* stats1_approx_percentile_alloc(char* value_field_name, char* stats1_acc_name, int allow_int_float,
+	int do_interpolated_percentiles, int k)
+{
+	stats1_acc_t* pstats1_acc   = mlr_malloc_or_die(sizeof(stats1_acc_t));
+	stats1_percentile_state_t* pstate = mlr_malloc_or_die(sizeof(stats1_percentile_state_t));
+	pstate->ppercentile_keeper  = NULL;
+	pstate->ppercentile_sketch  = percentile_sketch_alloc(k);
+	pstate->poutput_field_names = lhmss_alloc();
+	pstate->reference_count     = 1;
+	pstate->ppercentile_keeper_emitter = NULL;
+	pstate->ppercentile_sketch_emitter = (do_interpolated_percentiles)
+		? percentile_sketch_emit_linearly_interpolated
+		: percentile_sketch_emit_non_interpolated;
+
+	pstats1_acc->pvstate        = (void*)pstate;
+	pstats1_acc->pdingest_func  = NULL;
+	pstats1_acc->pningest_func  = stats1_approx_percentile_ningest;
+	pstats1_acc->psingest_func  = NULL;
+	pstats1_acc->ptingest_func  = NULL;
+	pstats1_acc->pemit_func     = stats1_percentile_emit;
+	pstats1_acc->pwrite_state_func = stats1_approx_percentile_write_state;
+	pstats1_acc->pmerge_state_func = stats1_approx_percentile_merge_state;
+	pstats1_acc->pfree_func     = stats1_percentile_free;
+	return pstats1_acc;
+}
+
 void stats1_percentile_reuse(stats1_acc_t* pstats1_acc) {
 	stats1_percentile_state_t* pstate = pstats1_acc->pvstate;
 	pstate->reference_count++;
 }
+
+// ================================================================
+// Fused accumulators for mlr stats1: see stats1_accumulators.h.
+
+// In the order of stats1_fused_type_t.
+typedef struct _stats1_fused_lookup_t {
+	char* name;
+	stats1_fused_type_t type;
+	int moment_order;
+} stats1_fused_lookup_t;
+static stats1_fused_lookup_t stats1_fused_lookup_table[] = {
+	{"count",    STATS1_FUSED_COUNT,    0},
+	{"sum",      STATS1_FUSED_SUM,      0},
+	{"mean",     STATS1_FUSED_MEAN,     1},
+	{"var",      STATS1_FUSED_VAR,      2},
+	{"stddev",   STATS1_FUSED_STDDEV,   2},
+	{"meaneb",   STATS1_FUSED_MEANEB,   2},
+	{"skewness", STATS1_FUSED_SKEWNESS, 3},
+	{"kurtosis", STATS1_FUSED_KURTOSIS, 4},
+	{"min",      STATS1_FUSED_MIN,      0},
+	{"max",      STATS1_FUSED_MAX,      0},
+};
+static int stats1_fused_lookup_table_length = sizeof(stats1_fused_lookup_table) / sizeof(stats1_fused_lookup_table[0]);
+
+static stats1_fused_lookup_t* stats1_fused_lookup(char* stats1_acc_name) {
+	for (int i = 0; i < stats1_fused_lookup_table_length; i++)
+		if (streq(stats1_acc_name, stats1_fused_lookup_table[i].name))
+			return &stats1_fused_lookup_table[i];
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+stats1_plan_t* stats1_plan_alloc(slls_t* paccumulator_names, int allow_int_float) {
+	stats1_plan_t* pplan     = mlr_malloc_or_die(sizeof(stats1_plan_t));
+	pplan->num_views         = 0;
+	pplan->view_names        = mlr_malloc_or_die(paccumulator_names->length * sizeof(char*));
+	pplan->view_types        = mlr_malloc_or_die(paccumulator_names->length * sizeof(stats1_fused_type_t));
+	pplan->num_unfused_names = 0;
+	pplan->do_count          = FALSE;
+	pplan->do_sum            = FALSE;
+	pplan->do_min            = FALSE;
+	pplan->do_max            = FALSE;
+	pplan->moment_order      = 0;
+	pplan->allow_int_float   = allow_int_float;
+
+	for (sllse_t* pe = paccumulator_names->phead; pe != NULL; pe = pe->pnext) {
+		stats1_fused_lookup_t* plookup = stats1_fused_lookup(pe->value);
+		if (plookup == NULL) {
+			pplan->num_unfused_names++;
+			continue;
+		}
+		int is_repeat = FALSE;
+		for (int i = 0; i < pplan->num_views; i++)
+			if (pplan->view_types[i] == plookup->type)
+				is_repeat = TRUE;
+		if (is_repeat)
+			continue;
+		pplan->view_names[pplan->num_views] = pe->value;
+		pplan->view_types[pplan->num_views] = plookup->type;
+		pplan->num_views++;
+		if (plookup->type == STATS1_FUSED_COUNT)
+			pplan->do_count = TRUE;
+		else if (plookup->type == STATS1_FUSED_SUM)
+			pplan->do_sum = TRUE;
+		else if (plookup->type == STATS1_FUSED_MIN)
+			pplan->do_min = TRUE;
+		else if (plookup->type == STATS1_FUSED_MAX)
+			pplan->do_max = TRUE;
+		if (plookup->moment_order > pplan->moment_order)
+			pplan->moment_order = plookup->moment_order;
+	}
+
+	if (pplan->num_views == 0) {
+		stats1_plan_free(pplan);
+		return NULL;
+	}
+	return pplan;
+}
+
+void stats1_plan_free(stats1_plan_t* pplan) {
+	if (pplan == NULL)
+		return;
+	free(pplan->view_names);
+	free(pplan->view_types);
+	free(pplan);
+}
+
+// ----------------------------------------------------------------
+static void stats1_fused_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data,
+	lrec_t* poutrec)
+{
+	stats1_fused_view_t* pview = pvstate;
+	stats1_fused_t* pfused = pview->pfused;
+	char* val = NULL; // for empty output
+	double output;
+	switch (pview->type) {
+	case STATS1_FUSED_COUNT:
+		val = mv_alloc_format_val(&pfused->count);
+		break;
+	case STATS1_FUSED_SUM:
+		val = mv_alloc_format_val(&pfused->sum);
+		break;
+	case STATS1_FUSED_MEAN:
+		if (pfused->n > 0LL)
+			val = mlr_alloc_string_from_double(pfused->sumx / pfused->n, MLR_GLOBALS.ofmt);
+		break;
+	case STATS1_FUSED_VAR:
+	case STATS1_FUSED_STDDEV:
+	case STATS1_FUSED_MEANEB:
+		if (pfused->n >= 2LL) {
+			output = mlr_get_var(pfused->n, pfused->sumx, pfused->sumx2);
+			if (pview->type == STATS1_FUSED_STDDEV)
+				output = sqrt(output);
+			else if (pview->type == STATS1_FUSED_MEANEB)
+				output = sqrt(output / pfused->n);
+			val = mlr_alloc_string_from_double(output, MLR_GLOBALS.ofmt);
+		}
+		break;
+	case STATS1_FUSED_SKEWNESS:
+		if (pfused->n >= 2LL) {
+			output = mlr_get_skewness(pfused->n, pfused->sumx, pfused->sumx2, pfused->sumx3);
+			val = mlr_alloc_string_from_double(output, MLR_GLOBALS.ofmt);
+		}
+		break;
+	case STATS1_FUSED_KURTOSIS:
+		if (pfused->n >= 2LL) {
+			output = mlr_get_kurtosis(pfused->n, pfused->sumx, pfused->sumx2, pfused->sumx3, pfused->sumx4);
+			val = mlr_alloc_string_from_double(output, MLR_GLOBALS.ofmt);
+		}
+		break;
+	case STATS1_FUSED_MIN:
+		if (!mv_is_null(&pfused->min))
+			val = mv_alloc_format_val(&pfused->min);
+		break;
+	case STATS1_FUSED_MAX:
+		if (!mv_is_null(&pfused->max))
+			val = mv_alloc_format_val(&pfused->max);
+		break;
+	}
+
+	if (val == NULL) {
+		if (copy_data)
+			lrec_put(poutrec, mlr_strdup_or_die(pview->output_field_name), "", FREE_ENTRY_KEY);
+		else
+			lrec_put(poutrec, pview->output_field_name, "", NO_FREE);
+	} else {
+		if (copy_data)
+			lrec_put(poutrec, mlr_strdup_or_die(pview->output_field_name), val, FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
+		else
+			lrec_put(poutrec, pview->output_field_name, val, FREE_ENTRY_VALUE);
+	}
+}
+
+// As the standalone accumulators: the moments are the count, then the sums of powers up to the order.
+static void stats1_fused_write_state(void* pvstate, FILE* output_stream) {
+	stats1_fused_view_t* pview = pvstate;
+	stats1_fused_t* pfused = pview->pfused;
+	int moment_order = stats1_fused_lookup_table[pview->type].moment_order;
+	switch (pview->type) {
+	case STATS1_FUSED_COUNT:
+		aggregate_state_put_mv(output_stream, &pfused->count);
+		break;
+	case STATS1_FUSED_SUM:
+		aggregate_state_put_mv(output_stream, &pfused->sum);
+		break;
+	case STATS1_FUSED_MIN:
+		aggregate_state_put_mv(output_stream, &pfused->min);
+		break;
+	case STATS1_FUSED_MAX:
+		aggregate_state_put_mv(output_stream, &pfused->max);
+		break;
+	default:
+		aggregate_state_put_varint(output_stream, pfused->n);
+		aggregate_state_put_double(output_stream, pfused->sumx);
+		if (moment_order >= 2)
+			aggregate_state_put_double(output_stream, pfused->sumx2);
+		if (moment_order >= 3)
+			aggregate_state_put_double(output_stream, pfused->sumx3);
+		if (moment_order >= 4)
+			aggregate_state_put_double(output_stream, pfused->sumx4);
+		break;
+	}
+}
+
+// Each view's moments are a prefix of the highest-order view's, and all were ingested together; so of
+// each moment only the first copy read since stats1_fused_merge_begin is merged.
+static void stats1_fused_merge_state(void* pvstate, aggregate_state_reader_t* preader) {
+	stats1_fused_view_t* pview = pvstate;
+	stats1_fused_t* pfused = pview->pfused;
+	int moment_order = stats1_fused_lookup_table[pview->type].moment_order;
+	mv_t other;
+	switch (pview->type) {
+	case STATS1_FUSED_COUNT:
+		other = aggregate_state_get_mv(preader);
+		pfused->count = x_xx_plus_func(&pfused->count, &other);
+		break;
+	case STATS1_FUSED_SUM:
+		other = aggregate_state_get_mv(preader);
+		pfused->sum = x_xx_plus_func(&pfused->sum, &other);
+		break;
+	case STATS1_FUSED_MIN:
+		other = aggregate_state_get_mv(preader);
+		pfused->min = x_xx_min_func(&pfused->min, &other);
+		break;
+	case STATS1_FUSED_MAX:
+		other = aggregate_state_get_mv(preader);
+		pfused->max = x_xx_max_func(&pfused->max, &other);
+		break;
+	default:
+		{
+			unsigned long long n = aggregate_state_get_varint(preader);
+			double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+			for (int i = 0; i < moment_order; i++)
+				sums[i] = aggregate_state_get_double(preader);
+			if (pfused->merged_order == 0)
+				pfused->n += n;
+			if (pfused->merged_order < 1)
+				pfused->sumx += sums[0];
+			if (pfused->merged_order < 2 && moment_order >= 2)
+				pfused->sumx2 += sums[1];
+			if (pfused->merged_order < 3 && moment_order >= 3)
+				pfused->sumx3 += sums[2];
+			if (pfused->merged_order < 4 && moment_order >= 4)
+				pfused->sumx4 += sums[3];
+			if (moment_order > pfused->merged_order)
+				pfused->merged_order = moment_order;
+		}
+		break;
+	}
+}
+
+void stats1_fused_merge_begin(stats1_fused_t* pfused) {
+	pfused->merged_order = 0;
+}
+
+// Freed with the fused state.
+static void stats1_fused_view_free(stats1_acc_t* pstats1_acc) {
+}
+
+// ----------------------------------------------------------------
+static stats1_fused_t* stats1_fused_alloc(stats1_plan_t* pplan, char* value_field_name) {
+	stats1_fused_t* pfused = mlr_malloc_or_die(sizeof(stats1_fused_t)
+		+ pplan->num_views * sizeof(stats1_fused_view_t));
+	pfused->pplan        = pplan;
+	pfused->count        = pplan->allow_int_float ? mv_from_int(0LL) : mv_from_float(0.0);
+	pfused->sum          = pplan->allow_int_float ? mv_from_int(0LL) : mv_from_float(0.0);
+	pfused->min          = mv_absent();
+	pfused->max          = mv_absent();
+	pfused->n            = 0LL;
+	pfused->sumx         = 0.0;
+	pfused->sumx2        = 0.0;
+	pfused->sumx3        = 0.0;
+	pfused->sumx4        = 0.0;
+	pfused->merged_order = 0;
+	pfused->views        = (stats1_fused_view_t*)(pfused + 1);
+
+	for (int i = 0; i < pplan->num_views; i++) {
+		stats1_fused_view_t* pview = &pfused->views[i];
+		pview->pfused            = pfused;
+		pview->type              = pplan->view_types[i];
+		pview->output_field_name = mlr_paste_3_strings(value_field_name, "_", pplan->view_names[i]);
+
+		pview->acc.pvstate           = (void*)pview;
+		pview->acc.pdingest_func     = NULL;
+		pview->acc.pningest_func     = NULL;
+		pview->acc.psingest_func     = NULL;
+		pview->acc.ptingest_func     = NULL;
+		pview->acc.pemit_func        = stats1_fused_emit;
+		pview->acc.pwrite_state_func = stats1_fused_write_state;
+		pview->acc.pmerge_state_func = stats1_fused_merge_state;
+		pview->acc.pfree_func        = stats1_fused_view_free;
+	}
+	return pfused;
+}
+
+void stats1_fused_free(stats1_fused_t* pfused) {
+	if (pfused == NULL)
+		return;
+	mv_free(&pfused->min);
+	mv_free(&pfused->max);
+	for (int i = 0; i < pfused->pplan->num_views; i++)
+		free(pfused->views[i].output_field_name);
+	free(pfused);
+}
+
+// The in/out maps are populated in the order of the accumulator names, as by make_stats1_accs, so that
+// state is written in the same order.
+stats1_fused_t* make_stats1_fused_accs(
+	stats1_plan_t* pplan,                 // input
+	char*    value_field_name,            // input
+	slls_t*  paccumulator_names,          // input
+	int      do_interpolated_percentiles, // input
+	int      do_approx_percentiles,       // input
+	int      approx_percentile_k,         // input
+	lhmsv_t* acc_field_to_acc_state_in,   // output
+	lhmsv_t* acc_field_to_acc_state_out)  // output
+{
+	stats1_fused_t* pfused = stats1_fused_alloc(pplan, value_field_name);
+	stats1_acc_t* ppercentile_acc = NULL;
+	stats1_acc_t* papprox_percentile_acc = NULL;
+	int i = 0;
+	for (sllse_t* pc = paccumulator_names->phead; pc != NULL; pc = pc->pnext) {
+		char* stats1_acc_name = pc->value;
+		if (stats1_fused_lookup(stats1_acc_name) == NULL) {
+			make_stats1_accs_for_name(value_field_name, stats1_acc_name, pplan->allow_int_float,
+				do_interpolated_percentiles, do_approx_percentiles, approx_percentile_k,
+				&ppercentile_acc, &papprox_percentile_acc, acc_field_to_acc_state_in, acc_field_to_acc_state_out);
+		} else if (i < pplan->num_views && stats1_acc_name == pplan->view_names[i]) { // else a repeat
+			stats1_acc_t* pstats1_acc = &pfused->views[i].acc;
+			lhmsv_put(acc_field_to_acc_state_in, stats1_acc_name, pstats1_acc, NO_FREE);
+			lhmsv_put(acc_field_to_acc_state_out, stats1_acc_name, pstats1_acc, NO_FREE);
+			i++;
+		}
+	}
+	return pfused;
+}
+
+// ----------------------------------------------------------------
+// The value as mlr_double_from_string_or_die would have it. For decimal integers that's the scanned int
+// converted; but e.g. "010" scans as octal, and "0x10" as hex.
+static double stats1_fused_dval(char* sval, mv_t* pnval) {
+	if (pnval->type == MT_FLOAT)
+		return pnval->u.fltv;
+	char* p = (*sval == '-') ? sval + 1 : sval;
+	if ('1' <= *p && *p <= '9')
+		return (double)pnval->u.intv;
+	return mlr_double_from_string_or_die(sval);
+}
+
+static inline void stats1_fused_count(stats1_fused_t* pfused) {
+	stats1_plan_t* pplan = pfused->pplan;
+	if (pfused->count.type == MT_INT && pplan->allow_int_float) {
+		pfused->count.u.intv++;
+	} else {
+		mv_t one = pplan->allow_int_float ? mv_from_int(1LL) : mv_from_float(1.0);
+		pfused->count = x_xx_plus_func(&pfused->count, &one);
+	}
+}
+
+// The number as the standalone accumulators get it: pnval for sum (if allowing ints), min and max;
+// dval for the others.
+static inline void stats1_fused_ingest_number(stats1_fused_t* pfused, mv_t* pnval, double dval) {
+	stats1_plan_t* pplan = pfused->pplan;
+	if (pplan->do_sum) {
+		if (!pplan->allow_int_float) {
+			mv_t fval = mv_from_float(dval);
+			pfused->sum = x_xx_plus_func(&pfused->sum, &fval);
+		} else if (pfused->sum.type == MT_FLOAT && pnval->type == MT_FLOAT) {
+			pfused->sum.u.fltv += pnval->u.fltv;
+		} else {
+			pfused->sum = x_xx_plus_func(&pfused->sum, pnval);
+		}
+	}
+	if (pplan->moment_order > 0) {
+		pfused->n++;
+		pfused->sumx += dval;
+		if (pplan->moment_order >= 2)
+			pfused->sumx2 += dval*dval;
+		if (pplan->moment_order >= 3)
+			pfused->sumx3 += dval*dval*dval;
+		if (pplan->moment_order >= 4)
+			pfused->sumx4 += dval*dval*dval*dval;
+	}
+	if (pplan->do_min)
+		pfused->min = x_xx_min_func(&pfused->min, pnval);
+	if (pplan->do_max)
+		pfused->max = x_xx_max_func(&pfused->max, pnval);
+}
+
+// Each value is scanned once. Non-numeric values are counted and go to min and max, as strings; else,
+// as for the standalone accumulators, they're fatal.
+void stats1_fused_singest(stats1_fused_t* pfused, char* sval) {
+	stats1_plan_t* pplan = pfused->pplan;
+	if (pplan->do_count)
+		stats1_fused_count(pfused);
+	if (pplan->num_views == pplan->do_count) // just count, which needn't scan
+		return;
+
+	// Without min, max or an int-preserving sum, only the floating-point value is needed.
+	if (!pplan->do_min && !pplan->do_max && !(pplan->do_sum && pplan->allow_int_float)) {
+		double dval = mlr_double_from_string_or_die(sval);
+		mv_t fval = mv_from_float(dval);
+		stats1_fused_ingest_number(pfused, &fval, dval);
+		return;
+	}
+
+	mv_t nval = mv_scan_number_nullable(sval);
+	if (!mv_is_numeric(&nval)) {
+		if (pplan->do_sum || pplan->moment_order > 0) {
+			fprintf(stderr, "%s: couldn't parse \"%s\" as number.\n", MLR_GLOBALS.bargv0, sval);
+			exit(1);
+		}
+		// Separate copies since min and max each free the value they don't keep.
+		if (pplan->do_min) {
+			mv_t val = mv_from_string(mlr_strdup_or_die(sval), FREE_ENTRY_VALUE);
+			pfused->min = x_xx_min_func(&pfused->min, &val);
+		}
+		if (pplan->do_max) {
+			mv_t val = mv_from_string(mlr_strdup_or_die(sval), FREE_ENTRY_VALUE);
+			pfused->max = x_xx_max_func(&pfused->max, &val);
+		}
+		return;
+	}
+
+	double dval = 0.0;
+	if (pplan->moment_order > 0 || (pplan->do_sum && !pplan->allow_int_float))
+		dval = stats1_fused_dval(sval, &nval);
+	stats1_fused_ingest_number(pfused, &nval, dval);
+}
+
+void stats1_fused_tingest(stats1_fused_t* pfused, mv_t* pval) {
+	if (pfused->pplan->do_count)
+		stats1_fused_count(pfused);
+	double dval = (pval->type == MT_INT) ? (double)pval->u.intv : pval->u.fltv;
+	stats1_fused_ingest_number(pfused, pval, dval);
+}
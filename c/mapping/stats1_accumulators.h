@@ -4,6 +4,7 @@
 #include "containers/lrec.h"
 #include "containers/slls.h"
 #include "containers/lhmsv.h"
+#include "mapping/aggregate_state.h"
 
 // ----------------------------------------------------------------
 // These are used by mlr stats1 as well as mlr merge-fields.
@@ -31,13 +32,22 @@ typedef void stats1_singest_func_t(void* pvstate, char*  val);
 // after the accumulator is freed.
 typedef void stats1_emit_func_t(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec);
 typedef void stats1_free_func_t(struct _stats1_acc_t* pstats1_acc);
+// For mlr stats1 --write-state and mlr merge-state: see aggregate_state.h. Merging folds in the state of
+// an accumulator of the same type, as though this one had also ingested the other's values.
+typedef void stats1_write_state_func_t(void* pvstate, FILE* output_stream);
+typedef void stats1_merge_state_func_t(void* pvstate, aggregate_state_reader_t* preader);
 
 typedef struct _stats1_acc_t {
 	void* pvstate;
 	stats1_dingest_func_t* pdingest_func;
 	stats1_ningest_func_t* pningest_func;
 	stats1_singest_func_t* psingest_func;
+	// Optional: for accumulators taking strings, the same given a number already typed, e.g. from
+	// columnar input. NULL for those needing the original text, e.g. mode.
+	stats1_ningest_func_t* ptingest_func;
 	stats1_emit_func_t*    pemit_func;
+	stats1_write_state_func_t* pwrite_state_func;
+	stats1_merge_state_func_t* pmerge_state_func;
 	stats1_free_func_t*    pfree_func; // virtual destructor
 } stats1_acc_t;
 
@@ -60,6 +70,9 @@ stats1_acc_t* stats1_kurtosis_alloc          (char* value_field_name, char* stat
 stats1_acc_t* stats1_min_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_max_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_percentile_alloc        (char* value_field_name, char* stats1_acc_name, int aif, int dip);
+// For p10~, median~ etc., or all percentiles with stats1 --approx-percentiles: see containers/percentile_sketch.h.
+stats1_acc_t* stats1_approx_percentile_alloc (char* value_field_name, char* stats1_acc_name, int aif, int dip,
+	int k);
 void          stats1_percentile_reuse        (stats1_acc_t* pstats1_acc);
 
 
@@ -72,6 +85,8 @@ void make_stats1_accs(
 	slls_t*  paccumulator_names,
 	int      allow_int_float,
 	int      do_interpolated_percentiles,
+	int      do_approx_percentiles,
+	int      approx_percentile_k,
 	lhmsv_t* acc_field_to_acc_state_in,
 	lhmsv_t* acc_field_to_acc_state_out);
 
@@ -82,6 +97,90 @@ stats1_acc_t* make_stats1_acc(
 	int   do_interpolated_percentiles);
 
 int is_percentile_acc_name(char* stats1_acc_name);
+int is_approx_percentile_acc_name(char* stats1_acc_name);
+
+// ----------------------------------------------------------------
+// For mlr stats1: the accumulators which are sums and extrema -- count, sum, mean, var, stddev, meaneb,
+// skewness, kurtosis, min and max -- are fused. The plan, compiled once from the accumulator names, says
+// which of them are wanted; then per value field and group a single stats1_fused_t holds all their state,
+// and takes each value once, with the moments (count, sum, sum of squares, ...) shared between mean, var,
+// stddev, meaneb, skewness and kurtosis.
+//
+// Each fused accumulator still has a stats1_acc_t in the in/out maps, as a view onto the fused state, for
+// emit and for --write-state with the same layout as the standalone accumulator. The views have no ingest
+// functions: values go to stats1_fused_singest or stats1_fused_tingest instead.
+typedef enum _stats1_fused_type_t {
+	STATS1_FUSED_COUNT,
+	STATS1_FUSED_SUM,
+	STATS1_FUSED_MEAN,
+	STATS1_FUSED_VAR,
+	STATS1_FUSED_STDDEV,
+	STATS1_FUSED_MEANEB,
+	STATS1_FUSED_SKEWNESS,
+	STATS1_FUSED_KURTOSIS,
+	STATS1_FUSED_MIN,
+	STATS1_FUSED_MAX,
+} stats1_fused_type_t;
+
+typedef struct _stats1_plan_t {
+	int    num_views;
+	char** view_names; // pointing into the accumulator names
+	stats1_fused_type_t* view_types;
+	int    num_unfused_names; // e.g. mode or percentiles, ingested as usual
+	int    do_count;
+	int    do_sum;
+	int    do_min;
+	int    do_max;
+	int    moment_order; // 0 for none, 1 for mean, 2 for var/stddev/meaneb, 3 for skewness, 4 for kurtosis
+	int    allow_int_float;
+} stats1_plan_t;
+
+struct _stats1_fused_t;
+typedef struct _stats1_fused_view_t {
+	stats1_acc_t acc;
+	struct _stats1_fused_t* pfused;
+	stats1_fused_type_t type;
+	char* output_field_name;
+} stats1_fused_view_t;
+
+typedef struct _stats1_fused_t {
+	stats1_plan_t* pplan;
+	mv_t count;
+	mv_t sum;
+	mv_t min;
+	mv_t max;
+	unsigned long long n;
+	double sumx;
+	double sumx2;
+	double sumx3;
+	double sumx4;
+	int merged_order; // for merging state: see stats1_fused_merge_begin
+	stats1_fused_view_t* views; // in the same allocation, in plan order
+} stats1_fused_t;
+
+// Returns NULL if none of the names is for a fused accumulator.
+stats1_plan_t* stats1_plan_alloc(slls_t* paccumulator_names, int allow_int_float);
+void           stats1_plan_free(stats1_plan_t* pplan);
+
+// As make_stats1_accs, with views onto the returned fused state for the accumulators in the plan.
+stats1_fused_t* make_stats1_fused_accs(
+	stats1_plan_t* pplan,
+	char*    value_field_name,
+	slls_t*  paccumulator_names,
+	int      do_interpolated_percentiles,
+	int      do_approx_percentiles,
+	int      approx_percentile_k,
+	lhmsv_t* acc_field_to_acc_state_in,
+	lhmsv_t* acc_field_to_acc_state_out);
+// The views are freed along with the fused state; their own free functions do nothing.
+void stats1_fused_free(stats1_fused_t* pfused);
+
+// As the standalone accumulators' singest and tingest, for all the fused accumulators at once.
+void stats1_fused_singest(stats1_fused_t* pfused, char* sval);
+void stats1_fused_tingest(stats1_fused_t* pfused, mv_t* pval);
+// Call before merging the states of a value field's accumulators, so that the moments shared between
+// e.g. mean and var are merged only once.
+void stats1_fused_merge_begin(stats1_fused_t* pfused);
 
 // ----------------------------------------------------------------
 // Lookups for all but percentiles, which are a special case.
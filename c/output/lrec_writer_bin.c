@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "lib/bin_format.h"
+#include "containers/lhmslv.h"
+#include "containers/mixutil.h"
+#include "output/lrec_writers.h"
+
+// Past this many distinct field-name lists, records carry their own field names instead, so that
+// highly heterogeneous data doesn't grow the writer's (and readers') schema dictionaries without bound.
+#define MAX_SCHEMAS 4096
+
+// A typed decimal takes ten bytes; shorter ones are no bigger as strings.
+#define MIN_TYPED_DECIMAL_LENGTH 9
+
+typedef struct _bin_schema_t {
+	unsigned long long id;
+	slls_t* pfield_names; // the key in the map of schemas
+} bin_schema_t;
+
+typedef struct _lrec_writer_bin_state_t {
+	int            write_typed_numbers;
+	int            wrote_stream_header;
+	lhmslv_t*      pschemas_by_field_names;
+	bin_schema_t*  plast_schema;
+	unsigned char* payload;
+	size_t         payload_length;
+	size_t         payload_capacity;
+} lrec_writer_bin_state_t;
+
+static void lrec_writer_bin_free(lrec_writer_t* pwriter, context_t* pctx);
+static void lrec_writer_bin_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static bin_schema_t* lrec_writer_bin_get_schema(lrec_writer_bin_state_t* pstate, FILE* output_stream,
+	lrec_t* prec);
+static void write_item(lrec_writer_bin_state_t* pstate, FILE* output_stream, char tag, unsigned long long a);
+static void payload_put_varint(lrec_writer_bin_state_t* pstate, unsigned long long value);
+static void payload_put_string(lrec_writer_bin_state_t* pstate, char* s, size_t length);
+static void payload_put_value(lrec_writer_bin_state_t* pstate, char* s);
+
+// ----------------------------------------------------------------
+lrec_writer_t* lrec_writer_bin_alloc(int write_typed_numbers) {
+	lrec_writer_t* plrec_writer = mlr_malloc_or_die(sizeof(lrec_writer_t));
+
+	lrec_writer_bin_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_bin_state_t));
+	pstate->write_typed_numbers     = write_typed_numbers;
+	pstate->wrote_stream_header     = FALSE;
+	pstate->pschemas_by_field_names = lhmslv_alloc();
+	pstate->plast_schema            = NULL;
+	pstate->payload_capacity        = 1024;
+	pstate->payload                 = mlr_malloc_or_die(pstate->payload_capacity);
+	pstate->payload_length          = 0;
+
+	plrec_writer->pvstate       = (void*)pstate;
+	plrec_writer->pprocess_func = lrec_writer_bin_process;
+	plrec_writer->pfree_func    = lrec_writer_bin_free;
+
+	return plrec_writer;
+}
+
+static void lrec_writer_bin_free(lrec_writer_t* pwriter, context_t* pctx) {
+	lrec_writer_bin_state_t* pstate = pwriter->pvstate;
+	// lhmslv_free will free the keys: we only need to free the void-star values.
+	for (lhmslve_t* pe = pstate->pschemas_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		free(pe->pvvalue);
+	lhmslv_free(pstate->pschemas_by_field_names);
+	free(pstate->payload);
+	free(pstate);
+	free(pwriter);
+}
+
+// ----------------------------------------------------------------
+static void lrec_writer_bin_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx) {
+	if (prec == NULL)
+		return;
+	lrec_writer_bin_state_t* pstate = pvstate;
+
+	if (!pstate->wrote_stream_header) {
+		fwrite(MLR_BIN_STREAM_HEADER, 1, MLR_BIN_STREAM_HEADER_LENGTH, output_stream);
+		pstate->wrote_stream_header = TRUE;
+	}
+
+	bin_schema_t* pschema = lrec_writer_bin_get_schema(pstate, output_stream, prec);
+	pstate->payload_length = 0;
+	if (pschema != NULL) {
+		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext)
+			payload_put_value(pstate, pe->value);
+		write_item(pstate, output_stream, MLR_BIN_TAG_RECORD, pschema->id);
+	} else {
+		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+			payload_put_string(pstate, pe->key, strlen(pe->key));
+			payload_put_value(pstate, pe->value);
+		}
+		write_item(pstate, output_stream, MLR_BIN_TAG_KEYED_RECORD, prec->field_count);
+	}
+
+	// See ../README.md for memory-management conventions
+	lrec_free(prec);
+}
+
+// Returns NULL if the record is to carry its own field names. Writes the schema definition the first
+// time a given list of field names is seen.
+static bin_schema_t* lrec_writer_bin_get_schema(lrec_writer_bin_state_t* pstate, FILE* output_stream,
+	lrec_t* prec)
+{
+	// Homogeneous data is the common case, so check against the previous record's schema first.
+	if (pstate->plast_schema != NULL && lrec_keys_equal_list(prec, pstate->plast_schema->pfield_names))
+		return pstate->plast_schema;
+
+	slls_t* pfield_names = mlr_reference_keys_from_record(prec);
+	bin_schema_t* pschema = lhmslv_get(pstate->pschemas_by_field_names, pfield_names);
+	slls_free(pfield_names);
+
+	if (pschema == NULL) {
+		int num_schemas = lhmslv_size(pstate->pschemas_by_field_names);
+		if (num_schemas >= MAX_SCHEMAS)
+			return NULL;
+		pschema = mlr_malloc_or_die(sizeof(bin_schema_t));
+		pschema->id = num_schemas;
+		pschema->pfield_names = mlr_copy_keys_from_record(prec);
+		lhmslv_put(pstate->pschemas_by_field_names, pschema->pfield_names, pschema, FREE_ENTRY_KEY);
+
+		pstate->payload_length = 0;
+		payload_put_varint(pstate, pschema->pfield_names->length);
+		for (sllse_t* pe = pschema->pfield_names->phead; pe != NULL; pe = pe->pnext)
+			payload_put_string(pstate, pe->value, strlen(pe->value));
+		write_item(pstate, output_stream, MLR_BIN_TAG_SCHEMA, pschema->id);
+	}
+
+	pstate->plast_schema = pschema;
+	return pschema;
+}
+
+// ----------------------------------------------------------------
+static void write_item(lrec_writer_bin_state_t* pstate, FILE* output_stream, char tag, unsigned long long a) {
+	unsigned char prefix[21];
+	prefix[0] = tag;
+	int prefix_length = 1;
+	prefix_length += mlr_bin_put_varint(&prefix[prefix_length], a);
+	prefix_length += mlr_bin_put_varint(&prefix[prefix_length], pstate->payload_length);
+	fwrite(prefix, 1, prefix_length, output_stream);
+	fwrite(pstate->payload, 1, pstate->payload_length, output_stream);
+}
+
+static inline void payload_ensure(lrec_writer_bin_state_t* pstate, size_t more) {
+	if (pstate->payload_length + more > pstate->payload_capacity) {
+		while (pstate->payload_length + more > pstate->payload_capacity)
+			pstate->payload_capacity *= 2;
+		pstate->payload = mlr_realloc_or_die(pstate->payload, pstate->payload_capacity);
+	}
+}
+
+static void payload_put_varint(lrec_writer_bin_state_t* pstate, unsigned long long value) {
+	payload_ensure(pstate, 10);
+	pstate->payload_length += mlr_bin_put_varint(&pstate->payload[pstate->payload_length], value);
+}
+
+static void payload_put_string(lrec_writer_bin_state_t* pstate, char* s, size_t length) {
+	payload_ensure(pstate, 10 + length + 1);
+	unsigned char* p = &pstate->payload[pstate->payload_length];
+	p += mlr_bin_put_varint(p, length);
+	memcpy(p, s, length + 1);
+	pstate->payload_length = p + length + 1 - pstate->payload;
+}
+
+// Numbers are written typed only when reading them back reproduces the text exactly.
+static void payload_put_value(lrec_writer_bin_state_t* pstate, char* s) {
+	size_t length = strlen(s);
+	if (pstate->write_typed_numbers && length > 0) {
+		long long int_value;
+		double double_value;
+		int decimals;
+		if (mlr_bin_is_canonical_int(s, &int_value)) {
+			payload_put_varint(pstate, MLR_BIN_VALUE_INT);
+			payload_put_varint(pstate, mlr_bin_zigzag(int_value));
+			return;
+		}
+		if (length >= MIN_TYPED_DECIMAL_LENGTH && mlr_bin_is_exact_decimal(s, length, &double_value, &decimals)) {
+			payload_ensure(pstate, 10);
+			unsigned char* p = &pstate->payload[pstate->payload_length];
+			p[0] = MLR_BIN_VALUE_DOUBLE;
+			p[1] = decimals;
+			mlr_bin_put_double(&p[2], double_value);
+			pstate->payload_length += 10;
+			return;
+		}
+	}
+	payload_ensure(pstate, 10 + length + 1);
+	unsigned char* p = &pstate->payload[pstate->payload_length];
+	p += mlr_bin_put_varint(p, (unsigned long long)length << 1);
+	memcpy(p, s, length + 1);
+	pstate->payload_length = p + length + 1 - pstate->payload;
+}
@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "lib/col_format.h"
+#include "containers/sllv.h"
+#include "containers/mixutil.h"
+#include "output/lrec_writers.h"
+
+// Records are held until there are this many with the same field names, or until the field names
+// change, then written as a row group.
+#define MAX_ROW_GROUP_LENGTH 65536
+
+typedef struct _col_buffer_t {
+	unsigned char* bytes;
+	size_t         length;
+	size_t         capacity;
+} col_buffer_t;
+
+typedef struct _lrec_writer_col_state_t {
+	int           wrote_stream_header;
+	sllv_t*       precords;     // the row group so far
+	slls_t*       pfield_names; // theirs
+	lrece_t**     cursors;      // per record, when writing the row group a column at a time
+	long long*    ints;
+	double*       doubles;
+	char*         decimals;
+	col_buffer_t  directory;
+	col_buffer_t  blocks;
+} lrec_writer_col_state_t;
+
+static void lrec_writer_col_free(lrec_writer_t* pwriter, context_t* pctx);
+static void lrec_writer_col_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static void lrec_writer_col_write_row_group(lrec_writer_col_state_t* pstate, FILE* output_stream);
+static int  lrec_writer_col_scan_ints(lrec_writer_col_state_t* pstate, int num_rows);
+static int  lrec_writer_col_scan_floats(lrec_writer_col_state_t* pstate, int num_rows);
+static void buffer_ensure(col_buffer_t* pbuffer, size_t more);
+static void buffer_put_varint(col_buffer_t* pbuffer, unsigned long long value);
+static void buffer_put_string(col_buffer_t* pbuffer, char* s, size_t length);
+static void buffer_put_double(col_buffer_t* pbuffer, double value);
+
+// ----------------------------------------------------------------
+lrec_writer_t* lrec_writer_col_alloc() {
+	lrec_writer_t* plrec_writer = mlr_malloc_or_die(sizeof(lrec_writer_t));
+
+	lrec_writer_col_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_col_state_t));
+	pstate->wrote_stream_header = FALSE;
+	pstate->precords            = sllv_alloc();
+	pstate->pfield_names        = NULL;
+	pstate->cursors             = mlr_malloc_or_die(MAX_ROW_GROUP_LENGTH * sizeof(lrece_t*));
+	pstate->ints                = mlr_malloc_or_die(MAX_ROW_GROUP_LENGTH * sizeof(long long));
+	pstate->doubles             = mlr_malloc_or_die(MAX_ROW_GROUP_LENGTH * sizeof(double));
+	pstate->decimals            = mlr_malloc_or_die(MAX_ROW_GROUP_LENGTH * sizeof(char));
+	pstate->directory.capacity  = 1024;
+	pstate->directory.bytes     = mlr_malloc_or_die(pstate->directory.capacity);
+	pstate->directory.length    = 0;
+	pstate->blocks.capacity     = 65536;
+	pstate->blocks.bytes        = mlr_malloc_or_die(pstate->blocks.capacity);
+	pstate->blocks.length       = 0;
+
+	plrec_writer->pvstate       = (void*)pstate;
+	plrec_writer->pprocess_func = lrec_writer_col_process;
+	plrec_writer->pfree_func    = lrec_writer_col_free;
+
+	return plrec_writer;
+}
+
+static void lrec_writer_col_free(lrec_writer_t* pwriter, context_t* pctx) {
+	lrec_writer_col_state_t* pstate = pwriter->pvstate;
+	for (sllve_t* pe = pstate->precords->phead; pe != NULL; pe = pe->pnext)
+		lrec_free(pe->pvvalue);
+	sllv_free(pstate->precords);
+	slls_free(pstate->pfield_names);
+	free(pstate->cursors);
+	free(pstate->ints);
+	free(pstate->doubles);
+	free(pstate->decimals);
+	free(pstate->directory.bytes);
+	free(pstate->blocks.bytes);
+	free(pstate);
+	free(pwriter);
+}
+
+// ----------------------------------------------------------------
+static void lrec_writer_col_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx) {
+	lrec_writer_col_state_t* pstate = pvstate;
+	if (prec == NULL) { // end of record stream
+		lrec_writer_col_write_row_group(pstate, output_stream);
+		return;
+	}
+
+	if (!pstate->wrote_stream_header) {
+		fwrite(MLR_COL_STREAM_HEADER, 1, MLR_COL_STREAM_HEADER_LENGTH, output_stream);
+		pstate->wrote_stream_header = TRUE;
+	}
+
+	if (pstate->pfield_names != NULL && !lrec_keys_equal_list(prec, pstate->pfield_names)) {
+		lrec_writer_col_write_row_group(pstate, output_stream);
+		slls_free(pstate->pfield_names);
+		pstate->pfield_names = NULL;
+	}
+	if (pstate->pfield_names == NULL)
+		pstate->pfield_names = mlr_copy_keys_from_record(prec);
+
+	// See ../README.md for memory-management conventions: the records are freed once written.
+	sllv_append(pstate->precords, prec);
+	if (pstate->precords->length >= MAX_ROW_GROUP_LENGTH)
+		lrec_writer_col_write_row_group(pstate, output_stream);
+}
+
+// ----------------------------------------------------------------
+static void lrec_writer_col_write_row_group(lrec_writer_col_state_t* pstate, FILE* output_stream) {
+	int num_rows = pstate->precords->length;
+	if (num_rows == 0)
+		return;
+
+	int r = 0;
+	for (sllve_t* pe = pstate->precords->phead; pe != NULL; pe = pe->pnext, r++)
+		pstate->cursors[r] = ((lrec_t*)pe->pvvalue)->phead;
+
+	pstate->directory.length = 0;
+	pstate->blocks.length = 0;
+	buffer_put_varint(&pstate->directory, pstate->pfield_names->length);
+	for (sllse_t* pf = pstate->pfield_names->phead; pf != NULL; pf = pf->pnext) {
+		buffer_put_string(&pstate->directory, pf->value, strlen(pf->value));
+		size_t block_start = pstate->blocks.length;
+
+		if (lrec_writer_col_scan_ints(pstate, num_rows)) {
+			long long min = pstate->ints[0];
+			long long max = pstate->ints[0];
+			for (r = 0; r < num_rows; r++) {
+				long long value = pstate->ints[r];
+				if (value < min)
+					min = value;
+				if (value > max)
+					max = value;
+				buffer_put_varint(&pstate->blocks, mlr_bin_zigzag(value));
+			}
+			buffer_ensure(&pstate->directory, 1);
+			pstate->directory.bytes[pstate->directory.length++] = MLR_COL_TYPE_INT;
+			buffer_put_varint(&pstate->directory, pstate->blocks.length - block_start);
+			buffer_put_varint(&pstate->directory, mlr_bin_zigzag(min));
+			buffer_put_varint(&pstate->directory, mlr_bin_zigzag(max));
+
+		} else if (lrec_writer_col_scan_floats(pstate, num_rows)) {
+			double min = pstate->doubles[0];
+			double max = pstate->doubles[0];
+			buffer_ensure(&pstate->blocks, (size_t)num_rows * MLR_COL_FLOAT_VALUE_LENGTH);
+			for (r = 0; r < num_rows; r++) {
+				double value = pstate->doubles[r];
+				if (value < min)
+					min = value;
+				if (value > max)
+					max = value;
+				unsigned char* p = &pstate->blocks.bytes[pstate->blocks.length];
+				p[0] = pstate->decimals[r];
+				mlr_bin_put_double(&p[1], value);
+				pstate->blocks.length += MLR_COL_FLOAT_VALUE_LENGTH;
+			}
+			buffer_ensure(&pstate->directory, 1);
+			pstate->directory.bytes[pstate->directory.length++] = MLR_COL_TYPE_FLOAT;
+			buffer_put_varint(&pstate->directory, pstate->blocks.length - block_start);
+			buffer_put_double(&pstate->directory, min);
+			buffer_put_double(&pstate->directory, max);
+
+		} else {
+			for (r = 0; r < num_rows; r++) {
+				char* value = pstate->cursors[r]->value;
+				buffer_put_string(&pstate->blocks, value, strlen(value));
+			}
+			buffer_ensure(&pstate->directory, 1);
+			pstate->directory.bytes[pstate->directory.length++] = MLR_COL_TYPE_STRING;
+			buffer_put_varint(&pstate->directory, pstate->blocks.length - block_start);
+		}
+
+		for (r = 0; r < num_rows; r++)
+			pstate->cursors[r] = pstate->cursors[r]->pnext;
+	}
+
+	unsigned char prefix[21];
+	prefix[0] = MLR_COL_TAG_ROW_GROUP;
+	int prefix_length = 1;
+	prefix_length += mlr_bin_put_varint(&prefix[prefix_length], num_rows);
+	prefix_length += mlr_bin_put_varint(&prefix[prefix_length], pstate->directory.length + pstate->blocks.length);
+	fwrite(prefix, 1, prefix_length, output_stream);
+	fwrite(pstate->directory.bytes, 1, pstate->directory.length, output_stream);
+	fwrite(pstate->blocks.bytes, 1, pstate->blocks.length, output_stream);
+
+	for (sllve_t* pe = pstate->precords->phead; pe != NULL; pe = pe->pnext)
+		lrec_free(pe->pvvalue);
+	sllv_free(pstate->precords);
+	pstate->precords = sllv_alloc();
+}
+
+// True if the column's values at the cursors are all integers as printed by "%lld", which are then
+// in pstate->ints.
+static int lrec_writer_col_scan_ints(lrec_writer_col_state_t* pstate, int num_rows) {
+	for (int r = 0; r < num_rows; r++)
+		if (!mlr_bin_is_canonical_int(pstate->cursors[r]->value, &pstate->ints[r]))
+			return FALSE;
+	return TRUE;
+}
+
+// True if the column's values at the cursors are all fixed-point decimals, or integers which doubles
+// hold exactly, which reading back will reproduce. They're then in pstate->doubles and
+// pstate->decimals.
+static int lrec_writer_col_scan_floats(lrec_writer_col_state_t* pstate, int num_rows) {
+	for (int r = 0; r < num_rows; r++) {
+		char* value = pstate->cursors[r]->value;
+		long long int_value;
+		int decimals;
+		if (mlr_bin_is_canonical_int(value, &int_value)) {
+			if (int_value > MLR_COL_MAX_EXACT_INT || int_value < -MLR_COL_MAX_EXACT_INT)
+				return FALSE;
+			pstate->doubles[r] = (double)int_value;
+			pstate->decimals[r] = 0;
+		} else if (mlr_bin_is_exact_decimal(value, strlen(value), &pstate->doubles[r], &decimals)) {
+			pstate->decimals[r] = decimals;
+		} else {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+static void buffer_ensure(col_buffer_t* pbuffer, size_t more) {
+	if (pbuffer->length + more > pbuffer->capacity) {
+		while (pbuffer->length + more > pbuffer->capacity)
+			pbuffer->capacity *= 2;
+		pbuffer->bytes = mlr_realloc_or_die(pbuffer->bytes, pbuffer->capacity);
+	}
+}
+
+static void buffer_put_varint(col_buffer_t* pbuffer, unsigned long long value) {
+	buffer_ensure(pbuffer, 10);
+	pbuffer->length += mlr_bin_put_varint(&pbuffer->bytes[pbuffer->length], value);
+}
+
+static void buffer_put_string(col_buffer_t* pbuffer, char* s, size_t length) {
+	buffer_ensure(pbuffer, 10 + length + 1);
+	unsigned char* p = &pbuffer->bytes[pbuffer->length];
+	p += mlr_bin_put_varint(p, length);
+	memcpy(p, s, length + 1);
+	pbuffer->length = p + length + 1 - pbuffer->bytes;
+}
+
+static void buffer_put_double(col_buffer_t* pbuffer, double value) {
+	buffer_ensure(pbuffer, 8);
+	mlr_bin_put_double(&pbuffer->bytes[pbuffer->length], value);
+	pbuffer->length += 8;
+}
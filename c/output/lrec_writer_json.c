@@ -1,9 +1,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include "lib/mlrutil.h"
+#include "lib/string_builder.h"
 #include "containers/mlhmmv.h"
+#include "containers/lhmslv.h"
+#include "containers/mixutil.h"
 #include "output/lrec_writers.h"
 
+// ----------------------------------------------------------------
+// Miller-to-JSON key deconcatenation (e.g. 'a:x=1,a:y=2' maps to '{"a":{"x":1,"y":2}}') and key escaping
+// depend only on the record's field names, not on its values. So for each distinct field-name list
+// ("schema") we compute once an output plan: the JSON text is an alternation of pre-encoded literal
+// segments (braces, escaped keys, separators, indentation) and field values. Per record we then only need
+// to print the literals and format the values.
+//
+// The plan is computed by inserting the field names into an mlhmmv exactly as is done for emitting
+// out-of-stream variables, with the field's position in the record as terminal value. Hence key-collision
+// and ordering semantics are the same as for the mlhmmv JSON printer.
+
+#define JSON_WRITER_PLAN_CACHE_MAX_SIZE 1000
+
+typedef struct _json_writer_plan_t {
+	slls_t* pfield_names;
+	int     num_fields;
+	char*   line_term;
+	int     num_values;     // Number of value slots; there are num_values+1 literal segments.
+	char**  literals;
+	int*    field_indices;  // Index into the record's field list for each value slot.
+} json_writer_plan_t;
+
 typedef struct _lrec_writer_json_state_t {
 	unsigned long long counter;
 	char* output_json_flatten_separator;
@@ -17,6 +42,11 @@ typedef struct _lrec_writer_json_state_t {
 	char* line_term;
 	int stack_vertically;
 
+	lhmslv_t*           pplans_by_field_names;
+	json_writer_plan_t* plast_plan;
+	char**              values;
+	int                 values_length;
+
 } lrec_writer_json_state_t;
 
 static void lrec_writer_json_free(lrec_writer_t* pwriter, context_t* pctx);
@@ -31,6 +61,14 @@ static void lrec_writer_json_process_nonauto_line_term_wrap(void* pvstate, FILE*
 static void lrec_writer_json_process_nonauto_line_term_no_wrap(void* pvstate, FILE* output_stream, lrec_t* prec,
 	context_t* pctx);
 
+static json_writer_plan_t* json_writer_plan_get(lrec_writer_json_state_t* pstate, lrec_t* prec, char* line_term);
+static json_writer_plan_t* json_writer_plan_alloc(lrec_writer_json_state_t* pstate, lrec_t* prec,
+	slls_t* pfield_names, char* line_term);
+static void json_writer_plan_free(json_writer_plan_t* pplan);
+static void json_writer_plan_cache_clear(lrec_writer_json_state_t* pstate);
+static void json_writer_print_value_stacked(FILE* output_stream, char* value, int quote_values_always);
+static void json_writer_print_value_single_line(FILE* output_stream, char* value, int quote_values_always);
+
 // ----------------------------------------------------------------
 lrec_writer_t* lrec_writer_json_alloc(int stack_vertically, int wrap_json_output_in_outer_list,
 	int json_quote_int_keys, int json_quote_non_string_values, char* output_json_flatten_separator, char* line_term)
@@ -53,6 +91,11 @@ lrec_writer_t* lrec_writer_json_alloc(int stack_vertically, int wrap_json_output
 	pstate->line_term                             = line_term;
 	pstate->stack_vertically                      = stack_vertically;
 
+	pstate->pplans_by_field_names = lhmslv_alloc();
+	pstate->plast_plan            = NULL;
+	pstate->values_length         = 32;
+	pstate->values                = mlr_malloc_or_die(pstate->values_length * sizeof(char*));
+
 	plrec_writer->pvstate = (void*)pstate;
 	if (streq(line_term, "auto")) {
 		plrec_writer->pprocess_func = wrap_json_output_in_outer_list
@@ -69,7 +112,13 @@ lrec_writer_t* lrec_writer_json_alloc(int stack_vertically, int wrap_json_output
 }
 
 static void lrec_writer_json_free(lrec_writer_t* pwriter, context_t* pctx) {
-	free(pwriter->pvstate);
+	lrec_writer_json_state_t* pstate = pwriter->pvstate;
+	// lhmslv_free doesn't free the void-star hashmap values; the plans own their keys.
+	for (lhmslve_t* pe = pstate->pplans_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		json_writer_plan_free(pe->pvvalue);
+	lhmslv_free(pstate->pplans_by_field_names);
+	free(pstate->values);
+	free(pstate);
 	free(pwriter);
 }
 
@@ -112,40 +161,26 @@ static void lrec_writer_json_process(void* pvstate, FILE* output_stream, lrec_t*
 			fputs(pstate->between_records_after_start_of_stream, output_stream);
 		}
 
-		// Use the mlhmmv printer since it naturally handles Miller-to-JSON key deconcatenation:
-		// e.g. 'a:x=1,a:y=2' maps to '{"a":{"x":1,"y":2}}'.
-		mlhmmv_root_t* pmap = mlhmmv_root_alloc();
-
-		char* sep = pstate->output_json_flatten_separator;
-		int seplen = strlen(sep);
-
-		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
-			// strdup since strmsep is destructive and CSV/PPRINT header fields
-			// are shared across multiple records
-			char* lkey = mlr_strdup_or_die(pe->key);
-			char* lvalue = pe->value;
-
-			sllmv_t* pmvkeys = sllmv_alloc();
-			char* walker = lkey;
-			char* piece = NULL;
-			while ((piece = mlr_strmsep(&walker, sep, seplen)) != NULL) {
-				mv_t mvkey = mv_from_string(piece, NO_FREE);
-				sllmv_append_no_free(pmvkeys, &mvkey);
-			}
-			mv_t mvval = mv_from_string(lvalue, NO_FREE);
-			mlhmmv_root_put_terminal(pmap, pmvkeys, &mvval);
-			sllmv_free(pmvkeys);
-			free(lkey);
-		}
+		json_writer_plan_t* pplan = json_writer_plan_get(pstate, prec, line_term);
 
-		if (pstate->stack_vertically)
-			mlhmmv_root_print_json_stacked(pmap, pstate->json_quote_int_keys, pstate->json_quote_non_string_values,
-				pstate->line_indent, line_term, output_stream);
-		else
-			mlhmmv_root_print_json_single_lines(pmap, pstate->json_quote_int_keys,
-				pstate->json_quote_non_string_values, line_term, output_stream);
+		if (pplan->num_fields > pstate->values_length) {
+			pstate->values_length = pplan->num_fields;
+			pstate->values = mlr_realloc_or_die(pstate->values, pstate->values_length * sizeof(char*));
+		}
+		int i = 0;
+		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext)
+			pstate->values[i++] = pe->value;
 
-		mlhmmv_root_free(pmap);
+		for (i = 0; i < pplan->num_values; i++) {
+			fputs(pplan->literals[i], output_stream);
+			if (pstate->stack_vertically)
+				json_writer_print_value_stacked(output_stream, pstate->values[pplan->field_indices[i]],
+					pstate->json_quote_non_string_values);
+			else
+				json_writer_print_value_single_line(output_stream, pstate->values[pplan->field_indices[i]],
+					pstate->json_quote_non_string_values);
+		}
+		fputs(pplan->literals[pplan->num_values], output_stream);
 
 		lrec_free(prec); // end of baton-pass
 
@@ -154,3 +189,244 @@ static void lrec_writer_json_process(void* pvstate, FILE* output_stream, lrec_t*
 		fputs(before_or_after_records, output_stream);
 	}
 }
+
+// ----------------------------------------------------------------
+// For homogeneous record streams the last-used plan is checked first, without any hashing or allocation.
+static json_writer_plan_t* json_writer_plan_get(lrec_writer_json_state_t* pstate, lrec_t* prec, char* line_term) {
+	json_writer_plan_t* pplan = pstate->plast_plan;
+	if (pplan != NULL && pplan->num_fields == prec->field_count && streq(pplan->line_term, line_term)) {
+		sllse_t* pf = pplan->pfield_names->phead;
+		lrece_t* pe = prec->phead;
+		for ( ; pe != NULL; pe = pe->pnext, pf = pf->pnext)
+			if (!streq(pe->key, pf->value))
+				break;
+		if (pe == NULL)
+			return pplan;
+	}
+
+	slls_t* pfield_names = mlr_reference_keys_from_record(prec);
+	pplan = lhmslv_get(pstate->pplans_by_field_names, pfield_names);
+	if (pplan == NULL || !streq(pplan->line_term, line_term)) {
+		// Bound the memory used for heterogeneous record streams.
+		if (pplan != NULL || lhmslv_size(pstate->pplans_by_field_names) >= JSON_WRITER_PLAN_CACHE_MAX_SIZE)
+			json_writer_plan_cache_clear(pstate);
+		pplan = json_writer_plan_alloc(pstate, prec, pfield_names, line_term);
+		lhmslv_put(pstate->pplans_by_field_names, pplan->pfield_names, pplan, NO_FREE);
+	}
+	slls_free(pfield_names);
+
+	pstate->plast_plan = pplan;
+	return pplan;
+}
+
+// ----------------------------------------------------------------
+static void json_writer_plan_cache_clear(lrec_writer_json_state_t* pstate) {
+	for (lhmslve_t* pe = pstate->pplans_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		json_writer_plan_free(pe->pvvalue);
+	lhmslv_free(pstate->pplans_by_field_names);
+	pstate->pplans_by_field_names = lhmslv_alloc();
+	pstate->plast_plan = NULL;
+}
+
+static void json_writer_plan_free(json_writer_plan_t* pplan) {
+	for (int i = 0; i <= pplan->num_values; i++)
+		free(pplan->literals[i]);
+	free(pplan->literals);
+	free(pplan->field_indices);
+	free(pplan->line_term);
+	slls_free(pplan->pfield_names);
+	free(pplan);
+}
+
+// ----------------------------------------------------------------
+// Plan construction. These mirror mlhmmv_level_print_stacked and mlhmmv_level_print_single_line, except that
+// text is accumulated into the current literal segment and terminal values are recorded as value slots.
+
+typedef struct _json_writer_plan_builder_t {
+	string_builder_t* psb;
+	sllv_t*           pliterals;
+	int               num_values;
+	int*              field_indices;
+	int               field_indices_length;
+} json_writer_plan_builder_t;
+
+static void plan_builder_append_escaped(json_writer_plan_builder_t* pbuilder, char* s) {
+	string_builder_t* psb = pbuilder->psb;
+	sb_append_char(psb, '"');
+	for (char* p = s; *p; p++) {
+		switch (*p) {
+		case '"':  sb_append_char(psb, '\\'); sb_append_char(psb, '"');  break;
+		case '\\': sb_append_char(psb, '\\'); sb_append_char(psb, '\\'); break;
+		case '\n': sb_append_char(psb, '\\'); sb_append_char(psb, 'n');  break;
+		case '\r': sb_append_char(psb, '\\'); sb_append_char(psb, 'r');  break;
+		case '\t': sb_append_char(psb, '\\'); sb_append_char(psb, 't');  break;
+		case '\b': sb_append_char(psb, '\\'); sb_append_char(psb, 'b');  break;
+		case '\f': sb_append_char(psb, '\\'); sb_append_char(psb, 'f');  break;
+		default:   sb_append_char(psb, *p); break;
+		}
+	}
+	sb_append_char(psb, '"');
+}
+
+static void plan_builder_append_value_slot(json_writer_plan_builder_t* pbuilder, int field_index) {
+	char* literal = sb_finish(pbuilder->psb);
+	sllv_append(pbuilder->pliterals, literal);
+	if (pbuilder->num_values >= pbuilder->field_indices_length) {
+		pbuilder->field_indices_length *= 2;
+		pbuilder->field_indices = mlr_realloc_or_die(pbuilder->field_indices,
+			pbuilder->field_indices_length * sizeof(int));
+	}
+	pbuilder->field_indices[pbuilder->num_values++] = field_index;
+}
+
+static void plan_builder_append_level_stacked(json_writer_plan_builder_t* pbuilder, mlhmmv_level_t* plevel,
+	int depth, int do_final_comma, char* line_indent, char* line_term)
+{
+	string_builder_t* psb = pbuilder->psb;
+	static char* leader = "  ";
+	if (depth == 0) {
+		sb_append_string(psb, line_indent);
+		sb_append_char(psb, '{');
+		sb_append_string(psb, line_term);
+	}
+	for (mlhmmv_level_entry_t* pentry = plevel->phead; pentry != NULL; pentry = pentry->pnext) {
+		sb_append_string(psb, line_indent);
+		for (int i = 0; i <= depth; i++)
+			sb_append_string(psb, leader);
+		plan_builder_append_escaped(pbuilder, pentry->level_key.u.strv);
+		sb_append_string(psb, ": ");
+
+		if (pentry->level_xvalue.is_terminal) {
+			plan_builder_append_value_slot(pbuilder, pentry->level_xvalue.terminal_mlrval.u.intv);
+			if (pentry->pnext != NULL)
+				sb_append_char(psb, ',');
+			sb_append_string(psb, line_term);
+		} else {
+			sb_append_string(psb, line_indent);
+			sb_append_char(psb, '{');
+			sb_append_string(psb, line_term);
+			plan_builder_append_level_stacked(pbuilder, pentry->level_xvalue.pnext_level, depth + 1,
+				pentry->pnext != NULL, line_indent, line_term);
+		}
+	}
+	for (int i = 0; i < depth; i++)
+		sb_append_string(psb, leader);
+	sb_append_string(psb, line_indent);
+	sb_append_char(psb, '}');
+	if (do_final_comma)
+		sb_append_char(psb, ',');
+	sb_append_string(psb, line_term);
+}
+
+static void plan_builder_append_level_single_line(json_writer_plan_builder_t* pbuilder, mlhmmv_level_t* plevel,
+	int depth, int do_final_comma)
+{
+	string_builder_t* psb = pbuilder->psb;
+	if (depth == 0)
+		sb_append_string(psb, "{ ");
+	for (mlhmmv_level_entry_t* pentry = plevel->phead; pentry != NULL; pentry = pentry->pnext) {
+		plan_builder_append_escaped(pbuilder, pentry->level_key.u.strv);
+		sb_append_string(psb, ": ");
+
+		if (pentry->level_xvalue.is_terminal) {
+			plan_builder_append_value_slot(pbuilder, pentry->level_xvalue.terminal_mlrval.u.intv);
+			if (pentry->pnext != NULL)
+				sb_append_string(psb, ", ");
+		} else {
+			sb_append_char(psb, '{');
+			plan_builder_append_level_single_line(pbuilder, pentry->level_xvalue.pnext_level, depth + 1,
+				pentry->pnext != NULL);
+		}
+	}
+	sb_append_string(psb, do_final_comma ? " }," : " }");
+}
+
+static json_writer_plan_t* json_writer_plan_alloc(lrec_writer_json_state_t* pstate, lrec_t* prec,
+	slls_t* pfield_names, char* line_term)
+{
+	char* sep = pstate->output_json_flatten_separator;
+	int seplen = strlen(sep);
+
+	mlhmmv_root_t* pmap = mlhmmv_root_alloc();
+	int field_index = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, field_index++) {
+		// strdup since strmsep is destructive
+		char* lkey = mlr_strdup_or_die(pe->key);
+		sllmv_t* pmvkeys = sllmv_alloc();
+		char* walker = lkey;
+		char* piece = NULL;
+		while ((piece = mlr_strmsep(&walker, sep, seplen)) != NULL) {
+			mv_t mvkey = mv_from_string(piece, NO_FREE);
+			sllmv_append_no_free(pmvkeys, &mvkey);
+		}
+		mv_t mvval = mv_from_int(field_index);
+		mlhmmv_root_put_terminal(pmap, pmvkeys, &mvval);
+		sllmv_free(pmvkeys);
+		free(lkey);
+	}
+
+	json_writer_plan_builder_t builder;
+	builder.psb                  = sb_alloc(1024);
+	builder.pliterals            = sllv_alloc();
+	builder.num_values           = 0;
+	builder.field_indices_length = 16;
+	builder.field_indices        = mlr_malloc_or_die(builder.field_indices_length * sizeof(int));
+
+	if (pstate->stack_vertically) {
+		plan_builder_append_level_stacked(&builder, pmap->root_xvalue.pnext_level, 0, FALSE,
+			pstate->line_indent, line_term);
+	} else {
+		plan_builder_append_level_single_line(&builder, pmap->root_xvalue.pnext_level, 0, FALSE);
+		sb_append_string(builder.psb, line_term);
+	}
+	char* last_literal = sb_finish(builder.psb);
+	sllv_append(builder.pliterals, last_literal);
+	sb_free(builder.psb);
+	mlhmmv_root_free(pmap);
+
+	json_writer_plan_t* pplan = mlr_malloc_or_die(sizeof(json_writer_plan_t));
+	pplan->pfield_names  = slls_copy(pfield_names);
+	pplan->num_fields    = field_index;
+	pplan->line_term     = mlr_strdup_or_die(line_term);
+	pplan->num_values    = builder.num_values;
+	pplan->field_indices = builder.field_indices;
+	pplan->literals      = mlr_malloc_or_die(builder.pliterals->length * sizeof(char*));
+	int i = 0;
+	for (sllve_t* pe = builder.pliterals->phead; pe != NULL; pe = pe->pnext)
+		pplan->literals[i++] = pe->pvvalue;
+	sllv_free(builder.pliterals);
+
+	return pplan;
+}
+
+// ----------------------------------------------------------------
+// Values are formatted as by mlhmmv_print_terminal and mlhmmv_level_print_single_line, respectively. All
+// record values are strings, so type inference is from the string contents.
+
+static void json_writer_print_value_stacked(FILE* output_stream, char* value, int quote_values_always) {
+	double unused;
+	if (quote_values_always) {
+		json_print_string_escaped(output_stream, value);
+	} else if (mlr_try_float_from_string(value, &unused)) {
+		json_decimal_print(output_stream, value);
+	} else if (streq(value, "true") || streq(value, "false")) {
+		fputs(value, output_stream);
+	} else {
+		json_print_string_escaped(output_stream, value);
+	}
+}
+
+static void json_writer_print_value_single_line(FILE* output_stream, char* value, int quote_values_always) {
+	double unused;
+	if (quote_values_always) {
+		fputc('"', output_stream);
+		fputs(value, output_stream);
+		fputc('"', output_stream);
+	} else if (mlr_try_float_from_string(value, &unused)) {
+		fputs(value, output_stream);
+	} else if (streq(value, "true") || streq(value, "false")) {
+		fputs(value, output_stream);
+	} else {
+		json_print_string_escaped(output_stream, value);
+	}
+}
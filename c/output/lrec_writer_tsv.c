@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "containers/mixutil.h"
+#include "lib/mlrutil.h"
+#include "output/lrec_writers.h"
+
+// ----------------------------------------------------------------
+// Like the CSV-lite writer, but tabs, newlines, and carriage returns within
+// keys and values are written as the two-character sequences "\t", "\n", and
+// "\r" so that each record stays on a single line. A backslash is written as
+// "\\" only when it would otherwise be read back as the start of one of those
+// sequences, when it precedes a tab, newline, or carriage return (which is
+// about to be written as one), or when it ends the key or value; all other
+// backslashes (e.g. Windows paths) are passed through, so that TSV-to-TSV
+// processing leaves them unchanged.
+//
+// There is no escape for an empty string: a record whose only field has an
+// empty value is written as a blank line, which TSV input takes as a schema
+// change, so such records don't survive a round trip.
+// ----------------------------------------------------------------
+
+typedef struct _lrec_writer_tsv_state_t {
+	int   onr;
+	char* ors;
+	char* ofs;
+	long long num_header_lines_output;
+	slls_t* plast_header_output;
+	int headerless_csv_output;
+} lrec_writer_tsv_state_t;
+
+static void lrec_writer_tsv_free(lrec_writer_t* pwriter, context_t* pctx);
+static void lrec_writer_tsv_process(void* pvstate, FILE* output_stream, lrec_t* prec, char* ors);
+static void lrec_writer_tsv_process_auto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static void lrec_writer_tsv_process_nonauto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static void tsv_fputs_escaped(char* s, FILE* output_stream);
+
+// ----------------------------------------------------------------
+lrec_writer_t* lrec_writer_tsv_alloc(char* ors, char* ofs, int headerless_csv_output) {
+	lrec_writer_t* plrec_writer = mlr_malloc_or_die(sizeof(lrec_writer_t));
+
+	lrec_writer_tsv_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_tsv_state_t));
+	pstate->onr                     = 0;
+	pstate->ors                     = ors;
+	pstate->ofs                     = ofs;
+	pstate->num_header_lines_output = 0LL;
+	pstate->plast_header_output     = NULL;
+	pstate->headerless_csv_output   = headerless_csv_output;
+
+	plrec_writer->pvstate       = (void*)pstate;
+	plrec_writer->pprocess_func = streq(ors, "auto")
+		? lrec_writer_tsv_process_auto_ors
+		: lrec_writer_tsv_process_nonauto_ors;
+	plrec_writer->pfree_func    = lrec_writer_tsv_free;
+
+	return plrec_writer;
+}
+
+static void lrec_writer_tsv_free(lrec_writer_t* pwriter, context_t* pctx) {
+	lrec_writer_tsv_state_t* pstate = pwriter->pvstate;
+	slls_free(pstate->plast_header_output);
+	free(pstate);
+	free(pwriter);
+}
+
+// ----------------------------------------------------------------
+static void lrec_writer_tsv_process_auto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx) {
+	lrec_writer_tsv_process(pvstate, output_stream, prec, pctx->auto_line_term);
+}
+
+static void lrec_writer_tsv_process_nonauto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx) {
+	lrec_writer_tsv_state_t* pstate = pvstate;
+	lrec_writer_tsv_process(pvstate, output_stream, prec, pstate->ors);
+}
+
+static void lrec_writer_tsv_process(void* pvstate, FILE* output_stream, lrec_t* prec, char* ors) {
+	if (prec == NULL)
+		return;
+	lrec_writer_tsv_state_t* pstate = pvstate;
+	char* ofs = pstate->ofs;
+
+	if (pstate->plast_header_output != NULL) {
+		if (!lrec_keys_equal_list(prec, pstate->plast_header_output)) {
+			slls_free(pstate->plast_header_output);
+			pstate->plast_header_output = NULL;
+			if (pstate->num_header_lines_output > 0LL)
+				fputs(ors, output_stream);
+		}
+	}
+
+	if (pstate->plast_header_output == NULL) {
+		if (!pstate->headerless_csv_output) {
+			int nf = 0;
+			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+				if (nf > 0)
+					fputs(ofs, output_stream);
+				tsv_fputs_escaped(pe->key, output_stream);
+				nf++;
+			}
+			fputs(ors, output_stream);
+		}
+		pstate->plast_header_output = mlr_copy_keys_from_record(prec);
+		pstate->num_header_lines_output++;
+	}
+
+	int nf = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+		if (nf > 0)
+			fputs(ofs, output_stream);
+		tsv_fputs_escaped(pe->value, output_stream);
+		nf++;
+	}
+	fputs(ors, output_stream);
+	pstate->onr++;
+
+	lrec_free(prec); // end of baton-pass
+}
+
+// ----------------------------------------------------------------
+static void tsv_fputs_escaped(char* s, FILE* output_stream) {
+	size_t n = strcspn(s, "\t\n\r\\");
+	if (s[n] == 0) {
+		fputs(s, output_stream);
+		return;
+	}
+	fwrite(s, 1, n, output_stream);
+	for (char* p = &s[n]; *p; p++) {
+		switch (*p) {
+		case '\t': fputs("\\t", output_stream); break;
+		case '\n': fputs("\\n", output_stream); break;
+		case '\r': fputs("\\r", output_stream); break;
+		case '\\':
+			switch (p[1]) {
+			case 't': case 'n': case 'r': case '\\':
+			case '\t': case '\n': case '\r': case 0:
+				fputs("\\\\", output_stream);
+				break;
+			default:
+				fputc('\\', output_stream);
+				break;
+			}
+			break;
+		default:
+			fputc(*p, output_stream);
+			break;
+		}
+	}
+}
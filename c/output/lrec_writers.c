@@ -18,6 +18,9 @@ lrec_writer_t*  lrec_writer_alloc(cli_writer_opts_t* popts) {
 	} else if (streq(popts->ofile_fmt, "csvlite")) {
 		return lrec_writer_csvlite_alloc(popts->ors, popts->ofs, popts->headerless_csv_output);
 
+	} else if (streq(popts->ofile_fmt, "tsv")) {
+		return lrec_writer_tsv_alloc(popts->ors, popts->ofs, popts->headerless_csv_output);
+
 	} else if (streq(popts->ofile_fmt, "markdown")) {
 		return lrec_writer_markdown_alloc(popts->ors);
 
@@ -27,6 +30,12 @@ lrec_writer_t*  lrec_writer_alloc(cli_writer_opts_t* popts) {
 	} else if (streq(popts->ofile_fmt, "xtab")) {
 		return lrec_writer_xtab_alloc(popts->ofs, popts->ops, popts->right_justify_xtab_value);
 
+	} else if (streq(popts->ofile_fmt, "bin")) {
+		return lrec_writer_bin_alloc(popts->write_typed_bin_numbers);
+
+	} else if (streq(popts->ofile_fmt, "col")) {
+		return lrec_writer_col_alloc();
+
 	} else if (streq(popts->ofile_fmt, "pprint")) {
 		if (strlen(popts->ofs) != 1) {
 			fprintf(stderr, "%s: OFS for PPRINT format must be single-character; got \"%s\".\n",
@@ -12,6 +12,7 @@ lrec_writer_t*  lrec_writer_alloc_or_die(cli_writer_opts_t* popts);
 
 lrec_writer_t* lrec_writer_csv_alloc(char* ors, char* ofs, quoting_t oquoting, int headerless_csv_output);
 lrec_writer_t* lrec_writer_csvlite_alloc(char* ors, char* ofs, int headerless_csv_output);
+lrec_writer_t* lrec_writer_tsv_alloc(char* ors, char* ofs, int headerless_csv_output);
 lrec_writer_t* lrec_writer_markdown_alloc(char* ors);
 lrec_writer_t* lrec_writer_dkvp_alloc(char* ors, char* ofs, char* ops);
 lrec_writer_t* lrec_writer_json_alloc(int stack_vertically, int wrap_json_output_in_outer_list,
@@ -19,6 +20,8 @@ lrec_writer_t* lrec_writer_json_alloc(int stack_vertically, int wrap_json_output
 lrec_writer_t* lrec_writer_nidx_alloc(char* ors, char* ofs);
 lrec_writer_t* lrec_writer_pprint_alloc(char* ors, char ofs, int right_align, int barred);
 lrec_writer_t* lrec_writer_xtab_alloc(char* ofs, char* ops, int right_justify_value);
+lrec_writer_t* lrec_writer_bin_alloc(int write_typed_numbers);
+lrec_writer_t* lrec_writer_col_alloc();
 
 // Pops and frees the lrecs in the argument list without sllv-freeing the list structure itself.
 void lrec_writer_print_all(lrec_writer_t* pwriter, FILE* fp, sllv_t* poutrecs, context_t* pctx);
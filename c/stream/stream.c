@@ -1,12 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
 #include "input/lrec_readers.h"
+#include "input/lrec_index.h"
+#include "input/line_readers.h"
+#include "input/file_reader_stdio.h"
 #include "mapping/mappers.h"
 #include "output/lrec_writers.h"
 
@@ -14,6 +18,25 @@ static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts);
 static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cli_opts_t* popts);
 
 static int do_file_chained(char* filename, context_t* pctx,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	lrec_reader_count_sink_t* pcount_sink, long long tail_count, lrec_reader_span_sink_t* pspan_sink,
+	cli_opts_t* popts);
+
+static void drive_spans(context_t* pctx, lrec_reader_span_sink_t* pspan_sink, int base_filenum,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	cli_opts_t* popts);
+
+static void get_byte_range(long long file_size, cli_opts_t* popts, long long* pstart, long long* pend);
+static char* get_byte_range_irs(cli_opts_t* popts);
+static void seek_byte_range_mmap(lrec_reader_t* plrec_reader, void* pvhandle, context_t* pctx, cli_opts_t* popts);
+static char* alloc_byte_range_temp_file(char* filename, cli_opts_t* popts);
+
+static lrec_index_t** load_indexes(lrec_reader_t* plrec_reader, cli_opts_t* popts);
+static int do_files_indexed(context_t* pctx, lrec_index_t** indexes,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	cli_opts_t* popts);
+static void do_file_indexed(char* filename, lrec_index_t* pindex, long long base,
+	lrec_reader_record_range_t* ranges, int num_ranges, context_t* pctx,
 	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
 	cli_opts_t* popts);
 
@@ -22,6 +45,9 @@ static sllv_t* chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_
 static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer,
 	FILE* output_stream);
 
+// With late materialization, the memory behind the input read so far is given back every so often.
+#define SPAN_RELEASE_BYTES (1LL << 24)
+
 typedef void progress_indicator_t(context_t* pctx, long long nr_progress_mod);
 static void null_progress_indicator(context_t* pctx, long long nr_progress_mod);
 static void stderr_progress_indicator(context_t* pctx, long long nr_progress_mod);
@@ -64,7 +90,7 @@ static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts) {
 
 		int argi = popts->mapper_argb;
 		int unused;
-		sllv_t* pmapper_list = cli_parse_mappers(popts->argv, &argi, popts->argc, popts, &unused);
+		sllv_t* pmapper_list = cli_parse_mappers(popts->argv, &argi, popts->argc, popts, &unused, NULL);
 		MLR_INTERNAL_CODING_ERROR_IF(pmapper_list->length < 1); // Should not have been allowed by the CLI parser.
 
 		char* filename = pe->value;
@@ -82,7 +108,7 @@ static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts) {
 		pctx->fnr = 0;
 
 		ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, plrec_writer,
-			output_stream, popts) && ok;
+			output_stream, NULL, -1LL, NULL, popts) && ok;
 
 		// For in-place mode, there's no breaking from the loop over input files. Just an early
 		// return from the mapper chain, which has already just happened.
@@ -123,16 +149,64 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 	MLR_INTERNAL_CODING_ERROR_IF(pmapper_list->length < 1); // Should not have been allowed by the CLI parser.
 
+	if (popts->do_build_index && plrec_reader->ptell_func == NULL) {
+		fprintf(stderr, "%s: --build-index is not supported for input format \"%s\".\n",
+			MLR_GLOBALS.bargv0, popts->reader_opts.ifile_fmt);
+		exit(1);
+	}
+
+	// Record-boundaries-only reading, if the chain's first mapper needs only record counts and the reader
+	// can provide them. Not with the progress indicator, which wants to see each record go by, nor when
+	// building indexes, which want to see where each record starts.
+	lrec_reader_count_sink_t* pcount_sink = NULL;
+	if (plrec_reader->pcount_func != NULL && popts->nr_progress_mod == 0LL && !popts->do_build_index)
+		pcount_sink = popts->reader_opts.precord_count_sink;
+
+	// Tail reading, if the chain is just a mapper needing the last records of each file, and the reader can
+	// find them from the end. Only then, since records skipped aren't counted in NR and FNR. Not with the
+	// progress indicator, nor when building indexes, nor with comments passed through, as above.
+	long long tail_count = -1LL;
+	if (plrec_reader->pseek_tail_func != NULL && pmapper_list->length == 1 && popts->nr_progress_mod == 0LL
+		&& !popts->do_build_index && popts->reader_opts.comment_handling != PASS_COMMENTS)
+	{
+		tail_count = popts->reader_opts.input_tail_count;
+	}
+
+	lrec_index_t** indexes = load_indexes(plrec_reader, popts);
+
+	// Late materialization, if the chain's first mapper only reorders whole records and the reader can read
+	// records again from where they were in their files. A second reader then reads just the fields the
+	// mapper needs, and the first reads the records again at end of stream. Not for standard input, nor
+	// with comments passed through, which reading again would repeat.
+	lrec_reader_span_sink_t* pspan_sink = NULL;
+	lrec_reader_t* pspan_reader = NULL;
+	hss_t* pspan_projection = NULL;
+	int base_filenum = pctx->filenum;
+	if (plrec_reader->preread_func != NULL && popts->reader_opts.pspan_sink != NULL && indexes == NULL
+		&& popts->filenames != NULL && popts->filenames->length > 0
+		&& popts->reader_opts.comment_handling != PASS_COMMENTS)
+	{
+		pspan_sink = popts->reader_opts.pspan_sink;
+		pspan_projection = hss_alloc();
+		for (sllse_t* pe = pspan_sink->pfield_names->phead; pe != NULL; pe = pe->pnext)
+			hss_add(pspan_projection, pe->value);
+		cli_reader_opts_t span_reader_opts = popts->reader_opts;
+		span_reader_opts.pfield_projection = pspan_projection;
+		pspan_reader = lrec_reader_alloc_or_die(&span_reader_opts);
+	}
+
 	int ok = 1;
 	if (popts->filenames == NULL) {
 		// No input at all
+	} else if (indexes != NULL) {
+		ok = do_files_indexed(pctx, indexes, plrec_reader, pmapper_list, plrec_writer, output_stream, popts);
 	} else if (popts->filenames->length == 0) {
 		// Zero file names means read from standard input
 		pctx->filenum++;
 		pctx->filename = "(stdin)";
 		pctx->fnr = 0;
 		ok = do_file_chained("-", pctx, plrec_reader, pmapper_list, plrec_writer,
-			output_stream, popts) && ok;
+			output_stream, pcount_sink, -1LL, NULL, popts) && ok;
 	} else {
 		// Read from each file name in turn
 		for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext) {
@@ -140,8 +214,8 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 			pctx->filenum++;
 			pctx->filename = filename;
 			pctx->fnr = 0;
-			ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, plrec_writer,
-				output_stream, popts) && ok;
+			ok = do_file_chained(filename, pctx, (pspan_reader != NULL) ? pspan_reader : plrec_reader,
+				pmapper_list, plrec_writer, output_stream, pcount_sink, tail_count, pspan_sink, popts) && ok;
 			if (pctx->force_eof == TRUE) // e.g. mlr head
 				break;
 		}
@@ -149,23 +223,52 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 	// Mappers and writers receive end-of-stream notifications via null input record.
 	// Do that, now that data from all input file(s) have been exhausted.
-	drive_lrec(NULL, pctx, pmapper_list->phead, plrec_writer, output_stream);
+	if (pspan_sink != NULL)
+		drive_spans(pctx, pspan_sink, base_filenum, plrec_reader, pmapper_list, plrec_writer, output_stream, popts);
+	else
+		drive_lrec(NULL, pctx, pmapper_list->phead, plrec_writer, output_stream);
 
 	// Drain the pretty-printer.
 	plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, NULL, pctx);
 
 	plrec_reader->pfree_func(plrec_reader);
 	plrec_writer->pfree_func(plrec_writer, pctx);
+	if (pspan_reader != NULL) {
+		pspan_reader->pfree_func(pspan_reader);
+		hss_free(pspan_projection);
+	}
+
+	if (indexes != NULL) {
+		for (int i = 0; i < popts->filenames->length; i++)
+			lrec_index_free(indexes[i]);
+		free(indexes);
+	}
 
 	return ok;
 }
 
 // ----------------------------------------------------------------
+// With a count sink, the reader counts the file's records without building them, and the count goes to the
+// sink in place of the records. With a tail count other than -1, the reader skips ahead to the file's last
+// so many records if it can. With a span sink, the records go there along with where each was in the file,
+// in place of going to the mapper chain.
 static int do_file_chained(char* filename, context_t* pctx,
 	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	lrec_reader_count_sink_t* pcount_sink, long long tail_count, lrec_reader_span_sink_t* pspan_sink,
 	cli_opts_t* popts)
 {
-	void* pvhandle = plrec_reader->popen_func(plrec_reader->pvstate, popts->reader_opts.prepipe, filename);
+	// Byte-range reading: mmap readers, which can seek, skip ahead to the range's first record and stop after
+	// its last. Stdio readers read a temp-file copy of those records, after the header line if any.
+	char* prepipe = popts->reader_opts.prepipe;
+	int do_byte_range = popts->byte_range_start >= 0LL || popts->num_shards > 0LL;
+	char* byte_range_temp_file = NULL;
+	if (do_byte_range && plrec_reader->pseek_func == NULL) {
+		byte_range_temp_file = alloc_byte_range_temp_file(filename, popts);
+		filename = byte_range_temp_file;
+		prepipe = NULL;
+	}
+
+	void* pvhandle = plrec_reader->popen_func(plrec_reader->pvstate, prepipe, filename);
 	progress_indicator_t* pindicator = popts->nr_progress_mod == 0LL
 		? null_progress_indicator
 		: stderr_progress_indicator;
@@ -173,7 +276,46 @@ static int do_file_chained(char* filename, context_t* pctx,
 	// Start-of-file hook, e.g. expecting CSV headers on input.
 	plrec_reader->psof_func(plrec_reader->pvstate, pvhandle);
 
+	if (do_byte_range && byte_range_temp_file == NULL)
+		seek_byte_range_mmap(plrec_reader, pvhandle, pctx, popts);
+
+	if (pcount_sink != NULL) {
+		long long record_count = plrec_reader->pcount_func(plrec_reader->pvstate, pvhandle, pctx);
+		pctx->nr  += record_count;
+		pctx->fnr += record_count;
+		pcount_sink->pcount_func(pcount_sink->pvstate, record_count, pctx);
+		plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, prepipe);
+		if (byte_range_temp_file != NULL) {
+			unlink(byte_range_temp_file);
+			free(byte_range_temp_file);
+		}
+		return 1;
+	}
+
+	if (tail_count >= 0LL)
+		plrec_reader->pseek_tail_func(plrec_reader->pvstate, pvhandle, tail_count, pctx);
+
+	// When building an index, note where the reader is before each record it may return, every so
+	// often. Records the reader drops are counted in FNR as well, so this is where record number FNR
+	// starts.
+	lrec_index_t* pindex = popts->do_build_index ? lrec_index_alloc_for_file(filename) : NULL;
+	long long next_index_fnr = 0LL;
+
+	// The span sink keeps nothing pointing into the file, so the memory behind what's been read can go.
+	lrec_reader_span_t span = { .offset = 0LL, .end = 0LL, .filenum = pctx->filenum };
+	long long released = 0LL;
+
 	while (1) {
+		if (pindex != NULL && pctx->fnr >= next_index_fnr) {
+			long long header_offset;
+			long long offset = plrec_reader->ptell_func(plrec_reader->pvstate, pvhandle, &header_offset);
+			lrec_index_note(pindex, pctx->fnr, offset, header_offset);
+			next_index_fnr = pctx->fnr + popts->index_stride;
+		}
+		if (pspan_sink != NULL) {
+			long long header_offset;
+			span.offset = plrec_reader->ptell_func(plrec_reader->pvstate, pvhandle, &header_offset);
+		}
 		lrec_t* pinrec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, pctx);
 		if (pinrec == NULL)
 			break;
@@ -186,13 +328,295 @@ static int do_file_chained(char* filename, context_t* pctx,
 
 		pindicator(pctx, popts->nr_progress_mod);
 
-		drive_lrec(pinrec, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		if (pspan_sink != NULL) {
+			long long header_offset;
+			span.end = plrec_reader->ptell_func(plrec_reader->pvstate, pvhandle, &header_offset);
+			pspan_sink->pspan_func(pspan_sink->pvstate, pinrec, &span, pctx);
+			if (span.end - released >= SPAN_RELEASE_BYTES) {
+				file_reader_mmap_release(pvhandle, released, span.end);
+				released = span.end;
+			}
+		} else {
+			drive_lrec(pinrec, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		}
 	}
 
-	plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, popts->reader_opts.prepipe);
+	if (pspan_sink != NULL) {
+		file_reader_mmap_state_t* phandle = pvhandle;
+		file_reader_mmap_release(phandle, released, phandle->eof - phandle->sof);
+	}
+	plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, prepipe);
+	if (byte_range_temp_file != NULL) {
+		unlink(byte_range_temp_file);
+		free(byte_range_temp_file);
+	}
+
+	if (pindex != NULL) {
+		// Not if the mapper chain stopped reading early: the count would be short.
+		if (pctx->force_eof == FALSE) {
+			pindex->num_records = pctx->fnr;
+			lrec_index_write(pindex, filename, &popts->reader_opts);
+		}
+		lrec_index_free(pindex);
+	}
+	return 1;
+}
+
+// ----------------------------------------------------------------
+// For late materialization, at end of stream: the first mapper gives back where its records were, in the
+// order it outputs them. Each is read again, from a fresh mapping of its file, and passed to the rest of the
+// chain, one at a time, so that at most a few whole records are in memory at once.
+static void drive_spans(context_t* pctx, lrec_reader_span_sink_t* pspan_sink, int base_filenum,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	cli_opts_t* popts)
+{
+	int num_files = popts->filenames->length;
+	char** filenames = mlr_malloc_or_die(num_files * sizeof(char*));
+	void** pvhandles = mlr_malloc_or_die(num_files * sizeof(void*));
+	int i = 0;
+	for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext, i++) {
+		filenames[i] = pe->value;
+		pvhandles[i] = NULL;
+	}
+
+	lrec_reader_span_t* spans = NULL;
+	long long num_spans = pspan_sink->pspans_func(pspan_sink->pvstate, &spans);
+	sllve_t* prest = pmapper_list->phead->pnext;
+	for (long long j = 0; j < num_spans && !pctx->force_eof; j++) {
+		lrec_reader_span_t* pspan = &spans[j];
+		int k = pspan->filenum - base_filenum - 1;
+		MLR_INTERNAL_CODING_ERROR_IF(k < 0 || k >= num_files);
+		if (pvhandles[k] == NULL) {
+			pvhandles[k] = plrec_reader->popen_func(plrec_reader->pvstate, popts->reader_opts.prepipe, filenames[k]);
+			plrec_reader->psof_func(plrec_reader->pvstate, pvhandles[k]);
+		}
+		lrec_t* prec = plrec_reader->preread_func(plrec_reader, pvhandles[k], pspan->offset, pspan->end, pctx);
+		if (prec == NULL) {
+			fprintf(stderr, "%s: \"%s\" changed while being read.\n", MLR_GLOBALS.bargv0, filenames[k]);
+			exit(1);
+		}
+		if (prest == NULL)
+			plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, prec, pctx);
+		else
+			drive_lrec(prec, pctx, prest, plrec_writer, output_stream);
+	}
+	if (prest != NULL)
+		drive_lrec(NULL, pctx, prest, plrec_writer, output_stream);
+
+	for (i = 0; i < num_files; i++)
+		if (pvhandles[i] != NULL)
+			plrec_reader->pclose_func(plrec_reader->pvstate, pvhandles[i], popts->reader_opts.prepipe);
+	free(spans);
+	free(pvhandles);
+	free(filenames);
+}
+
+// ----------------------------------------------------------------
+// With --shard, the shards' boundaries are rounded down, and the last one goes to end of file.
+static void get_byte_range(long long file_size, cli_opts_t* popts, long long* pstart, long long* pend) {
+	if (popts->num_shards > 0LL) {
+		long long n = popts->num_shards;
+		long long i = popts->shard_number - 1;
+		*pstart = (file_size / n) * i + ((file_size % n) * i) / n;
+		*pend = (i == n - 1) ? -1LL : (file_size / n) * (i + 1) + ((file_size % n) * (i + 1)) / n;
+	} else {
+		*pstart = popts->byte_range_start;
+		*pend = popts->byte_range_end;
+	}
+}
+
+// Autodetected line endings are LF or CRLF, so lines end after LF either way.
+static char* get_byte_range_irs(cli_opts_t* popts) {
+	return streq(popts->reader_opts.irs, "auto") ? "\n" : popts->reader_opts.irs;
+}
+
+// A record is in the range if its line starts in it. The header, if any, is read from where the reader would
+// read it at start of file; when the range starts before the header's end, reading starts just after it.
+static void seek_byte_range_mmap(lrec_reader_t* plrec_reader, void* pvhandle, context_t* pctx, cli_opts_t* popts) {
+	file_reader_mmap_state_t* phandle = pvhandle;
+	char* irs = get_byte_range_irs(popts);
+	int irslen = strlen(irs);
+	long long start, end;
+	get_byte_range(phandle->eof - phandle->sof, popts, &start, &end);
+
+	long long start_offset = mlr_find_line_start_mmap(phandle, irs, irslen, start);
+	long long end_offset = (end < 0LL) ? phandle->eof - phandle->sof : mlr_find_line_start_mmap(phandle, irs, irslen, end);
+	if (start_offset >= end_offset) {
+		phandle->sol = phandle->eof;
+		return;
+	}
+	long long header_offset;
+	long long offset = plrec_reader->ptell_func(plrec_reader->pvstate, pvhandle, &header_offset);
+	if (start_offset > offset) {
+		if (header_offset == LREC_READER_HEADER_NEXT)
+			header_offset = offset;
+		plrec_reader->pseek_func(plrec_reader->pvstate, pvhandle, start_offset, header_offset, pctx);
+	}
+	phandle->eof = phandle->sof + end_offset;
+}
+
+// Returns the name of a temp file holding the header line, if any, and the lines in range, for stdio readers.
+static char* alloc_byte_range_temp_file(char* filename, cli_opts_t* popts) {
+	char* tmpdir = getenv("TMPDIR");
+	char* temp_file = mlr_paste_2_strings((tmpdir == NULL || *tmpdir == 0) ? "/tmp" : tmpdir, "/mlr-byte-range-XXXXXX");
+	int fd = mkstemp(temp_file);
+	FILE* output_stream = (fd < 0) ? NULL : fdopen(fd, "wb");
+	if (output_stream == NULL) {
+		perror("mkstemp");
+		fprintf(stderr, "%s: Could not create \"%s\".\n", MLR_GLOBALS.bargv0, temp_file);
+		exit(1);
+	}
+
+	char* ifile_fmt = popts->reader_opts.ifile_fmt;
+	int with_header = !popts->reader_opts.use_implicit_csv_header
+		&& (streq(ifile_fmt, "csv") || streq(ifile_fmt, "csvlite") || streq(ifile_fmt, "tsv"));
+	char* irs = get_byte_range_irs(popts);
+	long long start, end;
+	get_byte_range((popts->num_shards > 0LL) ? get_file_size(filename) : -1LL, popts, &start, &end);
+
+	FILE* input_stream = file_reader_stdio_vopen(NULL, popts->reader_opts.prepipe, filename);
+	mlr_copy_line_range_stdio(input_stream, output_stream, irs, strlen(irs), with_header,
+		popts->reader_opts.comment_string, start, end);
+	file_reader_stdio_vclose(NULL, input_stream, popts->reader_opts.prepipe);
+
+	if (fclose(output_stream) != 0) {
+		perror("fclose");
+		fprintf(stderr, "%s: Could not write \"%s\".\n", MLR_GLOBALS.bargv0, temp_file);
+		exit(1);
+	}
+	return temp_file;
+}
+
+// ----------------------------------------------------------------
+// Indexes are used when the chain's first mapper needs only record counts or some records by position,
+// and each input file has a current one. Returns NULL otherwise. Not with comments passed through, since
+// those among skipped records would be missed.
+static lrec_index_t** load_indexes(lrec_reader_t* plrec_reader, cli_opts_t* popts) {
+	if (popts->filenames == NULL || popts->filenames->length == 0)
+		return NULL;
+	if (plrec_reader->pseek_func == NULL || popts->do_build_index || popts->nr_progress_mod != 0LL)
+		return NULL;
+	if (popts->byte_range_start >= 0LL || popts->num_shards > 0LL)
+		return NULL;
+	if (popts->reader_opts.comment_handling == PASS_COMMENTS)
+		return NULL;
+	if (popts->reader_opts.precord_count_sink == NULL && popts->reader_opts.precord_ranges == NULL)
+		return NULL;
+
+	lrec_index_t** indexes = mlr_malloc_or_die(popts->filenames->length * sizeof(lrec_index_t*));
+	int i = 0;
+	for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext, i++) {
+		indexes[i] = lrec_index_load(pe->value, &popts->reader_opts);
+		if (indexes[i] == NULL) {
+			for (int j = 0; j < i; j++)
+				lrec_index_free(indexes[j]);
+			free(indexes);
+			return NULL;
+		}
+	}
+	return indexes;
+}
+
+// ----------------------------------------------------------------
+// Record counts come straight from the indexes. Otherwise, files having none of the wanted records are
+// skipped, and within the others the reader seeks to the indexed record at or before the start of each
+// wanted range, when that's ahead of where it is. Skipped records are counted in NR and FNR.
+static int do_files_indexed(context_t* pctx, lrec_index_t** indexes,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	cli_opts_t* popts)
+{
+	lrec_reader_count_sink_t* pcount_sink = popts->reader_opts.precord_count_sink;
+	lrec_reader_record_ranges_t* precord_ranges = popts->reader_opts.precord_ranges;
+
+	lrec_reader_record_range_t* ranges = NULL;
+	int num_ranges = 0;
+	if (pcount_sink == NULL) {
+		long long num_records = 0LL;
+		for (int i = 0; i < popts->filenames->length; i++)
+			num_records += indexes[i]->num_records;
+		num_ranges = precord_ranges->pranges_func(precord_ranges->pvstate, num_records, &ranges);
+	}
+
+	int r = 0;
+	long long base = 0LL; // number of records in the files before this one
+	int i = 0;
+	for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext, i++) {
+		long long num_records = indexes[i]->num_records;
+		pctx->filenum++;
+		pctx->filename = pe->value;
+		pctx->fnr = 0;
+		if (pcount_sink != NULL) {
+			pctx->nr  += num_records;
+			pctx->fnr += num_records;
+			pcount_sink->pcount_func(pcount_sink->pvstate, num_records, pctx);
+		} else {
+			while (r < num_ranges && ranges[r].end <= base)
+				r++;
+			if (r < num_ranges && ranges[r].start < base + num_records) {
+				do_file_indexed(pe->value, indexes[i], base, &ranges[r], num_ranges - r, pctx,
+					plrec_reader, pmapper_list, plrec_writer, output_stream, popts);
+				if (pctx->force_eof == TRUE) // e.g. mlr head
+					break;
+			}
+			pctx->nr  = base + num_records;
+			pctx->fnr = num_records;
+		}
+		base += num_records;
+	}
+
+	free(ranges);
 	return 1;
 }
 
+static void do_file_indexed(char* filename, lrec_index_t* pindex, long long base,
+	lrec_reader_record_range_t* ranges, int num_ranges, context_t* pctx,
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
+	cli_opts_t* popts)
+{
+	void* pvhandle = plrec_reader->popen_func(plrec_reader->pvstate, popts->reader_opts.prepipe, filename);
+	plrec_reader->psof_func(plrec_reader->pvstate, pvhandle);
+
+	int r = 0;
+	while (r < num_ranges) {
+		long long start = ranges[r].start - base;
+		if (start >= pindex->num_records)
+			break;
+		if (pctx->fnr < start) {
+			lrec_index_entry_t* pentry = lrec_index_find(pindex, start);
+			if (pentry->record_number > pctx->fnr) {
+				plrec_reader->pseek_func(plrec_reader->pvstate, pvhandle, pentry->offset, pentry->header_offset,
+					pctx);
+				pctx->nr += pentry->record_number - pctx->fnr;
+				pctx->fnr = pentry->record_number;
+			}
+		}
+
+		lrec_t* pinrec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, pctx);
+		if (pinrec == NULL)
+			break;
+		if (pctx->force_eof == TRUE) { // e.g. mlr head
+			lrec_free(pinrec);
+			break;
+		}
+		// The reader may have dropped records before this one, past the end of the range.
+		long long record_number = pctx->fnr;
+		while (r < num_ranges && ranges[r].end - base <= record_number)
+			r++;
+		if (r >= num_ranges) {
+			lrec_free(pinrec);
+			break;
+		}
+		pctx->nr++;
+		pctx->fnr++;
+		if (record_number < ranges[r].start - base)
+			lrec_free(pinrec);
+		else
+			drive_lrec(pinrec, pctx, pmapper_list->phead, plrec_writer, output_stream);
+	}
+
+	plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, popts->reader_opts.prepipe);
+}
+
 // ----------------------------------------------------------------
 static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer,
 	FILE* output_stream)
@@ -72,7 +72,7 @@ static char* test_lrec_unbacked_api() {
 static char* test_lrec_dkvp_api() {
 	char* line = mlr_strdup_or_die("w=2,x=3,y=4,z=5");
 
-	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', FALSE);
+	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', FALSE, NULL);
 	mu_assert_lf(prec->field_count == 4);
 
 	mu_assert_lf(streq(lrec_get(prec, "w"), "2"));
@@ -110,7 +110,7 @@ static char* test_lrec_dkvp_api() {
 // ----------------------------------------------------------------
 static char* test_lrec_nidx_api() {
 	char* line = mlr_strdup_or_die("a,b,c,d");
-	lrec_t* prec = lrec_parse_stdio_nidx_single_sep(line, ',', FALSE);
+	lrec_t* prec = lrec_parse_stdio_nidx_single_sep(line, ',', FALSE, NULL);
 	mu_assert_lf(prec->field_count == 4);
 
 	mu_assert_lf(streq(lrec_get(prec, "1"), "a"));
@@ -260,6 +260,34 @@ static char* test_lrec_csv_api_disjoint_allocs() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+static char* test_lrec_tsv_api() {
+	char* hdr_line = mlr_strdup_or_die("w\tx\\ty");
+	slls_t* hdr_fields = split_tsv_header_line(hdr_line, '\t');
+	header_keeper_t* pheader_keeper = header_keeper_alloc(hdr_line, hdr_fields);
+	mu_assert_lf(hdr_fields->length == 2);
+	mu_assert_lf(streq(hdr_fields->phead->value, "w"));
+	mu_assert_lf(streq(hdr_fields->phead->pnext->value, "x\ty"));
+
+	char* data_line = mlr_strdup_or_die("a\\nb\\\\c\td\\e\\r");
+	lrec_t* prec = lrec_parse_stdio_tsv_data_line(pheader_keeper, "test-file", 999, data_line, '\t');
+	mu_assert_lf(prec->field_count == 2);
+	mu_assert_lf(streq(lrec_get(prec, "w"), "a\nb\\c"));
+	mu_assert_lf(streq(lrec_get(prec, "x\ty"), "d\\e\r"));
+	lrec_free(prec);
+
+	data_line = mlr_strdup_or_die("1\t\\t");
+	prec = lrec_parse_stdio_tsv_data_line_implicit_header(data_line, '\t');
+	mu_assert_lf(prec->field_count == 2);
+	mu_assert_lf(streq(lrec_get(prec, "1"), "1"));
+	mu_assert_lf(streq(lrec_get(prec, "2"), "\t"));
+	lrec_free(prec);
+
+	header_keeper_free(pheader_keeper);
+
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_lrec_xtab_api() {
 	char* line_1 = mlr_strdup_or_die("w 2");
@@ -408,6 +436,7 @@ static char * run_all_tests() {
 	mu_run_test(test_lrec_nidx_api);
 	mu_run_test(test_lrec_csv_api);
 	mu_run_test(test_lrec_csv_api_disjoint_allocs);
+	mu_run_test(test_lrec_tsv_api);
 	mu_run_test(test_lrec_xtab_api);
 	mu_run_test(test_lrec_put_after);
 	return 0;
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 #include "lib/minunit.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
@@ -16,8 +18,13 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsmv.h"
 #include "containers/percentile_keeper.h"
+#include "containers/percentile_sketch.h"
+#include "containers/hll_sketch.h"
 #include "containers/top_keeper.h"
+#include "containers/frequent_keeper.h"
 #include "containers/dheap.h"
+#include "containers/packed_key.h"
+#include "containers/lhmpkv.h"
 #include "lib/mvfuncs.h"
 
 int tests_run         = 0;
@@ -627,6 +634,94 @@ static char* test_lhmslv() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+static char* test_packed_key() {
+	packed_key_t* pab_c = packed_key_alloc();
+	packed_key_append(pab_c, "ab"); packed_key_append(pab_c, "c"); packed_key_finish(pab_c);
+	packed_key_t* pa_bc = packed_key_alloc();
+	packed_key_append(pa_bc, "a"); packed_key_append(pa_bc, "bc"); packed_key_finish(pa_bc);
+	mu_assert_lf(pab_c->num_values == 2);
+	mu_assert_lf(!packed_key_equals(pab_c, pa_bc));
+
+	// Values come back out in order, as C strings, including empty ones.
+	packed_key_clear(pa_bc);
+	packed_key_append(pa_bc, "ab"); packed_key_append(pa_bc, ""); packed_key_append(pa_bc, "c");
+	packed_key_finish(pa_bc);
+	mu_assert_lf(!packed_key_equals(pab_c, pa_bc));
+	char* value = packed_key_first(pa_bc);
+	mu_assert_lf(streq(value, "ab")); value = packed_key_next(pa_bc, value);
+	mu_assert_lf(streq(value, ""));   value = packed_key_next(pa_bc, value);
+	mu_assert_lf(streq(value, "c"));  value = packed_key_next(pa_bc, value);
+	mu_assert_lf(value == NULL);
+
+	// Refilling reuses the buffer, growing it as needed.
+	char buf[200];
+	memset(buf, 'x', sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+	slls_t* pvalues = slls_alloc();
+	slls_append_no_free(pvalues, "ab");
+	slls_append_no_free(pvalues, buf);
+	packed_key_fill_from_slls(pa_bc, pvalues);
+	mu_assert_lf(pa_bc->num_values == 2);
+	slls_t* pcopy = packed_key_to_slls(pa_bc);
+	mu_assert_lf(slls_equals(pvalues, pcopy));
+	slls_free(pcopy);
+	packed_key_fill_from_slls(pa_bc, pvalues);
+	mu_assert_lf(pa_bc->num_values == 2);
+
+	slls_free(pvalues);
+	packed_key_free(pab_c);
+	packed_key_free(pa_bc);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_lhmpkv() {
+	char buf[32];
+	int n = 1000;
+	packed_key_t* pkey = packed_key_alloc();
+	lhmpkv_t* pmap = lhmpkv_alloc();
+	mu_assert_lf(pmap->num_occupied == 0);
+
+	// Enough keys to make the table grow several times. The map copies keys, so the scratch one is reused.
+	for (int i = 0; i < n; i++) {
+		packed_key_clear(pkey);
+		sprintf(buf, "%d", i % 10);
+		packed_key_append(pkey, buf);
+		sprintf(buf, "%d", i);
+		packed_key_append(pkey, buf);
+		packed_key_finish(pkey);
+		mu_assert_lf(lhmpkv_get(pmap, pkey) == NULL);
+		lhmpkve_t* pe = lhmpkv_put(pmap, pkey, (void*)(long)(i + 1));
+		mu_assert_lf(pe->key != pkey && packed_key_equals(pe->key, pkey));
+	}
+	mu_assert_lf(pmap->num_occupied == n);
+	mu_assert_lf(2 * pmap->num_occupied <= pmap->array_length);
+
+	// Lookups find each, and entries are in insertion order.
+	int i = 0;
+	for (lhmpkve_t* pe = pmap->phead; pe != NULL; pe = pe->pnext, i++) {
+		sprintf(buf, "%d", i);
+		mu_assert_lf(streq(packed_key_next(pe->key, packed_key_first(pe->key)), buf));
+		packed_key_clear(pkey);
+		for (char* value = packed_key_first(pe->key); value != NULL; value = packed_key_next(pe->key, value))
+			packed_key_append(pkey, value);
+		packed_key_finish(pkey);
+		mu_assert_lf(lhmpkv_get(pmap, pkey) == (void*)(long)(i + 1));
+	}
+	mu_assert_lf(i == n);
+
+	// Putting an existing key replaces its value.
+	lhmpkv_put(pmap, pkey, "new");
+	mu_assert_lf(pmap->num_occupied == n);
+	mu_assert_lf(streq(lhmpkv_get(pmap, pkey), "new"));
+	mu_assert_lf(pmap->ptail->pvvalue == (void*)"new");
+
+	lhmpkv_free(pmap);
+	packed_key_free(pkey);
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_lhmsmv() {
 	printf("\n");
@@ -736,6 +831,158 @@ static char* test_percentile_keeper() {
 	return NULL;
 }
 
+// Percentiles asked for in any order, by selection, agree with sorting; ints and floats are kept unboxed
+// until mixed.
+static char* test_percentile_keeper_select() {
+	long long n = 1000LL;
+	percentile_keeper_t* pints = percentile_keeper_alloc();
+	percentile_keeper_t* pfloats = percentile_keeper_alloc();
+	for (long long i = 0; i < n; i++) {
+		long long v = (i * 379) % n / 2; // each of 0..n/2-1 twice
+		percentile_keeper_ingest(pints, mv_from_int(v));
+		percentile_keeper_ingest(pfloats, mv_from_float(-0.5 * v));
+	}
+	mu_assert_lf(pints->storage == PERCENTILE_KEEPER_INTS);
+	mu_assert_lf(pfloats->storage == PERCENTILE_KEEPER_FLOATS);
+
+	double ps[] = { 50.0, 99.0, 0.0, 25.0, 75.0, 100.0, 1.0, 50.0, 37.5, 62.5 };
+	for (int i = 0; i < sizeof(ps)/sizeof(ps[0]); i++) {
+		long long index = ps[i] * n / 100.0;
+		if (index >= n)
+			index = n - 1;
+		mv_t q = percentile_keeper_emit_non_interpolated(pints, ps[i]);
+		mu_assert_lf(q.type == MT_INT && q.u.intv == index / 2);
+		q = percentile_keeper_emit_non_interpolated(pfloats, ps[i]);
+		mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == -0.5 * ((n - 1 - index) / 2));
+		q = percentile_keeper_emit_linearly_interpolated(pints, ps[i]);
+		double findex = (ps[i] / 100.0) * (n - 1);
+		double lo = floor(findex) / 2;
+		mu_assert_lf(index >= 0LL && index < n);
+		mu_assert_lf(findex >= 0.0 && findex <= n - 1);
+		mu_assert_lf(fabs(index - findex) <= 1.0);
+		double dq = (q.type == MT_INT) ? q.u.intv : q.u.fltv;
+		mu_assert_lf(dq >= (long long)lo && dq <= (long long)lo + 1);
+	}
+	mu_assert_lf(pints->permuted);
+
+	percentile_keeper_ingest(pints, mv_from_float(1000.5));
+	mu_assert_lf(pints->storage == PERCENTILE_KEEPER_MIXED);
+	mu_assert_lf(pints->num_fixed == 0);
+	mv_t q = percentile_keeper_emit_non_interpolated(pints, 100.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == 1000.5);
+	q = percentile_keeper_emit_non_interpolated(pints, 0.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == 0LL);
+
+	percentile_keeper_free(pints);
+	percentile_keeper_free(pfloats);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+// Exact until the first compaction, and the same as percentile_keeper then.
+static char* test_percentile_sketch() {
+	percentile_sketch_t* psketch = percentile_sketch_alloc(PERCENTILE_SKETCH_DEFAULT_K);
+	for (long long i = 1; i <= 5; i++) {
+		mv_t value = mv_from_int(i);
+		percentile_sketch_ingest(psketch, &value);
+	}
+	percentile_sketch_print(psketch);
+
+	mv_t q = percentile_sketch_emit_non_interpolated(psketch, 50.0);
+	mu_assert_lf(q.type == MT_INT);
+	mu_assert_lf(q.u.intv == 3LL);
+	q = percentile_sketch_emit_non_interpolated(psketch, 100.0);
+	mu_assert_lf(q.type == MT_INT);
+	mu_assert_lf(q.u.intv == 5LL);
+	q = percentile_sketch_emit_linearly_interpolated(psketch, 10.0);
+	mu_assert_lf(q.type == MT_FLOAT);
+	mu_assert_lf(q.u.fltv == 1.4);
+
+	mv_t value = mv_from_float(0.5);
+	percentile_sketch_ingest(psketch, &value);
+	q = percentile_sketch_emit_non_interpolated(psketch, 0.0);
+	mu_assert_lf(q.type == MT_FLOAT);
+	mu_assert_lf(q.u.fltv == 0.5);
+
+	percentile_sketch_free(psketch);
+	return NULL;
+}
+
+// Ranks are within 2n/k after compactions, and the same for sketches merged from parts of the input.
+static char* test_percentile_sketch_merge() {
+	long long n = 100000LL;
+	int k = PERCENTILE_SKETCH_DEFAULT_K;
+	percentile_sketch_t* pwhole = percentile_sketch_alloc(k);
+	percentile_sketch_t* pfirst = percentile_sketch_alloc(k);
+	percentile_sketch_t* psecond = percentile_sketch_alloc(k);
+	for (long long i = 0; i < n; i++) {
+		mv_t value = mv_from_int((i * 7919) % n); // a permutation of 0..n-1
+		percentile_sketch_ingest(pwhole, &value);
+		percentile_sketch_ingest((i < n/3) ? pfirst : psecond, &value);
+	}
+	mu_assert_lf(pwhole->size < 3 * k + 2 * pwhole->num_levels);
+	percentile_sketch_merge(pfirst, psecond);
+	mu_assert_lf(pfirst->n == n);
+	mu_assert_lf(pfirst->size < 3 * k + 2 * pfirst->num_levels);
+
+	for (double p = 0.0; p <= 100.0; p += 5.0) {
+		mv_t q = percentile_sketch_emit_non_interpolated(pwhole, p);
+		mv_t r = percentile_sketch_emit_non_interpolated(pfirst, p);
+		printf("p%g %lld %lld\n", p, q.u.intv, r.u.intv);
+		mu_assert_lf(q.type == MT_INT && r.type == MT_INT);
+		mu_assert_lf(llabs(q.u.intv - (long long)(p * (n-1) / 100.0)) <= 2 * n / k);
+		mu_assert_lf(llabs(r.u.intv - (long long)(p * (n-1) / 100.0)) <= 2 * n / k);
+	}
+
+	percentile_sketch_free(pwhole);
+	percentile_sketch_free(pfirst);
+	percentile_sketch_free(psecond);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_hll_sketch() {
+	char buf[32];
+	int precision = 10;
+	hll_sketch_t* pwhole = hll_sketch_alloc(precision);
+	hll_sketch_t* pfirst = hll_sketch_alloc(precision);
+	hll_sketch_t* psecond = hll_sketch_alloc(precision);
+
+	// Exact while there are few enough values to keep their hashes.
+	for (int i = 0; i < 50; i++) {
+		sprintf(buf, "%d", i % 40);
+		hll_sketch_ingest(pwhole, hll_hash_string(HLL_HASH_INIT, buf));
+	}
+	mu_assert_lf(pwhole->registers == NULL);
+	mu_assert_lf(hll_sketch_estimate(pwhole) == 40LL);
+
+	// Lashed values hash differently from their concatenation.
+	unsigned long long h1 = hll_hash_string(hll_hash_string(HLL_HASH_INIT, "a"), "bc");
+	unsigned long long h2 = hll_hash_string(hll_hash_string(HLL_HASH_INIT, "ab"), "c");
+	mu_assert_lf(h1 != h2);
+
+	// Within four standard errors, and merging gives the same registers.
+	long long n = 100000LL;
+	for (long long i = 0; i < n; i++) {
+		sprintf(buf, "%lld", i);
+		unsigned long long hash = hll_hash_string(HLL_HASH_INIT, buf);
+		hll_sketch_ingest(pwhole, hash);
+		hll_sketch_ingest((i < 30) ? pfirst : psecond, hash);
+	}
+	mu_assert_lf(pwhole->registers != NULL);
+	mu_assert_lf(pfirst->registers == NULL);
+	hll_sketch_merge(pfirst, psecond);
+	mu_assert_lf(memcmp(pfirst->registers, pwhole->registers, pwhole->num_registers) == 0);
+	unsigned long long estimate = hll_sketch_estimate(pwhole);
+	printf("hll estimate %llu of %lld\n", estimate, n);
+	mu_assert_lf(fabs(estimate - (double)n) < 4 * 1.04 / sqrt(1 << precision) * n);
+
+	hll_sketch_free(pwhole);
+	hll_sketch_free(pfirst);
+	hll_sketch_free(psecond);
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_top_keeper() {
 	int capacity = 3;
@@ -744,12 +991,14 @@ static char* test_top_keeper() {
 	mu_assert_lf(ptop_keeper->size == 0);
 
 	top_keeper_add(ptop_keeper, mv_from_float(5.0), NULL);
+	top_keeper_sort(ptop_keeper);
 	top_keeper_print(ptop_keeper);
 	mu_assert_lf(ptop_keeper->size == 1);
 	mu_assert_lf(ptop_keeper->top_values[0].type == MT_FLOAT);
 	mu_assert_lf(ptop_keeper->top_values[0].u.fltv == 5.0);
 
 	top_keeper_add(ptop_keeper, mv_from_float(6.0), NULL);
+	top_keeper_sort(ptop_keeper);
 	top_keeper_print(ptop_keeper);
 	mu_assert_lf(ptop_keeper->size == 2);
 	mu_assert_lf(ptop_keeper->top_values[0].type == MT_FLOAT);
@@ -758,6 +1007,7 @@ static char* test_top_keeper() {
 	mu_assert_lf(ptop_keeper->top_values[1].u.fltv == 5.0);
 
 	top_keeper_add(ptop_keeper, mv_from_int(4), NULL);
+	top_keeper_sort(ptop_keeper);
 	top_keeper_print(ptop_keeper);
 	mu_assert_lf(ptop_keeper->size == 3);
 	mu_assert_lf(ptop_keeper->top_values[0].type == MT_FLOAT);
@@ -768,6 +1018,7 @@ static char* test_top_keeper() {
 	mu_assert_lf(ptop_keeper->top_values[2].u.intv == 4.0);
 
 	top_keeper_add(ptop_keeper, mv_from_int(2), NULL);
+	top_keeper_sort(ptop_keeper);
 	top_keeper_print(ptop_keeper);
 	mu_assert_lf(ptop_keeper->size == 3);
 	mu_assert_lf(ptop_keeper->top_values[0].type == MT_FLOAT);
@@ -778,6 +1029,7 @@ static char* test_top_keeper() {
 	mu_assert_lf(ptop_keeper->top_values[2].u.intv == 4.0);
 
 	top_keeper_add(ptop_keeper, mv_from_int(7), NULL);
+	top_keeper_sort(ptop_keeper);
 	top_keeper_print(ptop_keeper);
 	mu_assert_lf(ptop_keeper->size == 3);
 	mu_assert_lf(ptop_keeper->top_values[0].type == MT_INT);
@@ -791,6 +1043,144 @@ static char* test_top_keeper() {
 	return NULL;
 }
 
+// As with mlr top -a: equal values rank later-added first, and displace earlier ones.
+static char* test_top_keeper_ties() {
+	top_keeper_t* ptop_keeper = top_keeper_alloc(3);
+	top_keeper_add(ptop_keeper, mv_from_int(5), lrec_literal_1("i", "1"));
+	top_keeper_add(ptop_keeper, mv_from_int(5), lrec_literal_1("i", "2"));
+	top_keeper_add(ptop_keeper, mv_from_int(7), lrec_literal_1("i", "3"));
+	top_keeper_add(ptop_keeper, mv_from_float(5.0), lrec_literal_1("i", "4"));
+	top_keeper_add(ptop_keeper, mv_from_int(3), lrec_literal_1("i", "5"));
+	top_keeper_sort(ptop_keeper);
+	top_keeper_print(ptop_keeper);
+	mu_assert_lf(ptop_keeper->size == 3);
+	mu_assert_lf(ptop_keeper->top_values[0].u.intv == 7);
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[0], "i"), "3"));
+	mu_assert_lf(ptop_keeper->top_values[1].type == MT_FLOAT);
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[1], "i"), "4"));
+	mu_assert_lf(ptop_keeper->top_values[2].u.intv == 5);
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[2], "i"), "2"));
+
+	// Adding after sorting; and with n = 1, the last of equal maxima is kept.
+	top_keeper_add(ptop_keeper, mv_from_int(6), lrec_literal_1("i", "6"));
+	top_keeper_sort(ptop_keeper);
+	mu_assert_lf(ptop_keeper->size == 3);
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[0], "i"), "3"));
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[1], "i"), "6"));
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[2], "i"), "4"));
+	for (int i = 0; i < ptop_keeper->size; i++)
+		lrec_free(ptop_keeper->top_precords[i]);
+	top_keeper_free(ptop_keeper);
+
+	ptop_keeper = top_keeper_alloc(1);
+	top_keeper_add(ptop_keeper, mv_from_int(-2), lrec_literal_1("i", "1"));
+	top_keeper_add(ptop_keeper, mv_from_int(-2), lrec_literal_1("i", "2"));
+	top_keeper_add(ptop_keeper, mv_from_int(-3), lrec_literal_1("i", "3"));
+	top_keeper_sort(ptop_keeper);
+	mu_assert_lf(ptop_keeper->size == 1);
+	mu_assert_lf(streq(lrec_get(ptop_keeper->top_precords[0], "i"), "2"));
+	lrec_free(ptop_keeper->top_precords[0]);
+	top_keeper_free(ptop_keeper);
+
+	ptop_keeper = top_keeper_alloc(0);
+	top_keeper_add(ptop_keeper, mv_from_int(1), lrec_literal_1("i", "1"));
+	mu_assert_lf(ptop_keeper->size == 0);
+	top_keeper_free(ptop_keeper);
+	return NULL;
+}
+
+// Keepers fed the two halves of a stream, then merged, keep what one fed all of it does, in the same order.
+static char* test_top_keeper_merge() {
+	int values[] = { 3, 9, 1, 9, 4, 4, 8, 2, 9, 4, 0, 8, 7, 4, 9, 1, 3, 8, 4, 6 };
+	int n = sizeof(values) / sizeof(values[0]);
+	char* names[] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+		"10", "11", "12", "13", "14", "15", "16", "17", "18", "19" };
+
+	for (int capacity = 1; capacity <= n + 1; capacity += 3) {
+		top_keeper_t* pall   = top_keeper_alloc(capacity);
+		top_keeper_t* pfirst = top_keeper_alloc(capacity);
+		top_keeper_t* psecond = top_keeper_alloc(capacity);
+		for (int i = 0; i < n; i++) {
+			top_keeper_add(pall, mv_from_int(values[i]), lrec_literal_1("i", names[i]));
+			top_keeper_add(i < n/2 ? pfirst : psecond, mv_from_int(values[i]), lrec_literal_1("i", names[i]));
+		}
+		top_keeper_sort(pfirst); // merging into a sorted keeper is allowed
+		top_keeper_merge(pfirst, psecond);
+		mu_assert_lf(psecond->size == 0);
+		top_keeper_sort(pall);
+		top_keeper_sort(pfirst);
+		mu_assert_lf(pfirst->size == pall->size);
+		for (int i = 0; i < pall->size; i++) {
+			mu_assert_lf(pfirst->top_values[i].u.intv == pall->top_values[i].u.intv);
+			mu_assert_lf(streq(lrec_get(pfirst->top_precords[i], "i"), lrec_get(pall->top_precords[i], "i")));
+			if (i > 0) {
+				mu_assert_lf(pall->top_values[i].u.intv <= pall->top_values[i-1].u.intv);
+			}
+			lrec_free(pall->top_precords[i]);
+			lrec_free(pfirst->top_precords[i]);
+		}
+		top_keeper_free(pall);
+		top_keeper_free(pfirst);
+		top_keeper_free(psecond);
+	}
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_frequent_keeper() {
+	char buf[32];
+	int capacity = 20;
+	int num_values = 100;
+	long long true_counts[100];
+	memset(true_counts, 0, sizeof(true_counts));
+
+	// Value v is added about 1/(v+1) as often as value 0, in an order that repeatedly evicts the tail.
+	frequent_keeper_t* pkeeper = frequent_keeper_alloc(capacity);
+	unsigned long long n = 0LL;
+	for (int round = 1; round <= 50; round++) {
+		for (int v = 0; v < num_values; v++) {
+			if (round % (v + 1) != 0)
+				continue;
+			sprintf(buf, "%d", v);
+			slls_t* pvalues = slls_single_no_free(buf);
+			frequent_keeper_add(pkeeper, pvalues);
+			slls_free(pvalues);
+			true_counts[v]++;
+			n++;
+		}
+	}
+	frequent_keeper_print(pkeeper);
+	mu_assert_lf(pkeeper->size == capacity);
+	mu_assert_lf(pkeeper->num_added == n);
+
+	// Every value is findable, counts are within their error bounds, and values more frequent than n/capacity
+	// are all tracked.
+	int num_tracked[100];
+	memset(num_tracked, 0, sizeof(num_tracked));
+	frequent_keeper_entry_t** pentries = frequent_keeper_sorted_entries(pkeeper);
+	unsigned long long total = 0LL;
+	for (int i = 0; i < pkeeper->size; i++) {
+		int v = atoi(pentries[i]->pvalues->phead->value);
+		num_tracked[v]++;
+		total += pentries[i]->count;
+		mu_assert_lf(pentries[i]->count - pentries[i]->error <= true_counts[v]);
+		mu_assert_lf(true_counts[v] <= pentries[i]->count);
+		if (i > 0)
+			mu_assert_lf(pentries[i]->count <= pentries[i-1]->count);
+	}
+	mu_assert_lf(total == n);
+	for (int v = 0; v < num_values; v++) {
+		mu_assert_lf(num_tracked[v] <= 1);
+		if (true_counts[v] > n / capacity)
+			mu_assert_lf(num_tracked[v] == 1);
+	}
+	mu_assert_lf(pentries[0]->count == 50 && pentries[0]->error == 0);
+	free(pentries);
+
+	frequent_keeper_free(pkeeper);
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_dheap() {
 
@@ -875,8 +1265,17 @@ static char * run_all_tests() {
 	mu_run_test(test_lhms2v);
 	mu_run_test(test_lhmslv);
 	mu_run_test(test_lhmsmv);
+	mu_run_test(test_packed_key);
+	mu_run_test(test_lhmpkv);
 	mu_run_test(test_percentile_keeper);
+	mu_run_test(test_percentile_keeper_select);
+	mu_run_test(test_percentile_sketch);
+	mu_run_test(test_percentile_sketch_merge);
+	mu_run_test(test_hll_sketch);
 	mu_run_test(test_top_keeper);
+	mu_run_test(test_top_keeper_ties);
+	mu_run_test(test_top_keeper_merge);
+	mu_run_test(test_frequent_keeper);
 	mu_run_test(test_dheap);
 	return 0;
 }